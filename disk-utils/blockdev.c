@@ -9,8 +9,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <errno.h>
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 #include "c.h"
 #include "nls.h"
 #include "blkdev.h"
@@ -18,6 +23,7 @@
 #include "closestream.h"
 #include "strutils.h"
 #include "sysfs.h"
+#include "xalloc.h"
 
 struct bdc {
 	long		ioc;		/* ioctl code */
@@ -33,6 +39,37 @@ struct bdc {
 	int		flags;
 };
 
+/* --report result for one device */
+struct bdreport {
+	char		*device;
+	dev_t		devno;		/* from /proc/partitions, or 0 */
+
+	int		ro, ssz, bsz;
+	long		ra;
+	unsigned long long bytes;
+	char		start_str[16];
+
+	int		error;		/* REPORT_ERR_* */
+	int		errsv;		/* errno for REPORT_ERR_OPEN and _STAT */
+	unsigned int	quiet : 1;
+};
+
+enum {
+	REPORT_OK = 0,
+	REPORT_ERR_OPEN,
+	REPORT_ERR_STAT,
+	REPORT_ERR_IOCTL,
+	REPORT_ERR_SYSFS
+};
+
+struct report_control {
+	struct bdreport	*reps;
+	size_t		nreps;
+
+	unsigned int	nworkers;	/* --workers */
+	unsigned int	sysfs : 1;	/* --sysfs */
+};
+
 /* command flags */
 enum {
 	FL_NOPTR	= (1 << 1),	/* does not assume pointer (ARG_INT only)*/
@@ -186,7 +223,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_HEADER, stdout);
 	printf(_(
 	         " %1$s [-v|-q] commands devices\n"
-	         " %1$s --report [devices]\n"
+	         " %1$s --report [--sysfs] [--workers <num>] [devices]\n"
 	         " %1$s -h|-V\n"
 		), program_invocation_short_name);
 
@@ -197,6 +234,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	puts(  _(" -q             quiet mode"));
 	puts(  _(" -v             verbose mode"));
 	puts(  _("     --report   print report for specified (or all) devices"));
+	puts(  _("     --sysfs    read the report from sysfs, do not open the devices"));
+	puts(  _("     --workers <num>\n"
+		 "                report the devices by <num> threads"));
 	fputs(USAGE_SEPARATOR, stdout);
 	printf(USAGE_HELP_OPTIONS(16));
 
@@ -229,8 +269,10 @@ static int find_cmd(char *s)
 
 static void do_commands(int fd, char **argv, int d);
 static void report_header(void);
-static void report_device(char *device, int quiet);
-static void report_all_devices(void);
+static void report_add_device(struct report_control *ctl, char *device,
+			      dev_t devno, int quiet);
+static void report_all_devices(struct report_control *ctl);
+static void report_devices(struct report_control *ctl);
 
 int main(int argc, char **argv)
 {
@@ -254,13 +296,40 @@ int main(int argc, char **argv)
 
 	/* --report not together with other commands */
 	if (!strcmp(argv[1], "--report")) {
+		struct report_control ctl = { .nworkers = 1 };
+
+		for (d = 2; d < argc; d++) {
+			if (!strcmp(argv[d], "--sysfs"))
+				ctl.sysfs = 1;
+			else if (!strcmp(argv[d], "--workers")) {
+				if (++d >= argc)
+					errx(EXIT_FAILURE, _("option '--workers' requires an argument"));
+				ctl.nworkers = strtou32_or_err(argv[d],
+						_("invalid number of workers argument"));
+				if (!ctl.nworkers)
+					errx(EXIT_FAILURE, _("invalid number of workers argument"));
+			} else if (!strcmp(argv[d], "--")) {
+				d++;
+				break;
+			} else if (!strncmp(argv[d], "--", 2)) {
+				warnx(_("unknown report option: %s"), argv[d]);
+				errtryhelp(EXIT_FAILURE);
+			} else
+				break;
+		}
+
 		report_header();
-		if (argc > 2) {
-			for (d = 2; d < argc; d++)
-				report_device(argv[d], 0);
+		if (d < argc) {
+			for (; d < argc; d++)
+				report_add_device(&ctl, argv[d], 0, 0);
 		} else {
-			report_all_devices();
+			report_all_devices(&ctl);
 		}
+		report_devices(&ctl);
+
+		for (k = 0; (size_t) k < ctl.nreps; k++)
+			free(ctl.reps[k].device);
+		free(ctl.reps);
 		return EXIT_SUCCESS;
 	}
 
@@ -425,7 +494,23 @@ static void do_commands(int fd, char **argv, int d)
 	}
 }
 
-static void report_all_devices(void)
+static void report_add_device(struct report_control *ctl, char *device,
+			      dev_t devno, int quiet)
+{
+	struct bdreport *r;
+
+	if (ctl->nreps % 64 == 0)
+		ctl->reps = xrealloc(ctl->reps,
+				(ctl->nreps + 64) * sizeof(struct bdreport));
+	r = &ctl->reps[ctl->nreps++];
+	memset(r, 0, sizeof(*r));
+
+	r->device = xstrdup(device);
+	r->devno = devno;
+	r->quiet = quiet ? 1 : 0;
+}
+
+static void report_all_devices(struct report_control *ctl)
 {
 	FILE *procpt;
 	char line[200];
@@ -443,62 +528,245 @@ static void report_all_devices(void)
 			continue;
 
 		snprintf(device, sizeof(device), "/dev/%s", ptname);
-		report_device(device, 1);
+		report_add_device(ctl, device, makedev(ma, mi), 1);
 	}
 
 	fclose(procpt);
 }
 
-static void report_device(char *device, int quiet)
+/*
+ * Fills the start sector of partitions. If @disk_pc is not NULL, the sysfs
+ * path of the whole disk is returned there for partitions.
+ */
+static void report_get_start(struct bdreport *r, struct path_cxt *pc,
+			     struct path_cxt **disk_pc)
 {
-	int fd;
-	int ro, ssz, bsz;
-	long ra;
-	unsigned long long bytes;
 	uint64_t start = 0;
-	char start_str[16] = { "\0" };
+	dev_t disk;
+
+	if (pc &&
+	    sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk) == 0 &&
+	    disk != r->devno) {
+
+		if (ul_path_read_u64(pc, &start, "start") != 0)
+			/* TRANSLATORS: Start sector not available. Max. 15 letters. */
+			snprintf(r->start_str, sizeof(r->start_str), "%15s", _("N/A"));
+		if (disk_pc)
+			*disk_pc = ul_new_sysfs_path(disk, NULL, NULL);
+	}
+	if (!*r->start_str)
+		snprintf(r->start_str, sizeof(r->start_str), "%15ju", start);
+}
+
+static void report_read_ioctls(struct bdreport *r)
+{
+	int fd;
 	struct stat st;
 
-	fd = open(device, O_RDONLY | O_NONBLOCK);
+	fd = open(r->device, O_RDONLY | O_NONBLOCK);
 	if (fd < 0) {
-		if (!quiet)
-			warn(_("cannot open %s"), device);
+		r->error = REPORT_ERR_OPEN;
+		r->errsv = errno;
 		return;
 	}
 
-	ro = ssz = bsz = 0;
-	ra = 0;
 	if (fstat(fd, &st) == 0) {
-		dev_t disk;
 		struct path_cxt *pc;
 
+		r->devno = st.st_rdev;
 		pc = ul_new_sysfs_path(st.st_rdev, NULL, NULL);
-		if (pc &&
-		    sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk) == 0 &&
-		    disk != st.st_rdev) {
+		report_get_start(r, pc, NULL);
+		ul_unref_path(pc);
+	}
+	if (!*r->start_str)
+		snprintf(r->start_str, sizeof(r->start_str), "%15ju", (uintmax_t) 0);
+
+	if (ioctl(fd, BLKROGET, &r->ro) != 0 ||
+	    ioctl(fd, BLKRAGET, &r->ra) != 0 ||
+	    ioctl(fd, BLKSSZGET, &r->ssz) != 0 ||
+	    ioctl(fd, BLKBSZGET, &r->bsz) != 0 ||
+	    blkdev_get_size(fd, &r->bytes) != 0)
+		r->error = REPORT_ERR_IOCTL;
+
+	close(fd);
+}
 
-			if (ul_path_read_u64(pc, &start, "start") != 0)
-				/* TRANSLATORS: Start sector not available. Max. 15 letters. */
-				snprintf(start_str, sizeof(start_str), "%15s", _("N/A"));
+/*
+ * Reads the same values as report_read_ioctls() from sysfs. The device is
+ * not opened, so it is not spun up and close() does not trigger udev
+ * change events. The block size (BSZ) is not exported by the kernel; the
+ * default the kernel sets when the device is opened is reported instead.
+ */
+static void report_read_sysfs(struct bdreport *r)
+{
+	struct path_cxt *pc, *disk_pc = NULL, *queue;
+	uint64_t sectors, ra_kb;
+	int32_t ro, ssz;
+	long pagesz;
+
+	if (!r->devno) {
+		struct stat st;
+
+		if (stat(r->device, &st) != 0) {
+			r->error = REPORT_ERR_STAT;
+			r->errsv = errno;
+			return;
 		}
-		ul_unref_path(pc);
+		if (!S_ISBLK(st.st_mode)) {
+			r->error = REPORT_ERR_IOCTL;
+			return;
+		}
+		r->devno = st.st_rdev;
+	}
+
+	pc = ul_new_sysfs_path(r->devno, NULL, NULL);
+	if (!pc) {
+		r->error = REPORT_ERR_SYSFS;
+		return;
 	}
-	if (!*start_str)
-		snprintf(start_str, sizeof(start_str), "%15ju", start);
-
-	if (ioctl(fd, BLKROGET, &ro) == 0 &&
-	    ioctl(fd, BLKRAGET, &ra) == 0 &&
-	    ioctl(fd, BLKSSZGET, &ssz) == 0 &&
-	    ioctl(fd, BLKBSZGET, &bsz) == 0 &&
-	    blkdev_get_size(fd, &bytes) == 0) {
-		printf("%s %5ld %5d %5d %s %15lld   %s\n",
-			ro ? "ro" : "rw", ra, ssz, bsz, start_str, bytes, device);
-	} else {
-		if (!quiet)
-			warnx(_("ioctl error on %s"), device);
+	report_get_start(r, pc, &disk_pc);
+
+	/* partitions have no queue/, use the whole disk */
+	queue = disk_pc ? disk_pc : pc;
+
+	if (ul_path_read_s32(pc, &ro, "ro") != 0 ||
+	    ul_path_read_u64(pc, &sectors, "size") != 0 ||
+	    ul_path_read_u64(queue, &ra_kb, "queue/read_ahead_kb") != 0 ||
+	    ul_path_read_s32(queue, &ssz, "queue/logical_block_size") != 0 ||
+	    ssz <= 0) {
+		r->error = REPORT_ERR_SYSFS;
+		goto done;
 	}
 
-	close(fd);
+	r->ro = ro;
+	r->ra = ra_kb * 2;		/* in 512-byte sectors */
+	r->ssz = ssz;
+	r->bytes = sectors << 9;
+
+	/* see set_init_blocksize() in the kernel */
+	pagesz = getpagesize();
+	for (r->bsz = ssz; r->bsz < pagesz; r->bsz <<= 1) {
+		if (r->bytes & r->bsz)
+			break;
+	}
+done:
+	ul_unref_path(disk_pc);
+	ul_unref_path(pc);
+}
+
+static void report_read(struct report_control *ctl, struct bdreport *r)
+{
+	if (ctl->sysfs)
+		report_read_sysfs(r);
+	else
+		report_read_ioctls(r);
+}
+
+static void report_print(struct bdreport *r)
+{
+	switch (r->error) {
+	case REPORT_OK:
+		printf("%s %5ld %5d %5d %s %15lld   %s\n",
+			r->ro ? "ro" : "rw", r->ra, r->ssz, r->bsz,
+			r->start_str, r->bytes, r->device);
+		break;
+	case REPORT_ERR_OPEN:
+		if (!r->quiet) {
+			errno = r->errsv;
+			warn(_("cannot open %s"), r->device);
+		}
+		break;
+	case REPORT_ERR_STAT:
+		if (!r->quiet) {
+			errno = r->errsv;
+			warn(_("stat of %s failed"), r->device);
+		}
+		break;
+	case REPORT_ERR_IOCTL:
+		if (!r->quiet)
+			warnx(_("ioctl error on %s"), r->device);
+		break;
+	case REPORT_ERR_SYSFS:
+		if (!r->quiet)
+			warnx(_("cannot read sysfs attributes of %s"), r->device);
+		break;
+	}
+}
+
+#ifdef HAVE_PTHREAD_H
+struct report_workers {
+	struct report_control *ctl;
+	size_t next;			/* the next device to read */
+	pthread_mutex_t lock;		/* protects next */
+};
+
+static void *report_worker(void *data)
+{
+	struct report_workers *wrk = data;
+
+	for (;;) {
+		struct bdreport *r = NULL;
+
+		pthread_mutex_lock(&wrk->lock);
+		if (wrk->next < wrk->ctl->nreps)
+			r = &wrk->ctl->reps[wrk->next++];
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (!r)
+			break;
+		report_read(wrk->ctl, r);
+	}
+	return NULL;
+}
+
+/*
+ * Reads the devices in parallel; slow devices (e.g. disks in standby)
+ * do not block the others. The output is printed in the original order
+ * when all the devices are read.
+ */
+static void report_parallel(struct report_control *ctl)
+{
+	struct report_workers wrk = { .ctl = ctl };
+	pthread_t *threads;
+	unsigned int i, n, nthreads;
+	size_t k;
+
+	nthreads = min((size_t) ctl->nworkers, ctl->nreps);
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (n = 0; n < nthreads; n++) {
+		if (pthread_create(&threads[n], NULL, report_worker, &wrk) != 0)
+			break;
+	}
+	if (!n)
+		report_worker(&wrk);	/* no thread, do it ourselves */
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+
+	for (k = 0; k < ctl->nreps; k++)
+		report_print(&ctl->reps[k]);
+}
+#endif /* HAVE_PTHREAD_H */
+
+static void report_devices(struct report_control *ctl)
+{
+	size_t i;
+
+#ifdef HAVE_PTHREAD_H
+	if (ctl->nworkers > 1 && ctl->nreps > 1) {
+		report_parallel(ctl);
+		return;
+	}
+#endif
+	for (i = 0; i < ctl->nreps; i++) {
+		report_read(ctl, &ctl->reps[i]);
+		report_print(&ctl->reps[i]);
+	}
 }
 
 static void report_header(void)
@@ -218,6 +218,7 @@ struct cfdisk_extra {
 struct cfdisk_line {
 	char			*data;		/* line data */
 	struct libscols_table	*extra;		/* extra info ('X') */
+	char			*extra_data;	/* rendered extra info */
 	WINDOW			*w;		/* window with extra info */
 };
 
@@ -468,6 +469,7 @@ static void cfdisk_free_lines(struct cfdisk *cf)
 	size_t i = 0;
 	while(i < cf->nlines) {
 		scols_unref_table(cf->lines[i].extra);
+		free(cf->lines[i].extra_data);
 
 		DBG(UI, ul_debug("delete window: %p",
 				cf->lines[i].w));
@@ -481,6 +483,13 @@ static void cfdisk_free_lines(struct cfdisk *cf)
 	free(cf->lines);
 	cf->lines = NULL;
 }
+static void lines_set_page_size(struct cfdisk *cf)
+{
+	cf->page_sz = 0;
+	if (MENU_START_LINE - TABLE_START_LINE < cf->nlines)
+		cf->page_sz = MENU_START_LINE - TABLE_START_LINE - 1;
+}
+
 /*
  * Read data about partitions from libfdisk and prepare output lines.
  */
@@ -517,11 +526,9 @@ static int lines_refresh(struct cfdisk *cf)
 
 	cf->linesbufsz = strlen(cf->linesbuf);
 	cf->nlines = fdisk_table_get_nents(cf->table) + 1;	/* 1 for header line */
-	cf->page_sz = 0;
 	cf->wrong_order = fdisk_table_wrong_order(cf->table) ? 1 : 0;
 
-	if (MENU_START_LINE - TABLE_START_LINE < cf->nlines)
-		cf->page_sz = MENU_START_LINE - TABLE_START_LINE - 1;
+	lines_set_page_size(cf);
 
 	cf->lines = xcalloc(cf->nlines, sizeof(struct cfdisk_line));
 
@@ -1446,7 +1453,7 @@ static int ui_draw_extra(struct cfdisk *cf)
 	WINDOW *win_ex;
 	int wline = 1;
 	struct cfdisk_line *ln = &cf->lines[cf->lines_idx];
-	char *tbstr = NULL, *end;
+	char *tbstr, *end;
 	int win_ex_start_line, win_height, tblen;
 	int ndatalines;
 
@@ -1485,23 +1492,27 @@ static int ui_draw_extra(struct cfdisk *cf)
 	if ((size_t) win_ex_start_line + win_height + 1 < MENU_START_LINE)
 		win_ex_start_line = MENU_START_LINE - win_height;
 
-	win_ex = subwin(stdscr, win_height, ui_cols - 2, win_ex_start_line, 1);
+	/* the lines are rendered only once, see lines_refresh() */
+	if (!ln->extra_data) {
+		scols_table_reduce_termwidth(ln->extra, 4);
+		scols_print_table_to_string(ln->extra, &ln->extra_data);
+		if (!ln->extra_data)
+			return 1;
 
-	scols_table_reduce_termwidth(ln->extra, 4);
-	scols_print_table_to_string(ln->extra, &tbstr);
+		end = ln->extra_data;
+		while ((end = strchr(end, '\n')))
+			*end++ = '\0';
+	}
 
-	end = tbstr;
-	while ((end = strchr(end, '\n')))
-		*end++ = '\0';
+	win_ex = subwin(stdscr, win_height, ui_cols - 2, win_ex_start_line, 1);
 
 	box(win_ex, 0, 0);
 
-	end = tbstr;
+	tbstr = ln->extra_data;
 	while (--win_height > 1) {
 		mvwaddstr(win_ex, wline++, 1 /* window column*/, tbstr);
 		tbstr += strlen(tbstr) + 1;
 	}
-	free(end);
 
 	if (ln->w)
 		delwin(ln->w);
@@ -1776,7 +1787,8 @@ static int ui_refresh(struct cfdisk *cf)
 	lb = fdisk_get_label(cf->cxt, NULL);
 	assert(lb);
 
-	clear();
+	/* curses sends only the changed cells, resize() forces full repaint */
+	erase();
 
 	/* header */
 	attron(A_BOLD);
@@ -2331,7 +2343,7 @@ static int main_menu_ignore_keys(struct cfdisk *cf, char *ignore,
 static int main_menu_action(struct cfdisk *cf, int key)
 {
 	size_t n;
-	int ref = 0, rc, org_order = cf->wrong_order;
+	int ref = 0, redraw = 0, rc, org_order = cf->wrong_order;
 	const char *info = NULL, *warn = NULL;
 	struct fdisk_partition *pa;
 
@@ -2382,14 +2394,15 @@ static int main_menu_action(struct cfdisk *cf, int key)
 	case 'd': /* Delete */
 		if (fdisk_delete_partition(cf->cxt, n) != 0)
 			warn = _("Could not delete partition %zu.");
-		else
+		else {
 			info = _("Partition %zu has been deleted.");
-		ref = 1;
+			ref = 1;
+		}
 		break;
 	case 'h': /* Help */
 	case '?':
 		ui_help();
-		ref = 1;
+		redraw = 1;
 		break;
 	case 'n': /* New */
 	{
@@ -2442,12 +2455,14 @@ static int main_menu_action(struct cfdisk *cf, int key)
 			return -EINVAL;
 		t = (struct fdisk_parttype *) fdisk_partition_get_type(pa);
 		t = ui_get_parttype(cf, t);
-		ref = 1;
 
-		if (t && fdisk_set_partition_type(cf->cxt, n, t) == 0)
+		if (t && fdisk_set_partition_type(cf->cxt, n, t) == 0) {
 			info = _("Changed type of partition %zu.");
-		else
+			ref = 1;
+		} else {
 			info = _("The type of partition %zu is unchanged.");
+			redraw = 1;
+		}
 		break;
 	}
 	case 'r': /* resize */
@@ -2511,7 +2526,7 @@ static int main_menu_action(struct cfdisk *cf, int key)
 			  _("Type \"yes\" or \"no\", or press ESC to leave this dialog."),
 			  buf, sizeof(buf));
 
-		ref = 1;
+		redraw = 1;
 		if (rc <= 0 || (strcasecmp(buf, "yes") != 0 &&
 				strcasecmp(buf, _("yes")) != 0)) {
 			info = _("Did not write partition table to disk.");
@@ -2521,6 +2536,7 @@ static int main_menu_action(struct cfdisk *cf, int key)
 		if (rc)
 			warn = _("Failed to write disklabel.");
 		else {
+			ref = 1;
 			if (cf->device_is_used)
 				fdisk_reread_changes(cf->cxt, cf->original_layout);
 			else
@@ -2534,8 +2550,10 @@ static int main_menu_action(struct cfdisk *cf, int key)
 		break;
 	}
 
-	if (ref) {
+	/* rebuild the lines only if the partition table has been modified */
+	if (ref)
 		lines_refresh(cf);
+	if (ref || redraw) {
 		ui_refresh(cf);
 		ui_draw_extra(cf);
 	} else
@@ -2555,10 +2573,17 @@ static int main_menu_action(struct cfdisk *cf, int key)
 
 static void ui_resize_refresh(struct cfdisk *cf)
 {
+	size_t cols = ui_cols;
+
 	DBG(UI, ul_debug("ui resize/refresh"));
 	resize();
 	menu_refresh_size(cf);
-	lines_refresh(cf);
+
+	/* the lines are formatted for the terminal width */
+	if (cols != ui_cols)
+		lines_refresh(cf);
+	else
+		lines_set_page_size(cf);
 	ui_refresh(cf);
 	ui_draw_extra(cf);
 }
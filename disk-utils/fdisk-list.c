@@ -1,6 +1,8 @@
 #include <libfdisk.h>
 #include <libsmartcols.h>
 #include <assert.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 
 #include "c.h"
 #include "xalloc.h"
@@ -400,17 +402,146 @@ int print_device_freespace(struct fdisk_context *cxt, char *device, int warnme,
 	return 0;
 }
 
+/*
+ * Opening a device and probing its label is mostly waiting for I/O, so the
+ * devices are listed by forked workers. Every worker writes to a temporary
+ * file and the output is copied to stdout and stderr in the order of the
+ * devices.
+ */
+#define MAX_LIST_WORKERS	16
+
+struct list_worker {
+	pid_t	pid;		/* 0 if not forked */
+	FILE	*out;
+	FILE	*err;		/* NULL if stderr goes to @out */
+};
+
+static int stdout_is_stderr(void)
+{
+	struct stat a, b;
+
+	return fstat(STDOUT_FILENO, &a) == 0 && fstat(STDERR_FILENO, &b) == 0
+	       && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+}
+
+static void copy_output(FILE *from, FILE *to)
+{
+	char buf[BUFSIZ];
+	size_t n;
+
+	rewind(from);
+	while ((n = fread(buf, 1, sizeof(buf), from)) > 0)
+		fwrite(buf, 1, n, to);
+	fflush(to);
+	fclose(from);
+}
+
+static void start_list_worker(struct fdisk_context *cxt, struct list_worker *w,
+			      char *device, int warnme, int verify,
+			      int separator, int merged)
+{
+	memset(w, 0, sizeof(*w));
+
+	w->out = tmpfile();
+	if (w->out && !merged)
+		w->err = tmpfile();
+	if (!w->out || (!merged && !w->err))
+		goto fallback;
+
+	w->pid = fork();
+	if (w->pid == 0) {
+		int rc;
+
+		dup2(fileno(w->out), STDOUT_FILENO);
+		dup2(fileno(w->err ? w->err : w->out), STDERR_FILENO);
+
+		rc = print_device_pt(cxt, device, warnme, verify, separator);
+		fflush(stdout);
+		fflush(stderr);
+		_exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	if (w->pid > 0)
+		return;
+fallback:
+	/* list the device by finish_list_worker() */
+	if (w->out)
+		fclose(w->out);
+	if (w->err)
+		fclose(w->err);
+	memset(w, 0, sizeof(*w));
+}
+
+static int finish_list_worker(struct fdisk_context *cxt, struct list_worker *w,
+			      char *device, int warnme, int verify,
+			      int separator)
+{
+	int st;
+
+	if (!w->pid)
+		return print_device_pt(cxt, device, warnme, verify, separator);
+
+	while (waitpid(w->pid, &st, 0) < 0) {
+		if (errno != EINTR) {
+			st = -1;
+			break;
+		}
+	}
+	copy_output(w->out, stdout);
+	if (w->err)
+		copy_output(w->err, stderr);
+
+	return st != -1 && WIFEXITED(st) && WEXITSTATUS(st) == EXIT_SUCCESS ? 0 : -1;
+}
+
+/*
+ * Lists partition tables of the @devices, returns number of the devices
+ * that cannot be listed.
+ */
+int print_devices_pt(struct fdisk_context *cxt, char **devices, size_t ndevices,
+		     int warnme, int verify)
+{
+	struct list_worker workers[MAX_LIST_WORKERS];
+	size_t i, next = 0;
+	int merged, fails = 0;
+
+	if (ndevices == 1)
+		return print_device_pt(cxt, devices[0], warnme, verify, 0) ? 1 : 0;
+
+	merged = stdout_is_stderr();
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 0; i < ndevices; i++) {
+		for (; next < ndevices && next < i + MAX_LIST_WORKERS; next++)
+			start_list_worker(cxt, &workers[next % MAX_LIST_WORKERS],
+					  devices[next], warnme, verify,
+					  next != 0, merged);
+
+		if (finish_list_worker(cxt, &workers[i % MAX_LIST_WORKERS],
+				       devices[i], warnme, verify, i != 0))
+			fails++;
+	}
+	return fails;
+}
+
 void print_all_devices_pt(struct fdisk_context *cxt, int verify)
 {
 	FILE *f = NULL;
-	int sep = 0;
+	char **devs = NULL;
+	size_t i, ndevs = 0;
 	char *dev;
 
 	while ((dev = next_proc_partition(&f))) {
-		print_device_pt(cxt, dev, 0, verify, sep);
-		free(dev);
-		sep = 1;
+		if (ndevs % 32 == 0)
+			devs = xrealloc(devs, (ndevs + 32) * sizeof(char *));
+		devs[ndevs++] = dev;
 	}
+
+	print_devices_pt(cxt, devs, ndevs, 0, verify);
+
+	for (i = 0; i < ndevs; i++)
+		free(devs[i]);
+	free(devs);
 }
 
 void print_all_devices_freespace(struct fdisk_context *cxt)
@@ -8,6 +8,7 @@ extern void list_freespace(struct fdisk_context *cxt);
 
 extern char *next_proc_partition(FILE **f);
 extern int print_device_pt(struct fdisk_context *cxt, char *device, int warnme, int verify, int separator);
+extern int print_devices_pt(struct fdisk_context *cxt, char **devices, size_t ndevices, int warnme, int verify);
 extern int print_device_freespace(struct fdisk_context *cxt, char *device, int warnme, int separator);
 
 extern void print_all_devices_pt(struct fdisk_context *cxt, int verify);
@@ -1090,12 +1090,7 @@ int main(int argc, char **argv)
 		init_fields(cxt, outarg, NULL);
 
 		if (argc > optind) {
-			int k;
-
-			for (rc = 0, k = optind; k < argc; k++)
-				rc += print_device_pt(cxt, argv[k], 1, 0, k != optind);
-
-			if (rc)
+			if (print_devices_pt(cxt, argv + optind, argc - optind, 1, 0))
 				return EXIT_FAILURE;
 		} else
 			print_all_devices_pt(cxt, 0);
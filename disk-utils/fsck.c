@@ -71,6 +71,9 @@
 
 #define FSCK_RUNTIME_DIRNAME	"/run/fsck"
 
+/* the cost of a check on a rotational disk compared to the other devices */
+#define FSCK_ROTATIONAL_WEIGHT	4
+
 static const char *ignored_types[] = {
 	"ignore",
 	"iso9660",
@@ -95,9 +98,12 @@ struct fsck_fs_data
 {
 	const char	*device;
 	dev_t		disk;
+	uint64_t	cost;		/* see fs_get_cost() */
 	unsigned int	stacked:1,
 			done:1,
-			eval_device:1;
+			eval_device:1,
+			eval_cost:1,
+			irrotational:1;
 };
 
 /*
@@ -148,6 +154,7 @@ static FILE *report_stats_file;
 
 static int num_running;
 static int max_running;
+static int max_running_per_disk = 1;
 
 static volatile int cancel_requested;
 static int kill_sent;
@@ -190,14 +197,28 @@ static int fs_check_required(const char *type)
 	return 0;
 }
 
+static const char *fs_get_device(struct libmnt_fs *fs);
+
 static int is_mounted(struct libmnt_fs *fs)
 {
 	int rc;
-	const char *src;
+	const char *src, *dev;
+	struct stat st;
 
 	src = mnt_fs_get_source(fs);
 	if (!src)
 		return 0;
+
+	/* the cached devno set does not need the mount table lookup; note
+	 * that btrfs (and others) use an anonymous devno, so "not mounted"
+	 * has to be verified by the table */
+	dev = fs_get_device(fs);
+	if (dev && stat(dev, &st) == 0 && S_ISBLK(st.st_mode)
+	    && mnt_is_devno_mounted(st.st_rdev) == 1) {
+		rc = 1;
+		goto done;
+	}
+
 	if (!mntcache)
 		mntcache = mnt_new_cache();
 	if (!mtab) {
@@ -209,6 +230,7 @@ static int is_mounted(struct libmnt_fs *fs)
 	}
 
 	rc = mnt_table_find_source(mtab, src, MNT_ITER_BACKWARD) ? 1 : 0;
+done:
 	if (verbose) {
 		if (rc)
 			printf(_("%s is mounted\n"), src);
@@ -286,6 +308,61 @@ static dev_t fs_get_disk(struct libmnt_fs *fs, int check)
 	return 0;
 }
 
+static int is_irrotational_disk(dev_t disk);
+
+/*
+ * Returns the expected cost of the check, that's the size of the device
+ * weighted by the device type. The most expensive filesystems are checked
+ * first to shorten the whole run.
+ */
+static uint64_t fs_get_cost(struct libmnt_fs *fs)
+{
+	struct fsck_fs_data *data = fs_create_data(fs);
+	const char *device;
+	struct stat st;
+
+	if (data->eval_cost)
+		return data->cost;
+	data->eval_cost = 1;
+
+	device = fs_get_device(fs);
+	if (!device || stat(device, &st) != 0)
+		return 0;
+
+	if (S_ISBLK(st.st_mode)) {
+		char path[PATH_MAX];
+		unsigned long long sectors;
+		dev_t disk = fs_get_disk(fs, 1);
+		FILE *f;
+		int rc;
+
+		rc = snprintf(path, sizeof(path), "/sys/dev/block/%d:%d/size",
+				major(st.st_rdev), minor(st.st_rdev));
+		if (rc < 0 || (unsigned int) rc >= sizeof(path))
+			return 0;
+		f = fopen(path, "r" UL_CLOEXECSTR);
+		if (!f)
+			return 0;
+		if (fscanf(f, "%llu", &sectors) == 1)
+			data->cost = sectors << 9;
+		fclose(f);
+
+		data->irrotational = disk && is_irrotational_disk(disk);
+		if (!data->irrotational)
+			data->cost *= FSCK_ROTATIONAL_WEIGHT;
+
+	} else if (S_ISREG(st.st_mode))
+		data->cost = st.st_size;
+
+	return data->cost;
+}
+
+static int fs_is_irrotational(struct libmnt_fs *fs)
+{
+	fs_get_cost(fs);
+	return fs_create_data(fs)->irrotational;
+}
+
 static int fs_is_stacked(struct libmnt_fs *fs)
 {
 	struct fsck_fs_data *data = mnt_fs_get_userdata(fs);
@@ -1214,6 +1291,7 @@ static int disk_already_active(struct libmnt_fs *fs)
 {
 	struct fsck_instance *inst;
 	dev_t disk;
+	int n = 0;
 
 	if (force_all_parallel)
 		return 0;
@@ -1236,10 +1314,16 @@ static int disk_already_active(struct libmnt_fs *fs)
 	for (inst = instance_list; inst; inst = inst->next) {
 		dev_t idisk = fs_get_disk(inst->fs, 0);
 
-		if (!idisk || disk == idisk)
+		if (!idisk)
 			return 1;
+		if (disk == idisk)
+			n++;
 	}
 
+	/* more checks on a non-rotational disk, see FSCK_MAX_INST_PER_DISK */
+	if (n && (n >= max_running_per_disk || !fs_is_irrotational(fs)))
+		return 1;
+
 	return 0;
 }
 
@@ -1311,41 +1395,47 @@ static int check_all(void)
 		not_done_yet = 0;
 		pass_done = 1;
 
-		mnt_reset_iter(itr, MNT_ITER_FORWARD);
+		while (!cancel_requested) {
+			struct libmnt_fs *next = NULL;
 
-		while(mnt_table_next_fs(fstab, itr, &fs) == 0) {
+			mnt_reset_iter(itr, MNT_ITER_FORWARD);
 
-			if (cancel_requested)
-				break;
-			if (fs_is_done(fs))
-				continue;
-			/*
-			 * If the filesystem's pass number is higher
-			 * than the current pass number, then we don't
-			 * do it yet.
-			 */
-			if (mnt_fs_get_passno(fs) > passno) {
-				not_done_yet++;
-				continue;
-			}
-			if (ignore_mounted && is_mounted(fs)) {
-				fs_set_done(fs);
-				continue;
-			}
-			/*
-			 * If a filesystem on a particular device has
-			 * already been spawned, then we need to defer
-			 * this to another pass.
-			 */
-			if (disk_already_active(fs)) {
-				pass_done = 0;
-				continue;
+			while(mnt_table_next_fs(fstab, itr, &fs) == 0) {
+				if (fs_is_done(fs))
+					continue;
+				/*
+				 * If the filesystem's pass number is higher
+				 * than the current pass number, then we don't
+				 * do it yet.
+				 */
+				if (mnt_fs_get_passno(fs) > passno) {
+					not_done_yet++;
+					continue;
+				}
+				if (ignore_mounted && is_mounted(fs)) {
+					fs_set_done(fs);
+					continue;
+				}
+				/*
+				 * If a filesystem on a particular device has
+				 * already been spawned, then we need to defer
+				 * this to another pass.
+				 */
+				if (disk_already_active(fs)) {
+					pass_done = 0;
+					continue;
+				}
+				/* the longest check first */
+				if (!next || fs_get_cost(fs) > fs_get_cost(next))
+					next = fs;
 			}
+			if (!next)
+				break;
 			/*
 			 * Spawn off the fsck process
 			 */
-			status |= fsck_device(fs, serialize);
-			fs_set_done(fs);
+			status |= fsck_device(next, serialize);
+			fs_set_done(next);
 
 			/*
 			 * Only do one filesystem at a time, or if we
@@ -1606,6 +1696,9 @@ static void parse_argv(int argc, char *argv[])
 		force_all_parallel++;
 	if (ul_strtos32(getenv("FSCK_MAX_INST"), &max_running, 10) != 0)
 		max_running = 0;
+	if (ul_strtos32(getenv("FSCK_MAX_INST_PER_DISK"), &max_running_per_disk, 10) != 0
+	    || max_running_per_disk < 1)
+		max_running_per_disk = 1;
 }
 
 int main(int argc, char *argv[])
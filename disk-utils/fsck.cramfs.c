@@ -56,6 +56,10 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 #include "c.h"
 #include "cramfs.h"
 #include "nls.h"
@@ -63,6 +67,7 @@
 #include "exitcodes.h"
 #include "strutils.h"
 #include "closestream.h"
+#include "all-io.h"
 
 #define XALLOC_EXIT_CODE FSCK_EX_ERROR
 #include "xalloc.h"
@@ -99,6 +104,23 @@ static size_t rombufmask = CRAMFS_ROMBUFFERMASK;
 static char *read_buffer;
 static unsigned long read_buffer_block = ~0UL;
 
+/* the ROM image mmap()ed by map_image(), or NULL */
+static char *image;
+static size_t image_size;
+
+static unsigned int nworkers = 1;	/* --workers */
+
+#ifdef HAVE_PTHREAD_H
+/* a regular file for uncompress_parallel() */
+struct uncompress_job {
+	char *path;
+	struct cramfs_inode inode;
+};
+
+static struct uncompress_job *jobs;
+static size_t njobs;
+#endif
+
 static z_stream stream;
 
 /* Prototypes */
@@ -125,6 +147,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -y                       for compatibility only, ignored\n"), out);
 	fputs(_(" -b, --blocksize <size>   use this blocksize, defaults to page size\n"), out);
 	fputs(_("     --extract[=<dir>]    test uncompression, optionally extract into <dir>\n"), out);
+#ifdef HAVE_PTHREAD_H
+	fputs(_("     --workers <num>      uncompress files by <num> threads\n"), out);
+#endif
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(26));
 
@@ -217,6 +242,27 @@ static void test_super(int *start, size_t * length)
 		warnx(_("old cramfs format"));
 }
 
+/*
+ * Maps the whole image read-only. The mapping is followed by zeroed memory,
+ * so romfs_read() is able to return (at least) rombufsize bytes for any
+ * offset within the image, as the buffered version does.
+ */
+static void map_image(size_t length)
+{
+	size_t pad = rombufsize * 2;
+	char *p;
+
+	p = mmap(NULL, length + pad, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return;
+	if (mmap(p, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(p, length + pad);
+		return;
+	}
+	image = p;
+	image_size = length;
+}
+
 static void test_crc(int start)
 {
 	void *buf;
@@ -229,6 +275,18 @@ static void test_crc(int start)
 
 	crc = crc32(0L, NULL, 0);
 
+	if (image) {
+		/* the crc field is calculated as zero */
+		const uint32_t zero = 0;
+		size_t off = start + offsetof(struct cramfs_super, fsid.crc);
+
+		crc = crc32(crc, (unsigned char *) image + start, off - start);
+		crc = crc32(crc, (const unsigned char *) &zero, sizeof(zero));
+		off += sizeof(zero);
+		crc = crc32(crc, (unsigned char *) image + off, super.size - off);
+		goto done;
+	}
+
 	buf =
 	    mmap(NULL, super.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
 	if (buf == MAP_FAILED) {
@@ -279,7 +337,7 @@ static void test_crc(int start)
 		}
 		free(buf);
 	}
-
+done:
 	if (crc != super.fsid.crc)
 		errx(FSCK_EX_UNCORRECTED, _("crc error"));
 }
@@ -306,6 +364,13 @@ static void print_node(char type, struct cramfs_inode *i, char *name)
 static void *romfs_read(unsigned long offset)
 {
 	unsigned int block = offset >> rombufbits;
+
+	if (image && offset < image_size)
+		return image + offset;
+	if (nworkers > 1)
+		/* the buffer below is not thread-safe */
+		errx(FSCK_EX_UNCORRECTED, _("invalid file data offset"));
+
 	if (block != read_buffer_block) {
 		ssize_t x;
 
@@ -356,45 +421,50 @@ static struct cramfs_inode *read_super(void)
 	return root;
 }
 
-static int uncompress_block(void *src, size_t len)
+static int uncompress_block(z_stream *strm, char *out, void *src, size_t len)
 {
 	int err;
 
-	stream.next_in = src;
-	stream.avail_in = len;
+	strm->next_in = src;
+	strm->avail_in = len;
 
-	stream.next_out = (unsigned char *)outbuffer;
-	stream.avail_out = blksize * 2;
+	strm->next_out = (unsigned char *)out;
+	strm->avail_out = blksize * 2;
 
-	inflateReset(&stream);
+	inflateReset(strm);
 
 	if (len > blksize * 2)
 		errx(FSCK_EX_UNCORRECTED, _("data block too large"));
 
-	err = inflate(&stream, Z_FINISH);
+	err = inflate(strm, Z_FINISH);
 	if (err != Z_STREAM_END)
 		errx(FSCK_EX_UNCORRECTED, _("decompression error: %s"),
 		     zError(err));
-	return stream.total_out;
+	return strm->total_out;
 }
 
 #ifndef HAVE_LCHOWN
 #define lchown chown
 #endif
 
-static void do_uncompress(char *path, int outfd, unsigned long offset,
+/*
+ * Uncompresses the file data by @strm to the @out buffer; the end of the
+ * data is tracked in @end.
+ */
+static void do_uncompress(z_stream *strm, char *out, unsigned long *end,
+			  char *path, int outfd, unsigned long offset,
 			  unsigned long size)
 {
 	unsigned long curr = offset + 4 * ((size + blksize - 1) / blksize);
 
 	do {
-		unsigned long out = blksize;
+		unsigned long nbytes = blksize;
 		unsigned long next = u32_toggle_endianness(cramfs_is_big_endian,
 							   *(uint32_t *)
 							   romfs_read(offset));
 
-		if (next > end_data)
-			end_data = next;
+		if (next > *end)
+			*end = next;
 
 		offset += 4;
 		if (curr == next) {
@@ -402,26 +472,27 @@ static void do_uncompress(char *path, int outfd, unsigned long offset,
 				printf(_("  hole at %lu (%zu)\n"), curr,
 				       blksize);
 			if (size < blksize)
-				out = size;
-			memset(outbuffer, 0x00, out);
+				nbytes = size;
+			memset(out, 0x00, nbytes);
 		} else {
 			if (opt_verbose > 1)
 				printf(_("  uncompressing block at %lu to %lu (%lu)\n"),
 				       curr, next, next - curr);
-			out = uncompress_block(romfs_read(curr), next - curr);
+			nbytes = uncompress_block(strm, out, romfs_read(curr),
+						  next - curr);
 		}
 		if (size >= blksize) {
-			if (out != blksize)
+			if (nbytes != blksize)
 				errx(FSCK_EX_UNCORRECTED,
-				     _("non-block (%ld) bytes"), out);
+				     _("non-block (%ld) bytes"), nbytes);
 		} else {
-			if (out != size)
+			if (nbytes != size)
 				errx(FSCK_EX_UNCORRECTED,
-				     _("non-size (%ld vs %ld) bytes"), out,
+				     _("non-size (%ld vs %ld) bytes"), nbytes,
 				     size);
 		}
-		size -= out;
-		if (*extract_dir != '\0' && write(outfd, outbuffer, out) < 0)
+		size -= nbytes;
+		if (*extract_dir != '\0' && write_all(outfd, out, nbytes) != 0)
 			err(FSCK_EX_ERROR, _("write failed: %s"), path);
 		curr = next;
 	} while (size);
@@ -500,10 +571,28 @@ static void do_directory(char *path, struct cramfs_inode *i)
 	free(newpath);
 }
 
+static void extract_file(z_stream *strm, char *out, unsigned long *end,
+			 char *path, struct cramfs_inode *i)
+{
+	int outfd = 0;
+
+	if (*extract_dir != '\0') {
+		outfd = open(path, O_WRONLY | O_CREAT | O_TRUNC, i->mode);
+		if (outfd < 0)
+			err(FSCK_EX_ERROR, _("cannot open %s"), path);
+	}
+	if (i->size)
+		do_uncompress(strm, out, end, path, outfd, i->offset << 2, i->size);
+	if ( *extract_dir != '\0') {
+		if (close_fd(outfd) != 0)
+			err(FSCK_EX_ERROR, _("write failed: %s"), path);
+		change_file_status(path, i);
+	}
+}
+
 static void do_file(char *path, struct cramfs_inode *i)
 {
 	unsigned long offset = i->offset << 2;
-	int outfd = 0;
 
 	if (offset == 0 && i->size != 0)
 		errx(FSCK_EX_UNCORRECTED,
@@ -515,18 +604,19 @@ static void do_file(char *path, struct cramfs_inode *i)
 		start_data = offset;
 	if (opt_verbose)
 		print_node('f', i, path);
-	if (*extract_dir != '\0') {
-		outfd = open(path, O_WRONLY | O_CREAT | O_TRUNC, i->mode);
-		if (outfd < 0)
-			err(FSCK_EX_ERROR, _("cannot open %s"), path);
-	}
-	if (i->size)
-		do_uncompress(path, outfd, offset, i->size);
-	if ( *extract_dir != '\0') {
-		if (close_fd(outfd) != 0)
-			err(FSCK_EX_ERROR, _("write failed: %s"), path);
-		change_file_status(path, i);
+
+#ifdef HAVE_PTHREAD_H
+	if (nworkers > 1) {
+		/* later by uncompress_parallel() */
+		if (njobs % 64 == 0)
+			jobs = xrealloc(jobs, (njobs + 64) * sizeof(*jobs));
+		jobs[njobs].path = xstrdup(path);
+		memcpy(&jobs[njobs].inode, i, sizeof(*i));
+		njobs++;
+		return;
 	}
+#endif
+	extract_file(&stream, outbuffer, &end_data, path, i);
 }
 
 static void do_symlink(char *path, struct cramfs_inode *i)
@@ -548,7 +638,7 @@ static void do_symlink(char *path, struct cramfs_inode *i)
 	if (next > end_data)
 		end_data = next;
 
-	size = uncompress_block(romfs_read(curr), next - curr);
+	size = uncompress_block(&stream, outbuffer, romfs_read(curr), next - curr);
 	if (size != i->size)
 		errx(FSCK_EX_UNCORRECTED, _("size error in symlink: %s"), path);
 	outbuffer[size] = 0;
@@ -622,6 +712,81 @@ static void expand_fs(char *path, struct cramfs_inode *inode)
 		do_special_inode(path, inode);
 }
 
+#ifdef HAVE_PTHREAD_H
+struct uncompress_workers {
+	pthread_mutex_t lock;
+	size_t next;			/* the next job */
+	unsigned long end_data;		/* the end of the data of all the jobs */
+};
+
+static void *uncompress_worker(void *data)
+{
+	struct uncompress_workers *wrk = data;
+	z_stream strm = { .next_in = NULL };
+	char *out = xmalloc(blksize * 2);
+	unsigned long end = 0;
+
+	inflateInit(&strm);
+	for (;;) {
+		struct uncompress_job *job = NULL;
+
+		pthread_mutex_lock(&wrk->lock);
+		if (wrk->next < njobs)
+			job = &jobs[wrk->next++];
+		pthread_mutex_unlock(&wrk->lock);
+		if (!job)
+			break;
+
+		extract_file(&strm, out, &end, job->path, &job->inode);
+	}
+	inflateEnd(&strm);
+	free(out);
+
+	pthread_mutex_lock(&wrk->lock);
+	if (end > wrk->end_data)
+		wrk->end_data = end;
+	pthread_mutex_unlock(&wrk->lock);
+	return NULL;
+}
+
+/*
+ * Uncompresses the regular files found by expand_fs() by --workers threads,
+ * the image is accessed by the mapping (see map_image()) only.
+ */
+static void uncompress_parallel(void)
+{
+	struct uncompress_workers wrk = { .next = 0 };
+	pthread_t *threads;
+	unsigned int n;
+	size_t i;
+
+	threads = xcalloc(nworkers, sizeof(pthread_t));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (n = 0; n < nworkers; n++) {
+		if (pthread_create(&threads[n], NULL, uncompress_worker, &wrk) != 0)
+			break;
+	}
+	if (!n)
+		uncompress_worker(&wrk);	/* no thread, do it ourselves */
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	if (wrk.end_data > end_data)
+		end_data = wrk.end_data;
+
+	for (i = 0; i < njobs; i++)
+		free(jobs[i].path);
+	free(jobs);
+	jobs = NULL;
+	njobs = 0;
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+}
+#endif /* HAVE_PTHREAD_H */
+
 static void test_fs(int start)
 {
 	struct cramfs_inode *root;
@@ -634,6 +799,10 @@ static void test_fs(int start)
 	inflateInit(&stream);
 	expand_fs(extract_dir, root);
 	inflateEnd(&stream);
+#ifdef HAVE_PTHREAD_H
+	if (njobs)
+		uncompress_parallel();
+#endif
 	if (start_data != ~0UL) {
 		if (start_data < (sizeof(struct cramfs_super) + start))
 			errx(FSCK_EX_UNCORRECTED,
@@ -655,6 +824,9 @@ int main(int argc, char **argv)
 	int c;			/* for getopt */
 	int start = 0;
 	size_t length = 0;
+	enum {
+		OPT_WORKERS = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 		{"verbose",   no_argument,       NULL, 'v'},
@@ -662,6 +834,7 @@ int main(int argc, char **argv)
 		{"help",      no_argument,       NULL, 'h'},
 		{"blocksize", required_argument, NULL, 'b'},
 		{"extract",   optional_argument, NULL, 'x'},
+		{"workers",   required_argument, NULL, OPT_WORKERS},
 		{NULL, 0, NULL, 0},
 	};
 
@@ -695,6 +868,9 @@ int main(int argc, char **argv)
 		case 'b':
 			blksize = strtou32_or_err(optarg, _("invalid blocksize argument"));
 			break;
+		case OPT_WORKERS:
+			nworkers = strtou32_or_err(optarg, _("invalid workers argument"));
+			break;
 		default:
 			errtryhelp(FSCK_EX_USAGE);
 		}
@@ -706,7 +882,6 @@ int main(int argc, char **argv)
 	filename = argv[optind];
 
 	test_super(&start, &length);
-	test_crc(start);
 
 	if (opt_extract) {
 		size_t bufsize = 0;
@@ -720,7 +895,17 @@ int main(int argc, char **argv)
 		while (bufsize >>= 1)
 			rombufbits++;
 		rombufmask = rombufsize - 1;
+	}
+
+	map_image(length);
+	/* the threads use the mapping, see romfs_read(); the verbose
+	 * per-block output would be garbled by the threads */
+	if (!image || opt_verbose > 1)
+		nworkers = 1;
 
+	test_crc(start);
+
+	if (opt_extract) {
 		outbuffer = xmalloc(blksize * 2);
 		read_buffer = xmalloc(rombufsize * 2);
 		test_fs(start);
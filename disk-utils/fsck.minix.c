@@ -357,13 +357,8 @@ read_block(unsigned int nr, char *addr) {
 		memset(addr, 0, MINIX_BLOCK_SIZE);
 		return;
 	}
-	if (MINIX_BLOCK_SIZE * nr != lseek(device_fd, MINIX_BLOCK_SIZE * nr, SEEK_SET)) {
-		get_current_name();
-		printf(_("Read error: unable to seek to block in file '%s'\n"),
-		       current_name);
-		memset(addr, 0, MINIX_BLOCK_SIZE);
-		errors_uncorrected = 1;
-	} else if (MINIX_BLOCK_SIZE != read(device_fd, addr, MINIX_BLOCK_SIZE)) {
+	if (MINIX_BLOCK_SIZE != pread(device_fd, addr, MINIX_BLOCK_SIZE,
+				      (off_t) MINIX_BLOCK_SIZE * nr)) {
 		get_current_name();
 		printf(_("Read error: bad block in file '%s'\n"), current_name);
 		memset(addr, 0, MINIX_BLOCK_SIZE);
@@ -382,9 +377,8 @@ write_block(unsigned int nr, char *addr) {
 		errors_uncorrected = 1;
 		return;
 	}
-	if (MINIX_BLOCK_SIZE * nr != lseek(device_fd, MINIX_BLOCK_SIZE * nr, SEEK_SET))
-		die(_("seek failed in write_block"));
-	if (MINIX_BLOCK_SIZE != write(device_fd, addr, MINIX_BLOCK_SIZE)) {
+	if (MINIX_BLOCK_SIZE != pwrite(device_fd, addr, MINIX_BLOCK_SIZE,
+				       (off_t) MINIX_BLOCK_SIZE * nr)) {
 		get_current_name();
 		printf(_("Write error: bad block in file '%s'\n"),
 		       current_name);
@@ -1130,9 +1124,8 @@ static int
 bad_zone(int i) {
 	char buffer[1024];
 
-	if (MINIX_BLOCK_SIZE * i != lseek(device_fd, MINIX_BLOCK_SIZE * i, SEEK_SET))
-		die(_("seek failed in bad_zone"));
-	return (MINIX_BLOCK_SIZE != read(device_fd, buffer, MINIX_BLOCK_SIZE));
+	return (MINIX_BLOCK_SIZE != pread(device_fd, buffer, MINIX_BLOCK_SIZE,
+					  (off_t) MINIX_BLOCK_SIZE * i));
 }
 
 static void
@@ -1,7 +1,11 @@
 #ifndef UTIL_LINUX_MINIX_PROGRAMS_H
 #define UTIL_LINUX_MINIX_PROGRAMS_H
 
+#include <stdint.h>
+#include <string.h>
+
 #include "minix.h"
+#include "bitops.h"
 
 /*
  * Global variables.
@@ -115,4 +119,69 @@ static inline size_t get_inode_buffer_size(void)
 	return inode_blocks() * MINIX_BLOCK_SIZE;
 }
 
+/*
+ * Bitmap scanning. The inode and zone maps are arrays of bytes with bit N in
+ * (1 << (N % 8)) of byte N / 8, so 64 bits read as a little-endian word are
+ * in the same order as in the map.
+ */
+static inline uint64_t minix_map_word(const char *map, unsigned long bit)
+{
+	uint64_t w;
+
+	memcpy(&w, map + bit / NBBY, sizeof(w));
+	return le64toh(w);
+}
+
+static inline unsigned int minix_word_ctz(uint64_t w)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(w);
+#else
+	unsigned int n = 0;
+
+	while (!(w & 1)) {
+		w >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/* returns the first bit in [bit, end) set to @value, or @end */
+static inline unsigned long minix_find_bit(const char *map, unsigned long bit,
+					   unsigned long end, int value)
+{
+	for (; bit < end && bit % 64; bit++)
+		if (!isset(map, bit) == !value)
+			return bit;
+
+	for (; bit + 64 <= end; bit += 64) {
+		uint64_t w = minix_map_word(map, bit);
+
+		if (!value)
+			w = ~w;
+		if (w)
+			return bit + minix_word_ctz(w);
+	}
+
+	for (; bit < end; bit++)
+		if (!isset(map, bit) == !value)
+			return bit;
+	return end;
+}
+
+/* clears bits in [bit, end) */
+static inline void minix_clear_bits(char *map, unsigned long bit,
+				    unsigned long end)
+{
+	for (; bit < end && bit % NBBY; bit++)
+		clrbit(map, bit);
+	if (bit + NBBY <= end) {
+		memset(map + bit / NBBY, 0, (end - bit) / NBBY);
+		bit += (end - bit) / NBBY * NBBY;
+	}
+	for (; bit < end; bit++)
+		clrbit(map, bit);
+}
+
 #endif				/* UTIL_LINUX_MINIX_PROGRAMS_H */
@@ -37,6 +37,10 @@
 #include <getopt.h>
 #include <zconf.h>
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 /* We don't use our include/crc32.h, but crc32 from zlib!
  *
  * The zlib implementation performs pre/post-conditioning. The util-linux
@@ -92,6 +96,7 @@ static int warn_uid = 0;
 /* entry.flags */
 #define CRAMFS_EFLAG_MD5	1
 #define CRAMFS_EFLAG_INVALID	2
+#define CRAMFS_EFLAG_COMPRESSED	4	/* cdata prepared by compress_files() */
 
 /* In-core version of inode / directory entry. */
 struct entry {
@@ -107,6 +112,8 @@ struct entry {
 	struct entry *same;	    /* points to other identical file */
 	unsigned int offset;        /* pointer to compressed data in archive */
 	unsigned int dir_offset;    /* offset of directory entry in archive */
+	char *cdata;		    /* compressed data, see compress_files() */
+	unsigned long clen;
 
 	/* organization */
 	struct entry *child;	    /* NULL for non-directory and empty dir */
@@ -125,7 +132,7 @@ struct entry {
 static void __attribute__((__noreturn__)) usage(void)
 {
 	fputs(USAGE_HEADER, stdout);
-	printf(_(" %s [-h] [-v] [-b blksize] [-e edition] [-N endian] [-i file] [-n name] dirname outfile\n"),
+	printf(_(" %s [-h] [-v] [-b blksize] [-e edition] [-N endian] [-i file] [-n name] [-j workers] dirname outfile\n"),
 		program_invocation_short_name);
 	fputs(USAGE_SEPARATOR, stdout);
 	puts(_("Make compressed ROM file system."));
@@ -137,6 +144,9 @@ static void __attribute__((__noreturn__)) usage(void)
 	printf(_(" -N endian      set cramfs endianness (%s|%s|%s), default %s\n"), "big", "little", "host", "host");
 	puts(_(  " -i file        insert a file image into the filesystem"));
 	puts(_(  " -n name        set name of cramfs filesystem"));
+#ifdef HAVE_PTHREAD_H
+	puts(_(  " -j workers     compress files by this number of threads"));
+#endif
 	printf(_(" -p             pad by %d bytes for boot code\n"), PAD_SIZE);
 	puts(_(  " -s             sort directory entries (old option, ignored)"));
 	puts(_(  " -z             make explicit holes"));
@@ -561,30 +571,29 @@ static int is_zero(unsigned char const *begin, unsigned len)
  * so the i'th pointer points to the end of the i'th block
  * (i.e. the start of the (i+1)'th block or past EOF).
  *
- * Note that size > 0, as a zero-sized file wouldn't ever
- * have gotten here in the first place.
+ * The data are written to @out, the pointers are relative to @out and in
+ * host byte order, see do_compress(). The output needs at most
+ * 4 * blocks + 2 * blksize * blocks bytes.
+ *
+ * Returns the size of the output, or 0 if the file cannot be read.
  */
-static unsigned int
-do_compress(char *base, unsigned int offset, unsigned char const *name,
-	    char *path, unsigned int size, unsigned int mode)
+static unsigned long
+compress_blocks(char *out, char *path, unsigned int size, unsigned int mode)
 {
-	unsigned long original_size, original_offset, new_size, blocks, curr;
-	long change;
+	unsigned long original_size, blocks, curr;
 	char *start;
 	Bytef *p;
+	uint32_t *ptr = (uint32_t *) out;
 
 	/* get uncompressed data */
 	start = do_mmap(path, size, mode);
 	if (start == NULL)
-		return offset;
+		return 0;
 	p = (Bytef *) start;
 
 	original_size = size;
-	original_offset = offset;
 	blocks = (size - 1) / blksize + 1;
-	curr = offset + 4 * blocks;
-
-	total_blocks += blocks;
+	curr = 4 * blocks;
 
 	do {
 		uLongf len = 2 * blksize;
@@ -593,7 +602,7 @@ do_compress(char *base, unsigned int offset, unsigned char const *name,
 			input = blksize;
 		size -= input;
 		if (!is_zero (p, input)) {
-			compress((Bytef *)(base + curr), &len, p, input);
+			compress((Bytef *)(out + curr), &len, p, input);
 			curr += len;
 		}
 		p += input;
@@ -606,25 +615,147 @@ do_compress(char *base, unsigned int offset, unsigned char const *name,
 			exit(MKFS_EX_ERROR);
 		}
 
-		*(uint32_t *) (base + offset) = u32_toggle_endianness(cramfs_is_big_endian, curr);
-		offset += 4;
+		*ptr++ = curr;
 	} while (size);
 
 	do_munmap(start, original_size, mode);
+	return curr;
+}
+
+/*
+ * Note that size > 0, as a zero-sized file wouldn't ever
+ * have gotten here in the first place.
+ */
+static unsigned int
+do_compress(char *base, unsigned int offset, struct entry *e)
+{
+	unsigned long new_size, blocks, curr, i;
+	uint32_t *ptr = (uint32_t *) (base + offset);
+	long change;
 
-	curr = (curr + 3) & ~3;
-	new_size = curr - original_offset;
+	if (e->flags & CRAMFS_EFLAG_COMPRESSED) {
+		/* already done by compress_files() */
+		if (!e->cdata)
+			return offset;
+		memcpy(base + offset, e->cdata, e->clen);
+		curr = e->clen;
+		free(e->cdata);
+		e->cdata = NULL;
+	} else {
+		curr = compress_blocks(base + offset, e->path, e->size, e->mode);
+		if (!curr)
+			return offset;
+	}
+
+	blocks = (e->size - 1) / blksize + 1;
+	total_blocks += blocks;
+
+	for (i = 0; i < blocks; i++)
+		ptr[i] = u32_toggle_endianness(cramfs_is_big_endian, offset + ptr[i]);
+
+	curr = (offset + curr + 3) & ~3;
+	new_size = curr - offset;
 	/* TODO: Arguably, original_size in these 2 lines should be
 	   st_blocks * 512.  But if you say that, then perhaps
 	   administrative data should also be included in both. */
-	change = new_size - original_size;
+	change = new_size - e->size;
 	if (verbose)
 		printf(_("%6.2f%% (%+ld bytes)\t%s\n"),
-		       (change * 100) / (double) original_size, change, name);
+		       (change * 100) / (double) e->size, change, e->name);
 
 	return curr;
 }
 
+#ifdef HAVE_PTHREAD_H
+struct compress_workers {
+	pthread_mutex_t lock;
+	struct entry **files;
+	size_t nfiles;
+	size_t next;		/* the next file to compress */
+};
+
+static void *compress_worker(void *data)
+{
+	struct compress_workers *wrk = data;
+
+	for (;;) {
+		struct entry *e = NULL;
+		unsigned long blocks, len;
+		char *out;
+
+		pthread_mutex_lock(&wrk->lock);
+		if (wrk->next < wrk->nfiles)
+			e = wrk->files[wrk->next++];
+		pthread_mutex_unlock(&wrk->lock);
+		if (!e)
+			break;
+
+		blocks = (e->size - 1) / blksize + 1;
+		out = xmalloc(4 * blocks + 2 * blksize * blocks);
+		len = compress_blocks(out, e->path, e->size, e->mode);
+		if (len) {
+			e->cdata = xrealloc(out, len);
+			e->clen = len;
+		} else
+			free(out);
+	}
+	return NULL;
+}
+
+/* the files in the order of write_data() */
+static void collect_files(struct entry *entry, struct compress_workers *wrk)
+{
+	struct entry *e;
+
+	for (e = entry; e; e = e->next) {
+		if (e->path) {
+			if (!e->same && e->size) {
+				if (wrk->nfiles % 64 == 0)
+					wrk->files = xrealloc(wrk->files,
+						(wrk->nfiles + 64) * sizeof(struct entry *));
+				wrk->files[wrk->nfiles++] = e;
+			}
+		} else if (e->child)
+			collect_files(e->child, wrk);
+	}
+}
+
+/*
+ * Compresses the files by @nworkers threads in advance, write_data() only
+ * copies the compressed data to the image. The layout of the image is the
+ * same as without the threads.
+ */
+static void compress_files(struct entry *root, unsigned int nworkers)
+{
+	struct compress_workers wrk = { .nfiles = 0 };
+	pthread_t *threads;
+	unsigned int i, n;
+
+	collect_files(root, &wrk);
+	if (!wrk.nfiles)
+		return;
+
+	threads = xcalloc(nworkers, sizeof(pthread_t));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (n = 0; n < nworkers; n++) {
+		if (pthread_create(&threads[n], NULL, compress_worker, &wrk) != 0)
+			break;
+	}
+	if (!n)
+		compress_worker(&wrk);	/* no thread, do it ourselves */
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < wrk.nfiles; i++)
+		wrk.files[i]->flags |= CRAMFS_EFLAG_COMPRESSED;
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+	free(wrk.files);
+}
+#endif /* HAVE_PTHREAD_H */
 
 /*
  * Traverse the entry tree, writing data for every item that has
@@ -643,8 +774,7 @@ write_data(struct entry *entry, char *base, unsigned int offset) {
 			} else if (e->size) {
 				set_data_offset(e, base, offset);
 				e->offset = offset;
-				offset = do_compress(base, offset, e->name,
-						     e->path, e->size,e->mode);
+				offset = do_compress(base, offset, e);
 			}
 		} else if (e->child)
 			offset = write_data(e->child, base, offset);
@@ -708,6 +838,7 @@ int main(int argc, char **argv)
 	unsigned int fslen_max;
 	char const *dirname, *outfile;
 	uint32_t crc = crc32(0L, NULL, 0);
+	unsigned int nworkers = 1;
 	int c;
 	cramfs_is_big_endian = HOST_IS_BIG_ENDIAN; /* default is to use host order */
 
@@ -730,7 +861,7 @@ int main(int argc, char **argv)
 	strutils_set_exitcode(MKFS_EX_USAGE);
 
 	/* command line options */
-	while ((c = getopt(argc, argv, "hb:Ee:i:n:N:psVvz")) != EOF) {
+	while ((c = getopt(argc, argv, "hb:Ee:i:j:n:N:psVvz")) != EOF) {
 		switch (c) {
 		case 'h':
 			usage();
@@ -761,6 +892,9 @@ int main(int argc, char **argv)
 			image_length = st.st_size; /* may be padded later */
 			fslen_ub += (image_length + 3); /* 3 is for padding */
 			break;
+		case 'j':
+			nworkers = strtou32_or_err(optarg, _("invalid workers argument"));
+			break;
 		case 'n':
 			opt_name = optarg;
 			break;
@@ -860,6 +994,10 @@ int main(int argc, char **argv)
 	if (verbose)
 		printf(_("Directory data: %zd bytes\n"), offset);
 
+#ifdef HAVE_PTHREAD_H
+	if (nworkers > 1)
+		compress_files(root_entry, nworkers);
+#endif
 	offset = write_data(root_entry, rom_image, offset);
 
 	/* We always write a multiple of blksize bytes, so that
@@ -228,8 +228,9 @@ static int get_free_block(struct fs_control *ctl) {
 		blk = good_blocks_table[ctl->fs_used_blocks - 1] + 1;
 	else
 		blk = first_zone;
-	while (blk < zones && zone_in_use(blk))
-		blk++;
+	if (blk < zones)
+		blk = minix_find_bit(zone_map, blk - first_zone + 1,
+				     zones - first_zone + 1, 0) + first_zone - 1;
 	if (blk >= zones)
 		errx(MKFS_EX_ERROR, _("%s: not enough good blocks"), ctl->device_name);
 	good_blocks_table[ctl->fs_used_blocks] = blk;
@@ -250,10 +251,11 @@ static inline int next(unsigned long zone) {
 
 	if (!zone)
 		zone = first_zone-1;
-	while (++zone < zones)
-		if (zone_in_use(zone))
-			return zone;
-	return 0;
+	if (++zone >= zones)
+		return 0;
+	zone = minix_find_bit(zone_map, zone - first_zone + 1,
+			      zones - first_zone + 1, 1) + first_zone - 1;
+	return zone < zones ? zone : 0;
 }
 
 static void make_bad_inode_v1(struct fs_control *ctl)
@@ -497,7 +499,7 @@ static void super_set_magic(const struct fs_control *ctl)
 }
 
 static void setup_tables(const struct fs_control *ctl) {
-	unsigned long inodes, zmaps, imaps, zones, i;
+	unsigned long inodes, zmaps, imaps, zones;
 
 	super_block_buffer = xcalloc(1, MINIX_BLOCK_SIZE);
 
@@ -558,10 +560,8 @@ static void setup_tables(const struct fs_control *ctl) {
 	memset(inode_map,0xff,imaps * MINIX_BLOCK_SIZE);
 	memset(zone_map,0xff,zmaps * MINIX_BLOCK_SIZE);
 
-	for (i = get_first_zone() ; i<zones ; i++)
-		unmark_zone(i);
-	for (i = MINIX_ROOT_INO ; i<=inodes; i++)
-		unmark_inode(i);
+	minix_clear_bits(zone_map, 1, zones - get_first_zone() + 1);
+	minix_clear_bits(inode_map, MINIX_ROOT_INO, inodes + 1);
 
 	inode_buffer = xmalloc(get_inode_buffer_size());
 	memset(inode_buffer,0, get_inode_buffer_size());
@@ -54,6 +54,9 @@
 
 #define SELINUX_SWAPFILE_TYPE	"swapfile_t"
 
+/* size of one read() of --check */
+#define CHECK_CHUNK_SIZE	(8 * 1024 * 1024)
+
 struct mkswap_control {
 	struct swap_header_v1_2	*hdr;		/* swap header */
 	void			*signature_page;/* buffer with swap header */
@@ -191,34 +194,73 @@ static void page_bad(struct mkswap_control *ctl, unsigned int page)
 	ctl->nbadpages++;
 }
 
+/*
+ * Reads @npages pages from @page, the range is bisected on error to find the
+ * bad pages. The O_DIRECT *fd is replaced by the regular descriptor if the
+ * device does not accept the alignment.
+ */
+static void check_range(struct mkswap_control *ctl, int *fd, char *buffer,
+			unsigned long long page, size_t npages)
+{
+	while (npages) {
+		size_t sz = npages * ctl->pagesize;
+		ssize_t rc = pread(*fd, buffer, sz, (off_t) page * ctl->pagesize);
+
+		if (rc < 0 && errno == EINVAL && *fd != ctl->fd) {
+			close(*fd);
+			*fd = ctl->fd;
+			continue;
+		}
+		if (rc == (ssize_t) sz)
+			return;
+		if (rc >= ctl->pagesize) {
+			/* short read; the pages in front of the problem are fine */
+			page += rc / ctl->pagesize;
+			npages -= rc / ctl->pagesize;
+			continue;
+		}
+		if (npages == 1) {
+			page_bad(ctl, page);
+			return;
+		}
+		check_range(ctl, fd, buffer, page, npages / 2);
+		page += npages / 2;
+		npages -= npages / 2;
+	}
+}
+
 static void check_blocks(struct mkswap_control *ctl)
 {
-	unsigned int current_page = 0;
-	int do_seek = 1;
+	unsigned long long current_page = 0;
+	size_t chunk_pages = max(CHECK_CHUNK_SIZE / ctl->pagesize, 1);
 	char *buffer;
+	int fd;
 
 	assert(ctl);
 	assert(ctl->fd > -1);
 
-	buffer = xmalloc(ctl->pagesize);
-	while (current_page < ctl->npages) {
-		ssize_t rc;
-		off_t offset = (off_t) current_page * ctl->pagesize;
+	/* bypass the page cache, it's about the device, not about the cache */
+	fd = open(ctl->devname, O_RDONLY | O_DIRECT | O_CLOEXEC);
+	if (fd < 0)
+		fd = ctl->fd;
+
+	if (posix_memalign((void **) &buffer, max(ctl->pagesize, getpagesize()),
+			   chunk_pages * ctl->pagesize) != 0)
+		err(EXIT_FAILURE, _("cannot allocate memory"));
 
-		if (do_seek && lseek(ctl->fd, offset, SEEK_SET) != offset)
-			errx(EXIT_FAILURE, _("seek failed in check_blocks"));
+	while (current_page < ctl->npages) {
+		size_t n = min((unsigned long long) chunk_pages,
+			       ctl->npages - current_page);
 
-		rc = read(ctl->fd, buffer, ctl->pagesize);
-		do_seek = (rc < 0 || rc != ctl->pagesize);
-		if (do_seek)
-			page_bad(ctl, current_page);
-		current_page++;
+		check_range(ctl, &fd, buffer, current_page, n);
+		current_page += n;
 	}
 	printf(P_("%lu bad page\n", "%lu bad pages\n", ctl->nbadpages), ctl->nbadpages);
+	if (fd != ctl->fd)
+		close(fd);
 	free(buffer);
 }
 
-
 #ifdef HAVE_LINUX_FIEMAP_H
 static void warn_extent(struct mkswap_control *ctl, const char *msg, uint64_t off)
 {
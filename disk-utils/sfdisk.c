@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <getopt.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <assert.h>
 #include <fcntl.h>
 #include <libsmartcols.h>
@@ -51,6 +52,7 @@
 #include "rpmatch.h"
 #include "optutils.h"
 #include "ttyutils.h"
+#include "fileutils.h"
 
 #include "libfdisk.h"
 #include "fdisk-list.h"
@@ -88,7 +90,8 @@ enum {
 	ACT_PARTLABEL,
 	ACT_PARTATTRS,
 	ACT_DISKID,
-	ACT_DELETE
+	ACT_DELETE,
+	ACT_BULK
 };
 
 struct sfdisk {
@@ -102,6 +105,7 @@ struct sfdisk {
 	const char	*backup_file;	/* -O <path> */
 	const char	*move_typescript; /* --movedata <typescript> */
 	char		*prompt;
+	unsigned int	nworkers;	/* --bulk --workers <num> */
 
 	struct fdisk_context	*cxt;		/* libfdisk context */
 	struct fdisk_partition  *orig_pa;	/* -N <partno> before the change */
@@ -683,13 +687,9 @@ static int command_list_partitions(struct sfdisk *sf, int argc, char **argv)
 	int fail = 0;
 	fdisk_enable_listonly(sf->cxt, 1);
 
-	if (argc) {
-		int i;
-
-		for (i = 0; i < argc; i++)
-			if (print_device_pt(sf->cxt, argv[i], 1, sf->verify, i) != 0)
-				fail++;
-	} else
+	if (argc)
+		fail = print_devices_pt(sf->cxt, argv, argc, 1, sf->verify);
+	else
 		print_all_devices_pt(sf->cxt, sf->verify);
 
 	return fail;
@@ -2006,6 +2006,128 @@ static int command_fdisk(struct sfdisk *sf, int argc, char **argv)
 	return rc;
 }
 
+/* one device of the --bulk command */
+struct bulk_job {
+	const char	*devname;
+	pid_t		pid;		/* 0 = not started yet, -1 = done */
+	FILE		*in;		/* private copy of the script */
+	FILE		*out;		/* stdout and stderr of the child */
+};
+
+static void bulk_print_job(struct bulk_job *job)
+{
+	fflush(stdout);
+	if (lseek(fileno(job->out), 0, SEEK_SET) == 0)
+		ul_copy_file(fileno(job->out), STDOUT_FILENO);
+	fclose(job->out);
+	job->out = NULL;
+}
+
+/*
+ * sfdisk --bulk <device> ...
+ *
+ * The script is read from stdin once and applied to all the devices; every
+ * device is partitioned by command_fdisk() in a separate process, up to
+ * --workers at a time. The output is printed in the order of the devices.
+ */
+static int command_bulk(struct sfdisk *sf, int argc, char **argv)
+{
+	struct bulk_job *jobs;
+	FILE *script;
+	unsigned int running = 0;
+	int i, next = 0, printed = 0, fail = 0;
+
+	if (!argc)
+		errx(EXIT_FAILURE, _("no disk device specified"));
+
+	script = tmpfile();
+	if (!script)
+		err(EXIT_FAILURE, _("cannot create temporary file"));
+	if (ul_copy_file(STDIN_FILENO, fileno(script)) != 0)
+		err(EXIT_FAILURE, _("cannot read script"));
+
+	if (!sf->nworkers || sf->nworkers > (unsigned int) argc)
+		sf->nworkers = argc;
+	sf->interactive = 0;
+
+	jobs = xcalloc(argc, sizeof(struct bulk_job));
+	for (i = 0; i < argc; i++)
+		jobs[i].devname = argv[i];
+
+	fflush(stdout);
+	fflush(stderr);
+
+	while (printed < argc) {
+		pid_t pid;
+		int status;
+
+		if (next < argc && running < sf->nworkers) {
+			struct bulk_job *job = &jobs[next++];
+
+			/* the children must not share the file offset of the script */
+			job->in = tmpfile();
+			job->out = tmpfile();
+			if (!job->in || !job->out)
+				err(EXIT_FAILURE, _("cannot create temporary file"));
+			if (lseek(fileno(script), 0, SEEK_SET) != 0
+			    || ul_copy_file(fileno(script), fileno(job->in)) != 0)
+				err(EXIT_FAILURE, _("cannot read script"));
+
+			pid = fork();
+			if (pid < 0)
+				err(EXIT_FAILURE, _("fork failed"));
+			if (pid == 0) {
+				char *dev = (char *) job->devname;
+				int fd = fileno(job->out);
+
+				/* every child reads the script from the beginning */
+				if (dup2(fd, STDOUT_FILENO) < 0
+				    || dup2(fd, STDERR_FILENO) < 0
+				    || dup2(fileno(job->in), STDIN_FILENO) < 0
+				    || lseek(STDIN_FILENO, 0, SEEK_SET) < 0)
+					err(EXIT_FAILURE, _("%s: failed to read script"), dev);
+				setvbuf(stdout, NULL, _IONBF, 0);
+				clearerr(stdin);
+
+				exit(command_fdisk(sf, 1, &dev) == 0 ?
+						EXIT_SUCCESS : EXIT_FAILURE);
+			}
+			fclose(job->in);
+			job->in = NULL;
+			job->pid = pid;
+			running++;
+			continue;
+		}
+
+		pid = wait(&status);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, _("waitpid failed"));
+		}
+		for (i = 0; i < argc; i++) {
+			if (jobs[i].pid != pid)
+				continue;
+			jobs[i].pid = -1;
+			if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				fail++;
+			running--;
+			break;
+		}
+
+		/* print the finished devices in the order of the command line */
+		while (printed < argc && jobs[printed].pid == -1)
+			bulk_print_job(&jobs[printed++]);
+	}
+
+	if (fail)
+		warnx(P_("%d device failed", "%d devices failed", fail), fail);
+
+	fclose(script);
+	free(jobs);
+	return fail ? -1 : 0;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -2030,6 +2152,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -T, --list-types                  print the recognized types (see -X)\n"), out);
 	fputs(_(" -V, --verify [<dev> ...]          test whether partitions seem correct\n"), out);
 	fputs(_("     --delete <dev> [<part> ...]   delete all or specified partitions\n"), out);
+	fputs(_("     --bulk <dev> ...              apply the script from stdin to all the devices\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_(" --part-label <dev> <part> [<str>] print or change partition label\n"), out);
@@ -2067,6 +2190,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -O, --backup-file <path>  override default backup file name\n"), out);
 	fputs(_(" -o, --output <list>       output columns\n"), out);
 	fputs(_(" -q, --quiet               suppress extra info messages\n"), out);
+	fputs(_("     --workers <num>       partition <num> devices at a time (--bulk)\n"), out);
 	fprintf(out,
 	      _(" -w, --wipe <mode>         wipe signatures (%s, %s or %s)\n"), "auto", "always", "never");
 	fprintf(out,
@@ -2119,6 +2243,8 @@ int main(int argc, char *argv[])
 		OPT_NOTELL,
 		OPT_RELOCATE,
 		OPT_LOCK,
+		OPT_BULK,
+		OPT_WORKERS,
 	};
 
 	static const struct option longopts[] = {
@@ -2130,6 +2256,8 @@ int main(int argc, char *argv[])
 		{ "color",   optional_argument, NULL, OPT_COLOR },
 		{ "lock",    optional_argument, NULL, OPT_LOCK },
 		{ "delete",  no_argument,	NULL, OPT_DELETE },
+		{ "bulk",    no_argument,	NULL, OPT_BULK },
+		{ "workers", required_argument, NULL, OPT_WORKERS },
 		{ "dump",    no_argument,	NULL, 'd' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "force",   no_argument,       NULL, 'f' },
@@ -2329,6 +2457,12 @@ int main(int argc, char *argv[])
 		case OPT_DELETE:
 			sf->act = ACT_DELETE;
 			break;
+		case OPT_BULK:
+			sf->act = ACT_BULK;
+			break;
+		case OPT_WORKERS:
+			sf->nworkers = strtou32_or_err(optarg, _("invalid workers argument"));
+			break;
 		case OPT_NOTELL:
 			sf->notell = 1;
 			break;
@@ -2390,6 +2524,10 @@ int main(int argc, char *argv[])
 		rc = command_fdisk(sf, argc - optind, argv + optind);
 		break;
 
+	case ACT_BULK:
+		rc = command_bulk(sf, argc - optind, argv + optind);
+		break;
+
 	case ACT_DUMP:
 		rc = command_dump(sf, argc - optind, argv + optind);
 		break;
@@ -13,8 +13,10 @@ struct ul_buffer {
 	char *encoded;		/* encoded data (from mbs_safe_encode_to_buffer)) */
 	size_t encoded_sz;	/* space allocated for encoded data */
 
-	char **ptrs;		/* saved pointers */
+	size_t *ptrs;		/* saved pointers (offset + 1, 0 if unset) */
 	size_t nptrs;		/* number of saved pointers */
+
+	unsigned int storage : 1;	/* data in caller's memory, see ul_buffer_set_storage() */
 };
 
 #define UL_INIT_BUFFER { .begin = NULL }
@@ -23,6 +25,7 @@ void ul_buffer_reset_data(struct ul_buffer *buf);
 void ul_buffer_free_data(struct ul_buffer *buf);
 int ul_buffer_is_empty(struct ul_buffer *buf);
 void ul_buffer_set_chunksize(struct ul_buffer *buf, size_t sz);
+void ul_buffer_set_storage(struct ul_buffer *buf, char *mem, size_t sz);
 void ul_buffer_refer_string(struct ul_buffer *buf, char *str);
 int ul_buffer_alloc_data(struct ul_buffer *buf, size_t sz);
 int ul_buffer_append_data(struct ul_buffer *buf, const char *data, size_t sz);
@@ -17,6 +17,8 @@
 
 extern char *canonicalize_path(const char *path);
 extern char *canonicalize_path_restricted(const char *path);
+extern char *canonicalize_path_in_dir(const char *dir, const char *name);
+extern char *canonicalize_path_cached(const char *path);
 extern char *canonicalize_dm_name(const char *ptname);
 extern char *__canonicalize_dm_name(const char *prefix, const char *ptname);
 
@@ -28,24 +28,58 @@ static inline int fputc_careful(int c, FILE *fp, const char fail)
 	return (ret < 0) ? EOF : 0;
 }
 
+static inline int fputs_quoted_is_special(unsigned char c)
+{
+	return c == 0x22 ||		/* " */
+	       c == 0x5c ||		/* \ */
+	       c == 0x60 ||		/* ` */
+	       c == 0x24 ||		/* $ */
+	       !isprint(c) || iscntrl(c);
+}
+
+static inline int fputs_nonblank_is_special(unsigned char c)
+{
+	return isblank(c) ||
+	       c == 0x5c ||		/* \ */
+	       !isprint(c) || iscntrl(c);
+}
+
+static inline int fputs_case_convert(int c, int dir)
+{
+	return dir ==  1 ? toupper(c) :
+	       dir == -1 ? tolower(c) : c;
+}
+
+/*
+ * The characters which are written as they are, are written at once by one
+ * fwrite() for the whole run rather than by fputc() for each char.
+ */
 static inline void fputs_quoted_case(const char *data, FILE *out, int dir)
 {
 	const char *p;
 
 	fputc('"', out);
 	for (p = data; p && *p; p++) {
-		if ((unsigned char) *p == 0x22 ||		/* " */
-		    (unsigned char) *p == 0x5c ||		/* \ */
-		    (unsigned char) *p == 0x60 ||		/* ` */
-		    (unsigned char) *p == 0x24 ||		/* $ */
-		    !isprint((unsigned char) *p) ||
-		    iscntrl((unsigned char) *p)) {
-
+		size_t sz;
+
+		for (sz = 0; p[sz]; sz++) {
+			unsigned char c = (unsigned char) p[sz];
+
+			if (fputs_quoted_is_special(c)
+			    || (dir && fputs_case_convert(c, dir) != c))
+				break;
+		}
+		if (sz) {
+			fwrite(p, 1, sz, out);
+			p += sz;
+			if (!*p)
+				break;
+		}
+
+		if (fputs_quoted_is_special((unsigned char) *p))
 			fprintf(out, "\\x%02x", (unsigned char) *p);
-		} else
-			fputc(dir ==  1 ? toupper(*p) :
-			      dir == -1 ? tolower(*p) :
-			      *p, out);
+		else
+			fputc(fputs_case_convert(*p, dir), out);
 	}
 	fputc('"', out);
 }
@@ -59,15 +93,17 @@ static inline void fputs_nonblank(const char *data, FILE *out)
 	const char *p;
 
 	for (p = data; p && *p; p++) {
-		if (isblank((unsigned char) *p) ||
-		    (unsigned char) *p == 0x5c ||		/* \ */
-		    !isprint((unsigned char) *p) ||
-		    iscntrl((unsigned char) *p)) {
+		size_t sz;
 
-			fprintf(out, "\\x%02x", (unsigned char) *p);
+		for (sz = 0; p[sz] && !fputs_nonblank_is_special((unsigned char) p[sz]); sz++);
+		if (sz) {
+			fwrite(p, 1, sz, out);
+			p += sz;
+			if (!*p)
+				break;
+		}
 
-		} else
-			fputc(*p, out);
+		fprintf(out, "\\x%02x", (unsigned char) *p);
 	}
 }
 
@@ -81,10 +117,16 @@ static inline void fputs_shell_ident(const char *data, FILE *out)
 
 	/* replace all "bad" chars with "_" */
 	for (p = data; p && *p; p++) {
-		if (!isalnum(*p))
-			fputc('_', out);
-		else
-			fputc(*p, out);
+		size_t sz;
+
+		for (sz = 0; p[sz] && isalnum(p[sz]); sz++);
+		if (sz) {
+			fwrite(p, 1, sz, out);
+			p += sz;
+			if (!*p)
+				break;
+		}
+		fputc('_', out);
 	}
 }
 
@@ -10,10 +10,13 @@ struct identry {
 	unsigned long int	id;
 	char			*name;
 	struct identry		*next;
+	unsigned int		unknown : 1;	/* no entry found, name is the ID */
 };
 
 struct idcache {
-	struct identry	*ent;	/* first entry */
+	struct identry	**tab;	/* hash table */
+	size_t		tabsz;	/* number of buckets, power of 2 */
+	size_t		nents;	/* number of entries */
 	int		width;	/* name width */
 };
 
@@ -22,6 +25,9 @@ extern struct idcache *new_idcache(void);
 extern void add_gid(struct idcache *cache, unsigned long int id);
 extern void add_uid(struct idcache *cache, unsigned long int id);
 
+extern void preload_gids(struct idcache *cache);
+extern void preload_uids(struct idcache *cache);
+
 extern void free_idcache(struct idcache *ic);
 extern struct identry *get_id(struct idcache *ic, unsigned long int id);
 
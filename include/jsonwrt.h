@@ -7,14 +7,35 @@ enum {
 	UL_JSON_VALUE
 };
 
+#include "buffer.h"
+
+/* cached escaped object key, see ul_jsonwrt_set_buffered() */
+struct ul_jsonwrt_key {
+	const char *name;	/* the key as used by caller */
+	char *orig;		/* copy of the key */
+	char *quoted;		/* escaped and quoted key */
+	size_t len;
+};
+
+#define UL_JSONWRT_NKEYS	64
+
 struct ul_jsonwrt {
 	FILE *out;
 	int indent;
 
-	unsigned int after_close :1;
+	struct ul_buffer buf;		/* output of the current object */
+	struct ul_jsonwrt_key *keys;	/* UL_JSONWRT_NKEYS hash table */
+
+	unsigned int after_close :1,
+		     buffered :1,
+		     compact :1;
 };
 
 void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent);
+void ul_jsonwrt_set_buffered(struct ul_jsonwrt *fmt, int enable);
+void ul_jsonwrt_set_compact(struct ul_jsonwrt *fmt, int enable);
+void ul_jsonwrt_flush(struct ul_jsonwrt *fmt);
+void ul_jsonwrt_deinit(struct ul_jsonwrt *fmt);
 void ul_jsonwrt_indent(struct ul_jsonwrt *fmt);
 void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type);
 void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type);
@@ -0,0 +1,53 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_LINEIDX_H
+#define UTIL_LINUX_LINEIDX_H
+
+#include <sys/types.h>
+
+#include "c.h"
+
+/*
+ * Compact index of line offsets, extended while a file is read. The
+ * offsets have to be added in ascending order. Every UL_LINEIDX_STEP-th
+ * offset is stored as is, the others as varint encoded deltas, so a
+ * lookup decodes at most UL_LINEIDX_STEP - 1 deltas.
+ */
+#define UL_LINEIDX_STEP		64
+
+struct ul_lineidx_mark {
+	off_t		offset;		/* absolute offset of the first line */
+	size_t		data_off;	/* deltas of the other lines in data[] */
+};
+
+struct ul_lineidx {
+	struct ul_lineidx_mark *marks;
+	size_t		nmarks;
+
+	unsigned char	*data;		/* varint deltas */
+	size_t		datasz;		/* allocated size */
+	size_t		datalen;	/* used size */
+
+	size_t		nlines;		/* number of indexed lines */
+	off_t		last;		/* the last added offset */
+};
+
+#define UL_INIT_LINEIDX { .marks = NULL }
+
+extern void ul_lineidx_reset(struct ul_lineidx *idx);
+extern int ul_lineidx_add(struct ul_lineidx *idx, off_t offset);
+extern int ul_lineidx_get(struct ul_lineidx *idx, size_t n, off_t *offset);
+
+static inline size_t ul_lineidx_count(struct ul_lineidx *idx)
+{
+	return idx->nlines;
+}
+
+static inline off_t ul_lineidx_last(struct ul_lineidx *idx)
+{
+	return idx->nlines ? idx->last : -1;
+}
+
+#endif /* UTIL_LINUX_LINEIDX_H */
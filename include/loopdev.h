@@ -108,6 +108,7 @@ struct loopdev_cxt {
 	char		device[128];	/* device path (e.g. /dev/loop<N>) */
 	char		*filename;	/* backing file for loopcxt_set_... */
 	int		fd;		/* open(/dev/looo<N>) */
+	int		ctl_fd;		/* open(/dev/loop-control) */
 	int		mode;		/* fd mode O_{RDONLY,RDWR} */
 	uint64_t	blocksize;	/* used by loopcxt_setup_device() */
 
@@ -122,7 +123,7 @@ struct loopdev_cxt {
 	struct loopdev_iter	iter;	/* scans /sys or /dev for used/free devices */
 };
 
-#define UL_LOOPDEVCXT_EMPTY { .fd = -1  }
+#define UL_LOOPDEVCXT_EMPTY { .fd = -1, .ctl_fd = -1 }
 
 /*
  * loopdev_cxt.flags
@@ -155,6 +156,7 @@ extern char *loopdev_find_by_backing_file(const char *filename,
 extern int loopcxt_find_unused(struct loopdev_cxt *lc);
 extern int loopdev_delete(const char *device);
 extern int loopdev_count_by_backing_file(const char *filename, char **loopdev);
+extern int loopdev_get_dio_alignment(const char *filename, int mode, uint64_t *align);
 
 /*
  * Low-level
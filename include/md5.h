@@ -2,6 +2,7 @@
 #define UTIL_LINUX_MD5_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #define UL_MD5LENGTH 16
 
@@ -16,6 +17,12 @@ void ul_MD5Update(struct UL_MD5Context *ctx, unsigned char const *buf, unsigned
 void ul_MD5Final(unsigned char digest[UL_MD5LENGTH], struct UL_MD5Context *ctx);
 void ul_MD5Transform(uint32_t buf[4], uint32_t const in[16]);
 
+/* number of messages hashed at once by ul_MD5Multi() */
+#define UL_MD5_LANES	4
+
+void ul_MD5Multi(unsigned char digest[][UL_MD5LENGTH],
+		 const unsigned char *const data[], const size_t len[], size_t n);
+
 /*
  * This is needed to make RSAREF happy on some MS-DOS compilers.
  */
@@ -0,0 +1,203 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * listmount(2) and statmount(2) -- the kernel mount table by syscalls (since
+ * Linux 6.8). The definitions are from linux/mount.h, the library does not
+ * require new kernel headers.
+ */
+#ifndef UTIL_LINUX_MOUNT_API_UTILS
+#define UTIL_LINUX_MOUNT_API_UTILS
+
+#if defined(__linux__)
+# include <sys/syscall.h>
+# include <stdint.h>
+# include <unistd.h>
+
+# ifndef SYS_statmount
+#  if defined(__alpha__)
+#   define SYS_statmount	567
+#  elif !defined(__mips__)
+#   define SYS_statmount	457
+#  endif
+# endif
+# ifndef SYS_listmount
+#  if defined(__alpha__)
+#   define SYS_listmount	568
+#  elif !defined(__mips__)
+#   define SYS_listmount	458
+#  endif
+# endif
+
+# if defined(SYS_statmount) && defined(SYS_listmount)
+
+struct ul_mnt_id_req {
+	uint32_t	size;
+	uint32_t	spare;
+	uint64_t	mnt_id;
+	uint64_t	param;
+	uint64_t	mnt_ns_id;
+};
+
+#  define UL_MNT_ID_REQ_SIZE_VER0	24	/* sizeof first published struct */
+
+struct ul_statmount {
+	uint32_t	size;		/* Total size, including strings */
+	uint32_t	mnt_opts;	/* [str] Options (comma separated, escaped) */
+	uint64_t	mask;		/* What results were written */
+	uint32_t	sb_dev_major;	/* Device ID */
+	uint32_t	sb_dev_minor;
+	uint64_t	sb_magic;	/* ..._SUPER_MAGIC */
+	uint32_t	sb_flags;	/* SB_{RDONLY,SYNCHRONOUS,DIRSYNC,LAZYTIME} */
+	uint32_t	fs_type;	/* [str] Filesystem type */
+	uint64_t	mnt_id;		/* Unique ID of mount */
+	uint64_t	mnt_parent_id;	/* Unique ID of parent (for root == mnt_id) */
+	uint32_t	mnt_id_old;	/* Reused IDs used in proc/.../mountinfo */
+	uint32_t	mnt_parent_id_old;
+	uint64_t	mnt_attr;	/* MOUNT_ATTR_... */
+	uint64_t	mnt_propagation; /* MS_{SHARED,SLAVE,PRIVATE,UNBINDABLE} */
+	uint64_t	mnt_peer_group;	/* ID of shared peer group */
+	uint64_t	mnt_master;	/* Mount receives propagation from this ID */
+	uint64_t	propagate_from;	/* Propagation from in current namespace */
+	uint32_t	mnt_root;	/* [str] Root of mount relative to root of fs */
+	uint32_t	mnt_point;	/* [str] Mountpoint relative to current root */
+	uint64_t	mnt_ns_id;	/* ID of the mount namespace */
+	uint32_t	fs_subtype;	/* [str] Subtype of fs_type (if any) */
+	uint32_t	sb_source;	/* [str] Source string of the mount */
+	uint32_t	opt_num;	/* Number of fs options */
+	uint32_t	opt_array;	/* [str] Array of nul terminated fs options */
+	uint32_t	opt_sec_num;	/* Number of security options */
+	uint32_t	opt_sec_array;	/* [str] Array of nul terminated security options */
+	uint64_t	supported_mask;	/* Mask flags that this kernel supports */
+	uint32_t	mnt_uidmap_num;	/* Number of uid mappings */
+	uint32_t	mnt_uidmap;	/* [str] Array of uid mappings */
+	uint32_t	mnt_gidmap_num;	/* Number of gid mappings */
+	uint32_t	mnt_gidmap;	/* [str] Array of gid mappings */
+	uint64_t	__spare2[43];
+	char		str[];		/* Variable size part containing strings */
+};
+
+/* ul_statmount.mask bits */
+#  define UL_STATMOUNT_SB_BASIC		0x00000001U
+#  define UL_STATMOUNT_MNT_BASIC	0x00000002U
+#  define UL_STATMOUNT_PROPAGATE_FROM	0x00000004U
+#  define UL_STATMOUNT_MNT_ROOT		0x00000008U
+#  define UL_STATMOUNT_MNT_POINT	0x00000010U
+#  define UL_STATMOUNT_FS_TYPE		0x00000020U
+#  define UL_STATMOUNT_MNT_NS_ID	0x00000040U
+#  define UL_STATMOUNT_MNT_OPTS		0x00000080U
+#  define UL_STATMOUNT_FS_SUBTYPE	0x00000100U
+#  define UL_STATMOUNT_SB_SOURCE	0x00000200U
+#  define UL_STATMOUNT_OPT_ARRAY	0x00000400U
+#  define UL_STATMOUNT_OPT_SEC_ARRAY	0x00000800U
+#  define UL_STATMOUNT_SUPPORTED_MASK	0x00001000U
+
+/* listmount() special mount ID, root of the current namespace */
+#  define UL_LSMT_ROOT			0xffffffffffffffffULL
+
+/* ul_statmount.mnt_attr */
+#  define UL_MOUNT_ATTR_RDONLY		0x00000001
+#  define UL_MOUNT_ATTR_NOSUID		0x00000002
+#  define UL_MOUNT_ATTR_NODEV		0x00000004
+#  define UL_MOUNT_ATTR_NOEXEC		0x00000008
+#  define UL_MOUNT_ATTR__ATIME		0x00000070
+#  define UL_MOUNT_ATTR_RELATIME	0x00000000
+#  define UL_MOUNT_ATTR_NOATIME		0x00000010
+#  define UL_MOUNT_ATTR_STRICTATIME	0x00000020
+#  define UL_MOUNT_ATTR_NODIRATIME	0x00000080
+#  define UL_MOUNT_ATTR_IDMAP		0x00100000
+#  define UL_MOUNT_ATTR_NOSYMFOLLOW	0x00200000
+
+/* ul_statmount.sb_flags */
+#  define UL_SB_RDONLY			0x00000001
+#  define UL_SB_SYNCHRONOUS		0x00000010
+#  define UL_SB_DIRSYNC			0x00000080
+#  define UL_SB_LAZYTIME		0x02000000
+
+static inline int ul_statmount(uint64_t mnt_id, uint64_t mask,
+			       struct ul_statmount *buf, size_t bufsize)
+{
+	struct ul_mnt_id_req req = {
+		.size = UL_MNT_ID_REQ_SIZE_VER0,
+		.mnt_id = mnt_id,
+		.param = mask
+	};
+
+	return syscall(SYS_statmount, &req, buf, bufsize, 0);
+}
+
+/* returns IDs of the mounts after @last_id (or from the begin if zero) */
+static inline ssize_t ul_listmount(uint64_t mnt_id, uint64_t last_id,
+				   uint64_t *ids, size_t nids)
+{
+	struct ul_mnt_id_req req = {
+		.size = UL_MNT_ID_REQ_SIZE_VER0,
+		.mnt_id = mnt_id,
+		.param = last_id
+	};
+
+	return syscall(SYS_listmount, &req, ids, nids, 0);
+}
+
+#  define UL_HAVE_STATMOUNT 1
+
+# endif /* SYS_statmount && SYS_listmount */
+
+# if defined(SYS_statx) && defined(UL_HAVE_STATMOUNT)
+#  include <fcntl.h>
+#  include <string.h>
+
+#  ifndef AT_NO_AUTOMOUNT
+#   define AT_NO_AUTOMOUNT	0x800
+#  endif
+
+#  define UL_STATX_MNT_ID_UNIQUE	0x00004000U	/* since Linux 6.8 */
+#  define UL_STATX_ATTR_MOUNT_ROOT	0x00002000
+
+/* the begin of struct statx, up to stx_mnt_id */
+struct ul_statx {
+	uint32_t	stx_mask;
+	uint32_t	stx_blksize;
+	uint64_t	stx_attributes;
+	uint32_t	stx_nlink;
+	uint32_t	stx_uid;
+	uint32_t	stx_gid;
+	uint16_t	stx_mode;
+	uint16_t	__spare0;
+	uint64_t	stx_ino;
+	uint64_t	stx_size;
+	uint64_t	stx_blocks;
+	uint64_t	stx_attributes_mask;
+	unsigned char	__times[64];
+	uint32_t	stx_rdev_major;
+	uint32_t	stx_rdev_minor;
+	uint32_t	stx_dev_major;
+	uint32_t	stx_dev_minor;
+	uint64_t	stx_mnt_id;
+	unsigned char	__spare[104];	/* the struct is 256 bytes */
+};
+
+/*
+ * Returns the unique ID (as used by statmount) of the mount @path is the
+ * root of, or 0 if @path is not a mount root or the kernel does not report
+ * the unique mount IDs.
+ */
+static inline uint64_t ul_get_mount_root_id(const char *path)
+{
+	struct ul_statx stx;
+
+	memset(&stx, 0, sizeof(stx));
+	if (syscall(SYS_statx, AT_FDCWD, path, AT_NO_AUTOMOUNT,
+		    UL_STATX_MNT_ID_UNIQUE, &stx) != 0)
+		return 0;
+	if (!(stx.stx_mask & UL_STATX_MNT_ID_UNIQUE)
+	    || !(stx.stx_attributes_mask & UL_STATX_ATTR_MOUNT_ROOT)
+	    || !(stx.stx_attributes & UL_STATX_ATTR_MOUNT_ROOT))
+		return 0;
+	return stx.stx_mnt_id;
+}
+#  define UL_HAVE_MOUNT_ROOT_ID 1
+
+# endif /* SYS_statx && UL_HAVE_STATMOUNT */
+#endif /* __linux__ */
+#endif /* UTIL_LINUX_MOUNT_API_UTILS */
@@ -9,6 +9,8 @@
 
 #include "c.h"
 
+struct ul_path_cache;
+
 struct path_cxt {
 	int	dir_fd;
 	char	*dir_path;
@@ -18,6 +20,8 @@ struct path_cxt {
 	char *prefix;
 	char path_buffer[PATH_MAX];
 
+	struct ul_path_cache *cache;	/* see ul_path_enable_cache() */
+
 	void	*dialect;
 	void	(*free_dialect)(struct path_cxt *);
 	int	(*redirect_on_enoent)(struct path_cxt *, const char *, int *);
@@ -39,6 +43,9 @@ const char *ul_path_get_dir(struct path_cxt *pc);
 int ul_path_set_dialect(struct path_cxt *pc, void *data, void free_data(struct path_cxt *));
 void *ul_path_get_dialect(struct path_cxt *pc);
 
+int ul_path_enable_cache(struct path_cxt *pc, int enable);
+void ul_path_invalidate_cache(struct path_cxt *pc);
+
 int ul_path_set_enoent_redirect(struct path_cxt *pc, int (*func)(struct path_cxt *, const char *, int *));
 int ul_path_get_dirfd(struct path_cxt *pc);
 void ul_path_close_dirfd(struct path_cxt *pc);
@@ -128,6 +135,30 @@ int ul_path_count_dirents(struct path_cxt *pc, const char *path);
 int ul_path_countf_dirents(struct path_cxt *pc, const char *path, ...)
 				__attribute__ ((__format__ (__printf__, 2, 3)));
 
+/* batch read, see ul_path_read_attrs() */
+enum {
+	UL_PATH_ATTR_STRING = 0,
+	UL_PATH_ATTR_U64,
+	UL_PATH_ATTR_S64,
+	UL_PATH_ATTR_S32
+};
+
+struct ul_path_attr {
+	const char	*name;		/* file name */
+	int		type;		/* UL_PATH_ATTR_* */
+	int		rc;		/* 0 or negative errno */
+
+	union {
+		char		*str;
+		uint64_t	u64;
+		int64_t		s64;
+		int32_t		s32;
+	} data;
+};
+
+int ul_path_read_attrs(struct path_cxt *pc, const char *subdir,
+		       struct ul_path_attr *attrs, size_t nattrs);
+
 FILE *ul_prefix_fopen(const char *prefix, const char *path, const char *mode);
 
 
@@ -80,6 +80,7 @@
 #define _PATH_OS_RELEASE_ETC	"/etc/os-release"
 #define _PATH_OS_RELEASE_USR	"/usr/lib/os-release"
 #define _PATH_NUMLOCK_ON	_PATH_RUNSTATEDIR "/numlock-on"
+#define _PATH_LSCPU_VIRT_CACHE	_PATH_RUNSTATEDIR "/lscpu-virt"
 #define _PATH_LOGINDEFS		"/etc/login.defs"
 
 /* misc paths */
@@ -175,6 +176,7 @@
 #define _PATH_RAWDEVCTL_OLD	"/dev/rawctl"
 
 #define _PATH_PROC_KERNEL	"/proc/sys/kernel"
+#define _PATH_PROC_BOOT_ID	_PATH_PROC_KERNEL "/random/boot_id"
 
 /* ipc paths */
 #define _PATH_PROC_SYSV_MSG	"/proc/sysvipc/msg"
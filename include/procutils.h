@@ -11,15 +11,22 @@ struct proc_tasks {
 extern struct proc_tasks *proc_open_tasks(pid_t pid);
 extern void proc_close_tasks(struct proc_tasks *tasks);
 extern int proc_next_tid(struct proc_tasks *tasks, pid_t *tid);
+extern int proc_foreach_task(pid_t pid, int (*fn)(pid_t, void *), void *data);
 
 struct proc_processes {
 	DIR *dir;
 
 	const char *fltr_name;
 	uid_t fltr_uid;
+	char *fltr_cgroup;		/* cgroup path, matches also sub-groups */
+	const char *fltr_nsname;	/* "net", "mnt", ... in /proc/<pid>/ns/ */
+	dev_t fltr_nsdev;
+	ino_t fltr_nsino;
 
 	unsigned int has_fltr_name : 1,
-		     has_fltr_uid : 1;
+		     has_fltr_uid : 1,
+		     has_fltr_cgroup : 1,
+		     has_fltr_ns : 1;
 };
 
 extern struct proc_processes *proc_open_processes(void);
@@ -27,6 +34,9 @@ extern void proc_close_processes(struct proc_processes *ps);
 
 extern void proc_processes_filter_by_name(struct proc_processes *ps, const char *name);
 extern void proc_processes_filter_by_uid(struct proc_processes *ps, uid_t uid);
+extern int proc_processes_filter_by_cgroup(struct proc_processes *ps, const char *path);
+extern int proc_processes_filter_by_ns(struct proc_processes *ps, const char *file);
+extern int proc_processes_add_filter(struct proc_processes *ps, const char *str);
 extern int proc_next_pid(struct proc_processes *ps, pid_t *pid);
 
 extern char *proc_get_command(pid_t pid);
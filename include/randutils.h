@@ -1,6 +1,8 @@
 #ifndef UTIL_LINUX_RANDUTILS
 #define UTIL_LINUX_RANDUTILS
 
+#include <stdint.h>
+
 #ifdef HAVE_SRANDOM
 #define srand(x)	srandom(x)
 #define rand()		random()
@@ -14,4 +16,7 @@ extern int random_get_fd(void);
 extern int ul_random_get_bytes(void *buf, size_t nbytes);
 extern const char *random_tell_source(void);
 
+/* changed in the child process after fork(), 0 if not supported */
+extern uint64_t ul_fork_generation(void);
+
 #endif
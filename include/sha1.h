@@ -8,6 +8,7 @@
  */
 
 #include "stdint.h"
+#include <stddef.h>
 
 #define UL_SHA1LENGTH		20
 
@@ -24,4 +25,10 @@ void ul_SHA1Update(UL_SHA1_CTX *context, const unsigned char *data, uint32_t len
 void ul_SHA1Final(unsigned char digest[UL_SHA1LENGTH], UL_SHA1_CTX *context);
 void ul_SHA1(char *hash_out, const char *str, unsigned len);
 
+/* number of messages hashed at once by ul_SHA1Multi() */
+#define UL_SHA1_LANES		4
+
+void ul_SHA1Multi(unsigned char digest[][UL_SHA1LENGTH],
+		  const unsigned char *const data[], const size_t len[], size_t n);
+
 #endif /* UTIL_LINUX_SHA1_H */
@@ -201,6 +201,7 @@ enum
 };
 
 extern char *size_to_human_string(int options, uint64_t bytes);
+extern size_t ul_u64_to_dec(char *buf, uint64_t num);
 
 extern int string_to_idarray(const char *list, int ary[], size_t arysz,
 			   int (name2id)(const char *, size_t));
@@ -0,0 +1,87 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_ULSTATS_H
+#define UTIL_LINUX_ULSTATS_H
+
+/*
+ * Syscall, I/O and time accounting
+ *
+ * The accounting is enabled by UL_STATS= environment variable and a summary
+ * is printed to stderr at exit. The counters are private for each library
+ * (like debug masks), so libblkid, libmount, libsmartcols and the program
+ * itself print separate summaries.
+ *
+ * The accounting is initialized by ul_stats_init(), the library init_debug()
+ * functions call it. The UL_STATS_* macros do nothing if not enabled.
+ */
+#include <stddef.h>
+
+enum {
+	UL_STATS_OPEN = 0,	/* open(), openat(), fopen(), opendir() */
+	UL_STATS_READ,		/* read(), pread(), getline() */
+	UL_STATS_IOCTL,		/* ioctl() */
+	UL_STATS_STAT,		/* stat(), access(), statx(), statmount() */
+
+	__UL_STATS_NCALLS
+};
+
+enum {
+	UL_STATS_SYSFS = 0,	/* bytes read from /sys */
+	UL_STATS_PROCFS,	/* bytes read from /proc */
+	UL_STATS_DEVICE,	/* bytes read from devices */
+	UL_STATS_OTHER,		/* bytes read from regular files */
+
+	__UL_STATS_NSOURCES
+};
+
+enum {
+	UL_STATS_PROBE = 0,	/* libblkid probing */
+	UL_STATS_PARSE,		/* libmount tables parsing */
+	UL_STATS_PRINT,		/* libsmartcols output */
+
+	__UL_STATS_NPHASES
+};
+
+extern int ul_stats_enabled;
+
+extern void ul_stats_init(const char *name);
+extern void ul_stats_add_call(int call);
+extern void ul_stats_add_bytes(int source, size_t bytes);
+extern int ul_stats_path_source(const char *path);
+extern void ul_stats_phase_begin(int phase);
+extern void ul_stats_phase_end(int phase);
+
+#define UL_STATS_CALL(_call) \
+	do { \
+		if (ul_stats_enabled) \
+			ul_stats_add_call(_call); \
+	} while (0)
+
+#define UL_STATS_BYTES(_source, _bytes) \
+	do { \
+		if (ul_stats_enabled && (_bytes) > 0) \
+			ul_stats_add_bytes(_source, _bytes); \
+	} while (0)
+
+/* like UL_STATS_BYTES(), the source is evaluated from @_path */
+#define UL_STATS_PATH_BYTES(_path, _bytes) \
+	do { \
+		if (ul_stats_enabled && (_bytes) > 0) \
+			ul_stats_add_bytes(ul_stats_path_source(_path), _bytes); \
+	} while (0)
+
+#define UL_STATS_BEGIN(_phase) \
+	do { \
+		if (ul_stats_enabled) \
+			ul_stats_phase_begin(_phase); \
+	} while (0)
+
+#define UL_STATS_END(_phase) \
+	do { \
+		if (ul_stats_enabled) \
+			ul_stats_phase_end(_phase); \
+	} while (0)
+
+#endif /* UTIL_LINUX_ULSTATS_H */
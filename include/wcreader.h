@@ -0,0 +1,70 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ */
+#ifndef UTIL_LINUX_WCREADER_H
+#define UTIL_LINUX_WCREADER_H
+
+#include <stdio.h>
+
+#include "c.h"
+#include "widechar.h"
+
+#define UL_WCREADER_BUFSIZ	(64 * 1024)
+
+/*
+ * Buffered replacement for getwc() on a FILE that is read only by the
+ * reader. Input is read by read(2) in large blocks and decoded to a
+ * wide char array at once; ASCII bytes are copied without mbrtowc().
+ */
+struct ul_wcreader {
+	int		fd;
+
+	char		*bytes;		/* undecoded input */
+	size_t		bpos;		/* first undecoded byte */
+	size_t		blen;		/* number of bytes in the buffer */
+
+	wint_t		*wcs;		/* decoded input */
+	size_t		wpos;		/* next char to return */
+	size_t		wlen;		/* number of decoded chars */
+
+#ifdef HAVE_WIDECHAR
+	mbstate_t	st;
+#endif
+	unsigned int	eof : 1,	/* read(2) returned 0 or failed */
+			ilseq : 1,	/* invalid sequence at bytes[bpos] */
+			has_unget : 1;
+	wint_t		unget;
+};
+
+extern void ul_init_wcreader(struct ul_wcreader *rd, FILE *f);
+extern void ul_free_wcreader(struct ul_wcreader *rd);
+
+extern wint_t ul_wcreader_fill(struct ul_wcreader *rd);
+extern int ul_wcreader_getbyte(struct ul_wcreader *rd);
+
+/*
+ * Like getwc(): returns WEOF at end of input, or WEOF with errno set to
+ * EILSEQ on an invalid sequence. The offending byte may be consumed by
+ * ul_wcreader_getbyte().
+ */
+static inline wint_t ul_wcreader_getwc(struct ul_wcreader *rd)
+{
+	if (rd->has_unget) {
+		rd->has_unget = 0;
+		return rd->unget;
+	}
+	if (rd->wpos < rd->wlen)
+		return rd->wcs[rd->wpos++];
+	return ul_wcreader_fill(rd);
+}
+
+static inline void ul_wcreader_ungetwc(struct ul_wcreader *rd, wint_t wc)
+{
+	if (wc == WEOF)
+		return;
+	rd->unget = wc;
+	rd->has_unget = 1;
+}
+
+#endif /* UTIL_LINUX_WCREADER_H */
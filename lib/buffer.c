@@ -14,17 +14,19 @@ void ul_buffer_reset_data(struct ul_buffer *buf)
 	buf->end = buf->begin;
 
 	if (buf->ptrs && buf->nptrs)
-		memset(buf->ptrs, 0, buf->nptrs * sizeof(char *));
+		memset(buf->ptrs, 0, buf->nptrs * sizeof(size_t));
 }
 
 void ul_buffer_free_data(struct ul_buffer *buf)
 {
 	assert(buf);
 
-	free(buf->begin);
+	if (!buf->storage)
+		free(buf->begin);
 	buf->begin = NULL;
 	buf->end = NULL;
 	buf->sz = 0;
+	buf->storage = 0;
 
 	free(buf->ptrs);
 	buf->ptrs = NULL;
@@ -40,6 +42,26 @@ void ul_buffer_set_chunksize(struct ul_buffer *buf, size_t sz)
 	buf->chunksize = sz;
 }
 
+/*
+ * Use @mem of @sz bytes (e.g. an array on stack) for data. The buffer is
+ * moved to the heap when more space is necessary; @mem is never freed.
+ * It's usable for short-lived buffers with usually small data.
+ */
+void ul_buffer_set_storage(struct ul_buffer *buf, char *mem, size_t sz)
+{
+	assert(buf);
+	assert(mem);
+	assert(sz);
+
+	if (buf->sz)
+		ul_buffer_free_data(buf);
+
+	buf->begin = buf->end = mem;
+	buf->sz = sz;
+	buf->storage = 1;
+	*mem = '\0';
+}
+
 int ul_buffer_is_empty(struct ul_buffer *buf)
 {
 	return buf->begin == buf->end;
@@ -48,23 +70,26 @@ int ul_buffer_is_empty(struct ul_buffer *buf)
 int ul_buffer_save_pointer(struct ul_buffer *buf, unsigned short ptr_idx)
 {
 	if (ptr_idx >= buf->nptrs) {
-		char **tmp = realloc(buf->ptrs, (ptr_idx + 1) * sizeof(char *));
+		size_t *tmp = realloc(buf->ptrs, (ptr_idx + 1) * sizeof(size_t));
 
 		if (!tmp)
 			return -EINVAL;
+		memset(tmp + buf->nptrs, 0,
+		       (ptr_idx + 1 - buf->nptrs) * sizeof(size_t));
 		buf->ptrs = tmp;
 		buf->nptrs = ptr_idx + 1;
 	}
 
-	buf->ptrs[ptr_idx] = buf->end;
+	/* offset rather than pointer, data may be reallocated */
+	buf->ptrs[ptr_idx] = buf->end - buf->begin + 1;
 	return 0;
 }
 
 
 char *ul_buffer_get_pointer(struct ul_buffer *buf, unsigned short ptr_idx)
 {
-	if (ptr_idx < buf->nptrs)
-		return buf->ptrs[ptr_idx];
+	if (ptr_idx < buf->nptrs && buf->ptrs[ptr_idx])
+		return buf->begin + buf->ptrs[ptr_idx] - 1;
 	return NULL;
 }
 
@@ -111,16 +136,26 @@ int ul_buffer_alloc_data(struct ul_buffer *buf, size_t sz)
 	if (buf->end && buf->begin)
 		len = buf->end - buf->begin;
 
+	/* grow at least twice to keep number of reallocations small */
+	if (sz < buf->sz * 2)
+		sz = buf->sz * 2;
 	if (buf->chunksize)
 		sz = ((sz + buf->chunksize) / buf->chunksize) * buf->chunksize + 1;
 
-	tmp = realloc(buf->begin, sz);
+	if (buf->storage) {
+		/* caller's memory is too small, move data to heap */
+		tmp = malloc(sz);
+		if (tmp && len)
+			memcpy(tmp, buf->begin, len);
+	} else
+		tmp = realloc(buf->begin, sz);
 	if (!tmp)
 		return -ENOMEM;
 
 	buf->begin = tmp;
 	buf->end = buf->begin + len;
 	buf->sz = sz;
+	buf->storage = 0;
 
 	return 0;
 }
@@ -200,9 +235,14 @@ char *ul_buffer_get_safe_data(struct ul_buffer *buf, size_t *sz, size_t *width,
 	if (!data)
 		goto nothing;
 
-	encsz = mbs_safe_encode_size(buf->sz) + 1;
+	/* the encoded area is reused by the next calls, grow it twice */
+	encsz = mbs_safe_encode_size(buf->end - buf->begin) + 1;
 	if (encsz > buf->encoded_sz) {
-		char *tmp = realloc(buf->encoded, encsz);
+		char *tmp;
+
+		if (encsz < buf->encoded_sz * 2)
+			encsz = buf->encoded_sz * 2;
+		tmp = realloc(buf->encoded, encsz);
 		if (!tmp)
 			goto nothing;
 		buf->encoded = tmp;
@@ -237,7 +277,7 @@ enum {
 int main(void)
 {
 	struct ul_buffer buf = UL_INIT_BUFFER;
-	char *str;
+	char *str, mem[8];
 	size_t sz = 0;
 
 	ul_buffer_set_chunksize(&buf, 16);
@@ -279,6 +319,15 @@ int main(void)
 	str = ul_buffer_get_data(&buf, &sz, NULL);
 	printf("data [%zu] '%s'\n", sz, str);
 
+	ul_buffer_free_data(&buf);
+	ul_buffer_set_storage(&buf, mem, sizeof(mem));
+	ul_buffer_append_string(&buf, "foo");
+	ul_buffer_save_pointer(&buf, PTR_AAA);
+	ul_buffer_append_string(&buf, ",bar,baz");	/* moved to heap */
+	str = ul_buffer_get_data(&buf, &sz, NULL);
+	printf("data [%zu] '%s' %s\n", sz, str, str == mem ? "storage" : "heap");
+	printf(" pointer data len: AAA=%zu\n", ul_buffer_get_pointer_length(&buf, PTR_AAA));
+
 	ul_buffer_free_data(&buf);
 }
 #endif /* TEST_PROGRAM_BUFFER */
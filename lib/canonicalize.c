@@ -15,11 +15,35 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <fcntl.h>
 
 #include "canonicalize.h"
 #include "pathnames.h"
 #include "all-io.h"
 
+#if defined(__linux__)
+# include <sys/syscall.h>
+# include <stdint.h>
+# ifndef SYS_openat2
+#  if defined(__alpha__)
+#   define SYS_openat2	547
+#  elif !defined(__mips__)
+#   define SYS_openat2	437
+#  endif
+# endif
+#endif
+
+#ifdef SYS_openat2
+/* from linux/openat2.h */
+struct ul_open_how {
+	uint64_t	flags;
+	uint64_t	mode;
+	uint64_t	resolve;
+};
+# define UL_RESOLVE_NO_MAGICLINKS	0x02
+# define UL_RESOLVE_CACHED		0x20
+#endif
+
 /*
  * Converts private "dm-N" names to "/dev/mapper/<name>"
  *
@@ -140,6 +164,117 @@ char *canonicalize_path(const char *path)
 	return canonical;
 }
 
+/*
+ * Canonicalizes @name in @dir, where @dir is already canonicalized directory.
+ * This is cheap alternative to the canonicalize_path() if the directory has
+ * been already resolved, only the last path component is checked.
+ *
+ * Returns NULL and errno=ELOOP if @name is a symlink, then the caller has to
+ * use canonicalize_path() for the full path.
+ */
+char *canonicalize_path_in_dir(const char *dir, const char *name)
+{
+	char *canonical, *dmname;
+	struct stat st;
+	size_t dsz, nsz;
+
+	if (!dir || *dir != '/' || !name || !*name || strchr(name, '/')
+	    || strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	dsz = strlen(dir);
+	if (dir[dsz - 1] == '/')
+		dsz--;			/* "/" */
+	nsz = strlen(name);
+
+	canonical = malloc(dsz + 1 + nsz + 1);
+	if (!canonical)
+		return NULL;
+	memcpy(canonical, dir, dsz);
+	canonical[dsz] = '/';
+	memcpy(canonical + dsz + 1, name, nsz + 1);
+
+	if (lstat(canonical, &st) != 0) {
+		free(canonical);
+		return NULL;
+	}
+	if (S_ISLNK(st.st_mode)) {
+		free(canonical);
+		errno = ELOOP;
+		return NULL;
+	}
+
+	if (S_ISBLK(st.st_mode) && is_dm_devname(canonical, &dmname)) {
+		char *dm = canonicalize_dm_name(dmname);
+		if (dm) {
+			free(canonical);
+			return dm;
+		}
+	}
+	return canonical;
+}
+
+/*
+ * Canonicalizes @path by openat2(RESOLVE_CACHED), the path is resolved from
+ * the kernel dentry cache only. It's one syscall for whole path, and it does
+ * not wait for (and does not trigger) slow lookups like NFS revalidation.
+ *
+ * Returns NULL and errno=EAGAIN if the path is not in the cache, or
+ * errno=ENOSYS if unsupported; then the caller has to use canonicalize_path().
+ */
+char *canonicalize_path_cached(const char *path)
+{
+#ifdef SYS_openat2
+	struct ul_open_how how = {
+		.flags = O_PATH | O_CLOEXEC | O_NOFOLLOW,
+		.resolve = UL_RESOLVE_CACHED | UL_RESOLVE_NO_MAGICLINKS
+	};
+	char fdpath[sizeof(_PATH_PROC_FDDIR) + sizeof(stringify_value(INT_MAX))];
+	char buf[PATH_MAX], *dmname;
+	struct stat st;
+	ssize_t sz;
+	int fd;
+
+	if (!path || !*path) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	fd = syscall(SYS_openat2, AT_FDCWD, path, &how, sizeof(how));
+	if (fd < 0)
+		return NULL;
+
+	/* symlinks are followed by canonicalize_path() */
+	if (fstat(fd, &st) != 0 || S_ISLNK(st.st_mode)) {
+		close(fd);
+		errno = EAGAIN;
+		return NULL;
+	}
+
+	snprintf(fdpath, sizeof(fdpath), _PATH_PROC_FDDIR "/%d", fd);
+	sz = readlink(fdpath, buf, sizeof(buf) - 1);
+	close(fd);
+	if (sz <= 0 || *buf != '/') {
+		errno = EAGAIN;
+		return NULL;
+	}
+	buf[sz] = '\0';
+
+	if (S_ISBLK(st.st_mode) && is_dm_devname(buf, &dmname)) {
+		char *dm = canonicalize_dm_name(dmname);
+		if (dm)
+			return dm;
+	}
+	return strdup(buf);
+#else
+	(void) path;
+	errno = ENOSYS;
+	return NULL;
+#endif
+}
+
 char *canonicalize_path_restricted(const char *path)
 {
 	char *canonical = NULL;
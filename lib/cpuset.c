@@ -46,13 +46,70 @@ static inline int char_to_val(int c)
 	return -1;
 }
 
-static const char *nexttoken(const char *q,  int sep)
+/*
+ * The sets are accessed as arrays of unsigned longs; CPU N is bit
+ * (N % CPUSET_WORD_BITS) of word (N / CPUSET_WORD_BITS), that's how glibc
+ * and musl define cpu_set_t and the size from CPU_ALLOC_SIZE() is always
+ * a multiple of the word size.
+ */
+#define CPUSET_WORD_BITS	(8 * sizeof(unsigned long))
+#define cpuset_nwords(setsize)	((setsize) / sizeof(unsigned long))
+#define cpuset_words(set)	((unsigned long *) (set))
+
+static inline unsigned int word_ctz(unsigned long w)
+{
+#ifdef __GNUC__
+	return __builtin_ctzl(w);
+#else
+	unsigned int n = 0;
+
+	while (!(w & 1)) {
+		w >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/*
+ * Returns the first CPU >= @cpu which is set (@val is 1) or unset (@val is
+ * 0), or the number of bits in the set if there is no such CPU.
+ */
+static size_t find_next_cpu(const cpu_set_t *set, size_t setsize,
+			    size_t cpu, int val)
+{
+	const unsigned long *w = cpuset_words(set);
+	size_t i = cpu / CPUSET_WORD_BITS, nwords = cpuset_nwords(setsize);
+	unsigned long x;
+
+	if (i >= nwords)
+		return cpuset_nbits(setsize);
+
+	x = (val ? w[i] : ~w[i]) & (~0UL << (cpu % CPUSET_WORD_BITS));
+	while (!x) {
+		if (++i >= nwords)
+			return cpuset_nbits(setsize);
+		x = val ? w[i] : ~w[i];
+	}
+	return i * CPUSET_WORD_BITS + word_ctz(x);
+}
+
+/* sets CPUs @a..@b (inclusive), @b has to fit into the set */
+static void set_cpu_range(cpu_set_t *set, size_t a, size_t b)
 {
-	if (q)
-		q = strchr(q, sep);
-	if (q)
-		q++;
-	return q;
+	unsigned long *w = cpuset_words(set);
+	size_t ia = a / CPUSET_WORD_BITS, ib = b / CPUSET_WORD_BITS;
+	unsigned long ma = ~0UL << (a % CPUSET_WORD_BITS);
+	unsigned long mb = ~0UL >> (CPUSET_WORD_BITS - 1 - b % CPUSET_WORD_BITS);
+
+	if (ia == ib) {
+		w[ia] |= ma & mb;
+		return;
+	}
+	w[ia++] |= ma;
+	while (ia < ib)
+		w[ia++] = ~0UL;
+	w[ib] |= mb;
 }
 
 /*
@@ -123,7 +180,9 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 
 		if (l == 0)
 			continue;
-# if LONG_BIT > 32
+# ifdef __GNUC__
+		l = __builtin_popcountl(l);
+# elif LONG_BIT > 32
 		l = (l & 0x5555555555555555ul) + ((l >> 1) & 0x5555555555555555ul);
 		l = (l & 0x3333333333333333ul) + ((l >> 2) & 0x3333333333333333ul);
 		l = (l & 0x0f0f0f0f0f0f0f0ful) + ((l >> 4) & 0x0f0f0f0f0f0f0f0ful);
@@ -143,6 +202,25 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 }
 #endif
 
+/* writes decimal @num and @sep to @ptr, returns the number of bytes or -1 */
+static int put_cpu(char *ptr, size_t len, size_t num, char sep)
+{
+	char tmp[sizeof(size_t) * 3];
+	size_t n = 0;
+
+	do {
+		tmp[n++] = '0' + num % 10;
+		num /= 10;
+	} while (num);
+
+	if (n + 1 >= len)
+		return -1;
+	for (len = 0; n > 0; len++)
+		ptr[len] = tmp[--n];
+	ptr[len++] = sep;
+	return len;
+}
+
 /*
  * Returns human readable representation of the cpuset. The output format is
  * a list of CPUs with ranges (for example, "0,1,3-9").
@@ -150,37 +228,33 @@ int __cpuset_count_s(size_t setsize, const cpu_set_t *set)
 char *cpulist_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
-	size_t i;
+	size_t i = 0;
 	char *ptr = str;
 	int entry_made = 0;
 	size_t max = cpuset_nbits(setsize);
 
-	for (i = 0; i < max; i++) {
-		if (CPU_ISSET_S(i, setsize, set)) {
-			int rlen;
-			size_t j, run = 0;
-			entry_made = 1;
-			for (j = i + 1; j < max; j++) {
-				if (CPU_ISSET_S(j, setsize, set))
-					run++;
-				else
-					break;
+	while ((i = find_next_cpu(set, setsize, i, 1)) < max) {
+		size_t last = find_next_cpu(set, setsize, i + 1, 0) - 1;
+		int rlen;
+
+		entry_made = 1;
+		if (last == i)
+			rlen = put_cpu(ptr, len, i, ',');
+		else {
+			rlen = put_cpu(ptr, len, i, last == i + 1 ? ',' : '-');
+			if (rlen > 0) {
+				int n = put_cpu(ptr + rlen, len - rlen, last, ',');
+				rlen = n < 0 ? n : rlen + n;
 			}
-			if (!run)
-				rlen = snprintf(ptr, len, "%zu,", i);
-			else if (run == 1) {
-				rlen = snprintf(ptr, len, "%zu,%zu,", i, i + 1);
-				i++;
-			} else {
-				rlen = snprintf(ptr, len, "%zu-%zu,", i, i + run);
-				i += run;
-			}
-			if (rlen < 0 || (size_t) rlen >= len)
-				return NULL;
-			ptr += rlen;
-			len -= rlen;
 		}
+		if (rlen < 0)
+			return NULL;
+		ptr += rlen;
+		len -= rlen;
+		i = last + 1;
 	}
+	if (!entry_made && !len)
+		return NULL;
 	ptr -= entry_made;
 	*ptr = '\0';
 
@@ -193,31 +267,37 @@ char *cpulist_create(char *str, size_t len,
 char *cpumask_create(char *str, size_t len,
 			cpu_set_t *set, size_t setsize)
 {
+	const unsigned long *w = cpuset_words(set);
+	size_t i = cpuset_nwords(setsize);
 	char *ptr = str;
 	char *ret = NULL;
-	int cpu;
 
-	for (cpu = cpuset_nbits(setsize) - 4; cpu >= 0; cpu -= 4) {
-		char val = 0;
+	if (!len)
+		return NULL;
+	len--;		/* terminator */
 
-		if (len == (size_t) (ptr - str))
-			break;
+	while (i-- > 0 && len) {
+		unsigned long x = w[i];
+		int shift = CPUSET_WORD_BITS - 4;
+
+		if (!x && !ret) {
+			size_t n = min(len, CPUSET_WORD_BITS / 4);
+
+			memset(ptr, '0', n);
+			ptr += n;
+			len -= n;
+			continue;
+		}
+		for (; shift >= 0 && len; shift -= 4, len--) {
+			int val = (x >> shift) & 0xf;
 
-		if (CPU_ISSET_S(cpu, setsize, set))
-			val |= 1;
-		if (CPU_ISSET_S(cpu + 1, setsize, set))
-			val |= 2;
-		if (CPU_ISSET_S(cpu + 2, setsize, set))
-			val |= 4;
-		if (CPU_ISSET_S(cpu + 3, setsize, set))
-			val |= 8;
-
-		if (!ret && val)
-			ret = ptr;
-		*ptr++ = val_to_char(val);
+			if (!ret && val)
+				ret = ptr;
+			*ptr++ = val_to_char(val);
+		}
 	}
 	*ptr = '\0';
-	return ret ? ret : ptr - 1;
+	return ret ? ret : ptr > str ? ptr - 1 : ptr;
 }
 
 /*
@@ -225,37 +305,40 @@ char *cpumask_create(char *str, size_t len,
  */
 int cpumask_parse(const char *str, cpu_set_t *set, size_t setsize)
 {
-	int len = strlen(str);
-	const char *ptr = str + len - 1;
-	int cpu = 0;
+	unsigned long *w = cpuset_words(set);
+	size_t nwords = cpuset_nwords(setsize), i = 0;
+	const char *ptr = str + strlen(str);
+	unsigned long x = 0;
+	unsigned int shift = 0;
 
 	/* skip 0x, it's all hex anyway */
-	if (len > 1 && !memcmp(str, "0x", 2L))
+	if (ptr - str > 1 && !memcmp(str, "0x", 2L))
 		str += 2;
 
 	CPU_ZERO_S(setsize, set);
 
-	while (ptr >= str) {
-		char val;
+	while (ptr-- > str) {
+		int val;
 
 		/* cpu masks in /sys uses comma as a separator */
 		if (*ptr == ',')
-			ptr--;
+			continue;
 
 		val = char_to_val(*ptr);
-		if (val == (char) -1)
+		if (val < 0)
 			return -1;
-		if (val & 1)
-			CPU_SET_S(cpu, setsize, set);
-		if (val & 2)
-			CPU_SET_S(cpu + 1, setsize, set);
-		if (val & 4)
-			CPU_SET_S(cpu + 2, setsize, set);
-		if (val & 8)
-			CPU_SET_S(cpu + 3, setsize, set);
-		ptr--;
-		cpu += 4;
+		x |= (unsigned long) val << shift;
+		shift += 4;
+		if (shift == CPUSET_WORD_BITS) {
+			/* bits which do not fit into the set are ignored */
+			if (i < nwords)
+				w[i++] = x;
+			x = 0;
+			shift = 0;
+		}
 	}
+	if (shift && i < nwords)
+		w[i] = x;
 
 	return 0;
 }
@@ -290,29 +373,30 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 	q = str;
 	CPU_ZERO_S(setsize, set);
 
-	while (p = q, q = nexttoken(q, ','), p) {
+	while ((p = q)) {
 		unsigned int a;	/* beginning of range */
 		unsigned int b;	/* end of range */
 		unsigned int s;	/* stride */
 		const char *c1, *c2;
 
+		/* the next token, a range ends at the next ',' */
+		c2 = strchr(p, ',');
+		q = c2 ? c2 + 1 : NULL;
+
 		if (nextnumber(p, &end, &a) != 0)
 			return 1;
 		b = a;
 		s = 1;
 		p = end;
 
-		c1 = nexttoken(p, '-');
-		c2 = nexttoken(p, ',');
-
-		if (c1 != NULL && (c2 == NULL || c1 < c2)) {
-			if (nextnumber(c1, &end, &b) != 0)
+		c1 = c2 ? memchr(p, '-', c2 - p) : strchr(p, '-');
+		if (c1) {
+			if (nextnumber(c1 + 1, &end, &b) != 0)
 				return 1;
 
-			c1 = end && *end ? nexttoken(end, ':') : NULL;
-
-			if (c1 != NULL && (c2 == NULL || c1 < c2)) {
-				if (nextnumber(c1, &end, &s) != 0)
+			c1 = c2 ? memchr(end, ':', c2 - end) : strchr(end, ':');
+			if (c1) {
+				if (nextnumber(c1 + 1, &end, &s) != 0)
 					return 1;
 				if (s == 0)
 					return 1;
@@ -321,11 +405,23 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 
 		if (!(a <= b))
 			return 1;
-		while (a <= b) {
-			if (fail && (a >= max))
+		if (a >= max) {
+			if (fail)
 				return 2;
-			CPU_SET_S(a, setsize, set);
-			a += s;
+			continue;
+		}
+		if (b >= max) {
+			if (fail && b - (b - a) % s >= max)
+				return 2;
+			b = max - 1;
+		}
+		if (s == 1)
+			set_cpu_range(set, a, b);
+		else {
+			size_t cpu;
+
+			for (cpu = a; cpu <= b; cpu += s)
+				CPU_SET_S(cpu, setsize, set);
 		}
 	}
 
@@ -337,26 +433,112 @@ int cpulist_parse(const char *str, cpu_set_t *set, size_t setsize, int fail)
 #ifdef TEST_PROGRAM_CPUSET
 
 #include <getopt.h>
+#include <time.h>
+
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* formats and parses sets of @ncpus CPUs @loops times */
+static int bench(int ncpus, int loops)
+{
+	static const struct {
+		const char *name;
+		int step, len;		/* runs of @len CPUs every @step CPUs */
+	} patterns[] = {
+		{ "all",     1, 1 },
+		{ "odd",     2, 1 },
+		{ "ranges", 16, 8 },
+		{ "sparse", 97, 1 },
+	};
+	cpu_set_t *set;
+	size_t setsize, nbits, buflen, i;
+	char *buf, *mask, *list;
+
+	set = cpuset_alloc(ncpus, &setsize, &nbits);
+	if (!set)
+		err(EXIT_FAILURE, "failed to allocate cpu set");
+	buflen = 7 * nbits;
+	buf = malloc(buflen);
+	mask = malloc(buflen);
+	list = malloc(buflen);
+	if (!buf || !mask || !list)
+		err(EXIT_FAILURE, "failed to allocate cpu set buffer");
+
+	printf("%-8s %12s %12s %12s %12s %8s\n", "PATTERN",
+		"MASK-CREATE", "LIST-CREATE", "MASK-PARSE", "LIST-PARSE", "COUNT");
+
+	for (i = 0; i < ARRAY_SIZE(patterns); i++) {
+		double t[4];
+		int cpu, n, count = 0;
+
+		CPU_ZERO_S(setsize, set);
+		for (cpu = 0; cpu < ncpus; cpu += patterns[i].step)
+			for (n = 0; n < patterns[i].len && cpu + n < ncpus; n++)
+				CPU_SET_S(cpu + n, setsize, set);
+
+		strcpy(mask, cpumask_create(buf, buflen, set, setsize));
+		strcpy(list, cpulist_create(buf, buflen, set, setsize));
+
+		t[0] = bench_now();
+		for (n = 0; n < loops; n++)
+			cpumask_create(buf, buflen, set, setsize);
+		t[1] = bench_now();
+		for (n = 0; n < loops; n++)
+			cpulist_create(buf, buflen, set, setsize);
+		t[2] = bench_now();
+		for (n = 0; n < loops; n++)
+			cpumask_parse(mask, set, setsize);
+		t[3] = bench_now();
+		for (n = 0; n < loops; n++)
+			cpulist_parse(list, set, setsize, 0);
+
+		for (n = 0; n < 3; n++)
+			t[n] = t[n + 1] - t[n];
+		t[3] = bench_now() - t[3];
+		for (n = 0; n < loops; n++)
+			count = CPU_COUNT_S(setsize, set);
+
+		/* microseconds per call */
+		printf("%-8s %12.2f %12.2f %12.2f %12.2f %8d\n", patterns[i].name,
+			t[0] / loops, t[1] / loops, t[2] / loops, t[3] / loops,
+			count);
+	}
+
+	free(buf);
+	free(mask);
+	free(list);
+	cpuset_free(set);
+	return EXIT_SUCCESS;
+}
 
 int main(int argc, char *argv[])
 {
 	cpu_set_t *set;
 	size_t setsize, buflen, nbits;
 	char *buf, *mask = NULL, *range = NULL;
-	int ncpus = 2048, rc, c;
+	int ncpus = 2048, loops = 0, rc, c;
 
 	static const struct option longopts[] = {
 	    { "ncpus", 1, NULL, 'n' },
 	    { "mask",  1, NULL, 'm' },
 	    { "range", 1, NULL, 'r' },
+	    { "bench", 1, NULL, 'b' },
 	    { NULL,    0, NULL, 0 }
 	};
 
-	while ((c = getopt_long(argc, argv, "n:m:r:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "n:m:r:b:", longopts, NULL)) != -1) {
 		switch(c) {
 		case 'n':
 			ncpus = atoi(optarg);
 			break;
+		case 'b':
+			loops = atoi(optarg);
+			break;
 		case 'm':
 			mask = strdup(optarg);
 			break;
@@ -368,6 +550,8 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (loops > 0)
+		return bench(ncpus, loops);
 	if (!mask && !range)
 		goto usage_err;
 
@@ -406,7 +590,7 @@ int main(int argc, char *argv[])
 
 usage_err:
 	fprintf(stderr,
-		"usage: %s [--ncpus <num>] --mask <mask> | --range <list>\n",
+		"usage: %s [--ncpus <num>] --mask <mask> | --range <list> | --bench <loops>\n",
 		program_invocation_short_name);
 	exit(EXIT_FAILURE);
 }
@@ -1,8 +1,8 @@
 /*
  * This code is from freebsd/sys/libkern/crc32.c
  *
- * Simplest table-based crc32c.  Performance is not important
- * for checking crcs on superblocks
+ * Simplest table-based crc32c, used if the CPU does not support crc32c
+ * instructions (SSE4.2 on x86_64, CRC32 extension on aarch64).
  */
 
 /*-
@@ -10,6 +10,8 @@
  *  code or tables extracted from it, as desired without restriction.
  */
 
+#include <string.h>
+
 #include "crc32c.h"
 
 static const uint32_t crc32Table[256] = {
@@ -90,13 +92,227 @@ static const uint32_t crc32Table[256] = {
  *    crc ^= ~0L
  *
  */
-uint32_t
-crc32c(uint32_t crc, const void *buf, size_t size)
+static uint32_t
+crc32c_table(uint32_t crc, const uint8_t *p, size_t size)
 {
-	const uint8_t *p = buf;
-
 	while (size--)
 		crc = crc32Table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
 
 	return crc;
 }
+
+#if defined(__x86_64__) && \
+    ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+# define UL_CRC32C_SSE42
+# include <immintrin.h>
+
+/* SSE4.2 crc32 instruction implements exactly the Castagnoli polynomial */
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t *p, size_t size)
+{
+	uint64_t crc64 = crc;
+
+	while (size >= 8) {
+		uint64_t x;
+
+		memcpy(&x, p, sizeof(x));
+		crc64 = _mm_crc32_u64(crc64, x);
+		p += 8;
+		size -= 8;
+	}
+	crc = (uint32_t) crc64;
+	while (size--)
+		crc = _mm_crc32_u8(crc, *p++);
+
+	return crc;
+}
+#endif /* __x86_64__ */
+
+#if defined(__aarch64__) && defined(__linux__) && \
+    ((defined(__GNUC__) && __GNUC__ >= 6) || defined(__clang__))
+# define UL_CRC32C_ARMV8
+# include <sys/auxv.h>
+# include <arm_acle.h>
+# ifndef HWCAP_CRC32
+#  define HWCAP_CRC32	(1 << 7)
+# endif
+# ifdef __clang__
+#  define UL_TARGET_CRC	__attribute__((target("crc")))
+# else
+#  define UL_TARGET_CRC	__attribute__((target("+crc")))
+# endif
+
+UL_TARGET_CRC
+static uint32_t
+crc32c_armv8(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size >= 8) {
+		uint64_t x;
+
+		memcpy(&x, p, sizeof(x));
+		crc = __crc32cd(crc, x);
+		p += 8;
+		size -= 8;
+	}
+	while (size--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+#endif /* __aarch64__ */
+
+typedef uint32_t (*crc32c_fn)(uint32_t, const uint8_t *, size_t);
+
+static crc32c_fn
+crc32c_select(void)
+{
+#ifdef UL_CRC32C_SSE42
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse4.2"))
+		return crc32c_sse42;
+#endif
+#ifdef UL_CRC32C_ARMV8
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+		return crc32c_armv8;
+#endif
+	return crc32c_table;
+}
+
+/*
+ * The implementation is selected by CPU features on the first call.
+ */
+uint32_t
+crc32c(uint32_t crc, const void *buf, size_t size)
+{
+	static crc32c_fn fn;
+	crc32c_fn f = __atomic_load_n(&fn, __ATOMIC_RELAXED);
+
+	if (!f) {
+		f = crc32c_select();
+		__atomic_store_n(&fn, f, __ATOMIC_RELAXED);
+	}
+	return f(crc, buf, size);
+}
+
+#ifdef TEST_PROGRAM_CRC32C
+# include <stdio.h>
+# include <stdlib.h>
+# include <time.h>
+# include "c.h"
+# include "randutils.h"
+
+static const struct {
+	const char	*name;
+	crc32c_fn	fn;
+} crc32c_impls[] = {
+	{ "table", crc32c_table },
+#ifdef UL_CRC32C_SSE42
+	{ "sse4.2", crc32c_sse42 },
+#endif
+#ifdef UL_CRC32C_ARMV8
+	{ "armv8", crc32c_armv8 },
+#endif
+};
+
+static int crc32c_impl_usable(size_t idx)
+{
+	crc32c_fn fn = crc32c_impls[idx].fn;
+
+	return fn == crc32c_table || fn == crc32c_select();
+}
+
+static int check(const uint8_t *buf, size_t sz)
+{
+	size_t i, len, off;
+	int rc = EXIT_SUCCESS;
+
+	/* compare all implementations with the table version for all
+	 * lengths and alignments */
+	for (i = 0; i < ARRAY_SIZE(crc32c_impls); i++) {
+		int ok = 1;
+
+		if (!crc32c_impl_usable(i))
+			continue;
+		for (off = 0; ok && off < 16; off++) {
+			for (len = 0; ok && len + off <= sz; len += (len < 512 ? 1 : 61)) {
+				uint32_t seed = (uint32_t) (len * 2654435761U);
+
+				if (crc32c_impls[i].fn(seed, buf + off, len) !=
+				    crc32c_table(seed, buf + off, len))
+					ok = 0;
+			}
+		}
+		if (!ok) {
+			printf("%s: FAILED\n", crc32c_impls[i].name);
+			rc = EXIT_FAILURE;
+		}
+	}
+
+	/* iSCSI check value */
+	printf("check: %08x\n",
+		crc32c(~0U, "123456789", 9) ^ ~0U);
+	return rc;
+}
+
+static double get_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(const uint8_t *buf, size_t sz)
+{
+	static const size_t lens[] = { 64, 512, 4096, 65536 };
+	size_t i, l;
+
+	for (l = 0; l < ARRAY_SIZE(lens) && lens[l] <= sz; l++) {
+		size_t n, loops = (256 * 1024 * 1024) / lens[l];
+
+		for (i = 0; i < ARRAY_SIZE(crc32c_impls); i++) {
+			uint32_t crc = 0;
+			double t;
+
+			if (!crc32c_impl_usable(i))
+				continue;
+			t = get_sec();
+			for (n = 0; n < loops; n++)
+				crc = crc32c_impls[i].fn(crc, buf, lens[l]);
+			t = get_sec() - t;
+
+			printf("%-8s %6zu bytes: %8.1f MiB/s [%08x]\n",
+				crc32c_impls[i].name, lens[l],
+				(double) loops * lens[l] / (1024 * 1024) / t, crc);
+		}
+	}
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t sz = 65536;
+	uint8_t *buf;
+	int rc;
+
+	if (argc != 2 || (strcmp(argv[1], "--check") != 0 &&
+			  strcmp(argv[1], "--bench") != 0)) {
+		fprintf(stderr, "usage: %s --check | --bench\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	buf = malloc(sz);
+	if (!buf)
+		return EXIT_FAILURE;
+	ul_random_get_bytes(buf, sz);
+
+	if (strcmp(argv[1], "--check") == 0)
+		rc = check(buf, 8192);
+	else
+		rc = bench(buf, sz);
+
+	free(buf);
+	return rc;
+}
+#endif /* TEST_PROGRAM_CRC32C */
@@ -161,8 +161,13 @@ void sanitize_env(void)
 
 char *safe_getenv(const char *arg)
 {
-	uid_t ruid = getuid();
+	uid_t ruid;
 
+	/* usually not set, don't check privileges for nothing */
+	if (!getenv(arg))
+		return NULL;
+
+	ruid = getuid();
 	if (ruid != 0 || (ruid != geteuid()) || (getgid() != getegid()))
 		return NULL;
 #ifdef HAVE_PRCTL
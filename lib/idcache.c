@@ -8,18 +8,29 @@
 #include <pwd.h>
 #include <grp.h>
 #include <sys/types.h>
+#include <stdint.h>
+#include <errno.h>
 
 #include "c.h"
 #include "idcache.h"
 
+#define IDCACHE_INIT_SIZE	64
+
+static size_t id_hash(const struct idcache *ic, unsigned long int id)
+{
+	/* Fibonacci hashing, the IDs are often sequential */
+	return (size_t) (((uint64_t) id * 0x9E3779B97F4A7C15ULL) >> 32)
+		& (ic->tabsz - 1);
+}
+
 struct identry *get_id(struct idcache *ic, unsigned long int id)
 {
 	struct identry *ent;
 
-	if (!ic)
+	if (!ic || !ic->tab)
 		return NULL;
 
-	for (ent = ic->ent; ent; ent = ent->next) {
+	for (ent = ic->tab[id_hash(ic, id)]; ent; ent = ent->next) {
 		if (ent->id == id)
 			return ent;
 	}
@@ -34,27 +45,70 @@ struct idcache *new_idcache(void)
 
 void free_idcache(struct idcache *ic)
 {
-	struct identry *ent = ic->ent;
+	size_t i;
 
-	while (ent) {
-		struct identry *next = ent->next;
-		free(ent->name);
-		free(ent);
-		ent = next;
+	for (i = 0; i < ic->tabsz; i++) {
+		struct identry *ent = ic->tab[i];
+
+		while (ent) {
+			struct identry *next = ent->next;
+			free(ent->name);
+			free(ent);
+			ent = next;
+		}
 	}
 
+	free(ic->tab);
 	free(ic);
 }
 
+/* doubles the table if it's full */
+static int grow_idcache(struct idcache *ic)
+{
+	struct identry **old = ic->tab;
+	size_t i, oldsz = ic->tabsz;
+
+	if (ic->tab && ic->nents < ic->tabsz)
+		return 0;
+
+	ic->tabsz = oldsz ? oldsz * 2 : IDCACHE_INIT_SIZE;
+	ic->tab = calloc(ic->tabsz, sizeof(struct identry *));
+	if (!ic->tab) {
+		ic->tab = old;
+		ic->tabsz = oldsz;
+		return old ? 0 : -ENOMEM;
+	}
+
+	for (i = 0; i < oldsz; i++) {
+		struct identry *ent = old[i];
+
+		while (ent) {
+			struct identry *next = ent->next;
+			size_t h = id_hash(ic, ent->id);
+
+			ent->next = ic->tab[h];
+			ic->tab[h] = ent;
+			ent = next;
+		}
+	}
+	free(old);
+	return 0;
+}
+
 static void add_id(struct idcache *ic, char *name, unsigned long int id)
 {
-	struct identry *ent, *x;
+	struct identry *ent;
+	size_t h;
 	int w = 0;
 
+	if (grow_idcache(ic))
+		return;
+
 	ent = calloc(1, sizeof(struct identry));
 	if (!ent)
 		return;
 	ent->id = id;
+	ent->unknown = name ? 0 : 1;
 
 	if (name) {
 #ifdef HAVE_WIDECHAR
@@ -83,12 +137,10 @@ static void add_id(struct idcache *ic, char *name, unsigned long int id)
 		}
 	}
 
-	for (x = ic->ent; x && x->next; x = x->next);
-
-	if (x)
-		x->next = ent;
-	else
-		ic->ent = ent;
+	h = id_hash(ic, id);
+	ent->next = ic->tab[h];
+	ic->tab[h] = ent;
+	ic->nents++;
 
 	if (w <= 0)
 		w = ent->name ? strlen(ent->name) : 0;
@@ -115,3 +167,32 @@ void add_gid(struct idcache *cache, unsigned long int id)
 	}
 }
 
+/*
+ * Fill the cache by one pass over the user database. This is cheaper than
+ * a getpwuid() call for every ID if many IDs will be resolved. Note that
+ * the enumeration may be incomplete (e.g. for LDAP), the other IDs are
+ * still resolved by add_uid().
+ */
+void preload_uids(struct idcache *cache)
+{
+	struct passwd *pw;
+
+	setpwent();
+	while ((pw = getpwent())) {
+		if (!get_id(cache, pw->pw_uid))
+			add_id(cache, pw->pw_name, pw->pw_uid);
+	}
+	endpwent();
+}
+
+void preload_gids(struct idcache *cache)
+{
+	struct group *gr;
+
+	setgrent();
+	while ((gr = getgrent())) {
+		if (!get_id(cache, gr->gr_gid))
+			add_id(cache, gr->gr_name, gr->gr_gid);
+	}
+	endgrent();
+}
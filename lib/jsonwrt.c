@@ -7,13 +7,60 @@
  * Written by Karel Zak <kzak@redhat.com>
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <cctype.h>
 
 #include "c.h"
+#include "strutils.h"
 #include "jsonwrt.h"
 
+/*
+ * In the buffered mode the output is accumulated in fmt->buf and written to
+ * the stream when an object (usually a table row) is complete.
+ */
+static inline void json_write(struct ul_jsonwrt *fmt, const char *data, size_t sz)
+{
+	if (fmt->buffered)
+		ul_buffer_append_data(&fmt->buf, data, sz);
+	else
+		fwrite(data, 1, sz, fmt->out);
+}
+
+static inline void json_puts(struct ul_jsonwrt *fmt, const char *str)
+{
+	json_write(fmt, str, strlen(str));
+}
+
+static inline void json_putc(struct ul_jsonwrt *fmt, char c)
+{
+	if (fmt->buffered)
+		ul_buffer_append_data(&fmt->buf, &c, 1);
+	else
+		fputc(c, fmt->out);
+}
+
+/*
+ * Returns number of chars at the begin of @p which do not need any escape or
+ * case change, they are written to the output at once.
+ */
+static size_t json_plain_span(const char *p, int dir)
+{
+	size_t sz;
+
+	for (sz = 0; p[sz]; sz++) {
+		const unsigned char c = (unsigned char) p[sz];
+
+		if (c < 0x20 || c == '"' || c == '\\')
+			break;
+		if (dir && (c > 127 || (dir == 1 ? c_islower(c) : c_isupper(c))))
+			break;
+	}
+	return sz;
+}
+
 /*
  * Requirements enumerated via testing (V8, Firefox, IE11):
  *
@@ -26,14 +73,22 @@
  *	}
  * }
  */
-static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
+static void fputs_quoted_case_json(const char *data, struct ul_jsonwrt *fmt, int dir)
 {
 	const char *p;
 
-	fputc('"', out);
+	json_putc(fmt, '"');
 	for (p = data; p && *p; p++) {
+		size_t sz = json_plain_span(p, dir);
+		unsigned int c;
 
-		const unsigned int c = (unsigned int) *p;
+		if (sz) {
+			json_write(fmt, p, sz);
+			p += sz;
+			if (!*p)
+				break;
+		}
+		c = (unsigned int) *p;
 
 		/* From http://www.json.org
 		 *
@@ -44,8 +99,8 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
 		 * in the JSON spec, don't break double-quoted strings.
 		 */
 		if (c == '"' || c == '\\') {
-			fputc('\\', out);
-			fputc(c, out);
+			json_putc(fmt, '\\');
+			json_putc(fmt, c);
 			continue;
 		}
 
@@ -57,11 +112,11 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
 			 * (aka LANG=tr_TR.UTF-8) toupper('I') returns 'I'.
 			 */
 			if (c <= 127)
-				fputc(dir ==  1 ? c_toupper(c) :
-				      dir == -1 ? c_tolower(c) : *p, out);
+				json_putc(fmt, dir ==  1 ? c_toupper(c) :
+					       dir == -1 ? c_tolower(c) : *p);
 			else
-				fputc(dir ==  1 ? toupper(c) :
-				      dir == -1 ? tolower(c) : *p, out);
+				json_putc(fmt, dir ==  1 ? toupper(c) :
+					       dir == -1 ? tolower(c) : *p);
 			continue;
 		}
 
@@ -75,73 +130,199 @@ static void fputs_quoted_case_json(const char *data, FILE *out, int dir)
 			 * should probably be using it.
 			 */
 			case '\b':
-				fputs("\\b", out);
+				json_puts(fmt, "\\b");
 				break;
 			case '\t':
-				fputs("\\t", out);
+				json_puts(fmt, "\\t");
 				break;
 			case '\n':
-				fputs("\\n", out);
+				json_puts(fmt, "\\n");
 				break;
 			case '\f':
-				fputs("\\f", out);
+				json_puts(fmt, "\\f");
 				break;
 			case '\r':
-				fputs("\\r", out);
+				json_puts(fmt, "\\r");
 				break;
 			default:
+			{
 				/* Other assorted control characters */
-				fprintf(out, "\\u00%02x", c);
+				char esc[sizeof("\\u00XX")];
+
+				snprintf(esc, sizeof(esc), "\\u00%02x", c);
+				json_puts(fmt, esc);
 				break;
+			}
 		}
 	}
-	fputc('"', out);
+	json_putc(fmt, '"');
 }
 
-#define fputs_quoted_json(_d, _o)       fputs_quoted_case_json(_d, _o, 0)
-#define fputs_quoted_json_upper(_d, _o) fputs_quoted_case_json(_d, _o, 1)
-#define fputs_quoted_json_lower(_d, _o) fputs_quoted_case_json(_d, _o, -1)
+#define fputs_quoted_json(_d, _f)       fputs_quoted_case_json(_d, _f, 0)
+#define fputs_quoted_json_upper(_d, _f) fputs_quoted_case_json(_d, _f, 1)
+#define fputs_quoted_json_lower(_d, _f) fputs_quoted_case_json(_d, _f, -1)
 
 void ul_jsonwrt_init(struct ul_jsonwrt *fmt, FILE *out, int indent)
 {
+	memset(fmt, 0, sizeof(*fmt));
 	fmt->out = out;
 	fmt->indent = indent;
 	fmt->after_close = 0;
 }
 
+/*
+ * Enables the buffered mode: the output is written to the stream at once
+ * for every object (a table row) and the escaped object keys are cached
+ * -- the @name pointers are usually the same for all the rows. The caller
+ * must not write to the stream between ul_jsonwrt_*() calls without
+ * ul_jsonwrt_flush(), and has to call ul_jsonwrt_deinit() at the end.
+ */
+void ul_jsonwrt_set_buffered(struct ul_jsonwrt *fmt, int enable)
+{
+	if (!enable)
+		ul_jsonwrt_flush(fmt);
+	fmt->buffered = enable ? 1 : 0;
+}
+
+/*
+ * Enables the compact mode: no indentation and no newlines, the newline is
+ * written only after the top-level object. It's usable for newline-delimited
+ * JSON (every top-level object on a separate line).
+ */
+void ul_jsonwrt_set_compact(struct ul_jsonwrt *fmt, int enable)
+{
+	fmt->compact = enable ? 1 : 0;
+}
+
+void ul_jsonwrt_flush(struct ul_jsonwrt *fmt)
+{
+	size_t sz = 0;
+	char *data;
+
+	if (!fmt->buffered)
+		return;
+	data = ul_buffer_get_data(&fmt->buf, &sz, NULL);
+	if (data && sz)
+		fwrite(data, 1, sz, fmt->out);
+	ul_buffer_reset_data(&fmt->buf);
+}
+
+void ul_jsonwrt_deinit(struct ul_jsonwrt *fmt)
+{
+	size_t i;
+
+	ul_jsonwrt_flush(fmt);
+	ul_buffer_free_data(&fmt->buf);
+
+	for (i = 0; fmt->keys && i < UL_JSONWRT_NKEYS; i++) {
+		free(fmt->keys[i].orig);
+		free(fmt->keys[i].quoted);
+	}
+	free(fmt->keys);
+	fmt->keys = NULL;
+	fmt->buffered = 0;
+}
+
+/* writes the object key, cached in the buffered mode */
+static void json_write_key(struct ul_jsonwrt *fmt, const char *name)
+{
+	struct ul_jsonwrt_key *k = NULL;
+	size_t i, h, off = 0;
+
+	if (fmt->buffered) {
+		if (!fmt->keys)
+			fmt->keys = calloc(UL_JSONWRT_NKEYS, sizeof(struct ul_jsonwrt_key));
+
+		h = ((uintptr_t) name >> 3) % UL_JSONWRT_NKEYS;
+		for (i = 0; fmt->keys && i < UL_JSONWRT_NKEYS; i++) {
+			k = &fmt->keys[(h + i) % UL_JSONWRT_NKEYS];
+			if (!k->name)
+				break;		/* unused */
+			if (k->name == name && strcmp(k->orig, name) == 0) {
+				json_write(fmt, k->quoted, k->len);
+				return;
+			}
+			k = NULL;
+		}
+		ul_buffer_get_data(&fmt->buf, &off, NULL);
+	}
+
+	fputs_quoted_json_lower(name, fmt);
+
+	/* add to the cache */
+	if (k) {
+		size_t sz = 0;
+		char *data = ul_buffer_get_data(&fmt->buf, &sz, NULL);
+
+		if (!data || sz <= off)
+			return;
+		k->orig = strdup(name);
+		k->quoted = malloc(sz - off);
+		if (!k->orig || !k->quoted) {
+			free(k->orig);
+			free(k->quoted);
+			k->orig = k->quoted = NULL;
+			return;
+		}
+		memcpy(k->quoted, data + off, sz - off);
+		k->len = sz - off;
+		k->name = name;
+	}
+}
+
 void ul_jsonwrt_indent(struct ul_jsonwrt *fmt)
 {
-	int i;
+	static const char spaces[] = "                        ";
+	size_t n = fmt->indent * 3;
 
-	for (i = 0; i < fmt->indent; i++)
-		fputs("   ", fmt->out);
+	if (fmt->compact)
+		return;
+	while (n > 0) {
+		size_t x = min(n, sizeof(spaces) - 1);
+
+		json_write(fmt, spaces, x);
+		n -= x;
+	}
 }
 
 void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 {
 	if (name) {
 		if (fmt->after_close)
-			fputs(",\n", fmt->out);
+			json_puts(fmt, fmt->compact ? "," : ",\n");
 		ul_jsonwrt_indent(fmt);
-		fputs_quoted_json_lower(name, fmt->out);
+		json_write_key(fmt, name);
 	} else {
 		if (fmt->after_close)
-			fputs(",", fmt->out);
+			json_puts(fmt, ",");
 		else
 			ul_jsonwrt_indent(fmt);
 	}
 
+	if (fmt->compact) {
+		if (name)
+			json_putc(fmt, ':');
+		if (type == UL_JSON_OBJECT)
+			json_putc(fmt, '{');
+		else if (type == UL_JSON_ARRAY)
+			json_putc(fmt, '[');
+		if (type != UL_JSON_VALUE)
+			fmt->indent++;
+		fmt->after_close = 0;
+		return;
+	}
+
 	switch (type) {
 	case UL_JSON_OBJECT:
-		fputs(name ? ": {\n" : "{\n", fmt->out);
+		json_puts(fmt, name ? ": {\n" : "{\n");
 		fmt->indent++;
 		break;
 	case UL_JSON_ARRAY:
-		fputs(name ? ": [\n" : "[\n", fmt->out);
+		json_puts(fmt, name ? ": [\n" : "[\n");
 		fmt->indent++;
 		break;
 	case UL_JSON_VALUE:
-		fputs(name ? ": " : " ", fmt->out);
+		json_puts(fmt, name ? ": " : " ");
 		break;
 	}
 	fmt->after_close = 0;
@@ -149,10 +330,12 @@ void ul_jsonwrt_open(struct ul_jsonwrt *fmt, const char *name, int type)
 
 void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 {
-	if (fmt->indent == 1) {
-		fputs("\n}\n", fmt->out);
+	if (fmt->indent == 1 && type != UL_JSON_VALUE) {
+		json_puts(fmt, fmt->compact ? "}\n" : "\n}\n");
 		fmt->indent--;
-		fmt->after_close = 1;
+		/* compact root objects are independent records (NDJSON) */
+		fmt->after_close = fmt->compact ? 0 : 1;
+		ul_jsonwrt_flush(fmt);
 		return;
 	}
 	assert(fmt->indent > 0);
@@ -160,21 +343,27 @@ void ul_jsonwrt_close(struct ul_jsonwrt *fmt, int type)
 	switch (type) {
 	case UL_JSON_OBJECT:
 		fmt->indent--;
-		fputc('\n', fmt->out);
+		if (!fmt->compact)
+			json_putc(fmt, '\n');
 		ul_jsonwrt_indent(fmt);
-		fputs("}", fmt->out);
+		json_putc(fmt, '}');
 		break;
 	case UL_JSON_ARRAY:
 		fmt->indent--;
-		fputc('\n', fmt->out);
+		if (!fmt->compact)
+			json_putc(fmt, '\n');
 		ul_jsonwrt_indent(fmt);
-		fputs("]", fmt->out);
+		json_putc(fmt, ']');
 		break;
 	case UL_JSON_VALUE:
 		break;
 	}
 
 	fmt->after_close = 1;
+
+	/* a complete top-level object (e.g. table row) */
+	if (type != UL_JSON_VALUE && fmt->indent <= 2)
+		ul_jsonwrt_flush(fmt);
 }
 
 void ul_jsonwrt_value_raw(struct ul_jsonwrt *fmt,
@@ -182,9 +371,9 @@ void ul_jsonwrt_value_raw(struct ul_jsonwrt *fmt,
 {
 	ul_jsonwrt_value_open(fmt, name);
 	if (data && *data)
-		fputs(data, fmt->out);
+		json_puts(fmt, data);
 	else
-		fputs("null", fmt->out);
+		json_puts(fmt, "null");
 	ul_jsonwrt_value_close(fmt);
 }
 
@@ -193,17 +382,19 @@ void ul_jsonwrt_value_s(struct ul_jsonwrt *fmt,
 {
 	ul_jsonwrt_value_open(fmt, name);
 	if (data && *data)
-		fputs_quoted_json(data, fmt->out);
+		fputs_quoted_json(data, fmt);
 	else
-		fputs("null", fmt->out);
+		json_puts(fmt, "null");
 	ul_jsonwrt_value_close(fmt);
 }
 
 void ul_jsonwrt_value_u64(struct ul_jsonwrt *fmt,
 			const char *name, uint64_t data)
 {
+	char num[sizeof(stringify_value(UINT64_MAX))];
+
 	ul_jsonwrt_value_open(fmt, name);
-	fprintf(fmt->out, "%"PRIu64, data);
+	json_write(fmt, num, ul_u64_to_dec(num, data));
 	ul_jsonwrt_value_close(fmt);
 }
 
@@ -211,7 +402,7 @@ void ul_jsonwrt_value_boolean(struct ul_jsonwrt *fmt,
 			const char *name, int data)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	fputs(data ? "true" : "false", fmt->out);
+	json_puts(fmt, data ? "true" : "false");
 	ul_jsonwrt_value_close(fmt);
 }
 
@@ -219,6 +410,6 @@ void ul_jsonwrt_value_null(struct ul_jsonwrt *fmt,
 			const char *name)
 {
 	ul_jsonwrt_value_open(fmt, name);
-	fputs("null", fmt->out);
+	json_puts(fmt, "null");
 	ul_jsonwrt_value_close(fmt);
 }
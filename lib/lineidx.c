@@ -0,0 +1,123 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * Line offsets index for pagers. The deltas between lines are usually
+ * small, so they are stored as LEB128 varints (7 bits per byte, the top
+ * bit set on all but the last byte) -- one or two bytes per line for
+ * common text files.
+ */
+#include <errno.h>
+#include <string.h>
+
+#include "lineidx.h"
+#include "xalloc.h"
+
+void ul_lineidx_reset(struct ul_lineidx *idx)
+{
+	free(idx->marks);
+	free(idx->data);
+	memset(idx, 0, sizeof(*idx));
+}
+
+int ul_lineidx_add(struct ul_lineidx *idx, off_t offset)
+{
+	uint64_t delta;
+
+	if (idx->nlines && offset < idx->last)
+		return -EINVAL;
+
+	if (idx->nlines % UL_LINEIDX_STEP == 0) {
+		struct ul_lineidx_mark *m;
+
+		if (idx->nmarks % 1024 == 0)
+			idx->marks = xrealloc(idx->marks,
+					(idx->nmarks + 1024) * sizeof(*m));
+		m = &idx->marks[idx->nmarks++];
+		m->offset = offset;
+		m->data_off = idx->datalen;
+		goto done;
+	}
+
+	/* the longest varint of a 64-bit number is 10 bytes */
+	if (idx->datasz - idx->datalen < 10) {
+		idx->datasz = idx->datasz ? idx->datasz * 2 : 4096;
+		idx->data = xrealloc(idx->data, idx->datasz);
+	}
+
+	delta = offset - idx->last;
+	while (delta >= 0x80) {
+		idx->data[idx->datalen++] = (delta & 0x7f) | 0x80;
+		delta >>= 7;
+	}
+	idx->data[idx->datalen++] = delta;
+done:
+	idx->last = offset;
+	idx->nlines++;
+	return 0;
+}
+
+/*
+ * Returns offset of the line @n (counted from zero) or -EINVAL if the
+ * line is not indexed yet.
+ */
+int ul_lineidx_get(struct ul_lineidx *idx, size_t n, off_t *offset)
+{
+	const struct ul_lineidx_mark *m;
+	const unsigned char *p;
+	size_t i;
+	off_t off;
+
+	if (n >= idx->nlines)
+		return -EINVAL;
+
+	m = &idx->marks[n / UL_LINEIDX_STEP];
+	off = m->offset;
+	p = idx->data + m->data_off;
+
+	for (i = n % UL_LINEIDX_STEP; i > 0; i--) {
+		uint64_t delta = 0;
+		int shift = 0;
+
+		do {
+			delta |= (uint64_t) (*p & 0x7f) << shift;
+			shift += 7;
+		} while (*p++ & 0x80);
+		off += delta;
+	}
+
+	*offset = off;
+	return 0;
+}
+
+#ifdef TEST_PROGRAM_LINEIDX
+int main(int argc, char *argv[])
+{
+	struct ul_lineidx idx = UL_INIT_LINEIDX;
+	size_t i, n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+	off_t off = 0;
+
+	for (i = 0; i < n; i++) {
+		if (ul_lineidx_add(&idx, off) != 0)
+			errx(EXIT_FAILURE, "cannot add line %zu", i);
+		/* mix short and very long lines */
+		off += i % 1000 == 0 ? (off_t) i << 20 : (off_t) (i % 97);
+	}
+
+	off = 0;
+	for (i = 0; i < n; i++) {
+		off_t x;
+
+		if (ul_lineidx_get(&idx, i, &x) != 0 || x != off)
+			errx(EXIT_FAILURE, "line %zu: bad offset", i);
+		off += i % 1000 == 0 ? (off_t) i << 20 : (off_t) (i % 97);
+	}
+	if (ul_lineidx_get(&idx, n, &off) == 0)
+		errx(EXIT_FAILURE, "line %zu is not expected in the index", n);
+
+	printf("%zu lines, %zu bytes of deltas, %zu marks\n",
+			n, idx.datalen, idx.nmarks);
+	ul_lineidx_reset(&idx);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_LINEIDX */
@@ -215,6 +215,11 @@ void loopcxt_deinit(struct loopdev_cxt *lc)
 	ignore_result( loopcxt_set_device(lc, NULL) );
 	loopcxt_deinit_iterator(lc);
 
+	if (lc->ctl_fd >= 0) {
+		close(lc->ctl_fd);
+		lc->ctl_fd = -1;
+	}
+
 	errno = errsv;
 }
 
@@ -1552,6 +1557,20 @@ int loopcxt_delete_device(struct loopdev_cxt *lc)
 	return 0;
 }
 
+/*
+ * Returns /dev/loop-control file descriptor. The file is open on the first
+ * call and then kept open until loopcxt_deinit(), so setup of more devices
+ * by the same context does not need to open it again and again.
+ */
+static int loopcxt_get_ctl_fd(struct loopdev_cxt *lc)
+{
+	if (lc->ctl_fd < 0) {
+		lc->ctl_fd = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
+		DBG(CXT, ul_debugobj(lc, "open %s [fd=%d]", _PATH_DEV_LOOPCTL, lc->ctl_fd));
+	}
+	return lc->ctl_fd;
+}
+
 int loopcxt_add_device(struct loopdev_cxt *lc)
 {
 	int rc = -EINVAL;
@@ -1571,11 +1590,10 @@ int loopcxt_add_device(struct loopdev_cxt *lc)
 	       || nr < 0)
 		goto done;
 
-	ctl = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
+	ctl = loopcxt_get_ctl_fd(lc);
 	if (ctl >= 0) {
 		DBG(CXT, ul_debugobj(lc, "add_device %d", nr));
 		rc = ioctl(ctl, LOOP_CTL_ADD, nr);
-		close(ctl);
 	}
 	lc->control_ok = rc >= 0 ? 1 : 0;
 done:
@@ -1600,7 +1618,7 @@ int loopcxt_find_unused(struct loopdev_cxt *lc)
 
 		DBG(CXT, ul_debugobj(lc, "using loop-control"));
 
-		ctl = open(_PATH_DEV_LOOPCTL, O_RDWR|O_CLOEXEC);
+		ctl = loopcxt_get_ctl_fd(lc);
 		if (ctl >= 0)
 			rc = ioctl(ctl, LOOP_CTL_GET_FREE);
 		if (rc >= 0) {
@@ -1610,8 +1628,6 @@ int loopcxt_find_unused(struct loopdev_cxt *lc)
 			rc = loopiter_set_device(lc, name);
 		}
 		lc->control_ok = ctl >= 0 && rc == 0 ? 1 : 0;
-		if (ctl >= 0)
-			close(ctl);
 		DBG(CXT, ul_debugobj(lc, "find_unused by loop-control [rc=%d]", rc));
 	}
 
@@ -1885,6 +1901,59 @@ int loopdev_count_by_backing_file(const char *filename, char **loopdev)
 	return count;
 }
 
+/*
+ * @filename: backing file
+ * @mode: O_RDONLY or O_RDWR
+ * @align: returns logical sector size of the device with the backing file
+ *
+ * Checks if the backing file may be opened with O_DIRECT (not supported for
+ * example on tmpfs) and returns the alignment required by the device.
+ *
+ * Returns: 0 if direct I/O is possible, <0 on error.
+ */
+int loopdev_get_dio_alignment(const char *filename, int mode, uint64_t *align)
+{
+	struct stat st;
+	int fd, sz = 0, rc = 0;
+
+	fd = open(filename, mode | O_DIRECT | O_CLOEXEC);
+	if (fd < 0 && mode != O_RDONLY && (errno == EROFS || errno == EACCES))
+		fd = open(filename, O_RDONLY | O_DIRECT | O_CLOEXEC);
+	if (fd < 0) {
+		DBG(SETUP, ul_debug("%s: O_DIRECT open failed: %m", filename));
+		return -errno;
+	}
+
+	if (fstat(fd, &st) != 0) {
+		rc = -errno;
+		goto done;
+	}
+
+	if (S_ISBLK(st.st_mode)) {
+		if (blkdev_get_sector_size(fd, &sz) != 0)
+			sz = 0;
+	} else {
+		struct path_cxt *pc = ul_new_sysfs_path(st.st_dev, NULL, NULL);
+		dev_t disk = 0;
+
+		/* partitions do not have queue/ directory */
+		if (pc && sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk) == 0
+		    && (disk == st.st_dev || sysfs_blkdev_init_path(pc, disk, NULL) == 0)
+		    && ul_path_read_s32(pc, &sz, "queue/logical_block_size") != 0)
+			sz = 0;
+		ul_unref_path(pc);
+	}
+
+	/* unknown (e.g. network filesystem); the kernel checks it again */
+	*align = sz > 0 ? (uint64_t) sz : 512;
+
+	DBG(SETUP, ul_debug("%s: direct I/O possible [align=%"PRIu64"]",
+				filename, *align));
+done:
+	close(fd);
+	return rc;
+}
+
 #ifdef TEST_PROGRAM_LOOPDEV
 int main(int argc, char *argv[])
 {
@@ -49,24 +49,40 @@ char *mangle(const char *s)
 }
 
 
+/*
+ * Copies @s to @buf and decodes \oct escapes. The spans without a backslash
+ * are copied at once, the strings from mountinfo rarely contain any escape.
+ * @buf may be the same as @s.
+ */
 void unmangle_to_buffer(const char *s, char *buf, size_t len)
 {
-	size_t sz = 0;
+	const char *end;
 
 	if (!s)
 		return;
 
-	while(*s && sz < len - 1) {
-		if (*s == '\\' && sz + 3 < len - 1 && isoctal(s[1]) &&
+	end = s + strnlen(s, len - 1);
+
+	while (s < end) {
+		const char *bs = memchr(s, '\\', end - s);
+		size_t sz = (bs ? bs : end) - s;
+
+		if (sz) {
+			if (buf != s)
+				memmove(buf, s, sz);
+			buf += sz;
+			s += sz;
+			if (!bs)
+				break;
+		}
+
+		if (end - s > 3 && isoctal(s[1]) &&
 		    isoctal(s[2]) && isoctal(s[3])) {
 
 			*buf++ = 64*(s[1] & 7) + 8*(s[2] & 7) + (s[3] & 7);
 			s += 4;
-			sz += 4;
-		} else {
+		} else
 			*buf++ = *s++;
-			sz++;
-		}
 	}
 	*buf = '\0';
 }
@@ -97,9 +113,7 @@ size_t unhexmangle_to_buffer(const char *s, char *buf, size_t len)
 
 static inline const char *skip_nonspaces(const char *s)
 {
-	while (s && *s && !(*s == ' ' || *s == '\t'))
-		s++;
-	return s;
+	return s ? s + strcspn(s, " \t") : s;
 }
 
 /*
@@ -22,12 +22,46 @@
 #include <stdbool.h>
 #include <limits.h>
 #include <ctype.h>
+#include <stdint.h>
 
 #include "c.h"
 #include "mbsalign.h"
 #include "strutils.h"
 #include "widechar.h"
 
+/*
+ * Returns the number of leading printable ASCII chars in @buf, at most
+ * @bufsz. A backslash stops the span as it may be the begin of a "\x"
+ * sequence. The usual strings are pure ASCII, so check whole words at once
+ * and decode by mbrtowc() only the rest.
+ */
+#define ONES		(~(uintptr_t) 0 / 0xff)
+#define HIGHS		(ONES * 0x80)
+#define HAS_ZERO(w)	(((w) - ONES) & ~(w) & HIGHS)
+#define HAS_LESS(w, n)	(((w) - ONES * (n)) & ~(w) & HIGHS)
+
+static size_t ascii_span(const char *buf, size_t bufsz)
+{
+	size_t i = 0;
+
+	for (; i + sizeof(uintptr_t) <= bufsz; i += sizeof(uintptr_t)) {
+		uintptr_t w;
+
+		memcpy(&w, buf + i, sizeof(w));
+		if ((w & HIGHS) || HAS_LESS(w, 0x20)
+		    || HAS_ZERO(w ^ (ONES * 0x7f))
+		    || HAS_ZERO(w ^ (ONES * '\\')))
+			break;
+	}
+	for (; i < bufsz; i++) {
+		unsigned char c = buf[i];
+
+		if (c < 0x20 || c >= 0x7f || c == '\\')
+			break;
+	}
+	return i;
+}
+
 /*
  * Counts number of cells in multibyte string. All control and
  * non-printable chars are ignored.
@@ -47,6 +81,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		size_t n = ascii_span(p, last - p + 1);
+
+		if (n) {
+			width += n;
+			p += n;
+			continue;
+		}
 		if (iscntrl((unsigned char) *p)) {
 			p++;
 
@@ -66,12 +107,13 @@ size_t mbs_nwidth(const char *buf, size_t bufsz)
 
 		if (len == 0)
 			break;
-		if (len > 0 && iswprint(wc)) {
+		if (len == (size_t) -1 || len == (size_t) -2)
+			len = 1;
+		else if (iswprint(wc)) {
 			int x = wcwidth(wc);
 			if (x > 0)
 				width += x;
-		} else if (len == (size_t) -1 || len == (size_t) -2)
-			len = 1;
+		}
 		p += len;
 #else
 		if (isprint((unsigned char) *p))
@@ -110,6 +152,13 @@ size_t mbs_safe_nwidth(const char *buf, size_t bufsz, size_t *sz)
 		last = p + (bufsz - 1);
 
 	while (p && *p && p <= last) {
+		size_t n = ascii_span(p, last - p + 1);
+
+		if (n) {
+			width += n, bytes += n;
+			p += n;
+			continue;
+		}
 		if ((p < last && *p == '\\' && *(p + 1) == 'x')
 		    || iscntrl((unsigned char) *p)) {
 			width += 4, bytes += 4;		/* *p encoded to \x?? */
@@ -187,6 +236,14 @@ char *mbs_safe_encode_to_buffer(const char *s, size_t *width, char *buf, const c
 	*width = 0;
 
 	while (p && *p) {
+		size_t n = ascii_span(p, sz - (p - s));
+
+		if (n) {
+			memcpy(r, p, n);
+			r += n, p += n;
+			*width += n;
+			continue;
+		}
 		if (safechars && strchr(safechars, *p)) {
 			*r++ = *p++;
 			continue;
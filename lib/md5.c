@@ -90,6 +90,16 @@ void ul_MD5Update(struct UL_MD5Context *ctx, unsigned char const *buf, unsigned
     }
     /* Process data in 64-byte chunks */
 
+#if !defined(WORDS_BIGENDIAN)
+    /* Aligned input does not need to be copied on little-endian */
+    if (((uintptr_t) buf & (sizeof(uint32_t) - 1)) == 0) {
+	while (len >= 64) {
+	    ul_MD5Transform(ctx->buf, (uint32_t const *) buf);
+	    buf += 64;
+	    len -= 64;
+	}
+    }
+#endif
     while (len >= 64) {
 	memcpy(ctx->in, buf, 64);
 	byteReverse(ctx->in, 16);
@@ -253,5 +263,168 @@ void ul_MD5Transform(uint32_t buf[4], uint32_t const in[16])
     buf[3] += d;
 }
 
-#endif
+/*
+ * Multi-buffer MD5
+ *
+ * The messages are hashed UL_MD5_LANES at once, every lane is one element
+ * of a vector (SSE2 or NEON register for 4 lanes). It's faster than the
+ * single-stream code for many small messages (UUIDs, cookies, ...). The
+ * messages may be of different sizes.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+typedef uint32_t md5_lanes_t __attribute__((vector_size(UL_MD5_LANES * sizeof(uint32_t))));
+
+#define MD5_ROL(x, s)	((x) << (s) | (x) >> (32 - (s)))
+
+static const uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+/* index of the input word used by the step */
+static const unsigned char md5_g[64] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    1, 6, 11, 0, 5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12,
+    5, 8, 11, 14, 1, 4, 7, 10, 13, 0, 3, 6, 9, 12, 15, 2,
+    0, 7, 14, 5, 12, 3, 10, 1, 8, 15, 6, 13, 4, 11, 2, 9
+};
+
+static const unsigned char md5_s[4][4] = {
+    { 7, 12, 17, 22 }, { 5, 9, 14, 20 }, { 4, 11, 16, 23 }, { 6, 10, 15, 21 }
+};
+
+#define MD5_LANES_ROUND(f, r) \
+    for (j = (r) * 16; j < (r) * 16 + 16; j++) { \
+	md5_lanes_t t = a + f(b, c, d) + md5_k[j] + in[md5_g[j]]; \
+	unsigned s = md5_s[r][j & 3]; \
+	a = d; \
+	d = c; \
+	c = b; \
+	b += MD5_ROL(t, s); \
+    }
+
+/* updates the lanes in @mask (all bits set or zero) */
+static void md5_transform_lanes(md5_lanes_t st[4], md5_lanes_t const in[16],
+				md5_lanes_t mask)
+{
+    md5_lanes_t a = st[0], b = st[1], c = st[2], d = st[3];
+    unsigned j;
+
+    MD5_LANES_ROUND(F1, 0);
+    MD5_LANES_ROUND(F2, 1);
+    MD5_LANES_ROUND(F3, 2);
+    MD5_LANES_ROUND(F4, 3);
+
+    st[0] += a & mask;
+    st[1] += b & mask;
+    st[2] += c & mask;
+    st[3] += d & mask;
+}
+
+/* returns the @blk-th block of the padded message as little-endian words */
+static void md5_get_block(md5_lanes_t in[16], unsigned lane,
+			  const unsigned char *data, size_t len, size_t blk)
+{
+    unsigned char block[64];
+    const unsigned char *p = block;
+    size_t off = blk * 64, n = 0;
+    unsigned i;
+
+    if (off + 64 <= len)
+	p = data + off;		/* the whole block is in the message */
+    else {
+	if (off < len) {
+	    n = len - off;
+	    memcpy(block, data + off, n);
+	}
+	memset(block + n, 0, 64 - n);
+
+	if (off <= len)
+	    block[len - off] = 0x80;
+	if (blk == (len + 8) / 64) {
+	    uint64_t bits = (uint64_t) len << 3;
+
+	    for (i = 0; i < 8; i++)
+		block[56 + i] = bits >> (i * 8);
+	}
+    }
 
+    for (i = 0; i < 16; i++, p += 4)
+	in[i][lane] = (uint32_t) p[0] | (uint32_t) p[1] << 8 |
+		      (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+/*
+ * Calculates MD5 digests of @n messages, @data[x] of @len[x] bytes; the
+ * result is the same as ul_MD5Init(), ul_MD5Update() and ul_MD5Final() for
+ * each message.
+ */
+void ul_MD5Multi(unsigned char digest[][UL_MD5LENGTH],
+		 const unsigned char *const data[], const size_t len[], size_t n)
+{
+    size_t first;
+
+    for (first = 0; first < n; first += UL_MD5_LANES) {
+	md5_lanes_t st[4], in[16], mask;
+	size_t nblks[UL_MD5_LANES], maxblks = 0, blk;
+	unsigned i, j, nlanes = n - first < UL_MD5_LANES ? n - first : UL_MD5_LANES;
+
+	for (i = 0; i < UL_MD5_LANES; i++) {
+	    st[0][i] = 0x67452301;
+	    st[1][i] = 0xefcdab89;
+	    st[2][i] = 0x98badcfe;
+	    st[3][i] = 0x10325476;
+	    nblks[i] = i < nlanes ? (len[first + i] + 8) / 64 + 1 : 0;
+	    if (nblks[i] > maxblks)
+		maxblks = nblks[i];
+	}
+
+	for (blk = 0; blk < maxblks; blk++) {
+	    for (i = 0; i < UL_MD5_LANES; i++) {
+		mask[i] = blk < nblks[i] ? 0xffffffff : 0;
+		if (mask[i])
+		    md5_get_block(in, i, data[first + i], len[first + i], blk);
+		else
+		    for (j = 0; j < 16; j++)
+			in[j][i] = 0;
+	    }
+	    md5_transform_lanes(st, in, mask);
+	}
+
+	for (i = 0; i < nlanes; i++) {
+	    for (j = 0; j < UL_MD5LENGTH; j++)
+		digest[first + i][j] = st[j / 4][i] >> ((j % 4) * 8);
+	}
+    }
+}
+#else /* !__GNUC__ */
+void ul_MD5Multi(unsigned char digest[][UL_MD5LENGTH],
+		 const unsigned char *const data[], const size_t len[], size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+	struct UL_MD5Context ctx;
+
+	ul_MD5Init(&ctx);
+	ul_MD5Update(&ctx, data[i], len[i]);
+	ul_MD5Final(digest[i], &ctx);
+    }
+}
+#endif /* __GNUC__ */
+
+#endif /* !ASM_MD5 */
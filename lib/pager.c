@@ -18,6 +18,7 @@
 #include "xalloc.h"
 #include "nls.h"
 #include "ttyutils.h"
+#include "all-io.h"
 #include "pager.h"
 
 #define NULL_DEVICE	"/dev/null"
@@ -44,6 +45,32 @@ struct child_process {
 };
 static struct child_process pager_process;
 
+/*
+ * The pager is started only when the output does not fit to the terminal;
+ * until then stdout is replaced by a stream which keeps the output in
+ * memory. A short output is written to the terminal at the end, without
+ * fork and exec of the pager.
+ */
+struct lazy_pager {
+	FILE *org_stdout;	/* the original stdout */
+	FILE *stream;		/* stdout replacement */
+
+	char *data;		/* buffered output */
+	size_t len;
+	size_t sz;
+
+	int cols;		/* terminal size */
+	int lines;
+	int col;		/* current position of the output */
+	int line;
+
+	unsigned started:1,	/* the pager is running (or failed to start) */
+		 eof:1;		/* the output has been finished */
+};
+static struct lazy_pager lazy_pager;
+
+#define LAZY_PAGER_BUFSIZ	(64 * 1024)
+
 static inline void close_pair(int fd[2])
 {
 	close(fd[0]);
@@ -69,7 +96,11 @@ static int start_command(struct child_process *cmd)
 		cmd->in = fdin[1];
 	}
 
-	fflush(NULL);
+	/* the lazy pager stream is flushed by the caller */
+	if (lazy_pager.stream)
+		fflush(stderr);
+	else
+		fflush(NULL);
 	cmd->pid = fork();
 	if (!cmd->pid) {
 		if (need_in) {
@@ -153,8 +184,12 @@ static void pager_preexec(void)
 		warn(_("failed to set the %s environment variable"), "LESS");
 }
 
+static void lazy_pager_finish(void);
+
 static void wait_for_pager(void)
 {
+	lazy_pager_finish();
+
 	if (pager_process.pid == 0)
 		return;
 
@@ -207,21 +242,26 @@ done:
 	return rc;
 }
 
-static void __setup_pager(void)
+static const char *get_pager(void)
 {
 	const char *pager = getenv("PAGER");
-	struct sigaction sa;
 
 	if (!isatty(STDOUT_FILENO))
-		return;
+		return NULL;
 
 	if (!pager)
 		pager = "less";
 	else if (!*pager || !strcmp(pager, "cat"))
-		return;
+		return NULL;
 
 	if (!has_command(pager))
-		return;
+		return NULL;
+	return pager;
+}
+
+static void __setup_pager(const char *pager)
+{
+	struct sigaction sa;
 
 	/* spawn the pager */
 	pager_argv[2] = pager;
@@ -249,14 +289,138 @@ static void __setup_pager(void)
 	sigaction(SIGPIPE, &sa, &pager_process.orig_sigpipe);
 }
 
+#ifdef HAVE_FOPENCOOKIE
+/* writes the buffered output to the pager or to the terminal */
+static int lazy_pager_flush(void)
+{
+	int rc = 0;
+
+	if (lazy_pager.len)
+		rc = write_all(STDOUT_FILENO, lazy_pager.data, lazy_pager.len);
+
+	free(lazy_pager.data);
+	lazy_pager.data = NULL;
+	lazy_pager.len = lazy_pager.sz = 0;
+	return rc;
+}
+
+/* returns 1 if the output does not fit to the terminal anymore */
+static int lazy_pager_account(const char *buf, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (buf[i] == '\n' || ++lazy_pager.col >= lazy_pager.cols) {
+			lazy_pager.col = 0;
+			/* keep the last line for the shell prompt */
+			if (++lazy_pager.line >= lazy_pager.lines - 1)
+				return 1;
+		}
+	}
+	return 0;
+}
+
+static ssize_t lazy_pager_write(void *cookie __attribute__((__unused__)),
+				const char *buf, size_t size)
+{
+	if (!lazy_pager.started && !lazy_pager_account(buf, size)) {
+		if (lazy_pager.len + size > lazy_pager.sz) {
+			lazy_pager.sz = max(lazy_pager.sz * 2, lazy_pager.len + size);
+			lazy_pager.data = xrealloc(lazy_pager.data, lazy_pager.sz);
+		}
+		memcpy(lazy_pager.data + lazy_pager.len, buf, size);
+		lazy_pager.len += size;
+		return size;
+	}
+
+	if (!lazy_pager.started) {
+		lazy_pager.started = 1;
+		__setup_pager(pager_argv[2]);
+		if (lazy_pager_flush() != 0)
+			return -1;
+	}
+
+	/* stdout is the pager (or the terminal if the pager failed) now */
+	if (write_all(STDOUT_FILENO, buf, size) != 0)
+		return -1;
+	return size;
+}
+
+static int lazy_pager_setup(const char *pager)
+{
+	cookie_io_functions_t io = { .write = lazy_pager_write };
+	FILE *f;
+
+	if (get_terminal_dimension(&lazy_pager.cols, &lazy_pager.lines) != 0
+	    || lazy_pager.cols <= 0 || lazy_pager.lines <= 0)
+		return -1;
+
+	f = fopencookie(NULL, "w", io);
+	if (!f)
+		return -1;
+	setvbuf(f, NULL, _IOFBF, LAZY_PAGER_BUFSIZ);
+
+	fflush(stdout);
+	pager_argv[2] = pager;
+	lazy_pager.org_stdout = stdout;
+	lazy_pager.stream = f;
+	stdout = f;
+	return 0;
+}
+
+/* restores stdout, the short output is written to the terminal */
+static void lazy_pager_finish(void)
+{
+	if (!lazy_pager.stream || lazy_pager.eof)
+		return;
+
+	fflush(lazy_pager.stream);
+	lazy_pager.eof = 1;
+	if (!lazy_pager.started)
+		lazy_pager_flush();
+
+	stdout = lazy_pager.org_stdout;
+}
+
+static void lazy_pager_close(void)
+{
+	lazy_pager_finish();
+	if (lazy_pager.stream)
+		fclose(lazy_pager.stream);
+	memset(&lazy_pager, 0, sizeof(lazy_pager));
+}
+#else
+static inline int lazy_pager_setup(const char *pager __attribute__((__unused__)))
+{
+	return -1;
+}
+static inline void lazy_pager_finish(void) { }
+static inline void lazy_pager_close(void) { }
+#endif /* HAVE_FOPENCOOKIE */
+
+static void setup_pager(void)
+{
+	const char *pager = get_pager();
+
+	if (!pager)
+		return;
+	if (lazy_pager_setup(pager) != 0)
+		__setup_pager(pager);
+}
+
+static int pager_is_active(void)
+{
+	return pager_process.pid || lazy_pager.stream;
+}
+
 /* Setup pager and redirects output to the $PAGER. The pager is closed at exit.
  */
 void pager_redirect(void)
 {
-	if (pager_process.pid)
+	if (pager_is_active())
 		return;		/* already running */
 
-	__setup_pager();
+	setup_pager();
 
 	atexit(wait_for_pager);
 }
@@ -265,23 +429,32 @@ void pager_redirect(void)
  */
 void pager_open(void)
 {
-	if (pager_process.pid)
+	if (pager_is_active())
 		return;		/* already running */
 
 	pager_process.org_out = dup(STDOUT_FILENO);
 	pager_process.org_err = dup(STDERR_FILENO);
 
-	__setup_pager();
+	setup_pager();
 }
 
 /* Close pager and restore original std{out,err}.
  */
 void pager_close(void)
 {
-	if (pager_process.pid == 0)
+	if (!pager_is_active())
 		return;
 
 	wait_for_pager();
+	lazy_pager_close();
+
+	if (pager_process.pid == 0) {
+		/* the output has been short, the pager not started */
+		close(pager_process.org_out);
+		close(pager_process.org_err);
+		memset(&pager_process, 0, sizeof(pager_process));
+		return;
+	}
 
 	/* restore original output */
 	dup2(pager_process.org_out, STDOUT_FILENO);
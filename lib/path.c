@@ -26,6 +26,7 @@
 #include "path.h"
 #include "debug.h"
 #include "strutils.h"
+#include "ulstats.h"
 
 /*
  * Debug stuff (based on include/debug.h)
@@ -56,6 +57,7 @@ struct path_cxt *ul_new_path(const char *dir, ...)
 	if (!pc)
 		return NULL;
 
+	ul_stats_init(NULL);
 	DBG(CXT, ul_debugobj(pc, "alloc"));
 
 	pc->refcount = 1;
@@ -95,6 +97,7 @@ void ul_unref_path(struct path_cxt *pc)
 		DBG(CXT, ul_debugobj(pc, "dealloc"));
 		if (pc->dialect)
 			pc->free_dialect(pc);
+		ul_path_enable_cache(pc, 0);
 		ul_path_close_dirfd(pc);
 		free(pc->dir_path);
 		free(pc->prefix);
@@ -116,6 +119,7 @@ int ul_path_set_prefix(struct path_cxt *pc, const char *prefix)
 
 	free(pc->prefix);
 	pc->prefix = p;
+	ul_path_invalidate_cache(pc);
 	DBG(CXT, ul_debugobj(pc, "new prefix: '%s'", p));
 	return 0;
 }
@@ -142,6 +146,7 @@ int ul_path_set_dir(struct path_cxt *pc, const char *dir)
 
 	free(pc->dir_path);
 	pc->dir_path = p;
+	ul_path_invalidate_cache(pc);
 	DBG(CXT, ul_debugobj(pc, "new dir: '%s'", p));
 	return 0;
 }
@@ -164,6 +169,180 @@ void *ul_path_get_dialect(struct path_cxt *pc)
 	return pc ? pc->dialect : NULL;
 }
 
+/*
+ * Cache of the read files. The tools which read sysfs or procfs as a
+ * snapshot may read the same file more times (e.g. for more output columns);
+ * the cache keeps the content (or the error) of the files read by
+ * ul_path_read() and the functions based on it.
+ *
+ * The entries are valid for the current generation only, the generation is
+ * incremented by ul_path_invalidate_cache() and by a write or a change of
+ * the directory or prefix.
+ */
+#define UL_PATH_CACHE_INITSZ	32
+
+struct ul_path_centry {
+	char		*path;
+	char		*data;		/* file content */
+	int		rc;		/* size of the content or -errno */
+	unsigned int	gen;		/* generation of the content */
+
+	struct ul_path_centry *next;
+};
+
+struct ul_path_cache {
+	struct ul_path_centry	**tab;	/* hash table */
+	size_t			tabsz;	/* number of buckets, power of 2 */
+	size_t			nents;	/* number of entries */
+	unsigned int		gen;	/* current generation */
+};
+
+static size_t cache_hash(const struct ul_path_cache *ca, const char *path)
+{
+	size_t h = 5381;
+
+	while (*path)
+		h = h * 33 + (unsigned char) *path++;
+	return h & (ca->tabsz - 1);
+}
+
+static void free_cache(struct ul_path_cache *ca)
+{
+	size_t i;
+
+	for (i = 0; i < ca->tabsz; i++) {
+		struct ul_path_centry *ce = ca->tab[i];
+
+		while (ce) {
+			struct ul_path_centry *next = ce->next;
+
+			free(ce->path);
+			free(ce->data);
+			free(ce);
+			ce = next;
+		}
+	}
+	free(ca->tab);
+	free(ca);
+}
+
+/*
+ * Enables (or disables and frees) the cache of the read files. The cache
+ * is freed together with @pc.
+ */
+int ul_path_enable_cache(struct path_cxt *pc, int enable)
+{
+	if (!pc)
+		return -EINVAL;
+
+	if (!enable) {
+		if (pc->cache)
+			free_cache(pc->cache);
+		pc->cache = NULL;
+		return 0;
+	}
+	if (pc->cache)
+		return 0;
+
+	pc->cache = calloc(1, sizeof(struct ul_path_cache));
+	if (!pc->cache)
+		return -ENOMEM;
+	pc->cache->tabsz = UL_PATH_CACHE_INITSZ;
+	pc->cache->tab = calloc(pc->cache->tabsz, sizeof(struct ul_path_centry *));
+	if (!pc->cache->tab) {
+		free(pc->cache);
+		pc->cache = NULL;
+		return -ENOMEM;
+	}
+	DBG(CXT, ul_debugobj(pc, "cache enabled"));
+	return 0;
+}
+
+/*
+ * Drops all cached data, the files will be read again. Use it in
+ * long-running modes before a new round of reading.
+ */
+void ul_path_invalidate_cache(struct path_cxt *pc)
+{
+	if (pc && pc->cache)
+		pc->cache->gen++;
+}
+
+static struct ul_path_centry *cache_lookup(struct ul_path_cache *ca, const char *path)
+{
+	struct ul_path_centry *ce;
+
+	for (ce = ca->tab[cache_hash(ca, path)]; ce; ce = ce->next) {
+		if (strcmp(ce->path, path) == 0)
+			return ce;
+	}
+	return NULL;
+}
+
+static void cache_grow(struct ul_path_cache *ca)
+{
+	struct ul_path_centry **old = ca->tab;
+	size_t i, oldsz = ca->tabsz;
+
+	ca->tabsz *= 2;
+	ca->tab = calloc(ca->tabsz, sizeof(struct ul_path_centry *));
+	if (!ca->tab) {
+		ca->tab = old;
+		ca->tabsz = oldsz;
+		return;
+	}
+	for (i = 0; i < oldsz; i++) {
+		struct ul_path_centry *ce = old[i];
+
+		while (ce) {
+			struct ul_path_centry *next = ce->next;
+			size_t h = cache_hash(ca, ce->path);
+
+			ce->next = ca->tab[h];
+			ca->tab[h] = ce;
+			ce = next;
+		}
+	}
+	free(old);
+}
+
+/* updates @ce or adds a new entry; returns NULL on error */
+static struct ul_path_centry *cache_store(struct ul_path_cache *ca,
+			struct ul_path_centry *ce, const char *path,
+			const char *data, int rc)
+{
+	char *x = NULL;
+
+	if (rc > 0) {
+		x = malloc(rc);
+		if (!x)
+			return NULL;
+		memcpy(x, data, rc);
+	}
+
+	if (!ce) {
+		ce = calloc(1, sizeof(*ce));
+		if (ce)
+			ce->path = strdup(path);
+		if (!ce || !ce->path) {
+			free(ce);
+			free(x);
+			return NULL;
+		}
+		if (ca->nents >= ca->tabsz)
+			cache_grow(ca);
+		ce->next = ca->tab[cache_hash(ca, path)];
+		ca->tab[cache_hash(ca, path)] = ce;
+		ca->nents++;
+	}
+
+	free(ce->data);
+	ce->data = x;
+	ce->rc = rc;
+	ce->gen = ca->gen;
+	return ce;
+}
+
 int ul_path_set_enoent_redirect(struct path_cxt *pc, int (*func)(struct path_cxt *, const char *, int *))
 {
 	pc->redirect_on_enoent = func;
@@ -220,6 +399,7 @@ int ul_path_get_dirfd(struct path_cxt *pc)
 			return -errno;
 
 		DBG(CXT, ul_debugobj(pc, "opening dir: '%s'", path));
+		UL_STATS_CALL(UL_STATS_OPEN);
 		pc->dir_fd = open(path, O_RDONLY|O_CLOEXEC);
 	}
 
@@ -305,6 +485,8 @@ int ul_path_access(struct path_cxt *pc, int mode, const char *path)
 {
 	int rc;
 
+	UL_STATS_CALL(UL_STATS_STAT);
+
 	if (!pc) {
 		rc = access(path, mode);
 		DBG(CXT, ul_debug("access '%s' [no context, rc=%d]", path, rc));
@@ -343,6 +525,8 @@ int ul_path_stat(struct path_cxt *pc, struct stat *sb, const char *path)
 {
 	int rc;
 
+	UL_STATS_CALL(UL_STATS_STAT);
+
 	if (!pc) {
 		rc = stat(path, sb);
 		DBG(CXT, ul_debug("stat '%s' [no context, rc=%d]", path, rc));
@@ -369,6 +553,8 @@ int ul_path_open(struct path_cxt *pc, int flags, const char *path)
 {
 	int fd;
 
+	UL_STATS_CALL(UL_STATS_OPEN);
+
 	if (!pc) {
 		fd = open(path, flags);
 		DBG(CXT, ul_debug("opening '%s' [no context]", path));
@@ -580,7 +766,7 @@ ssize_t ul_path_readlinkf(struct path_cxt *pc, char *buf, size_t bufsiz, const c
 	return !p ? -errno : ul_path_readlink(pc, buf, bufsiz, p);
 }
 
-int ul_path_read(struct path_cxt *pc, char *buf, size_t len, const char *path)
+static int read_file(struct path_cxt *pc, char *buf, size_t len, const char *path)
 {
 	int rc, errsv;
 	int fd;
@@ -591,6 +777,8 @@ int ul_path_read(struct path_cxt *pc, char *buf, size_t len, const char *path)
 
 	DBG(CXT, ul_debug(" reading '%s'", path));
 	rc = read_all(fd, buf, len);
+	UL_STATS_CALL(UL_STATS_READ);
+	UL_STATS_PATH_BYTES(pc ? pc->dir_path : path, rc);
 
 	errsv = errno;
 	close(fd);
@@ -598,6 +786,54 @@ int ul_path_read(struct path_cxt *pc, char *buf, size_t len, const char *path)
 	return rc;
 }
 
+static int read_file_cached(struct path_cxt *pc, char *buf, size_t len, const char *path)
+{
+	struct ul_path_cache *ca = pc->cache;
+	struct ul_path_centry *ce = cache_lookup(ca, path);
+	size_t sz;
+
+	if (!ce || ce->gen != ca->gen) {
+		char data[BUFSIZ];
+		int rc = read_file(pc, data, sizeof(data), path);
+
+		if (rc < 0)
+			rc = -errno;
+		/* don't cache large files, the content may be truncated */
+		else if ((size_t) rc == sizeof(data))
+			return read_file(pc, buf, len, path);
+
+		ce = cache_store(ca, ce, path, data, rc);
+		if (!ce) {
+			if (rc < 0)
+				return rc;
+			sz = min(len, (size_t) rc);
+			memset(buf, 0, len);
+			memcpy(buf, data, sz);
+			return sz;
+		}
+	} else
+		DBG(CXT, ul_debug(" cached '%s'", path));
+
+	if (ce->rc < 0) {
+		errno = -ce->rc;
+		return ce->rc;
+	}
+
+	/* like read_all() */
+	sz = min(len, (size_t) ce->rc);
+	memset(buf, 0, len);
+	if (sz)
+		memcpy(buf, ce->data, sz);
+	return sz;
+}
+
+int ul_path_read(struct path_cxt *pc, char *buf, size_t len, const char *path)
+{
+	if (pc && pc->cache)
+		return read_file_cached(pc, buf, len, path);
+	return read_file(pc, buf, len, path);
+}
+
 int ul_path_vreadf(struct path_cxt *pc, char *buf, size_t len, const char *path, va_list ap)
 {
 	const char *p = ul_path_mkpath(pc, path, ap);
@@ -696,6 +932,20 @@ int ul_path_scanf(struct path_cxt *pc, const char *path, const char *fmt, ...)
 	va_list fmt_ap;
 	int rc;
 
+	if (pc && pc->cache) {
+		char buf[BUFSIZ];
+
+		rc = ul_path_read(pc, buf, sizeof(buf) - 1, path);
+		if (rc < 0)
+			return -EINVAL;
+		buf[rc] = '\0';
+
+		va_start(fmt_ap, fmt);
+		rc = vsscanf(buf, fmt, fmt_ap);
+		va_end(fmt_ap);
+		return rc;
+	}
+
 	f = ul_path_fopen(pc, "r" UL_CLOEXECSTR, path);
 	if (!f)
 		return -EINVAL;
@@ -857,6 +1107,8 @@ int ul_path_write_string(struct path_cxt *pc, const char *str, const char *path)
 	int rc, errsv;
 	int fd;
 
+	ul_path_invalidate_cache(pc);
+
 	fd = ul_path_open(pc, O_WRONLY|O_CLOEXEC, path);
 	if (fd < 0)
 		return -errno;
@@ -887,6 +1139,8 @@ int ul_path_write_s64(struct path_cxt *pc, int64_t num, const char *path)
 	int rc, errsv;
 	int fd, len;
 
+	ul_path_invalidate_cache(pc);
+
 	fd = ul_path_open(pc, O_WRONLY|O_CLOEXEC, path);
 	if (fd < 0)
 		return -errno;
@@ -909,6 +1163,8 @@ int ul_path_write_u64(struct path_cxt *pc, uint64_t num, const char *path)
 	int rc, errsv;
 	int fd, len;
 
+	ul_path_invalidate_cache(pc);
+
 	fd = ul_path_open(pc, O_WRONLY|O_CLOEXEC, path);
 	if (fd < 0)
 		return -errno;
@@ -965,6 +1221,110 @@ int ul_path_countf_dirents(struct path_cxt *pc, const char *path, ...)
 	return !p ? -errno : ul_path_count_dirents(pc, p);
 }
 
+/*
+ * Reads all @nattrs attributes by one call. The attribute names are relative
+ * to @subdir (if not NULL) or to the @pc directory. The @subdir is opened only
+ * once and the files are opened by openat(), so no path is composed for the
+ * attributes. All the files are read into the same buffer.
+ *
+ * The result of the read is in ul_path_attr->rc (0 or negative errno) for
+ * each attribute. Strings are allocated (without the tailing newline) and
+ * have to be deallocated by the caller; empty string is returned as NULL.
+ *
+ * Returns number of successfully read attributes or negative errno if @subdir
+ * cannot be opened.
+ */
+int ul_path_read_attrs(struct path_cxt *pc, const char *subdir,
+		       struct ul_path_attr *attrs, size_t nattrs)
+{
+	char buf[BUFSIZ];
+	int dirfd = -1, count = 0;
+	size_t i;
+
+	if (subdir) {
+		int parent = pc ? ul_path_get_dirfd(pc) : AT_FDCWD;
+
+		if (parent < 0)
+			return parent;
+		if (pc && *subdir == '/')
+			subdir++;
+		UL_STATS_CALL(UL_STATS_OPEN);
+		dirfd = openat(parent, subdir, O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+		if (dirfd < 0)
+			return -errno;
+		DBG(CXT, ul_debugobj(pc, "reading %zu attributes from '%s'", nattrs, subdir));
+	}
+
+	for (i = 0; i < nattrs; i++) {
+		struct ul_path_attr *a = &attrs[i];
+		int fd, rc;
+
+		memset(&a->data, 0, sizeof(a->data));
+
+		if (pc && pc->cache) {
+			char path[PATH_MAX];
+
+			snprintf(path, sizeof(path), "%s%s%s", subdir ? subdir : "",
+					subdir ? "/" : "", a->name);
+			rc = ul_path_read(pc, buf, sizeof(buf) - 1, path);
+		} else {
+			if (dirfd >= 0)
+				UL_STATS_CALL(UL_STATS_OPEN);
+			fd = dirfd >= 0 ? openat(dirfd, a->name, O_RDONLY|O_CLOEXEC) :
+					  ul_path_open(pc, O_RDONLY|O_CLOEXEC, a->name);
+			if (fd < 0) {
+				a->rc = -errno;
+				continue;
+			}
+			rc = read_all(fd, buf, sizeof(buf) - 1);
+			UL_STATS_CALL(UL_STATS_READ);
+			UL_STATS_PATH_BYTES(pc ? pc->dir_path : subdir, rc);
+			if (rc < 0)
+				rc = -errno;
+			close(fd);
+		}
+
+		if (rc < 0) {
+			a->rc = rc;
+			continue;
+		}
+
+		/* Remove tailing newline (usual in sysfs) */
+		if (rc > 0 && buf[rc - 1] == '\n')
+			--rc;
+		buf[rc] = '\0';
+
+		switch (a->type) {
+		case UL_PATH_ATTR_STRING:
+			a->rc = 0;
+			if (rc > 0) {
+				a->data.str = strdup(buf);
+				if (!a->data.str)
+					a->rc = -ENOMEM;
+			}
+			break;
+		case UL_PATH_ATTR_U64:
+			a->rc = ul_strtou64(buf, &a->data.u64, 10);
+			break;
+		case UL_PATH_ATTR_S64:
+			a->rc = ul_strtos64(buf, &a->data.s64, 10);
+			break;
+		case UL_PATH_ATTR_S32:
+			a->rc = ul_strtos32(buf, &a->data.s32, 10);
+			break;
+		default:
+			a->rc = -EINVAL;
+			break;
+		}
+		if (a->rc == 0)
+			count++;
+	}
+
+	if (dirfd >= 0)
+		close(dirfd);
+	return count;
+}
+
 /*
  * Like fopen() but, @path is always prefixed by @prefix. This function is
  * useful in case when ul_path_* API is overkill.
@@ -1069,6 +1429,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(" read-string <file>         read string  from file\n", stdout);
 	fputs(" read-majmin <file>         read devno from file\n", stdout);
 	fputs(" read-link <file>           read symlink\n", stdout);
+	fputs(" read-attrs <file> ...      read strings from files by one call\n", stdout);
 	fputs(" write-string <file> <str>  write string from file\n", stdout);
 	fputs(" write-u64 <file> <str>     write uint64_t from file\n", stdout);
 
@@ -1221,6 +1582,30 @@ int main(int argc, char *argv[])
 			err(EXIT_FAILURE, "readf symlink failed");
 		printf("readf: %s: %s\n", file, res);
 
+	} else if (strcmp(command, "read-attrs") == 0) {
+		struct ul_path_attr *attrs;
+		size_t i, nattrs = argc - optind;
+
+		if (!nattrs)
+			errx(EXIT_FAILURE, "<file> not defined");
+		attrs = calloc(nattrs, sizeof(*attrs));
+		if (!attrs)
+			err(EXIT_FAILURE, "cannot allocate attributes");
+		for (i = 0; i < nattrs; i++)
+			attrs[i].name = argv[optind++];
+
+		if (ul_path_read_attrs(pc, NULL, attrs, nattrs) < 0)
+			err(EXIT_FAILURE, "read attributes failed");
+		for (i = 0; i < nattrs; i++) {
+			if (attrs[i].rc)
+				printf("read:  %s: [rc=%d]\n", attrs[i].name, attrs[i].rc);
+			else
+				printf("read:  %s: %s\n", attrs[i].name,
+					attrs[i].data.str ? attrs[i].data.str : "");
+			free(attrs[i].data.str);
+		}
+		free(attrs);
+
 	} else if (strcmp(command, "write-string") == 0) {
 		char *str;
 
@@ -15,10 +15,18 @@
 #include <sys/stat.h>
 #include <sys/vfs.h>
 #include <sys/types.h>
+#include <sys/ioctl.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <pwd.h>
+
+#ifdef HAVE_LINUX_NSFS_H
+# include <linux/nsfs.h>
+#endif
 
 #include "procutils.h"
+#include "namespace.h"
+#include "strutils.h"
 #include "statfs_magic.h"
 #include "fileutils.h"
 #include "all-io.h"
@@ -94,6 +102,69 @@ int proc_next_tid(struct proc_tasks *tasks, pid_t *tid)
 	return 0;
 }
 
+static int cmp_tid(const void *a, const void *b)
+{
+	pid_t x = *(const pid_t *) a, y = *(const pid_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*
+ * @pid: process ID
+ * @fn: function to call for each thread, non-zero return value stops the loop
+ * @data: data for @fn
+ *
+ * The list of the tasks is read again (until no new thread appears) to also
+ * get threads which have been created while the list was read.
+ *
+ * Returns: 0 on success, <0 on error, or the @fn return code
+ */
+int proc_foreach_task(pid_t pid, int (*fn)(pid_t, void *), void *data)
+{
+	pid_t *done = NULL, tid;
+	size_t ndone = 0, nsorted = 0, nalloc = 0, nnew;
+	int rc = 0, pass = 0;
+
+	do {
+		struct proc_tasks *tasks = proc_open_tasks(pid);
+
+		if (!tasks) {
+			if (!pass)
+				rc = -errno;
+			break;		/* the process is gone */
+		}
+		nnew = 0;
+
+		while (rc == 0 && proc_next_tid(tasks, &tid) == 0) {
+			if (nsorted && bsearch(&tid, done, nsorted,
+					       sizeof(pid_t), cmp_tid))
+				continue;
+			if (ndone == nalloc) {
+				pid_t *tmp;
+
+				nalloc = nalloc ? nalloc * 2 : 64;
+				tmp = realloc(done, nalloc * sizeof(pid_t));
+				if (!tmp) {
+					rc = -ENOMEM;
+					break;
+				}
+				done = tmp;
+			}
+			done[ndone++] = tid;
+			nnew++;
+			rc = fn(tid, data);
+		}
+		proc_close_tasks(tasks);
+
+		qsort(done, ndone, sizeof(pid_t), cmp_tid);
+		nsorted = ndone;
+		pass++;
+	} while (rc == 0 && nnew);
+
+	free(done);
+	return rc;
+}
+
 /* returns process command path, use free() for result */
 static char *proc_file_strdup(pid_t pid, const char *name)
 {
@@ -155,6 +226,8 @@ void proc_close_processes(struct proc_processes *ps)
 {
 	if (ps && ps->dir)
 		closedir(ps->dir);
+	if (ps)
+		free(ps->fltr_cgroup);
 	free(ps);
 }
 
@@ -170,6 +243,203 @@ void proc_processes_filter_by_uid(struct proc_processes *ps, uid_t uid)
 	ps->has_fltr_uid = 1;
 }
 
+/*
+ * @path: cgroup path as in /proc/<pid>/cgroup, e.g. "/system.slice"
+ *
+ * Processes in the cgroup and in all its sub-groups are returned.
+ */
+int proc_processes_filter_by_cgroup(struct proc_processes *ps, const char *path)
+{
+	size_t sz;
+
+	if (!path || *path != '/')
+		return -EINVAL;
+
+	free(ps->fltr_cgroup);
+	ps->fltr_cgroup = strdup(path);
+	if (!ps->fltr_cgroup)
+		return -ENOMEM;
+
+	/* "/foo/" and "/foo" are the same group */
+	sz = strlen(ps->fltr_cgroup);
+	while (sz > 1 && ps->fltr_cgroup[sz - 1] == '/')
+		ps->fltr_cgroup[--sz] = '\0';
+
+	ps->has_fltr_cgroup = 1;
+	return 0;
+}
+
+/*
+ * @file: namespace file, e.g. /proc/<pid>/ns/net or a bind mount of it
+ *
+ * Returns only processes in the same namespace. The type of the namespace
+ * is detected by NS_GET_NSTYPE ioctl.
+ */
+int proc_processes_filter_by_ns(struct proc_processes *ps, const char *file)
+{
+#ifdef NS_GET_NSTYPE
+	struct stat st;
+	int fd, type, rc = 0;
+
+	fd = open(file, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) != 0) {
+		rc = -errno;
+		goto done;
+	}
+
+	type = ioctl(fd, NS_GET_NSTYPE);
+	switch (type) {
+	case CLONE_NEWNS:	ps->fltr_nsname = "mnt"; break;
+	case CLONE_NEWCGROUP:	ps->fltr_nsname = "cgroup"; break;
+	case CLONE_NEWUTS:	ps->fltr_nsname = "uts"; break;
+	case CLONE_NEWIPC:	ps->fltr_nsname = "ipc"; break;
+	case CLONE_NEWUSER:	ps->fltr_nsname = "user"; break;
+	case CLONE_NEWPID:	ps->fltr_nsname = "pid"; break;
+	case CLONE_NEWNET:	ps->fltr_nsname = "net"; break;
+	case CLONE_NEWTIME:	ps->fltr_nsname = "time"; break;
+	default:
+		rc = type < 0 ? -errno : -EINVAL;
+		goto done;
+	}
+
+	ps->fltr_nsdev = st.st_dev;
+	ps->fltr_nsino = st.st_ino;
+	ps->has_fltr_ns = 1;
+done:
+	close(fd);
+	return rc;
+#else
+	(void) ps;
+	(void) file;
+	return -ENOSYS;
+#endif
+}
+
+/*
+ * @str: "name=<command>", "uid=<uid>", "user=<login>", "cgroup=<path>"
+ *       or "ns=<file>"
+ *
+ * Sets a filter from a string as used by --select options. All the filters
+ * have to match; a filter of the same type overrides the previous one.
+ *
+ * Returns: 0 on success, -EINVAL on unknown filter, or negative errno
+ */
+int proc_processes_add_filter(struct proc_processes *ps, const char *str)
+{
+	const char *val;
+
+	if (!ps || !str)
+		return -EINVAL;
+
+	if ((val = startswith(str, "name="))) {
+		if (!*val)
+			return -EINVAL;
+		proc_processes_filter_by_name(ps, val);
+		return 0;
+	}
+	if ((val = startswith(str, "uid="))) {
+		unsigned long num;
+		char *end = NULL;
+
+		errno = 0;
+		num = strtoul(val, &end, 10);
+		if (errno || end == val || *end || num != (uid_t) num)
+			return -EINVAL;
+		proc_processes_filter_by_uid(ps, (uid_t) num);
+		return 0;
+	}
+	if ((val = startswith(str, "user="))) {
+		struct passwd *pw = getpwnam(val);
+
+		if (!pw)
+			return -ENOENT;
+		proc_processes_filter_by_uid(ps, pw->pw_uid);
+		return 0;
+	}
+	if ((val = startswith(str, "cgroup=")))
+		return proc_processes_filter_by_cgroup(ps, val);
+	if ((val = startswith(str, "ns=")))
+		return proc_processes_filter_by_ns(ps, val);
+
+	return -EINVAL;
+}
+
+/* returns 1 if the process is in the cgroup (or below it) in any hierarchy */
+static int proc_is_in_cgroup_at(int dir, const char *pidstr, const char *cgroup)
+{
+	char buf[BUFSIZ], *line, *next;
+	size_t len = strlen(cgroup);
+	ssize_t sz;
+	int fd;
+
+	snprintf(buf, sizeof(buf), "%s/cgroup", pidstr);
+	fd = openat(dir, buf, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+	sz = read_all(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (sz <= 0)
+		return 0;
+	buf[sz] = '\0';
+
+	/* <id>:<controllers>:<path> */
+	for (line = buf; line && *line; line = next) {
+		char *path;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		path = strchr(line, ':');
+		if (path)
+			path = strchr(path + 1, ':');
+		if (!path)
+			continue;
+		path++;
+		if (strncmp(path, cgroup, len) != 0)
+			continue;
+		if (len == 1 || path[len] == '\0' || path[len] == '/')
+			return 1;
+	}
+	return 0;
+}
+
+/* returns 1 if the process is in the namespace */
+static int proc_is_in_ns_at(int dir, const char *pidstr, const char *nsname,
+			    dev_t dev, ino_t ino)
+{
+	char buf[PATH_MAX];
+	struct stat st;
+
+	snprintf(buf, sizeof(buf), "%s/ns/%s", pidstr, nsname);
+	if (fstatat(dir, buf, &st, 0) != 0)
+		return 0;
+	return st.st_dev == dev && st.st_ino == ino;
+}
+
+/* reads the process name from /proc/<pid>/comm; returns 0 on success */
+static int proc_read_comm_at(int dir, const char *pidstr, char *buf, size_t bufsz)
+{
+	ssize_t sz;
+	int fd;
+
+	snprintf(buf, bufsz, "%s/comm", pidstr);
+	fd = openat(dir, buf, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	sz = read_all(fd, buf, bufsz - 1);
+	close(fd);
+	if (sz <= 0)
+		return -EINVAL;
+
+	if (buf[sz - 1] == '\n')
+		sz--;
+	buf[sz] = '\0';
+	return 0;
+}
+
 int proc_next_pid(struct proc_processes *ps, pid_t *pid)
 {
 	struct dirent *d;
@@ -191,7 +461,10 @@ int proc_next_pid(struct proc_processes *ps, pid_t *pid)
 
 		if (!isdigit((unsigned char) *d->d_name))
 			continue;
-
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (d->d_type != DT_DIR && d->d_type != DT_UNKNOWN)
+			continue;
+#endif
 		/* filter out by UID */
 		if (ps->has_fltr_uid) {
 			struct stat st;
@@ -202,29 +475,29 @@ int proc_next_pid(struct proc_processes *ps, pid_t *pid)
 				continue;
 		}
 
-		/* filter out by NAME */
-		if (ps->has_fltr_name) {
-			char procname[256];
-			FILE *f;
-
-			snprintf(buf, sizeof(buf), "%s/stat", d->d_name);
-			f = fopen_at(dirfd(ps->dir), buf, O_CLOEXEC|O_RDONLY, "r");
-			if (!f)
-				continue;
-
-			p = fgets(buf, sizeof(buf), f);
-			fclose(f);
-			if (!p)
-				continue;
+		/* filter out by namespace; one stat() */
+		if (ps->has_fltr_ns
+		    && !proc_is_in_ns_at(dirfd(ps->dir), d->d_name,
+					 ps->fltr_nsname,
+					 ps->fltr_nsdev, ps->fltr_nsino))
+			continue;
 
-			if (sscanf(buf, "%*d (%255[^)])", procname) != 1)
+		/* filter out by NAME; the comm file is the same name as in
+		 * /proc/<pid>/stat, but much cheaper for kernel to generate */
+		if (ps->has_fltr_name) {
+			if (proc_read_comm_at(dirfd(ps->dir), d->d_name,
+					      buf, sizeof(buf)) != 0)
 				continue;
-
-			/* ok, we got the process name. */
-			if (strcmp(procname, ps->fltr_name) != 0)
+			if (strcmp(buf, ps->fltr_name) != 0)
 				continue;
 		}
 
+		/* filter out by cgroup */
+		if (ps->has_fltr_cgroup
+		    && !proc_is_in_cgroup_at(dirfd(ps->dir), d->d_name,
+					     ps->fltr_cgroup))
+			continue;
+
 		p = NULL;
 		errno = 0;
 		*pid = (pid_t) strtol(d->d_name, &p, 10);
@@ -283,6 +556,29 @@ static int test_tasks(int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
+static int print_task(pid_t tid, void *data __attribute__((__unused__)))
+{
+	printf(" %d", tid);
+	return 0;
+}
+
+static int test_foreach_task(int argc, char *argv[])
+{
+	pid_t pid;
+
+	if (argc != 2)
+		return EXIT_FAILURE;
+
+	pid = strtol(argv[1], (char **) NULL, 10);
+	printf("PID=%d, TIDs:", pid);
+
+	if (proc_foreach_task(pid, print_task, NULL) != 0)
+		err(EXIT_FAILURE, "read list of tasks failed");
+
+	printf("\n");
+	return EXIT_SUCCESS;
+}
+
 static int test_processes(int argc, char *argv[])
 {
 	pid_t pid;
@@ -298,6 +594,16 @@ static int test_processes(int argc, char *argv[])
 	if (argc >= 3 && strcmp(argv[1], "--uid") == 0)
 		proc_processes_filter_by_uid(ps, (uid_t) atol(argv[2]));
 
+	if (argc >= 3 && strcmp(argv[1], "--select") == 0) {
+		int i;
+
+		for (i = 2; i < argc; i++) {
+			errno = -proc_processes_add_filter(ps, argv[i]);
+			if (errno)
+				err(EXIT_FAILURE, "bad filter '%s'", argv[i]);
+		}
+	}
+
 	while (proc_next_pid(ps, &pid) == 0)
 		printf(" %d", pid);
 
@@ -327,14 +633,18 @@ int main(int argc, char *argv[])
 {
 	if (argc < 2) {
 		fprintf(stderr, "usage: %1$s --tasks <pid>\n"
+				"       %1$s --foreach-task <pid>\n"
 				"       %1$s --is-procfs [<dir>]\n"
-				"       %1$s --processes [---name <name>] [--uid <uid>]\n",
+				"       %1$s --processes [---name <name>] [--uid <uid>]\n"
+				"       %1$s --processes --select <filter> ...\n",
 				program_invocation_short_name);
 		return EXIT_FAILURE;
 	}
 
 	if (strcmp(argv[1], "--tasks") == 0)
 		return test_tasks(argc - 1, argv + 1);
+	if (strcmp(argv[1], "--foreach-task") == 0)
+		return test_foreach_task(argc - 1, argv + 1);
 	if (strcmp(argv[1], "--processes") == 0)
 		return test_processes(argc - 1, argv + 1);
 	if (strcmp(argv[1], "--is-procfs") == 0)
@@ -12,7 +12,9 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 #ifdef __linux__
 #include <sys/syscall.h>
 #endif
@@ -102,12 +104,7 @@ int random_get_fd(void)
 #define UL_RAND_READ_ATTEMPTS	8
 #define UL_RAND_READ_DELAY	125000	/* microseconds */
 
-/*
- * Write @nbytes random bytes into @buf.
- *
- * Returns 0 for good quality of random bytes or 1 for weak quality.
- */
-int ul_random_get_bytes(void *buf, size_t nbytes)
+static int random_get_bytes(void *buf, size_t nbytes)
 {
 	unsigned char *cp = (unsigned char *)buf;
 	size_t i, n = nbytes;
@@ -163,9 +160,14 @@ int ul_random_get_bytes(void *buf, size_t nbytes)
 		}
 	}
 	/*
-	 * We do this all the time, but this is the only source of
-	 * randomness if /dev/random/urandom is out to lunch.
+	 * This is the only source of randomness if /dev/random/urandom is
+	 * out to lunch. The pseudo-random bytes add nothing to the kernel
+	 * random bytes, so skip it (it's expensive per byte) if all the
+	 * bytes have been read.
 	 */
+	if (n == 0)
+		return 0;
+
 	crank_random();
 	for (cp = buf, i = 0; i < nbytes; i++)
 		*cp++ ^= (rand() >> 7) & 0xFF;
@@ -183,9 +185,125 @@ int ul_random_get_bytes(void *buf, size_t nbytes)
 	}
 #endif
 
-	return n != 0;
+	return 1;
+}
+
+#ifdef MADV_WIPEONFORK
+/*
+ * The process generation is kept in a MADV_WIPEONFORK page, the kernel
+ * zeroes the page in the child after fork() and the next call assigns a new
+ * generation. It allows to detect fork() without getpid() syscall.
+ */
+static uint64_t *fork_gen_page;
+static uint64_t fork_gen_seq;
+static int fork_gen_disabled;
+
+/* returns the current process generation, or 0 if not supported */
+uint64_t ul_fork_generation(void)
+{
+	uint64_t *page = __atomic_load_n(&fork_gen_page, __ATOMIC_ACQUIRE);
+	uint64_t gen;
+
+	if (!page) {
+		size_t pgsz = getpagesize();
+		uint64_t *expected = NULL;
+		void *p;
+
+		if (__atomic_load_n(&fork_gen_disabled, __ATOMIC_RELAXED))
+			return 0;
+
+		p = mmap(NULL, pgsz, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			return 0;
+		if (madvise(p, pgsz, MADV_WIPEONFORK) != 0) {
+			munmap(p, pgsz);
+			__atomic_store_n(&fork_gen_disabled, 1, __ATOMIC_RELAXED);
+			return 0;
+		}
+		if (__atomic_compare_exchange_n(&fork_gen_page, &expected, p, 0,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			page = p;
+		else {
+			/* another thread has been faster */
+			munmap(p, pgsz);
+			page = expected;
+		}
+	}
+
+	gen = __atomic_load_n(page, __ATOMIC_RELAXED);
+	if (!gen) {
+		/* the first call, or the first call after fork() */
+		gen = __atomic_add_fetch(&fork_gen_seq, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(page, gen, __ATOMIC_RELAXED);
+	}
+	return gen;
+}
+#else
+uint64_t ul_fork_generation(void)
+{
+	return 0;
 }
+#endif /* MADV_WIPEONFORK */
 
+#if defined(HAVE_GETRANDOM) && defined(HAVE_TLS) && defined(MADV_WIPEONFORK)
+/*
+ * The small requests are served from a per-thread pool of the kernel random
+ * bytes, it saves the getrandom() syscall per call. The used bytes are
+ * zeroed in the pool.
+ *
+ * The pool must not be used in the child process after fork(), the both
+ * processes would return the same bytes. The pool is refilled if the process
+ * generation (see ul_fork_generation()) has been changed, and it's not used
+ * if the generation is not supported.
+ */
+# define UL_RANDOM_POOL
+# define UL_RANDOM_POOLSZ	256	/* getrandom() is not interrupted */
+# define UL_RANDOM_POOL_MAXREQ	64
+
+static int random_pool_get_bytes(void *buf, size_t nbytes)
+{
+	THREAD_LOCAL unsigned char	pool[UL_RANDOM_POOLSZ];
+	THREAD_LOCAL size_t		avail;
+	THREAD_LOCAL uint64_t		pool_gen;
+	uint64_t gen = ul_fork_generation();
+
+	if (!gen)
+		return -1;
+	if (gen != pool_gen) {
+		pool_gen = gen;
+		avail = 0;
+	}
+	if (avail < nbytes) {
+		if (getrandom(pool, sizeof(pool), GRND_NONBLOCK) != (ssize_t) sizeof(pool)) {
+			avail = 0;
+			return -1;
+		}
+		avail = sizeof(pool);
+	}
+
+	/* use and forget the bytes */
+	avail -= nbytes;
+	memcpy(buf, pool + avail, nbytes);
+	memset(pool + avail, 0, nbytes);
+	return 0;
+}
+#endif /* HAVE_GETRANDOM && HAVE_TLS && MADV_WIPEONFORK */
+
+/*
+ * Write @nbytes random bytes into @buf.
+ *
+ * Returns 0 for good quality of random bytes or 1 for weak quality.
+ */
+int ul_random_get_bytes(void *buf, size_t nbytes)
+{
+#ifdef UL_RANDOM_POOL
+	if (nbytes && nbytes <= UL_RANDOM_POOL_MAXREQ
+	    && random_pool_get_bytes(buf, nbytes) == 0)
+		return 0;
+#endif
+	return random_get_bytes(buf, nbytes);
+}
 
 /*
  * Tell source of randomness.
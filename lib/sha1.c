@@ -38,7 +38,7 @@
 
 /* Hash a single 512-bit block. This is the core of the algorithm. */
 
-void ul_SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
+static void sha1_transform_generic(uint32_t state[5], const unsigned char buffer[64])
 {
 	uint32_t a, b, c, d, e;
 
@@ -159,6 +159,127 @@ void ul_SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
 #endif
 }
 
+#if defined(__x86_64__) && \
+    ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+# define UL_SHA1_SHANI
+# include <cpuid.h>
+# include <immintrin.h>
+
+/*
+ * Four rounds by the Intel SHA extensions; @k is the index of the rounds
+ * (0..19). The message schedule for the next rounds is calculated in the
+ * rounds 1..18, see Intel's "New Instructions Supporting the Secure Hash
+ * Algorithm on Intel Architecture Processors" white paper.
+ */
+#define SHANI_R4(k, e, enext, m0, m1, m2, m3) do { \
+		e = _mm_sha1nexte_epu32(e, m0); \
+		enext = abcd; \
+		if ((k) >= 3 && (k) <= 18) \
+			m1 = _mm_sha1msg2_epu32(m1, m0); \
+		abcd = _mm_sha1rnds4_epu32(abcd, e, (k) / 5); \
+		if ((k) <= 16) \
+			m3 = _mm_sha1msg1_epu32(m3, m0); \
+		if ((k) >= 2 && (k) <= 17) \
+			m2 = _mm_xor_si128(m2, m0); \
+	} while (0)
+
+#define SHANI_LOAD(m, off) \
+	m = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (buffer + (off))), mask)
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_transform_shani(uint32_t state[5], const unsigned char buffer[64])
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+	__m128i abcd, abcd_save, e0, e0_save, e1;
+	__m128i m0, m1, m2, m3;
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+	e0 = _mm_set_epi32((int) state[4], 0, 0, 0);
+	abcd_save = abcd;
+	e0_save = e0;
+	m1 = m2 = m3 = _mm_setzero_si128();
+
+	SHANI_LOAD(m0, 0);
+	e0 = _mm_add_epi32(e0, m0);
+	e1 = abcd;
+	abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+	SHANI_LOAD(m1, 16);
+	SHANI_R4(1, e1, e0, m1, m2, m3, m0);
+	SHANI_LOAD(m2, 32);
+	SHANI_R4(2, e0, e1, m2, m3, m0, m1);
+	SHANI_LOAD(m3, 48);
+	SHANI_R4(3, e1, e0, m3, m0, m1, m2);
+	SHANI_R4(4, e0, e1, m0, m1, m2, m3);
+	SHANI_R4(5, e1, e0, m1, m2, m3, m0);
+	SHANI_R4(6, e0, e1, m2, m3, m0, m1);
+	SHANI_R4(7, e1, e0, m3, m0, m1, m2);
+	SHANI_R4(8, e0, e1, m0, m1, m2, m3);
+	SHANI_R4(9, e1, e0, m1, m2, m3, m0);
+	SHANI_R4(10, e0, e1, m2, m3, m0, m1);
+	SHANI_R4(11, e1, e0, m3, m0, m1, m2);
+	SHANI_R4(12, e0, e1, m0, m1, m2, m3);
+	SHANI_R4(13, e1, e0, m1, m2, m3, m0);
+	SHANI_R4(14, e0, e1, m2, m3, m0, m1);
+	SHANI_R4(15, e1, e0, m3, m0, m1, m2);
+	SHANI_R4(16, e0, e1, m0, m1, m2, m3);
+	SHANI_R4(17, e1, e0, m1, m2, m3, m0);
+	SHANI_R4(18, e0, e1, m2, m3, m0, m1);
+	SHANI_R4(19, e1, e0, m3, m0, m1, m2);
+
+	e0 = _mm_sha1nexte_epu32(e0, e0_save);
+	abcd = _mm_add_epi32(abcd, abcd_save);
+
+	_mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = (uint32_t) _mm_extract_epi32(e0, 3);
+}
+
+static int sha1_has_shani(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	if (!(ebx & (1 << 29)))		/* SHA */
+		return 0;
+
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.1") ? 1 : 0;
+}
+#endif /* __x86_64__ */
+
+typedef void (*sha1_transform_fn)(uint32_t *, const unsigned char *);
+
+static sha1_transform_fn sha1_select(void)
+{
+#ifdef UL_SHA1_SHANI
+	if (sha1_has_shani())
+		return sha1_transform_shani;
+#endif
+	return sha1_transform_generic;
+}
+
+/*
+ * The implementation is selected by CPU features on the first call.
+ */
+static sha1_transform_fn sha1_get_transform(void)
+{
+	static sha1_transform_fn fn;
+	sha1_transform_fn f = __atomic_load_n(&fn, __ATOMIC_RELAXED);
+
+	if (!f) {
+		f = sha1_select();
+		__atomic_store_n(&fn, f, __ATOMIC_RELAXED);
+	}
+	return f;
+}
+
+void ul_SHA1Transform(uint32_t state[5], const unsigned char buffer[64])
+{
+	sha1_get_transform()(state, buffer);
+}
+
 /* SHA1Init - Initialize new context */
 
 void ul_SHA1Init(UL_SHA1_CTX *context)
@@ -201,12 +322,10 @@ void ul_SHA1Update(UL_SHA1_CTX *context, const unsigned char *data, uint32_t len
 
 void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
 {
-	unsigned i;
+	unsigned i, j;
 
 	unsigned char finalcount[8];
 
-	unsigned char c;
-
 #if 0				/* untested "improvement" by DHR */
 	/* Convert context->count to a sequence of bytes
 	 * in finalcount.  Second element first, but
@@ -227,13 +346,17 @@ void ul_SHA1Final(unsigned char digest[20], UL_SHA1_CTX *context)
 		finalcount[i] = (unsigned char)((context->count[(i >= 4 ? 0 : 1)] >> ((3 - (i & 3)) * 8)) & 255);	/* Endian independent */
 	}
 #endif
-	c = 0200;
-	ul_SHA1Update(context, &c, 1);
-	while ((context->count[0] & 504) != 448) {
-		c = 0000;
-		ul_SHA1Update(context, &c, 1);
+	/* pad by 0x80 and zeros to 56 bytes (mod 64) and append the length */
+	j = (context->count[0] >> 3) & 63;
+	context->buffer[j++] = 0200;
+	if (j > 56) {
+		memset(&context->buffer[j], 0, 64 - j);
+		ul_SHA1Transform(context->state, context->buffer);
+		j = 0;
 	}
-	ul_SHA1Update(context, finalcount, 8);	/* Should cause a SHA1Transform() */
+	memset(&context->buffer[j], 0, 56 - j);
+	memcpy(&context->buffer[56], finalcount, 8);
+	ul_SHA1Transform(context->state, context->buffer);
 	for (i = 0; i < 20; i++) {
 		digest[i] = (unsigned char)
 		    ((context->state[i >> 2] >> ((3 - (i & 3)) * 8)) & 255);
@@ -254,3 +377,173 @@ void ul_SHA1(char *hash_out, const char *str, unsigned len)
 	ul_SHA1Final((unsigned char *)hash_out, &ctx);
 	hash_out[20] = '\0';
 }
+
+/*
+ * Multi-buffer SHA-1
+ *
+ * The messages are hashed UL_SHA1_LANES at once, every lane is one element
+ * of a vector (SSE2 or NEON register for 4 lanes). If the CPU supports SHA
+ * extensions the single-stream code is faster and it's used for the
+ * messages one by one.
+ */
+
+/* the @blk-th block of the padded message, @block is used for the tail */
+static const unsigned char *sha1_get_block(unsigned char block[64],
+			const unsigned char *data, size_t len, size_t blk)
+{
+	size_t off = blk * 64, n = 0;
+	unsigned i;
+
+	if (off + 64 <= len)
+		return data + off;	/* the whole block is in the message */
+
+	if (off < len) {
+		n = len - off;
+		memcpy(block, data + off, n);
+	}
+	memset(block + n, 0, 64 - n);
+
+	if (off <= len)
+		block[len - off] = 0200;
+	if (blk == (len + 8) / 64) {
+		uint64_t bits = (uint64_t) len << 3;
+
+		for (i = 0; i < 8; i++)
+			block[63 - i] = bits >> (i * 8);
+	}
+	return block;
+}
+
+static void sha1_digest(unsigned char digest[UL_SHA1LENGTH], const uint32_t state[5])
+{
+	unsigned i;
+
+	for (i = 0; i < UL_SHA1LENGTH; i++)
+		digest[i] = (unsigned char) (state[i >> 2] >> ((3 - (i & 3)) * 8));
+}
+
+static const uint32_t sha1_init[5] = {
+	0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+static void sha1_multi_single(unsigned char digest[][UL_SHA1LENGTH],
+			      const unsigned char *const data[], const size_t len[],
+			      size_t n, sha1_transform_fn transform)
+{
+	unsigned char block[64];
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		uint32_t state[5];
+		size_t blk, nblks = (len[i] + 8) / 64 + 1;
+
+		memcpy(state, sha1_init, sizeof(state));
+		for (blk = 0; blk < nblks; blk++)
+			transform(state, sha1_get_block(block, data[i], len[i], blk));
+		sha1_digest(digest[i], state);
+	}
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+typedef uint32_t sha1_lanes_t __attribute__((vector_size(UL_SHA1_LANES * sizeof(uint32_t))));
+
+#define SHA1_F0(x, y, z)	(((x) & ((y) ^ (z))) ^ (z))
+#define SHA1_F1(x, y, z)	((x) ^ (y) ^ (z))
+#define SHA1_F2(x, y, z)	((((x) | (y)) & (z)) | ((x) & (y)))
+
+#define SHA1_LANES_ROUND(f, k, r) \
+	for (j = (r) * 20; j < (r) * 20 + 20; j++) { \
+		sha1_lanes_t t; \
+		if (j >= 16) \
+			w[j & 15] = rol(w[(j + 13) & 15] ^ w[(j + 8) & 15] \
+					^ w[(j + 2) & 15] ^ w[j & 15], 1); \
+		t = rol(a, 5) + f(b, c, d) + e + (uint32_t) (k) + w[j & 15]; \
+		e = d; \
+		d = c; \
+		c = rol(b, 30); \
+		b = a; \
+		a = t; \
+	}
+
+/* updates the lanes in @mask (all bits set or zero) */
+static void sha1_transform_lanes(sha1_lanes_t st[5], sha1_lanes_t w[16],
+				 sha1_lanes_t mask)
+{
+	sha1_lanes_t a = st[0], b = st[1], c = st[2], d = st[3], e = st[4];
+	unsigned j;
+
+	SHA1_LANES_ROUND(SHA1_F0, 0x5A827999, 0);
+	SHA1_LANES_ROUND(SHA1_F1, 0x6ED9EBA1, 1);
+	SHA1_LANES_ROUND(SHA1_F2, 0x8F1BBCDC, 2);
+	SHA1_LANES_ROUND(SHA1_F1, 0xCA62C1D6, 3);
+
+	st[0] += a & mask;
+	st[1] += b & mask;
+	st[2] += c & mask;
+	st[3] += d & mask;
+	st[4] += e & mask;
+}
+
+/*
+ * Calculates SHA-1 digests of @n messages, @data[x] of @len[x] bytes; the
+ * result is the same as ul_SHA1Init(), ul_SHA1Update() and ul_SHA1Final()
+ * for each message.
+ */
+void ul_SHA1Multi(unsigned char digest[][UL_SHA1LENGTH],
+		  const unsigned char *const data[], const size_t len[], size_t n)
+{
+	sha1_transform_fn transform = sha1_get_transform();
+	unsigned char block[64];
+	size_t first;
+
+	if (transform != sha1_transform_generic) {
+		sha1_multi_single(digest, data, len, n, transform);
+		return;
+	}
+
+	for (first = 0; first < n; first += UL_SHA1_LANES) {
+		sha1_lanes_t st[5], w[16], mask;
+		size_t nblks[UL_SHA1_LANES], maxblks = 0, blk;
+		unsigned i, j, nlanes = n - first < UL_SHA1_LANES ? n - first : UL_SHA1_LANES;
+
+		for (i = 0; i < UL_SHA1_LANES; i++) {
+			for (j = 0; j < 5; j++)
+				st[j][i] = sha1_init[j];
+			nblks[i] = i < nlanes ? (len[first + i] + 8) / 64 + 1 : 0;
+			if (nblks[i] > maxblks)
+				maxblks = nblks[i];
+		}
+
+		for (blk = 0; blk < maxblks; blk++) {
+			for (i = 0; i < UL_SHA1_LANES; i++) {
+				const unsigned char *p = block;
+
+				mask[i] = blk < nblks[i] ? 0xffffffff : 0;
+				if (mask[i])
+					p = sha1_get_block(block, data[first + i],
+							   len[first + i], blk);
+				else
+					memset(block, 0, sizeof(block));
+				for (j = 0; j < 16; j++, p += 4)
+					w[j][i] = (uint32_t) p[0] << 24 | (uint32_t) p[1] << 16 |
+						  (uint32_t) p[2] << 8 | (uint32_t) p[3];
+			}
+			sha1_transform_lanes(st, w, mask);
+		}
+
+		for (i = 0; i < nlanes; i++) {
+			uint32_t state[5];
+
+			for (j = 0; j < 5; j++)
+				state[j] = st[j][i];
+			sha1_digest(digest[first + i], state);
+		}
+	}
+}
+#else /* !__GNUC__ */
+void ul_SHA1Multi(unsigned char digest[][UL_SHA1LENGTH],
+		  const unsigned char *const data[], const size_t len[], size_t n)
+{
+	sha1_multi_single(digest, data, len, n, sha1_get_transform());
+}
+#endif /* __GNUC__ */
@@ -322,6 +322,33 @@ char *strndup(const char *s, size_t n)
 /*
  * convert strings to numbers; returns <0 on error, and 0 on success
  */
+/*
+ * Fast path for the usual decimal numbers (e.g. from sysfs) -- only digits
+ * and not more than @maxdigits, so the result cannot overflow. Returns 1 if
+ * the string is not such number and strtoimax() or strtoumax() has to be
+ * used.
+ */
+static inline int parse_decimal(const char *str, uint64_t *num, size_t maxdigits)
+{
+	const char *p = str;
+	uint64_t n = 0;
+	unsigned int d;
+
+	while ((d = (unsigned char) *p - '0') < 10) {
+		n = n * 10 + d;
+		p++;
+	}
+	if (*p || p == str || (size_t) (p - str) > maxdigits)
+		return 1;
+	*num = n;
+	return 0;
+}
+
+static inline int is_decimal_base(const char *str, int base)
+{
+	return base == 10 || (base == 0 && *str != '0');
+}
+
 int ul_strtos64(const char *str, int64_t *num, int base)
 {
 	char *end = NULL;
@@ -329,6 +356,21 @@ int ul_strtos64(const char *str, int64_t *num, int base)
 	errno = 0;
 	if (str == NULL || *str == '\0')
 		return -EINVAL;
+
+	if (is_decimal_base(str, base)) {
+		uint64_t x;
+
+		/* 18 digits fit to int64_t */
+		if (*str == '-' && parse_decimal(str + 1, &x, 18) == 0) {
+			*num = -(int64_t) x;
+			return 0;
+		}
+		if (parse_decimal(str, &x, 18) == 0) {
+			*num = (int64_t) x;
+			return 0;
+		}
+	}
+
 	*num = (int64_t) strtoimax(str, &end, base);
 
 	if (errno || str == end || (end && *end))
@@ -345,6 +387,10 @@ int ul_strtou64(const char *str, uint64_t *num, int base)
 	if (str == NULL || *str == '\0')
 		return -EINVAL;
 
+	/* 19 digits fit to uint64_t */
+	if (is_decimal_base(str, base) && parse_decimal(str, num, 19) == 0)
+		return 0;
+
 	/* we need to ignore negative numbers, note that for invalid negative
 	 * number strtoimax() returns negative number too, so we do not
 	 * need to check errno here */
@@ -601,9 +647,29 @@ static int get_exp(uint64_t n)
 	return shft - 10;
 }
 
+/*
+ * Writes @num as a decimal number to @buf (at least 21 bytes) and
+ * returns the length of the string.
+ */
+size_t ul_u64_to_dec(char *buf, uint64_t num)
+{
+	char tmp[20], *p = tmp + sizeof(tmp);
+	size_t len;
+
+	do {
+		*--p = '0' + num % 10;
+		num /= 10;
+	} while (num);
+
+	len = tmp + sizeof(tmp) - p;
+	memcpy(buf, p, len);
+	buf[len] = '\0';
+	return len;
+}
+
 char *size_to_human_string(int options, uint64_t bytes)
 {
-	char buf[32];
+	char buf[32], *p;
 	int dec, exp;
 	uint64_t frac;
 	const char *letters = "BKMGTPE";
@@ -655,25 +721,28 @@ char *size_to_human_string(int options, uint64_t bytes)
 		}
 	}
 
+	p = buf + ul_u64_to_dec(buf, dec);
+
 	if (frac) {
 		struct lconv const *l = localeconv();
 		char *dp = l ? l->decimal_point : NULL;
-		int len;
+		size_t len;
 
 		if (!dp || !*dp)
 			dp = ".";
+		len = strlen(dp);
+		if (len > sizeof(buf) - (p - buf) - sizeof(suffix) - 2)
+			return strdup("");
+		memcpy(p, dp, len);
+		p += len;
+		*p++ = '0' + frac / 10;
+		/* remove potential extraneous zero */
+		if (frac % 10)
+			*p++ = '0' + frac % 10;
+	}
 
-		len = snprintf(buf, sizeof(buf), "%d%s%02" PRIu64, dec, dp, frac);
-		if (len > 0 && (size_t) len < sizeof(buf)) {
-			/* remove potential extraneous zero */
-			if (buf[len - 1] == '0')
-				buf[len--] = '\0';
-			/* append suffix */
-			xstrncpy(buf+len, suffix, sizeof(buf) - len);
-		} else
-			*buf = '\0';	/* snprintf error */
-	} else
-		snprintf(buf, sizeof(buf), "%d%s", dec, suffix);
+	/* append suffix */
+	memcpy(p, suffix, psuf - suffix + 1);
 
 	return strdup(buf);
 }
@@ -1124,6 +1193,8 @@ int ul_stralnumcmp(const char *p1, const char *p2)
 }
 
 #ifdef TEST_PROGRAM_STRUTILS
+#include <time.h>
+
 struct testS {
 	char *name;
 	char *value;
@@ -1224,6 +1295,44 @@ done:
 	return EXIT_SUCCESS;
 }
 
+static double bench_elapsed(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* micro-benchmark of the per-cell conversions used by the table tools */
+static int test_strutils_bench(int argc, char *argv[])
+{
+	static const char *nums[] = { "0", "1", "512", "4096", "1000204886016",
+				      "18446744073709551615" };
+	size_t i, n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	struct timespec start;
+	uint64_t x, sum = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n; i++) {
+		if (ul_strtou64(nums[i % ARRAY_SIZE(nums)], &x, 10) == 0)
+			sum += x;
+	}
+	printf("ul_strtou64():          %8.1f ns/call\n",
+			bench_elapsed(&start) * 1e9 / n);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n; i++) {
+		char *str = size_to_human_string(SIZE_SUFFIX_1LETTER,
+				(uint64_t) i * 1234567);
+		sum += *str;
+		free(str);
+	}
+	printf("size_to_human_string(): %8.1f ns/call\n",
+			bench_elapsed(&start) * 1e9 / n);
+
+	return sum ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char *argv[])
 {
 	if (argc == 3 && strcmp(argv[1], "--size") == 0) {
@@ -1262,13 +1371,17 @@ int main(int argc, char *argv[])
 		printf("'%s'-->%hu\n", argv[2], strtou16_or_err(argv[2], "strtou16 failed"));
 		return EXIT_SUCCESS;
 
+	} else if (argc >= 2 && strcmp(argv[1], "--bench") == 0) {
+		return test_strutils_bench(argc - 1, argv + 1);
+
 	} else {
 		fprintf(stderr, "usage: %1$s --size <number>[suffix]\n"
 				"       %1$s --cmp-paths <path> <path>\n"
 				"       %1$s --strdup-member <str> <str>\n"
 				"       %1$s --stralnumcmp <str> <str>\n"
 				"       %1$s --normalize <str>\n"
-				"       %1$s --strto{s,u}{16,32,64} <str>\n",
+				"       %1$s --strto{s,u}{16,32,64} <str>\n"
+				"       %1$s --bench [<count>]\n",
 				argv[0]);
 		exit(EXIT_FAILURE);
 	}
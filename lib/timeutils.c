@@ -407,19 +407,87 @@ int get_gmtoff(const struct tm *tp)
 #endif
 }
 
+#ifdef HAVE_TLS
+#define THREAD_LOCAL static __thread
+#else
+#define THREAD_LOCAL static
+#endif
+
+/*
+ * The broken-down time of the last converted minute. The tools usually print
+ * many timestamps from the same minute (dmesg, last, ...), the time within
+ * the cached minute is calculated without localtime_r() and the time zone
+ * lookup.
+ */
+struct iso_cache {
+	time_t		min;		/* the first second of the minute */
+	struct tm	tm;
+	unsigned int	valid : 1,
+			gmtime : 1;
+};
+
+THREAD_LOCAL struct iso_cache iso_cache;
+
+static struct tm *iso_broken_time(const time_t *t, int flags, struct tm *tm)
+{
+	struct iso_cache *c = &iso_cache;
+	int gmt = (flags & ISO_GMTIME) ? 1 : 0;
+
+	if (c->valid && c->gmtime == gmt && *t >= c->min && *t - c->min < 60) {
+		*tm = c->tm;
+		tm->tm_sec = *t - c->min;
+		return tm;
+	}
+
+	if (!(gmt ? gmtime_r(t, tm) : localtime_r(t, tm)))
+		return NULL;
+
+	/* don't cache a minute with a leap second */
+	if (tm->tm_sec < 60) {
+		c->min = *t - tm->tm_sec;
+		c->tm = *tm;
+		c->gmtime = gmt;
+		c->valid = 1;
+	}
+	return tm;
+}
+
+/* writes @v as @n decimal digits */
+static char *put_digits(char *p, unsigned long v, int n)
+{
+	char *end = p + n;
+
+	while (n-- > 0) {
+		p[n] = '0' + v % 10;
+		v /= 10;
+	}
+	return end;
+}
+
 static int format_iso_time(struct tm *tm, suseconds_t usec, int flags, char *buf, size_t bufsz)
 {
 	char *p = buf;
 	int len;
 
 	if (flags & ISO_DATE) {
-		len = snprintf(p, bufsz, "%4ld-%.2d-%.2d",
-			       tm->tm_year + (long) 1900,
-			       tm->tm_mon + 1, tm->tm_mday);
-		if (len < 0 || (size_t) len > bufsz)
-			goto err;
+		long year = tm->tm_year + (long) 1900;
+
+		if (year >= 1000 && year <= 9999 && bufsz > 10) {
+			p = put_digits(p, year, 4);
+			*p++ = '-';
+			p = put_digits(p, tm->tm_mon + 1, 2);
+			*p++ = '-';
+			p = put_digits(p, tm->tm_mday, 2);
+			*p = '\0';
+			len = 10;
+		} else {
+			len = snprintf(p, bufsz, "%4ld-%.2d-%.2d", year,
+				       tm->tm_mon + 1, tm->tm_mday);
+			if (len < 0 || (size_t) len > bufsz)
+				goto err;
+			p += len;
+		}
 		bufsz -= len;
-		p += len;
 	}
 
 	if ((flags & ISO_DATE) && (flags & ISO_TIME)) {
@@ -430,36 +498,46 @@ static int format_iso_time(struct tm *tm, suseconds_t usec, int flags, char *buf
 	}
 
 	if (flags & ISO_TIME) {
-		len = snprintf(p, bufsz, "%02d:%02d:%02d", tm->tm_hour,
-			       tm->tm_min, tm->tm_sec);
-		if (len < 0 || (size_t) len > bufsz)
+		if (bufsz < 9)
 			goto err;
-		bufsz -= len;
-		p += len;
+		p = put_digits(p, tm->tm_hour, 2);
+		*p++ = ':';
+		p = put_digits(p, tm->tm_min, 2);
+		*p++ = ':';
+		p = put_digits(p, tm->tm_sec, 2);
+		*p = '\0';
+		bufsz -= 8;
 	}
 
-	if (flags & ISO_DOTUSEC) {
-		len = snprintf(p, bufsz, ".%06"PRId64, (int64_t) usec);
-		if (len < 0 || (size_t) len > bufsz)
-			goto err;
-		bufsz -= len;
-		p += len;
-
-	} else if (flags & ISO_COMMAUSEC) {
-		len = snprintf(p, bufsz, ",%06"PRId64, (int64_t) usec);
-		if (len < 0 || (size_t) len > bufsz)
-			goto err;
+	if (flags & (ISO_DOTUSEC | ISO_COMMAUSEC)) {
+		char sep = (flags & ISO_DOTUSEC) ? '.' : ',';
+
+		if (usec >= 0 && usec < 1000000 && bufsz > 7) {
+			*p++ = sep;
+			p = put_digits(p, usec, 6);
+			*p = '\0';
+			len = 7;
+		} else {
+			len = snprintf(p, bufsz, "%c%06"PRId64, sep, (int64_t) usec);
+			if (len < 0 || (size_t) len > bufsz)
+				goto err;
+			p += len;
+		}
 		bufsz -= len;
-		p += len;
 	}
 
 	if (flags & ISO_TIMEZONE) {
 		int tmin  = get_gmtoff(tm) / 60;
 		int zhour = tmin / 60;
 		int zmin  = abs(tmin % 60);
-		len = snprintf(p, bufsz, "%+03d:%02d", zhour,zmin);
-		if (len < 0 || (size_t) len > bufsz)
+
+		if (bufsz < 7 || zhour < -99 || zhour > 99)
 			goto err;
+		*p++ = zhour < 0 ? '-' : '+';
+		p = put_digits(p, abs(zhour), 2);
+		*p++ = ':';
+		p = put_digits(p, zmin, 2);
+		*p = '\0';
 	}
 	return 0;
  err:
@@ -471,14 +549,8 @@ static int format_iso_time(struct tm *tm, suseconds_t usec, int flags, char *buf
 int strtimeval_iso(struct timeval *tv, int flags, char *buf, size_t bufsz)
 {
 	struct tm tm;
-	struct tm *rc;
 
-	if (flags & ISO_GMTIME)
-		rc = gmtime_r(&tv->tv_sec, &tm);
-	else
-		rc = localtime_r(&tv->tv_sec, &tm);
-
-	if (rc)
+	if (iso_broken_time(&tv->tv_sec, flags, &tm))
 		return format_iso_time(&tm, tv->tv_usec, flags, buf, bufsz);
 
 	warnx(_("time %"PRId64" is out of range."), (int64_t)(tv->tv_sec));
@@ -495,14 +567,8 @@ int strtm_iso(struct tm *tm, int flags, char *buf, size_t bufsz)
 int strtime_iso(const time_t *t, int flags, char *buf, size_t bufsz)
 {
 	struct tm tm;
-	struct tm *rc;
-
-	if (flags & ISO_GMTIME)
-		rc = gmtime_r(t, &tm);
-	else
-		rc = localtime_r(t, &tm);
 
-	if (rc)
+	if (iso_broken_time(t, flags, &tm))
 		return format_iso_time(&tm, 0, flags, buf, bufsz);
 
 	warnx(_("time %"PRId64" is out of range."), (int64_t)*t);
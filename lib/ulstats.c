@@ -0,0 +1,200 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * Syscall, I/O and time accounting, see include/ulstats.h.
+ *
+ * UL_STATS=<any> enables the accounting, the summary looks like:
+ *
+ *   1234: libmount: STATS: open=1 read=24 ioctl=0 stat=2
+ *   1234: libmount: STATS: sysfs=0 procfs=2781 device=0 other=0 bytes
+ *   1234: libmount: STATS: parse=1 (0.000084 s)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "c.h"
+#include "ulstats.h"
+
+int ul_stats_enabled;
+
+struct ul_stats_phase {
+	unsigned int	depth;		/* nested begin/end */
+	unsigned long	count;
+	struct timespec	start;
+	double		total;		/* seconds */
+};
+
+static struct ul_stats {
+	const char		*name;
+	unsigned int		initialized : 1;
+
+	unsigned long long	calls[__UL_STATS_NCALLS];
+	unsigned long long	bytes[__UL_STATS_NSOURCES];
+	struct ul_stats_phase	phases[__UL_STATS_NPHASES];
+} ul_stats;
+
+static const char *const call_names[] = {
+	[UL_STATS_OPEN]  = "open",
+	[UL_STATS_READ]  = "read",
+	[UL_STATS_IOCTL] = "ioctl",
+	[UL_STATS_STAT]  = "stat"
+};
+
+static const char *const source_names[] = {
+	[UL_STATS_SYSFS]  = "sysfs",
+	[UL_STATS_PROCFS] = "procfs",
+	[UL_STATS_DEVICE] = "device",
+	[UL_STATS_OTHER]  = "other"
+};
+
+static const char *const phase_names[] = {
+	[UL_STATS_PROBE] = "probe",
+	[UL_STATS_PARSE] = "parse",
+	[UL_STATS_PRINT] = "print"
+};
+
+static void ul_stats_print(void)
+{
+	struct ul_stats *st = &ul_stats;
+	int pid = getpid();
+	size_t i;
+
+	fprintf(stderr, "%d: %s: STATS:", pid, st->name);
+	for (i = 0; i < ARRAY_SIZE(call_names); i++)
+		fprintf(stderr, " %s=%llu", call_names[i], st->calls[i]);
+
+	fprintf(stderr, "\n%d: %s: STATS:", pid, st->name);
+	for (i = 0; i < ARRAY_SIZE(source_names); i++)
+		fprintf(stderr, " %s=%llu", source_names[i], st->bytes[i]);
+	fputs(" bytes\n", stderr);
+
+	for (i = 0; i < ARRAY_SIZE(phase_names); i++) {
+		const struct ul_stats_phase *ph = &st->phases[i];
+
+		if (!ph->count)
+			continue;
+		fprintf(stderr, "%d: %s: STATS: %s=%lu (%.6f s)\n", pid,
+				st->name, phase_names[i], ph->count, ph->total);
+	}
+}
+
+/*
+ * Enables the accounting if UL_STATS= is set. Only the first call is
+ * evaluated, @name is the library or program name used in the summary
+ * (NULL means the program name).
+ */
+void ul_stats_init(const char *name)
+{
+	const char *str;
+
+	if (ul_stats.initialized)
+		return;
+	ul_stats.initialized = 1;
+
+	str = getenv("UL_STATS");
+	if (!str || !*str || strcmp(str, "0") == 0)
+		return;
+
+	/* don't provide information about privileged operations */
+	if (getuid() != geteuid() || getgid() != getegid())
+		return;
+
+	ul_stats.name = name ? name : program_invocation_short_name;
+	ul_stats_enabled = 1;
+	atexit(ul_stats_print);
+}
+
+void ul_stats_add_call(int call)
+{
+	if (call >= 0 && call < __UL_STATS_NCALLS)
+		ul_stats.calls[call]++;
+}
+
+void ul_stats_add_bytes(int source, size_t bytes)
+{
+	if (source >= 0 && source < __UL_STATS_NSOURCES)
+		ul_stats.bytes[source] += bytes;
+}
+
+static int has_dir_prefix(const char *path, const char *dir, size_t len)
+{
+	return strncmp(path, dir, len) == 0
+	       && (path[len] == '/' || path[len] == '\0');
+}
+
+/* returns UL_STATS_{SYSFS,PROCFS,DEVICE,OTHER} for the absolute @path */
+int ul_stats_path_source(const char *path)
+{
+	if (!path)
+		return UL_STATS_OTHER;
+	if (has_dir_prefix(path, "/sys", 4))
+		return UL_STATS_SYSFS;
+	if (has_dir_prefix(path, "/proc", 5))
+		return UL_STATS_PROCFS;
+	if (has_dir_prefix(path, "/dev", 4))
+		return UL_STATS_DEVICE;
+	return UL_STATS_OTHER;
+}
+
+void ul_stats_phase_begin(int phase)
+{
+	struct ul_stats_phase *ph;
+
+	if (phase < 0 || phase >= __UL_STATS_NPHASES)
+		return;
+
+	ph = &ul_stats.phases[phase];
+	if (ph->depth++ == 0)
+		clock_gettime(CLOCK_MONOTONIC, &ph->start);
+}
+
+void ul_stats_phase_end(int phase)
+{
+	struct ul_stats_phase *ph;
+	struct timespec now;
+
+	if (phase < 0 || phase >= __UL_STATS_NPHASES)
+		return;
+
+	ph = &ul_stats.phases[phase];
+	if (!ph->depth || --ph->depth)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ph->total += (now.tv_sec - ph->start.tv_sec)
+		     + (now.tv_nsec - ph->start.tv_nsec) / 1e9;
+	ph->count++;
+}
+
+#ifdef TEST_PROGRAM_ULSTATS
+int main(int argc, char *argv[])
+{
+	const char *paths[] = { "/sys/block", "/proc/self/mountinfo",
+				"/dev/sda", "/system", "/etc/fstab", NULL };
+	size_t i;
+
+	setenv("UL_STATS", "1", 1);
+	ul_stats_init(argc > 1 ? argv[1] : NULL);
+
+	for (i = 0; paths[i]; i++) {
+		UL_STATS_CALL(UL_STATS_OPEN);
+		UL_STATS_CALL(UL_STATS_READ);
+		UL_STATS_PATH_BYTES(paths[i], 100 * (i + 1));
+	}
+
+	UL_STATS_BEGIN(UL_STATS_PARSE);
+	UL_STATS_BEGIN(UL_STATS_PARSE);		/* nested */
+	UL_STATS_END(UL_STATS_PARSE);
+	UL_STATS_END(UL_STATS_PARSE);
+	UL_STATS_END(UL_STATS_PARSE);		/* unbalanced, ignored */
+
+	if (ul_stats.phases[UL_STATS_PARSE].count != 1
+	    || ul_stats.bytes[UL_STATS_OTHER] != 900)
+		errx(EXIT_FAILURE, "unexpected counters");
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM_ULSTATS */
@@ -0,0 +1,144 @@
+/*
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * Block-buffered wide char input for the text filters (col, colrm, ul).
+ * The input is read by read(2) and decoded to an array of wide chars;
+ * runs of ASCII bytes are copied as they are, everything else is decoded
+ * by mbrtowc().
+ */
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wcreader.h"
+#include "xalloc.h"
+
+void ul_init_wcreader(struct ul_wcreader *rd, FILE *f)
+{
+	memset(rd, 0, sizeof(*rd));
+
+	rd->fd = fileno(f);
+	rd->bytes = xmalloc(UL_WCREADER_BUFSIZ);
+	rd->wcs = xmalloc(UL_WCREADER_BUFSIZ * sizeof(wint_t));
+}
+
+void ul_free_wcreader(struct ul_wcreader *rd)
+{
+	free(rd->bytes);
+	free(rd->wcs);
+	memset(rd, 0, sizeof(*rd));
+}
+
+/* decodes as much of the buffered bytes as possible */
+static void decode(struct ul_wcreader *rd)
+{
+	size_t n = 0;
+
+	while (rd->bpos < rd->blen) {
+		unsigned char c = rd->bytes[rd->bpos];
+#ifdef HAVE_WIDECHAR
+		mbstate_t st;
+		wchar_t wc;
+		size_t r;
+
+		if (c < 0x80 && mbsinit(&rd->st)) {
+			do {
+				rd->wcs[n++] = c;
+				rd->bpos++;
+			} while (rd->bpos < rd->blen
+				 && (c = rd->bytes[rd->bpos]) < 0x80);
+			continue;
+		}
+
+		st = rd->st;
+		r = mbrtowc(&wc, rd->bytes + rd->bpos, rd->blen - rd->bpos, &rd->st);
+		if (r == (size_t) -2) {
+			/* incomplete, decode it again when more data are read */
+			rd->st = st;
+			break;
+		}
+		if (r == (size_t) -1) {
+			memset(&rd->st, 0, sizeof(rd->st));
+			rd->ilseq = 1;
+			break;
+		}
+		if (r == 0)
+			r = 1;
+		rd->wcs[n++] = wc;
+		rd->bpos += r;
+#else
+		rd->wcs[n++] = c;
+		rd->bpos++;
+#endif
+	}
+	rd->wpos = 0;
+	rd->wlen = n;
+}
+
+/* moves the undecoded rest to the begin of the buffer and reads more data */
+static void refill(struct ul_wcreader *rd)
+{
+	size_t rest = rd->blen - rd->bpos;
+	ssize_t n;
+
+	if (rest && rd->bpos)
+		memmove(rd->bytes, rd->bytes + rd->bpos, rest);
+	rd->bpos = 0;
+	rd->blen = rest;
+
+	do {
+		n = read(rd->fd, rd->bytes + rest, UL_WCREADER_BUFSIZ - rest);
+	} while (n < 0 && errno == EINTR);
+
+	if (n <= 0)
+		rd->eof = 1;
+	else
+		rd->blen += n;
+}
+
+/*
+ * Called by ul_wcreader_getwc() when the decoded chars are exhausted.
+ */
+wint_t ul_wcreader_fill(struct ul_wcreader *rd)
+{
+	rd->wpos = rd->wlen = 0;
+
+	for (;;) {
+		if (rd->ilseq) {
+			errno = EILSEQ;
+			return WEOF;
+		}
+		decode(rd);
+		if (rd->wlen)
+			return rd->wcs[rd->wpos++];
+		if (rd->ilseq)
+			continue;
+		if (rd->eof) {
+			if (rd->bpos < rd->blen) {
+				/* incomplete sequence at the end of input */
+				rd->bpos = rd->blen;
+				errno = EILSEQ;
+			}
+			return WEOF;
+		}
+		refill(rd);
+	}
+}
+
+/*
+ * Returns the next undecoded byte, usually the begin of an invalid
+ * sequence after ul_wcreader_getwc() failed with EILSEQ.
+ */
+int ul_wcreader_getbyte(struct ul_wcreader *rd)
+{
+	if (rd->wpos < rd->wlen)
+		return EOF;
+	if (rd->bpos >= rd->blen && !rd->eof)
+		refill(rd);
+	if (rd->bpos >= rd->blen)
+		return EOF;
+
+	rd->ilseq = 0;
+	return (unsigned char) rd->bytes[rd->bpos++];
+}
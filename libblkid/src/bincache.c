@@ -0,0 +1,633 @@
+/*
+ * bincache.c - binary (mmap-able) version of the cache file
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include "fileutils.h"
+#include "all-io.h"
+
+#include "blkidP.h"
+
+/*
+ * File format:
+ *
+ * The binary cache is generated from the cache file by blkid_flush_cache()
+ * (if enabled by BINARY_CACHE=yes in blkid.conf) and it is used only if it
+ * describes the current cache file (inode, size and mtime have to match).
+ * The file uses native byte order; files from another architecture are
+ * ignored.
+ *
+ *	header		struct bincache_header
+ *	devices		struct bincache_dev[ndevs], in the cache order
+ *	tags		struct bincache_tag[ntags], grouped by devices
+ *	tag index	uint32_t[ntags], tags sorted by name and value
+ *	strings		NUL terminated strings, referenced by offsets
+ *
+ * The tag index allows to resolve NAME=value by binary search and to create
+ * in-memory devices only for the matching entries. The rest of the file is
+ * converted to the devices list on demand (see blkid_bincache_load()).
+ */
+#define BINCACHE_MAGIC		"BLKIDBC"
+#define BINCACHE_VERSION	1
+#define BINCACHE_BYTEORDER	0x01020304
+
+struct bincache_header {
+	char		magic[8];	/* BINCACHE_MAGIC */
+	uint32_t	version;	/* BINCACHE_VERSION */
+	uint32_t	byteorder;	/* BINCACHE_BYTEORDER */
+	uint64_t	size;		/* size of the file */
+
+	uint64_t	tab_ino;	/* the cache file */
+	uint64_t	tab_size;
+	int64_t		tab_mtime;
+
+	uint32_t	ndevs;
+	uint32_t	ntags;
+
+	uint64_t	devs_off;
+	uint64_t	tags_off;
+	uint64_t	tagidx_off;
+	uint64_t	strs_off;
+	uint64_t	strs_size;
+};
+
+struct bincache_dev {
+	uint64_t	devno;
+	int64_t		time;
+	int64_t		utime;
+	int32_t		pri;
+	uint32_t	name;		/* offset in strings */
+	uint32_t	tags;		/* index of the first tag */
+	uint32_t	ntags;
+};
+
+struct bincache_tag {
+	uint32_t	name;		/* offset in strings */
+	uint32_t	value;		/* offset in strings */
+	uint32_t	dev;		/* index of the device */
+};
+
+struct blkid_bincache {
+	void				*map;
+	size_t				mapsz;
+
+	const struct bincache_header	*hdr;
+	const struct bincache_dev	*devs;
+	const struct bincache_tag	*tags;
+	const uint32_t			*tagidx;
+	const char			*strs;
+
+	unsigned char			*loaded;	/* devices already in the list */
+};
+
+static const char *bincache_str(struct blkid_bincache *bc, uint32_t off)
+{
+	return off < bc->hdr->strs_size ? bc->strs + off : NULL;
+}
+
+static int bincache_area_ok(const struct bincache_header *hdr, uint64_t off,
+			    uint64_t n, size_t sz, size_t align)
+{
+	if (off % align || off < sizeof(*hdr) || off > hdr->size)
+		return 0;
+	return n <= (hdr->size - off) / sz;
+}
+
+static int bincache_verify(struct blkid_bincache *bc)
+{
+	const struct bincache_header *hdr = bc->hdr;
+	uint32_t i;
+
+	if (!bincache_area_ok(hdr, hdr->devs_off, hdr->ndevs,
+				sizeof(struct bincache_dev), sizeof(uint64_t)) ||
+	    !bincache_area_ok(hdr, hdr->tags_off, hdr->ntags,
+				sizeof(struct bincache_tag), sizeof(uint32_t)) ||
+	    !bincache_area_ok(hdr, hdr->tagidx_off, hdr->ntags,
+				sizeof(uint32_t), sizeof(uint32_t)) ||
+	    !bincache_area_ok(hdr, hdr->strs_off, hdr->strs_size, 1, 1) ||
+	    hdr->strs_size == 0 || hdr->strs_size > UINT32_MAX)
+		return 0;
+
+	bc->devs = (const struct bincache_dev *) ((char *) bc->map + hdr->devs_off);
+	bc->tags = (const struct bincache_tag *) ((char *) bc->map + hdr->tags_off);
+	bc->tagidx = (const uint32_t *) ((char *) bc->map + hdr->tagidx_off);
+	bc->strs = (const char *) bc->map + hdr->strs_off;
+
+	/* all strings are terminated by the last byte */
+	if (bc->strs[hdr->strs_size - 1] != '\0')
+		return 0;
+
+	for (i = 0; i < hdr->ndevs; i++) {
+		const struct bincache_dev *d = &bc->devs[i];
+
+		if (d->tags > hdr->ntags || d->ntags > hdr->ntags - d->tags)
+			return 0;
+	}
+	for (i = 0; i < hdr->ntags; i++) {
+		if (bc->tags[i].dev >= hdr->ndevs || bc->tagidx[i] >= hdr->ntags)
+			return 0;
+	}
+	return 1;
+}
+
+static void free_bincache(struct blkid_bincache *bc)
+{
+	if (!bc)
+		return;
+	if (bc->map)
+		munmap(bc->map, bc->mapsz);
+	free(bc->loaded);
+	free(bc);
+}
+
+static char *bincache_filename(const char *filename)
+{
+	char *name = NULL;
+
+	if (asprintf(&name, "%s" BLKID_BINCACHE_SUFFIX, filename) < 0)
+		return NULL;
+	return name;
+}
+
+/*
+ * Maps the binary cache file if it's up to date with the cache file
+ * described by @st. Returns 0 on success.
+ */
+int blkid_bincache_open(blkid_cache cache, const struct stat *st)
+{
+	struct blkid_bincache *bc = NULL;
+	const struct bincache_header *hdr;
+	struct stat bst;
+	char *name;
+	int fd;
+
+	if (!cache->bic_filename || !S_ISREG(st->st_mode))
+		return -BLKID_ERR_PARAM;
+
+	name = bincache_filename(cache->bic_filename);
+	if (!name)
+		return -BLKID_ERR_MEM;
+
+	fd = open(name, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		goto fail;
+	if (fstat(fd, &bst) < 0 || !S_ISREG(bst.st_mode)
+	    || (size_t) bst.st_size < sizeof(struct bincache_header)
+	    || (uint64_t) bst.st_size > SIZE_MAX)
+		goto fail;
+
+	bc = calloc(1, sizeof(*bc));
+	if (!bc)
+		goto fail;
+
+	bc->mapsz = bst.st_size;
+	bc->map = mmap(NULL, bc->mapsz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (bc->map == MAP_FAILED) {
+		bc->map = NULL;
+		goto fail;
+	}
+	bc->hdr = hdr = bc->map;
+
+	if (memcmp(hdr->magic, BINCACHE_MAGIC, sizeof(BINCACHE_MAGIC)) != 0
+	    || hdr->version != BINCACHE_VERSION
+	    || hdr->byteorder != BINCACHE_BYTEORDER
+	    || hdr->size != (uint64_t) bst.st_size) {
+		DBG(CACHE, ul_debug("%s: unsupported binary cache", name));
+		goto fail;
+	}
+	if (hdr->tab_ino != (uint64_t) st->st_ino
+	    || hdr->tab_size != (uint64_t) st->st_size
+	    || hdr->tab_mtime != (int64_t) st->st_mtime) {
+		DBG(CACHE, ul_debug("%s: outdated binary cache", name));
+		goto fail;
+	}
+	if (!bincache_verify(bc)) {
+		DBG(CACHE, ul_debug("%s: corrupted binary cache", name));
+		goto fail;
+	}
+	bc->loaded = calloc(hdr->ndevs ? hdr->ndevs : 1, 1);
+	if (!bc->loaded)
+		goto fail;
+
+	DBG(CACHE, ul_debug("mapped binary cache %s [devices=%u, tags=%u]",
+				name, hdr->ndevs, hdr->ntags));
+	close(fd);
+	free(name);
+
+	free_bincache(cache->bic_bin);
+	cache->bic_bin = bc;
+	return 0;
+fail:
+	if (fd >= 0)
+		close(fd);
+	free_bincache(bc);
+	free(name);
+	return -1;
+}
+
+/*
+ * Adds the device @idx from the binary cache to the cache devices list, the
+ * same way as blkid_read_cache() does for a line of the cache file.
+ */
+static blkid_dev bincache_get_dev(blkid_cache cache, struct blkid_bincache *bc,
+				  uint32_t idx)
+{
+	const struct bincache_dev *d = &bc->devs[idx];
+	const char *devname;
+	blkid_dev dev;
+	uint32_t i;
+
+	if (bc->loaded[idx])
+		return NULL;
+	bc->loaded[idx] = 1;
+
+	devname = bincache_str(bc, d->name);
+	if (!devname || !*devname)
+		return NULL;
+
+	DBG(READ, ul_debug("binary cache: found dev %s", devname));
+
+	dev = blkid_get_dev(cache, devname, BLKID_DEV_CREATE);
+	if (!dev)
+		return NULL;
+
+	dev->bid_devno = d->devno;
+	dev->bid_time = d->time;
+	dev->bid_utime = d->utime;
+	dev->bid_pri = d->pri;
+
+	for (i = d->tags; i < d->tags + d->ntags; i++) {
+		const char *name = bincache_str(bc, bc->tags[i].name);
+		const char *value = bincache_str(bc, bc->tags[i].value);
+
+		if (name && value)
+			blkid_set_tag(dev, name, value, strlen(value));
+	}
+
+	if (dev->bid_type == NULL) {
+		DBG(READ, ul_debug("blkid: device %s has no TYPE", dev->bid_name));
+		blkid_free_dev(dev);
+		return NULL;
+	}
+	return dev;
+}
+
+/*
+ * The binary cache is detached from the cache while the devices are
+ * created, so blkid_get_dev() does not try to load the rest of the file.
+ * The devices are read from disk, so it's not a change of the cache.
+ */
+static struct blkid_bincache *bincache_begin(blkid_cache cache, unsigned int *flags)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+
+	cache->bic_bin = NULL;
+	*flags = cache->bic_flags & BLKID_BIC_FL_CHANGED;
+	return bc;
+}
+
+static void bincache_end(blkid_cache cache, struct blkid_bincache *bc, unsigned int flags)
+{
+	cache->bic_flags &= ~BLKID_BIC_FL_CHANGED;
+	cache->bic_flags |= flags;
+	cache->bic_bin = bc;
+}
+
+static int cmp_tag(struct blkid_bincache *bc, uint32_t idx,
+		   const char *type, const char *value)
+{
+	const struct bincache_tag *t = &bc->tags[idx];
+	const char *name = bincache_str(bc, t->name);
+	const char *val = bincache_str(bc, t->value);
+	int rc;
+
+	rc = strcmp(name ? name : "", type);
+	if (rc == 0)
+		rc = strcmp(val ? val : "", value);
+	return rc;
+}
+
+/*
+ * Adds all devices with @type=@value tag from the binary cache to the cache
+ * devices list. Returns number of the added devices.
+ */
+int blkid_bincache_find(blkid_cache cache, const char *type, const char *value)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+	unsigned int flags;
+	uint32_t lo, hi;
+	int count = 0;
+
+	if (!bc)
+		return 0;
+
+	/* lower bound */
+	lo = 0;
+	hi = bc->hdr->ntags;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (cmp_tag(bc, bc->tagidx[mid], type, value) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	bc = bincache_begin(cache, &flags);
+	for (; lo < bc->hdr->ntags; lo++) {
+		uint32_t idx = bc->tagidx[lo];
+
+		if (cmp_tag(bc, idx, type, value) != 0)
+			break;
+		if (bincache_get_dev(cache, bc, bc->tags[idx].dev))
+			count++;
+	}
+	bincache_end(cache, bc, flags);
+
+	DBG(CACHE, ul_debug("binary cache: %s=%s: %d device(s)", type, value, count));
+	return count;
+}
+
+/*
+ * Adds all remaining devices from the binary cache to the cache devices
+ * list and unmaps the file. This has to be called before the list is used
+ * by anything else than blkid_find_dev_with_tag().
+ */
+void blkid_bincache_load(blkid_cache cache)
+{
+	struct blkid_bincache *bc = cache->bic_bin;
+	unsigned int flags;
+	uint32_t i;
+
+	if (!bc)
+		return;
+
+	DBG(CACHE, ul_debug("binary cache: loading all devices"));
+
+	bc = bincache_begin(cache, &flags);
+	for (i = 0; i < bc->hdr->ndevs; i++)
+		bincache_get_dev(cache, bc, i);
+	bincache_end(cache, NULL, flags);
+
+	free_bincache(bc);
+}
+
+void blkid_bincache_close(blkid_cache cache)
+{
+	free_bincache(cache->bic_bin);
+	cache->bic_bin = NULL;
+}
+
+/*
+ * Writer
+ */
+struct bincache_strs {
+	char	*data;
+	size_t	size;
+	size_t	alloc;
+};
+
+static int add_str(struct bincache_strs *ss, const char *str, uint32_t *off)
+{
+	size_t len = strlen(str) + 1;
+
+	if (ss->size + len > UINT32_MAX)
+		return -BLKID_ERR_MEM;
+	if (ss->size + len > ss->alloc) {
+		size_t sz = ss->alloc ? ss->alloc * 2 : 4096;
+		char *tmp;
+
+		while (sz < ss->size + len)
+			sz *= 2;
+		tmp = realloc(ss->data, sz);
+		if (!tmp)
+			return -BLKID_ERR_MEM;
+		ss->data = tmp;
+		ss->alloc = sz;
+	}
+	memcpy(ss->data + ss->size, str, len);
+	*off = ss->size;
+	ss->size += len;
+	return 0;
+}
+
+/* qsort_r() is not portable, the sort uses this global context */
+static const struct bincache_tag *sort_tags;
+static const char *sort_strs;
+
+static int cmp_tagidx(const void *a, const void *b)
+{
+	uint32_t ia = *((const uint32_t *) a), ib = *((const uint32_t *) b);
+	const struct bincache_tag *ta = &sort_tags[ia], *tb = &sort_tags[ib];
+	int rc;
+
+	rc = strcmp(sort_strs + ta->name, sort_strs + tb->name);
+	if (rc == 0)
+		rc = strcmp(sort_strs + ta->value, sort_strs + tb->value);
+	if (rc == 0)
+		rc = ia < ib ? -1 : ia > ib ? 1 : 0;
+	return rc;
+}
+
+static int is_saved_dev(blkid_dev dev)
+{
+	/* the same devices as written by save_dev() */
+	return dev->bid_type && dev->bid_name[0] == '/'
+	       && !(dev->bid_flags & BLKID_BID_FL_REMOVABLE);
+}
+
+/*
+ * Writes binary version of the cache file @filename. The cache file has to
+ * be already written. Returns 0 on success.
+ */
+int blkid_bincache_save(blkid_cache cache, const char *filename)
+{
+	struct bincache_header hdr;
+	struct bincache_dev *devs = NULL;
+	struct bincache_tag *tags = NULL;
+	uint32_t *tagidx = NULL;
+	struct bincache_strs ss = { .data = NULL };
+	struct list_head *p;
+	struct stat st;
+	char *name = NULL, *tmp = NULL;
+	size_t ndevs = 0, ntags = 0;
+	int fd = -1, rc = -BLKID_ERR_MEM;
+
+	if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode))
+		return -BLKID_ERR_PARAM;
+
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct list_head *t;
+
+		if (!is_saved_dev(dev))
+			continue;
+		ndevs++;
+		list_for_each(t, &dev->bid_tags)
+			ntags++;
+	}
+	if (ndevs > UINT32_MAX || ntags > UINT32_MAX)
+		goto done;
+
+	devs = calloc(ndevs ? ndevs : 1, sizeof(*devs));
+	tags = calloc(ntags ? ntags : 1, sizeof(*tags));
+	tagidx = calloc(ntags ? ntags : 1, sizeof(*tagidx));
+	if (!devs || !tags || !tagidx)
+		goto done;
+
+	ndevs = ntags = 0;
+	list_for_each(p, &cache->bic_devs) {
+		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
+		struct bincache_dev *d = &devs[ndevs];
+		struct list_head *t;
+
+		if (!is_saved_dev(dev))
+			continue;
+
+		d->devno = dev->bid_devno;
+		d->time = dev->bid_time;
+		d->utime = dev->bid_utime;
+		d->pri = dev->bid_pri;
+		d->tags = ntags;
+		if (add_str(&ss, dev->bid_name, &d->name))
+			goto done;
+
+		list_for_each(t, &dev->bid_tags) {
+			blkid_tag tag = list_entry(t, struct blkid_struct_tag, bit_tags);
+			struct bincache_tag *bt = &tags[ntags];
+
+			if (add_str(&ss, tag->bit_name, &bt->name) ||
+			    add_str(&ss, tag->bit_val, &bt->value))
+				goto done;
+			bt->dev = ndevs;
+			tagidx[ntags] = ntags;
+			ntags++;
+		}
+		d->ntags = ntags - d->tags;
+		ndevs++;
+	}
+
+	sort_tags = tags;
+	sort_strs = ss.data;
+	qsort(tagidx, ntags, sizeof(*tagidx), cmp_tagidx);
+	sort_tags = NULL;
+	sort_strs = NULL;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, BINCACHE_MAGIC, sizeof(BINCACHE_MAGIC));
+	hdr.version = BINCACHE_VERSION;
+	hdr.byteorder = BINCACHE_BYTEORDER;
+	hdr.tab_ino = st.st_ino;
+	hdr.tab_size = st.st_size;
+	hdr.tab_mtime = st.st_mtime;
+	hdr.ndevs = ndevs;
+	hdr.ntags = ntags;
+	hdr.devs_off = sizeof(hdr);
+	hdr.tags_off = hdr.devs_off + ndevs * sizeof(*devs);
+	hdr.tagidx_off = hdr.tags_off + ntags * sizeof(*tags);
+	hdr.strs_off = hdr.tagidx_off + ntags * sizeof(*tagidx);
+	hdr.strs_size = ss.size;
+	hdr.size = hdr.strs_off + ss.size;
+
+	name = bincache_filename(filename);
+	if (!name || asprintf(&tmp, "%s-XXXXXX", name) < 0) {
+		tmp = NULL;
+		goto done;
+	}
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0) {
+		rc = -errno;
+		goto done;
+	}
+	if (fchmod(fd, 0644) != 0
+	    || write_all(fd, &hdr, sizeof(hdr))
+	    || write_all(fd, devs, ndevs * sizeof(*devs))
+	    || write_all(fd, tags, ntags * sizeof(*tags))
+	    || write_all(fd, tagidx, ntags * sizeof(*tagidx))
+	    || write_all(fd, ss.data, ss.size)) {
+		rc = -errno;
+		goto done;
+	}
+	if (close(fd) != 0) {
+		fd = -1;
+		rc = -errno;
+		goto done;
+	}
+	fd = -1;
+	if (rename(tmp, name) != 0) {
+		rc = -errno;
+		goto done;
+	}
+	DBG(SAVE, ul_debug("wrote binary cache %s [devices=%u, tags=%u]",
+				name, hdr.ndevs, hdr.ntags));
+	rc = 0;
+done:
+	if (fd >= 0)
+		close(fd);
+	if (rc && tmp) {
+		DBG(SAVE, ul_debug("failed to write binary cache %s", name));
+		unlink(tmp);
+	}
+	free(tmp);
+	free(name);
+	free(ss.data);
+	free(devs);
+	free(tags);
+	free(tagidx);
+	return rc;
+}
+
+#ifdef TEST_PROGRAM
+int main(int argc, char **argv)
+{
+	blkid_cache cache = NULL;
+	blkid_dev dev;
+	char *type = NULL, *value = NULL;
+	int ret;
+
+	blkid_init_debug(BLKID_DEBUG_ALL);
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <cachefile> NAME=value\n"
+			"Search the binary cache\n", argv[0]);
+		exit(1);
+	}
+	if (blkid_parse_tag_string(argv[2], &type, &value) != 0) {
+		fprintf(stderr, "%s: cannot parse %s\n", argv[0], argv[2]);
+		exit(1);
+	}
+	if ((ret = blkid_get_cache(&cache, argv[1])) < 0) {
+		fprintf(stderr, "error %d reading cache file %s\n", ret, argv[1]);
+		exit(1);
+	}
+	if (!cache->bic_bin)
+		fprintf(stderr, "%s: binary cache not used\n", argv[1]);
+
+	ret = blkid_bincache_find(cache, type, value);
+	printf("%s=%s: %d device(s)\n", type, value, ret);
+
+	dev = blkid_find_dev_with_tag(cache, type, value);
+	if (dev)
+		printf("%s\n", blkid_dev_devname(dev));
+
+	free(type);
+	free(value);
+	blkid_put_cache(cache);
+	return dev ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
@@ -57,6 +57,14 @@ struct blkid_struct_dev
 	unsigned int		bid_flags;	/* Device status bitflags */
 	char			*bid_label;	/* Shortcut to device LABEL */
 	char			*bid_uuid;	/* Shortcut to binary UUID */
+
+	/* fingerprint for fast revalidation, see blkid_verify() */
+	uint64_t		bid_size;	/* Device size */
+	uint64_t		bid_fp_off;	/* Superblock magic offset */
+	unsigned int		bid_fp_len;	/* Magic length, 0 if not known */
+	uint32_t		bid_fp_crc;	/* Checksum of the magic sector(s) */
+	unsigned int		bid_fp_dlen;	/* Whole-disk area length, 0 if not partition */
+	uint32_t		bid_fp_dcrc;	/* Checksum of the whole-disk area */
 };
 
 #define BLKID_BID_FL_VERIFIED	0x0001	/* Device data validated from disk */
@@ -74,6 +82,8 @@ struct blkid_struct_tag
 {
 	struct list_head	bit_tags;	/* All tags for this device */
 	struct list_head	bit_names;	/* All tags with given NAME */
+	struct list_head	bit_hash;	/* Tags with the same NAME=value hash */
+	unsigned int		bit_hashval;	/* hash of NAME=value */
 	char			*bit_name;	/* NAME of tag (shared) */
 	char			*bit_val;	/* value of tag */
 	blkid_dev		bit_dev;	/* pointer to device */
@@ -99,6 +109,7 @@ struct blkid_chain {
 	int		binary;		/* boolean */
 	int		idx;		/* index of the current prober (or -1) */
 	unsigned long	*fltr;		/* filter or NULL */
+	unsigned long	*mfltr;		/* magic strings prefilter or NULL */
 	void		*data;		/* private chain data or NULL */
 };
 
@@ -181,10 +192,17 @@ struct blkid_idinfo
  */
 #define BLKID_IDINFO_TOLERANT	(1 << 1)
 
+/*
+ * metadata at the end of the device (RAIDs) -- read-ahead planner reads the
+ * end of the device by one read for all such probing functions.
+ */
+#define BLKID_IDINFO_TAILMETA	(1 << 2)
+
 struct blkid_bufinfo {
 	unsigned char		*data;
 	uint64_t		off;
 	uint64_t		len;
+	uint64_t		maxend;	/* max. end of this and all previous buffers in the index */
 	struct list_head	bufs;	/* list of buffers */
 };
 
@@ -197,6 +215,24 @@ struct blkid_hint {
 	struct list_head	hints;
 };
 
+/*
+ * Per-prober statistics, see blkid_probe_enable_stats()
+ */
+struct blkid_prstat {
+	const char	*chain;		/* chain driver name */
+	const char	*name;		/* probing function name or NULL for chain */
+	uint64_t	usec;
+	uint64_t	nreads;
+	uint64_t	nbytes;
+};
+
+struct blkid_prstat_mark {
+	int		enabled;
+	uint64_t	usec;
+	uint64_t	nreads;
+	uint64_t	nbytes;
+};
+
 /*
  * Low-level probing control struct
  */
@@ -220,6 +256,20 @@ struct blkid_struct_probe
 	struct blkid_chain	*wipe_chain;	/* superblock, partition, ... */
 
 	struct list_head	buffers;	/* list of buffers */
+	struct blkid_bufinfo	**bufidx;	/* buffers sorted by offset */
+	size_t			nbufs;		/* number of buffers in bufidx */
+	size_t			bufidx_sz;	/* allocated size of bufidx */
+	uint64_t		buf_hits;	/* number of requests read from buffers */
+	uint64_t		buf_misses;	/* number of requests read from device */
+	uint64_t		io_nreads;	/* number of reads from device */
+	uint64_t		io_nbytes;	/* number of bytes read from device */
+	struct blkid_prstat	*stats;		/* per-prober statistics */
+	size_t			nstats;
+	int			io_backend;	/* BLKID_IOBACKEND_* for read-ahead */
+	struct blkid_uring	*uring;		/* io_uring for read-ahead or NULL */
+	int			direct_fd;	/* device opened with O_DIRECT or -1 */
+	char			**memo_names;	/* names of values from results cache */
+	size_t			nmemo_names;
 	struct list_head	hints;
 
 	struct blkid_chain	chains[BLKID_NCHAINS];	/* array of chains */
@@ -237,11 +287,32 @@ struct blkid_struct_probe
 #define BLKID_FL_CDROM_DEV	(1 << 3)	/* is a CD/DVD drive */
 #define BLKID_FL_NOSCAN_DEV	(1 << 4)	/* do not scan this device */
 #define BLKID_FL_MODIF_BUFF	(1 << 5)	/* cached buffers has been modified */
+#define BLKID_FL_PREFETCH	(1 << 6)	/* read-ahead for magic strings */
+#define BLKID_FL_DIRECTIO	(1 << 7)	/* cache-neutral (O_DIRECT) reads */
+#define BLKID_FL_NODIRECT	(1 << 8)	/* O_DIRECT unusable for the device */
+#define BLKID_FL_MEMO		(1 << 9)	/* shared cache of safeprobe results */
+#define BLKID_FL_STATS		(1 << 10)	/* per-prober statistics */
+#define BLKID_FL_SHARED_DISK	(1 << 11)	/* cached whole-disk probe */
+#define BLKID_FL_PARTLIST	(1 << 12)	/* whole-disk partitions parsed */
+
+/* minimal alignment for O_DIRECT reads, see blkid_probe_enable_direct_io() */
+#define BLKID_DIRECTIO_ALIGN	4096
+
+/* read-ahead planner limits, see blkid_probe_enable_prefetch() */
+#define BLKID_PREFETCH_GAP	(64 * 1024)	/* max. gap between merged areas */
+#define BLKID_PREFETCH_MAXSZ	(1024 * 1024)	/* max. size of one read */
+#define BLKID_PREFETCH_TAILSZ	(2 * 1024 * 1024) /* end of the device for RAIDs */
 
 /* private per-probing flags */
 #define BLKID_PROBE_FL_IGNORE_PT (1 << 1)	/* ignore partition table */
+#define BLKID_PROBE_FL_CSUM_DEFERRED (1 << 2)	/* checksum of the result not verified */
+#define BLKID_PROBE_FL_FORCE_CSUM (1 << 3)	/* ignore BLKID_SUBLKS_LAZYCSUM */
 
 extern blkid_probe blkid_clone_probe(blkid_probe parent);
+extern void blkid_probe_reset_prefilter(blkid_probe pr);
+
+#define blkid_probe_is_prefiltered(chn, idx) \
+		((chn)->mfltr && blkid_bmp_get_item((chn)->mfltr, (idx)))
 extern blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr);
 
 /*
@@ -262,6 +333,7 @@ struct blkid_config {
 	int nevals;			/* number of elems in eval array */
 	int uevent;			/* SEND_UEVENT=<yes|not> option */
 	char *cachefile;		/* CACHE_FILE=<path> option */
+	int bincache;			/* BINARY_CACHE=<yes|no> option */
 };
 
 extern struct blkid_config *blkid_read_config(const char *filename)
@@ -297,8 +369,32 @@ struct blkid_struct_cache
 	unsigned int		bic_flags;	/* Status flags of the cache */
 	char			*bic_filename;	/* filename of cache */
 	blkid_probe		probe;		/* low-level probing stuff */
+
+	struct blkid_presult	*bic_presults;	/* results from parallel probing */
+	size_t			bic_npresults;	/* number of the results */
+
+	struct blkid_bincache	*bic_bin;	/* mmap'ed binary cache file */
+
+	struct list_head	*bic_taghash;	/* NAME=value -> tags hash table */
+	size_t			bic_taghashsz;	/* number of the hash buckets */
+	size_t			bic_ntaghash;	/* number of the tags in the table */
 };
 
+/*
+ * Result of the device probing done by blkid_probe_all_parallel() worker
+ * threads. The results are sorted by devno and used by blkid_verify().
+ */
+struct blkid_presult {
+	dev_t		devno;		/* device number */
+	char		*name;		/* kernel device name */
+	blkid_dev	dev;		/* detached device with the probing result */
+	int		rc;		/* 0 success, 1 nothing detected, <0 error */
+	int		done;		/* probed by a worker thread */
+};
+
+/* default max. number of threads, see blkid_probe_all_parallel() */
+#define BLKID_PROBE_MAXWORKERS	64
+
 #define BLKID_BIC_FL_PROBED	0x0002	/* We probed /proc/partition devices */
 #define BLKID_BIC_FL_CHANGED	0x0004	/* Cache has changed from disk */
 
@@ -313,6 +409,9 @@ struct blkid_struct_cache
 /* old systems */
 #define BLKID_CACHE_FILE_OLD	"/etc/blkid.tab"
 
+/* suffix of the binary cache file (generated from the cache file) */
+#define BLKID_BINCACHE_SUFFIX	".bin"
+
 #define BLKID_PROBE_OK	 0
 #define BLKID_PROBE_NONE 1
 
@@ -347,6 +446,7 @@ struct blkid_struct_cache
 #define BLKID_DEBUG_SAVE	(1 << 11)
 #define BLKID_DEBUG_TAG		(1 << 12)
 #define BLKID_DEBUG_BUFFER	(1 << 13)
+#define BLKID_DEBUG_TIMING	(1 << 14)
 #define BLKID_DEBUG_ALL		0xFFFF		/* (1 << 16) aka FFFF is expected by API */
 
 UL_DEBUG_DECLARE_MASK(libblkid);
@@ -369,6 +469,14 @@ extern void blkid__scan_dir(char *, dev_t, struct dir_list **, char **)
 extern int blkid_driver_has_major(const char *drvname, int drvmaj)
 			__attribute__((warn_unused_result));
 
+/* devname.c */
+extern struct blkid_presult *blkid_get_presult(blkid_cache cache, dev_t devno)
+			__attribute__((nonnull));
+
+/* verify.c */
+extern int blkid_probe_to_dev(blkid_probe pr, int fd, blkid_dev dev)
+			__attribute__((nonnull));
+
 /* read.c */
 extern void blkid_read_cache(blkid_cache cache)
 			__attribute__((nonnull));
@@ -377,6 +485,45 @@ extern void blkid_read_cache(blkid_cache cache)
 extern int blkid_flush_cache(blkid_cache cache)
 			__attribute__((nonnull));
 
+/* uring.c */
+extern int blkid_probe_uring_read(blkid_probe pr, struct blkid_bufinfo **bufs,
+				  size_t nbufs)
+			__attribute__((nonnull));
+extern void blkid_probe_free_uring(blkid_probe pr)
+			__attribute__((nonnull));
+extern int blkid_probe_uring_supported(void);
+
+/* stats.c */
+extern uint64_t blkid_monotonic_usec(void);
+extern void blkid_probe_stat_start(blkid_probe pr, struct blkid_prstat_mark *mk)
+			__attribute__((nonnull));
+extern void blkid_probe_stat_end(blkid_probe pr, struct blkid_prstat_mark *mk,
+			const char *chain, const char *name)
+			__attribute__((nonnull(1, 2, 3)));
+extern void blkid_probe_reset_stats(blkid_probe pr)
+			__attribute__((nonnull));
+
+/* memo.c */
+extern int blkid_probe_memo_lookup(blkid_probe pr, int *rc)
+			__attribute__((nonnull));
+extern void blkid_probe_memo_store(blkid_probe pr, int rc)
+			__attribute__((nonnull));
+extern void blkid_probe_free_memo(blkid_probe pr)
+			__attribute__((nonnull));
+
+/* bincache.c */
+extern int blkid_bincache_open(blkid_cache cache, const struct stat *st)
+			__attribute__((nonnull));
+extern void blkid_bincache_load(blkid_cache cache)
+			__attribute__((nonnull));
+extern int blkid_bincache_find(blkid_cache cache, const char *type,
+			       const char *value)
+			__attribute__((nonnull));
+extern void blkid_bincache_close(blkid_cache cache)
+			__attribute__((nonnull));
+extern int blkid_bincache_save(blkid_cache cache, const char *filename)
+			__attribute__((nonnull));
+
 /* cache */
 extern char *blkid_safe_getenv(const char *arg)
 			__attribute__((nonnull))
@@ -388,6 +535,10 @@ extern char *blkid_get_cache_filename(struct blkid_config *conf)
  * Functions to create and find a specific tag type: tag.c
  */
 extern void blkid_free_tag(blkid_tag tag);
+extern int blkid_init_taghash(blkid_cache cache)
+			__attribute__((nonnull));
+extern void blkid_free_taghash(blkid_cache cache)
+			__attribute__((nonnull));
 extern blkid_tag blkid_find_tag_dev(blkid_dev dev, const char *type)
 			__attribute__((nonnull))
 			__attribute__((warn_unused_result));
@@ -517,6 +668,8 @@ extern int blkid_probe_set_magic(blkid_probe pr, uint64_t offset,
 
 extern int blkid_probe_verify_csum(blkid_probe pr, uint64_t csum, uint64_t expected)
 			__attribute__((nonnull));
+extern int blkid_probe_need_csum(blkid_probe pr)
+			__attribute__((nonnull));
 
 extern void blkid_unparse_uuid(const unsigned char *uuid, char *str, size_t len)
 			__attribute__((nonnull));
@@ -106,6 +106,11 @@ int blkid_get_cache(blkid_cache *ret_cache, const char *filename)
 	INIT_LIST_HEAD(&cache->bic_devs);
 	INIT_LIST_HEAD(&cache->bic_tags);
 
+	if (blkid_init_taghash(cache) != 0) {
+		free(cache);
+		return -BLKID_ERR_MEM;
+	}
+
 	if (filename && !*filename)
 		filename = NULL;
 	if (filename)
@@ -130,6 +135,7 @@ void blkid_put_cache(blkid_cache cache)
 		return;
 
 	(void) blkid_flush_cache(cache);
+	blkid_bincache_close(cache);
 
 	DBG(CACHE, ul_debugobj(cache, "freeing cache struct"));
 
@@ -161,6 +167,7 @@ void blkid_put_cache(blkid_cache cache)
 	}
 
 	blkid_free_probe(cache->probe);
+	blkid_free_taghash(cache);
 
 	free(cache->bic_filename);
 	free(cache);
@@ -180,6 +187,8 @@ void blkid_gc_cache(blkid_cache cache)
 	if (!cache)
 		return;
 
+	blkid_bincache_load(cache);
+
 	list_for_each_safe(p, pnext, &cache->bic_devs) {
 		blkid_dev dev = list_entry(p, struct blkid_struct_dev, bid_devs);
 		if (stat(dev->bid_name, &st) < 0) {
@@ -33,6 +33,9 @@
 #include <errno.h>
 #endif
 #include <time.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "blkidP.h"
 
@@ -56,6 +59,8 @@ blkid_dev blkid_get_dev(blkid_cache cache, const char *devname, int flags)
 	if (!cache || !devname)
 		return NULL;
 
+	blkid_bincache_load(cache);
+
 	/* search by name */
 	list_for_each(p, &cache->bic_devs) {
 		tmp = list_entry(p, struct blkid_struct_dev, bid_devs);
@@ -415,12 +420,81 @@ ubi_probe_all(blkid_cache cache, int only_if_new)
 	}
 }
 
+/*
+ * Add device to the list of devices for parallel probing
+ */
+static int add_presult(blkid_cache cache, const char *name, dev_t devno)
+{
+	struct blkid_presult *res;
+
+	res = realloc(cache->bic_presults,
+			(cache->bic_npresults + 1) * sizeof(struct blkid_presult));
+	if (!res)
+		return -BLKID_ERR_MEM;
+	cache->bic_presults = res;
+
+	res = &cache->bic_presults[cache->bic_npresults];
+	memset(res, 0, sizeof(*res));
+	res->devno = devno;
+	res->name = strdup(name);
+	if (!res->name)
+		return -BLKID_ERR_MEM;
+
+	cache->bic_npresults++;
+	return 0;
+}
+
+static void free_presults(blkid_cache cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->bic_npresults; i++) {
+		struct blkid_presult *res = &cache->bic_presults[i];
+
+		blkid_free_dev(res->dev);
+		free(res->name);
+	}
+	free(cache->bic_presults);
+	cache->bic_presults = NULL;
+	cache->bic_npresults = 0;
+}
+
+static int cmp_presults(const void *a0, const void *b0)
+{
+	const struct blkid_presult *a = a0, *b = b0;
+
+	return a->devno < b->devno ? -1 : a->devno > b->devno ? 1 : 0;
+}
+
+/*
+ * Returns result from parallel probing or NULL if the device has not been
+ * probed by worker threads.
+ */
+struct blkid_presult *blkid_get_presult(blkid_cache cache, dev_t devno)
+{
+	struct blkid_presult key = { .devno = devno }, *res;
+
+	if (!cache->bic_npresults)
+		return NULL;
+
+	res = bsearch(&key, cache->bic_presults, cache->bic_npresults,
+			sizeof(struct blkid_presult), cmp_presults);
+	if (res && res->done) {
+		DBG(DEVNAME, ul_debug("using result from parallel probing for %s", res->name));
+		return res;
+	}
+	return NULL;
+}
+
 /*
  * This function uses /sys to read all block devices in way compatible with
  * /proc/partitions (like the original libblkid implementation)
+ *
+ * If @collect is true, then the devices are only added to the list for the
+ * parallel probing and the cache is not modified.
  */
 static int
-sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
+sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable, int collect)
 {
 	DIR *sysfs;
 	struct dirent *dev;
@@ -496,15 +570,21 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 			DBG(DEVNAME, ul_debug(" Probe partition dev %s, devno 0x%04X",
                                    part->d_name, (unsigned int) partno));
 			nparts++;
-			probe_one(cache, part->d_name, partno, 0, only_if_new, 0);
+			if (collect)
+				add_presult(cache, part->d_name, partno);
+			else
+				probe_one(cache, part->d_name, partno, 0, only_if_new, 0);
 		}
 
 		if (!nparts) {
 			/* add non-partitioned whole disk to cache */
 			DBG(DEVNAME, ul_debug(" Probe whole dev %s, devno 0x%04X",
 				   dev->d_name, (unsigned int) devno));
-			probe_one(cache, dev->d_name, devno, 0, only_if_new, 0);
-		} else {
+			if (collect)
+				add_presult(cache, dev->d_name, devno);
+			else
+				probe_one(cache, dev->d_name, devno, 0, only_if_new, 0);
+		} else if (!collect) {
 			/* remove partitioned whole-disk from cache */
 			struct list_head *p, *pnext;
 
@@ -530,10 +610,114 @@ sysfs_probe_all(blkid_cache cache, int only_if_new, int only_removable)
 	return 0;
 }
 
+#ifdef HAVE_PTHREAD_H
+/*
+ * Parallel probing -- the devices from /sys/block are probed by worker
+ * threads, every thread uses its own prober and stores the result to a
+ * detached (not in cache) device. The results are later used by
+ * blkid_verify() called from the serial probe_all() code, so the cache is
+ * modified only by the calling thread and the order of the devices in the
+ * cache is the same as without threads.
+ */
+struct probe_workers {
+	blkid_cache	cache;
+	pthread_mutex_t	lock;
+	size_t		next;		/* the next not yet probed result */
+};
+
+static void probe_presult(blkid_probe pr, struct blkid_presult *res)
+{
+	char device[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	/* keep non-standard names on blkid_verify() */
+	snprintf(device, sizeof(device), "/dev/%s", res->name);
+	if (stat(device, &st) != 0 || !S_ISBLK(st.st_mode)
+	    || st.st_rdev != res->devno)
+		return;
+	if (sysfs_devno_is_dm_private(res->devno, NULL))
+		return;
+
+	fd = open(device, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd < 0)
+		return;
+
+	res->dev = blkid_new_dev();
+	if (res->dev) {
+		res->rc = blkid_probe_to_dev(pr, fd, res->dev);
+		res->done = 1;
+	}
+	close(fd);
+}
+
+static void *probe_worker(void *data)
+{
+	struct probe_workers *wk = (struct probe_workers *) data;
+	blkid_probe pr;
+
+	pr = blkid_new_probe();
+	if (!pr)
+		return NULL;
+
+	do {
+		struct blkid_presult *res = NULL;
+
+		pthread_mutex_lock(&wk->lock);
+		if (wk->next < wk->cache->bic_npresults)
+			res = &wk->cache->bic_presults[wk->next++];
+		pthread_mutex_unlock(&wk->lock);
+
+		if (!res)
+			break;
+		probe_presult(pr, res);
+	} while (1);
+
+	blkid_free_probe(pr);
+	return NULL;
+}
+
+static void parallel_probe(blkid_cache cache, unsigned int nworkers)
+{
+	struct probe_workers wk = { .cache = cache };
+	pthread_t *threads;
+	unsigned int i, nthreads = 0;
+
+	sysfs_probe_all(cache, 0, 0, TRUE);
+	if (!cache->bic_npresults)
+		return;
+
+	qsort(cache->bic_presults, cache->bic_npresults,
+			sizeof(struct blkid_presult), cmp_presults);
+
+	if (nworkers > cache->bic_npresults)
+		nworkers = cache->bic_npresults;
+
+	threads = calloc(nworkers, sizeof(pthread_t));
+	if (!threads)
+		return;
+
+	DBG(DEVNAME, ul_debug("probing %zu devices by %u threads",
+				cache->bic_npresults, nworkers));
+
+	pthread_mutex_init(&wk.lock, NULL);
+	for (i = 0; i < nworkers; i++) {
+		if (pthread_create(&threads[i], NULL, probe_worker, &wk) != 0)
+			break;
+		nthreads++;
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wk.lock);
+	free(threads);
+}
+#endif /* HAVE_PTHREAD_H */
+
 /*
  * Read the device data for all available block devices in the system.
  */
-static int probe_all(blkid_cache cache, int only_if_new)
+static int probe_all(blkid_cache cache, int only_if_new, unsigned int nworkers)
 {
 	if (!cache)
 		return -BLKID_ERR_PARAM;
@@ -543,13 +727,19 @@ static int probe_all(blkid_cache cache, int only_if_new)
 		return 0;
 
 	blkid_read_cache(cache);
+	blkid_bincache_load(cache);
+#ifdef HAVE_PTHREAD_H
+	if (nworkers > 1)
+		parallel_probe(cache, nworkers);
+#endif
 #ifdef VG_DIR
 	lvm_probe_all(cache, only_if_new);
 #endif
 	ubi_probe_all(cache, only_if_new);
 
-	sysfs_probe_all(cache, only_if_new, 0);
+	sysfs_probe_all(cache, only_if_new, 0, FALSE);
 
+	free_presults(cache);
 	blkid_flush_cache(cache);
 	return 0;
 }
@@ -567,7 +757,7 @@ int blkid_probe_all(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all()"));
-	ret = probe_all(cache, 0);
+	ret = probe_all(cache, 0, 0);
 	if (ret == 0) {
 		cache->bic_time = time(NULL);
 		cache->bic_flags |= BLKID_BIC_FL_PROBED;
@@ -576,6 +766,48 @@ int blkid_probe_all(blkid_cache cache)
 	return ret;
 }
 
+/**
+ * blkid_probe_all_parallel:
+ * @cache: cache handler
+ * @nworkers: number of threads or 0 for default
+ *
+ * The same as blkid_probe_all(), but the block devices are probed by
+ * @nworkers threads. The cache is modified only by the calling thread and
+ * the order of the devices in the cache is the same as for
+ * blkid_probe_all(). The default number of threads is four times the number
+ * of online CPUs, but no more than 64.
+ *
+ * If the library has been compiled without threads support, then this
+ * function is the same as blkid_probe_all().
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, or number less than zero in case of error.
+ */
+int blkid_probe_all_parallel(blkid_cache cache, unsigned int nworkers)
+{
+	int ret;
+
+	blkid_init_debug(0);
+
+	if (!nworkers) {
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nworkers = ncpus > 0 ? ncpus * 4 : 1;
+		if (nworkers > BLKID_PROBE_MAXWORKERS)
+			nworkers = BLKID_PROBE_MAXWORKERS;
+	}
+
+	DBG(PROBE, ul_debug("Begin blkid_probe_all_parallel() [workers=%u]", nworkers));
+	ret = probe_all(cache, 0, nworkers);
+	if (ret == 0) {
+		cache->bic_time = time(NULL);
+		cache->bic_flags |= BLKID_BIC_FL_PROBED;
+	}
+	DBG(PROBE, ul_debug("End blkid_probe_all_parallel() [rc=%d]", ret));
+	return ret;
+}
+
 /**
  * blkid_probe_all_new:
  * @cache: cache handler
@@ -589,7 +821,7 @@ int blkid_probe_all_new(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all_new()"));
-	ret = probe_all(cache, 1);
+	ret = probe_all(cache, 1, 0);
 	DBG(PROBE, ul_debug("End blkid_probe_all_new() [rc=%d]", ret));
 	return ret;
 }
@@ -617,7 +849,8 @@ int blkid_probe_all_removable(blkid_cache cache)
 	int ret;
 
 	DBG(PROBE, ul_debug("Begin blkid_probe_all_removable()"));
-	ret = sysfs_probe_all(cache, 0, 1);
+	blkid_bincache_load(cache);
+	ret = sysfs_probe_all(cache, 0, 1, FALSE);
 	DBG(PROBE, ul_debug("End blkid_probe_all_removable() [rc=%d]", ret));
 	return ret;
 }
@@ -14,6 +14,7 @@
 #include <stdarg.h>
 
 #include "blkidP.h"
+#include "ulstats.h"
 
 UL_DEBUG_DEFINE_MASK(libblkid);
 UL_DEBUG_DEFINE_MASKNAMES(libblkid) =
@@ -32,6 +33,7 @@ UL_DEBUG_DEFINE_MASKNAMES(libblkid) =
 	{ "read", BLKID_DEBUG_READ,	"cache parsing" },
 	{ "save", BLKID_DEBUG_SAVE,	"cache writing" },
 	{ "tag", BLKID_DEBUG_TAG,	"tags utils" },
+	{ "timing", BLKID_DEBUG_TIMING,	"per-prober time and I/O statistics" },
 	{ NULL, 0, NULL }
 };
 
@@ -51,6 +53,7 @@ void blkid_init_debug(int mask)
 		return;
 
 	__UL_INIT_DEBUG_FROM_ENV(libblkid, BLKID_DEBUG_, mask, LIBBLKID_DEBUG);
+	ul_stats_init("libblkid");
 
 	if (libblkid_debug_mask != BLKID_DEBUG_INIT
 	    && libblkid_debug_mask != (BLKID_DEBUG_HELP|BLKID_DEBUG_INIT)) {
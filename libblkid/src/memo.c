@@ -0,0 +1,468 @@
+/*
+ * memo.c - shared cache of the blkid_do_safeprobe() results
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The result is stored to BLKID_RUNTIME_DIR/probe-<maj>:<min> and it is
+ * reused if the device has the same size, the probe has the same setting and
+ * all the areas read from the device by the previous probing contain the same
+ * data (the fingerprint is a hash of the areas). The probing functions depend
+ * only on the data, so if the same data are read, the same result is
+ * returned. The exception is the topology chain, its values come from the
+ * kernel, so the kernel's queue limits are part of the probe setting.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "blkidP.h"
+#include "all-io.h"
+#include "fileutils.h"
+#include "sysfs.h"
+
+#define MEMO_MAGIC	"BLKIDPM"
+#define MEMO_VERSION	1
+#define MEMO_MAXSZ	(1024 * 1024)	/* max. size of the file */
+
+struct memo_header {
+	char		magic[8];	/* MEMO_MAGIC */
+	uint32_t	version;	/* MEMO_VERSION */
+	int32_t		rc;		/* blkid_do_safeprobe() return code */
+
+	uint64_t	devno;
+	uint64_t	size;
+	uint64_t	setting;	/* hash of the probe setting */
+	uint64_t	fingerprint;	/* hash of the data in areas */
+
+	uint32_t	nareas;
+	uint32_t	nvalues;
+};
+
+struct memo_area {
+	uint32_t	disk;		/* 1 for the whole-disk probe */
+	uint32_t	reserved;
+	uint64_t	off;		/* offset from the begin of the device */
+	uint64_t	len;
+};
+
+struct memo_value {
+	uint32_t	chain;		/* BLKID_CHAIN_* */
+	uint32_t	namesz;		/* including terminator */
+	uint32_t	len;		/* data length (without terminator) */
+};
+
+#define FNV_INIT	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+static uint64_t memo_hash(uint64_t h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		h = (h ^ p[i]) * FNV_PRIME;
+	return h;
+}
+
+/*
+ * The topology does not depend on the data, reshaped dm or md device has the
+ * same data but another I/O limits. The queue directory is available for
+ * whole-disks only.
+ */
+static uint64_t memo_topology(blkid_probe pr, uint64_t h)
+{
+	static const char *attrs[] = {
+		"queue/minimum_io_size",
+		"queue/optimal_io_size",
+		"queue/logical_block_size",
+		"queue/physical_block_size",
+		"queue/dax"
+	};
+	struct path_cxt *pc;
+	dev_t disk;
+	int64_t x;
+	size_t i;
+
+	pc = ul_new_sysfs_path(pr->devno, NULL, NULL);
+	if (!pc)
+		return h;
+	x = -1;
+	ul_path_read_s64(pc, &x, "alignment_offset");
+	h = memo_hash(h, &x, sizeof(x));
+
+	disk = blkid_probe_get_wholedisk_devno(pr);
+	if (disk && disk != pr->devno) {
+		ul_unref_path(pc);
+		pc = ul_new_sysfs_path(disk, NULL, NULL);
+		if (!pc)
+			return h;
+	}
+	for (i = 0; i < ARRAY_SIZE(attrs); i++) {
+		x = -1;
+		ul_path_read_s64(pc, &x, attrs[i]);
+		h = memo_hash(h, &x, sizeof(x));
+	}
+	ul_unref_path(pc);
+	return h;
+}
+
+/* hash of everything what may affect the probing result except the data */
+static uint64_t memo_setting(blkid_probe pr)
+{
+	uint64_t h = FNV_INIT;
+	uint64_t x;
+	struct list_head *p;
+	int i;
+
+	h = memo_hash(h, BLKID_VERSION, sizeof(BLKID_VERSION));
+	h = memo_hash(h, &pr->off, sizeof(pr->off));
+	h = memo_hash(h, &pr->size, sizeof(pr->size));
+	h = memo_hash(h, &pr->zone_size, sizeof(pr->zone_size));
+	x = blkid_probe_get_sectorsize(pr);
+	h = memo_hash(h, &x, sizeof(x));
+	x = pr->flags & (BLKID_FL_TINY_DEV | BLKID_FL_CDROM_DEV);
+	h = memo_hash(h, &x, sizeof(x));
+
+	for (i = 0; i < BLKID_NCHAINS; i++) {
+		struct blkid_chain *chn = &pr->chains[i];
+
+		h = memo_hash(h, &chn->enabled, sizeof(chn->enabled));
+		if (!chn->enabled)
+			continue;
+		h = memo_hash(h, &chn->flags, sizeof(chn->flags));
+		x = chn->fltr ? 1 : 0;
+		h = memo_hash(h, &x, sizeof(x));
+		if (chn->fltr)
+			h = memo_hash(h, chn->fltr,
+				blkid_bmp_nbytes(chn->driver->nidinfos));
+	}
+
+	if (pr->chains[BLKID_CHAIN_TOPLGY].enabled)
+		h = memo_topology(pr, h);
+
+	list_for_each(p, &pr->hints) {
+		struct blkid_hint *hint = list_entry(p, struct blkid_hint, hints);
+
+		h = memo_hash(h, hint->name, strlen(hint->name) + 1);
+		h = memo_hash(h, &hint->value, sizeof(hint->value));
+	}
+	return h;
+}
+
+static int memo_is_usable(blkid_probe pr)
+{
+	return (pr->flags & BLKID_FL_MEMO) && !pr->parent
+		&& S_ISBLK(pr->mode) && pr->devno
+		&& !(pr->flags & BLKID_FL_MODIF_BUFF);
+}
+
+static char *memo_filename(blkid_probe pr)
+{
+	char *name = NULL;
+
+	if (asprintf(&name, BLKID_RUNTIME_DIR "/probe-%u:%u",
+			major(pr->devno), minor(pr->devno)) < 0)
+		return NULL;
+	return name;
+}
+
+/* returns the same string for the same name, the names live with the probe */
+static const char *memo_intern_name(blkid_probe pr, const char *name)
+{
+	size_t i;
+	char **tmp, *str;
+
+	for (i = 0; i < pr->nmemo_names; i++) {
+		if (strcmp(pr->memo_names[i], name) == 0)
+			return pr->memo_names[i];
+	}
+
+	tmp = realloc(pr->memo_names, (pr->nmemo_names + 1) * sizeof(char *));
+	if (!tmp)
+		return NULL;
+	pr->memo_names = tmp;
+
+	str = strdup(name);
+	if (!str)
+		return NULL;
+	pr->memo_names[pr->nmemo_names++] = str;
+	return str;
+}
+
+void blkid_probe_free_memo(blkid_probe pr)
+{
+	size_t i;
+
+	for (i = 0; i < pr->nmemo_names; i++)
+		free(pr->memo_names[i]);
+	free(pr->memo_names);
+	pr->memo_names = NULL;
+	pr->nmemo_names = 0;
+}
+
+static unsigned char *memo_read_file(blkid_probe pr, size_t *sz)
+{
+	unsigned char *buf = NULL;
+	struct stat st;
+	char *name;
+	int fd;
+
+	name = memo_filename(pr);
+	if (!name)
+		return NULL;
+
+	fd = open(name, O_RDONLY|O_CLOEXEC);
+	free(name);
+	if (fd < 0)
+		return NULL;
+
+	/* don't trust files which may be modified by others */
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+	    || (st.st_uid != 0 && st.st_uid != geteuid())
+	    || (st.st_mode & (S_IWGRP | S_IWOTH))
+	    || st.st_size < (off_t) sizeof(struct memo_header)
+	    || st.st_size > MEMO_MAXSZ)
+		goto done;
+
+	buf = malloc(st.st_size);
+	if (!buf)
+		goto done;
+	if (read_all(fd, (char *) buf, st.st_size) != st.st_size) {
+		free(buf);
+		buf = NULL;
+		goto done;
+	}
+	*sz = st.st_size;
+done:
+	close(fd);
+	return buf;
+}
+
+/*
+ * Checks the stored result and adds the values to the probe. Returns 0 and
+ * the stored blkid_do_safeprobe() return code in @rc, or 1 if not found.
+ */
+int blkid_probe_memo_lookup(blkid_probe pr, int *rc)
+{
+	struct memo_header *hdr;
+	unsigned char *buf, *p, *end;
+	uint64_t fp = FNV_INIT;
+	size_t sz = 0;
+	uint32_t i;
+	int res = 1;
+
+	if (!memo_is_usable(pr))
+		return 1;
+
+	buf = memo_read_file(pr, &sz);
+	if (!buf)
+		return 1;
+
+	hdr = (struct memo_header *) buf;
+	if (memcmp(hdr->magic, MEMO_MAGIC, sizeof(MEMO_MAGIC)) != 0
+	    || hdr->version != MEMO_VERSION
+	    || hdr->devno != (uint64_t) pr->devno
+	    || hdr->size != pr->size
+	    || hdr->setting != memo_setting(pr)
+	    || hdr->nareas > (sz - sizeof(*hdr)) / sizeof(struct memo_area)) {
+		DBG(LOWPROBE, ul_debug("memo: unusable result"));
+		goto done;
+	}
+
+	/* read the areas (the data are used for probing if the result is
+	 * outdated) and compare fingerprint */
+	p = buf + sizeof(*hdr);
+	end = buf + sz;
+	for (i = 0; i < hdr->nareas; i++, p += sizeof(struct memo_area)) {
+		struct memo_area *a = (struct memo_area *) p;
+		blkid_probe xpr = a->disk ? blkid_probe_get_wholedisk_probe(pr) : pr;
+		unsigned char *data;
+
+		if (!xpr || a->off < xpr->off)
+			goto done;
+		data = blkid_probe_get_buffer(xpr, a->off - xpr->off, a->len);
+		if (!data)
+			goto done;
+		fp = memo_hash(fp, data, a->len);
+	}
+	if (fp != hdr->fingerprint) {
+		DBG(LOWPROBE, ul_debug("memo: data modified"));
+		goto done;
+	}
+
+	/* the result is valid, replace the values of the enabled chains */
+	for (i = 0; i < BLKID_NCHAINS; i++) {
+		if (pr->chains[i].enabled)
+			blkid_probe_chain_reset_values(pr, &pr->chains[i]);
+	}
+	for (i = 0; i < hdr->nvalues; i++) {
+		struct memo_value *v = (struct memo_value *) p;
+		struct blkid_prval *val;
+		const char *name;
+
+		if ((size_t) (end - p) < sizeof(*v))
+			break;
+		p += sizeof(*v);
+		if (v->chain >= BLKID_NCHAINS || !v->namesz
+		    || (size_t) (end - p) < (size_t) v->namesz + v->len
+		    || p[v->namesz - 1] != '\0')
+			break;
+
+		name = memo_intern_name(pr, (char *) p);
+		if (!name)
+			break;
+
+		pr->cur_chain = &pr->chains[v->chain];
+		val = blkid_probe_assign_value(pr, name);
+		pr->cur_chain = NULL;
+		if (!val || blkid_probe_value_set_data(val, p + v->namesz, v->len) != 0) {
+			blkid_probe_free_value(val);
+			break;
+		}
+		p += v->namesz + v->len;
+	}
+	if (i < hdr->nvalues) {
+		/* corrupted, don't trust anything */
+		DBG(LOWPROBE, ul_debug("memo: corrupted values"));
+		for (i = 0; i < BLKID_NCHAINS; i++) {
+			if (pr->chains[i].enabled)
+				blkid_probe_chain_reset_values(pr, &pr->chains[i]);
+		}
+		goto done;
+	}
+
+	DBG(LOWPROBE, ul_debug("memo: using stored result [rc=%d, values=%u]",
+				hdr->rc, hdr->nvalues));
+	*rc = hdr->rc;
+	res = 0;
+done:
+	free(buf);
+	return res;
+}
+
+static int memo_add(unsigned char **buf, size_t *sz, const void *data, size_t len)
+{
+	unsigned char *tmp;
+
+	if (*sz + len > MEMO_MAXSZ)
+		return -E2BIG;
+	tmp = realloc(*buf, *sz + len);
+	if (!tmp)
+		return -ENOMEM;
+	memcpy(tmp + *sz, data, len);
+	*buf = tmp;
+	*sz += len;
+	return 0;
+}
+
+static int memo_add_areas(blkid_probe xpr, uint32_t disk, struct memo_header *hdr,
+			  unsigned char **buf, size_t *sz)
+{
+	size_t i;
+
+	for (i = 0; i < xpr->nbufs; i++) {
+		struct blkid_bufinfo *bf = xpr->bufidx[i];
+		struct memo_area a = { .disk = disk, .off = bf->off, .len = bf->len };
+		int rc = memo_add(buf, sz, &a, sizeof(a));
+
+		if (rc)
+			return rc;
+		hdr->fingerprint = memo_hash(hdr->fingerprint, bf->data, bf->len);
+		hdr->nareas++;
+	}
+	return 0;
+}
+
+/*
+ * Stores result of blkid_do_safeprobe().
+ */
+void blkid_probe_memo_store(blkid_probe pr, int rc)
+{
+	struct memo_header hdr;
+	struct list_head *p;
+	unsigned char *buf = NULL;
+	char *name = NULL, *tmp = NULL;
+	size_t sz = sizeof(hdr);
+	struct stat st;
+	int fd = -1;
+
+	if (!memo_is_usable(pr) || rc < -2 || rc == -1 || rc > 1
+	    || (pr->disk_probe && (pr->disk_probe->flags & BLKID_FL_MODIF_BUFF)))
+		return;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, MEMO_MAGIC, sizeof(MEMO_MAGIC));
+	hdr.version = MEMO_VERSION;
+	hdr.rc = rc;
+	hdr.devno = pr->devno;
+	hdr.size = pr->size;
+	hdr.setting = memo_setting(pr);
+	hdr.fingerprint = FNV_INIT;
+
+	buf = calloc(1, sz);
+	if (!buf)
+		return;
+
+	if (memo_add_areas(pr, 0, &hdr, &buf, &sz) != 0)
+		goto done;
+	if (pr->disk_probe && memo_add_areas(pr->disk_probe, 1, &hdr, &buf, &sz) != 0)
+		goto done;
+
+	list_for_each(p, &pr->values) {
+		struct blkid_prval *v = list_entry(p, struct blkid_prval, prvals);
+		struct memo_value mv;
+
+		if (!v->chain || !v->chain->enabled)
+			continue;
+		mv.chain = v->chain - pr->chains;
+		mv.namesz = strlen(v->name) + 1;
+		mv.len = v->len;
+		if (memo_add(&buf, &sz, &mv, sizeof(mv)) != 0
+		    || memo_add(&buf, &sz, v->name, mv.namesz) != 0
+		    || memo_add(&buf, &sz, v->data, v->len) != 0)
+			goto done;
+		hdr.nvalues++;
+	}
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	if (stat(BLKID_RUNTIME_DIR, &st) != 0 && errno == ENOENT
+	    && mkdir(BLKID_RUNTIME_DIR, S_IWUSR|
+				S_IRUSR|S_IRGRP|S_IROTH|
+				S_IXUSR|S_IXGRP|S_IXOTH) != 0
+	    && errno != EEXIST)
+		goto done;
+
+	name = memo_filename(pr);
+	if (!name || asprintf(&tmp, "%s-XXXXXX", name) < 0) {
+		tmp = NULL;
+		goto done;
+	}
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0)
+		goto done;
+	if (fchmod(fd, 0644) != 0 || write_all(fd, buf, sz) != 0) {
+		unlink(tmp);
+		goto done;
+	}
+	if (close(fd) != 0 || rename(tmp, name) != 0) {
+		fd = -1;
+		unlink(tmp);
+		goto done;
+	}
+	fd = -1;
+	DBG(LOWPROBE, ul_debug("memo: stored result %s [rc=%d, areas=%u, values=%u]",
+				name, rc, hdr.nareas, hdr.nvalues));
+done:
+	if (fd >= 0)
+		close(fd);
+	free(tmp);
+	free(name);
+	free(buf);
+	errno = 0;
+}
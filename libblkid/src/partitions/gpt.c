@@ -121,6 +121,23 @@ static inline int guidcmp(efi_guid_t left, efi_guid_t right)
 	return memcmp(&left, &right, sizeof (efi_guid_t));
 }
 
+/* 00000000-0000-0000-0000-000000000000 entry */
+static inline int is_unused_entry(const struct gpt_entry *e)
+{
+	return !guidcmp(e->partition_type_guid, GPT_UNUSED_ENTRY_GUID);
+}
+
+/*
+ * Returns number of entries without the unused entries at the end of the
+ * array. The array is usually 128 entries, but only a few of them are used.
+ */
+static uint32_t count_used_entries(const struct gpt_entry *e, uint32_t nents)
+{
+	while (nents > 0 && is_unused_entry(&e[nents - 1]))
+		nents--;
+	return nents;
+}
+
 /*
  * UUID is traditionally 16 byte big-endian array, except Intel EFI
  * specification where the UUID is a structure of little-endian fields.
@@ -311,7 +328,7 @@ static int probe_gpt_pt(blkid_probe pr,
 	blkid_parttable tab = NULL;
 	blkid_partlist ls;
 	uint64_t fu, lu;
-	uint32_t ssf, i;
+	uint32_t ssf, i, nents;
 	efi_guid_t guid;
 	int ret;
 
@@ -368,15 +385,17 @@ static int probe_gpt_pt(blkid_probe pr,
 	fu = le64_to_cpu(h->first_usable_lba);
 	lu = le64_to_cpu(h->last_usable_lba);
 
-	for (i = 0; i < le32_to_cpu(h->num_partition_entries); i++, e++) {
+	/* the unused entries at the end do not affect partition numbers */
+	nents = count_used_entries(e, le32_to_cpu(h->num_partition_entries));
+
+	for (i = 0; i < nents; i++, e++) {
 
 		blkid_partition par;
 		uint64_t start = le64_to_cpu(e->starting_lba);
 		uint64_t size = le64_to_cpu(e->ending_lba) -
 					le64_to_cpu(e->starting_lba) + 1ULL;
 
-		/* 00000000-0000-0000-0000-000000000000 entry */
-		if (!guidcmp(e->partition_type_guid, GPT_UNUSED_ENTRY_GUID)) {
+		if (is_unused_entry(e)) {
 			blkid_partlist_increment_partno(ls);
 			continue;
 		}
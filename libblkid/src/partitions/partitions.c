@@ -534,6 +534,7 @@ static int idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
 			struct blkid_chain *chn)
 {
 	const struct blkid_idmag *mag = NULL;
+	struct blkid_prstat_mark mk;
 	uint64_t off;
 	int rc = BLKID_PROBE_NONE;		/* default is nothing */
 
@@ -542,9 +543,12 @@ static int idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
 		goto nothing;
 
+	blkid_probe_stat_start(pr, &mk);
 	rc = blkid_probe_get_idmag(pr, id, &off, &mag);
-	if (rc != BLKID_PROBE_OK)
+	if (rc != BLKID_PROBE_OK) {
+		blkid_probe_stat_end(pr, &mk, partitions_drv.name, id->name);
 		goto nothing;
+	}
 
 	/* final check by probing function */
 	if (id->probefunc) {
@@ -565,6 +569,7 @@ static int idinfo_probe(blkid_probe pr, const struct blkid_idinfo *id,
 
 		DBG(LOWPROBE, ul_debug("%s: <--- (rc = %d)", id->name, rc));
 	}
+	blkid_probe_stat_end(pr, &mk, partitions_drv.name, id->name);
 
 	return rc;
 
@@ -607,6 +612,8 @@ static int partitions_probe(blkid_probe pr, struct blkid_chain *chn)
 		/* apply filter */
 		if (chn->fltr && blkid_bmp_get_item(chn->fltr, i))
 			continue;
+		if (blkid_probe_is_prefiltered(chn, i))
+			continue;	/* magic string does not match */
 
 		/* apply checks from idinfo */
 		rc = idinfo_probe(pr, idinfos[i], chn);
@@ -722,12 +729,35 @@ int blkid_partitions_do_subprobe(blkid_probe pr, blkid_partition parent,
 	return rc;
 }
 
+/*
+ * Returns the partition table of the whole-disk. The whole-disk probe is
+ * shared by all partitions of the disk (see blkid_probe_get_wholedisk_probe()),
+ * so the partition table is parsed only once.
+ */
+static blkid_partlist get_wholedisk_partlist(blkid_probe disk_pr, int reparse)
+{
+	blkid_partlist ls;
+
+	if (!reparse && (disk_pr->flags & BLKID_FL_PARTLIST)) {
+		DBG(LOWPROBE, ul_debug("parts: using already parsed wholedisk partitions"));
+		return blkid_probe_get_partlist(disk_pr);
+	}
+
+	ls = blkid_probe_get_partitions(disk_pr);
+	if (ls)
+		disk_pr->flags |= BLKID_FL_PARTLIST;
+	else
+		disk_pr->flags &= ~BLKID_FL_PARTLIST;
+	return ls;
+}
+
 static int blkid_partitions_probe_partition(blkid_probe pr)
 {
 	blkid_probe disk_pr = NULL;
 	blkid_partlist ls;
 	blkid_partition par;
 	dev_t devno;
+	int parsed;
 
 	DBG(LOWPROBE, ul_debug("parts: start probing for partition entry"));
 
@@ -743,11 +773,19 @@ static int blkid_partitions_probe_partition(blkid_probe pr)
 		goto nothing;
 
 	/* parse PT */
-	ls = blkid_probe_get_partitions(disk_pr);
+	parsed = disk_pr->flags & BLKID_FL_PARTLIST;
+	ls = get_wholedisk_partlist(disk_pr, 0);
 	if (!ls)
 		goto nothing;
 
 	par = blkid_partlist_devno_to_partition(ls, devno);
+	if (!par && parsed) {
+		/* the partition table has been probably modified, read it again */
+		blkid_probe_reset_buffers(disk_pr);
+		ls = get_wholedisk_partlist(disk_pr, 1);
+		if (ls)
+			par = blkid_partlist_devno_to_partition(ls, devno);
+	}
 	if (!par)
 		goto nothing;
 	else {
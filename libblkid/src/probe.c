@@ -107,12 +107,16 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <limits.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "blkidP.h"
 #include "all-io.h"
 #include "sysfs.h"
 #include "strutils.h"
 #include "list.h"
+#include "ulstats.h"
 
 /*
  * All supported chains
@@ -124,6 +128,8 @@ static const struct blkid_chaindrv *chains_drvs[] = {
 };
 
 static void blkid_probe_reset_values(blkid_probe pr);
+static void close_direct_fd(blkid_probe pr);
+static void put_wholedisk_probe(blkid_probe disk_pr);
 
 /**
  * blkid_new_probe:
@@ -151,6 +157,7 @@ blkid_probe blkid_new_probe(void)
 	INIT_LIST_HEAD(&pr->buffers);
 	INIT_LIST_HEAD(&pr->values);
 	INIT_LIST_HEAD(&pr->hints);
+	pr->direct_fd = -1;
 	return pr;
 }
 
@@ -208,6 +215,7 @@ blkid_probe blkid_new_probe_from_filename(const char *filename)
 	int fd;
 	blkid_probe pr = NULL;
 
+	UL_STATS_CALL(UL_STATS_OPEN);
 	fd = open(filename, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
 	if (fd < 0)
 		return NULL;
@@ -247,6 +255,8 @@ void blkid_free_probe(blkid_probe pr)
 		if (ch->driver->free_data)
 			ch->driver->free_data(pr, ch->data);
 		free(ch->fltr);
+		free(ch->mfltr);
+		ch->mfltr = NULL;
 	}
 
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
@@ -254,7 +264,12 @@ void blkid_free_probe(blkid_probe pr)
 	blkid_probe_reset_buffers(pr);
 	blkid_probe_reset_values(pr);
 	blkid_probe_reset_hints(pr);
-	blkid_free_probe(pr->disk_probe);
+	put_wholedisk_probe(pr->disk_probe);
+	free(pr->bufidx);
+	blkid_probe_free_uring(pr);
+	close_direct_fd(pr);
+	blkid_probe_free_memo(pr);
+	blkid_probe_reset_stats(pr);
 
 	DBG(LOWPROBE, ul_debug("free probe"));
 	free(pr);
@@ -536,15 +551,9 @@ int __blkid_probe_filter_types(blkid_probe pr, int chain, int flag, char *names[
 	return 0;
 }
 
-static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+static struct blkid_bufinfo *alloc_buffer(uint64_t real_off, uint64_t len)
 {
-	ssize_t ret;
-	struct blkid_bufinfo *bf = NULL;
-
-	if (lseek(pr->fd, real_off, SEEK_SET) == (off_t) -1) {
-		errno = 0;
-		return NULL;
-	}
+	struct blkid_bufinfo *bf;
 
 	/* someone trying to overflow some buffers? */
 	if (len > ULONG_MAX - sizeof(struct blkid_bufinfo)) {
@@ -564,10 +573,135 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 	bf->off = real_off;
 	INIT_LIST_HEAD(&bf->bufs);
 
+	return bf;
+}
+
+static void close_direct_fd(blkid_probe pr)
+{
+	if (pr->direct_fd >= 0)
+		close(pr->direct_fd);
+	pr->direct_fd = -1;
+}
+
+/*
+ * Returns the device file descriptor opened with O_DIRECT, or -1 if O_DIRECT
+ * is not usable. The clones share descriptor with the parent.
+ */
+static int get_direct_fd(blkid_probe pr)
+{
+	char path[64];
+
+	if (pr->parent)
+		return get_direct_fd(pr->parent);
+	if (pr->direct_fd >= 0)
+		return pr->direct_fd;
+	if ((pr->flags & BLKID_FL_NODIRECT) || S_ISCHR(pr->mode))
+		return -1;
+
+	/* the fd is from application, reopen it rather than modify its flags */
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", pr->fd);
+	UL_STATS_CALL(UL_STATS_OPEN);
+	pr->direct_fd = open(path, O_RDONLY|O_CLOEXEC|O_DIRECT);
+	if (pr->direct_fd < 0) {
+		DBG(LOWPROBE, ul_debug("O_DIRECT unsupported, using POSIX_FADV_DONTNEED"));
+		pr->flags |= BLKID_FL_NODIRECT;
+		errno = 0;
+	}
+	return pr->direct_fd;
+}
+
+/*
+ * Reads the data by O_DIRECT. The request is extended to the aligned area and
+ * the data copied to @data. Returns 0 on success, 1 on read error and -1 if
+ * O_DIRECT is not usable (the caller should use the normal read()).
+ */
+static int read_direct(blkid_probe pr, uint64_t real_off, unsigned char *data, uint64_t len)
+{
+	unsigned int align = max(blkid_probe_get_sectorsize(pr), (unsigned) BLKID_DIRECTIO_ALIGN);
+	uint64_t start, end;
+	ssize_t ret;
+	void *buf = NULL;
+	int fd = get_direct_fd(pr);
+
+	if (fd < 0)
+		return -1;
+
+	start = real_off - (real_off % align);
+	end = real_off + len;
+	if (end % align)
+		end += align - (end % align);
+
+	if (posix_memalign(&buf, align, end - start) != 0)
+		return -1;
+
+	DBG(LOWPROBE, ul_debug("\tread: off=%"PRIu64" len=%"PRIu64" (O_DIRECT off=%"PRIu64" len=%"PRIu64")",
+	                       real_off, len, start, end - start));
+
+	ret = pread(fd, buf, end - start, start);
+	UL_STATS_CALL(UL_STATS_READ);
+	UL_STATS_BYTES(S_ISREG(pr->mode) ? UL_STATS_OTHER : UL_STATS_DEVICE, ret);
+	if (ret < 0 && errno == EINVAL) {
+		/* alignment requirements unknown, give up */
+		DBG(LOWPROBE, ul_debug("\tO_DIRECT read failed, using POSIX_FADV_DONTNEED"));
+		free(buf);
+		close_direct_fd(pr->parent ? pr->parent : pr);
+		pr->flags |= BLKID_FL_NODIRECT;
+		if (pr->parent)
+			pr->parent->flags |= BLKID_FL_NODIRECT;
+		errno = 0;
+		return -1;
+	}
+	if (ret < 0 || (uint64_t) ret < real_off + len - start) {
+		DBG(LOWPROBE, ul_debug("\tread failed: %m"));
+		free(buf);
+		if (ret >= 0)
+			errno = 0;
+		return 1;
+	}
+
+	memcpy(data, (unsigned char *) buf + (real_off - start), len);
+	free(buf);
+	return 0;
+}
+
+static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint64_t len)
+{
+	ssize_t ret;
+	struct blkid_bufinfo *bf = NULL;
+
+	bf = alloc_buffer(real_off, len);
+	if (!bf)
+		return NULL;
+
+	pr->io_nreads++;
+	pr->io_nbytes += len;
+
+	if (pr->flags & BLKID_FL_DIRECTIO) {
+		switch (read_direct(pr, real_off, bf->data, len)) {
+		case 0:
+			return bf;
+		case 1:
+			free(bf);
+			if (blkid_probe_is_cdrom(pr))
+				errno = 0;
+			return NULL;
+		default:
+			break;	/* use read() */
+		}
+	}
+
+	if (lseek(pr->fd, real_off, SEEK_SET) == (off_t) -1) {
+		free(bf);
+		errno = 0;
+		return NULL;
+	}
+
 	DBG(LOWPROBE, ul_debug("\tread: off=%"PRIu64" len=%"PRIu64"",
 	                       real_off, len));
 
 	ret = read(pr->fd, bf->data, len);
+	UL_STATS_CALL(UL_STATS_READ);
+	UL_STATS_BYTES(S_ISREG(pr->mode) ? UL_STATS_OTHER : UL_STATS_DEVICE, ret);
 	if (ret != (ssize_t) len) {
 		DBG(LOWPROBE, ul_debug("\tread failed: %m"));
 		free(bf);
@@ -579,22 +713,41 @@ static struct blkid_bufinfo *read_buffer(blkid_probe pr, uint64_t real_off, uint
 		return NULL;
 	}
 
+#if defined(POSIX_FADV_DONTNEED) && defined(HAVE_POSIX_FADVISE)
+	/* O_DIRECT unusable, at least drop the data from page cache */
+	if (pr->flags & BLKID_FL_DIRECTIO)
+		posix_fadvise(pr->fd, real_off, len, POSIX_FADV_DONTNEED);
+#endif
 	return bf;
 }
 
 /*
- * Search in buffers we already have in memory
+ * Search in buffers we already have in memory. The buffers are indexed by
+ * pr->bufidx[] array sorted by offset, every item in the array knows the
+ * maximal end of all previous buffers, so we can stop the search as soon as
+ * no previous buffer is large enough.
  */
 static struct blkid_bufinfo *get_cached_buffer(blkid_probe pr, uint64_t off, uint64_t len)
 {
 	uint64_t real_off = pr->off + off;
-	struct list_head *p;
+	size_t lo = 0, hi = pr->nbufs;
 
-	list_for_each(p, &pr->buffers) {
-		struct blkid_bufinfo *x =
-				list_entry(p, struct blkid_bufinfo, bufs);
+	/* hi = number of buffers with x->off <= real_off */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
 
-		if (real_off >= x->off && real_off + len <= x->off + x->len) {
+		if (pr->bufidx[mid]->off <= real_off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	while (hi > 0) {
+		struct blkid_bufinfo *x = pr->bufidx[--hi];
+
+		if (x->maxend < real_off + len)
+			break;
+		if (real_off + len <= x->off + x->len) {
 			DBG(BUFFER, ul_debug("\treuse: off=%"PRIu64" len=%"PRIu64" (for off=%"PRIu64" len=%"PRIu64")",
 						x->off, x->len, real_off, len));
 			return x;
@@ -603,6 +756,49 @@ static struct blkid_bufinfo *get_cached_buffer(blkid_probe pr, uint64_t off, uin
 	return NULL;
 }
 
+/*
+ * Add a new buffer to the list of buffers and to the index
+ */
+static int add_cached_buffer(blkid_probe pr, struct blkid_bufinfo *bf)
+{
+	size_t i, lo = 0, hi = pr->nbufs;
+
+	if (pr->nbufs == pr->bufidx_sz) {
+		size_t sz = pr->bufidx_sz ? pr->bufidx_sz * 2 : 16;
+		struct blkid_bufinfo **x;
+
+		x = realloc(pr->bufidx, sz * sizeof(struct blkid_bufinfo *));
+		if (!x)
+			return -ENOMEM;
+		pr->bufidx = x;
+		pr->bufidx_sz = sz;
+	}
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (pr->bufidx[mid]->off <= bf->off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	memmove(&pr->bufidx[hi + 1], &pr->bufidx[hi],
+			(pr->nbufs - hi) * sizeof(struct blkid_bufinfo *));
+	pr->bufidx[hi] = bf;
+	pr->nbufs++;
+
+	for (i = hi; i < pr->nbufs; i++) {
+		struct blkid_bufinfo *x = pr->bufidx[i];
+		uint64_t prev = i ? pr->bufidx[i - 1]->maxend : 0;
+
+		x->maxend = max(prev, x->off + x->len);
+	}
+
+	list_add_tail(&bf->bufs, &pr->buffers);
+	return 0;
+}
+
 /*
  * Zeroize in-memory data in already read buffer. The next blkid_probe_get_buffer()
  * will return modified buffer. This is usable when you want to call the same probing
@@ -681,12 +877,18 @@ unsigned char *blkid_probe_get_buffer(blkid_probe pr, uint64_t off, uint64_t len
 	/* try buffers we already have in memory or read from device */
 	bf = get_cached_buffer(pr, off, len);
 	if (!bf) {
+		pr->buf_misses++;
 		bf = read_buffer(pr, real_off, len);
 		if (!bf)
 			return NULL;
 
-		list_add_tail(&bf->bufs, &pr->buffers);
-	}
+		if (add_cached_buffer(pr, bf) != 0) {
+			free(bf);
+			errno = ENOMEM;
+			return NULL;
+		}
+	} else
+		pr->buf_hits++;
 
 	assert(bf->off <= real_off);
 	assert(bf->off + bf->len >= real_off + len);
@@ -713,6 +915,7 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 	uint64_t ct = 0, len = 0;
 
 	pr->flags &= ~BLKID_FL_MODIF_BUFF;
+	blkid_probe_reset_prefilter(pr);
 
 	if (list_empty(&pr->buffers))
 		return 0;
@@ -733,8 +936,12 @@ int blkid_probe_reset_buffers(blkid_probe pr)
 
 	DBG(LOWPROBE, ul_debug(" buffers summary: %"PRIu64" bytes by %"PRIu64" read() calls",
 			len, ct));
+	DBG(BUFFER, ul_debug(" buffers requests: %"PRIu64" hits, %"PRIu64" misses",
+			pr->buf_hits, pr->buf_misses));
 
 	INIT_LIST_HEAD(&pr->buffers);
+	pr->nbufs = 0;
+	pr->buf_hits = pr->buf_misses = 0;
 
 	return 0;
 }
@@ -762,11 +969,446 @@ int blkid_probe_hide_range(blkid_probe pr, uint64_t off, uint64_t len)
 {
 	int rc = hide_buffer(pr, off, len);
 
-	if (rc == 0)
+	if (rc == 0) {
 		pr->flags |= BLKID_FL_MODIF_BUFF;
+		blkid_probe_reset_prefilter(pr);
+	}
 	return rc;
 }
 
+/**
+ * blkid_probe_enable_prefetch:
+ * @pr: prober
+ * @enable: TRUE/FALSE
+ *
+ * Enables/disables read-ahead for magic strings. If enabled, then the library
+ * collects at begin of the every probing chain the areas with magic strings
+ * of all enabled (not filtered out) probing functions, merges the areas and
+ * reads them from the device by a few large read() calls. The probing
+ * functions then use the already read data. It is usable for devices where
+ * many small random reads are expensive (for example multipath or network
+ * storage).
+ *
+ * The behavior is disabled by default.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_enable_prefetch(blkid_probe pr, int enable)
+{
+	if (enable)
+		pr->flags |= BLKID_FL_PREFETCH;
+	else
+		pr->flags &= ~BLKID_FL_PREFETCH;
+	return 0;
+}
+
+/**
+ * blkid_probe_enable_direct_io:
+ * @pr: prober
+ * @enable: TRUE/FALSE
+ *
+ * Enables/disables cache-neutral probing. If enabled, then the library reads
+ * the device by O_DIRECT (the device is reopened, the file descriptor
+ * specified by blkid_probe_set_device() is not modified), so probing does not
+ * evict pages from page cache and does not trigger read-ahead. The reads are
+ * aligned to the device sector size (or 4KiB at least) and only the
+ * requested data are stored in the probing buffers.
+ *
+ * If O_DIRECT is not supported for the device, then the library uses the
+ * standard read() and POSIX_FADV_DONTNEED for the read ranges.
+ *
+ * The behavior is disabled by default.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_enable_direct_io(blkid_probe pr, int enable)
+{
+	if (enable)
+		pr->flags |= BLKID_FL_DIRECTIO;
+	else {
+		pr->flags &= ~BLKID_FL_DIRECTIO;
+		close_direct_fd(pr);
+	}
+	return 0;
+}
+
+/**
+ * blkid_probe_enable_results_cache:
+ * @pr: prober
+ * @enable: TRUE/FALSE
+ *
+ * Enables/disables the shared cache of the blkid_do_safeprobe() results. If
+ * enabled, then blkid_do_safeprobe() stores the result for the block device
+ * to the /run/blkid directory (if writable) and the next blkid_do_safeprobe()
+ * (from the same or another process) returns the stored result without
+ * calling the probing functions, if the device size and the prober setting
+ * are the same and the data in all the areas previously read from the device
+ * have not been modified. The areas have to be read again to compare the
+ * data, but usually by a few larger reads.
+ *
+ * The cache is used only for block devices, not for regular files.
+ *
+ * The behavior is disabled by default.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_enable_results_cache(blkid_probe pr, int enable)
+{
+	if (enable)
+		pr->flags |= BLKID_FL_MEMO;
+	else
+		pr->flags &= ~BLKID_FL_MEMO;
+	return 0;
+}
+
+/**
+ * blkid_probe_set_io_backend:
+ * @pr: prober
+ * @backend: BLKID_IOBACKEND_READ or BLKID_IOBACKEND_URING
+ *
+ * Sets the way how the read-ahead planner (see blkid_probe_enable_prefetch())
+ * reads data from the device. The default BLKID_IOBACKEND_READ uses read()
+ * for every merged area, BLKID_IOBACKEND_URING submits all the areas by one
+ * io_uring batch, so the device can read them in parallel. The other reads
+ * (for example within probing functions) always use read(). The io_uring
+ * backend is not used if blkid_probe_enable_direct_io() is enabled.
+ *
+ * If io_uring is not usable at runtime, then the library silently falls back
+ * to read().
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, -ENOTSUP if the library has been compiled without
+ * io_uring support, or -EINVAL for unknown @backend.
+ */
+int blkid_probe_set_io_backend(blkid_probe pr, int backend)
+{
+	switch (backend) {
+	case BLKID_IOBACKEND_READ:
+		blkid_probe_free_uring(pr);
+		break;
+	case BLKID_IOBACKEND_URING:
+		if (!blkid_probe_uring_supported())
+			return -ENOTSUP;
+		break;
+	default:
+		return -EINVAL;
+	}
+	pr->io_backend = backend;
+	return 0;
+}
+
+/*
+ * Returns offset of the 1KiB area with magic string, or -1 if the magic
+ * is not usable for the device (zoned magic on non-zoned device).
+ */
+static int get_idmag_area(blkid_probe pr, const struct blkid_idmag *mag, uint64_t *off)
+{
+	uint64_t kboff, hint_offset;
+
+	/* If the magic is for zoned device, skip non-zoned device */
+	if (mag->is_zoned && !pr->zone_size)
+		return -1;
+
+	if (!mag->hoff || blkid_probe_get_hint(pr, mag->hoff, &hint_offset) < 0)
+		hint_offset = 0;
+
+	if (!mag->is_zoned)
+		kboff = mag->kboff;
+	else
+		kboff = ((mag->zonenum * pr->zone_size) >> 10) + mag->kboff_inzone;
+
+	*off = hint_offset + ((kboff + (mag->sboff >> 10)) << 10);
+	return 0;
+}
+
+/*
+ * Read-ahead planner
+ */
+struct prefetch_area {
+	uint64_t	off;
+	uint64_t	len;
+};
+
+static int cmp_prefetch_areas(const void *a0, const void *b0)
+{
+	const struct prefetch_area *a = a0, *b = b0;
+
+	return a->off < b->off ? -1 : a->off > b->off ? 1 : 0;
+}
+
+static size_t prefetch_add_idinfo(blkid_probe pr, const struct blkid_idinfo *id,
+				  struct prefetch_area *areas, size_t nareas)
+{
+	const struct blkid_idmag *mag;
+
+	for (mag = &id->magics[0]; mag->magic; mag++) {
+		uint64_t off;
+
+		if (get_idmag_area(pr, mag, &off) != 0)
+			continue;
+		if (off + 1024 > pr->size)
+			continue;
+		if (get_cached_buffer(pr, off, 1024))
+			continue;
+
+		areas[nareas].off = off;
+		areas[nareas].len = 1024;
+		nareas++;
+	}
+	return nareas;
+}
+
+/*
+ * Reads all the ranges by one io_uring batch. Returns 0 on success (the read
+ * errors are ignored as well as for read_buffer()), or <0 if io_uring is not
+ * usable.
+ */
+static int prefetch_uring(blkid_probe pr, struct prefetch_area *ranges, size_t nranges)
+{
+	struct blkid_bufinfo **bufs;
+	size_t i;
+	int rc;
+
+	bufs = calloc(nranges, sizeof(struct blkid_bufinfo *));
+	if (!bufs)
+		return -ENOMEM;
+
+	for (i = 0; i < nranges; i++) {
+		bufs[i] = alloc_buffer(pr->off + ranges[i].off, ranges[i].len);
+		if (!bufs[i]) {
+			rc = -ENOMEM;
+			goto done;
+		}
+	}
+
+	rc = blkid_probe_uring_read(pr, bufs, nranges);
+	if (rc == -ENOTSUP) {
+		/* don't try it again */
+		DBG(LOWPROBE, ul_debug("io_uring not available, using read()"));
+		pr->io_backend = BLKID_IOBACKEND_READ;
+	}
+	if (rc)
+		goto done;
+
+	UL_STATS_CALL(UL_STATS_READ);		/* one io_uring batch */
+	for (i = 0; i < nranges; i++) {
+		pr->io_nreads++;
+		pr->io_nbytes += ranges[i].len;
+		UL_STATS_BYTES(S_ISREG(pr->mode) ? UL_STATS_OTHER : UL_STATS_DEVICE,
+			       ranges[i].len);
+		if (bufs[i] && add_cached_buffer(pr, bufs[i]) == 0)
+			bufs[i] = NULL;
+	}
+done:
+	for (i = 0; i < nranges; i++)
+		free(bufs[i]);
+	free(bufs);
+	return rc;
+}
+
+/*
+ * Returns 1 if the probing function reads metadata from the end of the device
+ * (see superblocks_probe() for the same conditions).
+ */
+static int need_tail_prefetch(blkid_probe pr, const struct blkid_idinfo *id)
+{
+	if (!(id->flags & BLKID_IDINFO_TAILMETA))
+		return 0;
+	if ((id->usage & BLKID_USAGE_RAID)
+	    && (blkid_probe_is_tiny(pr) || blkid_probe_is_cdrom(pr)))
+		return 0;
+	return 1;
+}
+
+/*
+ * Collects magic strings areas of all enabled probing functions in the chain,
+ * merges the areas (if the gap between them is not too large) and reads the
+ * result to the probing buffers. The end of the device is read by one large
+ * read if there are enabled functions with metadata at the end of the device
+ * (RAIDs), so they don't read it by many small reads. The read errors are not
+ * fatal -- the probing functions read the data by small reads later in this
+ * case.
+ */
+static void blkid_probe_prefetch_chain(blkid_probe pr, struct blkid_chain *chn)
+{
+	struct prefetch_area *areas;
+	size_t i, n = 0, nmags = 0, nreads = 0, nranges = 0;
+	int rc = -1, tail = 0;
+
+	if (!(pr->flags & BLKID_FL_PREFETCH) || pr->parent
+	    || S_ISCHR(pr->mode) || pr->size <= 1024)
+		return;
+
+	for (i = 0; i < chn->driver->nidinfos; i++) {
+		const struct blkid_idmag *mag = &chn->driver->idinfos[i]->magics[0];
+
+		for (; mag->magic; mag++)
+			nmags++;
+	}
+
+	/* + 1 for the end of the device */
+	areas = malloc((nmags + 1) * sizeof(struct prefetch_area));
+	if (!areas)
+		return;
+
+	for (i = 0; i < chn->driver->nidinfos; i++) {
+		const struct blkid_idinfo *id = chn->driver->idinfos[i];
+
+		if (chn->fltr && blkid_bmp_get_item(chn->fltr, i))
+			continue;
+		if (id->minsz && (unsigned) id->minsz > pr->size)
+			continue;
+		if (!tail && need_tail_prefetch(pr, id))
+			tail = 1;
+		n = prefetch_add_idinfo(pr, id, areas, n);
+	}
+
+	if (tail) {
+		uint64_t len = min(pr->size, (uint64_t) BLKID_PREFETCH_TAILSZ);
+
+		if (!get_cached_buffer(pr, pr->size - len, len)) {
+			areas[n].off = pr->size - len;
+			areas[n].len = len;
+			n++;
+		}
+	}
+
+	if (n)
+		qsort(areas, n, sizeof(struct prefetch_area), cmp_prefetch_areas);
+
+	/* merge the areas, the result is stored to areas[0..nranges] */
+	for (i = 0; i < n; ) {
+		uint64_t off = areas[i].off;
+		uint64_t end = off + areas[i].len;
+
+		for (i++; i < n; i++) {
+			uint64_t x = areas[i].off + areas[i].len;
+
+			if (areas[i].off > end + BLKID_PREFETCH_GAP)
+				break;
+			if (x > end && x - off > BLKID_PREFETCH_MAXSZ)
+				break;
+			if (x > end)
+				end = x;
+		}
+
+		DBG(BUFFER, ul_debug("\tprefetch: off=%"PRIu64" len=%"PRIu64,
+					off, end - off));
+		areas[nranges].off = off;
+		areas[nranges].len = end - off;
+		nranges++;
+	}
+
+	/* io_uring reads are not cache-neutral, see read_direct() */
+	if (nranges && pr->io_backend == BLKID_IOBACKEND_URING
+	    && !(pr->flags & BLKID_FL_DIRECTIO))
+		rc = prefetch_uring(pr, areas, nranges);
+
+	for (i = 0; rc != 0 && i < nranges; i++) {
+		struct blkid_bufinfo *bf;
+
+		bf = read_buffer(pr, pr->off + areas[i].off, areas[i].len);
+		if (!bf)
+			continue;
+		if (add_cached_buffer(pr, bf) != 0) {
+			free(bf);
+			break;
+		}
+		nreads++;
+	}
+
+	DBG(LOWPROBE, ul_debug("%s: prefetched %zu areas%s by %zu reads%s",
+			chn->driver->name, n, tail ? " (incl. device end)" : "",
+			rc ? nreads : nranges, rc ? "" : " (io_uring)"));
+	free(areas);
+	errno = 0;
+}
+
+/*
+ * Magic strings prefilter -- marks probing functions where all magic strings
+ * areas are already in memory (usually read by the read-ahead planner) and no
+ * magic string matches. The probing loops skip the marked functions, so only
+ * a few real candidates call blkid_probe_get_idmag() and probefunc().
+ */
+static void blkid_probe_prefilter_chain(blkid_probe pr, struct blkid_chain *chn)
+{
+	size_t i, nskip = 0;
+
+	blkid_probe_reset_prefilter(pr);
+
+	if (pr->parent || !pr->nbufs)
+		return;
+
+	chn->mfltr = calloc(1, blkid_bmp_nbytes(chn->driver->nidinfos));
+	if (!chn->mfltr)
+		return;
+
+	for (i = 0; i < chn->driver->nidinfos; i++) {
+		const struct blkid_idinfo *id = chn->driver->idinfos[i];
+		const struct blkid_idmag *mag = &id->magics[0];
+		int cand = 0;
+
+		if (!mag->magic)
+			continue;	/* probing function without magic */
+
+		for (; mag->magic; mag++) {
+			struct blkid_bufinfo *bf;
+			uint64_t off;
+			unsigned char *data;
+
+			if (get_idmag_area(pr, mag, &off) != 0)
+				continue;
+
+			bf = get_cached_buffer(pr, off, 1024);
+			if (!bf) {
+				cand = 1;	/* not in memory */
+				break;
+			}
+			data = bf->data + (pr->off + off - bf->off);
+			if (!memcmp(mag->magic, data + (mag->sboff & 0x3ff), mag->len)) {
+				cand = 1;	/* match */
+				break;
+			}
+		}
+		if (!cand) {
+			blkid_bmp_set_item(chn->mfltr, i);
+			nskip++;
+		}
+	}
+
+	DBG(LOWPROBE, ul_debug("%s: magic prefilter: skip %zu of %zu probing functions",
+			chn->driver->name, nskip, chn->driver->nidinfos));
+}
+
+/*
+ * Forget the prefilter results; the data in the buffers has been changed.
+ */
+void blkid_probe_reset_prefilter(blkid_probe pr)
+{
+	int i;
+
+	for (i = 0; i < BLKID_NCHAINS; i++) {
+		free(pr->chains[i].mfltr);
+		pr->chains[i].mfltr = NULL;
+	}
+}
+
+/*
+ * Called at the begin of the every chain probing
+ */
+static void blkid_probe_prepare_chain(blkid_probe pr, struct blkid_chain *chn)
+{
+	blkid_probe_prefetch_chain(pr, chn);
+	blkid_probe_prefilter_chain(pr, chn);
+}
+
 
 static void blkid_probe_reset_values(blkid_probe pr)
 {
@@ -885,9 +1527,12 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 
 	if ((pr->flags & BLKID_FL_PRIVATE_FD) && pr->fd >= 0)
 		close(pr->fd);
+	close_direct_fd(pr);
+	pr->flags &= ~BLKID_FL_NODIRECT;
+	blkid_probe_reset_stats(pr);
 
 	if (pr->disk_probe) {
-		blkid_free_probe(pr->disk_probe);
+		put_wholedisk_probe(pr->disk_probe);
 		pr->disk_probe = NULL;
 	}
 
@@ -914,6 +1559,7 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	/* Disable read-ahead */
 	posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
 #endif
+	UL_STATS_CALL(UL_STATS_STAT);
 	if (fstat(fd, &sb))
 		goto err;
 
@@ -927,6 +1573,7 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 		pr->devno = sb.st_rdev;
 
 	if (S_ISBLK(sb.st_mode)) {
+		UL_STATS_CALL(UL_STATS_IOCTL);
 		if (blkdev_get_size(fd, (unsigned long long *) &devsiz)) {
 			DBG(LOWPROBE, ul_debug("failed to get device size"));
 			goto err;
@@ -1009,6 +1656,7 @@ int blkid_probe_set_device(blkid_probe pr, int fd,
 	if (S_ISBLK(sb.st_mode)) {
 		uint32_t zone_size_sector;
 
+		UL_STATS_CALL(UL_STATS_IOCTL);
 		if (!ioctl(pr->fd, BLKGETZONESZ, &zone_size_sector))
 			pr->zone_size = zone_size_sector << 9;
 	}
@@ -1082,24 +1730,12 @@ int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 	/* try to detect by magic string */
 	while(mag && mag->magic) {
 		unsigned char *buf;
-		uint64_t kboff;
-		uint64_t hint_offset;
-
-		if (!mag->hoff || blkid_probe_get_hint(pr, mag->hoff, &hint_offset) < 0)
-			hint_offset = 0;
 
-		/* If the magic is for zoned device, skip non-zoned device */
-		if (mag->is_zoned && !pr->zone_size) {
+		if (get_idmag_area(pr, mag, &off) != 0) {
 			mag++;
 			continue;
 		}
 
-		if (!mag->is_zoned)
-			kboff = mag->kboff;
-		else
-			kboff = ((mag->zonenum * pr->zone_size) >> 10) + mag->kboff_inzone;
-
-		off = hint_offset + ((kboff + (mag->sboff >> 10)) << 10);
 		buf = blkid_probe_get_buffer(pr, off, 1024);
 
 		if (!buf && errno)
@@ -1108,8 +1744,8 @@ int blkid_probe_get_idmag(blkid_probe pr, const struct blkid_idinfo *id,
 		if (buf && !memcmp(mag->magic,
 				buf + (mag->sboff & 0x3ff), mag->len)) {
 
-			DBG(LOWPROBE, ul_debug("\tmagic sboff=%u, kboff=%ld",
-				mag->sboff, kboff));
+			DBG(LOWPROBE, ul_debug("\tmagic sboff=%u, off=%"PRIu64,
+				mag->sboff, off));
 			if (offset)
 				*offset = off + (mag->sboff & 0x3ff);
 			if (res)
@@ -1183,6 +1819,7 @@ static inline void blkid_probe_end(blkid_probe pr)
  */
 int blkid_do_probe(blkid_probe pr)
 {
+	struct blkid_prstat_mark mk;
 	int rc = 1;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
@@ -1225,9 +1862,16 @@ int blkid_do_probe(blkid_probe pr)
 		if (!chn->enabled)
 			continue;
 
+		blkid_probe_stat_start(pr, &mk);
+
+		if (chn->idx == -1)
+			blkid_probe_prepare_chain(pr, chn);
+
 		/* rc: -1 = error, 0 = success, 1 = no result */
 		rc = chn->driver->probe(pr, chn);
 
+		blkid_probe_stat_end(pr, &mk, chn->driver->name, NULL);
+
 	} while (rc == 1);
 
 	return rc;
@@ -1506,6 +2150,7 @@ int blkid_probe_step_back(blkid_probe pr)
  */
 int blkid_do_safeprobe(blkid_probe pr)
 {
+	struct blkid_prstat_mark mk;
 	int i, count = 0, rc = 0;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
@@ -1513,6 +2158,11 @@ int blkid_do_safeprobe(blkid_probe pr)
 
 	blkid_probe_start(pr);
 
+	if ((pr->flags & BLKID_FL_MEMO) && blkid_probe_memo_lookup(pr, &rc) == 0) {
+		blkid_probe_end(pr);
+		return rc;
+	}
+
 	for (i = 0; i < BLKID_NCHAINS; i++) {
 		struct blkid_chain *chn;
 
@@ -1526,11 +2176,14 @@ int blkid_do_safeprobe(blkid_probe pr)
 		if (!chn->enabled)
 			continue;
 
+		blkid_probe_stat_start(pr, &mk);
 		blkid_probe_chain_reset_position(chn);
+		blkid_probe_prepare_chain(pr, chn);
 
 		rc = chn->driver->safeprobe(pr, chn);
 
 		blkid_probe_chain_reset_position(chn);
+		blkid_probe_stat_end(pr, &mk, chn->driver->name, NULL);
 
 		/* rc: -2 ambivalent, -1 = error, 0 = success, 1 = no result */
 		if (rc < 0)
@@ -1541,9 +2194,11 @@ int blkid_do_safeprobe(blkid_probe pr)
 
 done:
 	blkid_probe_end(pr);
-	if (rc < 0)
-		return rc;
-	return count ? 0 : 1;
+	if (rc >= 0)
+		rc = count ? 0 : 1;
+	if (pr->flags & BLKID_FL_MEMO)
+		blkid_probe_memo_store(pr, rc);
+	return rc;
 }
 
 /**
@@ -1560,6 +2215,7 @@ done:
  */
 int blkid_do_fullprobe(blkid_probe pr)
 {
+	struct blkid_prstat_mark mk;
 	int i, count = 0, rc = 0;
 
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
@@ -1580,11 +2236,14 @@ int blkid_do_fullprobe(blkid_probe pr)
 		if (!chn->enabled)
 			continue;
 
+		blkid_probe_stat_start(pr, &mk);
 		blkid_probe_chain_reset_position(chn);
+		blkid_probe_prepare_chain(pr, chn);
 
 		rc = chn->driver->probe(pr, chn);
 
 		blkid_probe_chain_reset_position(chn);
+		blkid_probe_stat_end(pr, &mk, chn->driver->name, NULL);
 
 		/* rc: -1 = error, 0 = success, 1 = no result */
 		if (rc < 0)
@@ -1743,6 +2402,33 @@ accept:
 	return 1;
 }
 
+/*
+ * Returns 1 if the prober has to calculate and verify the checksum. With
+ * BLKID_SUBLKS_LAZYCSUM the checksum is not verified when only TYPE-like
+ * results are requested; the result is marked and the superblocks chain
+ * verifies it later if the result has to be compared with others.
+ */
+int blkid_probe_need_csum(blkid_probe pr)
+{
+	struct blkid_chain *chn = blkid_probe_get_chain(pr);
+
+	if (!chn || chn->driver->id != BLKID_CHAIN_SUBLKS
+	    || !(chn->flags & BLKID_SUBLKS_LAZYCSUM)
+	    || (pr->prob_flags & BLKID_PROBE_FL_FORCE_CSUM))
+		return 1;
+
+	/* values read from the superblock are trusted only if checksum is valid */
+	if (chn->flags & (BLKID_SUBLKS_LABEL | BLKID_SUBLKS_LABELRAW |
+			  BLKID_SUBLKS_UUID | BLKID_SUBLKS_UUIDRAW |
+			  BLKID_SUBLKS_BADCSUM))
+		return 1;
+
+	DBG(LOWPROBE, ul_debug("deferred checksum for type %s",
+			blkid_probe_get_probername(pr)));
+	pr->prob_flags |= BLKID_PROBE_FL_CSUM_DEFERRED;
+	return 0;
+}
+
 /**
  * blkid_probe_get_devno:
  * @pr: probe
@@ -1796,6 +2482,245 @@ int blkid_probe_is_wholedisk(blkid_probe pr)
 	return devno == disk_devno;
 }
 
+#ifdef HAVE_PTHREAD_H
+/*
+ * Process-wide cache of the whole-disk probes. The partitions of the same disk
+ * share the whole-disk probe, so the partition table is read and parsed only
+ * once (see blkid_partitions_probe_partition()).
+ *
+ * The probe is used by one thread only (but may be shared by more probes in
+ * the thread). The unused probes are kept in the cache for a short time
+ * without the file descriptor, so the cache does not keep the disks open.
+ */
+#define BLKID_WHOLEDISK_CACHE_MAX	8
+#define BLKID_WHOLEDISK_CACHE_TTL	(1 * 1000000)	/* usec */
+
+struct wholedisk_ent {
+	struct list_head	ents;
+	blkid_probe		pr;
+	char			*path;
+	int			refcount;
+	pthread_t		owner;
+	uint64_t		stamp;		/* when unused */
+};
+
+static struct list_head wholedisk_cache = { &wholedisk_cache, &wholedisk_cache };
+static size_t nwholedisk_cache;
+static pthread_mutex_t wholedisk_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void free_wholedisk_list(struct list_head *list)
+{
+	while (!list_empty(list)) {
+		struct wholedisk_ent *ent = list_entry(list->next,
+						struct wholedisk_ent, ents);
+		list_del(&ent->ents);
+		ent->pr->flags &= ~BLKID_FL_SHARED_DISK;
+		blkid_free_probe(ent->pr);
+		free(ent->path);
+		free(ent);
+	}
+}
+
+/*
+ * The partition table may be rewritten while the probe is unused, and the
+ * probing results are based on the buffers. Re-read the buffered areas and
+ * compare them with the cache; it's cheaper than to parse it all again.
+ */
+static int wholedisk_buffers_unchanged(blkid_probe pr, int fd)
+{
+	struct list_head *p;
+	unsigned char *data = NULL;
+	uint64_t datasz = 0;
+	int rc = 1;
+
+	if (pr->flags & BLKID_FL_MODIF_BUFF)
+		return 0;
+
+	list_for_each(p, &pr->buffers) {
+		struct blkid_bufinfo *bf = list_entry(p, struct blkid_bufinfo, bufs);
+
+		if (bf->len > datasz) {
+			unsigned char *tmp = realloc(data, bf->len);
+
+			if (!tmp) {
+				rc = 0;
+				break;
+			}
+			data = tmp;
+			datasz = bf->len;
+		}
+		UL_STATS_CALL(UL_STATS_READ);
+		if (pread(fd, data, bf->len, bf->off) != (ssize_t) bf->len
+		    || memcmp(data, bf->data, bf->len) != 0) {
+			rc = 0;
+			break;
+		}
+	}
+	free(data);
+
+	if (!rc)
+		DBG(LOWPROBE, ul_debug("wholedisk data modified, dropping cached probe"));
+	return rc;
+}
+
+/* reopens the device for the unused cached probe */
+static int reopen_wholedisk(struct wholedisk_ent *ent)
+{
+	blkid_probe pr = ent->pr;
+	unsigned long long sz = 0;
+	struct stat st;
+	int fd;
+
+	UL_STATS_CALL(UL_STATS_OPEN);
+	fd = open(ent->path, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode)
+	    || st.st_rdev != pr->devno
+	    || blkdev_get_size(fd, &sz) != 0 || sz != pr->size
+	    || !wholedisk_buffers_unchanged(pr, fd)) {
+		close(fd);
+		return -1;
+	}
+	pr->fd = fd;
+	return 0;
+}
+
+static blkid_probe get_cached_wholedisk(dev_t disk)
+{
+	struct list_head *p, *pnext, garbage;
+	uint64_t now = blkid_monotonic_usec();
+	blkid_probe res = NULL;
+
+	INIT_LIST_HEAD(&garbage);
+
+	pthread_mutex_lock(&wholedisk_lock);
+	list_for_each_safe(p, pnext, &wholedisk_cache) {
+		struct wholedisk_ent *ent = list_entry(p, struct wholedisk_ent, ents);
+
+		if (ent->refcount == 0 &&
+		    (now < ent->stamp || now - ent->stamp >= BLKID_WHOLEDISK_CACHE_TTL))
+			goto drop;	/* expired */
+		if (res || ent->pr->devno != disk)
+			continue;
+
+		if (ent->refcount == 0) {
+			if (reopen_wholedisk(ent) != 0)
+				goto drop;
+			ent->owner = pthread_self();
+		} else if (!pthread_equal(ent->owner, pthread_self()))
+			continue;	/* used by another thread */
+
+		ent->refcount++;
+		res = ent->pr;
+		continue;
+drop:
+		list_del(&ent->ents);
+		list_add_tail(&ent->ents, &garbage);
+		nwholedisk_cache--;
+	}
+	pthread_mutex_unlock(&wholedisk_lock);
+
+	free_wholedisk_list(&garbage);
+
+	if (res)
+		DBG(LOWPROBE, ul_debug("using cached wholedisk probe"));
+	return res;
+}
+
+static blkid_probe new_wholedisk_probe(char *path)
+{
+	struct wholedisk_ent *ent;
+	blkid_probe pr;
+
+	DBG(LOWPROBE, ul_debug("allocate a wholedisk probe"));
+
+	pr = blkid_new_probe_from_filename(path);
+	if (!pr || !S_ISBLK(pr->mode))
+		goto nocache;
+
+	ent = calloc(1, sizeof(*ent));
+	if (!ent)
+		goto nocache;
+
+	ent->pr = pr;
+	ent->path = path;
+	ent->refcount = 1;
+	ent->owner = pthread_self();
+
+	pthread_mutex_lock(&wholedisk_lock);
+	if (nwholedisk_cache < BLKID_WHOLEDISK_CACHE_MAX) {
+		list_add(&ent->ents, &wholedisk_cache);
+		nwholedisk_cache++;
+		pr->flags |= BLKID_FL_SHARED_DISK;
+		ent = NULL;
+	}
+	pthread_mutex_unlock(&wholedisk_lock);
+
+	if (!ent)
+		return pr;
+	free(ent);
+nocache:
+	free(path);
+	return pr;
+}
+
+static void put_wholedisk_probe(blkid_probe disk_pr)
+{
+	struct list_head *p;
+
+	if (!disk_pr)
+		return;
+	if (!(disk_pr->flags & BLKID_FL_SHARED_DISK)) {
+		blkid_free_probe(disk_pr);
+		return;
+	}
+
+	pthread_mutex_lock(&wholedisk_lock);
+	list_for_each(p, &wholedisk_cache) {
+		struct wholedisk_ent *ent = list_entry(p, struct wholedisk_ent, ents);
+
+		if (ent->pr != disk_pr)
+			continue;
+		if (--ent->refcount == 0) {
+			/* don't keep the disk open */
+			ent->stamp = blkid_monotonic_usec();
+			close_direct_fd(disk_pr);
+			blkid_probe_free_uring(disk_pr);
+			if (disk_pr->fd >= 0)
+				close(disk_pr->fd);
+			disk_pr->fd = -1;
+		}
+		break;
+	}
+	pthread_mutex_unlock(&wholedisk_lock);
+}
+
+#else /* !HAVE_PTHREAD_H */
+
+/* without threads support every partition uses its own whole-disk probe */
+static blkid_probe get_cached_wholedisk(dev_t disk __attribute__((__unused__)))
+{
+	return NULL;
+}
+
+static blkid_probe new_wholedisk_probe(char *path)
+{
+	blkid_probe pr;
+
+	DBG(LOWPROBE, ul_debug("allocate a wholedisk probe"));
+
+	pr = blkid_new_probe_from_filename(path);
+	free(path);
+	return pr;
+}
+
+static void put_wholedisk_probe(blkid_probe disk_pr)
+{
+	blkid_free_probe(disk_pr);
+}
+#endif /* HAVE_PTHREAD_H */
+
 blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr)
 {
 	dev_t disk;
@@ -1811,10 +2736,13 @@ blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr)
 
 	if (pr->disk_probe && pr->disk_probe->devno != disk) {
 		/* we have disk prober, but for another disk... close it */
-		blkid_free_probe(pr->disk_probe);
+		put_wholedisk_probe(pr->disk_probe);
 		pr->disk_probe = NULL;
 	}
 
+	if (!pr->disk_probe)
+		pr->disk_probe = get_cached_wholedisk(disk);
+
 	if (!pr->disk_probe) {
 		/* Open a new disk prober */
 		char *disk_path = blkid_devno_to_devname(disk);
@@ -1822,12 +2750,7 @@ blkid_probe blkid_probe_get_wholedisk_probe(blkid_probe pr)
 		if (!disk_path)
 			return NULL;
 
-		DBG(LOWPROBE, ul_debug("allocate a wholedisk probe"));
-
-		pr->disk_probe = blkid_new_probe_from_filename(disk_path);
-
-		free(disk_path);
-
+		pr->disk_probe = new_wholedisk_probe(disk_path);
 		if (!pr->disk_probe)
 			return NULL;	/* ENOMEM? */
 	}
@@ -2293,3 +3216,190 @@ void blkid_probe_reset_hints(blkid_probe pr)
 
 	INIT_LIST_HEAD(&pr->hints);
 }
+
+#ifdef TEST_PROGRAM
+/*
+ * Probing throughput benchmark: calls every superblocks and partitions
+ * prober separately on each image and prints probes/sec and bytes read from
+ * the device by the prober. The probers which read more than --ratio times
+ * the end of their magic area are marked by '!'.
+ */
+#include <getopt.h>
+
+struct prober_bench {
+	const char	*chain;
+	const char	*name;
+	uint64_t	magic_end;	/* 0 if unknown */
+
+	uint64_t	nprobes;	/* prober called (magic matched or not) */
+	uint64_t	nmatches;
+	uint64_t	usec;
+	uint64_t	nbytes;
+};
+
+/*
+ * Returns the end of the most distant area read to check the magic strings
+ * (see get_idmag_area()), or 0 if unknown.
+ */
+static uint64_t idinfo_magic_end(const struct blkid_idinfo *id)
+{
+	const struct blkid_idmag *mag;
+	uint64_t end = 0;
+
+	for (mag = &id->magics[0]; mag->magic; mag++) {
+		uint64_t x;
+
+		if (mag->is_zoned)
+			continue;
+		if (mag->kboff < 0)
+			return 0;
+		x = ((mag->kboff + (mag->sboff >> 10)) << 10) + 1024;
+		end = max(end, x);
+	}
+	return end;
+}
+
+static int bench_prober(blkid_probe pr, int fd, struct prober_bench *b,
+			int chain)
+{
+	char *names[] = { (char *) b->name, NULL };
+	int rc, n, nstats;
+
+	if (blkid_probe_set_device(pr, fd, 0, 0) != 0)
+		return -1;
+
+	blkid_probe_enable_superblocks(pr, chain == BLKID_CHAIN_SUBLKS);
+	blkid_probe_enable_partitions(pr, chain == BLKID_CHAIN_PARTS);
+	blkid_probe_enable_topology(pr, 0);
+	__blkid_probe_filter_types(pr, chain, BLKID_FLTR_ONLYIN, names);
+
+	rc = blkid_do_probe(pr);
+	if (rc < 0)
+		return rc;
+	if (rc == 0)
+		b->nmatches++;
+
+	nstats = blkid_probe_numof_stats(pr);
+	for (n = 0; n < nstats; n++) {
+		const char *name;
+		uint64_t usec, nbytes;
+
+		if (blkid_probe_get_stat(pr, n, NULL, &name, &usec,
+					 NULL, &nbytes) || !name
+		    || strcmp(name, b->name) != 0)
+			continue;
+		b->nprobes++;
+		b->usec += usec;
+		b->nbytes += nbytes;
+	}
+	return 0;
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	fprintf(stdout, " %s [options] <image> [...]\n\n",
+			program_invocation_short_name);
+	fputs(" -r, --repeat <num>   probe every image <num> times (default 10)\n", stdout);
+	fputs(" -x, --ratio <num>    mark probers reading more than <num> times\n"
+	      "                      the end of the magic area (default 16)\n", stdout);
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option longopts[] = {
+		{ "repeat", required_argument, NULL, 'r' },
+		{ "ratio",  required_argument, NULL, 'x' },
+		{ "help",   no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	static const int chains[] = { BLKID_CHAIN_SUBLKS, BLKID_CHAIN_PARTS };
+	struct prober_bench *benches;
+	unsigned int repeat = 10, ratio = 16, r;
+	size_t nbenches = 0, i, c;
+	blkid_probe pr;
+	int ch;
+
+	while ((ch = getopt_long(argc, argv, "r:x:h", longopts, NULL)) != -1) {
+		switch (ch) {
+		case 'r':
+			repeat = strtou32_or_err(optarg, "failed to parse repeat");
+			break;
+		case 'x':
+			ratio = strtou32_or_err(optarg, "failed to parse ratio");
+			break;
+		case 'h':
+			usage();
+		default:
+			errx(EXIT_FAILURE, "try --help");
+		}
+	}
+	if (optind == argc)
+		errx(EXIT_FAILURE, "no image specified");
+
+	benches = calloc(superblocks_drv.nidinfos + partitions_drv.nidinfos,
+			 sizeof(*benches));
+	if (!benches)
+		err(EXIT_FAILURE, "cannot allocate benchmark data");
+
+	for (c = 0; c < ARRAY_SIZE(chains); c++) {
+		const struct blkid_chaindrv *drv = chains_drvs[chains[c]];
+
+		for (i = 0; i < drv->nidinfos; i++) {
+			struct prober_bench *b = &benches[nbenches++];
+
+			b->chain = drv->name;
+			b->name = drv->idinfos[i]->name;
+			b->magic_end = idinfo_magic_end(drv->idinfos[i]);
+		}
+	}
+
+	pr = blkid_new_probe();
+	if (!pr)
+		err(EXIT_FAILURE, "cannot allocate prober");
+	blkid_probe_enable_stats(pr, 1);
+
+	for (; optind < argc; optind++) {
+		int fd = open(argv[optind], O_RDONLY|O_CLOEXEC);
+
+		if (fd < 0)
+			err(EXIT_FAILURE, "cannot open %s", argv[optind]);
+
+		for (i = 0; i < nbenches; i++) {
+			int chain = i < superblocks_drv.nidinfos ?
+					BLKID_CHAIN_SUBLKS : BLKID_CHAIN_PARTS;
+
+			for (r = 0; r < repeat; r++) {
+				if (bench_prober(pr, fd, &benches[i], chain) < 0)
+					warnx("%s: %s: probing failed",
+						argv[optind], benches[i].name);
+			}
+		}
+		close(fd);
+	}
+
+	printf("%-12s %-30s %8s %8s %12s %11s %10s\n", "CHAIN", "PROBER",
+		"PROBES", "MATCHES", "PROBES/SEC", "BYTES/PROBE", "MAGIC-END");
+
+	for (i = 0; i < nbenches; i++) {
+		struct prober_bench *b = &benches[i];
+		uint64_t bytes;
+		int mark;
+
+		if (!b->nprobes)
+			continue;
+
+		bytes = b->nbytes / b->nprobes;
+		mark = b->magic_end && bytes > b->magic_end * ratio;
+
+		printf("%-12s %-30s %8"PRIu64" %8"PRIu64" %12.0f %11"PRIu64" %10"PRIu64"%s\n",
+			b->chain, b->name, b->nprobes, b->nmatches,
+			b->usec ? b->nprobes * 1000000.0 / b->usec : 0.0,
+			bytes, b->magic_end, mark ? " !" : "");
+	}
+
+	blkid_free_probe(pr);
+	free(benches);
+	return EXIT_SUCCESS;
+}
+#endif /* TEST_PROGRAM */
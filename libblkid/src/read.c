@@ -46,6 +46,10 @@
  *	The following tags may be present, depending on the device contents
  *	<LABEL="label">	(user supplied) label (volume name, etc)
  *	<UUID="uuid">	(generated) universally unique identifier (serial no)
+ *
+ *	The following tag is optional and used to revalidate the entry
+ *	<FPRINT="size:offset:length:crc"> device size and checksum of the
+ *	                 sector(s) with the superblock magic
  */
 
 static char *skip_over_blank(char *cp)
@@ -316,6 +320,20 @@ static int parse_tag(blkid_cache cache, blkid_dev dev, char **cp)
 			dev->bid_utime = strtoull(end + 1, NULL, 0);
 		if (errno)
 			return -errno;
+	} else if (!strcmp(name, "FPRINT")) {
+		uintmax_t size, off;
+		unsigned int len, crc, dlen, dcrc;
+
+		/* the fingerprint is optional, ignore garbage */
+		if (sscanf(value, "%ju:%ju:%u:%x:%u:%x", &size, &off, &len, &crc,
+					&dlen, &dcrc) == 6) {
+			dev->bid_size = size;
+			dev->bid_fp_off = off;
+			dev->bid_fp_len = len;
+			dev->bid_fp_crc = crc;
+			dev->bid_fp_dlen = dlen;
+			dev->bid_fp_dcrc = dcrc;
+		}
 	} else
 		ret = blkid_set_tag(dev, name, value, strlen(value));
 
@@ -391,6 +409,20 @@ void blkid_read_cache(blkid_cache cache)
 		goto errout;
 	}
 
+	/* the old binary cache is outdated, keep its devices */
+	blkid_bincache_load(cache);
+
+	if (blkid_bincache_open(cache, &st) == 0) {
+		close(fd);
+		/*
+		 * The devices are read from the file on demand, except
+		 * re-read when the list is already in use.
+		 */
+		if (!list_empty(&cache->bic_devs))
+			blkid_bincache_load(cache);
+		goto done;
+	}
+
 	DBG(CACHE, ul_debug("reading cache file %s",
 				cache->bic_filename));
 
@@ -419,7 +451,7 @@ void blkid_read_cache(blkid_cache cache)
 		}
 	}
 	fclose(file);
-
+done:
 	/*
 	 * Initially we do not need to write out the cache file.
 	 */
@@ -59,6 +59,12 @@ static int save_dev(blkid_dev dev, FILE *file)
 
 	if (dev->bid_pri)
 		fprintf(file, " PRI=\"%d\"", dev->bid_pri);
+	if (dev->bid_fp_len)
+		fprintf(file, " FPRINT=\"%ju:%ju:%u:0x%08x:%u:0x%08x\"",
+				(uintmax_t) dev->bid_size,
+				(uintmax_t) dev->bid_fp_off,
+				dev->bid_fp_len, dev->bid_fp_crc,
+				dev->bid_fp_dlen, dev->bid_fp_dcrc);
 
 	list_for_each(p, &dev->bid_tags) {
 		blkid_tag tag = list_entry(p, struct blkid_struct_tag, bit_tags);
@@ -73,6 +79,27 @@ static int save_dev(blkid_dev dev, FILE *file)
 	return 0;
 }
 
+/*
+ * Write out (or remove) the binary version of the cache file.
+ */
+static void save_bincache(blkid_cache cache, const char *filename)
+{
+	struct blkid_config *conf = blkid_read_config(NULL);
+
+	if (conf && conf->bincache)
+		blkid_bincache_save(cache, filename);
+	else {
+		char *name = NULL;
+
+		if (asprintf(&name, "%s" BLKID_BINCACHE_SUFFIX, filename) > 0) {
+			if (unlink(name) == 0)
+				DBG(SAVE, ul_debug("removed binary cache %s", name));
+			free(name);
+		}
+	}
+	blkid_free_config(conf);
+}
+
 /*
  * Write out the cache struct to the cache file on disk.
  */
@@ -86,6 +113,9 @@ int blkid_flush_cache(blkid_cache cache)
 	int fd, ret = 0;
 	struct stat st;
 
+	if (cache->bic_flags & BLKID_BIC_FL_CHANGED)
+		blkid_bincache_load(cache);
+
 	if (list_empty(&cache->bic_devs) ||
 	    !(cache->bic_flags & BLKID_BIC_FL_CHANGED)) {
 		DBG(SAVE, ul_debug("skipping cache file write"));
@@ -201,6 +231,8 @@ int blkid_flush_cache(blkid_cache cache)
 		}
 	}
 
+	if (ret == 1)
+		save_bincache(cache, filename);
 errout:
 	free(tmp);
 	if (filename != cache->bic_filename)
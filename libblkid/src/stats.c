@@ -0,0 +1,212 @@
+/*
+ * stats.c - per-prober timing and I/O statistics
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The statistics are collected if enabled by blkid_probe_enable_stats() or
+ * by LIBBLKID_DEBUG=timing. The probing functions of all chains are wrapped
+ * by blkid_probe_stat_start() and blkid_probe_stat_end(); the I/O counters
+ * are incremented for all reads from the device (including read-ahead).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "blkidP.h"
+#include "monotonic.h"
+#include "ulstats.h"
+
+/* clones and whole-disk probes account to the top-level probe */
+static blkid_probe stats_probe(blkid_probe pr)
+{
+	while (pr->parent)
+		pr = pr->parent;
+	return pr;
+}
+
+static int stats_enabled(blkid_probe pr)
+{
+	return (stats_probe(pr)->flags & BLKID_FL_STATS) ||
+	       (libblkid_debug_mask & BLKID_DEBUG_TIMING);
+}
+
+static void get_io_counters(blkid_probe pr, uint64_t *nreads, uint64_t *nbytes)
+{
+	*nreads = *nbytes = 0;
+
+	for (; pr; pr = pr->parent) {
+		*nreads += pr->io_nreads;
+		*nbytes += pr->io_nbytes;
+		if (pr->disk_probe) {
+			*nreads += pr->disk_probe->io_nreads;
+			*nbytes += pr->disk_probe->io_nbytes;
+		}
+	}
+}
+
+uint64_t blkid_monotonic_usec(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(UL_CLOCK_MONOTONIC, &ts) != 0)
+		return 0;
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void blkid_probe_stat_start(blkid_probe pr, struct blkid_prstat_mark *mk)
+{
+	UL_STATS_BEGIN(UL_STATS_PROBE);
+
+	mk->enabled = stats_enabled(pr);
+	if (!mk->enabled)
+		return;
+
+	get_io_counters(pr, &mk->nreads, &mk->nbytes);
+	mk->usec = blkid_monotonic_usec();
+}
+
+/*
+ * Accounts the time and I/O since blkid_probe_stat_start() to @name
+ * probing function (or to the whole chain if @name is NULL).
+ */
+void blkid_probe_stat_end(blkid_probe pr, struct blkid_prstat_mark *mk,
+			  const char *chain, const char *name)
+{
+	struct blkid_prstat *st = NULL;
+	blkid_probe top;
+	uint64_t usec, nreads, nbytes;
+	size_t i;
+
+	UL_STATS_END(UL_STATS_PROBE);
+
+	if (!mk->enabled)
+		return;
+
+	usec = blkid_monotonic_usec() - mk->usec;
+	get_io_counters(pr, &nreads, &nbytes);
+	nreads -= mk->nreads;
+	nbytes -= mk->nbytes;
+
+	DBG(TIMING, ul_debug("%s%s%s: %"PRIu64" usec, %"PRIu64" reads, %"PRIu64" bytes",
+				chain, name ? "/" : "", name ? name : "",
+				usec, nreads, nbytes));
+
+	top = stats_probe(pr);
+	if (!(top->flags & BLKID_FL_STATS))
+		return;
+
+	for (i = 0; i < top->nstats; i++) {
+		if (top->stats[i].chain == chain && top->stats[i].name == name) {
+			st = &top->stats[i];
+			break;
+		}
+	}
+	if (!st) {
+		struct blkid_prstat *tmp;
+
+		tmp = realloc(top->stats, (top->nstats + 1) * sizeof(*tmp));
+		if (!tmp)
+			return;
+		top->stats = tmp;
+		st = &top->stats[top->nstats++];
+		memset(st, 0, sizeof(*st));
+		st->chain = chain;
+		st->name = name;
+	}
+
+	st->usec += usec;
+	st->nreads += nreads;
+	st->nbytes += nbytes;
+}
+
+void blkid_probe_reset_stats(blkid_probe pr)
+{
+	free(pr->stats);
+	pr->stats = NULL;
+	pr->nstats = 0;
+}
+
+/**
+ * blkid_probe_enable_stats:
+ * @pr: prober
+ * @enable: TRUE/FALSE
+ *
+ * Enables/disables the per-prober statistics. If enabled, the library
+ * records the time spent, number of reads and bytes read from the device for
+ * each called probing function and for each chain. The statistics are
+ * accumulated for all probing calls for the current device and they are
+ * reset by blkid_probe_set_device().
+ *
+ * See also blkid_probe_numof_stats() and blkid_probe_get_stat(). The
+ * statistics are also printed to stderr by LIBBLKID_DEBUG=timing.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_enable_stats(blkid_probe pr, int enable)
+{
+	if (enable)
+		pr->flags |= BLKID_FL_STATS;
+	else {
+		pr->flags &= ~BLKID_FL_STATS;
+		blkid_probe_reset_stats(pr);
+	}
+	return 0;
+}
+
+/**
+ * blkid_probe_numof_stats:
+ * @pr: probe
+ *
+ * Since: 2.38
+ *
+ * Returns: number of records in the statistics or -1 in case of error.
+ */
+int blkid_probe_numof_stats(blkid_probe pr)
+{
+	return (int) pr->nstats;
+}
+
+/**
+ * blkid_probe_get_stat:
+ * @pr: probe
+ * @num: wanted record in range 0..N, where N is blkid_probe_numof_stats() - 1
+ * @chain: pointer to return chain name ("superblocks", "partitions", ...) or NULL
+ * @name: pointer to return probing function name, NULL for the whole chain
+ * @usec: pointer to return time in microseconds or NULL
+ * @nreads: pointer to return number of reads from the device or NULL
+ * @nbytes: pointer to return number of bytes read from the device or NULL
+ *
+ * The records for the whole chains include also the time and I/O of the
+ * chain initialization (for example read-ahead).
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, or -1 in case of error.
+ */
+int blkid_probe_get_stat(blkid_probe pr, int num, const char **chain,
+			 const char **name, uint64_t *usec,
+			 uint64_t *nreads, uint64_t *nbytes)
+{
+	struct blkid_prstat *st;
+
+	if (num < 0 || (size_t) num >= pr->nstats)
+		return -1;
+
+	st = &pr->stats[num];
+	if (chain)
+		*chain = st->chain;
+	if (name)
+		*name = st->name;
+	if (usec)
+		*usec = st->usec;
+	if (nreads)
+		*nreads = st->nreads;
+	if (nbytes)
+		*nbytes = st->nbytes;
+	return 0;
+}
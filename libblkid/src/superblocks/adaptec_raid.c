@@ -109,6 +109,7 @@ static int probe_adraid(blkid_probe pr,
 const struct blkid_idinfo adraid_idinfo = {
 	.name		= "adaptec_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_adraid,
 	.magics		= BLKID_NONE_MAGIC
 };
@@ -134,6 +134,7 @@ static int probe_ddf(blkid_probe pr,
 const struct blkid_idinfo ddfraid_idinfo = {
 	.name		= "ddf_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_ddf,
 	.magics		= BLKID_NONE_MAGIC
 };
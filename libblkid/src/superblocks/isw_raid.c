@@ -60,6 +60,7 @@ static int probe_iswraid(blkid_probe pr,
 const struct blkid_idinfo iswraid_idinfo = {
 	.name		= "isw_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_iswraid,
 	.magics		= BLKID_NONE_MAGIC
 };
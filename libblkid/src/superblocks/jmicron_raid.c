@@ -58,6 +58,7 @@ static int probe_jmraid(blkid_probe pr,
 const struct blkid_idinfo jmraid_idinfo = {
 	.name		= "jmicron_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_jmraid,
 	.magics		= BLKID_NONE_MAGIC
 };
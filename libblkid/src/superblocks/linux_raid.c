@@ -260,6 +260,7 @@ static int probe_raid(blkid_probe pr,
 const struct blkid_idinfo linuxraid_idinfo = {
 	.name		= "linux_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_raid,
 	.magics		= BLKID_NONE_MAGIC
 };
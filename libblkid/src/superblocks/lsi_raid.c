@@ -53,6 +53,7 @@ static int probe_lsiraid(blkid_probe pr,
 const struct blkid_idinfo lsiraid_idinfo = {
 	.name		= "lsi_mega_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_lsiraid,
 	.magics		= BLKID_NONE_MAGIC
 };
@@ -97,7 +97,7 @@ static int probe_lvm2(blkid_probe pr, const struct blkid_idmag *mag)
 	if (le64_to_cpu(label->sector_xl) != (unsigned) sector)
 		return 1;
 
-	if (!blkid_probe_verify_csum(
+	if (blkid_probe_need_csum(pr) && !blkid_probe_verify_csum(
 		pr, lvm2_calc_crc(
 			&label->offset_xl, LVM2_LABEL_SIZE -
 			((char *) &label->offset_xl - (char *) label)),
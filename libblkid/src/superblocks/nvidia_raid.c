@@ -57,6 +57,7 @@ static int probe_nvraid(blkid_probe pr,
 const struct blkid_idinfo nvraid_idinfo = {
 	.name		= "nvidia_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_nvraid,
 	.magics		= BLKID_NONE_MAGIC
 };
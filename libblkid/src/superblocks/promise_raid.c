@@ -70,6 +70,7 @@ static int probe_pdcraid(blkid_probe pr,
 const struct blkid_idinfo pdcraid_idinfo = {
 	.name		= "promise_fasttrack_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_pdcraid,
 	.magics		= BLKID_NONE_MAGIC
 };
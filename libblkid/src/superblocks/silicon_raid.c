@@ -108,7 +108,8 @@ static int probe_silraid(blkid_probe pr,
 		return 1;
 	if (sil->disk_number >= 8)
 		return 1;
-	if (!blkid_probe_verify_csum(pr, silraid_checksum(sil), le16_to_cpu(sil->checksum1)))
+	if (blkid_probe_need_csum(pr) &&
+	    !blkid_probe_verify_csum(pr, silraid_checksum(sil), le16_to_cpu(sil->checksum1)))
 		return 1;
 
 	if (blkid_probe_sprintf_version(pr, "%u.%u",
@@ -127,6 +128,7 @@ static int probe_silraid(blkid_probe pr,
 const struct blkid_idinfo silraid_idinfo = {
 	.name		= "silicon_medley_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_silraid,
 	.magics		= BLKID_NONE_MAGIC
 };
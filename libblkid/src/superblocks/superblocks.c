@@ -210,6 +210,13 @@ int blkid_probe_enable_superblocks(blkid_probe pr, int enable)
  * Sets probing flags to the superblocks prober. This function is optional, the
  * default are BLKID_SUBLKS_DEFAULTS flags.
  *
+ * The BLKID_SUBLKS_LAZYCSUM flag allows to skip superblock checksum
+ * verification if the checksum is not necessary for the requested results,
+ * for example for TYPE-only scans. The flag is ignored if LABEL or UUID is
+ * requested. The checksums are still verified when blkid_do_safeprobe() has
+ * to decide between more results or when a RAID or crypto signature hides
+ * other signatures on the device.
+ *
  * Returns: 0 on success, or -1 in case of error.
  */
 int blkid_probe_set_superblocks_flags(blkid_probe pr, int flags)
@@ -341,6 +348,7 @@ int blkid_superblocks_get_name(size_t idx, const char **name, int *usage)
  */
 static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 {
+	struct blkid_prstat_mark mk;
 	size_t i;
 	int rc = BLKID_PROBE_NONE;
 
@@ -381,6 +389,11 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 			continue;
 		}
 
+		if (blkid_probe_is_prefiltered(chn, i)) {
+			rc = BLKID_PROBE_NONE;
+			continue;	/* magic string does not match */
+		}
+
 		if (id->minsz && (unsigned)id->minsz > pr->size) {
 			rc = BLKID_PROBE_NONE;
 			continue;	/* the device is too small */
@@ -401,23 +414,23 @@ static int superblocks_probe(blkid_probe pr, struct blkid_chain *chn)
 
 		DBG(LOWPROBE, ul_debug("[%zd] %s:", i, id->name));
 
+		blkid_probe_stat_start(pr, &mk);
+		pr->prob_flags &= ~BLKID_PROBE_FL_CSUM_DEFERRED;
 		rc = blkid_probe_get_idmag(pr, id, &off, &mag);
-		if (rc < 0)
-			break;
-		if (rc != BLKID_PROBE_OK)
-			continue;
 
 		/* final check by probing function */
-		if (id->probefunc) {
+		if (rc == BLKID_PROBE_OK && id->probefunc) {
 			DBG(LOWPROBE, ul_debug("\tcall probefunc()"));
 			rc = id->probefunc(pr, mag);
-			if (rc != BLKID_PROBE_OK) {
+			if (rc != BLKID_PROBE_OK)
 				blkid_probe_chain_reset_values(pr, chn);
-				if (rc < 0)
-					break;
-				continue;
-			}
 		}
+		blkid_probe_stat_end(pr, &mk, chn->driver->name, id->name);
+
+		if (rc < 0)
+			break;
+		if (rc != BLKID_PROBE_OK)
+			continue;
 
 		/* all checks passed */
 		if (chn->flags & BLKID_SUBLKS_TYPE)
@@ -465,6 +478,7 @@ static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn)
 	int idx = -1;
 	int count = 0;
 	int intol = 0;
+	int deferred = 0;
 	int rc;
 
 	INIT_LIST_HEAD(&vals);
@@ -472,16 +486,30 @@ static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn)
 	if (pr->flags & BLKID_FL_NOSCAN_DEV)
 		return BLKID_PROBE_NONE;
 
+	pr->prob_flags &= ~BLKID_PROBE_FL_FORCE_CSUM;
+again:
 	while ((rc = superblocks_probe(pr, chn)) == 0) {
 
 		if (blkid_probe_is_tiny(pr) && !count)
-			return BLKID_PROBE_OK;	/* floppy or so -- returns the first result. */
-
-		count++;
+			goto done_ok;	/* floppy or so -- returns the first result. */
 
 		if (chn->idx >= 0 &&
-		    idinfos[chn->idx]->usage & (BLKID_USAGE_RAID | BLKID_USAGE_CRYPTO))
+		    idinfos[chn->idx]->usage & (BLKID_USAGE_RAID | BLKID_USAGE_CRYPTO)) {
+			if (pr->prob_flags & BLKID_PROBE_FL_CSUM_DEFERRED) {
+				/* the result hides all others, verify it */
+				DBG(LOWPROBE, ul_debug("re-probe %s with checksum",
+						idinfos[chn->idx]->name));
+				pr->prob_flags |= BLKID_PROBE_FL_FORCE_CSUM;
+				chn->idx--;
+				continue;
+			}
+			count++;
 			break;
+		}
+		count++;
+
+		if (pr->prob_flags & BLKID_PROBE_FL_CSUM_DEFERRED)
+			deferred++;
 
 		if (chn->idx >= 0 &&
 		    !(idinfos[chn->idx]->flags & BLKID_IDINFO_TOLERANT))
@@ -497,6 +525,18 @@ static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn)
 	if (rc < 0)
 		goto done;		/* error */
 
+	if (count > 1 && intol && deferred) {
+		/* the result may be ambivalent due to a bad checksum */
+		DBG(LOWPROBE, ul_debug("re-probe all with checksums"));
+		blkid_probe_free_values_list(&vals);
+		blkid_probe_chain_reset_values(pr, chn);
+		pr->prob_flags |= BLKID_PROBE_FL_FORCE_CSUM;
+		chn->idx = -1;
+		idx = -1;
+		count = intol = deferred = 0;
+		goto again;
+	}
+
 	if (count > 1 && intol) {
 		DBG(LOWPROBE, ul_debug("ERROR: superblocks chain: "
 			       "ambivalent result detected (%d filesystems)!",
@@ -523,9 +563,10 @@ static int superblocks_safeprobe(blkid_probe pr, struct blkid_chain *chn)
 	 */
 	if (chn->idx >= 0 && idinfos[chn->idx]->usage & BLKID_USAGE_RAID)
 		pr->prob_flags |= BLKID_PROBE_FL_IGNORE_PT;
-
+done_ok:
 	rc = BLKID_PROBE_OK;
 done:
+	pr->prob_flags &= ~BLKID_PROBE_FL_FORCE_CSUM;
 	blkid_probe_free_values_list(&vals);
 	return rc;
 }
@@ -173,8 +173,6 @@ static unsigned char *search_fat_label(blkid_probe pr,
 		if ((ent->attr & (FAT_ATTR_VOLUME_ID | FAT_ATTR_DIR)) ==
 		    FAT_ATTR_VOLUME_ID) {
 			DBG(LOWPROBE, ul_debug("\tfound fs LABEL at entry %d", i));
-			if (ent->name[0] == 0x05)
-				ent->name[0] = 0xE5;
 			return ent->name;
 		}
 	}
@@ -330,6 +328,8 @@ static int probe_vfat(blkid_probe pr, const struct blkid_idmag *mag)
 		if (vol_label) {
 			memcpy(vol_label_buf, vol_label, 11);
 			vol_label = vol_label_buf;
+			if (vol_label_buf[0] == 0x05)
+				vol_label_buf[0] = 0xE5;
 		}
 
 		if (ms->ms_ext_boot_sign == 0x29)
@@ -373,6 +373,8 @@ static int probe_vfat(blkid_probe pr, const struct blkid_idmag *mag)
 			if (vol_label) {
 				memcpy(vol_label_buf, vol_label, 11);
 				vol_label = vol_label_buf;
+				if (vol_label_buf[0] == 0x05)
+					vol_label_buf[0] = 0xE5;
 				break;
 			}
 
@@ -69,7 +69,8 @@ static int probe_viaraid(blkid_probe pr,
 		return 1;
 	if (v->version_number > 2)
 		return 1;
-	if (!blkid_probe_verify_csum(pr, via_checksum(v), v->checksum))
+	if (blkid_probe_need_csum(pr) &&
+	    !blkid_probe_verify_csum(pr, via_checksum(v), v->checksum))
 		return 1;
 
 	if (blkid_probe_sprintf_version(pr, "%u", v->version_number) != 0)
@@ -84,6 +85,7 @@ static int probe_viaraid(blkid_probe pr,
 const struct blkid_idinfo viaraid_idinfo = {
 	.name		= "via_raid_member",
 	.usage		= BLKID_USAGE_RAID,
+	.flags		= BLKID_IDINFO_TAILMETA,
 	.probefunc	= probe_viaraid,
 	.magics		= BLKID_NONE_MAGIC
 };
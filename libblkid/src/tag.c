@@ -27,10 +27,101 @@ static blkid_tag blkid_new_tag(void)
 	DBG(TAG, ul_debugobj(tag, "alloc"));
 	INIT_LIST_HEAD(&tag->bit_tags);
 	INIT_LIST_HEAD(&tag->bit_names);
+	INIT_LIST_HEAD(&tag->bit_hash);
 
 	return tag;
 }
 
+/*
+ * Tags hash table -- the cache keeps all device tags in hash table, so
+ * blkid_find_dev_with_tag() does not have to compare all tags of the given
+ * NAME. The table grows when number of the tags is larger than number of
+ * the buckets.
+ */
+#define TAGHASH_MINSZ	64
+
+static unsigned int taghash_value(const char *name, const char *value)
+{
+	unsigned int h = 2166136261U;		/* FNV-1a */
+	const unsigned char *p;
+
+	for (p = (const unsigned char *) name; *p; p++)
+		h = (h ^ *p) * 16777619U;
+	h = (h ^ '=') * 16777619U;
+	for (p = (const unsigned char *) value; *p; p++)
+		h = (h ^ *p) * 16777619U;
+	return h;
+}
+
+static int taghash_resize(blkid_cache cache, size_t sz)
+{
+	struct list_head *buckets;
+	size_t i;
+
+	buckets = malloc(sz * sizeof(struct list_head));
+	if (!buckets)
+		return -BLKID_ERR_MEM;
+	for (i = 0; i < sz; i++)
+		INIT_LIST_HEAD(&buckets[i]);
+
+	for (i = 0; i < cache->bic_taghashsz; i++) {
+		struct list_head *p, *pnext;
+
+		list_for_each_safe(p, pnext, &cache->bic_taghash[i]) {
+			blkid_tag t = list_entry(p, struct blkid_struct_tag, bit_hash);
+
+			list_del(&t->bit_hash);
+			list_add_tail(&t->bit_hash, &buckets[t->bit_hashval % sz]);
+		}
+	}
+
+	DBG(TAG, ul_debug("tags hash resized %zu -> %zu", cache->bic_taghashsz, sz));
+	free(cache->bic_taghash);
+	cache->bic_taghash = buckets;
+	cache->bic_taghashsz = sz;
+	return 0;
+}
+
+static void taghash_del(blkid_tag t)
+{
+	blkid_cache cache = t->bit_dev ? t->bit_dev->bid_cache : NULL;
+
+	if (list_empty(&t->bit_hash))
+		return;
+	list_del_init(&t->bit_hash);
+	if (cache)
+		cache->bic_ntaghash--;
+}
+
+static void taghash_add(blkid_cache cache, blkid_tag t)
+{
+	taghash_del(t);
+
+	if (!cache->bic_taghashsz)
+		return;
+	/* on error use the current table, it's only slower */
+	if (cache->bic_ntaghash >= cache->bic_taghashsz)
+		taghash_resize(cache, cache->bic_taghashsz * 2);
+
+	t->bit_hashval = taghash_value(t->bit_name, t->bit_val);
+	list_add_tail(&t->bit_hash,
+		      &cache->bic_taghash[t->bit_hashval % cache->bic_taghashsz]);
+	cache->bic_ntaghash++;
+}
+
+int blkid_init_taghash(blkid_cache cache)
+{
+	return taghash_resize(cache, TAGHASH_MINSZ);
+}
+
+void blkid_free_taghash(blkid_cache cache)
+{
+	free(cache->bic_taghash);
+	cache->bic_taghash = NULL;
+	cache->bic_taghashsz = 0;
+	cache->bic_ntaghash = 0;
+}
+
 void blkid_free_tag(blkid_tag tag)
 {
 	if (!tag)
@@ -40,6 +131,7 @@ void blkid_free_tag(blkid_tag tag)
 
 	list_del(&tag->bit_tags);	/* list of tags for this device */
 	list_del(&tag->bit_names);	/* list of tags with this type */
+	taghash_del(tag);		/* tags hash table */
 
 	free(tag->bit_name);
 	free(tag->bit_val);
@@ -141,6 +233,8 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 		DBG(TAG, ul_debugobj(t, "update (%s) '%s' -> '%s'", t->bit_name, t->bit_val, val));
 		free(t->bit_val);
 		t->bit_val = val;
+		if (dev->bid_cache)
+			taghash_add(dev->bid_cache, t);
 	} else {
 		/* Existing tag not present, add to device */
 		if (!(t = blkid_new_tag()))
@@ -168,6 +262,7 @@ int blkid_set_tag(blkid_dev dev, const char *name,
 					      &dev->bid_cache->bic_tags);
 			}
 			list_add_tail(&t->bit_names, &head->bit_names);
+			taghash_add(dev->bid_cache, t);
 		}
 	}
 
@@ -327,6 +422,7 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 	int		pri;
 	struct list_head *p;
 	int		probe_new = 0;
+	unsigned int	hashval;
 
 	if (!cache || !type || !value)
 		return NULL;
@@ -335,12 +431,29 @@ blkid_dev blkid_find_dev_with_tag(blkid_cache cache,
 
 	DBG(TAG, ul_debug("looking for %s=%s in cache", type, value));
 
+	/* add matching devices from binary cache */
+	blkid_bincache_find(cache, type, value);
+
+	hashval = taghash_value(type, value);
 try_again:
 	pri = -1;
 	dev = NULL;
-	head = blkid_find_head_cache(cache, type);
 
-	if (head) {
+	if (cache->bic_taghashsz) {
+		list_for_each(p, &cache->bic_taghash[hashval % cache->bic_taghashsz]) {
+			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
+						   bit_hash);
+
+			if (tmp->bit_hashval == hashval &&
+			    !strcmp(tmp->bit_name, type) &&
+			    !strcmp(tmp->bit_val, value) &&
+			    (tmp->bit_dev->bid_pri > pri) &&
+			    !access(tmp->bit_dev->bid_name, F_OK)) {
+				dev = tmp->bit_dev;
+				pri = dev->bid_pri;
+			}
+		}
+	} else if ((head = blkid_find_head_cache(cache, type))) {
 		list_for_each(p, &head->bit_names) {
 			blkid_tag tmp = list_entry(p, struct blkid_struct_tag,
 						   bit_names);
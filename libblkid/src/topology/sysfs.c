@@ -15,38 +15,105 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 
 #include "sysfs.h"
+#include "all-io.h"
 #include "topology.h"
 
 /*
  * Sysfs topology values (since 2.6.31, May 2009).
  */
-static struct topology_val {
+struct topology_val {
 
-	/* /sys/dev/block/<maj>:<min>/<ATTR> */
+	/* <ATTR> name */
 	const char *attr;
 
 	/* functions to set probing result */
 	int (*set_ulong)(blkid_probe, unsigned long);
 	int (*set_int)(blkid_probe, int);
+};
+
+/* /sys/dev/block/<maj>:<min>/<ATTR> */
+static const struct topology_val alignment_val =
+	{ "alignment_offset", NULL, blkid_topology_set_alignment_offset };
+
+/* /sys/dev/block/<maj>:<min>/queue/<ATTR>, the same for all partitions */
+static const struct topology_val queue_vals[] = {
+	{ "minimum_io_size", blkid_topology_set_minimum_io_size },
+	{ "optimal_io_size", blkid_topology_set_optimal_io_size },
+	{ "physical_block_size", blkid_topology_set_physical_sector_size },
+	{ "dax", blkid_topology_set_dax },
+};
 
-} topology_vals[] = {
-	{ "alignment_offset", NULL, blkid_topology_set_alignment_offset },
-	{ "queue/minimum_io_size", blkid_topology_set_minimum_io_size },
-	{ "queue/optimal_io_size", blkid_topology_set_optimal_io_size },
-	{ "queue/physical_block_size", blkid_topology_set_physical_sector_size },
-	{ "queue/dax", blkid_topology_set_dax },
+struct queue_data {
+	unsigned int	mask;		/* the existing attributes */
+	int64_t		vals[ARRAY_SIZE(queue_vals)];
 };
 
+/* reads number from @name file in @dirfd directory */
+static int read_attr(int dirfd, const char *name, int64_t *res)
+{
+	char buf[64];
+	ssize_t sz;
+	int fd;
+
+	fd = openat(dirfd, name, O_RDONLY|O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+
+	sz = read_all(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (sz <= 0)
+		return -EINVAL;
+	buf[sz] = '\0';
+
+	if (sscanf(buf, "%"SCNd64, res) != 1)
+		return -EINVAL;
+	return 0;
+}
+
+/* reads all queue attributes by one directory open */
+static int read_queue(struct path_cxt *pc, struct queue_data *qd)
+{
+	int dirfd, qfd;
+	size_t i;
+
+	dirfd = ul_path_get_dirfd(pc);
+	if (dirfd < 0)
+		return -1;
+	qfd = openat(dirfd, "queue", O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if (qfd < 0)
+		return -1;
+
+	qd->mask = 0;
+	for (i = 0; i < ARRAY_SIZE(queue_vals); i++) {
+		if (read_attr(qfd, queue_vals[i].attr, &qd->vals[i]) == 0)
+			qd->mask |= (1 << i);
+	}
+	close(qfd);
+
+	DBG(LOWPROBE, ul_debug("sysfs: read queue attributes [mask=0x%x]", qd->mask));
+	return 0;
+}
+
+static int set_value(blkid_probe pr, const struct topology_val *val, int64_t data)
+{
+	if (val->set_ulong)
+		return val->set_ulong(pr, (unsigned long) data);
+	return val->set_int(pr, (int) data);
+}
+
 static int probe_sysfs_tp(blkid_probe pr,
 		const struct blkid_idmag *mag __attribute__((__unused__)))
 {
-	dev_t dev;
-	int rc, set_parent = 1;
+	dev_t dev, disk;
+	int rc = 1;
 	struct path_cxt *pc;
+	struct queue_data qd = { .mask = 0 };
 	size_t i, count = 0;
+	int64_t data;
 
 	dev = blkid_probe_get_devno(pr);
 	if (!dev)
@@ -55,53 +122,38 @@ static int probe_sysfs_tp(blkid_probe pr,
 	if (!pc)
 		return 1;
 
-	rc = 1;		/* nothing (default) */
-
-	for (i = 0; i < ARRAY_SIZE(topology_vals); i++) {
-		struct topology_val *val = &topology_vals[i];
-		int ok = ul_path_access(pc, F_OK, val->attr) == 0;
-
-		rc = 1;	/* nothing */
-
-		if (!ok && set_parent) {
-			dev_t disk = blkid_probe_get_wholedisk_devno(pr);
-			set_parent = 0;
+	/* per-partition attribute */
+	if (ul_path_get_dirfd(pc) >= 0
+	    && read_attr(ul_path_get_dirfd(pc), alignment_val.attr, &data) == 0) {
+		rc = set_value(pr, &alignment_val, data);
+		if (rc < 0)
+			goto done;
+		if (rc == 0)
+			count++;
+	}
 
-			/*
-			 * Read attributes from "disk" if the current device is
-			 * a partition. Note that sysfs ul_path_* API is able
-			 * to redirect requests to attributes if parent is set.
-			 */
-			if (disk && disk != dev) {
-				struct path_cxt *parent = ul_new_sysfs_path(disk, NULL, NULL);
-				if (!parent)
-					goto done;
+	/*
+	 * Read queue attributes from "disk" if the current device is a
+	 * partition (partitions don't have the queue directory).
+	 */
+	disk = blkid_probe_get_wholedisk_devno(pr);
+	if (!disk)
+		disk = dev;
 
-				sysfs_blkdev_set_parent(pc, parent);
-				ul_unref_path(parent);
+	if (read_queue(pc, &qd) != 0 && disk != dev) {
+		struct path_cxt *parent = ul_new_sysfs_path(disk, NULL, NULL);
 
-				/* try it again */
-				ok = ul_path_access(pc, F_OK, val->attr) == 0;
-			}
+		if (parent) {
+			read_queue(parent, &qd);
+			ul_unref_path(parent);
 		}
-		if (!ok)
-			continue;	/* attribute does not exist */
-
-		if (val->set_ulong) {
-			uint64_t data;
-
-			if (ul_path_read_u64(pc, &data, val->attr) != 0)
-				continue;
-			rc = val->set_ulong(pr, (unsigned long) data);
-
-		} else if (val->set_int) {
-			int64_t data;
+	}
 
-			if (ul_path_read_s64(pc, &data, val->attr) != 0)
-				continue;
-			rc = val->set_int(pr, (int) data);
-		}
+	for (i = 0; i < ARRAY_SIZE(queue_vals); i++) {
+		if (!(qd.mask & (1 << i)))
+			continue;	/* attribute does not exist */
 
+		rc = set_value(pr, &queue_vals[i], qd.vals[i]);
 		if (rc < 0)
 			goto done;	/* error */
 		if (rc == 0)
@@ -109,10 +161,10 @@ static int probe_sysfs_tp(blkid_probe pr,
 	}
 
 done:
-	ul_unref_path(pc);		/* unref pc and parent */
+	ul_unref_path(pc);
 	if (count)
 		return 0;		/* success */
-	return rc;			/* error or nothing */
+	return rc < 0 ? rc : 1;		/* error or nothing */
 }
 
 const struct blkid_idinfo sysfs_tp_idinfo =
@@ -179,8 +179,14 @@ static int topology_probe(blkid_probe pr, struct blkid_chain *chn)
 		chn->idx = i;
 
 		if (id->probefunc) {
+			struct blkid_prstat_mark mk;
+			int rc;
+
 			DBG(LOWPROBE, ul_debug("%s: call probefunc()", id->name));
-			if (id->probefunc(pr, NULL) != 0)
+			blkid_probe_stat_start(pr, &mk);
+			rc = id->probefunc(pr, NULL);
+			blkid_probe_stat_end(pr, &mk, chn->driver->name, id->name);
+			if (rc != 0)
 				continue;
 		}
 
@@ -0,0 +1,288 @@
+/*
+ * uring.c - io_uring based reads for the probing buffers
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * The library does not depend on liburing, the ring is small and used only
+ * to submit a batch of reads planned by the read-ahead planner (see
+ * blkid_probe_enable_prefetch()) by one syscall.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/syscall.h>
+
+#include "blkidP.h"
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(SYS_io_uring_setup) \
+    && defined(SYS_io_uring_enter)
+
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#define BLKID_URING_ENTRIES	32
+
+int blkid_probe_uring_supported(void)
+{
+	return 1;
+}
+
+struct blkid_uring {
+	int			fd;
+	unsigned int		entries;
+
+	void			*sq_ptr;
+	size_t			sq_sz;
+	void			*cq_ptr;
+	size_t			cq_sz;
+	struct io_uring_sqe	*sqes;
+	size_t			sqes_sz;
+
+	unsigned int		*sq_tail;
+	unsigned int		*sq_mask;
+	unsigned int		*sq_array;
+	unsigned int		*cq_head;
+	unsigned int		*cq_tail;
+	unsigned int		*cq_mask;
+	struct io_uring_cqe	*cqes;
+};
+
+static int uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return (int) syscall(SYS_io_uring_setup, entries, p);
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete)
+{
+	return (int) syscall(SYS_io_uring_enter, fd, to_submit, min_complete,
+			     IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+void blkid_probe_free_uring(blkid_probe pr)
+{
+	struct blkid_uring *ur = pr->uring;
+
+	if (!ur)
+		return;
+	if (ur->sqes)
+		munmap(ur->sqes, ur->sqes_sz);
+	if (ur->cq_ptr && ur->cq_ptr != ur->sq_ptr)
+		munmap(ur->cq_ptr, ur->cq_sz);
+	if (ur->sq_ptr)
+		munmap(ur->sq_ptr, ur->sq_sz);
+	if (ur->fd >= 0)
+		close(ur->fd);
+	free(ur);
+	pr->uring = NULL;
+}
+
+static void *uring_mmap(int fd, size_t sz, off_t off)
+{
+	void *p = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, fd, off);
+
+	return p == MAP_FAILED ? NULL : p;
+}
+
+static struct blkid_uring *get_uring(blkid_probe pr)
+{
+	struct io_uring_params p;
+	struct blkid_uring *ur;
+
+	if (pr->uring)
+		return pr->uring;
+
+	ur = calloc(1, sizeof(*ur));
+	if (!ur)
+		return NULL;
+	pr->uring = ur;
+
+	memset(&p, 0, sizeof(p));
+	ur->fd = uring_setup(BLKID_URING_ENTRIES, &p);
+	if (ur->fd < 0) {
+		DBG(LOWPROBE, ul_debug("io_uring setup failed: %m"));
+		goto err;
+	}
+	ur->entries = p.sq_entries;
+
+	ur->sq_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ur->cq_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ur->cq_sz > ur->sq_sz)
+			ur->sq_sz = ur->cq_sz;
+		ur->sq_ptr = uring_mmap(ur->fd, ur->sq_sz, IORING_OFF_SQ_RING);
+		ur->cq_ptr = ur->sq_ptr;
+	} else {
+		ur->sq_ptr = uring_mmap(ur->fd, ur->sq_sz, IORING_OFF_SQ_RING);
+		ur->cq_ptr = uring_mmap(ur->fd, ur->cq_sz, IORING_OFF_CQ_RING);
+	}
+	if (!ur->sq_ptr || !ur->cq_ptr)
+		goto err;
+
+	ur->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ur->sqes = uring_mmap(ur->fd, ur->sqes_sz, IORING_OFF_SQES);
+	if (!ur->sqes)
+		goto err;
+
+	ur->sq_tail = (unsigned int *) ((char *) ur->sq_ptr + p.sq_off.tail);
+	ur->sq_mask = (unsigned int *) ((char *) ur->sq_ptr + p.sq_off.ring_mask);
+	ur->sq_array = (unsigned int *) ((char *) ur->sq_ptr + p.sq_off.array);
+	ur->cq_head = (unsigned int *) ((char *) ur->cq_ptr + p.cq_off.head);
+	ur->cq_tail = (unsigned int *) ((char *) ur->cq_ptr + p.cq_off.tail);
+	ur->cq_mask = (unsigned int *) ((char *) ur->cq_ptr + p.cq_off.ring_mask);
+	ur->cqes = (struct io_uring_cqe *) ((char *) ur->cq_ptr + p.cq_off.cqes);
+
+	DBG(LOWPROBE, ul_debug("io_uring ready [entries=%u]", ur->entries));
+	return ur;
+err:
+	blkid_probe_free_uring(pr);
+	return NULL;
+}
+
+/* submits @n prepared SQEs, returns number of submitted entries or -errno */
+static int uring_submit(struct blkid_uring *ur, unsigned int n, unsigned int *submitted)
+{
+	*submitted = 0;
+
+	while (*submitted < n) {
+		int rc = uring_enter(ur->fd, n - *submitted, 0);
+
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			return rc < 0 ? -errno : -EIO;
+		*submitted += rc;
+	}
+	return 0;
+}
+
+/*
+ * Reads @nbufs buffers (bf->off, bf->len and bf->data have to be set) by
+ * io_uring. The buffers which cannot be read are deallocated and set to
+ * NULL in the @bufs array.
+ *
+ * Returns 0 on success (also if some reads failed) or <0 if io_uring is not
+ * usable; the caller should use the normal read() in this case.
+ */
+int blkid_probe_uring_read(blkid_probe pr, struct blkid_bufinfo **bufs, size_t nbufs)
+{
+	struct blkid_uring *ur = get_uring(pr);
+	struct iovec *iov;
+	size_t i, done = 0;
+	int rc = 0;
+
+	if (!ur)
+		return -ENOTSUP;
+
+	iov = calloc(nbufs, sizeof(struct iovec));
+	if (!iov)
+		return -ENOMEM;
+
+	for (i = 0; i < nbufs; i++) {
+		iov[i].iov_base = bufs[i]->data;
+		iov[i].iov_len = bufs[i]->len;
+	}
+
+	while (done < nbufs && rc == 0) {
+		size_t n = nbufs - done;
+		unsigned int tail = *ur->sq_tail, submitted, got = 0;
+
+		if (n > ur->entries)
+			n = ur->entries;
+
+		for (i = done; i < done + n; i++) {
+			unsigned int idx = tail & *ur->sq_mask;
+			struct io_uring_sqe *sqe = &ur->sqes[idx];
+
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_READV;
+			sqe->fd = pr->fd;
+			sqe->off = bufs[i]->off;
+			sqe->addr = (uintptr_t) &iov[i];
+			sqe->len = 1;
+			sqe->user_data = i;
+
+			ur->sq_array[idx] = idx;
+			tail++;
+		}
+		__atomic_store_n(ur->sq_tail, tail, __ATOMIC_RELEASE);
+
+		DBG(LOWPROBE, ul_debug("io_uring: submit %zu reads", n));
+
+		rc = uring_submit(ur, n, &submitted);
+
+		/* all the submitted reads have to be reaped before the
+		 * buffers are returned or deallocated */
+		while (got < submitted) {
+			unsigned int head = *ur->cq_head;
+
+			if (head == __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE)) {
+				if (uring_enter(ur->fd, 0, submitted - got) < 0
+				    && errno != EINTR)
+					goto inflight;
+				continue;
+			}
+
+			for (; head != __atomic_load_n(ur->cq_tail, __ATOMIC_ACQUIRE); head++) {
+				struct io_uring_cqe *cqe = &ur->cqes[head & *ur->cq_mask];
+				size_t x = cqe->user_data;
+
+				if (x < nbufs && bufs[x]
+				    && (cqe->res < 0 || (uint64_t) cqe->res != bufs[x]->len)) {
+					DBG(LOWPROBE, ul_debug("\tio_uring read failed: off=%"PRIu64" [rc=%d]",
+							bufs[x]->off, cqe->res));
+					free(bufs[x]);
+					bufs[x] = NULL;
+				}
+				got++;
+			}
+			__atomic_store_n(ur->cq_head, head, __ATOMIC_RELEASE);
+		}
+		done += n;
+	}
+
+	if (rc) {
+		/* the ring is in unknown state, don't use it anymore */
+		DBG(LOWPROBE, ul_debug("io_uring submit failed [rc=%d]", rc));
+		blkid_probe_free_uring(pr);
+	}
+	free(iov);
+	return rc;
+
+inflight:
+	/* The kernel may still write to the buffers of the reads which have
+	 * not been reaped. Don't touch them, the memory is intentionally
+	 * leaked and the caller reads the data again by read(). */
+	rc = -errno;
+	DBG(LOWPROBE, ul_debug("io_uring wait failed [rc=%d]", rc));
+	for (i = 0; i < nbufs; i++)
+		bufs[i] = NULL;
+	blkid_probe_free_uring(pr);
+	return rc;
+}
+
+#else /* !HAVE_LINUX_IO_URING_H */
+
+int blkid_probe_uring_supported(void)
+{
+	return 0;
+}
+
+void blkid_probe_free_uring(blkid_probe pr __attribute__((__unused__)))
+{
+}
+
+int blkid_probe_uring_read(blkid_probe pr __attribute__((__unused__)),
+			   struct blkid_bufinfo **bufs __attribute__((__unused__)),
+			   size_t nbufs __attribute__((__unused__)))
+{
+	return -ENOTSUP;
+}
+
+#endif
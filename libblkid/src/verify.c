@@ -21,6 +21,8 @@
 #endif
 
 #include "blkidP.h"
+#include "blkdev.h"
+#include "crc32.h"
 #include "sysfs.h"
 
 static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
@@ -35,6 +37,9 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	for (n = 0; n < nvals; n++) {
 		if (blkid_probe_get_value(pr, n, &name, &data, &len) != 0)
 			continue;
+		if (strncmp(name, "SBMAGIC", 7) == 0)
+			continue;	/* used for the fingerprint only */
+
 		if (strncmp(name, "PART_ENTRY_", 11) == 0) {
 			if (strcmp(name, "PART_ENTRY_UUID") == 0)
 				blkid_set_tag(dev, "PARTUUID", data, len);
@@ -49,6 +54,195 @@ static void blkid_probe_to_tags(blkid_probe pr, blkid_dev dev)
 	}
 }
 
+/*
+ * The fingerprint is a checksum of the area from the begin of the device to
+ * the end of the sector(s) with the superblock magic (some superblocks store
+ * UUID and LABEL before the magic, for example swap), and the device size.
+ * If the magic is too far, only the magic sector(s) are used.
+ *
+ * PARTUUID and PARTLABEL are read from the whole-disk, so for partitions the
+ * fingerprint also covers the begin of the whole-disk with MBR and GPT header
+ * (the header contains checksum of the partition entries).
+ */
+#define FINGERPRINT_MAXSZ	(64 * 1024)
+#define FINGERPRINT_DISKSZ	8192
+
+static void fingerprint_area(uint64_t off, unsigned int len,
+			     uint64_t *start, size_t *size)
+{
+	uint64_t end = (off + len + 511) & ~(uint64_t) 511;
+
+	*start = end <= FINGERPRINT_MAXSZ ? 0 : off & ~(uint64_t) 511;
+	*size = end - *start;
+}
+
+static void set_dev_fingerprint(blkid_probe pr, blkid_dev dev)
+{
+	const char *off;
+	const unsigned char *buf;
+	uint64_t start;
+	size_t len, size;
+	dev_t devno, disk;
+
+	dev->bid_fp_len = 0;
+	dev->bid_fp_dlen = 0;
+
+	if (blkid_probe_lookup_value(pr, "SBMAGIC_OFFSET", &off, NULL) != 0 ||
+	    blkid_probe_lookup_value(pr, "SBMAGIC", NULL, &len) != 0 ||
+	    len == 0 || len > 512)
+		return;
+
+	errno = 0;
+	dev->bid_fp_off = strtoull(off, NULL, 10);
+	if (errno)
+		return;
+
+	fingerprint_area(dev->bid_fp_off, len, &start, &size);
+	buf = blkid_probe_get_buffer(pr, start, size);
+	if (!buf)
+		return;
+
+	devno = blkid_probe_get_devno(pr);
+	disk = blkid_probe_get_wholedisk_devno(pr);
+	if (devno && disk && devno != disk) {
+		blkid_probe disk_pr = blkid_probe_get_wholedisk_probe(pr);
+		const unsigned char *dbuf;
+
+		if (!disk_pr || blkid_probe_get_size(disk_pr) < FINGERPRINT_DISKSZ)
+			return;
+		dbuf = blkid_probe_get_buffer(disk_pr, 0, FINGERPRINT_DISKSZ);
+		if (!dbuf)
+			return;
+		dev->bid_fp_dcrc = ul_crc32(0, dbuf, FINGERPRINT_DISKSZ);
+		dev->bid_fp_dlen = FINGERPRINT_DISKSZ;
+	}
+
+	dev->bid_size = blkid_probe_get_size(pr);
+	dev->bid_fp_crc = ul_crc32(0, buf, size);
+	dev->bid_fp_len = len;
+}
+
+/* returns 1 if the area of @fd has checksum @crc */
+static int match_area_crc(int fd, uint64_t start, size_t size, uint32_t crc)
+{
+	unsigned char *buf;
+	int rc = 0;
+
+	buf = malloc(size);
+	if (!buf)
+		return 0;
+	if (pread(fd, buf, size, start) == (ssize_t) size)
+		rc = ul_crc32(0, buf, size) == crc;
+	free(buf);
+	return rc;
+}
+
+/* returns 1 if the partition tables of the whole-disk of @dev are the same */
+static int match_disk_fingerprint(blkid_dev dev)
+{
+	dev_t disk = 0;
+	char *name;
+	int fd, rc = 0;
+
+	if (blkid_devno_to_wholedisk(dev->bid_devno, NULL, 0, &disk) != 0
+	    || disk == dev->bid_devno)
+		return 0;
+	name = blkid_devno_to_devname(disk);
+	if (!name)
+		return 0;
+	fd = open(name, O_RDONLY|O_CLOEXEC|O_NONBLOCK);
+	free(name);
+	if (fd < 0)
+		return 0;
+
+	rc = match_area_crc(fd, 0, dev->bid_fp_dlen, dev->bid_fp_dcrc);
+	close(fd);
+	return rc;
+}
+
+/*
+ * Returns 1 if the device @fd still matches the fingerprint of @dev.
+ */
+static int match_dev_fingerprint(blkid_dev dev, int fd, struct stat *st)
+{
+	uint64_t start, devsize;
+	size_t size;
+
+	if (!dev->bid_fp_len)
+		return 0;
+
+	if (S_ISBLK(st->st_mode)) {
+		unsigned long long sz;
+
+		if (blkdev_get_size(fd, &sz) != 0)
+			return 0;
+		devsize = sz;
+	} else if (S_ISREG(st->st_mode))
+		devsize = st->st_size;
+	else
+		return 0;
+
+	if (devsize != dev->bid_size)
+		return 0;
+
+	fingerprint_area(dev->bid_fp_off, dev->bid_fp_len, &start, &size);
+	if (!match_area_crc(fd, start, size, dev->bid_fp_crc))
+		return 0;
+
+	return dev->bid_fp_dlen ? match_disk_fingerprint(dev) : 1;
+}
+
+static void reset_dev_tags(blkid_dev dev)
+{
+	blkid_tag_iterate iter;
+	const char *type, *value;
+
+	iter = blkid_tag_iterate_begin(dev);
+	while (blkid_tag_next(iter, &type, &value) == 0)
+		blkid_set_tag(dev, type, NULL, 0);
+	blkid_tag_iterate_end(iter);
+}
+
+/*
+ * Probe device @fd by @pr and add the result as tags to @dev. The @dev does
+ * not have to be in the cache. It's used by blkid_verify() as well as by
+ * the parallel probing worker threads.
+ *
+ * Returns: 0 on success, 1 if nothing detected, <0 on error.
+ */
+int blkid_probe_to_dev(blkid_probe pr, int fd, blkid_dev dev)
+{
+	int rc;
+
+	if (blkid_probe_set_device(pr, fd, 0, 0))
+		return -BLKID_ERR_IO;	/* failed to read the device */
+
+	/* enable superblocks probing */
+	blkid_probe_enable_superblocks(pr, TRUE);
+	blkid_probe_set_superblocks_flags(pr,
+		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
+		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE |
+		BLKID_SUBLKS_MAGIC);
+
+	/* enable partitions probing */
+	blkid_probe_enable_partitions(pr, TRUE);
+	blkid_probe_set_partitions_flags(pr, BLKID_PARTS_ENTRY_DETAILS);
+
+	/* probe */
+	rc = blkid_do_safeprobe(pr);
+	if (rc == 0) {
+		blkid_probe_to_tags(pr, dev);
+		set_dev_fingerprint(pr, dev);
+	} else if (rc > 0)
+		rc = BLKID_PROBE_NONE;
+
+	/* reset prober */
+	blkid_probe_reset_superblocks_filter(pr);
+	blkid_probe_set_device(pr, -1, 0, 0);
+
+	return rc;
+}
+
 /*
  * Verify that the data in dev is consistent with what is on the actual
  * block device (using the devname field only).  Normally this will be
@@ -62,9 +256,13 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 {
 	blkid_tag_iterate iter;
 	const char *type, *value;
+	struct blkid_presult *pres;
 	struct stat st;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	struct timeval tv;
+#endif
 	time_t diff, now;
-	int fd;
+	int fd, rc;
 
 	if (!dev || !cache)
 		return NULL;
@@ -118,6 +316,32 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		blkid_free_dev(dev);
 		return NULL;
 	}
+	/* already probed by blkid_probe_all_parallel() */
+	pres = blkid_get_presult(cache, st.st_rdev);
+	if (pres) {
+		/* remove old cache info */
+		reset_dev_tags(dev);
+
+		if (pres->rc != 0) {
+			/* found nothing or error */
+			blkid_free_dev(dev);
+			return NULL;
+		}
+
+		iter = blkid_tag_iterate_begin(pres->dev);
+		while (blkid_tag_next(iter, &type, &value) == 0)
+			blkid_set_tag(dev, type, value, strlen(value));
+		blkid_tag_iterate_end(iter);
+
+		dev->bid_size = pres->dev->bid_size;
+		dev->bid_fp_off = pres->dev->bid_fp_off;
+		dev->bid_fp_len = pres->dev->bid_fp_len;
+		dev->bid_fp_crc = pres->dev->bid_fp_crc;
+		dev->bid_fp_dlen = pres->dev->bid_fp_dlen;
+		dev->bid_fp_dcrc = pres->dev->bid_fp_dcrc;
+		goto done;
+	}
+
 	if (!cache->probe) {
 		cache->probe = blkid_new_probe();
 		if (!cache->probe) {
@@ -134,61 +358,51 @@ blkid_dev blkid_verify(blkid_cache cache, blkid_dev dev)
 		goto open_err;
 	}
 
-	if (blkid_probe_set_device(cache->probe, fd, 0, 0)) {
-		/* failed to read the device */
+	/*
+	 * The device has not been written by the device node since the last
+	 * probe, so it's enough to compare the fingerprint and skip the full
+	 * probe if nothing has been changed.
+	 */
+	if (st.st_rdev == dev->bid_devno &&
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	    (st.st_mtime < dev->bid_time ||
+	        (st.st_mtime == dev->bid_time &&
+		 st.st_mtim.tv_nsec / 1000 <= dev->bid_utime)) &&
+#else
+	    st.st_mtime <= dev->bid_time &&
+#endif
+	    match_dev_fingerprint(dev, fd, &st)) {
+		DBG(PROBE, ul_debug("%s: fingerprint matches", dev->bid_name));
 		close(fd);
-		blkid_free_dev(dev);
-		return NULL;
+		goto done;
 	}
 
 	/* remove old cache info */
-	iter = blkid_tag_iterate_begin(dev);
-	while (blkid_tag_next(iter, &type, &value) == 0)
-		blkid_set_tag(dev, type, NULL, 0);
-	blkid_tag_iterate_end(iter);
-
-	/* enable superblocks probing */
-	blkid_probe_enable_superblocks(cache->probe, TRUE);
-	blkid_probe_set_superblocks_flags(cache->probe,
-		BLKID_SUBLKS_LABEL | BLKID_SUBLKS_UUID |
-		BLKID_SUBLKS_TYPE | BLKID_SUBLKS_SECTYPE);
+	reset_dev_tags(dev);
 
-	/* enable partitions probing */
-	blkid_probe_enable_partitions(cache->probe, TRUE);
-	blkid_probe_set_partitions_flags(cache->probe, BLKID_PARTS_ENTRY_DETAILS);
+	rc = blkid_probe_to_dev(cache->probe, fd, dev);
+	close(fd);
 
-	/* probe */
-	if (blkid_do_safeprobe(cache->probe)) {
-		/* found nothing or error */
+	if (rc != 0) {
+		/* failed to read the device, found nothing or error */
 		blkid_free_dev(dev);
-		dev = NULL;
+		return NULL;
 	}
-
-	if (dev) {
+done:
 #ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
-		struct timeval tv;
-		if (!gettimeofday(&tv, NULL)) {
-			dev->bid_time = tv.tv_sec;
-			dev->bid_utime = tv.tv_usec;
-		} else
+	if (!gettimeofday(&tv, NULL)) {
+		dev->bid_time = tv.tv_sec;
+		dev->bid_utime = tv.tv_usec;
+	} else
 #endif
-			dev->bid_time = time(NULL);
+		dev->bid_time = time(NULL);
 
-		dev->bid_devno = st.st_rdev;
-		dev->bid_flags |= BLKID_BID_FL_VERIFIED;
-		cache->bic_flags |= BLKID_BIC_FL_CHANGED;
-
-		blkid_probe_to_tags(cache->probe, dev);
-
-		DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
-			   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
-	}
-
-	/* reset prober */
-	blkid_probe_reset_superblocks_filter(cache->probe);
-	blkid_probe_set_device(cache->probe, -1, 0, 0);
-	close(fd);
+	dev->bid_devno = st.st_rdev;
+	dev->bid_flags |= BLKID_BID_FL_VERIFIED;
+	cache->bic_flags |= BLKID_BIC_FL_CHANGED;
 
+	DBG(PROBE, ul_debug("%s: devno 0x%04llx, type %s",
+		   dev->bid_name, (long long)st.st_rdev, dev->bid_type));
 	return dev;
 }
 
@@ -176,6 +176,16 @@ static const struct fdisk_shortcut gpt_parttype_cuts[] =
 /*
  * in-memory fdisk GPT stuff
  */
+/*
+ * Copy of the entries array as stored on the device. It's used to write only
+ * the modified sectors of the array.
+ */
+struct gpt_ondisk_entries {
+	unsigned char	*data;		/* NULL if unknown */
+	size_t		size;		/* size of the array in bytes */
+	uint64_t	lba;		/* partition_entry_lba */
+};
+
 struct fdisk_gpt_label {
 	struct fdisk_label	head;		/* generic part */
 
@@ -185,6 +195,9 @@ struct fdisk_gpt_label {
 
 	unsigned char *ents;			/* entries (partitions) */
 
+	struct gpt_ondisk_entries pondisk;	/* primary entries on disk */
+	struct gpt_ondisk_entries bondisk;	/* backup entries on disk */
+
 	unsigned int no_relocate :1,		/* do not fix backup location */
 		     minimize :1;
 };
@@ -465,6 +478,37 @@ static inline int gpt_sizeof_entries(struct gpt_header *hdr, size_t *sz)
 	return gpt_calculate_sizeof_entries(hdr, le32_to_cpu(hdr->npartition_entries), sz);
 }
 
+static void gpt_reset_ondisk(struct gpt_ondisk_entries *od)
+{
+	free(od->data);
+	memset(od, 0, sizeof(*od));
+}
+
+/* remember @ents as the current on-disk content of the @header entries */
+static void gpt_set_ondisk(struct gpt_ondisk_entries *od,
+			   struct gpt_header *header, unsigned char *ents)
+{
+	size_t size = 0;
+
+	if (gpt_sizeof_entries(header, &size)) {
+		gpt_reset_ondisk(od);
+		return;
+	}
+	if (!od->data || od->size != size) {
+		unsigned char *data = realloc(od->data, size);
+
+		if (!data) {
+			/* not fatal, the next write will write all the array */
+			gpt_reset_ondisk(od);
+			return;
+		}
+		od->data = data;
+		od->size = size;
+	}
+	memcpy(od->data, ents, size);
+	od->lba = le64_to_cpu(header->partition_entry_lba);
+}
+
 static char *gpt_get_header_id(struct gpt_header *header)
 {
 	char str[UUID_STR_LEN];
@@ -1405,6 +1449,129 @@ static uint32_t check_start_after_end_partitions(struct fdisk_gpt_label *gpt)
 	return 0;
 }
 
+/*
+ * Areas of the used partitions sorted by start. The gdisk-like functions
+ * below are called in loops (for example for all free segments), so they use
+ * binary search in the sorted areas rather than a scan of all entries.
+ */
+struct gpt_extent {
+	uint64_t	start;
+	uint64_t	end;
+	size_t		partno;
+};
+
+struct gpt_extents {
+	struct gpt_extent	*parts;		/* used partitions sorted by start */
+	size_t			nparts;
+	struct gpt_extent	*areas;		/* merged partitions, disjoint */
+	size_t			nareas;
+
+	uint64_t		first_usable;
+	uint64_t		last_usable;
+};
+
+static int cmp_extents(const void *a0, const void *b0)
+{
+	const struct gpt_extent *a = a0, *b = b0;
+
+	if (a->start != b->start)
+		return a->start < b->start ? -1 : 1;
+	return a->partno < b->partno ? -1 : a->partno > b->partno ? 1 : 0;
+}
+
+static void free_extents(struct gpt_extents *ex)
+{
+	free(ex->parts);
+	free(ex->areas);
+	memset(ex, 0, sizeof(*ex));
+}
+
+static int init_extents(struct fdisk_gpt_label *gpt, struct gpt_extents *ex)
+{
+	size_t i, nents;
+
+	assert(gpt);
+	assert(gpt->pheader);
+	assert(gpt->ents);
+
+	memset(ex, 0, sizeof(*ex));
+	ex->first_usable = le64_to_cpu(gpt->pheader->first_usable_lba);
+	ex->last_usable = le64_to_cpu(gpt->pheader->last_usable_lba);
+
+	nents = gpt_get_nentries(gpt);
+	if (!nents)
+		return 0;
+
+	ex->parts = malloc(nents * sizeof(struct gpt_extent));
+	ex->areas = malloc(nents * sizeof(struct gpt_extent));
+	if (!ex->parts || !ex->areas) {
+		free_extents(ex);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nents; i++) {
+		struct gpt_entry *e = gpt_get_entry(gpt, i);
+		struct gpt_extent *x;
+
+		if (!gpt_entry_is_used(e))
+			continue;
+		x = &ex->parts[ex->nparts++];
+		x->start = gpt_partition_start(e);
+		x->end = gpt_partition_end(e);
+		x->partno = i;
+	}
+
+	qsort(ex->parts, ex->nparts, sizeof(struct gpt_extent), cmp_extents);
+
+	for (i = 0; i < ex->nparts; i++) {
+		struct gpt_extent *x = &ex->parts[i];
+		struct gpt_extent *last = ex->nareas ? &ex->areas[ex->nareas - 1] : NULL;
+
+		if (x->start > x->end)
+			continue;	/* does not cover anything */
+
+		/* merge also adjacent areas, the gaps are free space */
+		if (last && (last->end == UINT64_MAX || x->start <= last->end + 1)) {
+			if (x->end > last->end)
+				last->end = x->end;
+		} else
+			ex->areas[ex->nareas++] = *x;
+	}
+
+	DBG(GPT, ul_debug("extents: %zu partitions in %zu areas",
+				ex->nparts, ex->nareas));
+	return 0;
+}
+
+/* returns the first extent with start greater than @lba or NULL */
+static const struct gpt_extent *extent_after(const struct gpt_extent *xs,
+					     size_t nxs, uint64_t lba)
+{
+	size_t lo = 0, hi = nxs;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (xs[mid].start <= lba)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < nxs ? &xs[lo] : NULL;
+}
+
+/* returns area which contains @lba or NULL */
+static const struct gpt_extent *area_of(const struct gpt_extents *ex, uint64_t lba)
+{
+	const struct gpt_extent *x = extent_after(ex->areas, ex->nareas, lba);
+	size_t idx = x ? (size_t) (x - ex->areas) : ex->nareas;
+
+	if (idx == 0)
+		return NULL;
+	x = &ex->areas[idx - 1];
+	return lba <= x->end ? x : NULL;
+}
+
 /*
  * Check if partition e1 overlaps with partition e2.
  */
@@ -1418,17 +1585,70 @@ static inline int partition_overlap(struct gpt_entry *e1, struct gpt_entry *e2)
 	return (start1 && start2 && (start1 <= end2) != (end1 < start2));
 }
 
+/* returns 1 if any of the partitions with partno < @n overlap */
+static int extents_overlap(const struct gpt_extents *ex, size_t n)
+{
+	uint64_t maxend = 0;
+	size_t i;
+	int any = 0;
+
+	for (i = 0; i < ex->nparts; i++) {
+		const struct gpt_extent *x = &ex->parts[i];
+
+		if (x->partno >= n || !x->start)
+			continue;
+		if (any && x->start <= maxend)
+			return 1;
+		if (!any || x->end > maxend)
+			maxend = x->end;
+		any = 1;
+	}
+	return 0;
+}
+
 /*
- * Find any partitions that overlap.
+ * Find any partitions that overlap. Returns number of the first partition
+ * which overlaps with any of the previous partitions.
  */
 static uint32_t check_overlap_partitions(struct fdisk_gpt_label *gpt)
 {
-	size_t i, j;
+	struct gpt_extents ex;
+	size_t i, j, lo, hi;
 
 	assert(gpt);
 	assert(gpt->pheader);
 	assert(gpt->ents);
 
+	if (init_extents(gpt, &ex) != 0)
+		goto slow;
+	for (i = 0; i < ex.nparts; i++) {
+		/* partition_overlap() is not an interval check for such entries */
+		if (ex.parts[i].start > ex.parts[i].end) {
+			free_extents(&ex);
+			goto slow;
+		}
+	}
+
+	/* the smallest number of entries with overlapping partitions */
+	lo = 2;
+	hi = gpt_get_nentries(gpt);
+	if (hi < lo || !extents_overlap(&ex, hi)) {
+		free_extents(&ex);
+		return 0;
+	}
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (extents_overlap(&ex, mid))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	free_extents(&ex);
+
+	DBG(GPT, ul_debug("partitions overlap detected [%zu]", lo - 1));
+	return lo;
+slow:
 	for (i = 0; i < gpt_get_nentries(gpt); i++)
 		for (j = 0; j < i; j++) {
 			struct gpt_entry *ei = gpt_get_entry(gpt, i);
@@ -1449,51 +1669,27 @@ static uint32_t check_overlap_partitions(struct fdisk_gpt_label *gpt)
  * Find the first available block after the starting point; returns 0 if
  * there are no available blocks left, or error. From gdisk.
  */
-static uint64_t find_first_available(struct fdisk_gpt_label *gpt, uint64_t start)
+static uint64_t find_first_available(const struct gpt_extents *ex, uint64_t start)
 {
-	int first_moved = 0;
+	const struct gpt_extent *x;
 	uint64_t first;
-	uint64_t fu, lu;
-
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
-
-	fu = le64_to_cpu(gpt->pheader->first_usable_lba);
-	lu = le64_to_cpu(gpt->pheader->last_usable_lba);
 
 	/*
 	 * Begin from the specified starting point or from the first usable
 	 * LBA, whichever is greater...
 	 */
-	first = start < fu ? fu : start;
+	first = start < ex->first_usable ? ex->first_usable : start;
 
 	/*
-	 * Now search through all partitions; if first is within an
-	 * existing partition, move it to the next sector after that
-	 * partition and repeat. If first was moved, set firstMoved
-	 * flag; repeat until firstMoved is not set, so as to catch
-	 * cases where partitions are out of sequential order....
+	 * ...and if first is within an existing partition, move it to the next
+	 * sector after the partition. The areas are merged, so the sector is
+	 * not within any other partition.
 	 */
-	do {
-		size_t i;
-
-		first_moved = 0;
-		for (i = 0; i < gpt_get_nentries(gpt); i++) {
-			struct gpt_entry *e = gpt_get_entry(gpt, i);
-
-			if (!gpt_entry_is_used(e))
-				continue;
-			if (first < gpt_partition_start(e))
-				continue;
-			if (first <= gpt_partition_end(e)) {
-				first = gpt_partition_end(e) + 1;
-				first_moved = 1;
-			}
-		}
-	} while (first_moved == 1);
+	x = area_of(ex, first);
+	if (x)
+		first = x->end + 1;
 
-	if (first > lu)
+	if (first > ex->last_usable)
 		first = 0;
 
 	return first;
@@ -1501,85 +1697,84 @@ static uint64_t find_first_available(struct fdisk_gpt_label *gpt, uint64_t start
 
 
 /* Returns last available sector in the free space pointed to by start. From gdisk. */
-static uint64_t find_last_free(struct fdisk_gpt_label *gpt, uint64_t start)
+static uint64_t find_last_free(const struct gpt_extents *ex, uint64_t start)
 {
-	size_t i;
-	uint64_t nearest_start;
-
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	const struct gpt_extent *x;
+	uint64_t nearest_start = ex->last_usable;
 
-	nearest_start = le64_to_cpu(gpt->pheader->last_usable_lba);
-
-	for (i = 0; i < gpt_get_nentries(gpt); i++) {
-		struct gpt_entry *e = gpt_get_entry(gpt, i);
-		uint64_t ps = gpt_partition_start(e);
-
-		if (nearest_start > ps && ps > start)
-			nearest_start = ps - 1ULL;
-	}
+	x = extent_after(ex->parts, ex->nparts, start);
+	if (x && nearest_start > x->start)
+		nearest_start = x->start - 1ULL;
 
 	return nearest_start;
 }
 
 /* Returns the last free sector on the disk. From gdisk. */
-static uint64_t find_last_free_sector(struct fdisk_gpt_label *gpt)
+static uint64_t find_last_free_sector(const struct gpt_extents *ex)
 {
-	int last_moved;
-	uint64_t last = 0;
-
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	const struct gpt_extent *x;
 
 	/* start by assuming the last usable LBA is available */
-	last = le64_to_cpu(gpt->pheader->last_usable_lba);
-	do {
-		size_t i;
-
-		last_moved = 0;
-		for (i = 0; i < gpt_get_nentries(gpt); i++) {
-			struct gpt_entry *e = gpt_get_entry(gpt, i);
-
-			if (last >= gpt_partition_start(e) &&
-			    last <= gpt_partition_end(e)) {
-				last = gpt_partition_start(e) - 1ULL;
-				last_moved = 1;
-			}
-		}
-	} while (last_moved == 1);
+	uint64_t last = ex->last_usable;
+
+	x = area_of(ex, last);
+	if (x)
+		last = x->start - 1ULL;
 
 	return last;
 }
 
+/*
+ * Walks the free segments in disk order, the same as find_first_available()
+ * and find_last_free() in a loop, but without searching. The @idx and @start
+ * have to be zero for the first call. Returns 0 if there is no more segment.
+ */
+static int next_free_segment(const struct gpt_extents *ex, size_t *idx,
+			     uint64_t *start, uint64_t *first, uint64_t *last)
+{
+	uint64_t x = *start < ex->first_usable ? ex->first_usable : *start;
+
+	for (; *idx < ex->nareas; (*idx)++) {
+		const struct gpt_extent *a = &ex->areas[*idx];
+
+		if (a->end < x)
+			continue;
+		if (a->start > x)
+			break;
+		if (a->end == UINT64_MAX)
+			return 0;
+		x = a->end + 1;
+	}
+	if (x > ex->last_usable)
+		return 0;
+
+	*first = x;
+	*last = ex->last_usable;
+	if (*idx < ex->nareas && *last > ex->areas[*idx].start)
+		*last = ex->areas[*idx].start - 1ULL;
+	*start = *last + 1ULL;
+	return 1;
+}
+
 /*
  * Finds the first available sector in the largest block of unallocated
  * space on the disk. Returns 0 if there are no available blocks left.
  * From gdisk.
  */
-static uint64_t find_first_in_largest(struct fdisk_gpt_label *gpt)
+static uint64_t find_first_in_largest(const struct gpt_extents *ex)
 {
 	uint64_t start = 0, first_sect, last_sect;
 	uint64_t segment_size, selected_size = 0, selected_segment = 0;
+	size_t idx = 0;
 
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	while (next_free_segment(ex, &idx, &start, &first_sect, &last_sect)) {
+		segment_size = last_sect - first_sect + 1ULL;
 
-	do {
-		first_sect = find_first_available(gpt, start);
-		if (first_sect != 0) {
-			last_sect = find_last_free(gpt, first_sect);
-			segment_size = last_sect - first_sect + 1ULL;
-
-			if (segment_size > selected_size) {
-				selected_size = segment_size;
-				selected_segment = first_sect;
-			}
-			start = last_sect + 1ULL;
+		if (segment_size > selected_size) {
+			selected_size = segment_size;
+			selected_segment = first_sect;
 		}
-	} while (first_sect != 0);
+	}
 
 	return selected_segment;
 }
@@ -1589,7 +1784,7 @@ static uint64_t find_first_in_largest(struct fdisk_gpt_label *gpt)
  * they reside, and the size of the largest of those segments. From gdisk.
  */
 static uint64_t get_free_sectors(struct fdisk_context *cxt,
-				 struct fdisk_gpt_label *gpt,
+				 const struct gpt_extents *ex,
 				 uint32_t *nsegments,
 				 uint64_t *largest_segment)
 {
@@ -1597,27 +1792,19 @@ static uint64_t get_free_sectors(struct fdisk_context *cxt,
 	uint64_t first_sect, last_sect;
 	uint64_t largest_seg = 0, segment_sz;
 	uint64_t totfound = 0, start = 0; /* starting point for each search */
+	size_t idx = 0;
 
 	if (!cxt->total_sectors)
 		goto done;
 
-	assert(gpt);
-	assert(gpt->pheader);
-	assert(gpt->ents);
+	while (next_free_segment(ex, &idx, &start, &first_sect, &last_sect)) {
+		segment_sz = last_sect - first_sect + 1;
 
-	do {
-		first_sect = find_first_available(gpt, start);
-		if (first_sect) {
-			last_sect = find_last_free(gpt, first_sect);
-			segment_sz = last_sect - first_sect + 1;
-
-			if (segment_sz > largest_seg)
-				largest_seg = segment_sz;
-			totfound += segment_sz;
-			num++;
-			start = last_sect + 1ULL;
-		}
-	} while (first_sect);
+		if (segment_sz > largest_seg)
+			largest_seg = segment_sz;
+		totfound += segment_sz;
+		num++;
+	}
 
 done:
 	if (nsegments)
@@ -1649,18 +1836,28 @@ static int gpt_probe_label(struct fdisk_context *cxt)
 	gpt->pheader = gpt_read_header(cxt, GPT_PRIMARY_PARTITION_TABLE_LBA,
 				       &gpt->ents);
 
-	if (gpt->pheader)
+	if (gpt->pheader) {
+		unsigned char *bents = NULL;
+
 		/* primary OK, try backup from alternative LBA */
 		gpt->bheader = gpt_read_header(cxt,
 					le64_to_cpu(gpt->pheader->alternative_lba),
-					NULL);
-	else
+					&bents);
+		if (gpt->bheader)
+			gpt_set_ondisk(&gpt->bondisk, gpt->bheader, bents);
+		free(bents);
+	} else
 		/* primary corrupted -- try last LBA */
 		gpt->bheader = gpt_read_header(cxt, last_lba(cxt), &gpt->ents);
 
 	if (!gpt->pheader && !gpt->bheader)
 		goto failed;
 
+	if (gpt->pheader)
+		gpt_set_ondisk(&gpt->pondisk, gpt->pheader, gpt->ents);
+	else
+		gpt_set_ondisk(&gpt->bondisk, gpt->bheader, gpt->ents);
+
 	/* primary OK, backup corrupted -- recovery */
 	if (gpt->pheader && !gpt->bheader) {
 		fdisk_warnx(cxt, _("The backup GPT table is corrupt, but the "
@@ -2031,22 +2228,52 @@ static int gpt_write(struct fdisk_context *cxt, off_t offset, void *buf, size_t
 }
 
 /*
- * Write partitions.
+ * Write partitions. If the on-disk content of the array is known (@od), then
+ * only the range of the modified sectors is written.
+ *
  * Returns 0 on success, or corresponding error otherwise.
  */
 static int gpt_write_partitions(struct fdisk_context *cxt,
-				struct gpt_header *header, unsigned char *ents)
+				struct gpt_header *header, unsigned char *ents,
+				struct gpt_ondisk_entries *od)
 {
-	size_t esz = 0;
+	size_t esz = 0, begin = 0, end;
+	uint64_t lba;
 	int rc;
 
 	rc = gpt_sizeof_entries(header, &esz);
 	if (rc)
 		return rc;
 
-	return gpt_write(cxt,
-			(off_t) le64_to_cpu(header->partition_entry_lba) * cxt->sector_size,
-			ents, esz);
+	lba = le64_to_cpu(header->partition_entry_lba);
+	end = esz;
+
+	if (od->data && od->size == esz && od->lba == lba) {
+		size_t ssz = cxt->sector_size;
+
+		/* the first and the last modified sector */
+		while (begin < esz
+		       && memcmp(ents + begin, od->data + begin,
+				 min(ssz, esz - begin)) == 0)
+			begin += ssz;
+		if (begin >= esz) {
+			DBG(GPT, ul_debug("  entries on LBA %"PRIu64" unchanged", lba));
+			return 0;
+		}
+		while (end > begin) {
+			size_t last = (end - 1) / ssz * ssz;
+
+			if (memcmp(ents + last, od->data + last, end - last) != 0)
+				break;
+			end = last;
+		}
+	}
+
+	rc = gpt_write(cxt, (off_t) lba * cxt->sector_size + begin,
+			ents + begin, end - begin);
+	if (rc == 0)
+		gpt_set_ondisk(od, header, ents);
+	return rc;
 }
 
 /*
@@ -2150,12 +2377,12 @@ static int gpt_write_disklabel(struct fdisk_context *cxt)
 	 *
 	 * If any write fails, we abort the rest.
 	 */
-	if (gpt_write_partitions(cxt, gpt->bheader, gpt->ents) != 0)
+	if (gpt_write_partitions(cxt, gpt->bheader, gpt->ents, &gpt->bondisk) != 0)
 		goto err1;
 	if (gpt_write_header(cxt, gpt->bheader,
 			     le64_to_cpu(gpt->pheader->alternative_lba)) != 0)
 		goto err1;
-	if (gpt_write_partitions(cxt, gpt->pheader, gpt->ents) != 0)
+	if (gpt_write_partitions(cxt, gpt->pheader, gpt->ents, &gpt->pondisk) != 0)
 		goto err1;
 	if (gpt_write_header(cxt, gpt->pheader, GPT_PRIMARY_PARTITION_TABLE_LBA) != 0)
 		goto err1;
@@ -2271,6 +2498,7 @@ static int gpt_verify_disklabel(struct fdisk_context *cxt)
 	if (!nerror) { /* yay :-) */
 		uint32_t nsegments = 0;
 		uint64_t free_sectors = 0, largest_segment = 0;
+		struct gpt_extents ex;
 		char *strsz = NULL;
 
 		fdisk_info(cxt, _("No errors detected."));
@@ -2279,7 +2507,10 @@ static int gpt_verify_disklabel(struct fdisk_context *cxt)
 		       partitions_in_use(gpt),
 		       gpt_get_nentries(gpt));
 
-		free_sectors = get_free_sectors(cxt, gpt, &nsegments, &largest_segment);
+		if (init_extents(gpt, &ex) == 0) {
+			free_sectors = get_free_sectors(cxt, &ex, &nsegments, &largest_segment);
+			free_extents(&ex);
+		}
 		if (largest_segment)
 			strsz = size_to_human_string(SIZE_SUFFIX_SPACE | SIZE_SUFFIX_3LETTER,
 					largest_segment * cxt->sector_size);
@@ -2343,6 +2574,7 @@ static int gpt_add_partition(
 	struct gpt_header *pheader;
 	struct gpt_entry *e;
 	struct fdisk_ask *ask = NULL;
+	struct gpt_extents ex = { .parts = NULL };
 	size_t partnum;
 	int rc;
 
@@ -2375,18 +2607,23 @@ static int gpt_add_partition(
 		fdisk_warnx(cxt, _("All partitions are already in use."));
 		return -ENOSPC;
 	}
-	if (!get_free_sectors(cxt, gpt, NULL, NULL)) {
+
+	rc = init_extents(gpt, &ex);
+	if (rc)
+		return rc;
+	if (!cxt->total_sectors || !find_first_available(&ex, 0)) {
 		fdisk_warnx(cxt, _("No free sectors available."));
-		return -ENOSPC;
+		rc = -ENOSPC;
+		goto done;
 	}
 
 	rc = string_to_guid(pa && pa->type && pa->type->typestr ?
 				pa->type->typestr:
 				GPT_DEFAULT_ENTRY_TYPE, &typeid);
 	if (rc)
-		return rc;
+		goto done;
 
-	disk_f = find_first_available(gpt, le64_to_cpu(pheader->first_usable_lba));
+	disk_f = find_first_available(&ex, le64_to_cpu(pheader->first_usable_lba));
 	e = gpt_get_entry(gpt, 0);
 
 	/* if first sector no explicitly defined then ignore small gaps before
@@ -2398,10 +2635,10 @@ static int gpt_add_partition(
 		do {
 			uint64_t x;
 			DBG(GPT, ul_debug("testing first sector %"PRIu64"", disk_f));
-			disk_f = find_first_available(gpt, disk_f);
+			disk_f = find_first_available(&ex, disk_f);
 			if (!disk_f)
 				break;
-			x = find_last_free(gpt, disk_f);
+			x = find_last_free(&ex, disk_f);
 			if (x - disk_f >= cxt->grain / cxt->sector_size)
 				break;
 			DBG(GPT, ul_debug("first sector %"PRIu64" addresses to small space, continue...", disk_f));
@@ -2409,15 +2646,15 @@ static int gpt_add_partition(
 		} while(1);
 
 		if (disk_f == 0)
-			disk_f = find_first_available(gpt, le64_to_cpu(pheader->first_usable_lba));
+			disk_f = find_first_available(&ex, le64_to_cpu(pheader->first_usable_lba));
 	}
 
 	e = NULL;
-	disk_l = find_last_free_sector(gpt);
+	disk_l = find_last_free_sector(&ex);
 
 	/* the default is the largest free space */
-	dflt_f = find_first_in_largest(gpt);
-	dflt_l = find_last_free(gpt, dflt_f);
+	dflt_f = find_first_in_largest(&ex);
+	dflt_l = find_last_free(&ex, dflt_f);
 
 	/* align the default in range <dflt_f,dflt_l>*/
 	dflt_f = fdisk_align_lba_in_range(cxt, dflt_f, dflt_f, dflt_l);
@@ -2428,9 +2665,10 @@ static int gpt_add_partition(
 
 	} else if (pa && fdisk_partition_has_start(pa)) {
 		DBG(GPT, ul_debug("first sector defined: %ju",  (uintmax_t)pa->start));
-		if (pa->start != find_first_available(gpt, pa->start)) {
+		if (pa->start != find_first_available(&ex, pa->start)) {
 			fdisk_warnx(cxt, _("Sector %ju already used."),  (uintmax_t)pa->start);
-			return -ERANGE;
+			rc = -ERANGE;
+			goto done;
 		}
 		user_f = pa->start;
 	} else {
@@ -2440,8 +2678,10 @@ static int gpt_add_partition(
 				ask = fdisk_new_ask();
 			else
 				fdisk_reset_ask(ask);
-			if (!ask)
-				return -ENOMEM;
+			if (!ask) {
+				rc = -ENOMEM;
+				goto done;
+			}
 
 			/* First sector */
 			fdisk_ask_set_query(ask, _("First sector"));
@@ -2455,7 +2695,7 @@ static int gpt_add_partition(
 				goto done;
 
 			user_f = fdisk_ask_number_get_result(ask);
-			if (user_f != find_first_available(gpt, user_f)) {
+			if (user_f != find_first_available(&ex, user_f)) {
 				fdisk_warnx(cxt, _("Sector %ju already used."), user_f);
 				continue;
 			}
@@ -2465,7 +2705,7 @@ static int gpt_add_partition(
 
 
 	/* Last sector */
-	dflt_l = find_last_free(gpt, user_f);
+	dflt_l = find_last_free(&ex, user_f);
 
 	if (pa && pa->end_follow_default) {
 		user_l = dflt_l;
@@ -2490,8 +2730,10 @@ static int gpt_add_partition(
 				ask = fdisk_new_ask();
 			else
 				fdisk_reset_ask(ask);
-			if (!ask)
-				return -ENOMEM;
+			if (!ask) {
+				rc = -ENOMEM;
+				goto done;
+			}
 
 			fdisk_ask_set_query(ask, _("Last sector, +/-sectors or +/-size{K,M,G,T,P}"));
 			fdisk_ask_set_type(ask, FDISK_ASKTYPE_OFFSET);
@@ -2601,6 +2843,7 @@ static int gpt_add_partition(
 	if (partno)
 		*partno = partnum;
 done:
+	free_extents(&ex);
 	fdisk_unref_ask(ask);
 	return rc;
 }
@@ -3152,6 +3395,8 @@ static void gpt_deinit(struct fdisk_label *lb)
 	free(gpt->ents);
 	free(gpt->pheader);
 	free(gpt->bheader);
+	gpt_reset_ondisk(&gpt->pondisk);
+	gpt_reset_ondisk(&gpt->bondisk);
 
 	gpt->ents = NULL;
 	gpt->pheader = NULL;
@@ -1,5 +1,7 @@
 #include "c.h"
 #include "strutils.h"
+#include "blkdev.h"
+#include "all-io.h"
 
 #ifdef HAVE_LIBBLKID
 # include <blkid.h>
@@ -103,11 +105,94 @@ int fdisk_do_wipe(struct fdisk_context *cxt __attribute__((__unused__)))
 	return 0;
 }
 #else
+/* signature area to zeroize, in bytes */
+struct wipe_range {
+	uint64_t	offset;
+	uint64_t	len;
+};
+
+static int cmp_wipe_ranges(const void *a0, const void *b0)
+{
+	const struct wipe_range *a = a0, *b = b0;
+
+	return a->offset < b->offset ? -1 : a->offset > b->offset ? 1 : 0;
+}
+
+/* adds magic string of the current probing result to @ranges */
+static int add_wipe_range(blkid_probe pr, uint64_t start,
+			  struct wipe_range **ranges, size_t *nranges)
+{
+	const char *off = NULL;
+	size_t len = 0;
+	struct wipe_range *r;
+
+	if (blkid_probe_lookup_value(pr, "SBMAGIC_OFFSET", &off, NULL) == 0)
+		blkid_probe_lookup_value(pr, "SBMAGIC", NULL, &len);
+	else if (blkid_probe_lookup_value(pr, "PTMAGIC_OFFSET", &off, NULL) == 0)
+		blkid_probe_lookup_value(pr, "PTMAGIC", NULL, &len);
+	if (!off || !len)
+		return 0;
+
+	r = realloc(*ranges, (*nranges + 1) * sizeof(struct wipe_range));
+	if (!r)
+		return -ENOMEM;
+	*ranges = r;
+
+	r = &r[(*nranges)++];
+	errno = 0;
+	r->offset = start + strtoumax(off, NULL, 10);
+	r->len = len;
+	return errno ? -errno : 0;
+}
+
+/* zeroizes all @ranges by one pass over the device */
+static int write_wipe_ranges(struct fdisk_context *cxt,
+			     struct wipe_range *ranges, size_t nranges)
+{
+	char buf[BUFSIZ] = { 0 };
+	size_t i;
+
+	qsort(ranges, nranges, sizeof(struct wipe_range), cmp_wipe_ranges);
+
+	for (i = 0; i < nranges; ) {
+		uint64_t off = ranges[i].offset;
+		uint64_t end = off + ranges[i].len;
+
+		/* merge overlapping and adjacent ranges */
+		for (i++; i < nranges && ranges[i].offset <= end; i++)
+			end = max(end, ranges[i].offset + ranges[i].len);
+
+		DBG(CXT, ul_debugobj(cxt, "wipe [offset=%ju, len=%ju]",
+					(uintmax_t) off, (uintmax_t) (end - off)));
+		while (off < end) {
+			size_t sz = min(end - off, (uint64_t) sizeof(buf));
+
+			if (lseek(cxt->dev_fd, off, SEEK_SET) == (off_t) -1
+			    || write_all(cxt->dev_fd, buf, sz))
+				return -errno;
+			off += sz;
+		}
+	}
+
+	if (nranges)
+		fsync(cxt->dev_fd);
+	return 0;
+}
+
+/*
+ * All the areas are probed first (the signatures are wiped only in the
+ * prober buffers), and then all the detected signatures are zeroized on the
+ * device by one batch of writes and one fsync(). It's not possible for zoned
+ * devices where sequential zones have to be reset by libblkid.
+ */
 int fdisk_do_wipe(struct fdisk_context *cxt)
 {
 	struct list_head *p;
+	struct blk_zone_report *zones;
+	struct wipe_range *ranges = NULL;
+	size_t nranges = 0;
 	blkid_probe pr;
-	int rc;
+	int rc = 0, zoned;
 
 	assert(cxt);
 	assert(cxt->dev_fd >= 0);
@@ -115,6 +200,10 @@ int fdisk_do_wipe(struct fdisk_context *cxt)
 	if (list_empty(&cxt->wipes))
 		return 0;
 
+	zones = blkdev_get_zonereport(cxt->dev_fd, 0, 1);
+	zoned = zones != NULL;
+	free(zones);
+
 	pr = blkid_new_probe();
 	if (!pr)
 		return -ENOMEM;
@@ -130,7 +219,7 @@ int fdisk_do_wipe(struct fdisk_context *cxt)
 		rc = blkid_probe_set_device(pr, cxt->dev_fd, start, size);
 		if (rc) {
 			DBG(WIPE, ul_debugobj(wp, "blkid_probe_set_device() failed [rc=%d]", rc));
-			return rc;
+			goto done;
 		}
 
 		blkid_probe_enable_superblocks(pr, 1);
@@ -139,13 +228,24 @@ int fdisk_do_wipe(struct fdisk_context *cxt)
 		blkid_probe_set_partitions_flags(pr, BLKID_PARTS_MAGIC);
 
 		while (blkid_do_probe(pr) == 0) {
-			DBG(WIPE, ul_debugobj(wp, " wiping..."));
-			blkid_do_wipe(pr, FALSE);
+			if (zoned) {
+				DBG(WIPE, ul_debugobj(wp, " wiping..."));
+				blkid_do_wipe(pr, FALSE);
+				continue;
+			}
+			DBG(WIPE, ul_debugobj(wp, " wiping (in memory)..."));
+			rc = add_wipe_range(pr, start, &ranges, &nranges);
+			if (rc)
+				goto done;
+			blkid_do_wipe(pr, TRUE);
 		}
 	}
 
+	rc = write_wipe_ranges(cxt, ranges, nranges);
+done:
+	free(ranges);
 	blkid_free_probe(pr);
-	return 0;
+	return rc;
 }
 #endif
 
@@ -0,0 +1,372 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * This file is part of libmount from util-linux project.
+ *
+ * libmount is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ *
+ * Benchmarks for the hot paths: table parsing, mnt_diff_tables(), lookups
+ * and monitor events. The tables are synthetic, generated to temporary files
+ * with the requested number of entries (e.g. 1000 .. 200000).
+ *
+ * The results are printed in milliseconds (or microseconds per operation)
+ * and they are not checked, it's not a regression test. Compare the output
+ * before and after a change.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef TEST_PROGRAM
+#define TEST_PROGRAM
+#endif
+
+#include "mountP.h"
+#include "monotonic.h"
+#include "strutils.h"
+
+#define BENCH_DEFAULT_NENTS	10000
+
+static double bench_now(void)
+{
+	struct timeval tv;
+
+	gettime_monotonic(&tv);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static size_t bench_get_nents(int argc, char *argv[])
+{
+	if (argc >= 2)
+		return strtou32_or_err(argv[1], "failed to parse number of entries");
+	return BENCH_DEFAULT_NENTS;
+}
+
+/*
+ * Writes @n mountinfo entries; the entries with the index divisible by
+ * @step are omitted (umounted) or remounted (every second of them) and
+ * @nnew new entries are appended, used to generate a changed table for the
+ * diff benchmark.
+ */
+static void gen_mountinfo(FILE *f, size_t n, size_t step, size_t nnew)
+{
+	size_t i;
+
+	fprintf(f, "1 0 8:1 / / rw,relatime shared:1 - ext4 /dev/sda1 rw\n");
+	for (i = 2; i < n + 1 + nnew; i++) {
+		int remount = 0;
+
+		if (step && i < n + 1 && i % step == 0) {
+			if ((i / step) % 2)
+				continue;
+			remount = 1;
+		}
+		fprintf(f, "%zu 1 0:%zu / /mnt/bench/%zu %s,nosuid,nodev,relatime "
+			   "shared:%zu - tmpfs tmpfs%zu rw,size=1024k,mode=755\n",
+			   i, (i % 4096) + 32, i, remount ? "ro" : "rw", i, i);
+	}
+}
+
+static void gen_fstab(FILE *f, size_t n)
+{
+	size_t i;
+
+	for (i = 1; i < n + 1; i++) {
+		if (i % 3 == 0)
+			fprintf(f, "UUID=%08zx-0000-0000-0000-000000000000 /srv/%zu ext4 "
+				   "defaults,noatime 0 2\n", i, i);
+		else
+			fprintf(f, "/dev/disk/bench%zu /srv/%zu xfs defaults,nofail 0 0\n",
+				   i, i);
+	}
+}
+
+static void gen_utab(FILE *f, size_t n)
+{
+	size_t i;
+
+	for (i = 1; i < n + 1; i++)
+		fprintf(f, "SRC=/dev/loop%zu TARGET=/mnt/bench/%zu ROOT=/ "
+			   "OPTS=x-bench=%zu,user=root\n", i, i, i);
+}
+
+static struct libmnt_table *bench_parse(FILE *f, int fmt, const char *name,
+					double *ms)
+{
+	struct libmnt_table *tb;
+	double start;
+
+	rewind(f);
+	tb = mnt_new_table();
+	if (!tb)
+		return NULL;
+	tb->fmt = fmt;
+
+	start = bench_now();
+	if (mnt_table_parse_stream(tb, f, name) != 0) {
+		mnt_unref_table(tb);
+		return NULL;
+	}
+	*ms = bench_now() - start;
+	return tb;
+}
+
+static FILE *bench_tmpfile(void (*gen)(FILE *, size_t), size_t n)
+{
+	FILE *f = tmpfile();
+
+	if (!f)
+		return NULL;
+	gen(f, n);
+	fflush(f);
+	return f;
+}
+
+static void gen_mountinfo_simple(FILE *f, size_t n)
+{
+	gen_mountinfo(f, n, 0, 0);
+}
+
+static int test_bench_parse(struct libmnt_test *ts __attribute__((unused)),
+			    int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		int fmt;
+		void (*gen)(FILE *, size_t);
+	} files[] = {
+		{ "mountinfo", MNT_FMT_MOUNTINFO, gen_mountinfo_simple },
+		{ "fstab",     MNT_FMT_FSTAB,     gen_fstab },
+		{ "utab",      MNT_FMT_UTAB,      gen_utab }
+	};
+	size_t i, n = bench_get_nents(argc, argv);
+
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		struct libmnt_table *tb;
+		double ms = 0;
+		FILE *f;
+
+		f = bench_tmpfile(files[i].gen, n);
+		if (!f)
+			return -errno;
+		tb = bench_parse(f, files[i].fmt, files[i].name, &ms);
+		fclose(f);
+		if (!tb)
+			return -1;
+
+		printf("parse %-10s %8d entries %10.3f ms\n", files[i].name,
+				mnt_table_get_nents(tb), ms);
+		mnt_unref_table(tb);
+	}
+	return 0;
+}
+
+static int test_bench_diff(struct libmnt_test *ts __attribute__((unused)),
+			   int argc, char *argv[])
+{
+	struct libmnt_table *old = NULL, *new = NULL;
+	struct libmnt_tabdiff *df = NULL;
+	size_t n = bench_get_nents(argc, argv);
+	double ms = 0, start;
+	FILE *f;
+	int rc = -1, nchanges;
+
+	/* the old table */
+	f = bench_tmpfile(gen_mountinfo_simple, n);
+	if (!f)
+		return -errno;
+	old = bench_parse(f, MNT_FMT_MOUNTINFO, "old", &ms);
+	fclose(f);
+
+	/* the new table; 1% of entries umounted or remounted, 1% added */
+	f = tmpfile();
+	if (!f)
+		goto done;
+	gen_mountinfo(f, n, 50, n / 100);
+	fflush(f);
+	new = bench_parse(f, MNT_FMT_MOUNTINFO, "new", &ms);
+	fclose(f);
+
+	df = mnt_new_tabdiff();
+	if (!old || !new || !df)
+		goto done;
+
+	start = bench_now();
+	nchanges = mnt_diff_tables(df, old, new);
+	ms = bench_now() - start;
+	if (nchanges < 0)
+		goto done;
+
+	printf("diff %8d:%d entries %10.3f ms (%d changes)\n",
+			mnt_table_get_nents(old), mnt_table_get_nents(new),
+			ms, nchanges);
+
+	/* no changes, the tables are compared by all entries */
+	start = bench_now();
+	nchanges = mnt_diff_tables(df, old, old);
+	ms = bench_now() - start;
+	if (nchanges < 0)
+		goto done;
+
+	printf("diff %8d:%d entries %10.3f ms (the same tables)\n",
+			mnt_table_get_nents(old), mnt_table_get_nents(old), ms);
+	rc = 0;
+done:
+	mnt_free_tabdiff(df);
+	mnt_unref_table(old);
+	mnt_unref_table(new);
+	return rc;
+}
+
+static int test_bench_find(struct libmnt_test *ts __attribute__((unused)),
+			   int argc, char *argv[])
+{
+	struct libmnt_table *tb = NULL;
+	size_t i, n = bench_get_nents(argc, argv), nlookups, nfound;
+	double ms = 0, start;
+	char buf[64];
+	FILE *f;
+
+	f = bench_tmpfile(gen_mountinfo_simple, n);
+	if (!f)
+		return -errno;
+	tb = bench_parse(f, MNT_FMT_MOUNTINFO, "mountinfo", &ms);
+	fclose(f);
+	if (!tb)
+		return -1;
+
+	/* the lookups are spread over the whole table, the first one builds
+	 * the index (if any) */
+	nlookups = n < 1000 ? 1000 : n;
+
+	start = bench_now();
+	for (nfound = 0, i = 0; i < nlookups; i++) {
+		snprintf(buf, sizeof(buf), "/mnt/bench/%zu", (i * 7919) % n + 2);
+		if (mnt_table_find_target(tb, buf, MNT_ITER_BACKWARD))
+			nfound++;
+	}
+	ms = bench_now() - start;
+	printf("find target %8zu lookups %10.3f ms %8.3f us/lookup (%zu found)\n",
+			nlookups, ms, ms * 1000 / nlookups, nfound);
+
+	start = bench_now();
+	for (nfound = 0, i = 0; i < nlookups; i++) {
+		snprintf(buf, sizeof(buf), "tmpfs%zu", (i * 7919) % n + 2);
+		if (mnt_table_find_source(tb, buf, MNT_ITER_BACKWARD))
+			nfound++;
+	}
+	ms = bench_now() - start;
+	printf("find source %8zu lookups %10.3f ms %8.3f us/lookup (%zu found)\n",
+			nlookups, ms, ms * 1000 / nlookups, nfound);
+
+	start = bench_now();
+	for (nfound = 0, i = 0; i < nlookups; i++) {
+		if (mnt_table_find_devno(tb, makedev(0, (i % 4096) + 32),
+					 MNT_ITER_BACKWARD))
+			nfound++;
+	}
+	ms = bench_now() - start;
+	printf("find devno  %8zu lookups %10.3f ms %8.3f us/lookup (%zu found)\n",
+			nlookups, ms, ms * 1000 / nlookups, nfound);
+
+	mnt_unref_table(tb);
+	return 0;
+}
+
+/*
+ * Measures the userspace (utab) monitor latency, the time between the event
+ * (close of the utab lock file) and mnt_monitor_wait() return. The kernel
+ * monitor is not measured, it requires mount(2).
+ */
+static int test_bench_monitor(struct libmnt_test *ts __attribute__((unused)),
+			      int argc, char *argv[])
+{
+	char dir[] = "/tmp/libmount-bench-XXXXXX";
+	char *utab = NULL, *lock = NULL;
+	struct libmnt_monitor *mn = NULL;
+	size_t i, n = bench_get_nents(argc, argv);
+	double ms = 0, start, max = 0;
+	int rc = -1, fd;
+
+	if (!mkdtemp(dir))
+		return -errno;
+	if (asprintf(&utab, "%s/utab", dir) < 0 ||
+	    asprintf(&lock, "%s/utab.lock", dir) < 0)
+		goto done;
+
+	fd = open(lock, O_RDONLY|O_CREAT|O_CLOEXEC, 0644);
+	if (fd < 0)
+		goto done;
+	close(fd);
+
+	mn = mnt_new_monitor();
+	if (!mn || mnt_monitor_enable_userspace(mn, TRUE, utab) != 0
+	    || mnt_monitor_get_fd(mn) < 0)
+		goto done;
+
+	for (i = 0; i < n; i++) {
+		double x;
+
+		start = bench_now();
+		fd = open(lock, O_RDONLY|O_CLOEXEC);
+		if (fd < 0)
+			goto done;
+		close(fd);
+
+		if (mnt_monitor_wait(mn, 1000) <= 0) {
+			fprintf(stderr, "event %zu not detected\n", i);
+			goto done;
+		}
+		while (mnt_monitor_next_change(mn, NULL, NULL) == 0);
+
+		x = bench_now() - start;
+		ms += x;
+		if (x > max)
+			max = x;
+	}
+
+	printf("monitor %8zu events %10.3f ms %8.3f us/event (max %.3f us)\n",
+			n, ms, ms * 1000 / n, max * 1000);
+	rc = 0;
+done:
+	mnt_unref_monitor(mn);
+	if (lock)
+		unlink(lock);
+	rmdir(dir);
+	free(utab);
+	free(lock);
+	return rc;
+}
+
+static int test_bench_all(struct libmnt_test *ts, int argc, char *argv[])
+{
+	int rc;
+
+	rc = test_bench_parse(ts, argc, argv);
+	if (!rc)
+		rc = test_bench_diff(ts, argc, argv);
+	if (!rc)
+		rc = test_bench_find(ts, argc, argv);
+	if (!rc)
+		rc = test_bench_monitor(ts, argc, argv);
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	struct libmnt_test tss[] = {
+	{ "--parse",   test_bench_parse,   "[<entries>]  parse mountinfo, fstab and utab" },
+	{ "--diff",    test_bench_diff,    "[<entries>]  compare mountinfo tables" },
+	{ "--find",    test_bench_find,    "[<entries>]  find by target, source and devno" },
+	{ "--monitor", test_bench_monitor, "[<events>]   utab monitor event latency" },
+	{ "--all",     test_bench_all,     "[<entries>]  all benchmarks" },
+	{ NULL }
+	};
+
+	return mnt_run_test(tss, argc, argv);
+}
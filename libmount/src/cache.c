@@ -48,6 +48,7 @@
 struct mnt_cache_entry {
 	char			*key;	/* search key (e.g. uncanonicalized path) */
 	char			*value;	/* value (e.g. canonicalized path) */
+	uint64_t		hash;	/* path key hash (MNT_CACHE_ISPATH only) */
 	int			flag;
 };
 
@@ -69,6 +70,8 @@ struct libmnt_cache {
 	blkid_cache		bc;
 
 	struct libmnt_table	*mtab;
+
+	unsigned int		resolve_cached : 1;	/* try openat2(RESOLVE_CACHED) */
 };
 
 /**
@@ -170,6 +173,30 @@ int mnt_cache_set_targets(struct libmnt_cache *cache,
 	return 0;
 }
 
+/**
+ * mnt_cache_enable_cached_resolve:
+ * @cache: cache pointer
+ * @enable: TRUE or FALSE
+ *
+ * Enables or disables path resolution by openat2(2) with RESOLVE_CACHED. Paths
+ * are canonicalized in one syscall from the kernel dentry cache. Slow lookups
+ * (e.g. network filesystems) are never waited for there. If a path is not in
+ * the dentry cache, libmount falls back to the usual canonicalization.
+ *
+ * This is useful for tools that resolve many paths, for example all fstab
+ * targets.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, or negative number in case of error.
+ */
+int mnt_cache_enable_cached_resolve(struct libmnt_cache *cache, int enable)
+{
+	if (!cache)
+		return -EINVAL;
+	cache->resolve_cached = enable ? 1 : 0;
+	return 0;
+}
 
 /* note that the @key could be the same pointer as @value */
 static int cache_add_entry(struct libmnt_cache *cache, char *key,
@@ -195,6 +222,7 @@ static int cache_add_entry(struct libmnt_cache *cache, char *key,
 	e->key = key;
 	e->value = value;
 	e->flag = flag;
+	e->hash = (flag & MNT_CACHE_ISPATH) ? __mnt_tabidx_path_key(key) : 0;
 	cache->nents++;
 
 	DBG(CACHE, ul_debugobj(cache, "add entry [%2zd] (%s): %s: %s",
@@ -245,14 +273,18 @@ static int cache_add_tag(struct libmnt_cache *cache, const char *tagname,
  */
 static const char *cache_find_path(struct libmnt_cache *cache, const char *path)
 {
+	uint64_t hash;
 	size_t i;
 
 	if (!cache || !path)
 		return NULL;
 
+	/* the same hash as in table index, it ignores redundant slashes */
+	hash = __mnt_tabidx_path_key(path);
+
 	for (i = 0; i < cache->nents; i++) {
 		struct mnt_cache_entry *e = &cache->ents[i];
-		if (!(e->flag & MNT_CACHE_ISPATH))
+		if (!(e->flag & MNT_CACHE_ISPATH) || e->hash != hash)
 			continue;
 		if (streq_paths(path, e->key))
 			return e->value;
@@ -492,15 +524,57 @@ char *mnt_get_fstype(const char *devname, int *ambi, struct libmnt_cache *cache)
 	return type;
 }
 
+/*
+ * Canonicalizes the last component of @path in the already resolved parent
+ * directory. The parent directories are resolved (and cached) recursively, so
+ * for paths in the same directory (e.g. /dev/sd* or fstab targets) it's only
+ * one lstat() per path rather than one for each path component.
+ *
+ * Returns NULL if not possible, then the caller has to use realpath().
+ */
+static char *canonicalize_path_by_dir(const char *path,
+				      struct libmnt_cache *cache)
+{
+	const char *name, *dir_canon;
+	char *dir, *res;
+
+	if (*path != '/' || endswith(path, "/"))
+		return NULL;
+
+	name = strrchr(path, '/') + 1;
+	if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+		return NULL;
+
+	dir = strndup(path, name - path > 1 ? name - path - 1 : 1);
+	if (!dir)
+		return NULL;
+
+	dir_canon = mnt_resolve_path(dir, cache);
+	free(dir);
+	if (!dir_canon)
+		return NULL;
+
+	res = canonicalize_path_in_dir(dir_canon, name);
+	if (res)
+		DBG(CACHE, ul_debugobj(cache, "canonicalized by parent %s", dir_canon));
+	return res;
+}
+
 static char *canonicalize_path_and_cache(const char *path,
 						struct libmnt_cache *cache)
 {
-	char *p;
+	char *p = NULL;
 	char *key;
 	char *value;
 
 	DBG(CACHE, ul_debugobj(cache, "canonicalize path %s", path));
-	p = canonicalize_path(path);
+
+	if (cache && cache->resolve_cached)
+		p = canonicalize_path_cached(path);
+	if (!p && cache)
+		p = canonicalize_path_by_dir(path, cache);
+	if (!p)
+		p = canonicalize_path(path);
 
 	if (p && cache) {
 		value = p;
@@ -735,6 +809,8 @@ static int test_resolve_path(struct libmnt_test *ts, int argc, char *argv[])
 	cache = mnt_new_cache();
 	if (!cache)
 		return -ENOMEM;
+	if (argc > 1 && strcmp(argv[1], "--cached") == 0)
+		mnt_cache_enable_cached_resolve(cache, TRUE);
 
 	while(fgets(line, sizeof(line), stdin)) {
 		size_t sz = strlen(line);
@@ -829,7 +905,7 @@ static int test_read_tags(struct libmnt_test *ts, int argc, char *argv[])
 int main(int argc, char *argv[])
 {
 	struct libmnt_test ts[] = {
-		{ "--resolve-path", test_resolve_path, "  resolve paths from stdin" },
+		{ "--resolve-path", test_resolve_path, "[--cached]  resolve paths from stdin" },
 		{ "--resolve-spec", test_resolve_spec, "  evaluate specs from stdin" },
 		{ "--read-tags", test_read_tags,       "  read devname or TAG from stdin (\"quit\" to exit)" },
 		{ NULL }
@@ -40,6 +40,7 @@
 #include "fileutils.h"
 #include "strutils.h"
 #include "namespace.h"
+#include "mount-api-utils.h"
 
 #include <sys/wait.h>
 
@@ -80,6 +81,19 @@ struct libmnt_context *mnt_new_context(void)
 	return cxt;
 }
 
+static void free_children(struct libmnt_context *cxt)
+{
+	int i;
+
+	for (i = 0; i < cxt->nchildren; i++) {
+		free(cxt->children[i].target);
+		free(cxt->children[i].srcpath);
+	}
+	free(cxt->children);
+	cxt->children = NULL;
+	cxt->nchildren = cxt->nrunning = 0;
+}
+
 /**
  * mnt_free_context:
  * @cxt: mount context
@@ -108,7 +122,7 @@ void mnt_free_context(struct libmnt_context *cxt)
 
 	mnt_context_set_target_ns(cxt, NULL);
 
-	free(cxt->children);
+	free_children(cxt);
 
 	DBG(CXT, ul_debugobj(cxt, "<---- free"));
 	free(cxt);
@@ -584,6 +598,31 @@ int mnt_context_enable_fork(struct libmnt_context *cxt, int enable)
 	return set_flag(cxt, MNT_FL_FORK, enable);
 }
 
+/**
+ * mnt_context_set_fork_limit:
+ * @cxt: mount context
+ * @limit: maximal number of running children or zero for unlimited
+ *
+ * Sets the maximal number of the children running in parallel for
+ * mnt_context_next_mount() if fork is enabled (see mnt_context_enable_fork()).
+ * The next child is forked when any of the running children exits. The
+ * default is unlimited.
+ *
+ * Note that the library waits for any child process by waitpid(-1) if the
+ * limit is reached.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, negative number in case of error.
+ */
+int mnt_context_set_fork_limit(struct libmnt_context *cxt, int limit)
+{
+	if (!cxt || limit < 0)
+		return -EINVAL;
+	cxt->fork_limit = limit;
+	return 0;
+}
+
 /**
  * mnt_context_is_fork:
  * @cxt: mount context
@@ -1300,6 +1339,7 @@ int mnt_context_get_mtab(struct libmnt_context *cxt, struct libmnt_table **tb)
 			mnt_table_set_parser_fltrcb(cxt->mtab,
 					cxt->table_fltrcb,
 					cxt->table_fltrcb_data);
+		cxt->mtab->mntid_hint = cxt->table_mntid;
 
 		mnt_table_set_cache(cxt->mtab, mnt_context_get_cache(cxt));
 
@@ -1312,6 +1352,7 @@ int mnt_context_get_mtab(struct libmnt_context *cxt, struct libmnt_table **tb)
 						    cxt->mtab_path, cxt->utab);
 		else
 			rc = mnt_table_parse_mtab(cxt->mtab, cxt->mtab_path);
+		cxt->mtab->mntid_hint = 0;
 		if (rc)
 			goto end;
 	}
@@ -1346,7 +1387,8 @@ static int mtab_filter(struct libmnt_fs *fs, void *data)
 
 /*
  * The same like mnt_context_get_mtab(), but does not read all mountinfo/mtab
- * file, but only entries relevant for @tgt.
+ * file, but only entries relevant for @tgt. If @tgt is a mountpoint and the
+ * kernel supports statmount(2), only the mount is read from kernel.
  */
 int mnt_context_get_mtab_for_target(struct libmnt_context *cxt,
 				    struct libmnt_table **mtab,
@@ -1362,18 +1404,25 @@ int mnt_context_get_mtab_for_target(struct libmnt_context *cxt,
 	if (!ns_old)
 		return -MNT_ERR_NAMESPACE;
 
-	if (mnt_context_is_nocanonicalize(cxt))
+	if (mnt_context_is_nocanonicalize(cxt)) {
 		mnt_context_set_tabfilter(cxt, mtab_filter, (void *) tgt);
-
-	else if (mnt_stat_mountpoint(tgt, &st) == 0 && S_ISDIR(st.st_mode)) {
+#ifdef UL_HAVE_MOUNT_ROOT_ID
+		cxt->table_mntid = ul_get_mount_root_id(tgt);
+#endif
+	} else if (mnt_stat_mountpoint(tgt, &st) == 0 && S_ISDIR(st.st_mode)) {
 		cache = mnt_context_get_cache(cxt);
 		cn_tgt = mnt_resolve_path(tgt, cache);
-		if (cn_tgt)
+		if (cn_tgt) {
 			mnt_context_set_tabfilter(cxt, mtab_filter, cn_tgt);
+#ifdef UL_HAVE_MOUNT_ROOT_ID
+			cxt->table_mntid = ul_get_mount_root_id(cn_tgt);
+#endif
+		}
 	}
 
 	rc = mnt_context_get_mtab(cxt, mtab);
 	mnt_context_set_tabfilter(cxt, NULL, NULL);
+	cxt->table_mntid = 0;
 
 	if (!mnt_context_switch_ns(cxt, ns_old))
 		return -MNT_ERR_NAMESPACE;
@@ -1672,9 +1721,8 @@ int mnt_context_get_mflags(struct libmnt_context *cxt, unsigned long *flags)
 
 	*flags = 0;
 	if (!(cxt->flags & MNT_FL_MOUNTFLAGS_MERGED) && cxt->fs) {
-		const char *o = mnt_fs_get_options(cxt->fs);
-		if (o)
-			rc = mnt_optstr_get_flags(o, flags,
+		if (mnt_fs_get_options(cxt->fs))
+			rc = __mnt_fs_get_optflags(cxt->fs, flags,
 				    mnt_get_builtin_optmap(MNT_LINUX_MAP));
 	}
 
@@ -2366,6 +2414,11 @@ int mnt_context_update_tabs(struct libmnt_context *cxt)
 		mnt_update_force_rdonly(cxt->update,
 				cxt->mountflags & MS_RDONLY);
 
+	/* written after the last mount, see mnt_context_mount_batch() */
+	if (cxt->batch_utab
+	    && __mnt_update_defer(cxt->update, cxt->batch_utab) == 1)
+		goto end;
+
 	rc = mnt_update_table(cxt->update, cxt->lock);
 
 end:
@@ -2957,25 +3010,147 @@ int mnt_context_is_fs_mounted(struct libmnt_context *cxt,
 	return 0;
 }
 
-static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid)
+static int mnt_context_add_child(struct libmnt_context *cxt, pid_t pid,
+				 struct libmnt_fs *fs)
 {
-	pid_t *pids;
+	struct libmnt_child *ch;
 
 	if (!cxt)
 		return -EINVAL;
 
-	pids = realloc(cxt->children, sizeof(pid_t) * cxt->nchildren + 1);
-	if (!pids)
+	ch = realloc(cxt->children, sizeof(*ch) * (cxt->nchildren + 1));
+	if (!ch)
 		return -ENOMEM;
 
 	DBG(CXT, ul_debugobj(cxt, "add new child %d", pid));
-	cxt->children = pids;
-	cxt->children[cxt->nchildren++] = pid;
-
+	cxt->children = ch;
+
+	ch = &cxt->children[cxt->nchildren++];
+	memset(ch, 0, sizeof(*ch));
+	ch->pid = pid;
+	cxt->nrunning++;
+
+	/* ENOMEM is not fatal here, it's used for dependencies only */
+	if (fs && mnt_fs_get_target(fs))
+		ch->target = strdup(mnt_fs_get_target(fs));
+	if (fs && mnt_fs_get_srcpath(fs))
+		ch->srcpath = strdup(mnt_fs_get_srcpath(fs));
 	return 0;
 }
 
-int mnt_fork_context(struct libmnt_context *cxt)
+/* returns 1 if @path is @dir or it's in @dir */
+static int is_path_in(const char *path, const char *dir)
+{
+	size_t sz;
+
+	if (!path || !dir || *path != '/' || *dir != '/')
+		return 0;
+
+	sz = strlen(dir);
+	while (sz > 1 && dir[sz - 1] == '/')
+		sz--;
+	if (sz == 1)
+		return 1;	/* "/" */
+
+	return strncmp(path, dir, sz) == 0 && (path[sz] == '\0' || path[sz] == '/');
+}
+
+/*
+ * Returns 1 if @fs has to wait for the child. It's the parent (or child) mount
+ * point, or the source of one mount is within the other mount point (e.g.
+ * loop file or bind mount).
+ */
+static int is_child_dependency(struct libmnt_child *ch, struct libmnt_fs *fs)
+{
+	const char *tgt = mnt_fs_get_target(fs);
+	const char *src = mnt_fs_get_srcpath(fs);
+
+	return is_path_in(tgt, ch->target)
+	       || is_path_in(ch->target, tgt)
+	       || is_path_in(src, ch->target)
+	       || is_path_in(ch->srcpath, tgt);
+}
+
+static struct libmnt_child *get_child(struct libmnt_context *cxt, pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < cxt->nchildren; i++) {
+		if (cxt->children[i].pid == pid)
+			return &cxt->children[i];
+	}
+	return NULL;
+}
+
+static void child_done(struct libmnt_context *cxt, struct libmnt_child *ch,
+		       int status, int errsv)
+{
+	DBG(CXT, ul_debugobj(cxt, "child %d done [status=%d, errsv=%d]",
+				ch->pid, status, errsv));
+	ch->status = status;
+	ch->errsv = errsv;
+	ch->done = 1;
+	cxt->nrunning--;
+}
+
+/* waits for the child @ch, or for any child if @ch is NULL */
+static int wait_for_child(struct libmnt_context *cxt, struct libmnt_child *ch)
+{
+	pid_t pid;
+	int status = 0, rc = 0;
+
+	do {
+		errno = 0;
+		pid = waitpid(ch ? ch->pid : -1, &status, 0);
+	} while (pid == -1 && errno == EINTR);
+
+	if (pid == -1) {
+		rc = errno ? -errno : -ECHILD;
+		if (!ch)
+			return rc;
+		/* the child is lost, we don't know the result */
+		status = 0;
+	} else if (!ch)
+		ch = get_child(cxt, pid);
+
+	if (ch && !ch->done)
+		child_done(cxt, ch, status, rc);
+	return rc;
+}
+
+/*
+ * Waits for the running children @fs depends on, and for a free slot if
+ * the fork limit is reached.
+ */
+static int wait_for_fork_slot(struct libmnt_context *cxt, struct libmnt_fs *fs)
+{
+	int i, rc = 0;
+
+	for (i = 0; fs && i < cxt->nchildren; i++) {
+		struct libmnt_child *ch = &cxt->children[i];
+
+		if (ch->done || !is_child_dependency(ch, fs))
+			continue;
+
+		DBG(CXT, ul_debugobj(cxt, "%s: waiting for %s (child %d)",
+					mnt_fs_get_target(fs), ch->target, ch->pid));
+		wait_for_child(cxt, ch);
+	}
+
+	while (rc == 0 && cxt->fork_limit && cxt->nrunning >= cxt->fork_limit) {
+		DBG(CXT, ul_debugobj(cxt, "fork limit reached, waiting for child"));
+		rc = wait_for_child(cxt, NULL);
+	}
+
+	if (rc == -ECHILD) {
+		/* nothing to wait for, somebody else waited for our children */
+		cxt->nrunning = 0;
+		rc = 0;
+	}
+	return rc;
+}
+
+int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs)
 {
 	int rc = 0;
 	pid_t pid;
@@ -2984,6 +3159,10 @@ int mnt_fork_context(struct libmnt_context *cxt)
 	if (!mnt_context_is_parent(cxt))
 		return -EINVAL;
 
+	rc = wait_for_fork_slot(cxt, fs);
+	if (rc)
+		return rc;
+
 	DBG(CXT, ul_debugobj(cxt, "forking context"));
 
 	DBG_FLUSH;
@@ -3002,7 +3181,7 @@ int mnt_fork_context(struct libmnt_context *cxt)
 		break;
 
 	default:
-		rc = mnt_context_add_child(cxt, pid);
+		rc = mnt_context_add_child(cxt, pid, fs);
 		break;
 	}
 
@@ -3020,35 +3199,29 @@ int mnt_context_wait_for_children(struct libmnt_context *cxt,
 	assert(mnt_context_is_parent(cxt));
 
 	for (i = 0; i < cxt->nchildren; i++) {
-		pid_t pid = cxt->children[i];
-		int rc = 0, ret = 0;
+		struct libmnt_child *ch = &cxt->children[i];
 
-		if (!pid)
-			continue;
-		do {
+		if (!ch->done) {
 			DBG(CXT, ul_debugobj(cxt,
 					"waiting for child (%d/%d): %d",
-					i + 1, cxt->nchildren, pid));
-			errno = 0;
-			rc = waitpid(pid, &ret, 0);
-
-		} while (rc == -1 && errno == EINTR);
+					i + 1, cxt->nchildren, ch->pid));
+			wait_for_child(cxt, ch);
+		}
 
 		if (nchildren)
 			(*nchildren)++;
 
-		if (rc != -1 && nerrs) {
-			if (WIFEXITED(ret))
-				(*nerrs) += WEXITSTATUS(ret) == 0 ? 0 : 1;
+		if (nerrs) {
+			if (ch->errsv)
+				(*nerrs)++;
+			else if (WIFEXITED(ch->status))
+				(*nerrs) += WEXITSTATUS(ch->status) == 0 ? 0 : 1;
 			else
 				(*nerrs)++;
 		}
-		cxt->children[i] = 0;
 	}
 
-	cxt->nchildren = 0;
-	free(cxt->children);
-	cxt->children = NULL;
+	free_children(cxt);
 	return 0;
 }
 
@@ -3504,12 +3677,53 @@ static int test_mountall(struct libmnt_test *ts, int argc, char *argv[])
 	return 0;
 }
 
+static int test_mountbatch_cb(struct libmnt_context *cxt,
+			      struct libmnt_fs *fs, int mntrc,
+			      void *data __attribute__((__unused__)))
+{
+	const char *tgt = mnt_fs_get_target(fs);
+
+	if (!mnt_context_get_status(cxt)) {
+		if (mntrc > 0) {
+			errno = mntrc;
+			warn("%s: mount failed", tgt);
+		} else
+			warnx("%s: mount failed", tgt);
+	} else
+		printf("%s: successfully mounted\n", tgt);
+	return 0;
+}
+
+static int test_mountbatch(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_context *cxt;
+	struct libmnt_table *specs;
+	int rc;
+
+	if (argc != 2)
+		return -EINVAL;
+
+	cxt = mnt_new_context();
+	specs = mnt_new_table_from_file(argv[1]);
+	if (!cxt || !specs)
+		return -ENOMEM;
+
+	rc = mnt_context_mount_batch(cxt, specs, test_mountbatch_cb, NULL);
+	if (rc > 0)
+		printf("%d mounts failed\n", rc);
+
+	mnt_unref_table(specs);
+	mnt_free_context(cxt);
+	return rc < 0 ? rc : 0;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 	{ "--mount",  test_mount,  "[-o <opts>] [-t <type>] <spec>|<src> <target>" },
 	{ "--umount", test_umount, "[-t <type>] [-f][-l][-r] <src>|<target>" },
 	{ "--mount-all", test_mountall,  "[-O <pattern>] [-t <pattern] mount all filesystems from fstab" },
+	{ "--mount-batch", test_mountbatch, "<file>  mount all filesystems from fstab-like file by one batch" },
 	{ "--flags", test_flags,   "[-o <opts>] <spec>" },
 	{ "--search-helper", test_search_helper, "<fstype>" },
 	{ NULL }};
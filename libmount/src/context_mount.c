@@ -227,6 +227,11 @@ static int fix_optstr(struct libmnt_context *cxt)
 
 	fs = cxt->fs;
 
+	/* the options are modified in place */
+	rc = __mnt_fs_unshare_strbuf(fs);
+	if (rc)
+		goto done;
+
 	DBG(CXT, ul_debugobj(cxt, "mount: fixing options, current "
 		"vfs: '%s' fs: '%s' user: '%s', optstr: '%s'",
 		fs->vfs_optstr, fs->fs_optstr, fs->user_optstr, fs->optstr));
@@ -1479,7 +1484,7 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 	cxt->mtab = mtab;
 
 	if (mnt_context_is_fork(cxt)) {
-		rc = mnt_fork_context(cxt);
+		rc = mnt_fork_context(cxt, *fs);
 		if (rc)
 			return rc;		/* fork error */
 
@@ -1520,6 +1525,110 @@ int mnt_context_next_mount(struct libmnt_context *cxt,
 }
 
 
+/**
+ * mnt_context_mount_batch:
+ * @cxt: context
+ * @specs: filesystems to mount
+ * @cb: function called after each mount or NULL
+ * @data: @cb data
+ *
+ * Mounts all filesystems from @specs in the table order, so the parent
+ * mountpoints have to be in the table before the mounts on top of them. The
+ * @cxt is used as a template for all the mounts (flags, options, ...) and the
+ * source, target, fstype and options are applied from the @specs entries (see
+ * mnt_context_apply_fs()). The fstab is used only for incomplete entries, in
+ * the same way as by mnt_context_mount().
+ *
+ * The setup is shared by all the mounts: the mount table is read only once
+ * (and it's not updated within the batch, see mnt_context_get_mtab()), and
+ * the new utab entries are written by one update after the last mount rather
+ * than after each mount.
+ *
+ * The @cb callback is called with the mount return code (see
+ * mnt_context_mount(), mnt_context_get_excode() is usable within the
+ * callback). Non-zero callback return code stops the batch.
+ *
+ * The "mount -a --fork" mode is not supported by this function.
+ *
+ * Since: 2.38
+ *
+ * Returns: number of failed mounts, or negative number in case of error.
+ */
+int mnt_context_mount_batch(struct libmnt_context *cxt,
+			    struct libmnt_table *specs,
+			    int (*cb)(struct libmnt_context *cxt,
+				      struct libmnt_fs *fs, int mntrc, void *data),
+			    void *data)
+{
+	struct libmnt_table *mtab;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	int rc = 0, nfailed = 0;
+
+	if (!cxt || !specs || mnt_context_is_fork(cxt) || cxt->batch_utab)
+		return -EINVAL;
+
+	DBG(CXT, ul_debugobj(cxt, "batch-mount: %d entries",
+				mnt_table_get_nents(specs)));
+
+	if (!mnt_context_has_template(cxt)) {
+		mnt_context_set_source(cxt, NULL);
+		mnt_context_set_target(cxt, NULL);
+		mnt_context_set_fstype(cxt, NULL);
+		mnt_context_save_template(cxt);
+	}
+
+	cxt->batch_utab = mnt_new_table();
+	if (!cxt->batch_utab)
+		return -ENOMEM;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(specs, &itr, &fs) == 0) {
+		int mntrc;
+
+		/* reset context, but protect mtab */
+		mtab = cxt->mtab;
+		cxt->mtab = NULL;
+		mnt_reset_context(cxt);
+		cxt->mtab = mtab;
+
+		DBG(CXT, ul_debugobj(cxt, "batch-mount: trying %s",
+					mnt_fs_get_target(fs)));
+
+		mntrc = mnt_context_apply_fs(cxt, fs);
+		if (!mntrc)
+			mntrc = mnt_context_mount(cxt);
+		if (mntrc || mnt_context_get_status(cxt) != 1)
+			nfailed++;
+
+		if (cb && cb(cxt, fs, mntrc, data) != 0) {
+			DBG(CXT, ul_debugobj(cxt, "batch-mount: stopped by callback"));
+			break;
+		}
+	}
+
+	/* write the deferred utab entries */
+	if (cxt->update && mnt_table_get_nents(cxt->batch_utab)) {
+		struct libmnt_ns *ns_old = mnt_context_switch_target_ns(cxt);
+
+		if (!ns_old)
+			rc = -MNT_ERR_NAMESPACE;
+		else {
+			rc = __mnt_update_add_entries(cxt->update,
+						      cxt->batch_utab, cxt->lock);
+			if (!mnt_context_switch_ns(cxt, ns_old))
+				rc = -MNT_ERR_NAMESPACE;
+		}
+	}
+
+	mnt_unref_table(cxt->batch_utab);
+	cxt->batch_utab = NULL;
+
+	DBG(CXT, ul_debugobj(cxt, "batch-mount: done [failed=%d, rc=%d]", nfailed, rc));
+	return rc ? rc : nfailed;
+}
+
+
 /**
  * mnt_context_next_remount:
  * @cxt: context
@@ -63,6 +63,72 @@ void mnt_free_fs(struct libmnt_fs *fs)
 	free(fs);
 }
 
+/*
+ * The mountinfo strings may be stored in one per-entry buffer (see
+ * mnt_table_enable_zerocopy()). These strings must not be freed or
+ * reallocated.
+ */
+static void free_fs_str(struct libmnt_fs *fs, char **str)
+{
+	if (!__mnt_fs_is_strbuf(fs, *str))
+		free(*str);
+	*str = NULL;
+}
+
+static int strdup_fs_str(struct libmnt_fs *fs, char **str, const char *new)
+{
+	char *p = NULL;
+
+	if (new) {
+		p = strdup(new);
+		if (!p)
+			return -ENOMEM;
+	}
+	free_fs_str(fs, str);
+	*str = p;
+	return 0;
+}
+
+/*
+ * Copies the strings from the per-entry buffer to the separately allocated
+ * strings. Has to be called before the strings are modified in place.
+ */
+int __mnt_fs_unshare_strbuf(struct libmnt_fs *fs)
+{
+	char **strs[] = {
+		&fs->source, &fs->root, &fs->target, &fs->fstype,
+		&fs->optstr, &fs->vfs_optstr, &fs->opt_fields, &fs->fs_optstr
+	};
+	char *dups[ARRAY_SIZE(strs)];
+	size_t i;
+
+	__mnt_fs_materialize(fs);
+	if (!fs->strbuf)
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(strs); i++) {
+		dups[i] = NULL;
+		if (!__mnt_fs_is_strbuf(fs, *strs[i]))
+			continue;
+		dups[i] = strdup(*strs[i]);
+		if (!dups[i])
+			goto nomem;
+	}
+	for (i = 0; i < ARRAY_SIZE(strs); i++) {
+		if (dups[i])
+			*strs[i] = dups[i];
+	}
+
+	free(fs->strbuf);
+	fs->strbuf = NULL;
+	fs->strbufsz = 0;
+	return 0;
+nomem:
+	while (i > 0)
+		free(dups[--i]);
+	return -ENOMEM;
+}
+
 /**
  * mnt_reset_fs:
  * @fs: fs pointer
@@ -79,21 +145,24 @@ void mnt_reset_fs(struct libmnt_fs *fs)
 	ref = fs->refcount;
 
 	list_del(&fs->ents);
-	free(fs->source);
+	free_fs_str(fs, &fs->source);
 	free(fs->bindsrc);
 	free(fs->tagname);
 	free(fs->tagval);
-	free(fs->root);
+	free_fs_str(fs, &fs->root);
 	free(fs->swaptype);
-	free(fs->target);
-	free(fs->fstype);
-	free(fs->optstr);
-	free(fs->vfs_optstr);
-	free(fs->fs_optstr);
+	free_fs_str(fs, &fs->target);
+	free_fs_str(fs, &fs->fstype);
+	free_fs_str(fs, &fs->optstr);
+	free_fs_str(fs, &fs->vfs_optstr);
+	free_fs_str(fs, &fs->fs_optstr);
 	free(fs->user_optstr);
 	free(fs->attrs);
-	free(fs->opt_fields);
+	free_fs_str(fs, &fs->opt_fields);
 	free(fs->comment);
+	free(fs->strbuf);
+	free(fs->lazyline);
+	__mnt_free_optparsed(fs->optparsed);
 
 	memset(fs, 0, sizeof(*fs));
 	INIT_LIST_HEAD(&fs->ents);
@@ -192,7 +261,9 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 			return NULL;
 
 		dest->tab	 = NULL;
-	}
+
+	} else if (dest->tab)
+		__mnt_table_reset_index(dest->tab);	/* indexed fields */
 
 	dest->id         = src->id;
 	dest->parent     = src->parent;
@@ -226,6 +297,15 @@ struct libmnt_fs *mnt_copy_fs(struct libmnt_fs *dest,
 	if (cpy_str_at_offset(dest, src, offsetof(struct libmnt_fs, bindsrc)))
 		goto err;
 
+	/* not parsed fields, see mnt_table_enable_lazy_parse() */
+	free(dest->lazyline);
+	dest->lazyline = NULL;
+	if (src->lazyline) {
+		dest->lazyline = strdup(src->lazyline);
+		if (!dest->lazyline)
+			goto err;
+	}
+
 	dest->freq       = src->freq;
 	dest->passno     = src->passno;
 	dest->flags      = src->flags;
@@ -255,6 +335,8 @@ struct libmnt_fs *mnt_copy_mtab_fs(const struct libmnt_fs *fs)
 	if (!n)
 		return NULL;
 
+	__mnt_fs_materialize((struct libmnt_fs *) fs);
+
 	if (strdup_between_structs(n, fs, source))
 		goto err;
 	if (strdup_between_structs(n, fs, target))
@@ -380,11 +462,14 @@ int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 	}
 
 	if (fs->source != source)
-		free(fs->source);
+		free_fs_str(fs, &fs->source);
 
 	free(fs->tagname);
 	free(fs->tagval);
 
+	if (fs->tab)
+		__mnt_table_reset_index(fs->tab);	/* source is indexed */
+
 	fs->source = source;
 	fs->tagname = t;
 	fs->tagval = v;
@@ -549,7 +634,11 @@ const char *mnt_fs_get_target(struct libmnt_fs *fs)
  */
 int mnt_fs_set_target(struct libmnt_fs *fs, const char *tgt)
 {
-	return strdup_to_struct_member(fs, target, tgt);
+	if (fs && fs->tab)
+		__mnt_table_reset_index(fs->tab);	/* target is indexed */
+	if (!fs)
+		return -EINVAL;
+	return strdup_fs_str(fs, &fs->target, tgt);
 }
 
 static int mnt_fs_get_flags(struct libmnt_fs *fs)
@@ -575,6 +664,7 @@ int mnt_fs_get_propagation(struct libmnt_fs *fs, unsigned long *flags)
 
 	*flags = 0;
 
+	__mnt_fs_materialize(fs);
 	if (!fs->opt_fields)
 		return 0;
 
@@ -668,7 +758,7 @@ int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 	assert(fs);
 
 	if (fstype != fs->fstype)
-		free(fs->fstype);
+		free_fs_str(fs, &fs->fstype);
 
 	fs->fstype = fstype;
 	fs->flags &= ~MNT_FS_PSEUDO;
@@ -724,7 +814,8 @@ int mnt_fs_set_fstype(struct libmnt_fs *fs, const char *fstype)
  *
  *           returns: "rw,noexec,journal=update"
  */
-static char *merge_optstr(const char *vfs, const char *fs)
+static char *merge_optstr(const char *vfs, const char *fs,
+			  char *buf, size_t bufsz)
 {
 	char *res, *p;
 	size_t sz;
@@ -732,14 +823,18 @@ static char *merge_optstr(const char *vfs, const char *fs)
 
 	if (!vfs && !fs)
 		return NULL;
-	if (!vfs || !fs)
-		return strdup(fs ? fs : vfs);
-	if (!strcmp(vfs, fs))
-		return strdup(vfs);		/* e.g. "aaa" and "aaa" */
+	if (!vfs || !fs || !strcmp(vfs, fs)) {
+		/* one of them or the same, e.g. "aaa" and "aaa" */
+		p = (char *) (vfs ? vfs : fs);
+		sz = strlen(p) + 1;
+		if (!buf || bufsz < sz)
+			return strdup(p);
+		return memcpy(buf, p, sz);
+	}
 
 	/* leave space for the leading "r[ow],", "," and the trailing zero */
 	sz = strlen(vfs) + strlen(fs) + 5;
-	res = malloc(sz);
+	res = buf && bufsz >= sz ? buf : malloc(sz);
 	if (!res)
 		return NULL;
 	p = res + 3;			/* make a room for rw/ro flag */
@@ -781,10 +876,11 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
 		return NULL;
 
 	errno = 0;
+	__mnt_fs_materialize(fs);
 	if (fs->optstr)
 		return strdup(fs->optstr);
 
-	res = merge_optstr(fs->vfs_optstr, fs->fs_optstr);
+	res = merge_optstr(fs->vfs_optstr, fs->fs_optstr, NULL, 0);
 	if (!res && errno)
 		return NULL;
 	if (fs->user_optstr &&
@@ -795,6 +891,19 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
 	return res;
 }
 
+/*
+ * The same as mnt_fs_strdup_options() for mountinfo entries (without
+ * userspace options), but the result is stored to @buf if possible.
+ */
+char *__mnt_fs_merge_options(struct libmnt_fs *fs, char *buf, size_t bufsz)
+{
+	if (fs->optstr || fs->user_optstr)
+		return mnt_fs_strdup_options(fs);
+
+	errno = 0;
+	return merge_optstr(fs->vfs_optstr, fs->fs_optstr, buf, bufsz);
+}
+
 /**
  * mnt_fs_get_options:
  * @fs: fstab/mtab/mountinfo entry pointer
@@ -803,7 +912,10 @@ char *mnt_fs_strdup_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_options(struct libmnt_fs *fs)
 {
-	return fs ? fs->optstr : NULL;
+	if (!fs)
+		return NULL;
+	__mnt_fs_materialize(fs);
+	return fs->optstr;
 }
 
 /**
@@ -815,7 +927,10 @@ const char *mnt_fs_get_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_optional_fields(struct libmnt_fs *fs)
 {
-	return fs ? fs->opt_fields : NULL;
+	if (!fs)
+		return NULL;
+	__mnt_fs_materialize(fs);
+	return fs->opt_fields;
 }
 
 /**
@@ -834,6 +949,7 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 
 	if (!fs)
 		return -EINVAL;
+	__mnt_fs_materialize(fs);
 	if (optstr) {
 		int rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
 		if (rc)
@@ -847,10 +963,10 @@ int mnt_fs_set_options(struct libmnt_fs *fs, const char *optstr)
 		}
 	}
 
-	free(fs->fs_optstr);
-	free(fs->vfs_optstr);
+	free_fs_str(fs, &fs->fs_optstr);
+	free_fs_str(fs, &fs->vfs_optstr);
 	free(fs->user_optstr);
-	free(fs->optstr);
+	free_fs_str(fs, &fs->optstr);
 
 	fs->fs_optstr = f;
 	fs->vfs_optstr = v;
@@ -882,6 +998,9 @@ int mnt_fs_append_options(struct libmnt_fs *fs, const char *optstr)
 	if (!optstr)
 		return 0;
 
+	rc = __mnt_fs_unshare_strbuf(fs);
+	if (rc)
+		return rc;
 	rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
 	if (rc)
 		return rc;
@@ -924,6 +1043,9 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
 	if (!optstr)
 		return 0;
 
+	rc = __mnt_fs_unshare_strbuf(fs);
+	if (rc)
+		return rc;
 	rc = mnt_split_optstr(optstr, &u, &v, &f, 0, 0);
 	if (rc)
 		return rc;
@@ -952,7 +1074,10 @@ int mnt_fs_prepend_options(struct libmnt_fs *fs, const char *optstr)
  */
 const char *mnt_fs_get_fs_options(struct libmnt_fs *fs)
 {
-	return fs ? fs->fs_optstr : NULL;
+	if (!fs)
+		return NULL;
+	__mnt_fs_materialize(fs);
+	return fs->fs_optstr;
 }
 
 /**
@@ -963,7 +1088,10 @@ const char *mnt_fs_get_fs_options(struct libmnt_fs *fs)
  */
 const char *mnt_fs_get_vfs_options(struct libmnt_fs *fs)
 {
-	return fs ? fs->vfs_optstr : NULL;
+	if (!fs)
+		return NULL;
+	__mnt_fs_materialize(fs);
+	return fs->vfs_optstr;
 }
 
 /**
@@ -978,11 +1106,10 @@ char *mnt_fs_get_vfs_options_all(struct libmnt_fs *fs)
 {
 	const struct libmnt_optmap *map = mnt_get_builtin_optmap(MNT_LINUX_MAP);
 	const struct libmnt_optmap *ent;
-	const char *opts = mnt_fs_get_options(fs);
 	char *result = NULL;
 	unsigned long flags = 0;
 
-	if (!opts || mnt_optstr_get_flags(opts, &flags, map))
+	if (!mnt_fs_get_options(fs) || __mnt_fs_get_optflags(fs, &flags, map))
 		return NULL;
 
 	for (ent = map ; ent && ent->name ; ent++){
@@ -1137,7 +1264,10 @@ int mnt_fs_set_passno(struct libmnt_fs *fs, int passno)
  */
 const char *mnt_fs_get_root(struct libmnt_fs *fs)
 {
-	return fs ? fs->root : NULL;
+	if (!fs)
+		return NULL;
+	__mnt_fs_materialize(fs);
+	return fs->root;
 }
 
 /**
@@ -1149,7 +1279,10 @@ const char *mnt_fs_get_root(struct libmnt_fs *fs)
  */
 int mnt_fs_set_root(struct libmnt_fs *fs, const char *path)
 {
-	return strdup_to_struct_member(fs, root, path);
+	if (!fs)
+		return -EINVAL;
+	__mnt_fs_materialize(fs);
+	return strdup_fs_str(fs, &fs->root, path);
 }
 
 /**
@@ -1296,6 +1429,7 @@ int mnt_fs_get_option(struct libmnt_fs *fs, const char *name,
 
 	if (!fs)
 		return -EINVAL;
+	__mnt_fs_materialize(fs);
 	if (fs->fs_optstr)
 		rc = mnt_optstr_get_option(fs->fs_optstr, name, value, valsz);
 	if (rc == 1 && fs->vfs_optstr)
@@ -1531,9 +1665,34 @@ int mnt_fs_match_fstype(struct libmnt_fs *fs, const char *types)
  */
 int mnt_fs_match_options(struct libmnt_fs *fs, const char *options)
 {
+	struct libmnt_optparsed *op = fs ? __mnt_fs_get_optparsed(fs) : NULL;
+
+	if (op)
+		return __mnt_optparsed_match(op, options);
 	return mnt_match_options(mnt_fs_get_options(fs), options);
 }
 
+/*
+ * Returns parsed fs->optstr. The options are parsed again only if the string
+ * has been modified since the last call.
+ */
+struct libmnt_optparsed *__mnt_fs_get_optparsed(struct libmnt_fs *fs)
+{
+	__mnt_fs_materialize(fs);
+	return __mnt_optparsed_sync(&fs->optparsed, fs->optstr);
+}
+
+/* the same as mnt_optstr_get_flags() for fs->optstr */
+int __mnt_fs_get_optflags(struct libmnt_fs *fs, unsigned long *flags,
+			  const struct libmnt_optmap *map)
+{
+	struct libmnt_optparsed *op = __mnt_fs_get_optparsed(fs);
+
+	if (op)
+		return __mnt_optparsed_get_flags(op, flags, map);
+	return mnt_optstr_get_flags(fs->optstr, flags, map);
+}
+
 /**
  * mnt_fs_print_debug
  * @fs: fstab/mtab/mountinfo entry
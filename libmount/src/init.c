@@ -19,6 +19,7 @@
 #include <stdarg.h>
 
 #include "mountP.h"
+#include "ulstats.h"
 
 UL_DEBUG_DEFINE_MASK(libmount);
 UL_DEBUG_DEFINE_MASKNAMES(libmount) =
@@ -58,6 +59,7 @@ void mnt_init_debug(int mask)
 		return;
 
 	__UL_INIT_DEBUG_FROM_ENV(libmount, MNT_DEBUG_, mask, LIBMOUNT_DEBUG);
+	ul_stats_init("libmount");
 
 	if (libmount_debug_mask != MNT_DEBUG_INIT
 	    && libmount_debug_mask != (MNT_DEBUG_HELP|MNT_DEBUG_INIT)) {
@@ -42,7 +42,8 @@ struct libmnt_lock {
 
 	unsigned int	locked :1,	/* do we own the lock? */
 			sigblock :1,	/* block signals when locked */
-			simplelock :1;	/* use flock rather than normal mtab lock */
+			simplelock :1,	/* use flock rather than normal mtab lock */
+			shared :1;	/* shared flock (utab journal appends) */
 
 	sigset_t oldsigmask;
 };
@@ -163,6 +164,24 @@ int mnt_lock_use_simplelock(struct libmnt_lock *ml, int enable)
 	return 0;
 }
 
+/* don't export this to API
+ *
+ * The shared lock is used for utab journal appends, the appends are atomic
+ * and don't have to be serialized. The exclusive lock (default) is necessary
+ * for the utab rewrite.
+ */
+int mnt_lock_use_shared(struct libmnt_lock *ml, int enable)
+{
+	if (!ml)
+		return -EINVAL;
+
+	assert(ml->simplelock);
+
+	DBG(LOCKS, ul_debugobj(ml, "shared flock: %s", enable ? "ENABLED" : "DISABLED"));
+	ml->shared = enable ? 1 : 0;
+	return 0;
+}
+
 /*
  * Returns path to lockfile.
  */
@@ -239,7 +258,7 @@ static int lock_simplelock(struct libmnt_lock *ml)
 		}
 	}
 
-	while (flock(ml->lockfile_fd, LOCK_EX) < 0) {
+	while (flock(ml->lockfile_fd, ml->shared ? LOCK_SH : LOCK_EX) < 0) {
 		int errsv;
 		if ((errno == EAGAIN) || (errno == EINTR))
 			continue;
@@ -33,14 +33,18 @@
  *   </programlisting>
  * </informalexample>
  *
+ * The kernel monitor is also able to return IDs of the changed mounts, see
+ * mnt_monitor_enable_kernel_changes().
  */
 
 #include "fileutils.h"
 #include "mountP.h"
 #include "pathnames.h"
+#include "mount-api-utils.h"
 
 #include <sys/inotify.h>
 #include <sys/epoll.h>
+#include <inttypes.h>
 
 
 struct monitor_opers;
@@ -59,10 +63,41 @@ struct monitor_entry {
 	struct list_head	ents;
 };
 
+/* kernel mount as seen by the last scan, see mnt_monitor_enable_kernel_changes() */
+struct monitor_mount {
+	uint64_t		id;		/* unique mount ID */
+	uint64_t		parent;		/* unique parent ID */
+	uint64_t		point_hash;	/* mountpoint */
+	uint64_t		attr_hash;	/* mount flags and options */
+	uint64_t		prop_hash;	/* propagation */
+	int			old_id;		/* mountinfo ID */
+};
+
+struct monitor_change {
+	uint64_t		id;		/* unique mount ID */
+	int			old_id;		/* mountinfo ID */
+	int			oper;		/* MNT_TABDIFF_* */
+};
+
+struct monitor_tracker {
+	struct monitor_mount	*mounts;	/* sorted by ID */
+	size_t			nmounts;
+
+	struct monitor_change	*changes;
+	size_t			nchanges;
+	size_t			changes_alloc;
+	size_t			changes_next;	/* next unread change */
+	unsigned int		overflow : 1;	/* unread changes dropped */
+
+	struct ul_statmount	*sm;		/* statmount() buffer */
+	size_t			smsz;
+};
+
 struct libmnt_monitor {
 	int			refcount;
 	int			fd;		/* public monitor file descriptor */
 
+	struct monitor_tracker	*tracker;	/* kernel changes or NULL */
 	struct list_head	ents;
 };
 
@@ -74,6 +109,7 @@ struct monitor_opers {
 
 static int monitor_modify_epoll(struct libmnt_monitor *mn,
 				struct monitor_entry *me, int enable);
+static void free_monitor_tracker(struct monitor_tracker *tr);
 
 /**
  * mnt_new_monitor:
@@ -142,6 +178,7 @@ void mnt_unref_monitor(struct libmnt_monitor *mn)
 			free_monitor_entry(me);
 		}
 
+		free_monitor_tracker(mn->tracker);
 		free(mn);
 	}
 }
@@ -471,12 +508,298 @@ err:
 	return rc;
 }
 
+/*
+ * Kernel changes tracker -- keeps the list of the mounts (by listmount() and
+ * statmount()) and compares it with the previous state after each kernel
+ * event. It's cheaper than parse and compare the whole mountinfo, and the
+ * caller does not have to read the mount table at all.
+ */
+static void free_monitor_tracker(struct monitor_tracker *tr)
+{
+	if (!tr)
+		return;
+	free(tr->mounts);
+	free(tr->changes);
+	free(tr->sm);
+	free(tr);
+}
+
+#ifdef UL_HAVE_STATMOUNT
+
+#define TRACKER_NIDS		512
+#define TRACKER_SMSZ		4096
+#define TRACKER_MAXCHANGES	4096	/* max. unread changes */
+
+#define TRACKER_MASK	(UL_STATMOUNT_SB_BASIC | UL_STATMOUNT_MNT_BASIC | \
+			 UL_STATMOUNT_PROPAGATE_FROM | UL_STATMOUNT_MNT_POINT | \
+			 UL_STATMOUNT_MNT_OPTS)
+
+static uint64_t tracker_hash(uint64_t h, const void *data, size_t sz)
+{
+	const unsigned char *p = data;
+	size_t i;
+
+	for (i = 0; i < sz; i++)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+#define tracker_hash_num(_h, _n)	tracker_hash(_h, &(_n), sizeof(_n))
+
+/* returns 0 on success, 1 if the mount does not exist, <0 on error */
+static int tracker_stat_mount(struct monitor_tracker *tr, uint64_t id,
+			      struct monitor_mount *mnt)
+{
+	struct ul_statmount *sm;
+	const char *str;
+	uint64_t h;
+
+	while (ul_statmount(id, TRACKER_MASK, tr->sm, tr->smsz) != 0) {
+		if (errno == EOVERFLOW) {
+			sm = realloc(tr->sm, tr->smsz * 2);
+			if (!sm)
+				return -ENOMEM;
+			tr->sm = sm;
+			tr->smsz *= 2;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+		return errno == ENOENT ? 1 : -errno;
+	}
+	sm = tr->sm;
+
+	mnt->id = sm->mnt_id;
+	mnt->parent = sm->mnt_parent_id;
+	mnt->old_id = sm->mnt_id_old;
+
+	str = sm->mask & UL_STATMOUNT_MNT_POINT ? sm->str + sm->mnt_point : "";
+	mnt->point_hash = tracker_hash(0xcbf29ce484222325ULL, str, strlen(str));
+
+	h = 0xcbf29ce484222325ULL;
+	h = tracker_hash_num(h, sm->mnt_attr);
+	h = tracker_hash_num(h, sm->sb_flags);
+	if (sm->mask & UL_STATMOUNT_MNT_OPTS) {
+		str = sm->str + sm->mnt_opts;
+		h = tracker_hash(h, str, strlen(str));
+	}
+	mnt->attr_hash = h;
+
+	h = 0xcbf29ce484222325ULL;
+	h = tracker_hash_num(h, sm->mnt_propagation);
+	h = tracker_hash_num(h, sm->mnt_peer_group);
+	h = tracker_hash_num(h, sm->mnt_master);
+	if (sm->mask & UL_STATMOUNT_PROPAGATE_FROM)
+		h = tracker_hash_num(h, sm->propagate_from);
+	mnt->prop_hash = h;
+	return 0;
+}
+
+static int cmp_monitor_mounts(const void *a, const void *b)
+{
+	const struct monitor_mount *x = a, *y = b;
+
+	return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/* reads the current mounts, the result is sorted by IDs */
+static int tracker_read_mounts(struct monitor_tracker *tr,
+			       struct monitor_mount **res, size_t *nres)
+{
+	uint64_t ids[TRACKER_NIDS], last = 0;
+	struct monitor_mount *mnts = NULL;
+	size_t nmnts = 0, alloc = 0;
+	int rc = 0, sorted = 1;
+	ssize_t n, i;
+
+	do {
+		n = ul_listmount(UL_LSMT_ROOT, last, ids, TRACKER_NIDS);
+		if (n < 0) {
+			rc = -errno;
+			goto err;
+		}
+		for (i = 0; i < n; i++) {
+			if (nmnts == alloc) {
+				struct monitor_mount *tmp;
+
+				alloc = alloc ? alloc * 2 : TRACKER_NIDS;
+				tmp = realloc(mnts, alloc * sizeof(*mnts));
+				if (!tmp) {
+					rc = -ENOMEM;
+					goto err;
+				}
+				mnts = tmp;
+			}
+			if (ids[i] < last)
+				sorted = 0;
+			last = ids[i];
+
+			rc = tracker_stat_mount(tr, ids[i], &mnts[nmnts]);
+			if (rc < 0)
+				goto err;
+			if (rc == 0)
+				nmnts++;
+		}
+	} while (n == TRACKER_NIDS);
+
+	if (!sorted)
+		qsort(mnts, nmnts, sizeof(*mnts), cmp_monitor_mounts);
+
+	*res = mnts;
+	*nres = nmnts;
+	return 0;
+err:
+	free(mnts);
+	return rc;
+}
+
+static int tracker_add_change(struct monitor_tracker *tr,
+			      const struct monitor_mount *mnt, int oper)
+{
+	struct monitor_change *ch;
+
+	if (tr->nchanges == tr->changes_alloc) {
+		size_t sz = tr->changes_alloc ? tr->changes_alloc * 2 : 16;
+
+		ch = realloc(tr->changes, sz * sizeof(*ch));
+		if (!ch)
+			return -ENOMEM;
+		tr->changes = ch;
+		tr->changes_alloc = sz;
+	}
+
+	ch = &tr->changes[tr->nchanges++];
+	ch->id = mnt->id;
+	ch->old_id = mnt->old_id;
+	ch->oper = oper;
+	return 0;
+}
+
+/* compares the current mounts with the previous state */
+static int tracker_scan(struct libmnt_monitor *mn, struct monitor_tracker *tr)
+{
+	struct monitor_mount *mnts = NULL;
+	size_t nmnts = 0, o = 0, n = 0;
+	int rc;
+
+	rc = tracker_read_mounts(tr, &mnts, &nmnts);
+	if (rc)
+		return rc;
+
+	/* drop the already read changes */
+	if (tr->changes_next) {
+		tr->nchanges -= tr->changes_next;
+		memmove(tr->changes, tr->changes + tr->changes_next,
+				tr->nchanges * sizeof(*tr->changes));
+		tr->changes_next = 0;
+	}
+
+	while (rc == 0 && (o < tr->nmounts || n < nmnts)) {
+		struct monitor_mount *old = o < tr->nmounts ? &tr->mounts[o] : NULL;
+		struct monitor_mount *new = n < nmnts ? &mnts[n] : NULL;
+
+		if (!new || (old && old->id < new->id)) {
+			rc = tracker_add_change(tr, old, MNT_TABDIFF_UMOUNT);
+			o++;
+		} else if (!old || new->id < old->id) {
+			rc = tracker_add_change(tr, new, MNT_TABDIFF_MOUNT);
+			n++;
+		} else {
+			if (old->parent != new->parent || old->point_hash != new->point_hash)
+				rc = tracker_add_change(tr, new, MNT_TABDIFF_MOVE);
+			else if (old->attr_hash != new->attr_hash)
+				rc = tracker_add_change(tr, new, MNT_TABDIFF_REMOUNT);
+			else if (old->prop_hash != new->prop_hash)
+				rc = tracker_add_change(tr, new, MNT_TABDIFF_PROPAGATION);
+			o++, n++;
+		}
+	}
+	if (rc) {
+		free(mnts);
+		return rc;
+	}
+
+	/* nobody reads the changes, keep the last ones only */
+	if (tr->nchanges > TRACKER_MAXCHANGES) {
+		size_t ndrop = tr->nchanges - TRACKER_MAXCHANGES;
+
+		DBG(MONITOR, ul_debugobj(mn, "kernel scan: dropping %zu unread changes", ndrop));
+		memmove(tr->changes, tr->changes + ndrop,
+				TRACKER_MAXCHANGES * sizeof(*tr->changes));
+		tr->nchanges = TRACKER_MAXCHANGES;
+		tr->overflow = 1;
+	}
+
+	DBG(MONITOR, ul_debugobj(mn, "kernel scan: %zu mounts, %zu unread changes",
+				nmnts, tr->nchanges - tr->changes_next));
+	free(tr->mounts);
+	tr->mounts = mnts;
+	tr->nmounts = nmnts;
+	return 0;
+}
+
+static struct monitor_tracker *new_monitor_tracker(struct libmnt_monitor *mn)
+{
+	struct monitor_tracker *tr;
+
+	tr = calloc(1, sizeof(*tr));
+	if (!tr)
+		return NULL;
+	tr->smsz = TRACKER_SMSZ;
+	tr->sm = malloc(tr->smsz);
+	if (!tr->sm)
+		goto err;
+
+	/* the initial state, all mounts are not "changed" */
+	if (tracker_scan(mn, tr) != 0)
+		goto err;
+	tr->nchanges = 0;
+	return tr;
+err:
+	free_monitor_tracker(tr);
+	return NULL;
+}
+
+#else /* !UL_HAVE_STATMOUNT */
+
+static struct monitor_tracker *new_monitor_tracker(
+			struct libmnt_monitor *mn __attribute__((__unused__)))
+{
+	errno = ENOSYS;
+	return NULL;
+}
+
+static int tracker_scan(struct libmnt_monitor *mn __attribute__((__unused__)),
+			struct monitor_tracker *tr __attribute__((__unused__)))
+{
+	return -ENOSYS;
+}
+
+#endif /* UL_HAVE_STATMOUNT */
+
+/*
+ * Updates the list of the changed mounts if enabled, the event is always
+ * accepted (there is no way to verify mountinfo event).
+ */
+static int kernel_event_verify(struct libmnt_monitor *mn,
+			       struct monitor_entry *me __attribute__((__unused__)))
+{
+	if (mn->tracker) {
+		int rc = tracker_scan(mn, mn->tracker);
+
+		if (rc)
+			DBG(MONITOR, ul_debugobj(mn, "kernel scan failed [rc=%d]", rc));
+	}
+	return 1;
+}
+
 /*
  * kernel monitor operations
  */
 static const struct monitor_opers kernel_opers = {
 	.op_get_fd		= kernel_monitor_get_fd,
 	.op_close_fd		= kernel_monitor_close_fd,
+	.op_event_verify	= kernel_event_verify
 };
 
 /**
@@ -545,6 +868,104 @@ err:
 	return rc;
 }
 
+/**
+ * mnt_monitor_enable_kernel_changes:
+ * @mn: monitor
+ * @enable: 0 or 1
+ *
+ * Enables or disables tracking of the changed mounts for the kernel monitor
+ * (see mnt_monitor_enable_kernel()). If enabled, the monitor keeps the list
+ * of the mounts and after each kernel event it returns the changed mounts by
+ * mnt_monitor_next_kernel_change(), so the caller does not have to read and
+ * compare the whole mount table.
+ *
+ * The tracking uses listmount(2) and statmount(2) syscalls (Linux 6.8 or
+ * newer) and it follows the current mount namespace.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, -ENOSYS if unsupported by kernel, or <0 on error.
+ */
+int mnt_monitor_enable_kernel_changes(struct libmnt_monitor *mn, int enable)
+{
+	if (!mn)
+		return -EINVAL;
+
+	if (!enable) {
+		free_monitor_tracker(mn->tracker);
+		mn->tracker = NULL;
+		return 0;
+	}
+	if (mn->tracker)
+		return 0;
+
+	DBG(MONITOR, ul_debugobj(mn, "allocate kernel changes tracker"));
+	errno = 0;
+	mn->tracker = new_monitor_tracker(mn);
+	if (!mn->tracker) {
+		int rc = errno ? -errno : -ENOMEM;
+
+		/* old kernel */
+		if (rc == -EINVAL || rc == -EPERM)
+			rc = -ENOSYS;
+		DBG(MONITOR, ul_debugobj(mn, "failed to allocate tracker [rc=%d]", rc));
+		return rc;
+	}
+	return 0;
+}
+
+/**
+ * mnt_monitor_next_kernel_change:
+ * @mn: monitor
+ * @uniq_id: returns the unique mount ID (see statmount(2)) or NULL
+ * @id: returns the mount ID as used in /proc/self/mountinfo or NULL
+ * @oper: returns MNT_TABDIFF_* operation or NULL
+ *
+ * Returns the next changed mount since the last call. The operation is
+ * MNT_TABDIFF_MOUNT, MNT_TABDIFF_UMOUNT, MNT_TABDIFF_MOVE, MNT_TABDIFF_REMOUNT
+ * (VFS flags or filesystem options) or MNT_TABDIFF_PROPAGATION. The changes
+ * are updated when the kernel event is detected by mnt_monitor_wait() or
+ * mnt_monitor_next_change().
+ *
+ * Note that the mountinfo mount IDs are reused by kernel. If the changes are
+ * not read, only the last 4096 unread changes are kept. The next call after
+ * the older changes have been dropped returns 2 (and no change); the list is
+ * incomplete and the caller should read the whole mount table again.
+ *
+ * See also mnt_monitor_enable_kernel_changes().
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success, 1 at the end of the list, 2 if some changes have been
+ * lost, or <0 on error.
+ */
+int mnt_monitor_next_kernel_change(struct libmnt_monitor *mn, uint64_t *uniq_id,
+				   int *id, int *oper)
+{
+	struct monitor_tracker *tr;
+	struct monitor_change *ch;
+
+	if (!mn || !mn->tracker)
+		return -EINVAL;
+
+	tr = mn->tracker;
+	if (tr->overflow) {
+		tr->overflow = 0;
+		return 2;
+	}
+	if (tr->changes_next >= tr->nchanges)
+		return 1;
+
+	ch = &tr->changes[tr->changes_next++];
+	if (uniq_id)
+		*uniq_id = ch->id;
+	if (id)
+		*id = ch->old_id;
+	if (oper)
+		*oper = ch->oper;
+	return 0;
+}
+
 /*
  * Add/Remove monitor entry to/from monitor epoll.
  */
@@ -965,12 +1386,61 @@ static int test_wait(struct libmnt_test *ts, int argc, char *argv[])
 	return 0;
 }
 
+/*
+ * create a kernel monitor and print changed mounts
+ */
+static int test_changes(struct libmnt_test *ts __attribute__((unused)),
+			int argc __attribute__((unused)),
+			char *argv[] __attribute__((unused)))
+{
+	struct libmnt_monitor *mn = mnt_new_monitor();
+	int rc;
+
+	if (!mn)
+		return -1;
+
+	rc = mnt_monitor_enable_kernel(mn, TRUE);
+	if (!rc)
+		rc = mnt_monitor_enable_kernel_changes(mn, TRUE);
+	if (rc) {
+		warnx("failed to initialize kernel changes monitor [rc=%d]", rc);
+		goto done;
+	}
+
+	printf("waiting for changes...\n");
+	while (mnt_monitor_wait(mn, -1) > 0) {
+		uint64_t uniq_id;
+		int id, oper, ch;
+
+		while (mnt_monitor_next_change(mn, NULL, NULL) == 0);
+
+		while ((ch = mnt_monitor_next_kernel_change(mn, &uniq_id, &id, &oper)) == 0
+		       || ch == 2) {
+			if (ch == 2) {
+				printf(" some changes lost\n");
+				continue;
+			}
+			printf(" %-12s id=%d [unique: %" PRIu64 "]\n",
+				oper == MNT_TABDIFF_MOUNT ? "mount" :
+				oper == MNT_TABDIFF_UMOUNT ? "umount" :
+				oper == MNT_TABDIFF_MOVE ? "move" :
+				oper == MNT_TABDIFF_REMOUNT ? "remount" :
+				oper == MNT_TABDIFF_PROPAGATION ? "propagation" : "???",
+				id, uniq_id);
+		}
+	}
+done:
+	mnt_unref_monitor(mn);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 		{ "--epoll", test_epoll, "<userspace kernel ...>  monitor in epoll" },
 		{ "--epoll-clean", test_epoll_cleanup, "<userspace kernel ...>  monitor in epoll and clean events" },
 		{ "--wait",  test_wait,  "<userspace kernel ...>  monitor wait function" },
+		{ "--changes", test_changes, "monitor kernel and print changed mounts" },
 		{ NULL }
 	};
 
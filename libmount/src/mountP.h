@@ -82,6 +82,10 @@ UL_DEBUG_DECLARE_MASK(libmount);
 
 #define MNT_UTAB_HEADER	"# libmount utab file\n"
 
+/* utab journal, see tab_update.c */
+#define MNT_UTAB_JOURNAL_HEADER	"# libmount utab journal size="
+#define MNT_UTAB_DELETED	"DEL "	/* removed entry record prefix */
+
 #ifdef TEST_PROGRAM
 struct libmnt_test {
 	const char	*name;
@@ -214,6 +218,13 @@ struct libmnt_fs {
 
 	int		flags;		/* MNT_FS_* flags */
 	pid_t		tid;		/* /proc/<tid>/mountinfo otherwise zero */
+	uint64_t	linehash;	/* mountinfo line hash, see mnt_table_refresh() */
+
+	char		*strbuf;	/* mountinfo strings, see mnt_table_enable_zerocopy() */
+	size_t		strbufsz;
+	char		*lazyline;	/* not yet parsed mountinfo line, see mnt_table_enable_lazy_parse() */
+
+	struct libmnt_optparsed *optparsed; /* parsed optstr, see __mnt_fs_get_optparsed() */
 
 	char		*comment;	/* fstab comment */
 
@@ -232,11 +243,46 @@ struct libmnt_fs {
 /*
  * mtab/fstab/mountinfo file
  */
+/*
+ * Lookup indexes of the table entries, see tab_index.c
+ */
+enum {
+	MNT_TABIDX_TARGET = 0,	/* mountpoint path */
+	MNT_TABIDX_SRCPATH,	/* source path */
+	MNT_TABIDX_ID,		/* mount ID */
+	MNT_TABIDX_PARENT,	/* parent mount ID */
+	MNT_TABIDX_DEVNO,	/* st_dev */
+
+	MNT_TABIDX_COUNT
+};
+
+struct libmnt_tabidx_ent {
+	uint64_t		key;	/* hash or number */
+	size_t			pos;	/* position in the table */
+	struct libmnt_fs	*fs;
+};
+
+struct libmnt_tabidx {
+	struct libmnt_tabidx_ent *ents;	/* sorted by key and pos */
+	size_t		nents;
+	unsigned int	built : 1;
+};
+
+struct libmnt_tabidx_iter {
+	struct libmnt_tabidx_ent *cur;
+	struct libmnt_tabidx_ent *first;	/* the first entry with the key */
+	struct libmnt_tabidx_ent *last;		/* the last entry with the key */
+	int		direction;
+};
+
 struct libmnt_table {
 	int		fmt;		/* MNT_FMT_* file format */
 	int		nents;		/* number of entries */
 	int		refcount;	/* reference counter */
 	int		comms;		/* enable/disable comment parsing */
+	int		zerocopy;	/* store mountinfo strings to one buffer per entry */
+	int		lazy;		/* parse mountinfo root and options on demand */
+	uint64_t	mntid_hint;	/* read only this mount from mountinfo */
 	char		*comm_intro;	/* First comment in file */
 	char		*comm_tail;	/* Last comment in file */
 
@@ -251,10 +297,34 @@ struct libmnt_table {
 
 	struct list_head	ents;	/* list of entries (libmnt_fs) */
 	void		*userdata;
+
+	struct libmnt_tabidx	idx[MNT_TABIDX_COUNT];	/* lazy lookup indexes */
+	int		idx_ntags;	/* entries with tags (by SRCPATH index) */
 };
 
 extern struct libmnt_table *__mnt_new_table_from_file(const char *filename, int fmt, int empty_for_enoent);
 
+/* tab_parse.c */
+extern int __mnt_kernel_fs_postparse(struct libmnt_table *tb,
+				     struct libmnt_fs *fs, pid_t *tid,
+				     const char *filename);
+
+/* tab_listmount.c */
+extern int __mnt_table_parse_listmount(struct libmnt_table *tb);
+extern int __mnt_table_parse_statmount(struct libmnt_table *tb, uint64_t id);
+
+/* tab_index.c */
+extern void __mnt_table_reset_index(struct libmnt_table *tb);
+extern uint64_t __mnt_tabidx_path_key(const char *path);
+extern int __mnt_table_index_begin(struct libmnt_table *tb, int type, uint64_t key,
+				   int direction, struct libmnt_tabidx_iter *it);
+extern struct libmnt_fs *__mnt_table_index_next(struct libmnt_tabidx_iter *it);
+
+/* tab_diff.c */
+extern int __mnt_tabdiff_reset(struct libmnt_tabdiff *df);
+extern int __mnt_tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
+				   struct libmnt_fs *new, int oper);
+
 /*
  * Tab file format
  */
@@ -281,6 +351,19 @@ struct libmnt_ns {
 	struct libmnt_cache *cache;	/* paths cache associated with NS */
 };
 
+/*
+ * Forked child, see mnt_context_enable_fork()
+ */
+struct libmnt_child {
+	pid_t		pid;
+	int		status;		/* wait(2) status */
+	int		errsv;		/* -errno if waitpid() failed */
+	unsigned int	done : 1;	/* already waited for */
+
+	char		*target;	/* fstab target, for dependencies */
+	char		*srcpath;	/* fstab source path or NULL */
+};
+
 /*
  * Mount context -- high-level API
  */
@@ -306,6 +389,7 @@ struct libmnt_context
 
 	int	(*table_fltrcb)(struct libmnt_fs *fs, void *data);	/* callback for libmnt_table structs */
 	void	*table_fltrcb_data;
+	uint64_t table_mntid;		/* mount to read by mnt_context_get_mtab() */
 
 	char	*(*pwd_get_cb)(struct libmnt_context *);		/* get encryption password */
 	void	(*pwd_release_cb)(struct libmnt_context *, char *);	/* release password */
@@ -323,6 +407,7 @@ struct libmnt_context
 	struct libmnt_cache	*cache;	/* paths cache */
 	struct libmnt_lock	*lock;	/* mtab lock */
 	struct libmnt_update	*update;/* mtab/utab update */
+	struct libmnt_table	*batch_utab; /* deferred utab entries (batch mount) */
 
 	const char	*mtab_path; /* path to mtab */
 	int		mtab_writable; /* is mtab writable */
@@ -340,8 +425,10 @@ struct libmnt_context
 
 	char	*orig_user;	/* original (non-fixed) user= option */
 
-	pid_t	*children;	/* "mount -a --fork" PIDs */
+	struct libmnt_child *children;	/* "mount -a --fork" children */
 	int	nchildren;	/* number of children */
+	int	nrunning;	/* number of not yet finished children */
+	int	fork_limit;	/* max running children or zero */
 	pid_t	pid;		/* 0=parent; PID=child */
 
 
@@ -389,6 +476,7 @@ struct libmnt_context
 
 /* lock.c */
 extern int mnt_lock_use_simplelock(struct libmnt_lock *ml, int enable);
+extern int mnt_lock_use_shared(struct libmnt_lock *ml, int enable);
 
 /* optmap.c */
 extern const struct libmnt_optmap *mnt_optmap_get_entry(
@@ -405,6 +493,16 @@ extern int mnt_optstr_fix_uid(char **optstr, char *value, size_t valsz, char **n
 extern int mnt_optstr_fix_secontext(char **optstr, char *value, size_t valsz, char **next);
 extern int mnt_optstr_fix_user(char **optstr);
 
+struct libmnt_optparsed;
+extern void __mnt_free_optparsed(struct libmnt_optparsed *op);
+extern struct libmnt_optparsed *__mnt_optparsed_sync(struct libmnt_optparsed **op,
+					      const char *optstr);
+extern int __mnt_optparsed_get_option(struct libmnt_optparsed *op, const char *name,
+			       const char **value, size_t *valsz);
+extern int __mnt_optparsed_match(struct libmnt_optparsed *op, const char *pattern);
+extern int __mnt_optparsed_get_flags(struct libmnt_optparsed *op, unsigned long *flags,
+			      const struct libmnt_optmap *map);
+
 /* fs.c */
 extern struct libmnt_fs *mnt_copy_mtab_fs(const struct libmnt_fs *fs)
 			__attribute__((nonnull));
@@ -412,6 +510,30 @@ extern int __mnt_fs_set_source_ptr(struct libmnt_fs *fs, char *source)
 			__attribute__((nonnull(1)));
 extern int __mnt_fs_set_fstype_ptr(struct libmnt_fs *fs, char *fstype)
 			__attribute__((nonnull(1)));
+extern int __mnt_fs_unshare_strbuf(struct libmnt_fs *fs)
+			__attribute__((nonnull));
+extern char *__mnt_fs_merge_options(struct libmnt_fs *fs, char *buf, size_t bufsz);
+extern struct libmnt_optparsed *__mnt_fs_get_optparsed(struct libmnt_fs *fs)
+			__attribute__((nonnull));
+extern int __mnt_fs_get_optflags(struct libmnt_fs *fs, unsigned long *flags,
+			  const struct libmnt_optmap *map)
+			__attribute__((nonnull(1)));
+
+extern int __mnt_fs_parse_lazy(struct libmnt_fs *fs)
+			__attribute__((nonnull));
+
+/* parses root, options and optional fields skipped by the lazy parser */
+static inline void __mnt_fs_materialize(struct libmnt_fs *fs)
+{
+	if (fs->lazyline)
+		__mnt_fs_parse_lazy(fs);
+}
+
+/* returns 1 if @str is in the per-entry string buffer */
+static inline int __mnt_fs_is_strbuf(const struct libmnt_fs *fs, const char *str)
+{
+	return fs->strbuf && str >= fs->strbuf && str < fs->strbuf + fs->strbufsz;
+}
 
 /* context.c */
 extern struct libmnt_context *mnt_copy_context(struct libmnt_context *o);
@@ -448,7 +570,7 @@ extern int mnt_context_setup_loopdev(struct libmnt_context *cxt);
 extern int mnt_context_delete_loopdev(struct libmnt_context *cxt);
 extern int mnt_context_clear_loopdev(struct libmnt_context *cxt);
 
-extern int mnt_fork_context(struct libmnt_context *cxt);
+extern int mnt_fork_context(struct libmnt_context *cxt, struct libmnt_fs *fs);
 
 extern int mnt_context_set_tabfilter(struct libmnt_context *cxt,
 				     int (*fltr)(struct libmnt_fs *, void *),
@@ -475,6 +597,9 @@ extern int mnt_update_set_filename(struct libmnt_update *upd,
 				   const char *filename, int userspace_only);
 extern int mnt_update_already_done(struct libmnt_update *upd,
 				   struct libmnt_lock *lc);
+extern int __mnt_update_defer(struct libmnt_update *upd, struct libmnt_table *tb);
+extern int __mnt_update_add_entries(struct libmnt_update *upd,
+				    struct libmnt_table *ents, struct libmnt_lock *lc);
 
 #if __linux__
 /* btrfs.c */
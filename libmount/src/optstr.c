@@ -1169,6 +1169,212 @@ int mnt_match_options(const char *optstr, const char *pattern)
 	return match;
 }
 
+/*
+ * Parsed options string -- the options are parsed only once and the result
+ * is kept (for example by libmnt_fs) for repeated lookups. The object keeps
+ * a private copy of the string; __mnt_optparsed_sync() compares it with the
+ * current string and parses again only if the string has been modified.
+ */
+struct libmnt_optent {
+	const char	*name;
+	size_t		namesz;
+	const char	*value;
+	size_t		valsz;
+};
+
+#define MNT_OPTPARSED_NMAPS	2
+
+struct libmnt_optparsed {
+	char			*str;		/* the parsed string */
+	struct libmnt_optent	*ents;
+	size_t			nents;
+
+	/* mnt_optstr_get_flags() results, see optparsed_get_flags() */
+	const struct libmnt_optmap *maps[MNT_OPTPARSED_NMAPS];
+	unsigned long		set[MNT_OPTPARSED_NMAPS];
+	unsigned long		keep[MNT_OPTPARSED_NMAPS];
+	size_t			nmaps;
+};
+
+void __mnt_free_optparsed(struct libmnt_optparsed *op)
+{
+	if (!op)
+		return;
+	free(op->ents);
+	free(op->str);
+	free(op);
+}
+
+static struct libmnt_optparsed *new_optparsed(const char *optstr)
+{
+	struct libmnt_optparsed *op;
+	size_t nallocs = 0;
+	char *str, *name, *value;
+	size_t namesz, valsz;
+	int rc;
+
+	op = calloc(1, sizeof(*op));
+	if (!op)
+		return NULL;
+	op->str = strdup(optstr);
+	if (!op->str)
+		goto err;
+
+	str = op->str;
+	while ((rc = mnt_optstr_parse_next(&str, &name, &namesz,
+					   &value, &valsz)) == 0) {
+		struct libmnt_optent *e;
+
+		if (op->nents == nallocs) {
+			nallocs = nallocs ? nallocs * 2 : 8;
+			e = realloc(op->ents, nallocs * sizeof(*e));
+			if (!e)
+				goto err;
+			op->ents = e;
+		}
+		e = &op->ents[op->nents++];
+		e->name = name;
+		e->namesz = namesz;
+		e->value = value;
+		e->valsz = valsz;
+	}
+	if (rc < 0)
+		goto err;	/* parse error, use the string functions */
+	return op;
+err:
+	__mnt_free_optparsed(op);
+	return NULL;
+}
+
+/*
+ * Returns parsed @optstr. The already parsed options in @op are reused if
+ * the string is unchanged, otherwise the old @op is deallocated.
+ *
+ * Returns NULL on error (or if optstr is NULL); the caller is expected
+ * to use the string functions in this case.
+ */
+struct libmnt_optparsed *__mnt_optparsed_sync(struct libmnt_optparsed **op,
+					      const char *optstr)
+{
+	assert(op);
+
+	if (*op && optstr && strcmp((*op)->str, optstr) == 0)
+		return *op;
+
+	__mnt_free_optparsed(*op);
+	*op = optstr ? new_optparsed(optstr) : NULL;
+	return *op;
+}
+
+static const struct libmnt_optent *optparsed_find(struct libmnt_optparsed *op,
+						  const char *name, size_t namesz)
+{
+	size_t i;
+
+	for (i = 0; i < op->nents; i++) {
+		const struct libmnt_optent *e = &op->ents[i];
+
+		if (e->namesz == namesz && strncmp(e->name, name, namesz) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+/* the same as mnt_optstr_get_option() */
+int __mnt_optparsed_get_option(struct libmnt_optparsed *op, const char *name,
+			       const char **value, size_t *valsz)
+{
+	const struct libmnt_optent *e;
+
+	assert(op);
+	assert(name);
+
+	e = optparsed_find(op, name, strlen(name));
+	if (!e)
+		return 1;
+	if (value)
+		*value = e->value;
+	if (valsz)
+		*valsz = e->valsz;
+	return 0;
+}
+
+/* the same as mnt_match_options() */
+int __mnt_optparsed_match(struct libmnt_optparsed *op, const char *pattern)
+{
+	char *name, *pat = (char *) pattern;
+	char *patval;
+	size_t namesz = 0, patvalsz = 0;
+	int match = 1;
+
+	assert(op);
+
+	if (!pattern)
+		return 0;
+
+	while (match && !mnt_optstr_next_option(&pat, &name, &namesz,
+						&patval, &patvalsz)) {
+		const struct libmnt_optent *e;
+		int no = 0;
+
+		if (*name == '+')
+			name++, namesz--;
+		else if ((no = (startswith(name, "no") != NULL)))
+			name += 2, namesz -= 2;
+
+		e = optparsed_find(op, name, namesz);
+
+		/* check also value (if the pattern is "foo=value") */
+		if (e && patvalsz > 0 &&
+		    (patvalsz != e->valsz || strncmp(patval, e->value, e->valsz) != 0))
+			e = NULL;
+
+		match = e ? no == 0 : no == 1;
+	}
+	return match;
+}
+
+/*
+ * The same as mnt_optstr_get_flags(). The result for @map is calculated
+ * only once. The options set or unset the bits, so it's stored as bits set
+ * from zero and bits kept from ~0 -- then it's usable for any input @flags.
+ */
+int __mnt_optparsed_get_flags(struct libmnt_optparsed *op, unsigned long *flags,
+			      const struct libmnt_optmap *map)
+{
+	size_t i;
+
+	assert(op);
+
+	if (!flags || !map)
+		return -EINVAL;
+
+	for (i = 0; i < op->nmaps; i++) {
+		if (op->maps[i] == map)
+			break;
+	}
+	if (i == op->nmaps) {
+		unsigned long set = 0, keep = ~0UL;
+		int rc;
+
+		rc = mnt_optstr_get_flags(op->str, &set, map);
+		if (!rc)
+			rc = mnt_optstr_get_flags(op->str, &keep, map);
+		if (rc)
+			return rc;
+		if (op->nmaps == MNT_OPTPARSED_NMAPS)
+			i = 0;		/* replace the first one */
+		else
+			op->nmaps++;
+		op->maps[i] = map;
+		op->set[i] = set;
+		op->keep[i] = keep;
+	}
+
+	*flags = op->set[i] | (*flags & op->keep[i]);
+	return 0;
+}
+
 #ifdef TEST_PROGRAM
 #include "xalloc.h"
 
@@ -167,6 +167,7 @@ void mnt_free_table(struct libmnt_table *tb)
 		return;
 
 	mnt_reset_table(tb);
+	__mnt_table_reset_index(tb);
 	DBG(TAB, ul_debugobj(tb, "free [refcount=%d]", tb->refcount));
 
 	mnt_unref_cache(tb->cache);
@@ -259,6 +260,55 @@ void mnt_table_enable_comments(struct libmnt_table *tb, int enable)
 		tb->comms = enable;
 }
 
+/**
+ * mnt_table_enable_zerocopy:
+ * @tb: pointer to tab
+ * @enable: TRUE or FALSE
+ *
+ * Enables the compact mountinfo parser mode. All strings of the entry
+ * (source, target, root, type, options and optional fields) are unmangled to
+ * one per-entry buffer rather than allocated separately, which saves most of
+ * the allocations when parsing large mount tables. The buffer is transparent
+ * for the library API; the strings are copied on demand if the entry is
+ * modified. This setting is ignored for other file formats.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success or negative number in case of error.
+ */
+int mnt_table_enable_zerocopy(struct libmnt_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+	tb->zerocopy = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * mnt_table_enable_lazy_parse:
+ * @tb: pointer to tab
+ * @enable: TRUE or FALSE
+ *
+ * Enables the lazy mountinfo parser mode. Only the mount IDs, device
+ * number, target, source and filesystem type are parsed when the table is
+ * read; the entry keeps the original line and the filesystem root, options
+ * and optional fields are parsed on the first access (for example by
+ * mnt_fs_get_options()). It saves memory and time for applications which
+ * read large mount tables but don't use the options. This setting is
+ * ignored for other file formats.
+ *
+ * Since: 2.38
+ *
+ * Returns: 0 on success or negative number in case of error.
+ */
+int mnt_table_enable_lazy_parse(struct libmnt_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+	tb->lazy = enable ? 1 : 0;
+	return 0;
+}
+
 /**
  * mnt_table_with_comments:
  * @tb: pointer to table
@@ -452,6 +502,7 @@ int mnt_table_add_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 	list_add_tail(&fs->ents, &tb->ents);
 	fs->tab = tb;
 	tb->nents++;
+	__mnt_table_reset_index(tb);
 
 	DBG(TAB, ul_debugobj(tb, "add entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -471,6 +522,7 @@ static int __table_insert_fs(
 
 	fs->tab = tb;
 	tb->nents++;
+	__mnt_table_reset_index(tb);
 
 	DBG(TAB, ul_debugobj(tb, "insert entry: %s %s",
 			mnt_fs_get_source(fs), mnt_fs_get_target(fs)));
@@ -542,6 +594,7 @@ int mnt_table_move_fs(struct libmnt_table *src, struct libmnt_table *dst,
 	/* remove from source */
 	list_del_init(&fs->ents);
 	src->nents--;
+	__mnt_table_reset_index(src);
 
 	/* insert to the destination */
 	return __table_insert_fs(dst, before, pos, fs);
@@ -566,6 +619,7 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 	fs->tab = NULL;
 	list_del_init(&fs->ents);
+	__mnt_table_reset_index(tb);
 
 	mnt_unref_fs(fs);
 	tb->nents--;
@@ -574,10 +628,15 @@ int mnt_table_remove_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 
 static inline struct libmnt_fs *get_parent_fs(struct libmnt_table *tb, struct libmnt_fs *fs)
 {
+	struct libmnt_tabidx_iter it;
 	struct libmnt_iter itr;
 	struct libmnt_fs *x;
 	int parent_id = mnt_fs_get_parent_id(fs);
 
+	if (__mnt_table_index_begin(tb, MNT_TABIDX_ID, (uint64_t) parent_id,
+				    MNT_ITER_FORWARD, &it) == 0)
+		return __mnt_table_index_next(&it);
+
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while (mnt_table_next_fs(tb, &itr, &x) == 0) {
 		if (mnt_fs_get_id(x) == parent_id)
@@ -657,8 +716,9 @@ int mnt_table_get_root_fs(struct libmnt_table *tb, struct libmnt_fs **root)
 int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 			struct libmnt_fs *parent, struct libmnt_fs **chld)
 {
+	struct libmnt_tabidx_iter it;
 	struct libmnt_fs *fs;
-	int parent_id, lastchld_id = 0, chld_id = 0;
+	int parent_id, lastchld_id = 0, chld_id = 0, indexed;
 
 	if (!tb || !itr || !parent || !is_mountinfo(tb))
 		return -EINVAL;
@@ -676,8 +736,12 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 
 	*chld = NULL;
 
+	indexed = __mnt_table_index_begin(tb, MNT_TABIDX_PARENT,
+				(uint64_t) parent_id, MNT_ITER_FORWARD, &it) == 0;
+
 	mnt_reset_iter(itr, MNT_ITER_FORWARD);
-	while(mnt_table_next_fs(tb, itr, &fs) == 0) {
+	while (indexed ? (fs = __mnt_table_index_next(&it)) != NULL
+		       : mnt_table_next_fs(tb, itr, &fs) == 0) {
 		int id;
 
 		if (mnt_fs_get_parent_id(fs) != parent_id)
@@ -734,9 +798,10 @@ int mnt_table_next_child_fs(struct libmnt_table *tb, struct libmnt_iter *itr,
 int mnt_table_over_fs(struct libmnt_table *tb, struct libmnt_fs *parent,
 		      struct libmnt_fs **child)
 {
+	struct libmnt_tabidx_iter it;
 	struct libmnt_iter itr;
 	struct libmnt_fs *fs = NULL;
-	int id;
+	int id, indexed;
 	const char *tgt;
 
 	if (!tb || !parent || !is_mountinfo(tb))
@@ -749,7 +814,11 @@ int mnt_table_over_fs(struct libmnt_table *tb, struct libmnt_fs *parent,
 	id = mnt_fs_get_id(parent);
 	tgt = mnt_fs_get_target(parent);
 
-	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+	indexed = __mnt_table_index_begin(tb, MNT_TABIDX_PARENT,
+				(uint64_t) id, MNT_ITER_FORWARD, &it) == 0;
+
+	while (indexed ? (fs = __mnt_table_index_next(&it)) != NULL
+		       : mnt_table_next_fs(tb, &itr, &fs) == 0) {
 		if (mnt_fs_get_parent_id(fs) == id &&
 		    mnt_fs_streq_target(fs, tgt) == 1) {
 			if (child)
@@ -1033,6 +1102,31 @@ struct libmnt_fs *mnt_table_find_mountpoint(struct libmnt_table *tb,
 	return mnt_table_find_target(tb, "/", direction);
 }
 
+/* returns the first entry with target equal to @path */
+static struct libmnt_fs *find_target_streq(struct libmnt_table *tb,
+					   const char *path, int direction)
+{
+	struct libmnt_tabidx_iter it;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs = NULL;
+
+	if (__mnt_table_index_begin(tb, MNT_TABIDX_TARGET,
+				__mnt_tabidx_path_key(path), direction, &it) == 0) {
+		while ((fs = __mnt_table_index_next(&it))) {
+			if (mnt_fs_streq_target(fs, path))
+				return fs;
+		}
+		return NULL;
+	}
+
+	mnt_reset_iter(&itr, direction);
+	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_streq_target(fs, path))
+			return fs;
+	}
+	return NULL;
+}
+
 /**
  * mnt_table_find_target:
  * @tb: tab pointer
@@ -1062,23 +1156,17 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup TARGET: '%s'", path));
 
 	/* native @target */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, path))
-			return fs;
-	}
+	fs = find_target_streq(tb, path, direction);
+	if (fs)
+		return fs;
 
 	/* try absolute path */
 	if (is_relative_path(path) && (cn = absolute_path(path))) {
 		DBG(TAB, ul_debugobj(tb, "lookup absolute TARGET: '%s'", cn));
-		mnt_reset_iter(&itr, direction);
-		while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_target(fs, cn)) {
-				free(cn);
-				return fs;
-			}
-		}
+		fs = find_target_streq(tb, cn, direction);
 		free(cn);
+		if (fs)
+			return fs;
 	}
 
 	if (!tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
@@ -1087,11 +1175,9 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	DBG(TAB, ul_debugobj(tb, "lookup canonical TARGET: '%s'", cn));
 
 	/* canonicalized paths in struct libmnt_table */
-	mnt_reset_iter(&itr, direction);
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		if (mnt_fs_streq_target(fs, cn))
-			return fs;
-	}
+	fs = find_target_streq(tb, cn, direction);
+	if (fs)
+		return fs;
 
 	/* non-canonical path in struct libmnt_table
 	 * -- note that mountpoint in /proc/self/mountinfo is already
@@ -1115,6 +1201,77 @@ struct libmnt_fs *mnt_table_find_target(struct libmnt_table *tb, const char *pat
 	return NULL;
 }
 
+#ifdef HAVE_BTRFS_SUPPORT
+/* returns 1 if @fs is btrfs subvolume, but not the default one */
+static int is_btrfs_nondefault(struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	uint64_t default_id;
+	char *val;
+	size_t len;
+
+	if (!fs->fstype || strcmp(fs->fstype, "btrfs") != 0)
+		return 0;
+
+	default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
+	if (default_id == UINT64_MAX)
+		DBG(TAB, ul_debug("not found btrfs volume setting"));
+
+	else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
+		uint64_t subvol_id;
+
+		if (mnt_parse_offset(val, len, &subvol_id)) {
+			DBG(TAB, ul_debugobj(tb, "failed to parse subvolid="));
+			return 1;
+		}
+		if (subvol_id != default_id)
+			return 1;
+	}
+	return 0;
+}
+#else
+# define is_btrfs_nondefault(tb, fs)	0
+#endif /* HAVE_BTRFS_SUPPORT */
+
+/*
+ * Returns the first entry with source path equal to @path. If @ntags is not
+ * NULL, then the btrfs not-default subvolumes are ignored and the number of
+ * the entries with tags is returned by @ntags if nothing found.
+ */
+static struct libmnt_fs *find_srcpath_streq(struct libmnt_table *tb,
+					    const char *path, int direction,
+					    int *ntags)
+{
+	struct libmnt_tabidx_iter it;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs = NULL;
+
+	if (__mnt_table_index_begin(tb, MNT_TABIDX_SRCPATH,
+				__mnt_tabidx_path_key(path), direction, &it) == 0) {
+		while ((fs = __mnt_table_index_next(&it))) {
+			if (!mnt_fs_streq_srcpath(fs, path))
+				continue;
+			if (ntags && is_btrfs_nondefault(tb, fs))
+				continue;
+			return fs;
+		}
+		if (ntags)
+			*ntags = tb->idx_ntags;
+		return NULL;
+	}
+
+	mnt_reset_iter(&itr, direction);
+	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_streq_srcpath(fs, path)) {
+			if (ntags && is_btrfs_nondefault(tb, fs))
+				continue;
+			return fs;
+		}
+		if (ntags && mnt_fs_get_tag(fs, NULL, NULL) == 0)
+			(*ntags)++;
+	}
+	return NULL;
+}
+
 /**
  * mnt_table_find_srcpath:
  * @tb: tab pointer
@@ -1151,37 +1308,9 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 	DBG(TAB, ul_debugobj(tb, "lookup SRCPATH: '%s'", path));
 
 	/* native paths */
-	mnt_reset_iter(&itr, direction);
-
-	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-
-		if (mnt_fs_streq_srcpath(fs, path)) {
-#ifdef HAVE_BTRFS_SUPPORT
-			if (fs->fstype && !strcmp(fs->fstype, "btrfs")) {
-				uint64_t default_id = btrfs_get_default_subvol_id(mnt_fs_get_target(fs));
-				char *val;
-				size_t len;
-
-				if (default_id == UINT64_MAX)
-					DBG(TAB, ul_debug("not found btrfs volume setting"));
-
-				else if (mnt_fs_get_option(fs, "subvolid", &val, &len) == 0) {
-					uint64_t subvol_id;
-
-					if (mnt_parse_offset(val, len, &subvol_id)) {
-						DBG(TAB, ul_debugobj(tb, "failed to parse subvolid="));
-						continue;
-					}
-					if (subvol_id != default_id)
-						continue;
-				}
-			}
-#endif /* HAVE_BTRFS_SUPPORT */
-			return fs;
-		}
-		if (mnt_fs_get_tag(fs, NULL, NULL) == 0)
-			ntags++;
-	}
+	fs = find_srcpath_streq(tb, path, direction, &ntags);
+	if (fs)
+		return fs;
 
 	if (!path || !tb->cache || !(cn = mnt_resolve_path(path, tb->cache)))
 		return NULL;
@@ -1192,11 +1321,9 @@ struct libmnt_fs *mnt_table_find_srcpath(struct libmnt_table *tb, const char *pa
 
 	/* canonicalized paths in struct libmnt_table */
 	if (ntags < nents) {
-		mnt_reset_iter(&itr, direction);
-		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-			if (mnt_fs_streq_srcpath(fs, cn))
-				return fs;
-		}
+		fs = find_srcpath_streq(tb, cn, direction, NULL);
+		if (fs)
+			return fs;
 	}
 
 	/* evaluated tag */
@@ -1430,6 +1557,7 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 				       dev_t devno, int direction)
 {
 	struct libmnt_fs *fs = NULL;
+	struct libmnt_tabidx_iter it;
 	struct libmnt_iter itr;
 
 	if (!tb)
@@ -1439,6 +1567,10 @@ struct libmnt_fs *mnt_table_find_devno(struct libmnt_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "lookup DEVNO: %d", (int) devno));
 
+	if (__mnt_table_index_begin(tb, MNT_TABIDX_DEVNO, (uint64_t) devno,
+				    direction, &it) == 0)
+		return __mnt_table_index_next(&it);
+
 	mnt_reset_iter(&itr, direction);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -1900,6 +2032,8 @@ int mnt_table_is_fs_mounted(struct libmnt_table *tb, struct libmnt_fs *fstab_fs)
 
 
 #ifdef TEST_PROGRAM
+#include <sys/time.h>
+
 #include "pathnames.h"
 
 static int parser_errcb(struct libmnt_table *tb, const char *filename, int line)
@@ -1909,7 +2043,8 @@ static int parser_errcb(struct libmnt_table *tb, const char *filename, int line)
 	return 1;	/* all errors are recoverable -- this is the default */
 }
 
-static struct libmnt_table *create_table(const char *file, int comments)
+static struct libmnt_table *create_table(const char *file, int comments, int zerocopy,
+					  int lazy)
 {
 	struct libmnt_table *tb;
 
@@ -1920,6 +2055,8 @@ static struct libmnt_table *create_table(const char *file, int comments)
 		goto err;
 
 	mnt_table_enable_comments(tb, comments);
+	mnt_table_enable_zerocopy(tb, zerocopy);
+	mnt_table_enable_lazy_parse(tb, lazy);
 	mnt_table_set_parser_errcb(tb, parser_errcb);
 
 	if (mnt_table_parse_file(tb, file) != 0)
@@ -1937,7 +2074,7 @@ static int test_copy_fs(struct libmnt_test *ts, int argc, char *argv[])
 	struct libmnt_fs *fs;
 	int rc = -1;
 
-	tb = create_table(argv[1], FALSE);
+	tb = create_table(argv[1], FALSE, FALSE, FALSE);
 	if (!tb)
 		return -1;
 
@@ -1967,12 +2104,16 @@ static int test_parse(struct libmnt_test *ts, int argc, char *argv[])
 	struct libmnt_iter *itr = NULL;
 	struct libmnt_fs *fs;
 	int rc = -1;
-	int parse_comments = FALSE;
+	int parse_comments = FALSE, zerocopy = FALSE, lazy = FALSE;
 
 	if (argc == 3 && !strcmp(argv[2], "--comments"))
 		parse_comments = TRUE;
+	else if (argc == 3 && !strcmp(argv[2], "--zerocopy"))
+		zerocopy = TRUE;
+	else if (argc == 3 && !strcmp(argv[2], "--lazy"))
+		lazy = TRUE;
 
-	tb = create_table(argv[1], parse_comments);
+	tb = create_table(argv[1], parse_comments, zerocopy, lazy);
 	if (!tb)
 		return -1;
 
@@ -1997,6 +2138,40 @@ done:
 	return rc;
 }
 
+/* parses the directory twice, the second parsing is from the cache */
+static int test_parse_dir(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb[2] = { NULL, NULL };
+	struct libmnt_iter *itr = NULL;
+	struct libmnt_fs *fs;
+	int rc = -1, i;
+
+	if (argc != 2)
+		return -EINVAL;
+
+	for (i = 0; i < 2; i++) {
+		tb[i] = mnt_new_table();
+		if (!tb[i] || mnt_table_parse_dir(tb[i], argv[1]) != 0)
+			goto done;
+	}
+	if (mnt_table_get_nents(tb[0]) != mnt_table_get_nents(tb[1])) {
+		fprintf(stderr, "cached table differs\n");
+		goto done;
+	}
+
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+	if (!itr)
+		goto done;
+	while (mnt_table_next_fs(tb[1], itr, &fs) == 0)
+		mnt_fs_print_debug(fs, stdout);
+	rc = 0;
+done:
+	mnt_free_iter(itr);
+	mnt_unref_table(tb[0]);
+	mnt_unref_table(tb[1]);
+	return rc;
+}
+
 static int test_find_idx(struct libmnt_test *ts, int argc, char *argv[])
 {
 	struct libmnt_table *tb;
@@ -2012,7 +2187,7 @@ static int test_find_idx(struct libmnt_test *ts, int argc, char *argv[])
 
 	file = argv[1], what = argv[2];
 
-	tb = create_table(file, FALSE);
+	tb = create_table(file, FALSE, FALSE, FALSE);
 	if (!tb)
 		goto done;
 
@@ -2057,7 +2232,7 @@ static int test_find(struct libmnt_test *ts, int argc, char *argv[], int dr)
 
 	file = argv[1], find = argv[2], what = argv[3];
 
-	tb = create_table(file, FALSE);
+	tb = create_table(file, FALSE, FALSE, FALSE);
 	if (!tb)
 		goto done;
 
@@ -2101,7 +2276,7 @@ static int test_find_pair(struct libmnt_test *ts, int argc, char *argv[])
 	struct libmnt_cache *mpc = NULL;
 	int rc = -1;
 
-	tb = create_table(argv[1], FALSE);
+	tb = create_table(argv[1], FALSE, FALSE, FALSE);
 	if (!tb)
 		return -1;
 	mpc = mnt_new_cache();
@@ -2167,7 +2342,7 @@ static int test_is_mounted(struct libmnt_test *ts, int argc, char *argv[])
 		return -1;
 	}
 
-	fstab = create_table(argv[1], FALSE);
+	fstab = create_table(argv[1], FALSE, FALSE, FALSE);
 	if (!fstab)
 		goto done;
 
@@ -2220,7 +2395,7 @@ static int test_uniq(struct libmnt_test *ts, int argc, char *argv[])
 		return -EINVAL;
 	}
 
-	tb = create_table(argv[1], FALSE);
+	tb = create_table(argv[1], FALSE, FALSE, FALSE);
 	if (!tb)
 		goto done;
 
@@ -2240,10 +2415,99 @@ done:
 }
 
 
+static int streq_safe(const char *a, const char *b)
+{
+	return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static int is_same_fs(struct libmnt_fs *a, struct libmnt_fs *b)
+{
+	return mnt_fs_get_id(a) == mnt_fs_get_id(b)
+	    && mnt_fs_get_devno(a) == mnt_fs_get_devno(b)
+	    && streq_safe(mnt_fs_get_source(a), mnt_fs_get_source(b))
+	    && streq_safe(mnt_fs_get_root(a), mnt_fs_get_root(b))
+	    && streq_safe(mnt_fs_get_target(a), mnt_fs_get_target(b))
+	    && streq_safe(mnt_fs_get_fstype(a), mnt_fs_get_fstype(b))
+	    && streq_safe(mnt_fs_get_options(a), mnt_fs_get_options(b))
+	    && streq_safe(mnt_fs_get_vfs_options(a), mnt_fs_get_vfs_options(b))
+	    && streq_safe(mnt_fs_get_fs_options(a), mnt_fs_get_fs_options(b))
+	    && streq_safe(mnt_fs_get_optional_fields(a), mnt_fs_get_optional_fields(b));
+}
+
+/* parses synthetic mountinfo by the standard, zero-copy and lazy parsers */
+static int test_bench_parse(struct libmnt_test *ts __attribute__((unused)),
+			    int argc, char *argv[])
+{
+	static const char *names[] = { "standard:", "zerocopy:", "lazy:" };
+	struct libmnt_table *tbs[3] = { NULL, NULL, NULL };
+	struct libmnt_iter *itr[3] = { NULL, NULL, NULL };
+	struct libmnt_fs *fs[3];
+	size_t i, nlines = 100000;
+	int rc = -1;
+	FILE *f;
+
+	if (argc == 2)
+		nlines = strtou32_or_err(argv[1], "failed to parse number of lines");
+
+	f = tmpfile();
+	if (!f)
+		return -errno;
+
+	fprintf(f, "1 0 8:1 / / rw,relatime shared:1 - ext4 /dev/sda1 rw\n");
+	for (i = 2; i < nlines + 1; i++)
+		fprintf(f, "%zu %zu 0:%zu / /run/user/1000/test\\040dir/%zu rw,nosuid,nodev,relatime "
+			   "shared:%zu master:1 - tmpfs tmpfs%zu rw,size=1024k,mode=755,uid=1000\n",
+			   i, i / 2, i % 256, i, i, i);
+	fflush(f);
+
+	for (i = 0; i < ARRAY_SIZE(tbs); i++) {
+		struct timeval start, end;
+
+		rewind(f);
+		tbs[i] = mnt_new_table();
+		itr[i] = mnt_new_iter(MNT_ITER_FORWARD);
+		if (!tbs[i] || !itr[i])
+			goto done;
+		mnt_table_enable_zerocopy(tbs[i], i == 1);
+		mnt_table_enable_lazy_parse(tbs[i], i == 2);
+
+		gettimeofday(&start, NULL);
+		if (mnt_table_parse_stream(tbs[i], f, "synthetic") != 0)
+			goto done;
+		gettimeofday(&end, NULL);
+
+		printf("%-9s %d entries, %.3f ms\n", names[i],
+			mnt_table_get_nents(tbs[i]),
+			(end.tv_sec - start.tv_sec) * 1000.0 +
+			(end.tv_usec - start.tv_usec) / 1000.0);
+	}
+
+	while (mnt_table_next_fs(tbs[0], itr[0], &fs[0]) == 0) {
+		for (i = 1; i < ARRAY_SIZE(tbs); i++) {
+			if (mnt_table_next_fs(tbs[i], itr[i], &fs[i]) != 0
+			    || !is_same_fs(fs[0], fs[i])) {
+				fprintf(stderr, "%s: %s tables are not the same\n",
+						mnt_fs_get_target(fs[0]), names[i]);
+				goto done;
+			}
+		}
+	}
+	rc = 0;
+done:
+	for (i = 0; i < ARRAY_SIZE(tbs); i++) {
+		mnt_free_iter(itr[i]);
+		mnt_unref_table(tbs[i]);
+	}
+	fclose(f);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
-	{ "--parse",    test_parse,        "<file> [--comments] parse and print tab" },
+	{ "--parse",    test_parse,        "<file> [--comments|--zerocopy|--lazy] parse and print tab" },
+	{ "--parse-dir", test_parse_dir,   "<dir>  parse directory twice (by cache)" },
+	{ "--bench-parse", test_bench_parse, "[<lines>] parse synthetic mountinfo" },
 	{ "--find-forward",  test_find_fw, "<file> <source|target> <string>" },
 	{ "--find-backward", test_find_bw, "<file> <source|target> <string>" },
 	{ "--uniq-target",   test_uniq,    "<file>" },
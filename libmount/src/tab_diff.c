@@ -124,7 +124,7 @@ int mnt_tabdiff_next_change(struct libmnt_tabdiff *df, struct libmnt_iter *itr,
 	return rc;
 }
 
-static int tabdiff_reset(struct libmnt_tabdiff *df)
+int __mnt_tabdiff_reset(struct libmnt_tabdiff *df)
 {
 	assert(df);
 
@@ -150,8 +150,8 @@ static int tabdiff_reset(struct libmnt_tabdiff *df)
 	return 0;
 }
 
-static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
-			     struct libmnt_fs *new, int oper)
+int __mnt_tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
+			    struct libmnt_fs *new, int oper)
 {
 	struct tabdiff_entry *de;
 
@@ -186,30 +186,83 @@ static int tabdiff_add_entry(struct libmnt_tabdiff *df, struct libmnt_fs *old,
 	return 0;
 }
 
-static struct tabdiff_entry *tabdiff_get_mount(struct libmnt_tabdiff *df,
+/* newly mounted entry, the array is sorted by mount ID and changes order */
+struct tabdiff_mount {
+	int			id;
+	size_t			pos;
+	struct tabdiff_entry	*de;
+};
+
+static int cmp_tabdiff_mounts(const void *a, const void *b)
+{
+	const struct tabdiff_mount *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+static struct tabdiff_entry *tabdiff_get_mount(struct tabdiff_mount *mounts,
+					       size_t nmounts,
 					       const char *src,
 					       int id)
 {
-	struct list_head *p;
+	size_t lo = 0, hi = nmounts;
 
-	assert(df);
+	/* the first entry with the ID */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
 
-	list_for_each(p, &df->changes) {
-		struct tabdiff_entry *de;
+		if (mounts[mid].id < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-		de = list_entry(p, struct tabdiff_entry, changes);
+	for (; lo < nmounts && mounts[lo].id == id; lo++) {
+		struct tabdiff_entry *de = mounts[lo].de;
+		const char *s;
 
-		if (de->oper == MNT_TABDIFF_MOUNT && de->new_fs &&
-		    mnt_fs_get_id(de->new_fs) == id) {
+		if (de->oper != MNT_TABDIFF_MOUNT)
+			continue;	/* already used for MOVE */
 
-			const char *s = mnt_fs_get_source(de->new_fs);
+		s = mnt_fs_get_source(de->new_fs);
+		if (s == NULL && src == NULL)
+			return de;
+		if (s && src && strcmp(s, src) == 0)
+			return de;
+	}
+	return NULL;
+}
 
-			if (s == NULL && src == NULL)
-				return de;
-			if (s && src && strcmp(s, src) == 0)
-				return de;
-		}
+/*
+ * The same as mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD), but the
+ * native target is searched by the table index, so the diff is not quadratic
+ * for large tables.
+ */
+static struct libmnt_fs *tabdiff_find_pair(struct libmnt_table *tb,
+					   const char *src, const char *tgt)
+{
+	struct libmnt_tabidx_iter it;
+	struct libmnt_fs *fs;
+
+	if (!src || !*src || !tgt || !*tgt)
+		return NULL;
+
+	if (__mnt_table_index_begin(tb, MNT_TABIDX_TARGET,
+				    __mnt_tabidx_path_key(tgt),
+				    MNT_ITER_FORWARD, &it) != 0)
+		return mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD);
+
+	while ((fs = __mnt_table_index_next(&it))) {
+		if (mnt_fs_streq_target(fs, tgt)
+		    && mnt_fs_match_source(fs, src, tb->cache))
+			return fs;
 	}
+
+	/* canonicalized paths */
+	if (tb->cache)
+		return mnt_table_find_pair(tb, src, tgt, MNT_ITER_FORWARD);
 	return NULL;
 }
 
@@ -229,12 +282,14 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 {
 	struct libmnt_fs *fs;
 	struct libmnt_iter itr;
+	struct tabdiff_mount *mounts = NULL;
+	size_t nmounts = 0;
 	int no, nn;
 
 	if (!df || !old_tab || !new_tab)
 		return -EINVAL;
 
-	tabdiff_reset(df);
+	__mnt_tabdiff_reset(df);
 
 	no = mnt_table_get_nents(old_tab);
 	nn = mnt_table_get_nents(new_tab);
@@ -251,26 +306,37 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 	/* all mounted or umounted */
 	if (!no && nn) {
 		while(mnt_table_next_fs(new_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
+			__mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
 		goto done;
 
 	} else if (no && !nn) {
 		while(mnt_table_next_fs(old_tab, &itr, &fs) == 0)
-			tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+			__mnt_tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		goto done;
 	}
 
+	mounts = malloc(nn * sizeof(struct tabdiff_mount));
+	if (!mounts)
+		return -ENOMEM;
+
 	/* search newly mounted or modified */
 	while(mnt_table_next_fs(new_tab, &itr, &fs) == 0) {
 		struct libmnt_fs *o_fs;
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		o_fs = mnt_table_find_pair(old_tab, src, tgt, MNT_ITER_FORWARD);
-		if (!o_fs)
+		o_fs = tabdiff_find_pair(old_tab, src, tgt);
+		if (!o_fs) {
 			/* 'fs' is not in the old table -- so newly mounted */
-			tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT);
-		else {
+			if (__mnt_tabdiff_add_entry(df, NULL, fs, MNT_TABDIFF_MOUNT) == 0) {
+				struct tabdiff_mount *m = &mounts[nmounts];
+
+				m->id = mnt_fs_get_id(fs);
+				m->pos = nmounts++;
+				m->de = list_last_entry(&df->changes,
+						struct tabdiff_entry, changes);
+			}
+		} else {
 			/* is modified? */
 			const char *v1 = mnt_fs_get_vfs_options(o_fs),
 				   *v2 = mnt_fs_get_vfs_options(fs),
@@ -278,29 +344,32 @@ int mnt_diff_tables(struct libmnt_tabdiff *df, struct libmnt_table *old_tab,
 				   *f2 = mnt_fs_get_fs_options(fs);
 
 			if ((v1 && v2 && strcmp(v1, v2) != 0) || (f1 && f2 && strcmp(f1, f2) != 0))
-				tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
+				__mnt_tabdiff_add_entry(df, o_fs, fs, MNT_TABDIFF_REMOUNT);
 		}
 	}
 
+	qsort(mounts, nmounts, sizeof(struct tabdiff_mount), cmp_tabdiff_mounts);
+
 	/* search umounted or moved */
 	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 	while(mnt_table_next_fs(old_tab, &itr, &fs) == 0) {
 		const char *src = mnt_fs_get_source(fs),
 			   *tgt = mnt_fs_get_target(fs);
 
-		if (!mnt_table_find_pair(new_tab, src, tgt, MNT_ITER_FORWARD)) {
+		if (!tabdiff_find_pair(new_tab, src, tgt)) {
 			struct tabdiff_entry *de;
 
-			de = tabdiff_get_mount(df, src,	mnt_fs_get_id(fs));
+			de = tabdiff_get_mount(mounts, nmounts, src, mnt_fs_get_id(fs));
 			if (de) {
 				mnt_ref_fs(fs);
 				mnt_unref_fs(de->old_fs);
 				de->oper = MNT_TABDIFF_MOVE;
 				de->old_fs = fs;
 			} else
-				tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
+				__mnt_tabdiff_add_entry(df, fs, NULL, MNT_TABDIFF_UMOUNT);
 		}
 	}
+	free(mounts);
 done:
 	DBG(DIFF, ul_debugobj(df, "%d changes detected", df->nchanges));
 	return df->nchanges;
@@ -308,27 +377,10 @@ done:
 
 #ifdef TEST_PROGRAM
 
-static int test_diff(struct libmnt_test *ts, int argc, char *argv[])
+static void print_changes(struct libmnt_tabdiff *diff, struct libmnt_iter *itr)
 {
-	struct libmnt_table *tb_old, *tb_new;
-	struct libmnt_tabdiff *diff;
-	struct libmnt_iter *itr;
 	struct libmnt_fs *old, *new;
-	int rc = -1, change;
-
-	tb_old = mnt_new_table_from_file(argv[1]);
-	tb_new = mnt_new_table_from_file(argv[2]);
-	diff = mnt_new_tabdiff();
-	itr = mnt_new_iter(MNT_ITER_FORWARD);
-
-	if (!tb_old || !tb_new || !diff || !itr) {
-		warnx("failed to allocate resources");
-		goto done;
-	}
-
-	rc = mnt_diff_tables(diff, tb_old, tb_new);
-	if (rc < 0)
-		goto done;
+	int change;
 
 	while(mnt_tabdiff_next_change(diff, itr, &old, &new, &change) == 0) {
 
@@ -350,11 +402,39 @@ static int test_diff(struct libmnt_test *ts, int argc, char *argv[])
 		case MNT_TABDIFF_MOUNT:
 			printf("MOUNTED\n");
 			break;
+		case MNT_TABDIFF_PROPAGATION:
+			printf("PROPAGATION changed from '%s' to '%s'\n",
+					mnt_fs_get_optional_fields(old),
+					mnt_fs_get_optional_fields(new));
+			break;
 		default:
 			printf("unknown change!\n");
 		}
 	}
+}
+
+static int test_diff(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb_old, *tb_new;
+	struct libmnt_tabdiff *diff;
+	struct libmnt_iter *itr;
+	int rc = -1;
+
+	tb_old = mnt_new_table_from_file(argv[1]);
+	tb_new = mnt_new_table_from_file(argv[2]);
+	diff = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+
+	if (!tb_old || !tb_new || !diff || !itr) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	rc = mnt_diff_tables(diff, tb_old, tb_new);
+	if (rc < 0)
+		goto done;
 
+	print_changes(diff, itr);
 	rc = 0;
 done:
 	mnt_unref_table(tb_old);
@@ -364,10 +444,40 @@ done:
 	return rc;
 }
 
+static int test_refresh(struct libmnt_test *ts, int argc, char *argv[])
+{
+	struct libmnt_table *tb;
+	struct libmnt_tabdiff *diff;
+	struct libmnt_iter *itr;
+	int rc = -1;
+
+	tb = mnt_new_table_from_file(argv[1]);
+	diff = mnt_new_tabdiff();
+	itr = mnt_new_iter(MNT_ITER_FORWARD);
+
+	if (!tb || !diff || !itr) {
+		warnx("failed to allocate resources");
+		goto done;
+	}
+
+	rc = mnt_table_refresh(tb, argv[2], diff);
+	if (rc < 0)
+		goto done;
+
+	print_changes(diff, itr);
+	rc = 0;
+done:
+	mnt_unref_table(tb);
+	mnt_free_tabdiff(diff);
+	mnt_free_iter(itr);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	struct libmnt_test tss[] = {
 		{ "--diff", test_diff, "<old> <new> prints change" },
+		{ "--refresh", test_refresh, "<old> <new> refreshes <old> table, prints change" },
 		{ NULL }
 	};
 
@@ -0,0 +1,217 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * This file is part of libmount from util-linux project.
+ *
+ * libmount is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Lookup indexes for mnt_table_find_*() functions.
+ *
+ * The index is a sorted array of (key, position, fs) triplets. It's built on
+ * the first lookup and dropped on any table change (add, insert, move or
+ * remove entry) or if the indexed field is modified. The key is a hash for
+ * paths, so the caller has to compare the found entries by the usual
+ * mnt_fs_streq_*() functions. The entries with the same key are sorted by
+ * the table position, so the lookup returns the entries in the same order as
+ * mnt_table_next_fs().
+ *
+ * The small tables are not indexed, the linear search is fast enough there.
+ */
+#include "mountP.h"
+
+#define MNT_TABIDX_MINENTS	32
+
+static const char *tabidx_names[] = {
+	[MNT_TABIDX_TARGET]  = "target",
+	[MNT_TABIDX_SRCPATH] = "srcpath",
+	[MNT_TABIDX_ID]      = "id",
+	[MNT_TABIDX_PARENT]  = "parent",
+	[MNT_TABIDX_DEVNO]   = "devno"
+};
+
+void __mnt_table_reset_index(struct libmnt_table *tb)
+{
+	size_t i;
+
+	for (i = 0; i < MNT_TABIDX_COUNT; i++) {
+		struct libmnt_tabidx *x = &tb->idx[i];
+
+		if (!x->built)
+			continue;
+		free(x->ents);
+		x->ents = NULL;
+		x->nents = 0;
+		x->built = 0;
+	}
+	tb->idx_ntags = 0;
+}
+
+/*
+ * FNV-1a hash of the path. The redundant slashes are ignored in the same way
+ * as by streq_paths(), so the equal paths have the same key.
+ */
+uint64_t __mnt_tabidx_path_key(const char *path)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	const char *p;
+
+	for (p = path; p && *p; p++) {
+		if (*p == '/' && (*(p + 1) == '/' || *(p + 1) == '\0'))
+			continue;
+		h = (h ^ (unsigned char) *p) * 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/* returns 1 if @fs is indexed, the key is returned by @key */
+static int get_fs_key(struct libmnt_fs *fs, int type, uint64_t *key)
+{
+	const char *p;
+
+	switch (type) {
+	case MNT_TABIDX_TARGET:
+		p = mnt_fs_get_target(fs);
+		if (!p)
+			return 0;
+		*key = __mnt_tabidx_path_key(p);
+		break;
+	case MNT_TABIDX_SRCPATH:
+		p = mnt_fs_get_srcpath(fs);
+		if (!p)
+			return 0;
+		*key = __mnt_tabidx_path_key(p);
+		break;
+	case MNT_TABIDX_ID:
+		*key = (uint64_t) mnt_fs_get_id(fs);
+		break;
+	case MNT_TABIDX_PARENT:
+		*key = (uint64_t) mnt_fs_get_parent_id(fs);
+		break;
+	case MNT_TABIDX_DEVNO:
+		*key = (uint64_t) mnt_fs_get_devno(fs);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+static int cmp_tabidx_ents(const void *a, const void *b)
+{
+	const struct libmnt_tabidx_ent *x = a, *y = b;
+
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+static int build_index(struct libmnt_table *tb, int type)
+{
+	struct libmnt_tabidx *x = &tb->idx[type];
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	size_t pos = 0;
+
+	x->ents = malloc(tb->nents * sizeof(struct libmnt_tabidx_ent));
+	if (!x->ents)
+		return -ENOMEM;
+	x->nents = 0;
+
+	if (type == MNT_TABIDX_SRCPATH)
+		tb->idx_ntags = 0;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		struct libmnt_tabidx_ent *e = &x->ents[x->nents];
+
+		if (type == MNT_TABIDX_SRCPATH && mnt_fs_get_tag(fs, NULL, NULL) == 0)
+			tb->idx_ntags++;
+
+		if (get_fs_key(fs, type, &e->key)) {
+			e->pos = pos;
+			e->fs = fs;
+			x->nents++;
+		}
+		pos++;
+	}
+
+	qsort(x->ents, x->nents, sizeof(struct libmnt_tabidx_ent), cmp_tabidx_ents);
+	x->built = 1;
+
+	DBG(TAB, ul_debugobj(tb, "built %s index [entries=%zu]",
+				tabidx_names[type], x->nents));
+	return 0;
+}
+
+/*
+ * Initializes @it for the table entries with @key. Returns 1 if the table is
+ * not indexed, then the caller is expected to use the linear search.
+ */
+int __mnt_table_index_begin(struct libmnt_table *tb, int type, uint64_t key,
+			    int direction, struct libmnt_tabidx_iter *it)
+{
+	struct libmnt_tabidx *x;
+	size_t lo, hi;
+
+	assert(tb);
+	assert(it);
+	assert(type >= 0 && type < MNT_TABIDX_COUNT);
+
+	if (tb->nents < MNT_TABIDX_MINENTS)
+		return 1;
+
+	x = &tb->idx[type];
+	if (!x->built && build_index(tb, type) != 0)
+		return 1;
+
+	memset(it, 0, sizeof(*it));
+	it->direction = direction;
+
+	/* the first entry with the key */
+	lo = 0, hi = x->nents;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (x->ents[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == x->nents || x->ents[lo].key != key)
+		return 0;		/* not found */
+
+	it->first = &x->ents[lo];
+
+	/* the last entry with the key */
+	hi = x->nents;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (x->ents[mid].key <= key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	it->last = &x->ents[lo - 1];
+	it->cur = direction == MNT_ITER_BACKWARD ? it->last : it->first;
+	return 0;
+}
+
+/* returns the next entry with the key or NULL at the end */
+struct libmnt_fs *__mnt_table_index_next(struct libmnt_tabidx_iter *it)
+{
+	struct libmnt_fs *fs;
+
+	if (!it->cur)
+		return NULL;
+
+	fs = it->cur->fs;
+
+	if (it->direction == MNT_ITER_BACKWARD)
+		it->cur = it->cur == it->first ? NULL : it->cur - 1;
+	else
+		it->cur = it->cur == it->last ? NULL : it->cur + 1;
+	return fs;
+}
@@ -0,0 +1,398 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * This file is part of libmount from util-linux project.
+ *
+ * libmount is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * Reads the mount table of the current namespace by listmount(2) and
+ * statmount(2) rather than by parsing /proc/self/mountinfo. The result is
+ * the same as from the mountinfo parser, but the kernel does not have to
+ * format (and libmount parse) megabytes of text on systems with many mounts.
+ *
+ * The backend is used for /proc/self/mountinfo only and it has to be enabled
+ * by LIBMOUNT_STATMOUNT=1 environment variable. It's not faster than the
+ * mountinfo parser for complete mount table reads (the syscalls are per
+ * mount and the libmnt_fs setup costs the same), but the mounts are listed
+ * by the stable unique IDs, so the result is not affected by mount table
+ * changes during the read.
+ */
+#include <sys/sysmacros.h>
+
+#include "mountP.h"
+#include "env.h"
+#include "mangle.h"
+#include "pathnames.h"
+#include "strutils.h"
+#include "mount-api-utils.h"
+#include "ulstats.h"
+
+#ifdef UL_HAVE_STATMOUNT
+
+#define LISTMOUNT_NIDS		512
+#define STATMOUNT_BUFSIZ	4096
+
+/* the kernel propagation flags (mnt_propagation) */
+#ifndef MS_UNBINDABLE
+# define MS_UNBINDABLE	(1<<17)
+#endif
+#ifndef MS_SLAVE
+# define MS_SLAVE	(1<<19)
+#endif
+#ifndef MS_SHARED
+# define MS_SHARED	(1<<20)
+#endif
+
+/* all required to get the same result as from mountinfo */
+#define STATMOUNT_MASK	(UL_STATMOUNT_SB_BASIC | UL_STATMOUNT_MNT_BASIC | \
+			 UL_STATMOUNT_PROPAGATE_FROM | UL_STATMOUNT_MNT_ROOT | \
+			 UL_STATMOUNT_MNT_POINT | UL_STATMOUNT_FS_TYPE | \
+			 UL_STATMOUNT_MNT_OPTS | UL_STATMOUNT_FS_SUBTYPE | \
+			 UL_STATMOUNT_SB_SOURCE)
+
+static int statmount_unsupported;
+
+/* mountinfo[6] */
+static char *statmount_vfs_options(const struct ul_statmount *sm)
+{
+	char buf[128];
+	uint64_t attr = sm->mnt_attr;
+
+	snprintf(buf, sizeof(buf), "%s%s%s%s%s%s%s%s%s",
+		attr & UL_MOUNT_ATTR_RDONLY ? "ro" : "rw",
+		attr & UL_MOUNT_ATTR_NOSUID ? ",nosuid" : "",
+		attr & UL_MOUNT_ATTR_NODEV ? ",nodev" : "",
+		attr & UL_MOUNT_ATTR_NOEXEC ? ",noexec" : "",
+		(attr & UL_MOUNT_ATTR__ATIME) == UL_MOUNT_ATTR_NOATIME ? ",noatime" : "",
+		attr & UL_MOUNT_ATTR_NODIRATIME ? ",nodiratime" : "",
+		(attr & UL_MOUNT_ATTR__ATIME) == UL_MOUNT_ATTR_RELATIME ? ",relatime" : "",
+		attr & UL_MOUNT_ATTR_NOSYMFOLLOW ? ",nosymfollow" : "",
+		attr & UL_MOUNT_ATTR_IDMAP ? ",idmapped" : "");
+	return strdup(buf);
+}
+
+/* mountinfo[7], returns 0 and NULL if there are no optional fields */
+static int statmount_opt_fields(const struct ul_statmount *sm, char **res)
+{
+	char buf[128], *p = buf;
+	size_t sz = sizeof(buf);
+	int n;
+
+	*buf = '\0';
+	if (sm->mnt_propagation & MS_SHARED) {
+		n = snprintf(p, sz, " shared:%" PRIu64, sm->mnt_peer_group);
+		p += n, sz -= n;
+	}
+	if (sm->mnt_propagation & MS_SLAVE) {
+		n = snprintf(p, sz, " master:%" PRIu64, sm->mnt_master);
+		p += n, sz -= n;
+		if (sm->propagate_from && sm->propagate_from != sm->mnt_master) {
+			n = snprintf(p, sz, " propagate_from:%" PRIu64, sm->propagate_from);
+			p += n, sz -= n;
+		}
+	}
+	if (sm->mnt_propagation & MS_UNBINDABLE)
+		snprintf(p, sz, " unbindable");
+
+	*res = NULL;
+	if (!*buf)
+		return 0;
+	*res = strdup(buf + 1);
+	return *res ? 0 : -ENOMEM;
+}
+
+/* mountinfo[11] */
+static char *statmount_fs_options(const struct ul_statmount *sm)
+{
+	char buf[64];
+	char *res = NULL;
+
+	snprintf(buf, sizeof(buf), "%s%s%s%s",
+		sm->sb_flags & UL_SB_RDONLY ? "ro" : "rw",
+		sm->sb_flags & UL_SB_SYNCHRONOUS ? ",sync" : "",
+		sm->sb_flags & UL_SB_DIRSYNC ? ",dirsync" : "",
+		sm->sb_flags & UL_SB_LAZYTIME ? ",lazytime" : "");
+
+	if (!(sm->mask & UL_STATMOUNT_MNT_OPTS) || !*(sm->str + sm->mnt_opts))
+		return strdup(buf);
+
+	/* the options are escaped in the same way as in mountinfo */
+	if (strappend(&res, buf) || strappend(&res, ",")
+	    || strappend(&res, sm->str + sm->mnt_opts)) {
+		free(res);
+		return NULL;
+	}
+	unmangle_string(res);
+	return res;
+}
+
+static int statmount_to_fs(struct libmnt_fs *fs, const struct ul_statmount *sm)
+{
+	const char *type, *src;
+	char *p;
+	int rc;
+
+	fs->flags |= MNT_FS_KERNEL;
+
+	fs->id = sm->mnt_id_old;
+	fs->parent = sm->mnt_parent_id_old;
+	fs->devno = makedev(sm->sb_dev_major, sm->sb_dev_minor);
+
+	fs->root = strdup(sm->str + sm->mnt_root);
+	fs->target = strdup(sm->str + sm->mnt_point);
+	if (!fs->root || !fs->target)
+		return -ENOMEM;
+
+	/* remove " (deleted)" suffix */
+	p = (char *) endswith(fs->target, PATH_DELETED_SUFFIX);
+	if (p && *p)
+		*p = '\0';
+
+	fs->vfs_optstr = statmount_vfs_options(sm);
+	if (!fs->vfs_optstr)
+		return -ENOMEM;
+	rc = statmount_opt_fields(sm, &fs->opt_fields);
+	if (rc)
+		return rc;
+
+	/* "type.subtype" as in mountinfo */
+	type = sm->str + sm->fs_type;
+	if (sm->mask & UL_STATMOUNT_FS_SUBTYPE) {
+		p = NULL;
+		if (asprintf(&p, "%s.%s", type, sm->str + sm->fs_subtype) < 0)
+			return -ENOMEM;
+	} else
+		p = strdup(type);
+	if (!p)
+		return -ENOMEM;
+	rc = __mnt_fs_set_fstype_ptr(fs, p);
+	if (rc) {
+		free(p);
+		return rc;
+	}
+
+	src = sm->mask & UL_STATMOUNT_SB_SOURCE ? sm->str + sm->sb_source : "none";
+	rc = mnt_fs_set_source(fs, src);
+	if (rc)
+		return rc;
+
+	fs->fs_optstr = statmount_fs_options(sm);
+	if (!fs->fs_optstr)
+		return -ENOMEM;
+
+	fs->optstr = mnt_fs_strdup_options(fs);
+	if (!fs->optstr)
+		return -ENOMEM;
+	return 0;
+}
+
+/* returns 1 if the kernel does not support all the wanted fields */
+static int statmount_check_support(struct ul_statmount *sm, size_t bufsiz,
+				   uint64_t id)
+{
+	UL_STATS_CALL(UL_STATS_STAT);
+	if (ul_statmount(id, UL_STATMOUNT_SUPPORTED_MASK, sm, bufsiz) != 0) {
+		if (errno == ENOENT)
+			return -ENOENT;	/* umounted in the meantime */
+		DBG(TAB, ul_debug("statmount: failed to get supported mask"));
+		return 1;
+	}
+	if (!(sm->mask & UL_STATMOUNT_SUPPORTED_MASK)
+	    || (sm->supported_mask & STATMOUNT_MASK) != STATMOUNT_MASK) {
+		DBG(TAB, ul_debug("statmount: unsupported kernel"));
+		return 1;
+	}
+	return 0;
+}
+
+/* returns 0 on success, 1 if statmount is not usable, <0 on error */
+static int read_statmount(uint64_t id, struct ul_statmount **sm, size_t *bufsiz)
+{
+	do {
+		UL_STATS_CALL(UL_STATS_STAT);
+		if (ul_statmount(id, STATMOUNT_MASK, *sm, *bufsiz) == 0)
+			return 0;
+		if (errno == EOVERFLOW) {
+			struct ul_statmount *tmp;
+
+			tmp = realloc(*sm, *bufsiz * 2);
+			if (!tmp)
+				return -ENOMEM;
+			*sm = tmp;
+			*bufsiz *= 2;
+			continue;
+		}
+	} while (errno == EINTR);
+
+	return errno == ENOENT ? 1 : -errno;
+}
+
+/*
+ * Adds to @tb all mounts of the current namespace as visible by the current
+ * process (the same as /proc/self/mountinfo).
+ *
+ * Returns: 0 on success, 1 if listmount() or statmount() is not supported
+ *          by kernel (the caller is expected to parse mountinfo), <0 on error.
+ */
+int __mnt_table_parse_listmount(struct libmnt_table *tb)
+{
+	uint64_t ids[LISTMOUNT_NIDS], last = 0;
+	struct ul_statmount *sm = NULL;
+	size_t bufsiz = STATMOUNT_BUFSIZ;
+	int rc = 0, first = 1, nadded = 0;
+	ssize_t n, i;
+	pid_t tid = -1;
+
+	if (statmount_unsupported || !safe_getenv("LIBMOUNT_STATMOUNT"))
+		return 1;
+
+	sm = malloc(bufsiz);
+	if (!sm)
+		return -ENOMEM;
+
+	DBG(TAB, ul_debugobj(tb, "statmount: start reading"));
+
+	do {
+		UL_STATS_CALL(UL_STATS_STAT);
+		n = ul_listmount(UL_LSMT_ROOT, last, ids, LISTMOUNT_NIDS);
+		if (n < 0) {
+			rc = errno == ENOSYS || errno == EINVAL || errno == EPERM ? 1 : -errno;
+			goto err;
+		}
+		if (n > 0 && first) {
+			rc = statmount_check_support(sm, bufsiz, ids[0]);
+			if (rc)
+				goto err;
+			first = 0;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct libmnt_fs *fs;
+
+			last = ids[i];
+
+			rc = read_statmount(ids[i], &sm, &bufsiz);
+			if (rc == 1) {
+				rc = 0;
+				continue;	/* umounted in the meantime */
+			}
+			if (rc)
+				goto err;
+
+			fs = mnt_new_fs();
+			if (!fs) {
+				rc = -ENOMEM;
+				goto err;
+			}
+			rc = statmount_to_fs(fs, sm);
+			if (rc == 0 && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data)) {
+				mnt_unref_fs(fs);
+				continue;	/* filtered out by callback... */
+			}
+			if (rc == 0)
+				rc = mnt_table_add_fs(tb, fs);
+			if (rc == 0) {
+				nadded++;
+				rc = __mnt_kernel_fs_postparse(tb, fs, &tid,
+							       _PATH_PROC_MOUNTINFO);
+			}
+			mnt_unref_fs(fs);
+			if (rc)
+				goto err;
+		}
+	} while (n == LISTMOUNT_NIDS);
+
+	free(sm);
+	DBG(TAB, ul_debugobj(tb, "statmount: done (%d entries)", nadded));
+	return 0;
+err:
+	if (rc == 1)
+		statmount_unsupported = 1;
+
+	/* remove the already added entries, caller will parse mountinfo */
+	while (nadded-- > 0) {
+		struct libmnt_fs *fs = list_last_entry(&tb->ents,
+						       struct libmnt_fs, ents);
+		mnt_table_remove_fs(tb, fs);
+	}
+	free(sm);
+	DBG(TAB, ul_debugobj(tb, "statmount: failed [rc=%d]", rc));
+	return rc;
+}
+
+/*
+ * Adds to @tb the mount with the unique @id only. This is used for the mount
+ * table lookups for a known mountpoint, where the complete table is not
+ * necessary. Unlike the complete read it's not restricted by the
+ * LIBMOUNT_STATMOUNT environment variable, one statmount() call is always
+ * cheaper than to read mountinfo.
+ *
+ * Returns: 0 on success, 1 if statmount() is not supported, the mount does
+ *          not exist anymore or it's filtered out, <0 on error.
+ */
+int __mnt_table_parse_statmount(struct libmnt_table *tb, uint64_t id)
+{
+	struct ul_statmount *sm = NULL;
+	size_t bufsiz = STATMOUNT_BUFSIZ;
+	struct libmnt_fs *fs = NULL;
+	pid_t tid = -1;
+	int rc;
+
+	if (statmount_unsupported)
+		return 1;
+
+	sm = malloc(bufsiz);
+	if (!sm)
+		return -ENOMEM;
+
+	rc = statmount_check_support(sm, bufsiz, id);
+	if (rc) {
+		if (rc == 1)
+			statmount_unsupported = 1;
+		rc = 1;
+		goto done;
+	}
+	rc = read_statmount(id, &sm, &bufsiz);
+	if (rc)
+		goto done;
+
+	fs = mnt_new_fs();
+	if (!fs) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	rc = statmount_to_fs(fs, sm);
+	if (rc == 0 && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data)) {
+		rc = 1;		/* not the wanted one, read all */
+		goto done;
+	}
+	if (rc == 0)
+		rc = mnt_table_add_fs(tb, fs);
+	if (rc == 0) {
+		rc = __mnt_kernel_fs_postparse(tb, fs, &tid, _PATH_PROC_MOUNTINFO);
+		if (rc)
+			mnt_table_remove_fs(tb, fs);
+	}
+done:
+	mnt_unref_fs(fs);
+	free(sm);
+	DBG(TAB, ul_debugobj(tb, "statmount: mount %" PRIu64 " [rc=%d]", id, rc));
+	return rc;
+}
+
+#else /* !UL_HAVE_STATMOUNT */
+
+int __mnt_table_parse_listmount(struct libmnt_table *tb __attribute__((__unused__)))
+{
+	return 1;
+}
+
+int __mnt_table_parse_statmount(struct libmnt_table *tb __attribute__((__unused__)),
+				uint64_t id __attribute__((__unused__)))
+{
+	return 1;
+}
+
+#endif
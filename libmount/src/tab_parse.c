@@ -20,12 +20,16 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
 
 #include "fileutils.h"
 #include "mangle.h"
 #include "mountP.h"
 #include "pathnames.h"
 #include "strutils.h"
+#include "ulstats.h"
 
 struct libmnt_parser {
 	FILE	*f;		/* fstab, mtab, swaps or mountinfo ... */
@@ -33,6 +37,8 @@ struct libmnt_parser {
 	char	*buf;		/* buffer (the current line content) */
 	size_t	bufsiz;		/* size of the buffer */
 	size_t	line;		/* current line */
+
+	unsigned int deleted :1;	/* utab journal removed entry record */
 };
 
 static void parser_cleanup(struct libmnt_parser *pa)
@@ -174,12 +180,65 @@ fail:
 
 
 /*
- * Parses one line from a mountinfo file
+ * Like unmangle(), but the result is stored to the per-entry string buffer
+ * if enabled by mnt_table_enable_zerocopy() and there is enough space.
+ */
+static char *unmangle_field(struct libmnt_fs *fs, size_t *used,
+			    const char *s, const char **end)
+{
+	const char *e;
+	char *res;
+	size_t sz;
+
+	if (!fs->strbuf || !s)
+		return unmangle(s, end);
+
+	for (e = s; *e && *e != ' ' && *e != '\t'; e++);
+	if (end)
+		*end = e;
+	if (e == s)
+		return NULL;	/* empty string */
+
+	sz = e - s + 1;
+	if (*used + sz > fs->strbufsz)
+		return unmangle(s, NULL);
+
+	res = fs->strbuf + *used;
+	unmangle_to_buffer(s, res, sz);
+	*used += strlen(res) + 1;
+	return res;
+}
+
+static char *strndup_field(struct libmnt_fs *fs, size_t *used,
+			   const char *s, size_t len)
+{
+	char *res;
+
+	if (!fs->strbuf || *used + len + 1 > fs->strbufsz)
+		return strndup(s, len);
+
+	res = fs->strbuf + *used;
+	memcpy(res, s, len);
+	res[len] = '\0';
+	*used += len + 1;
+	return res;
+}
+
+static void free_field(struct libmnt_fs *fs, char *str)
+{
+	if (!__mnt_fs_is_strbuf(fs, str))
+		free(str);
+}
+
+/*
+ * Parses one line from a mountinfo file. The root, options and optional
+ * fields are skipped if @lazy is set, see __mnt_fs_parse_lazy().
  */
-static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
+static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s, int lazy)
 {
 	int rc = 0;
 	unsigned int maj, min;
+	size_t used = 0;
 	char *p;
 
 	fs->flags |= MNT_FS_KERNEL;
@@ -212,8 +271,11 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
 	s = skip_separator(s);
 
 	/* (4) mountroot */
-	fs->root = unmangle(s, &s);
-	if (!fs->root) {
+	if (lazy)
+		s = skip_nonspearator(s);
+	else
+		fs->root = unmangle_field(fs, &used, s, &s);
+	if (!lazy && !fs->root) {
 		DBG(TAB, ul_debug("tab parse error: [mountroot]"));
 		goto fail;
 	}
@@ -221,7 +283,7 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
 	s = skip_separator(s);
 
 	/* (5) target */
-	fs->target = unmangle(s, &s);
+	fs->target = unmangle_field(fs, &used, s, &s);
 	if (!fs->target) {
 		DBG(TAB, ul_debug("tab parse error: [target]"));
 		goto fail;
@@ -235,8 +297,11 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
 	s = skip_separator(s);
 
 	/* (6) vfs options (fs-independent) */
-	fs->vfs_optstr = unmangle(s, &s);
-	if (!fs->vfs_optstr) {
+	if (lazy)
+		s = skip_nonspearator(s);
+	else
+		fs->vfs_optstr = unmangle_field(fs, &used, s, &s);
+	if (!lazy && !fs->vfs_optstr) {
 		DBG(TAB, ul_debug("tab parse error: [VFS options]"));
 		goto fail;
 	}
@@ -247,16 +312,16 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
 		DBG(TAB, ul_debug("mountinfo parse error: separator not found"));
 		return -EINVAL;
 	}
-	if (p > s + 1)
-		fs->opt_fields = strndup(s + 1, p - s - 1);
+	if (!lazy && p > s + 1)
+		fs->opt_fields = strndup_field(fs, &used, s + 1, p - s - 1);
 
 	s = skip_separator(p + 3);
 
 	/* (8) FS type */
-	p = unmangle(s, &s);
+	p = unmangle_field(fs, &used, s, &s);
 	if (!p || (rc = __mnt_fs_set_fstype_ptr(fs, p))) {
 		DBG(TAB, ul_debug("tab parse error: [fstype]"));
-		free(p);
+		free_field(fs, p);
 		goto fail;
 	}
 
@@ -265,31 +330,37 @@ static int mnt_parse_mountinfo_line(struct libmnt_fs *fs, const char *s)
 		DBG(TAB, ul_debug("tab parse error: [source]"));
 		goto fail;
 	} else if (*s == ' ' && *(s+1) == ' ') {
-		if ((rc = mnt_fs_set_source(fs, ""))) {
+		p = strndup_field(fs, &used, "", 0);
+		if (!p || (rc = __mnt_fs_set_source_ptr(fs, p))) {
 			DBG(TAB, ul_debug("tab parse error: [empty source]"));
+			free_field(fs, p);
 			goto fail;
 		}
 	} else {
 		s = skip_separator(s);
-		p = unmangle(s, &s);
+		p = unmangle_field(fs, &used, s, &s);
 		if (!p || (rc = __mnt_fs_set_source_ptr(fs, p))) {
 			DBG(TAB, ul_debug("tab parse error: [regular source]"));
-			free(p);
+			free_field(fs, p);
 			goto fail;
 		}
 	}
 
+	if (lazy)
+		return 0;
+
 	s = skip_separator(s);
 
 	/* (10) fs options (fs specific) */
-	fs->fs_optstr = unmangle(s, &s);
+	fs->fs_optstr = unmangle_field(fs, &used, s, &s);
 	if (!fs->fs_optstr) {
 		DBG(TAB, ul_debug("tab parse error: [FS options]"));
 		goto fail;
 	}
 
 	/* merge VFS and FS options to one string */
-	fs->optstr = mnt_fs_strdup_options(fs);
+	fs->optstr = __mnt_fs_merge_options(fs, fs->strbuf ? fs->strbuf + used : NULL,
+					    fs->strbufsz - used);
 	if (!fs->optstr) {
 		rc = -ENOMEM;
 		DBG(TAB, ul_debug("tab parse error: [merge VFS and FS options]"));
@@ -304,6 +375,57 @@ fail:
 	return rc;
 }
 
+/*
+ * Parses the fields skipped by the lazy mountinfo parser (see
+ * mnt_table_enable_lazy_parse()). The line is parsed to a temporary entry
+ * and the missing fields are moved to @fs.
+ */
+int __mnt_fs_parse_lazy(struct libmnt_fs *fs)
+{
+	struct libmnt_fs *tmp;
+	char *line = fs->lazyline;
+	int rc;
+
+	if (!line)
+		return 0;
+
+	tmp = mnt_new_fs();
+	if (!tmp)
+		return -ENOMEM;
+
+	fs->lazyline = NULL;
+	rc = mnt_parse_mountinfo_line(tmp, line, 0);
+	if (rc == 0) {
+		fs->root = tmp->root;
+		fs->vfs_optstr = tmp->vfs_optstr;
+		fs->opt_fields = tmp->opt_fields;
+		fs->fs_optstr = tmp->fs_optstr;
+		fs->optstr = tmp->optstr;
+		tmp->root = tmp->vfs_optstr = tmp->opt_fields = NULL;
+		tmp->fs_optstr = tmp->optstr = NULL;
+	}
+	DBG(FS, ul_debugobj(fs, "lazy parse done [rc=%d]", rc));
+
+	mnt_unref_fs(tmp);
+	free(line);
+	return rc;
+}
+
+/*
+ * FNV-1a hash of the mountinfo line, used by mnt_table_refresh() to detect
+ * unchanged entries without parsing.
+ */
+static uint64_t mountinfo_line_hash(const char *s)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for (; *s; s++) {
+		h ^= (unsigned char) *s;
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
 /*
  * Parses one line from utab file
  */
@@ -533,6 +655,27 @@ static int append_comment(struct libmnt_table *tb,
 	return rc;
 }
 
+/*
+ * Removes the last entry with @target, used for utab journal "DEL" records.
+ */
+static void remove_utab_entry(struct libmnt_table *tb, const char *target)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+
+	if (!target)
+		return;
+
+	mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_streq_target(fs, target)) {
+			DBG(TAB, ul_debugobj(tb, "utab: removing %s", target));
+			mnt_table_remove_fs(tb, fs);
+			break;
+		}
+	}
+}
+
 /*
  * Read and parse the next line from {fs,m}tab or mountinfo
  */
@@ -599,9 +742,28 @@ next_line:
 		rc = mnt_parse_table_line(fs, s);
 		break;
 	case MNT_FMT_MOUNTINFO:
-		rc = mnt_parse_mountinfo_line(fs, s);
+		fs->linehash = mountinfo_line_hash(s);
+		if (tb->zerocopy && !fs->strbuf) {
+			/* the strings and merged options, see mnt_parse_mountinfo_line() */
+			size_t sz = 2 * strlen(s) + 6;
+
+			fs->strbuf = malloc(sz);
+			if (fs->strbuf)
+				fs->strbufsz = sz;
+		}
+		if (tb->lazy) {
+			fs->lazyline = strdup(s);
+			if (!fs->lazyline)
+				return -ENOMEM;
+		}
+		rc = mnt_parse_mountinfo_line(fs, s, tb->lazy);
 		break;
 	case MNT_FMT_UTAB:
+		pa->deleted = 0;
+		if (startswith(s, MNT_UTAB_DELETED)) {
+			pa->deleted = 1;
+			s += sizeof(MNT_UTAB_DELETED) - 1;
+		}
 		rc = mnt_parse_utab_line(fs, s);
 		break;
 	case MNT_FMT_SWAPS:
@@ -630,10 +792,15 @@ err:
 
 static pid_t path_to_tid(const char *filename)
 {
-	char *path = mnt_resolve_path(filename, NULL);
-	char *p, *end = NULL;
+	char *path, *p, *end = NULL;
 	pid_t tid = 0;
 
+	/* don't resolve the symlink to get our own PID */
+	if (strncmp(filename, "/proc/self/", 11) == 0
+	    && !strchr(filename + 11, '/'))
+		return getpid();
+
+	path = mnt_resolve_path(filename, NULL);
 	if (!path)
 		goto done;
 	p = strrchr(path, '/');
@@ -657,9 +824,9 @@ done:
 	return tid;
 }
 
-static int kernel_fs_postparse(struct libmnt_table *tb,
-			       struct libmnt_fs *fs, pid_t *tid,
-			       const char *filename)
+int __mnt_kernel_fs_postparse(struct libmnt_table *tb,
+			      struct libmnt_fs *fs, pid_t *tid,
+			      const char *filename)
 {
 	int rc = 0;
 	const char *src = mnt_fs_get_srcpath(fs);
@@ -744,6 +911,13 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 		/* parse */
 		rc = mnt_table_parse_next(&pa, tb, fs);
 
+		/* utab journal, remove the previous entry for the target */
+		if (rc == 0 && pa.deleted) {
+			remove_utab_entry(tb, mnt_fs_get_target(fs));
+			mnt_unref_fs(fs);
+			continue;
+		}
+
 		if (rc == 0 && tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
 			rc = 1;	/* filtered out by callback... */
 
@@ -753,7 +927,7 @@ int mnt_table_parse_stream(struct libmnt_table *tb, FILE *f, const char *filenam
 			fs->flags |= flags;
 
 			if (rc == 0 && tb->fmt == MNT_FMT_MOUNTINFO) {
-				rc = kernel_fs_postparse(tb, fs, &tid, filename);
+				rc = __mnt_kernel_fs_postparse(tb, fs, &tid, filename);
 				if (rc)
 					mnt_table_remove_fs(tb, fs);
 			}
@@ -805,17 +979,307 @@ int mnt_table_parse_file(struct libmnt_table *tb, const char *filename)
 	if (!filename || !tb)
 		return -EINVAL;
 
+	UL_STATS_BEGIN(UL_STATS_PARSE);
+
+	/* read the kernel mount table by syscalls rather than parse text */
+	if ((tb->fmt == MNT_FMT_GUESS || tb->fmt == MNT_FMT_MOUNTINFO)
+	    && strcmp(filename, _PATH_PROC_MOUNTINFO) == 0
+	    && ((tb->mntid_hint && __mnt_table_parse_statmount(tb, tb->mntid_hint) == 0)
+		|| __mnt_table_parse_listmount(tb) == 0)) {
+		tb->fmt = MNT_FMT_MOUNTINFO;
+		rc = 0;
+		goto done;
+	}
+
+	UL_STATS_CALL(UL_STATS_OPEN);
 	f = fopen(filename, "r" UL_CLOEXECSTR);
 	if (f) {
 		rc = mnt_table_parse_stream(tb, f, filename);
+		UL_STATS_PATH_BYTES(filename, ftello(f));
 		fclose(f);
 	} else
 		rc = -errno;
-
+done:
+	UL_STATS_END(UL_STATS_PARSE);
 	DBG(TAB, ul_debugobj(tb, "parsing done [filename=%s, rc=%d]", filename, rc));
 	return rc;
 }
 
+struct refresh_old {
+	struct libmnt_fs	*fs;
+	int			used;
+};
+
+struct refresh_idx {
+	int	id;		/* mount ID */
+	size_t	n;		/* index in refresh_old array */
+};
+
+static int cmp_refresh_idx(const void *a, const void *b)
+{
+	const struct refresh_idx *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->n < y->n ? -1 : x->n > y->n;
+}
+
+/* returns the first unused old entry with the mount @id */
+static struct refresh_old *refresh_lookup(struct refresh_old *olds,
+					  struct refresh_idx *idx, size_t nolds,
+					  int id)
+{
+	size_t lo = 0, hi = nolds;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (idx[mid].id < id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < nolds && idx[lo].id == id; lo++) {
+		if (!olds[idx[lo].n].used)
+			return &olds[idx[lo].n];
+	}
+	return NULL;
+}
+
+static int strdiff_safe(const char *a, const char *b)
+{
+	if (!a || !b)
+		return a != b;
+	return strcmp(a, b) != 0;
+}
+
+/*
+ * Adds change between @old and @new (the same mount ID) to @df. Returns 1 if
+ * modified, 0 if not, or <0 on error.
+ */
+static int refresh_add_change(struct libmnt_tabdiff *df,
+			      struct libmnt_fs *old, struct libmnt_fs *new)
+{
+	int oper;
+
+	if (!old)
+		oper = MNT_TABDIFF_MOUNT;
+	else if (strdiff_safe(old->target, new->target))
+		oper = MNT_TABDIFF_MOVE;
+	else if (strdiff_safe(mnt_fs_get_vfs_options(old), mnt_fs_get_vfs_options(new))
+		 || strdiff_safe(mnt_fs_get_fs_options(old), mnt_fs_get_fs_options(new)))
+		oper = MNT_TABDIFF_REMOUNT;
+	else if (strdiff_safe(mnt_fs_get_optional_fields(old),
+			      mnt_fs_get_optional_fields(new)))
+		oper = MNT_TABDIFF_PROPAGATION;
+	else
+		return 0;
+
+	if (df) {
+		int rc = __mnt_tabdiff_add_entry(df, old, new, oper);
+		if (rc)
+			return rc;
+	}
+	return 1;
+}
+
+/**
+ * mnt_table_refresh:
+ * @tb: mountinfo table
+ * @filename: mountinfo file or NULL for /proc/self/mountinfo
+ * @df: diff handler or NULL
+ *
+ * Updates @tb in place from the current content of the mountinfo file. The
+ * entries with unchanged mountinfo lines (matched by mount ID) are reused
+ * without parsing, only new and modified lines are parsed. This is
+ * significantly faster than parsing the whole file to a new table and
+ * mnt_diff_tables() for systems with many mounts.
+ *
+ * The table has to be empty or contain entries parsed from mountinfo. The
+ * entries modified by the caller (for example by mnt_fs_set_options()) are
+ * not detected, and the user options merged from utab (see
+ * mnt_table_parse_mtab()) are reparsed and lost.
+ *
+ * The changes are stored in @df (if not NULL) and accessible by
+ * mnt_tabdiff_next_change(); a modified entry is reported with the old and
+ * the new libmnt_fs. Contrary to mnt_diff_tables(), the mount ID is used to
+ * match the entries and propagation changes are reported as
+ * MNT_TABDIFF_PROPAGATION.
+ *
+ * The table is not modified on error.
+ *
+ * Since: 2.38
+ *
+ * Returns: number of changes, negative number in case of error.
+ */
+int mnt_table_refresh(struct libmnt_table *tb, const char *filename,
+		      struct libmnt_tabdiff *df)
+{
+	struct refresh_old *olds = NULL;
+	struct refresh_idx *idx = NULL;
+	struct libmnt_parser pa = { .line = 0 };
+	size_t i, nolds = 0;
+	pid_t tid = -1;
+	int rc = 0, nchanges = 0;
+
+	if (!tb)
+		return -EINVAL;
+	if (!filename)
+		filename = _PATH_PROC_MOUNTINFO;
+	if (!mnt_table_is_empty(tb) && tb->fmt != MNT_FMT_MOUNTINFO)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "%s: refresh [entries=%d]", filename, tb->nents));
+
+	pa.filename = filename;
+	UL_STATS_CALL(UL_STATS_OPEN);
+	pa.f = fopen(filename, "r" UL_CLOEXECSTR);
+	if (!pa.f)
+		return -errno;
+
+	UL_STATS_BEGIN(UL_STATS_PARSE);
+
+	if (tb->nents > 0) {
+		olds = calloc(tb->nents, sizeof(*olds));
+		idx = calloc(tb->nents, sizeof(*idx));
+		if (!olds || !idx) {
+			rc = -ENOMEM;
+			goto done;
+		}
+	}
+	if (df)
+		__mnt_tabdiff_reset(df);
+
+	/* detach the current entries, the table reference is moved to @olds */
+	while (!list_empty(&tb->ents)) {
+		struct libmnt_fs *fs = list_entry(tb->ents.next,
+						  struct libmnt_fs, ents);
+		list_del_init(&fs->ents);
+		fs->tab = NULL;
+		olds[nolds].fs = fs;
+		idx[nolds].id = fs->id;
+		idx[nolds].n = nolds;
+		nolds++;
+	}
+	tb->nents = 0;
+	__mnt_table_reset_index(tb);
+	tb->fmt = MNT_FMT_MOUNTINFO;
+
+	if (nolds)
+		qsort(idx, nolds, sizeof(*idx), cmp_refresh_idx);
+
+	while (getline(&pa.buf, &pa.bufsiz, pa.f) >= 0) {
+		struct refresh_old *old = NULL;
+		struct libmnt_fs *fs;
+		uint64_t hash;
+		char *s, *end = NULL;
+		int id;
+
+		pa.line++;
+		s = strchr(pa.buf, '\n');
+		if (s)
+			*s = '\0';
+		s = (char *) skip_blank(pa.buf);
+		if (!*s)
+			continue;
+
+		hash = mountinfo_line_hash(s);
+		errno = 0;
+		id = strtol(s, &end, 10);
+		if (errno == 0 && end && end != s)
+			old = refresh_lookup(olds, idx, nolds, id);
+
+		if (old && old->fs->linehash == hash
+		    && !(old->fs->flags & MNT_FS_MERGED)) {
+			/* unchanged */
+			old->used = 1;
+			rc = mnt_table_add_fs(tb, old->fs);
+			if (rc)
+				goto err;
+			continue;
+		}
+
+		fs = mnt_new_fs();
+		if (!fs) {
+			rc = -ENOMEM;
+			goto err;
+		}
+		fs->linehash = hash;
+
+		if (tb->lazy && !(fs->lazyline = strdup(s)))
+			rc = -ENOMEM;
+		else
+			rc = mnt_parse_mountinfo_line(fs, s, tb->lazy);
+		if (rc) {
+			DBG(TAB, ul_debugobj(tb, "%s:%zu: mountinfo parse error",
+						filename, pa.line));
+			rc = tb->errcb ? tb->errcb(tb, filename, pa.line) : 1;
+
+		} else if (tb->fltrcb && tb->fltrcb(fs, tb->fltrcb_data))
+			rc = 1;	/* filtered out by callback... */
+
+		if (rc == 0) {
+			rc = mnt_table_add_fs(tb, fs);
+			if (rc == 0) {
+				rc = __mnt_kernel_fs_postparse(tb, fs, &tid, filename);
+				if (rc)
+					mnt_table_remove_fs(tb, fs);
+			}
+		}
+		if (rc == 0) {
+			if (old)
+				old->used = 1;
+			rc = refresh_add_change(df, old ? old->fs : NULL, fs);
+			if (rc > 0)
+				nchanges++;
+		}
+		mnt_unref_fs(fs);
+		if (rc < 0)
+			goto err;
+	}
+	if (ferror(pa.f)) {
+		rc = -EIO;
+		goto err;
+	}
+
+	/* the unused old entries are umounted */
+	for (i = 0; i < nolds; i++) {
+		if (olds[i].used)
+			continue;
+		if (df) {
+			rc = __mnt_tabdiff_add_entry(df, olds[i].fs, NULL,
+						     MNT_TABDIFF_UMOUNT);
+			if (rc)
+				goto err;
+		}
+		nchanges++;
+	}
+
+	DBG(TAB, ul_debugobj(tb, "%s: refresh done (%d entries, %d changes)",
+				filename, tb->nents, nchanges));
+	rc = nchanges;
+	goto done;
+err:
+	DBG(TAB, ul_debugobj(tb, "%s: refresh failed (rc=%d)", filename, rc));
+
+	/* restore the original entries */
+	mnt_reset_table(tb);
+	for (i = 0; i < nolds; i++)
+		mnt_table_add_fs(tb, olds[i].fs);
+	if (df)
+		__mnt_tabdiff_reset(df);
+done:
+	for (i = 0; i < nolds; i++)
+		mnt_unref_fs(olds[i].fs);
+	free(olds);
+	free(idx);
+	UL_STATS_PATH_BYTES(filename, ftello(pa.f));
+	UL_STATS_END(UL_STATS_PARSE);
+	fclose(pa.f);
+	parser_cleanup(&pa);
+	return rc;
+}
+
 static int mnt_table_parse_dir_filter(const struct dirent *d)
 {
 	size_t namesz;
@@ -840,6 +1304,202 @@ static int mnt_table_parse_dir_filter(const struct dirent *d)
 	return 1;
 }
 
+/*
+ * Per-process cache of the parsed fstab.d files. The long-running processes
+ * (and libraries which prepare mount context repeatedly) read the same
+ * directory again and again, so the already parsed entries are reused if the
+ * file has not been changed (the same inode, size and mtime).
+ *
+ * The cache is not used for tables with a filter or comments parsing, and
+ * the files with syntax errors are never cached to call the error callback
+ * for each parsing. The cache is shared by all threads and protected by the
+ * mutex; without threads support it is not compiled at all.
+ */
+#ifdef HAVE_PTHREAD_H
+struct dircache_file {
+	char		*path;		/* <dirname>/<filename> */
+	int		fmt;
+	dev_t		dev;
+	ino_t		ino;
+	off_t		size;
+	struct timespec	mtim;
+	struct libmnt_table *tb;	/* parsed entries */
+
+	unsigned int	broken :1;	/* parse errors, the file is not cached */
+};
+
+static struct dircache_file *dircache;
+static size_t ndircache;
+static pthread_mutex_t dircache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int dircache_errcb(struct libmnt_table *tb,
+			  const char *filename __attribute__((__unused__)),
+			  int line __attribute__((__unused__)))
+{
+	tb->userdata = (void *) 1;	/* mark as broken */
+	return 1;
+}
+
+static struct dircache_file *dircache_get(const char *path)
+{
+	struct dircache_file *tmp;
+	size_t i;
+
+	for (i = 0; i < ndircache; i++) {
+		if (strcmp(dircache[i].path, path) == 0)
+			return &dircache[i];
+	}
+
+	tmp = realloc(dircache, (ndircache + 1) * sizeof(*dircache));
+	if (!tmp)
+		return NULL;
+	dircache = tmp;
+	tmp = &dircache[ndircache];
+	memset(tmp, 0, sizeof(*tmp));
+	tmp->path = strdup(path);
+	if (!tmp->path)
+		return NULL;
+	ndircache++;
+	return tmp;
+}
+
+static int dircache_is_valid(struct dircache_file *c, struct libmnt_table *tb,
+			     struct stat *st)
+{
+	return (c->tb || c->broken) && c->fmt == tb->fmt
+		&& c->dev == st->st_dev && c->ino == st->st_ino
+		&& c->size == st->st_size
+		&& c->mtim.tv_sec == st->st_mtim.tv_sec
+		&& c->mtim.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/* parses @name to the private table; returns NULL on error or broken file */
+static struct libmnt_table *dircache_parse(struct libmnt_table *tb, int dd,
+					   const char *name)
+{
+	struct libmnt_table *ctb;
+	FILE *f;
+
+	f = fopen_at(dd, name, O_RDONLY|O_CLOEXEC, "r" UL_CLOEXECSTR);
+	if (!f)
+		return NULL;
+
+	ctb = mnt_new_table();
+	if (ctb) {
+		ctb->fmt = tb->fmt;
+		ctb->errcb = dircache_errcb;
+		if (mnt_table_parse_stream(ctb, f, name) != 0 || ctb->userdata) {
+			mnt_unref_table(ctb);
+			ctb = NULL;
+		}
+	}
+	fclose(f);
+	return ctb;
+}
+
+/* adds copies of the cached entries to @tb, or nothing on error */
+static int dircache_copy(struct libmnt_table *tb, struct libmnt_table *ctb)
+{
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	int rc = 0, nents = mnt_table_get_nents(tb);
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (rc == 0 && mnt_table_next_fs(ctb, &itr, &fs) == 0) {
+		struct libmnt_fs *x = mnt_copy_fs(NULL, fs);
+
+		if (!x) {
+			rc = -ENOMEM;
+			break;
+		}
+		rc = mnt_table_add_fs(tb, x);
+		mnt_unref_fs(x);
+	}
+
+	/* remove the partial copy, the file will be parsed by caller */
+	while (rc && mnt_table_get_nents(tb) > nents
+	       && mnt_table_last_fs(tb, &fs) == 0)
+		mnt_table_remove_fs(tb, fs);
+	return rc;
+}
+
+/*
+ * Returns 0 if the entries have been added from the cache, or 1 if the file
+ * has to be parsed by the caller.
+ */
+static int parse_dir_file_cached(struct libmnt_table *tb, int dd,
+				 const char *dirname, const char *name,
+				 struct stat *st)
+{
+	struct dircache_file *c;
+	char *path = NULL;
+
+	if (tb->fltrcb || tb->comms)
+		return 1;
+	if (asprintf(&path, "%s/%s", dirname, name) < 0)
+		return 1;
+
+	pthread_mutex_lock(&dircache_lock);
+	c = dircache_get(path);
+	free(path);
+	if (!c)
+		goto nocache;
+
+	if (!dircache_is_valid(c, tb, st)) {
+		mnt_unref_table(c->tb);
+		c->tb = dircache_parse(tb, dd, name);
+		c->broken = c->tb ? 0 : 1;
+		c->fmt = tb->fmt;
+		c->dev = st->st_dev;
+		c->ino = st->st_ino;
+		c->size = st->st_size;
+		c->mtim = st->st_mtim;
+		DBG(TAB, ul_debugobj(tb, "%s/%s: %s", dirname, name,
+					c->broken ? "not cached" : "cached"));
+	}
+	if (c->broken)
+		goto nocache;
+
+	DBG(TAB, ul_debugobj(tb, "%s/%s: using cache", dirname, name));
+
+	if (dircache_copy(tb, c->tb) != 0)
+		goto nocache;
+	pthread_mutex_unlock(&dircache_lock);
+	return 0;
+nocache:
+	pthread_mutex_unlock(&dircache_lock);
+	return 1;
+}
+#else /* !HAVE_PTHREAD_H */
+static int parse_dir_file_cached(
+			struct libmnt_table *tb __attribute__((__unused__)),
+			int dd __attribute__((__unused__)),
+			const char *dirname __attribute__((__unused__)),
+			const char *name __attribute__((__unused__)),
+			struct stat *st __attribute__((__unused__)))
+{
+	return 1;
+}
+#endif /* HAVE_PTHREAD_H */
+
+static void parse_dir_file(struct libmnt_table *tb, int dd,
+			   const char *dirname, const char *name)
+{
+	struct stat st;
+	FILE *f;
+
+	if (fstatat(dd, name, &st, 0) || !S_ISREG(st.st_mode))
+		return;
+	if (parse_dir_file_cached(tb, dd, dirname, name, &st) == 0)
+		return;
+
+	f = fopen_at(dd, name, O_RDONLY|O_CLOEXEC, "r" UL_CLOEXECSTR);
+	if (f) {
+		mnt_table_parse_stream(tb, f, name);
+		fclose(f);
+	}
+}
+
 #ifdef HAVE_SCANDIRAT
 static int __mnt_table_parse_dir(struct libmnt_table *tb, const char *dirname)
 {
@@ -857,21 +1517,8 @@ static int __mnt_table_parse_dir(struct libmnt_table *tb, const char *dirname)
 	        return 0;
 	}
 
-	for (i = 0; i < n; i++) {
-		struct dirent *d = namelist[i];
-		struct stat st;
-		FILE *f;
-
-		if (fstatat(dd, d->d_name, &st, 0) ||
-		    !S_ISREG(st.st_mode))
-			continue;
-
-		f = fopen_at(dd, d->d_name, O_RDONLY|O_CLOEXEC, "r" UL_CLOEXECSTR);
-		if (f) {
-			mnt_table_parse_stream(tb, f, d->d_name);
-			fclose(f);
-		}
-	}
+	for (i = 0; i < n; i++)
+		parse_dir_file(tb, dd, dirname, namelist[i]->d_name);
 
 	for (i = 0; i < n; i++)
 		free(namelist[i]);
@@ -897,22 +1544,8 @@ static int __mnt_table_parse_dir(struct libmnt_table *tb, const char *dirname)
 		goto out;
 	}
 
-	for (i = 0; i < n; i++) {
-		struct dirent *d = namelist[i];
-		struct stat st;
-		FILE *f;
-
-		if (fstatat(dirfd(dir), d->d_name, &st, 0) ||
-		    !S_ISREG(st.st_mode))
-			continue;
-
-		f = fopen_at(dirfd(dir), d->d_name,
-				O_RDONLY|O_CLOEXEC, "r" UL_CLOEXECSTR);
-		if (f) {
-			mnt_table_parse_stream(tb, f, d->d_name);
-			fclose(f);
-		}
-	}
+	for (i = 0; i < n; i++)
+		parse_dir_file(tb, dirfd(dir), dirname, namelist[i]->d_name);
 
 out:
 	for (i = 0; i < n; i++)
@@ -934,6 +1567,10 @@ out:
  *	- files that start with "." are ignored (e.g. ".10foo.fstab")
  *	- files without the ".fstab" extension are ignored
  *
+ * The parsed files are cached for the whole process and the file is parsed
+ * again only if it has been modified (or the table uses a filter or comments
+ * parsing). The entries in @tb are always private copies.
+ *
  * Returns: 0 on success or negative number in case of error.
  */
 int mnt_table_parse_dir(struct libmnt_table *tb, const char *dirname)
@@ -1140,13 +1777,17 @@ static struct libmnt_fs *mnt_table_merge_user_fs(struct libmnt_table *tb, struct
 	mnt_reset_iter(&itr, MNT_ITER_BACKWARD);
 
 	while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
-		const char *r = mnt_fs_get_root(fs);
+		const char *r;
 
 		if (fs->flags & MNT_FS_MERGED)
 			continue;
 
+		/* target first, the root may be parsed on demand */
+		if (!mnt_fs_streq_target(fs, target))
+			continue;
+
+		r = mnt_fs_get_root(fs);
 		if (r && strcmp(r, root) == 0
-		    && mnt_fs_streq_target(fs, target)
 		    && mnt_fs_streq_srcpath(fs, src))
 			break;
 	}
@@ -30,6 +30,9 @@
 #include "mountP.h"
 #include "mangle.h"
 #include "pathnames.h"
+#include "all-io.h"
+#include "env.h"
+#include "strutils.h"
 
 struct libmnt_update {
 	char		*target;
@@ -38,6 +41,7 @@ struct libmnt_update {
 	unsigned long	mountflags;
 	int		userspace_only;
 	int		ready;
+	int		journal;	/* append to utab (LIBMOUNT_UTAB_JOURNAL=1) */
 
 	struct libmnt_table *mountinfo;
 };
@@ -106,7 +110,7 @@ int mnt_update_set_filename(struct libmnt_update *upd, const char *filename,
 	}
 
 	if (upd->filename)
-		return 0;
+		goto done;
 
 	/* detect tab filename -- /etc/mtab or /run/mount/utab
 	 */
@@ -123,7 +127,8 @@ int mnt_update_set_filename(struct libmnt_update *upd, const char *filename,
 	upd->filename = strdup(path);
 	if (!upd->filename)
 		return -ENOMEM;
-
+done:
+	upd->journal = upd->userspace_only && safe_getenv("LIBMOUNT_UTAB_JOURNAL");
 	return 0;
 }
 
@@ -531,7 +536,10 @@ static int update_table(struct libmnt_update *upd, struct libmnt_table *tb)
 
 		mnt_reset_iter(&itr, MNT_ITER_FORWARD);
 
-		if (tb->comms && mnt_table_get_intro_comment(tb))
+		if (upd->journal)
+			/* the size is updated below */
+			fprintf(f, MNT_UTAB_JOURNAL_HEADER "%010d\n", 0);
+		else if (tb->comms && mnt_table_get_intro_comment(tb))
 			fputs(mnt_table_get_intro_comment(tb), f);
 
 		while(mnt_table_next_fs(tb, &itr, &fs) == 0) {
@@ -545,9 +553,16 @@ static int update_table(struct libmnt_update *upd, struct libmnt_table *tb)
 				goto leave;
 			}
 		}
-		if (tb->comms && mnt_table_get_trailing_comment(tb))
+		if (!upd->journal && tb->comms && mnt_table_get_trailing_comment(tb))
 			fputs(mnt_table_get_trailing_comment(tb), f);
 
+		if (upd->journal) {
+			long sz = ftell(f);
+
+			if (sz > 0 && fseek(f, 0, SEEK_SET) == 0)
+				fprintf(f, MNT_UTAB_JOURNAL_HEADER "%010ld\n", sz);
+		}
+
 		if (fflush(f) != 0) {
 			rc = -errno;
 			DBG(UPDATE, ul_debugobj(upd, "%s: fflush failed: %m", uq));
@@ -820,6 +835,300 @@ static int update_modify_options(struct libmnt_update *upd, struct libmnt_lock *
 	return rc;
 }
 
+/*
+ * utab journal
+ *
+ * If LIBMOUNT_UTAB_JOURNAL=1 is set, the utab changes are appended to the
+ * file by one write(2) rather than rewriting the whole file under the
+ * exclusive lock, so the concurrent mounts don't wait for each other. The
+ * plain appends (mount, umount) use the shared lock (only to exclude the
+ * journal compaction), the readers don't use the lock at all. The remount and
+ * move read the current entry from the file, so they use the exclusive lock
+ * to not interleave with another update of the same entry.
+ *
+ * The umount appends the "DEL TARGET=<path>" record, the remount and move
+ * append the record followed by the modified entry. The parser replays the
+ * records, so all utab readers see the same table as for the rewritten file.
+ *
+ * The journal is compacted (rewritten by update_table()) when it's twice as
+ * large as after the last compaction, the size is stored in the file header.
+ */
+#define UTAB_JOURNAL_MINSIZE	(16 * 1024)
+
+/* returns 1 if the journal (opened as @fd) should be compacted */
+static int journal_need_compact(int fd)
+{
+	char buf[sizeof(MNT_UTAB_JOURNAL_HEADER) + 16];
+	const char *p;
+	struct stat st;
+	off_t base = 0;
+	ssize_t sz;
+
+	if (fstat(fd, &st) != 0 || st.st_size < UTAB_JOURNAL_MINSIZE)
+		return 0;
+
+	sz = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (sz > 0) {
+		buf[sz] = '\0';
+		p = startswith(buf, MNT_UTAB_JOURNAL_HEADER);
+		if (p)
+			base = strtol(p, NULL, 10);
+	}
+	return st.st_size > 2 * base;
+}
+
+static int journal_append(struct libmnt_update *upd, const char *buf,
+			  size_t sz, int *compact)
+{
+	int fd, rc = 0;
+
+	fd = open(upd->filename, O_WRONLY|O_APPEND|O_CREAT|O_CLOEXEC,
+			S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+	if (fd < 0)
+		return -errno;
+
+	if (write_all(fd, buf, sz) != 0)
+		rc = -errno;
+	else
+		*compact = journal_need_compact(fd);
+	close(fd);
+
+	DBG(UPDATE, ul_debugobj(upd, "%s: appended %zu bytes [rc=%d]",
+				upd->filename, sz, rc));
+	return rc;
+}
+
+static int journal_compact(struct libmnt_update *upd, struct libmnt_lock *lc)
+{
+	struct libmnt_table *tb = NULL;
+	int rc = 0, fd;
+
+	if (lc && mnt_lock_file(lc) != 0)
+		return -MNT_ERR_LOCK;
+
+	/* compacted by another process in the meantime? */
+	fd = open(upd->filename, O_RDONLY|O_CLOEXEC);
+	if (fd >= 0 && journal_need_compact(fd)) {
+		DBG(UPDATE, ul_debugobj(upd, "%s: compacting journal", upd->filename));
+		tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+		rc = tb ? update_table(upd, tb) : -ENOMEM;
+	}
+	if (fd >= 0)
+		close(fd);
+	if (lc)
+		mnt_unlock_file(lc);
+
+	mnt_unref_table(tb);
+	return rc;
+}
+
+static int fprintf_utab_deleted(FILE *f, const char *target)
+{
+	char *p = mangle(target);
+	int rc;
+
+	if (!p)
+		return -ENOMEM;
+	rc = fprintf(f, MNT_UTAB_DELETED "TARGET=%s\n", p);
+	free(p);
+	return rc < 0 ? -EIO : 0;
+}
+
+static int update_journal(struct libmnt_update *upd, struct libmnt_lock *lc)
+{
+	struct libmnt_table *tb = NULL;
+	struct libmnt_fs *fs = NULL;
+	char *buf = NULL;
+	size_t sz = 0;
+	int rc = 0, compact = 0;
+	int modify = upd->fs && (upd->mountflags & (MS_MOVE | MS_REMOUNT));
+	FILE *f;
+
+	DBG(UPDATE, ul_debugobj(upd, "%s: update journal", upd->filename));
+
+	if (lc) {
+		mnt_lock_use_shared(lc, !modify);
+		rc = mnt_lock_file(lc);
+		mnt_lock_use_shared(lc, FALSE);
+		if (rc)
+			return -MNT_ERR_LOCK;
+	}
+
+	f = open_memstream(&buf, &sz);
+	if (!f) {
+		rc = -errno;
+		goto done;
+	}
+
+	if (!upd->fs && upd->target)				/* umount */
+		rc = fprintf_utab_deleted(f, upd->target);
+
+	else if (modify) {					/* move, remount */
+		const char *tgt = upd->mountflags & MS_MOVE ?
+					mnt_fs_get_srcpath(upd->fs) :
+					mnt_fs_get_target(upd->fs);
+		struct libmnt_fs *cur;
+
+		tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+		cur = tb ? mnt_table_find_target(tb, tgt, MNT_ITER_BACKWARD) : NULL;
+		if (cur) {
+			rc = fprintf_utab_deleted(f, tgt);
+			if (!rc && (upd->mountflags & MS_MOVE))
+				rc = mnt_fs_set_target(cur, mnt_fs_get_target(upd->fs));
+			else if (!rc) {
+				rc = mnt_fs_set_attributes(cur, mnt_fs_get_attributes(upd->fs));
+				if (!rc)
+					rc = mnt_fs_set_options(cur, mnt_fs_get_options(upd->fs));
+			}
+			fs = cur;
+		} else if (upd->mountflags & MS_REMOUNT)
+			fs = upd->fs;		/* not found, add new */
+
+	} else								/* mount */
+		fs = upd->fs;
+
+	if (!rc && fs)
+		rc = fprintf_utab_fs(f, fs);
+	if (fclose(f) != 0 && !rc)
+		rc = -errno;
+	if (!rc && sz)
+		rc = journal_append(upd, buf, sz, &compact);
+done:
+	if (lc)
+		mnt_unlock_file(lc);
+	if (!rc && compact)
+		journal_compact(upd, lc);	/* errors are not fatal here */
+
+	mnt_unref_table(tb);
+	free(buf);
+	return rc;
+}
+
+/*
+ * Moves the prepared mount update to @tb rather than to update the file now;
+ * used to write all utab entries of the batch mount by one update, see
+ * __mnt_update_add_entries(). Only the new utab entries could be deferred.
+ *
+ * Returns: 1 if deferred, 0 if not, or <0 on error.
+ */
+int __mnt_update_defer(struct libmnt_update *upd, struct libmnt_table *tb)
+{
+	struct libmnt_fs *fs;
+	int rc;
+
+	if (!upd || !tb)
+		return -EINVAL;
+	if (!upd->ready || !upd->fs || !upd->userspace_only
+	    || (upd->mountflags & (MS_MOVE | MS_REMOUNT)))
+		return 0;
+
+	fs = mnt_copy_fs(NULL, upd->fs);
+	if (!fs)
+		return -ENOMEM;
+	DBG(UPDATE, ul_debugobj(upd, "%s: deferred %s", upd->filename,
+				mnt_fs_get_target(fs)));
+	rc = mnt_table_add_fs(tb, fs);
+	mnt_unref_fs(fs);
+	if (rc)
+		return rc;
+
+	upd->ready = FALSE;
+	return 1;
+}
+
+/*
+ * Adds all @ents entries (deferred by __mnt_update_defer()) to the @upd file
+ * by one update.
+ */
+int __mnt_update_add_entries(struct libmnt_update *upd,
+			     struct libmnt_table *ents, struct libmnt_lock *lc)
+{
+	struct libmnt_lock *lc0 = lc;
+	struct libmnt_table *tb = NULL;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	char *buf = NULL;
+	size_t sz = 0;
+	int rc = 0, compact = 0;
+
+	if (!upd || !upd->filename || !ents)
+		return -EINVAL;
+	if (!mnt_table_get_nents(ents))
+		return 0;
+
+	DBG(UPDATE, ul_debugobj(upd, "%s: add %d entries", upd->filename,
+				mnt_table_get_nents(ents)));
+	if (!lc) {
+		lc = mnt_new_lock(upd->filename, 0);
+		if (lc)
+			mnt_lock_block_signals(lc, TRUE);
+	}
+	if (lc)
+		mnt_lock_use_simplelock(lc, TRUE);	/* userspace only */
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+
+	if (upd->journal) {
+		FILE *f = open_memstream(&buf, &sz);
+
+		if (!f) {
+			rc = -errno;
+			goto done;
+		}
+		while (rc == 0 && mnt_table_next_fs(ents, &itr, &fs) == 0)
+			rc = fprintf_utab_fs(f, fs);
+		if (fclose(f) != 0 && !rc)
+			rc = -errno;
+		if (rc)
+			goto done;
+		if (lc) {
+			mnt_lock_use_shared(lc, TRUE);
+			rc = mnt_lock_file(lc);
+			mnt_lock_use_shared(lc, FALSE);
+			if (rc) {
+				rc = -MNT_ERR_LOCK;
+				goto done;
+			}
+		}
+		rc = journal_append(upd, buf, sz, &compact);
+		if (lc)
+			mnt_unlock_file(lc);
+		if (!rc && compact)
+			journal_compact(upd, lc);	/* errors are not fatal here */
+		goto done;
+	}
+
+	if (lc && mnt_lock_file(lc) != 0) {
+		rc = -MNT_ERR_LOCK;
+		goto done;
+	}
+	tb = __mnt_new_table_from_file(upd->filename, MNT_FMT_UTAB, 1);
+	if (!tb)
+		rc = -ENOMEM;
+	while (rc == 0 && mnt_table_next_fs(ents, &itr, &fs) == 0) {
+		struct libmnt_fs *x = mnt_copy_fs(NULL, fs);
+
+		if (!x) {
+			rc = -ENOMEM;
+			break;
+		}
+		rc = mnt_table_add_fs(tb, x);
+		mnt_unref_fs(x);
+	}
+	if (!rc)
+		rc = update_table(upd, tb);
+	if (lc)
+		mnt_unlock_file(lc);
+done:
+	DBG(UPDATE, ul_debugobj(upd, "%s: add entries: done [rc=%d]",
+				upd->filename, rc));
+	mnt_unref_table(tb);
+	free(buf);
+	if (lc != lc0)
+		mnt_free_lock(lc);
+	return rc;
+}
+
 /**
  * mnt_update_table:
  * @upd: update
@@ -856,7 +1165,9 @@ int mnt_update_table(struct libmnt_update *upd, struct libmnt_lock *lc)
 	if (lc && upd->userspace_only)
 		mnt_lock_use_simplelock(lc, TRUE);	/* use flock */
 
-	if (!upd->fs && upd->target)
+	if (upd->journal)
+		rc = update_journal(upd, lc);
+	else if (!upd->fs && upd->target)
 		rc = update_remove_entry(upd, lc);	/* umount */
 	else if (upd->mountflags & MS_MOVE)
 		rc = update_modify_target(upd, lc);	/* move */
@@ -892,7 +1203,11 @@ int mnt_update_already_done(struct libmnt_update *upd, struct libmnt_lock *lc)
 	if (lc && upd->userspace_only)
 		mnt_lock_use_simplelock(lc, TRUE);	/* use flock */
 	if (lc) {
+		if (upd->journal)
+			mnt_lock_use_shared(lc, TRUE);
 		rc = mnt_lock_file(lc);
+		if (upd->journal)
+			mnt_lock_use_shared(lc, FALSE);
 		if (rc) {
 			rc = -MNT_ERR_LOCK;
 			goto done;
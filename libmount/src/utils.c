@@ -1200,6 +1200,130 @@ int mnt_tmptgt_cleanup(int old_ns_fd)
 	return 0;
 }
 
+/*
+ * The process-wide set of the mounted device numbers for
+ * mnt_is_devno_mounted(). The set is sorted and it's re-read only if the
+ * kernel monitor reports a change in the mount table.
+ */
+static struct libmnt_monitor *mounted_mn;
+static dev_t *mounted_devnos;
+static size_t mounted_ndevnos;
+static int mounted_valid;
+static int mounted_nomonitor;
+
+static int cmp_devnos(const void *a, const void *b)
+{
+	dev_t x = *(const dev_t *) a, y = *(const dev_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int read_mounted_devnos(void)
+{
+	struct libmnt_table *tb;
+	struct libmnt_iter itr;
+	struct libmnt_fs *fs;
+	dev_t *devnos;
+	size_t n = 0;
+	int rc;
+
+	tb = mnt_new_table();
+	if (!tb)
+		return -ENOMEM;
+
+	mnt_table_enable_lazy_parse(tb, 1);	/* devno only */
+	rc = mnt_table_parse_file(tb, _PATH_PROC_MOUNTINFO);
+	if (rc)
+		goto done;
+
+	devnos = realloc(mounted_devnos, (mnt_table_get_nents(tb) + 1) * sizeof(dev_t));
+	if (!devnos) {
+		rc = -ENOMEM;
+		goto done;
+	}
+	mounted_devnos = devnos;
+
+	mnt_reset_iter(&itr, MNT_ITER_FORWARD);
+	while (mnt_table_next_fs(tb, &itr, &fs) == 0) {
+		if (mnt_fs_get_devno(fs))
+			devnos[n++] = mnt_fs_get_devno(fs);
+	}
+	qsort(devnos, n, sizeof(dev_t), cmp_devnos);
+
+	mounted_ndevnos = n;
+	mounted_valid = 1;
+	DBG(UTILS, ul_debug("mounted devnos: %zu entries", n));
+done:
+	mnt_unref_table(tb);
+	return rc;
+}
+
+/* returns 1 if the mount table has been (or could be) changed */
+static int mounted_devnos_changed(void)
+{
+	int changed = 0;
+
+	if (mounted_nomonitor)
+		return 1;
+	if (!mounted_mn) {
+		mounted_mn = mnt_new_monitor();
+		if (!mounted_mn
+		    || mnt_monitor_enable_kernel(mounted_mn, TRUE) != 0
+		    || mnt_monitor_get_fd(mounted_mn) < 0) {
+			DBG(UTILS, ul_debug("mounted devnos: monitor unavailable"));
+			mnt_unref_monitor(mounted_mn);
+			mounted_mn = NULL;
+			mounted_nomonitor = 1;
+		}
+		return 1;
+	}
+
+	/* drain all events, the table is read after that */
+	while (mnt_monitor_next_change(mounted_mn, NULL, NULL) == 0)
+		changed = 1;
+	return changed;
+}
+
+/**
+ * mnt_is_devno_mounted:
+ * @devno: device number (e.g. st_rdev of the block device)
+ *
+ * Checks if a filesystem on the device @devno is mounted in the current mount
+ * namespace. The mounted device numbers are cached for the whole process and
+ * the cache is refreshed only if the kernel mount table has been modified
+ * (see mnt_monitor_enable_kernel()). It makes repeated checks (e.g. for all
+ * devices on the system) cheap.
+ *
+ * The @devno is compared with the device numbers of the mounted filesystems
+ * (see mnt_fs_get_devno()). Some filesystems (e.g. btrfs) use an anonymous
+ * device number, so the function may return 0 for a mounted device; use
+ * mnt_table_find_source() to verify the negative result if necessary.
+ *
+ * The function is not thread-safe and the cache is not refreshed if the
+ * process changes its mount namespace.
+ *
+ * Since: 2.38
+ *
+ * Returns: 1 if mounted, 0 if not mounted, or negative number in case of error.
+ */
+int mnt_is_devno_mounted(dev_t devno)
+{
+	if (!devno)
+		return -EINVAL;
+
+	if (mounted_devnos_changed() || !mounted_valid) {
+		int rc;
+
+		mounted_valid = 0;
+		rc = read_mounted_devnos();
+		if (rc)
+			return rc;
+	}
+
+	return bsearch(&devno, mounted_devnos, mounted_ndevnos,
+		       sizeof(dev_t), cmp_devnos) ? 1 : 0;
+}
+
 #ifdef TEST_PROGRAM
 static int test_match_fstype(struct libmnt_test *ts, int argc, char *argv[])
 {
@@ -1327,6 +1451,24 @@ static int test_guess_root(struct libmnt_test *ts, int argc, char *argv[])
 	return 0;
 }
 
+static int test_devno_mounted(struct libmnt_test *ts, int argc, char *argv[])
+{
+	unsigned int x, y;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		int rc;
+
+		if (sscanf(argv[i], "%u:%u", &x, &y) != 2)
+			return -EINVAL;
+		rc = mnt_is_devno_mounted(makedev(x, y));
+		if (rc < 0)
+			return rc;
+		printf("%s: %s\n", argv[i], rc ? "mounted" : "not mounted");
+	}
+	return 0;
+}
+
 static int test_mkdir(struct libmnt_test *ts, int argc, char *argv[])
 {
 	int rc;
@@ -1367,6 +1509,7 @@ int main(int argc, char *argv[])
 	{ "--cd-parent",     test_chdir,           "<path>" },
 	{ "--kernel-cmdline",test_kernel_cmdline,  "<option> | <option>=" },
 	{ "--guess-root",    test_guess_root,      "[<maj:min>]" },
+	{ "--devno-mounted", test_devno_mounted,   "<maj:min> ..." },
 	{ "--mkdir",         test_mkdir,           "<path>" },
 	{ "--statfs-type",   test_statfs_type,     "<path>" },
 
@@ -0,0 +1,405 @@
+/*
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ *
+ * Benchmark for the library hot paths. It builds a synthetic table of the
+ * requested size and shape and measures the time to add lines, calculate
+ * columns width, sort and print the table in all (or selected) output
+ * formats. The output is written to /dev/null by default.
+ *
+ * The results are not checked, it's not a regression test. Compare the
+ * output before and after a change.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "c.h"
+#include "nls.h"
+#include "strutils.h"
+#include "monotonic.h"
+
+#include "libsmartcols.h"
+
+enum {
+	SHAPE_FLAT,
+	SHAPE_TREE,
+	SHAPE_WRAP,
+	SHAPE_GROUPS
+};
+
+static const char *shape_names[] = {
+	[SHAPE_FLAT]   = "flat",
+	[SHAPE_TREE]   = "tree",
+	[SHAPE_WRAP]   = "wrap",
+	[SHAPE_GROUPS] = "groups"
+};
+
+enum {
+	FMT_HUMAN,
+	FMT_RAW,
+	FMT_JSON,
+	FMT_EXPORT
+};
+
+static const char *format_names[] = {
+	[FMT_HUMAN]  = "human",
+	[FMT_RAW]    = "raw",
+	[FMT_JSON]   = "json",
+	[FMT_EXPORT] = "export"
+};
+
+#define BENCH_TREE_DEPTH	32	/* max depth of the tree */
+#define BENCH_GROUP_SIZE	16	/* lines per group */
+#define BENCH_TERMWIDTH		120
+
+struct bench {
+	size_t	nlines;
+	size_t	ncols;
+	int	shape;
+	FILE	*out;
+
+	unsigned int arena : 1,
+		     nosort : 1;
+};
+
+#ifdef __GLIBC__
+/*
+ * Count allocations; the functions are used also by the library, the glibc
+ * __libc_ functions are the real allocator.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static size_t nallocs;
+
+void *malloc(size_t size)
+{
+	nallocs++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	nallocs++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	nallocs++;
+	return __libc_realloc(ptr, size);
+}
+# define HAVE_ALLOCS_COUNTER 1
+#endif
+
+static double bench_now(void)
+{
+	struct timeval tv;
+
+	gettime_monotonic(&tv);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static size_t bench_nallocs(void)
+{
+#ifdef HAVE_ALLOCS_COUNTER
+	return nallocs;
+#else
+	return 0;
+#endif
+}
+
+static struct libscols_table *new_table(struct bench *be, int fmt)
+{
+	struct libscols_table *tb;
+	size_t i;
+
+	tb = scols_new_table();
+	if (!tb)
+		err(EXIT_FAILURE, "failed to create output table");
+
+	if (be->arena && scols_table_enable_arena(tb, TRUE))
+		err(EXIT_FAILURE, "failed to enable arena");
+
+	scols_table_set_stream(tb, be->out);
+
+	switch (fmt) {
+	case FMT_HUMAN:
+		/* force terminal to calculate columns width */
+		scols_table_set_termforce(tb, SCOLS_TERMFORCE_ALWAYS);
+		scols_table_set_termwidth(tb, BENCH_TERMWIDTH);
+		break;
+	case FMT_RAW:
+		scols_table_enable_raw(tb, TRUE);
+		break;
+	case FMT_JSON:
+		scols_table_enable_json(tb, TRUE);
+		scols_table_set_name(tb, "bench");
+		break;
+	case FMT_EXPORT:
+		scols_table_enable_export(tb, TRUE);
+		break;
+	}
+
+	if (!scols_table_new_column(tb, "NAME", 0,
+			be->shape == SHAPE_TREE ||
+			be->shape == SHAPE_GROUPS ? SCOLS_FL_TREE : 0)
+	    || !scols_table_new_column(tb, "SIZE", 0, SCOLS_FL_RIGHT)
+	    || !scols_table_new_column(tb, "TYPE", 0, 0))
+		err(EXIT_FAILURE, "failed to create output columns");
+
+	for (i = 3; i < be->ncols; i++) {
+		struct libscols_column *cl;
+		char name[32];
+		int last = i + 1 == be->ncols;
+
+		snprintf(name, sizeof(name), "COL%zu", i);
+		cl = scols_table_new_column(tb, name, last ? 0.3 : 0,
+				last && be->shape == SHAPE_WRAP ? SCOLS_FL_WRAP : 0);
+		if (!cl)
+			err(EXIT_FAILURE, "failed to create output column");
+		if (last && be->shape == SHAPE_WRAP)
+			scols_column_set_safechars(cl, "\n");
+	}
+
+	return tb;
+}
+
+static void add_lines(struct bench *be, struct libscols_table *tb)
+{
+	struct libscols_line *ln = NULL, *parent = NULL, *group = NULL;
+	char buf[128];
+	size_t i, x, g = 0;
+
+	for (i = 0; i < be->nlines; i++) {
+		switch (be->shape) {
+		case SHAPE_TREE:
+			parent = i % BENCH_TREE_DEPTH ? ln : NULL;
+			break;
+		case SHAPE_GROUPS:
+			/* the first line of the chunk is the group, the chunk
+			 * members are in the group and every member has a
+			 * child linked to the group */
+			g = i % BENCH_GROUP_SIZE;
+			parent = g % 2 ? ln : NULL;
+			break;
+		default:
+			break;
+		}
+
+		ln = scols_table_new_line(tb, parent);
+		if (!ln)
+			err(EXIT_FAILURE, "failed to create output line");
+
+		if (be->shape == SHAPE_GROUPS) {
+			if (g == 0)
+				group = ln;
+			else if (g % 2 == 0)
+				scols_table_group_lines(tb, group, ln, 0);
+			else if (g == BENCH_GROUP_SIZE - 1)
+				scols_line_link_group(ln, group, 0);
+		}
+
+		snprintf(buf, sizeof(buf), "dev%zu", i);
+		if (scols_line_set_data(ln, 0, buf))
+			goto fail;
+		snprintf(buf, sizeof(buf), "%zuM", (i * 7919) % 100000);
+		if (scols_line_set_data(ln, 1, buf))
+			goto fail;
+		if (scols_line_set_data(ln, 2, i % 3 ? "part" : "disk"))
+			goto fail;
+
+		for (x = 3; x < be->ncols; x++) {
+			if (be->shape == SHAPE_WRAP && x + 1 == be->ncols)
+				snprintf(buf, sizeof(buf), "the long text %zu\n"
+					"to be wrapped to more lines according "
+					"to the column width", i);
+			else
+				snprintf(buf, sizeof(buf), "/dev/disk/by-id/%zu-%zu", x, i);
+			if (scols_line_set_data(ln, x, buf))
+				goto fail;
+		}
+	}
+	return;
+fail:
+	err(EXIT_FAILURE, "failed to set line data");
+}
+
+static void bench_format(struct bench *be, int fmt)
+{
+	struct libscols_table *tb;
+	struct libscols_line *ln;
+	size_t allocs;
+	double start, add, sort = -1, calc = -1, print;
+
+	tb = new_table(be, fmt);
+
+	/* add lines */
+	allocs = bench_nallocs();
+	start = bench_now();
+	add_lines(be, tb);
+	add = bench_now() - start;
+	allocs = bench_nallocs() - allocs;
+
+	/* sort */
+	if (!be->nosort) {
+		struct libscols_column *cl = scols_table_get_column(tb, 1);
+
+		scols_column_set_cmpfunc(cl, scols_cmpstr_cells, NULL);
+		start = bench_now();
+		if (scols_sort_table(tb, cl))
+			err(EXIT_FAILURE, "failed to sort table");
+		sort = bench_now() - start;
+	}
+
+	/* calculate; it's done for all the table also when only the first
+	 * line is printed (not possible for trees) */
+	ln = scols_table_get_line(tb, 0);
+	if (fmt == FMT_HUMAN && ln && !scols_table_is_tree(tb)) {
+		start = bench_now();
+		if (scols_table_print_range(tb, ln, ln))
+			err(EXIT_FAILURE, "failed to print table");
+		calc = bench_now() - start;
+	}
+
+	/* print */
+	start = bench_now();
+	if (scols_print_table(tb))
+		err(EXIT_FAILURE, "failed to print table");
+	fflush(be->out);
+	print = bench_now() - start;
+
+	printf("%-6s %-6s %8zu %10.3f", shape_names[be->shape],
+			format_names[fmt], be->nlines, add);
+	if (bench_nallocs())
+		printf(" %8.2f", (double) allocs / be->nlines);
+	else
+		printf(" %8s", "-");
+	if (sort >= 0)
+		printf(" %10.3f", sort);
+	else
+		printf(" %10s", "-");
+	if (calc >= 0)
+		printf(" %10.3f", calc);
+	else
+		printf(" %10s", "-");
+	printf(" %10.3f\n", print);
+
+	scols_unref_table(tb);
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+	fprintf(out,
+		"\n %s [options]\n\n", program_invocation_short_name);
+
+	fputs(" -a, --arena                    use memory arena for lines\n", out);
+	fputs(" -c, --columns <num>            number of columns (default 4, min 3)\n", out);
+	fputs(" -f, --format <name>            human, raw, json or export (default all)\n", out);
+	fputs(" -n, --nlines <num>             number of lines (default 100000)\n", out);
+	fputs(" -o, --output <file>            write output to the file (default /dev/null)\n", out);
+	fputs(" -s, --shape <name>             flat, tree, wrap or groups (default flat)\n", out);
+	fputs(" -S, --nosort                   don't sort the table\n", out);
+	fputs(" -h, --help                     this help\n", out);
+	fputs("\n", out);
+	fputs(" The times are in milliseconds, 'calc' is the columns width\n"
+	      " calculation (human output without tree only).\n", out);
+	fputs("\n", out);
+
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench be = {
+		.nlines = 100000,
+		.ncols = 4,
+		.shape = SHAPE_FLAT
+	};
+	const char *outname = "/dev/null";
+	int c, fmt = -1;
+	size_t i;
+
+	static const struct option longopts[] = {
+		{ "arena",	no_argument,       NULL, 'a' },
+		{ "columns",	required_argument, NULL, 'c' },
+		{ "format",	required_argument, NULL, 'f' },
+		{ "nlines",	required_argument, NULL, 'n' },
+		{ "output",	required_argument, NULL, 'o' },
+		{ "shape",	required_argument, NULL, 's' },
+		{ "nosort",	no_argument,       NULL, 'S' },
+		{ "help",	no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	setlocale(LC_ALL, "");	/* just to have enable UTF8 chars */
+
+	scols_init_debug(0);
+
+	while((c = getopt_long(argc, argv, "ac:f:hn:o:s:S", longopts, NULL)) != -1) {
+		switch(c) {
+		case 'a':
+			be.arena = 1;
+			break;
+		case 'c':
+			be.ncols = strtou32_or_err(optarg, "failed to parse number of columns");
+			if (be.ncols < 3)
+				errx(EXIT_FAILURE, "the minimal number of columns is 3");
+			break;
+		case 'f':
+			for (i = 0; i < ARRAY_SIZE(format_names); i++) {
+				if (strcmp(optarg, format_names[i]) == 0)
+					break;
+			}
+			if (i == ARRAY_SIZE(format_names))
+				errx(EXIT_FAILURE, "unsupported format: %s", optarg);
+			fmt = i;
+			break;
+		case 'n':
+			be.nlines = strtou32_or_err(optarg, "failed to parse number of lines");
+			if (!be.nlines)
+				errx(EXIT_FAILURE, "the number of lines must be greater than zero");
+			break;
+		case 'o':
+			outname = optarg;
+			break;
+		case 's':
+			for (i = 0; i < ARRAY_SIZE(shape_names); i++) {
+				if (strcmp(optarg, shape_names[i]) == 0)
+					break;
+			}
+			if (i == ARRAY_SIZE(shape_names))
+				errx(EXIT_FAILURE, "unsupported shape: %s", optarg);
+			be.shape = i;
+			break;
+		case 'S':
+			be.nosort = 1;
+			break;
+		case 'h':
+			usage();
+		default:
+			errtryhelp(EXIT_FAILURE);
+		}
+	}
+
+	be.out = fopen(outname, "w" UL_CLOEXECSTR);
+	if (!be.out)
+		err(EXIT_FAILURE, "%s: open failed", outname);
+
+	printf("%-6s %-6s %8s %10s %8s %10s %10s %10s\n",
+			"SHAPE", "FORMAT", "LINES", "ADD", "ALLOCS", "SORT",
+			"CALC", "PRINT");
+
+	for (i = 0; i < ARRAY_SIZE(format_names); i++) {
+		if (fmt < 0 || (size_t) fmt == i)
+			bench_format(&be, i);
+	}
+
+	fclose(be.out);
+	return EXIT_SUCCESS;
+}
@@ -129,23 +129,35 @@ fail:
 	return NULL;
 }
 
+/* reads the next line from the column data file, returns -1 on EOF */
+static ssize_t read_column_data(FILE *f, char **str, size_t *len)
+{
+	ssize_t i;
+	char *p;
+
+	i = getline(str, len, f);
+	if (i == -1)
+		return -1;
+
+	p = strrchr(*str, '\n');
+	if (p)
+		*p = '\0';
+
+	while ((p = strrchr(*str, '\\')) && *(p + 1) == 'n') {
+		*p = '\n';
+		memmove(p + 1, p + 2, i - (p + 2 - *str));
+	}
+	return i;
+}
+
 static int parse_column_data(FILE *f, struct libscols_table *tb, int col)
 {
 	size_t len = 0, nlines = 0;
-	int i;
 	char *str = NULL;
 
-	while ((i = getline(&str, &len, f)) != -1) {
+	while (read_column_data(f, &str, &len) != -1) {
 
 		struct libscols_line *ln;
-		char *p = strrchr(str, '\n');
-		if (p)
-			*p = '\0';
-
-		while ((p = strrchr(str, '\\')) && *(p + 1) == 'n') {
-			*p = '\n';
-			memmove(p + 1, p + 2, i - (p + 2 - str));
-		}
 
 		ln = scols_table_get_line(tb, nlines++);
 		if (!ln)
@@ -160,6 +172,46 @@ static int parse_column_data(FILE *f, struct libscols_table *tb, int col)
 
 }
 
+/* streaming mode, the table is filled line by line from all the files */
+static int parse_stream_data(FILE **fs, size_t nfiles,
+			     struct libscols_table *tb, int nlines)
+{
+	size_t len = 0, i;
+	char *str = NULL;
+	int n;
+
+	for (n = 0; n < nlines; n++) {
+		struct libscols_line *ln = scols_table_new_line(tb, NULL);
+
+		if (!ln)
+			err(EXIT_FAILURE, "failed to add a new line");
+
+		for (i = 0; i < nfiles; i++) {
+			if (read_column_data(fs[i], &str, &len) == -1)
+				continue;
+			if (*str && scols_line_set_data(ln, i, str) != 0)
+				err(EXIT_FAILURE, "failed to add output data");
+		}
+	}
+
+	free(str);
+	return 0;
+}
+
+/* lazy column data, generated from the first column */
+static char *lazy_column_data(struct libscols_column *cl __attribute__((unused)),
+			      struct libscols_line *ln,
+			      void *data __attribute__((unused)))
+{
+	struct libscols_cell *ce = scols_line_get_cell(ln, 0);
+	const char *str = ce ? scols_cell_get_data(ce) : NULL;
+	char *res = NULL;
+
+	if (str)
+		xasprintf(&res, "%zu:%s", strlen(str), str);
+	return res;
+}
+
 static struct libscols_line *get_line_with_id(struct libscols_table *tb,
 						int col_id, const char *id)
 {
@@ -198,23 +250,35 @@ static void compose_tree(struct libscols_table *tb, int parent_col, int id_col)
 }
 
 
+static void set_filter(struct libscols_table *tb, struct libscols_filter *fltr)
+{
+	if (scols_table_set_filter(tb, fltr))
+		errx(EXIT_FAILURE, "failed to set filter: %s",
+				scols_filter_get_errmsg(fltr));
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
 	fprintf(out,
 		"\n %s [options] <column-data-file> ...\n\n", program_invocation_short_name);
 
+	fputs(" -a, --arena                    use memory arena for lines\n", out);
 	fputs(" -m, --maxout                   fill all terminal width\n", out);
 	fputs(" -M, --minout                   minimize tailing padding\n", out);
 	fputs(" -c, --column <file>            column definition\n", out);
+	fputs(" -l, --lazy-column <file>       column definition, data from the first column\n", out);
 	fputs(" -n, --nlines <num>             number of lines\n", out);
 	fputs(" -J, --json                     JSON output format\n", out);
+	fputs(" -N, --ndjson                   newline delimited JSON output format\n", out);
 	fputs(" -r, --raw                      RAW output format\n", out);
 	fputs(" -E, --export                   use key=\"value\" output format\n", out);
 	fputs(" -C, --colsep <str>             set columns separator\n", out);
 	fputs(" -w, --width <num>              hardcode terminal width\n", out);
 	fputs(" -p, --tree-parent-column <n>   parent column\n", out);
 	fputs(" -i, --tree-id-column <n>       id column\n", out);
+	fputs(" -s, --stream <num>             streaming output, calculate widths from <num> lines\n", out);
+	fputs(" -Q, --filter <expr>            print only lines matching the expression\n", out);
 	fputs(" -h, --help                     this help\n", out);
 	fputs("\n", out);
 
@@ -225,26 +289,32 @@ int main(int argc, char *argv[])
 {
 	struct libscols_table *tb;
 	int c, n, nlines = 0;
-	int parent_col = -1, id_col = -1;
+	int parent_col = -1, id_col = -1, stream = 0;
+	struct libscols_filter *fltr = NULL;
 
 	static const struct option longopts[] = {
+		{ "arena",  0, NULL, 'a' },
 		{ "maxout", 0, NULL, 'm' },
 		{ "minout", 0, NULL, 'M' },
 		{ "column", 1, NULL, 'c' },
+		{ "lazy-column", 1, NULL, 'l' },
 		{ "nlines", 1, NULL, 'n' },
 		{ "width",  1, NULL, 'w' },
 		{ "tree-parent-column", 1, NULL, 'p' },
 		{ "tree-id-column",	1, NULL, 'i' },
 		{ "json",   0, NULL, 'J' },
+		{ "ndjson", 0, NULL, 'N' },
 		{ "raw",    0, NULL, 'r' },
 		{ "export", 0, NULL, 'E' },
 		{ "colsep",  1, NULL, 'C' },
+		{ "stream", 1, NULL, 's' },
+		{ "filter", 1, NULL, 'Q' },
 		{ "help",   0, NULL, 'h' },
 		{ NULL, 0, NULL, 0 },
 	};
 
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
-		{ 'E', 'J', 'r' },
+		{ 'E', 'J', 'N', 'r' },
 		{ 'M', 'm' },
 		{ 0 }
 	};
@@ -257,12 +327,13 @@ int main(int argc, char *argv[])
 	if (!tb)
 		err(EXIT_FAILURE, "failed to create output table");
 
-	while((c = getopt_long(argc, argv, "hCc:Ei:JMmn:p:rw:", longopts, NULL)) != -1) {
+	while((c = getopt_long(argc, argv, "haCc:Ei:JMl:mNn:p:Q:rs:w:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
 		switch(c) {
 		case 'c': /* add column from file */
+		case 'l':
 		{
 			struct libscols_column *cl;
 			FILE *f = fopen(optarg, "r");
@@ -270,12 +341,18 @@ int main(int argc, char *argv[])
 			if (!f)
 				err(EXIT_FAILURE, "%s: open failed", optarg);
 			cl = parse_column(f);
+			if (cl && c == 'l')
+				scols_column_set_data_func(cl, lazy_column_data, NULL);
 			if (cl && scols_table_add_column(tb, cl))
 				err(EXIT_FAILURE, "%s: failed to add column", optarg);
 			scols_unref_column(cl);
 			fclose(f);
 			break;
 		}
+		case 'a':
+			if (scols_table_enable_arena(tb, TRUE))
+				err(EXIT_FAILURE, "failed to enable arena");
+			break;
 		case 'p':
 			parent_col = strtou32_or_err(optarg, "failed to parse tree PARENT column");
 			break;
@@ -286,6 +363,10 @@ int main(int argc, char *argv[])
 			scols_table_enable_json(tb, 1);
 			scols_table_set_name(tb, "testtable");
 			break;
+		case 'N':
+			scols_table_enable_json(tb, 1);
+			scols_table_enable_ndjson(tb, 1);
+			break;
 		case 'm':
 			scols_table_enable_maxout(tb, TRUE);
 			break;
@@ -301,6 +382,20 @@ int main(int argc, char *argv[])
 		case 'C':
 			scols_table_set_column_separator(tb, optarg);
 			break;
+		case 's':
+			scols_table_enable_streaming(tb, TRUE);
+			scols_table_set_streaming_sample(tb,
+				strtou32_or_err(optarg, "failed to parse number of lines"));
+			stream = 1;
+			break;
+		case 'Q':
+			fltr = scols_new_filter();
+			if (!fltr)
+				err(EXIT_FAILURE, "failed to allocate filter");
+			if (scols_filter_parse_string(fltr, optarg))
+				errx(EXIT_FAILURE, "failed to parse filter: %s",
+						scols_filter_get_errmsg(fltr));
+			break;
 		case 'n':
 			nlines = strtou32_or_err(optarg, "failed to parse number of lines");
 			break;
@@ -318,6 +413,29 @@ int main(int argc, char *argv[])
 	if (nlines <= 0)
 		errx(EXIT_FAILURE, "--nlines not set");
 
+	scols_table_enable_colors(tb, isatty(STDOUT_FILENO));
+
+	/* the streamed lines are filtered when added, otherwise the lines
+	 * are complete after all files are parsed */
+	if (stream && fltr)
+		set_filter(tb, fltr);
+
+	if (stream) {
+		size_t nfiles = argc - optind, i;
+		FILE **fs = xcalloc(nfiles ? nfiles : 1, sizeof(FILE *));
+
+		for (i = 0; i < nfiles; i++) {
+			fs[i] = fopen(argv[optind + i], "r");
+			if (!fs[i])
+				err(EXIT_FAILURE, "%s: open failed", argv[optind + i]);
+		}
+		parse_stream_data(fs, nfiles, tb, nlines);
+		for (i = 0; i < nfiles; i++)
+			fclose(fs[i]);
+		free(fs);
+		goto done;
+	}
+
 	for (n = 0; n < nlines; n++) {
 		struct libscols_line *ln = scols_new_line();
 
@@ -342,10 +460,11 @@ int main(int argc, char *argv[])
 
 	if (scols_table_is_tree(tb) && parent_col >= 0 && id_col >= 0)
 		compose_tree(tb, parent_col, id_col);
-
-	scols_table_enable_colors(tb, isatty(STDOUT_FILENO));
-
+	if (fltr)
+		set_filter(tb, fltr);
+done:
 	scols_print_table(tb);
+	scols_unref_filter(fltr);
 	scols_unref_table(tb);
 	return EXIT_SUCCESS;
 }
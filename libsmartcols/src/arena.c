@@ -0,0 +1,114 @@
+/*
+ * arena.c - bump allocator for lines and cells
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+
+/*
+ * The arena is used (if enabled by scols_table_enable_arena()) for line cells
+ * arrays and cells data. The memory is allocated in large chunks and it's
+ * never deallocated per item; all the chunks are deallocated at once when the
+ * last reference to the arena is dropped. The table and all lines allocated
+ * by the table keep the reference, so the line may outlive the table.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "smartcolsP.h"
+
+#define SCOLS_ARENA_CHUNKSIZ	(64 * 1024)
+
+struct libscols_arena_chunk {
+	struct libscols_arena_chunk	*next;
+	size_t				size;	/* size of the data[] */
+	size_t				used;
+	char				data[];
+};
+
+struct libscols_arena *scols_new_arena(void)
+{
+	struct libscols_arena *ar = calloc(1, sizeof(*ar));
+
+	if (!ar)
+		return NULL;
+	DBG(TAB, ul_debugobj(ar, "alloc arena"));
+	ar->refcount = 1;
+	return ar;
+}
+
+void scols_ref_arena(struct libscols_arena *ar)
+{
+	if (ar)
+		ar->refcount++;
+}
+
+void scols_unref_arena(struct libscols_arena *ar)
+{
+	if (ar && --ar->refcount <= 0) {
+		DBG(TAB, ul_debugobj(ar, "dealloc arena [%zu bytes]", ar->size));
+		while (ar->chunks) {
+			struct libscols_arena_chunk *ch = ar->chunks;
+
+			ar->chunks = ch->next;
+			free(ch);
+		}
+		free(ar);
+	}
+}
+
+static void *arena_alloc(struct libscols_arena *ar, size_t size, size_t align)
+{
+	struct libscols_arena_chunk *ch = ar->chunks;
+	size_t off = 0;
+
+	if (ch)
+		off = (ch->used + align - 1) & ~(align - 1);
+
+	if (!ch || off + size > ch->size) {
+		size_t sz = max(size, (size_t) SCOLS_ARENA_CHUNKSIZ);
+
+		ch = malloc(sizeof(*ch) + sz);
+		if (!ch)
+			return NULL;
+		ch->size = sz;
+		ch->used = 0;
+
+		/* keep the current chunk on top if the new one is for
+		 * a large item only, the rest of the current may be used */
+		if (size >= SCOLS_ARENA_CHUNKSIZ && ar->chunks) {
+			ch->next = ar->chunks->next;
+			ar->chunks->next = ch;
+		} else {
+			ch->next = ar->chunks;
+			ar->chunks = ch;
+		}
+		ar->size += sz;
+		off = 0;
+	}
+
+	ch->used = off + size;
+	return ch->data + off;
+}
+
+/* returns zeroed memory for @n cells */
+struct libscols_cell *scols_arena_alloc_cells(struct libscols_arena *ar, size_t n)
+{
+	struct libscols_cell *ce;
+	size_t sz = n * sizeof(struct libscols_cell);
+
+	ce = arena_alloc(ar, sz, sizeof(void *));
+	if (ce)
+		memset(ce, 0, sz);
+	return ce;
+}
+
+char *scols_arena_strdup(struct libscols_arena *ar, const char *str)
+{
+	size_t sz = strlen(str) + 1;
+	char *p = arena_alloc(ar, sz, 1);
+
+	if (p)
+		memcpy(p, str, sz);
+	return p;
+}
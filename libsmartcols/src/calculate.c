@@ -32,31 +32,66 @@ static void dbg_columns(struct libscols_table *tb)
 		dbg_column(tb, cl);
 }
 
+/*
+ * Returns display width of the cell data. The width is cached in the cell,
+ * so the wide chars are not counted again on the next calculation (another
+ * pass or print of the same table).
+ */
+static size_t get_cell_width(struct libscols_table *tb,
+			     struct libscols_line *ln,
+			     struct libscols_column *cl,
+			     struct libscols_cell *ce)
+{
+	unsigned int noenc = scols_table_is_noencoding(tb) ? 1 : 0;
+	const char *data = __scols_get_cell_data(cl, ln, ce);
+	size_t len;
+
+	if (!data)
+		return 0;
+	if (ce->width_cached && ce->width_noenc == noenc)
+		return ce->width;
+
+	len = noenc ? mbs_width(data) : mbs_safe_width(data);
+	if (len == (size_t) -1)		/* ignore broken multibyte strings */
+		len = 0;
+
+	ce->width = len;
+	ce->width_noenc = noenc;
+	ce->width_cached = 1;
+	return len;
+}
+
 static int count_cell_width(struct libscols_table *tb,
 		struct libscols_line *ln,
 		struct libscols_column *cl,
 		struct ul_buffer *buf)
 {
-	size_t len;
+	struct libscols_cell *ce = scols_line_get_cell(ln, cl->seqnum);
+	size_t len, treewidth = 0;
 	char *data;
 	int rc;
 
-	rc = __cell_to_buffer(tb, ln, cl, buf);
-	if (rc)
-		return rc;
-
-	data = ul_buffer_get_data(buf, NULL, NULL);
-	if (!data)
-		len = 0;
-	else if (scols_column_is_customwrap(cl))
-		len = cl->wrap_chunksize(cl, data, cl->wrapfunc_data);
-	else if (scols_table_is_noencoding(tb))
-		len = mbs_width(data);
-	else
-		len = mbs_safe_width(data);
+	if (scols_column_is_customwrap(cl)) {
+		rc = __cell_to_buffer(tb, ln, cl, buf);
+		if (rc)
+			return rc;
+		data = ul_buffer_get_data(buf, NULL, NULL);
+		len = data ? cl->wrap_chunksize(cl, data, cl->wrapfunc_data) : 0;
+		if (len == (size_t) -1)
+			len = 0;
+		if (scols_column_is_tree(cl))
+			treewidth = ul_buffer_get_safe_pointer_width(buf, SCOLS_BUFPTR_TREEEND);
+
+	} else if (scols_column_is_tree(cl)) {
+		/* only the ascii art width is used from the buffer */
+		rc = __cell_to_buffer(tb, ln, cl, buf);
+		if (rc)
+			return rc;
+		treewidth = ul_buffer_get_safe_pointer_width(buf, SCOLS_BUFPTR_TREEEND);
+		len = treewidth + get_cell_width(tb, ln, cl, ce);
+	} else
+		len = get_cell_width(tb, ln, cl, ce);
 
-	if (len == (size_t) -1)		/* ignore broken multibyte strings */
-		len = 0;
 	cl->width_max = max(len, cl->width_max);
 
 	if (cl->is_extreme && cl->width_avg && len > cl->width_avg * 2)
@@ -67,10 +102,8 @@ static int count_cell_width(struct libscols_table *tb,
 		cl->extreme_count++;
 	}
 	cl->width = max(len, cl->width);
-	if (scols_column_is_tree(cl)) {
-		size_t treewidth = ul_buffer_get_safe_pointer_width(buf, SCOLS_BUFPTR_TREEEND);
+	if (scols_column_is_tree(cl))
 		cl->width_treeart = max(cl->width_treeart, treewidth);
-	}
 	return 0;
 }
 
@@ -45,7 +45,8 @@ int scols_reset_cell(struct libscols_cell *ce)
 		return -EINVAL;
 
 	/*DBG(CELL, ul_debugobj(ce, "reset"));*/
-	free(ce->data);
+	if (!ce->arena_data)
+		free(ce->data);
 	free(ce->color);
 	memset(ce, 0, sizeof(*ce));
 	return 0;
@@ -62,6 +63,14 @@ int scols_reset_cell(struct libscols_cell *ce)
  */
 int scols_cell_set_data(struct libscols_cell *ce, const char *data)
 {
+	if (!ce)
+		return -EINVAL;
+	if (ce->arena_data) {
+		ce->data = NULL;	/* deallocated with the arena */
+		ce->arena_data = 0;
+	}
+	ce->width_cached = 0;
+	ce->lazy_done = 0;
 	return strdup_to_struct_member(ce, data, data);
 }
 
@@ -81,8 +90,12 @@ int scols_cell_refer_data(struct libscols_cell *ce, char *data)
 {
 	if (!ce)
 		return -EINVAL;
-	free(ce->data);
+	if (!ce->arena_data)
+		free(ce->data);
 	ce->data = data;
+	ce->arena_data = 0;
+	ce->width_cached = 0;
+	ce->lazy_done = 0;
 	return 0;
 }
 
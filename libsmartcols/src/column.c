@@ -376,6 +376,60 @@ int scols_column_set_cmpfunc(struct libscols_column *cl,
 	return 0;
 }
 
+/**
+ * scols_column_set_data_func:
+ * @cl: a pointer to a struct libscols_column instance
+ * @datafunc: function to return cell data
+ * @data: private data for @datafunc
+ *
+ * Sets function to produce the column cells data on demand. The function is
+ * called (only once for the cell) when the data are necessary for printing,
+ * width calculation or sort, and the cell data are not set. The function
+ * returns allocated string (deallocated by the library, like data set by
+ * scols_line_refer_data()) or NULL. It allows to not compute data for
+ * the hidden columns and for not printed lines.
+ *
+ * Note that scols_cell_get_data() does not call the function.
+ *
+ * Returns: 0, a negative value in case of an error.
+ *
+ * Since: 2.38
+ */
+int scols_column_set_data_func(struct libscols_column *cl,
+			char *(*datafunc)(struct libscols_column *,
+					  struct libscols_line *,
+					  void *),
+			void *data)
+{
+	if (!cl)
+		return -EINVAL;
+
+	cl->datafunc = datafunc;
+	cl->datafunc_data = data;
+	return 0;
+}
+
+/*
+ * Returns cell data, the data are produced by the column data function if
+ * not set yet.
+ */
+const char *__scols_get_cell_data(struct libscols_column *cl,
+				  struct libscols_line *ln,
+				  struct libscols_cell *ce)
+{
+	char *data;
+
+	if (!ce)
+		return NULL;
+	if (ce->data || !cl->datafunc || ce->lazy_done)
+		return ce->data;
+
+	data = cl->datafunc(cl, ln, cl->datafunc_data);
+	scols_cell_refer_data(ce, data);
+	ce->lazy_done = 1;
+	return ce->data;
+}
+
 /**
  * scols_column_set_wrapfunc:
  * @cl: a pointer to a struct libscols_column instance
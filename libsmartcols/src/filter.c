@@ -0,0 +1,802 @@
+/*
+ * filter.c - filter expressions
+ *
+ * This file may be redistributed under the terms of the
+ * GNU Lesser General Public License.
+ */
+
+/**
+ * SECTION: filter
+ * @title: Filter
+ * @short_description: filter expressions for table lines
+ *
+ * The filter expression is compiled once by scols_filter_parse_string() to a
+ * simple stack based program. The program is evaluated for the lines of the
+ * table (see scols_table_set_filter()) and the lines which do not match are
+ * removed from the table as soon as they are complete, so they are never
+ * printed and they are not kept in memory.
+ *
+ * The expression syntax:
+ *
+ * <informalexample>
+ *   <programlisting>
+ * expr    := expr "||" expr | expr "&&" expr | "!" expr | "(" expr ")"
+ *          | operand | operand op operand
+ * op      := "==" | "!=" | "<" | "<=" | ">" | ">=" | "=~" | "!~"
+ * operand := column | "string" | 'string' | number | true | false
+ *   </programlisting>
+ * </informalexample>
+ *
+ * The keywords "or", "and", "not", "eq", "ne", "lt", "le", "gt" and "ge" are
+ * accepted too. The column is specified by the column header (case
+ * insensitive). The number may be followed by K, M, G, T, P, E, Z or Y suffix
+ * (2^N, optionally followed by "iB") or by KB, MB, ... (10^N), for example
+ * 'SIZE > 1G'. The operands are compared as numbers if both are numbers,
+ * otherwise as strings. The right side of "=~" and "!~" is an extended
+ * regular expression. A standalone operand is true if it's not empty and not
+ * zero.
+ */
+#include <ctype.h>
+#include <regex.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "smartcolsP.h"
+
+/* instructions */
+enum {
+	F_OP_COLUMN,	/* push column data, arg is param */
+	F_OP_CONST,	/* push constant, arg is param */
+	F_OP_BOOL,	/* convert the top to boolean */
+	F_OP_NOT,	/* negate the top */
+	F_OP_AND,	/* jump to arg if the top is false, else pop */
+	F_OP_OR,	/* jump to arg if the top is true, else pop */
+	F_OP_REGEX,	/* match the top by regex, arg is param */
+	F_OP_NREGEX,
+	F_OP_EQ,
+	F_OP_NE,
+	F_OP_LT,
+	F_OP_LE,
+	F_OP_GT,
+	F_OP_GE
+};
+
+struct filter_insn {
+	int	op;
+	size_t	arg;
+};
+
+struct filter_param {
+	char			*str;	/* column name, string or regex */
+	long double		num;
+	struct libscols_column	*col;	/* resolved column for F_OP_COLUMN */
+	regex_t			re;
+
+	unsigned int	is_num :1,
+			has_re :1;
+};
+
+/* evaluation stack item */
+struct filter_value {
+	const char	*str;
+	long double	num;
+	int		num_state;	/* 0: unknown, 1: number, -1: string */
+};
+
+struct libscols_filter {
+	int	refcount;
+	char	*errmsg;
+
+	struct filter_insn	*code;
+	size_t			ncode;
+
+	struct filter_param	*params;
+	size_t			nparams;
+
+	struct filter_value	*stack;		/* ncode items */
+};
+
+/* tokens */
+enum {
+	F_TK_END,
+	F_TK_LPAREN,
+	F_TK_RPAREN,
+	F_TK_AND,
+	F_TK_OR,
+	F_TK_NOT,
+	F_TK_CMP,	/* F_OP_{EQ,NE,...} in tk_op */
+	F_TK_NAME,
+	F_TK_STRING,
+	F_TK_TRUE,
+	F_TK_FALSE
+};
+
+struct filter_parser {
+	struct libscols_filter	*fltr;
+	const char	*str;		/* expression */
+	const char	*p;		/* the next token */
+
+	int		tk;		/* the current token */
+	int		tk_op;		/* F_OP_* for F_TK_CMP */
+	const char	*tk_start;	/* the current token in @str */
+	char		*tk_str;	/* F_TK_NAME and F_TK_STRING */
+};
+
+static const struct {
+	const char	*name;
+	int		tk;
+	int		op;
+} filter_keywords[] = {
+	{ "and",   F_TK_AND,   0 },
+	{ "eq",	   F_TK_CMP,   F_OP_EQ },
+	{ "false", F_TK_FALSE, 0 },
+	{ "ge",	   F_TK_CMP,   F_OP_GE },
+	{ "gt",	   F_TK_CMP,   F_OP_GT },
+	{ "le",	   F_TK_CMP,   F_OP_LE },
+	{ "lt",	   F_TK_CMP,   F_OP_LT },
+	{ "ne",	   F_TK_CMP,   F_OP_NE },
+	{ "not",   F_TK_NOT,   0 },
+	{ "or",	   F_TK_OR,    0 },
+	{ "true",  F_TK_TRUE,  0 }
+};
+
+/**
+ * scols_new_filter:
+ *
+ * Returns: A newly allocated filter without expression, see
+ * scols_filter_parse_string().
+ *
+ * Since: 2.38
+ */
+struct libscols_filter *scols_new_filter(void)
+{
+	struct libscols_filter *fltr = calloc(1, sizeof(*fltr));
+
+	if (!fltr)
+		return NULL;
+	DBG(FLTR, ul_debugobj(fltr, "alloc"));
+	fltr->refcount = 1;
+	return fltr;
+}
+
+/**
+ * scols_ref_filter:
+ * @fltr: filter
+ *
+ * Increases the refcount of @fltr.
+ *
+ * Since: 2.38
+ */
+void scols_ref_filter(struct libscols_filter *fltr)
+{
+	if (fltr)
+		fltr->refcount++;
+}
+
+static void reset_filter(struct libscols_filter *fltr)
+{
+	size_t i;
+
+	for (i = 0; i < fltr->nparams; i++) {
+		struct filter_param *pa = &fltr->params[i];
+
+		if (pa->has_re)
+			regfree(&pa->re);
+		scols_unref_column(pa->col);
+		free(pa->str);
+	}
+	free(fltr->params);
+	free(fltr->code);
+	free(fltr->stack);
+	free(fltr->errmsg);
+
+	fltr->params = NULL;
+	fltr->nparams = 0;
+	fltr->code = NULL;
+	fltr->ncode = 0;
+	fltr->stack = NULL;
+	fltr->errmsg = NULL;
+}
+
+/**
+ * scols_unref_filter:
+ * @fltr: filter
+ *
+ * Decreases the refcount of @fltr. When the refcount reaches zero, the
+ * @fltr is deallocated.
+ *
+ * Since: 2.38
+ */
+void scols_unref_filter(struct libscols_filter *fltr)
+{
+	if (fltr && --fltr->refcount <= 0) {
+		DBG(FLTR, ul_debugobj(fltr, "dealloc"));
+		reset_filter(fltr);
+		free(fltr);
+	}
+}
+
+/**
+ * scols_filter_get_errmsg:
+ * @fltr: filter
+ *
+ * Returns: the last parse or column resolution error message or NULL.
+ *
+ * Since: 2.38
+ */
+const char *scols_filter_get_errmsg(struct libscols_filter *fltr)
+{
+	return fltr ? fltr->errmsg : NULL;
+}
+
+static int set_errmsg(struct libscols_filter *fltr, const char *fmt, ...)
+{
+	va_list ap;
+	int rc;
+
+	free(fltr->errmsg);
+	fltr->errmsg = NULL;
+
+	va_start(ap, fmt);
+	rc = vasprintf(&fltr->errmsg, fmt, ap);
+	va_end(ap);
+
+	if (rc < 0) {
+		fltr->errmsg = NULL;
+		return -ENOMEM;
+	}
+	DBG(FLTR, ul_debugobj(fltr, "error: %s", fltr->errmsg));
+	return -EINVAL;
+}
+
+/*
+ * Parses "<digits>[.<digits>][<suffix>]", the suffix is K, M, G, ... or KiB,
+ * MiB, ... for 2^N, or KB, MB, ... for 10^N. The decimal point may be '.' or
+ * ',' (the human readable sizes are printed by locale).
+ */
+static int parse_number(const char *str, long double *res)
+{
+	static const char *suf = "KMGTPEZY";
+	const char *p = str;
+	long double x = 0;
+	int neg = 0, ndigits = 0;
+
+	if (*p == '-')
+		neg = 1, p++;
+
+	for (; isdigit((unsigned char) *p); p++, ndigits++)
+		x = x * 10 + (*p - '0');
+
+	if (*p == '.' || *p == ',') {
+		long double f = 0.1;
+
+		for (p++; isdigit((unsigned char) *p); p++, ndigits++, f /= 10)
+			x += (*p - '0') * f;
+	}
+	if (!ndigits)
+		return -EINVAL;
+
+	if (*p) {
+		const char *sp = strchr(suf, toupper((unsigned char) *p));
+		int base = 1024, pwr;
+
+		if (!sp)
+			return -EINVAL;
+		pwr = sp - suf + 1;
+		p++;
+
+		if (*p == 'i' && *(p + 1) == 'B')
+			p += 2;
+		else if (*p == 'B') {
+			base = 1000;
+			p++;
+		}
+		if (*p)
+			return -EINVAL;
+		while (pwr-- > 0)
+			x *= base;
+	}
+
+	*res = neg ? -x : x;
+	return 0;
+}
+
+static int add_param(struct libscols_filter *fltr, const char *str, size_t *idx)
+{
+	struct filter_param *pa;
+
+	pa = realloc(fltr->params, (fltr->nparams + 1) * sizeof(*pa));
+	if (!pa)
+		return -ENOMEM;
+	fltr->params = pa;
+
+	pa = &fltr->params[fltr->nparams];
+	memset(pa, 0, sizeof(*pa));
+	pa->str = strdup(str);
+	if (!pa->str)
+		return -ENOMEM;
+	if (parse_number(str, &pa->num) == 0)
+		pa->is_num = 1;
+
+	*idx = fltr->nparams++;
+	return 0;
+}
+
+/* returns index of the new instruction or a negative number on error */
+static ssize_t emit(struct libscols_filter *fltr, int op, size_t arg)
+{
+	struct filter_insn *in;
+
+	in = realloc(fltr->code, (fltr->ncode + 1) * sizeof(*in));
+	if (!in)
+		return -ENOMEM;
+	fltr->code = in;
+	fltr->code[fltr->ncode].op = op;
+	fltr->code[fltr->ncode].arg = arg;
+
+	return fltr->ncode++;
+}
+
+static int parse_error(struct filter_parser *pr, const char *msg)
+{
+	if (pr->tk == F_TK_END)
+		return set_errmsg(pr->fltr, "%s at the end of the expression", msg);
+
+	return set_errmsg(pr->fltr, "%s at position %zu",
+			msg, (size_t) (pr->tk_start - pr->str) + 1);
+}
+
+static inline int is_name_char(int c)
+{
+	return c && (isalnum(c) || strchr("_:%.,-/", c));
+}
+
+static int next_token(struct filter_parser *pr)
+{
+	const char *p = pr->p;
+
+	free(pr->tk_str);
+	pr->tk_str = NULL;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	pr->tk_start = p;
+
+	switch (*p) {
+	case '\0':
+		pr->tk = F_TK_END;
+		break;
+	case '(':
+		pr->tk = F_TK_LPAREN;
+		p++;
+		break;
+	case ')':
+		pr->tk = F_TK_RPAREN;
+		p++;
+		break;
+	case '&':
+	case '|':
+		if (*(p + 1) != *p)
+			goto unexpected;
+		pr->tk = *p == '&' ? F_TK_AND : F_TK_OR;
+		p += 2;
+		break;
+	case '!':
+		if (*(p + 1) == '=' || *(p + 1) == '~') {
+			pr->tk = F_TK_CMP;
+			pr->tk_op = *(p + 1) == '=' ? F_OP_NE : F_OP_NREGEX;
+			p += 2;
+		} else {
+			pr->tk = F_TK_NOT;
+			p++;
+		}
+		break;
+	case '=':
+		if (*(p + 1) != '=' && *(p + 1) != '~')
+			goto unexpected;
+		pr->tk = F_TK_CMP;
+		pr->tk_op = *(p + 1) == '=' ? F_OP_EQ : F_OP_REGEX;
+		p += 2;
+		break;
+	case '<':
+	case '>':
+		pr->tk = F_TK_CMP;
+		if (*(p + 1) == '=') {
+			pr->tk_op = *p == '<' ? F_OP_LE : F_OP_GE;
+			p += 2;
+		} else {
+			pr->tk_op = *p == '<' ? F_OP_LT : F_OP_GT;
+			p++;
+		}
+		break;
+	case '"':
+	case '\'':
+	{
+		char quote = *p++, *s;
+
+		s = pr->tk_str = malloc(strlen(p) + 1);
+		if (!s)
+			return -ENOMEM;
+		while (*p && *p != quote) {
+			if (*p == '\\' && *(p + 1))
+				p++;
+			*s++ = *p++;
+		}
+		*s = '\0';
+		if (!*p)
+			return parse_error(pr, "unterminated string");
+		p++;
+		pr->tk = F_TK_STRING;
+		break;
+	}
+	default:
+	{
+		size_t i, sz;
+
+		if (!is_name_char((unsigned char) *p))
+			goto unexpected;
+		for (sz = 0; *(p + sz) && is_name_char((unsigned char) *(p + sz)); sz++);
+
+		pr->tk_str = strndup(p, sz);
+		if (!pr->tk_str)
+			return -ENOMEM;
+		p += sz;
+
+		pr->tk = F_TK_NAME;
+		for (i = 0; i < ARRAY_SIZE(filter_keywords); i++) {
+			if (strcasecmp(pr->tk_str, filter_keywords[i].name) == 0) {
+				pr->tk = filter_keywords[i].tk;
+				pr->tk_op = filter_keywords[i].op;
+				break;
+			}
+		}
+
+		/* numbers and things like "8:0" are constants */
+		if (pr->tk == F_TK_NAME
+		    && (isdigit((unsigned char) *pr->tk_start) || *pr->tk_start == '-'))
+			pr->tk = F_TK_STRING;
+		break;
+	}
+	}
+
+	pr->p = p;
+	return 0;
+unexpected:
+	return parse_error(pr, "unexpected character");
+}
+
+static int parse_or(struct filter_parser *pr);
+
+/* emits push of the current operand */
+static int parse_operand(struct filter_parser *pr)
+{
+	struct libscols_filter *fltr = pr->fltr;
+	size_t idx;
+	int rc, op;
+
+	switch (pr->tk) {
+	case F_TK_NAME:
+		op = F_OP_COLUMN;
+		rc = add_param(fltr, pr->tk_str, &idx);
+		break;
+	case F_TK_STRING:
+		op = F_OP_CONST;
+		rc = add_param(fltr, pr->tk_str, &idx);
+		break;
+	case F_TK_TRUE:
+	case F_TK_FALSE:
+		op = F_OP_CONST;
+		rc = add_param(fltr, pr->tk == F_TK_TRUE ? "1" : "0", &idx);
+		break;
+	default:
+		return parse_error(pr, "operand expected");
+	}
+
+	if (!rc && emit(fltr, op, idx) < 0)
+		rc = -ENOMEM;
+	if (!rc)
+		rc = next_token(pr);
+	return rc;
+}
+
+static int parse_regex(struct filter_parser *pr, int op)
+{
+	struct libscols_filter *fltr = pr->fltr;
+	struct filter_param *pa;
+	size_t idx;
+	int rc;
+
+	if (pr->tk != F_TK_STRING)
+		return parse_error(pr, "regular expression expected");
+
+	rc = add_param(fltr, pr->tk_str, &idx);
+	if (rc)
+		return rc;
+
+	pa = &fltr->params[idx];
+	rc = regcomp(&pa->re, pa->str, REG_EXTENDED | REG_NOSUB);
+	if (rc) {
+		char buf[128];
+
+		regerror(rc, &pa->re, buf, sizeof(buf));
+		return parse_error(pr, buf);
+	}
+	pa->has_re = 1;
+
+	if (emit(fltr, op, idx) < 0)
+		return -ENOMEM;
+	return next_token(pr);
+}
+
+static int parse_primary(struct filter_parser *pr)
+{
+	int rc, op;
+
+	if (pr->tk == F_TK_LPAREN) {
+		rc = next_token(pr);
+		if (!rc)
+			rc = parse_or(pr);
+		if (!rc && pr->tk != F_TK_RPAREN)
+			rc = parse_error(pr, "')' expected");
+		if (!rc)
+			rc = next_token(pr);
+		return rc;
+	}
+
+	rc = parse_operand(pr);
+	if (rc)
+		return rc;
+
+	if (pr->tk != F_TK_CMP)
+		return emit(pr->fltr, F_OP_BOOL, 0) < 0 ? -ENOMEM : 0;
+
+	op = pr->tk_op;
+	rc = next_token(pr);
+	if (rc)
+		return rc;
+
+	if (op == F_OP_REGEX || op == F_OP_NREGEX)
+		return parse_regex(pr, op);
+
+	rc = parse_operand(pr);
+	if (!rc && emit(pr->fltr, op, 0) < 0)
+		rc = -ENOMEM;
+	return rc;
+}
+
+static int parse_not(struct filter_parser *pr)
+{
+	int rc;
+
+	if (pr->tk != F_TK_NOT)
+		return parse_primary(pr);
+
+	rc = next_token(pr);
+	if (!rc)
+		rc = parse_not(pr);
+	if (!rc && emit(pr->fltr, F_OP_NOT, 0) < 0)
+		rc = -ENOMEM;
+	return rc;
+}
+
+/* "a && b" is "a; AND end; b; end:" where AND keeps false on the stack */
+static int parse_logical(struct filter_parser *pr, int tk, int op,
+			 int (*parse)(struct filter_parser *))
+{
+	int rc = parse(pr);
+
+	while (!rc && pr->tk == tk) {
+		ssize_t jmp = emit(pr->fltr, op, 0);
+
+		if (jmp < 0)
+			return -ENOMEM;
+		rc = next_token(pr);
+		if (!rc)
+			rc = parse(pr);
+		pr->fltr->code[jmp].arg = pr->fltr->ncode;
+	}
+	return rc;
+}
+
+static int parse_and(struct filter_parser *pr)
+{
+	return parse_logical(pr, F_TK_AND, F_OP_AND, parse_not);
+}
+
+static int parse_or(struct filter_parser *pr)
+{
+	return parse_logical(pr, F_TK_OR, F_OP_OR, parse_and);
+}
+
+/**
+ * scols_filter_parse_string:
+ * @fltr: filter
+ * @str: expression
+ *
+ * Compiles the expression @str, the previous expression is removed. See
+ * scols_filter_get_errmsg() for the error message and the filter section
+ * description for the syntax.
+ *
+ * Returns: 0 on success, negative number in case of an error (-EINVAL on
+ * syntax error).
+ *
+ * Since: 2.38
+ */
+int scols_filter_parse_string(struct libscols_filter *fltr, const char *str)
+{
+	struct filter_parser pr = { .fltr = fltr, .str = str, .p = str };
+	int rc;
+
+	if (!fltr || !str)
+		return -EINVAL;
+
+	DBG(FLTR, ul_debugobj(fltr, "parse: '%s'", str));
+	reset_filter(fltr);
+
+	rc = next_token(&pr);
+	if (!rc)
+		rc = parse_or(&pr);
+	if (!rc && pr.tk != F_TK_END)
+		rc = parse_error(&pr, "unexpected token");
+	free(pr.tk_str);
+
+	if (!rc) {
+		fltr->stack = malloc(fltr->ncode * sizeof(struct filter_value));
+		if (!fltr->stack)
+			rc = -ENOMEM;
+	}
+	if (rc) {
+		char *msg = fltr->errmsg;
+
+		fltr->errmsg = NULL;
+		reset_filter(fltr);
+		fltr->errmsg = msg;
+		return rc;
+	}
+
+	DBG(FLTR, ul_debugobj(fltr, "compiled [%zu instructions, %zu params]",
+				fltr->ncode, fltr->nparams));
+	return 0;
+}
+
+/*
+ * Resolves the column names used by @fltr for @tb.
+ */
+int __scols_filter_resolve(struct libscols_filter *fltr, struct libscols_table *tb)
+{
+	size_t i;
+
+	for (i = 0; i < fltr->ncode; i++) {
+		struct filter_param *pa;
+		struct libscols_column *cl;
+		struct libscols_iter itr;
+
+		if (fltr->code[i].op != F_OP_COLUMN)
+			continue;
+		pa = &fltr->params[fltr->code[i].arg];
+
+		scols_unref_column(pa->col);
+		pa->col = NULL;
+
+		scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+		while (scols_table_next_column(tb, &itr, &cl) == 0) {
+			const char *name = scols_cell_get_data(&cl->header);
+
+			if (name && strcasecmp(name, pa->str) == 0) {
+				pa->col = cl;
+				scols_ref_column(cl);
+				break;
+			}
+		}
+		if (!pa->col)
+			return set_errmsg(fltr, "unknown column '%s'", pa->str);
+	}
+	return 0;
+}
+
+static inline int value_is_number(struct filter_value *v)
+{
+	if (!v->num_state)
+		v->num_state = parse_number(v->str, &v->num) == 0 ? 1 : -1;
+	return v->num_state == 1;
+}
+
+static inline int value_is_true(struct filter_value *v)
+{
+	return value_is_number(v) ? v->num != 0 : *v->str != '\0';
+}
+
+static inline void set_bool(struct filter_value *v, int x)
+{
+	v->str = x ? "1" : "0";
+	v->num = x ? 1 : 0;
+	v->num_state = 1;
+}
+
+static int compare_values(struct filter_value *a, struct filter_value *b)
+{
+	if (value_is_number(a) && value_is_number(b))
+		return a->num < b->num ? -1 : a->num > b->num;
+	return strcmp(a->str, b->str);
+}
+
+/*
+ * Returns 1 if @ln matches @fltr, columns have to be resolved by
+ * __scols_filter_resolve() for @tb.
+ */
+int __scols_filter_match(struct libscols_filter *fltr,
+			 struct libscols_table *tb,
+			 struct libscols_line *ln)
+{
+	struct filter_value *st = fltr->stack, *v;
+	size_t i = 0, n = 0;
+
+	if (!fltr->ncode)
+		return 1;
+
+	while (i < fltr->ncode) {
+		struct filter_insn *in = &fltr->code[i++];
+		struct filter_param *pa;
+		int x;
+
+		switch (in->op) {
+		case F_OP_COLUMN:
+		{
+			const char *data = NULL;
+
+			pa = &fltr->params[in->arg];
+			if (pa->col && pa->col->table == tb)
+				data = __scols_get_cell_data(pa->col, ln,
+						scols_line_get_column_cell(ln, pa->col));
+			v = &st[n++];
+			v->str = data ? data : "";
+			v->num_state = 0;
+			break;
+		}
+		case F_OP_CONST:
+			pa = &fltr->params[in->arg];
+			v = &st[n++];
+			v->str = pa->str;
+			v->num = pa->num;
+			v->num_state = pa->is_num ? 1 : -1;
+			break;
+		case F_OP_BOOL:
+			set_bool(&st[n - 1], value_is_true(&st[n - 1]));
+			break;
+		case F_OP_NOT:
+			set_bool(&st[n - 1], !value_is_true(&st[n - 1]));
+			break;
+		case F_OP_AND:
+		case F_OP_OR:
+			x = value_is_true(&st[n - 1]);
+			if (in->op == F_OP_AND ? !x : x)
+				i = in->arg;
+			else
+				n--;
+			break;
+		case F_OP_REGEX:
+		case F_OP_NREGEX:
+			pa = &fltr->params[in->arg];
+			x = regexec(&pa->re, st[n - 1].str, 0, NULL, 0) == 0;
+			set_bool(&st[n - 1], in->op == F_OP_REGEX ? x : !x);
+			break;
+		default:
+			x = compare_values(&st[n - 2], &st[n - 1]);
+			n--;
+			switch (in->op) {
+			case F_OP_EQ: x = x == 0; break;
+			case F_OP_NE: x = x != 0; break;
+			case F_OP_LT: x = x < 0; break;
+			case F_OP_LE: x = x <= 0; break;
+			case F_OP_GT: x = x > 0; break;
+			case F_OP_GE: x = x >= 0; break;
+			}
+			set_bool(&st[n - 1], x);
+			break;
+		}
+	}
+
+	return value_is_true(&st[0]);
+}
@@ -16,6 +16,7 @@
 #include <stdarg.h>
 
 #include "smartcolsP.h"
+#include "ulstats.h"
 
 UL_DEBUG_DEFINE_MASK(libsmartcols);
 UL_DEBUG_DEFINE_MASKNAMES(libsmartcols) =
@@ -24,6 +25,7 @@ UL_DEBUG_DEFINE_MASKNAMES(libsmartcols) =
 	{ "buff", SCOLS_DEBUG_BUFF,	"output buffer utils" },
 	{ "cell", SCOLS_DEBUG_CELL,	"table cell utils" },
 	{ "col", SCOLS_DEBUG_COL,	"cols utils" },
+	{ "filter", SCOLS_DEBUG_FLTR,	"filter utils" },
 	{ "help", SCOLS_DEBUG_HELP,	"this help" },
 	{ "group", SCOLS_DEBUG_GROUP,	"lines grouping utils" },
 	{ "line", SCOLS_DEBUG_LINE,	"table line utils" },
@@ -47,6 +49,7 @@ void scols_init_debug(int mask)
 		return;
 
 	__UL_INIT_DEBUG_FROM_ENV(libsmartcols, SCOLS_DEBUG_, mask, LIBSMARTCOLS_DEBUG);
+	ul_stats_init("libsmartcols");
 
 	if (libsmartcols_debug_mask != SCOLS_DEBUG_INIT
 	    && libsmartcols_debug_mask != (SCOLS_DEBUG_HELP|SCOLS_DEBUG_INIT)) {
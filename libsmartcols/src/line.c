@@ -79,6 +79,7 @@ void scols_unref_line(struct libscols_line *ln)
 		list_del(&ln->ln_groups);
 		scols_unref_group(ln->group);
 		scols_line_free_cells(ln);
+		scols_unref_arena(ln->arena);
 		free(ln->color);
 		free(ln);
 		return;
@@ -103,7 +104,8 @@ void scols_line_free_cells(struct libscols_line *ln)
 	for (i = 0; i < ln->ncells; i++)
 		scols_reset_cell(&ln->cells[i]);
 
-	free(ln->cells);
+	if (!ln->arena)
+		free(ln->cells);
 	ln->ncells = 0;
 	ln->cells = NULL;
 }
@@ -136,13 +138,30 @@ int scols_line_alloc_cells(struct libscols_line *ln, size_t n)
 
 	DBG(LINE, ul_debugobj(ln, "alloc %zu cells", n));
 
-	ce = realloc(ln->cells, n * sizeof(struct libscols_cell));
-	if (!ce)
-		return -errno;
-
-	if (n > ln->ncells)
-		memset(ce + ln->ncells, 0,
-		       (n - ln->ncells) * sizeof(struct libscols_cell));
+	if (ln->arena) {
+		/* the old array is deallocated with the arena */
+		if (n < ln->ncells) {
+			size_t i;
+
+			for (i = n; i < ln->ncells; i++)
+				scols_reset_cell(&ln->cells[i]);
+			ln->ncells = n;
+			return 0;
+		}
+		ce = scols_arena_alloc_cells(ln->arena, n);
+		if (!ce)
+			return -ENOMEM;
+		if (ln->ncells)
+			memcpy(ce, ln->cells, ln->ncells * sizeof(struct libscols_cell));
+	} else {
+		ce = realloc(ln->cells, n * sizeof(struct libscols_cell));
+		if (!ce)
+			return -errno;
+
+		if (n > ln->ncells)
+			memset(ce + ln->ncells, 0,
+			       (n - ln->ncells) * sizeof(struct libscols_cell));
+	}
 
 	ln->cells = ce;
 	ln->ncells = n;
@@ -439,10 +458,26 @@ struct libscols_cell *scols_line_get_column_cell(
 int scols_line_set_data(struct libscols_line *ln, size_t n, const char *data)
 {
 	struct libscols_cell *ce = scols_line_get_cell(ln, n);
+	char *p = NULL;
 
 	if (!ce)
 		return -EINVAL;
-	return scols_cell_set_data(ce, data);
+	if (!ln->arena)
+		return scols_cell_set_data(ce, data);
+
+	/* line allocated by table with arena, see scols_table_enable_arena() */
+	if (data) {
+		p = scols_arena_strdup(ln->arena, data);
+		if (!p)
+			return -ENOMEM;
+	}
+	if (!ce->arena_data)
+		free(ce->data);
+	ce->data = p;
+	ce->arena_data = 1;
+	ce->width_cached = 0;
+	ce->lazy_done = 0;
+	return 0;
 }
 
 /**
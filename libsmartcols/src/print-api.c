@@ -1,4 +1,5 @@
 #include "smartcolsP.h"
+#include "ulstats.h"
 
 /**
  * scola_table_print_range:
@@ -24,9 +25,12 @@ int scols_table_print_range(	struct libscols_table *tb,
 
 	DBG(TAB, ul_debugobj(tb, "printing range from API"));
 
+	UL_STATS_BEGIN(UL_STATS_PRINT);
 	rc = __scols_initialize_printing(tb, &buf);
-	if (rc)
+	if (rc) {
+		UL_STATS_END(UL_STATS_PRINT);
 		return rc;
+	}
 
 	if (start) {
 		itr.direction = SCOLS_ITER_FORWARD;
@@ -44,6 +48,7 @@ int scols_table_print_range(	struct libscols_table *tb,
 	rc = __scols_print_range(tb, &buf, &itr, end);
 done:
 	__scols_cleanup_printing(tb, &buf);
+	UL_STATS_END(UL_STATS_PRINT);
 	return rc;
 }
 
@@ -114,9 +119,28 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 		DBG(TAB, ul_debugobj(tb, "error -- no columns"));
 		return -EINVAL;
 	}
+
+	if (tb->filter)
+		__scols_table_filter_lines(tb, 1);
+
+	/* streaming mode, print the rest of the table */
+	if (tb->stream_started) {
+		rc = __scols_print_stream(tb);
+		if (scols_table_is_json(tb) && !tb->ndjson) {
+			ul_jsonwrt_array_close(&tb->json);
+			ul_jsonwrt_root_close(&tb->json);
+		}
+		__scols_cleanup_printing(tb, &tb->stream_buf);
+		tb->stream_started = 0;
+		tb->stream_last = NULL;
+		return rc;
+	}
+
 	if (list_empty(&tb->tb_lines)) {
 		DBG(TAB, ul_debugobj(tb, "ignore -- no lines"));
-		if (scols_table_is_json(tb)) {
+		if (scols_table_is_ndjson(tb))
+			;	/* nothing, no lines */
+		else if (scols_table_is_json(tb)) {
 			ul_jsonwrt_init(&tb->json, tb->out, 0);
 			ul_jsonwrt_root_open(&tb->json);
 			ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
@@ -132,7 +156,7 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	if (rc)
 		return rc;
 
-	if (scols_table_is_json(tb)) {
+	if (scols_table_is_json(tb) && !tb->ndjson) {
 		ul_jsonwrt_root_open(&tb->json);
 		ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
 	}
@@ -144,12 +168,13 @@ static int do_print_table(struct libscols_table *tb, int *is_empty)
 	if (rc)
 		goto done;
 
-	if (scols_table_is_tree(tb))
+	/* NDJSON prints trees as flat lists with references to parents */
+	if (scols_table_is_tree(tb) && !tb->ndjson)
 		rc = __scols_print_tree(tb, &buf);
 	else
 		rc = __scols_print_table(tb, &buf);
 
-	if (scols_table_is_json(tb)) {
+	if (scols_table_is_json(tb) && !tb->ndjson) {
 		ul_jsonwrt_array_close(&tb->json);
 		ul_jsonwrt_root_close(&tb->json);
 	}
@@ -169,10 +194,14 @@ done:
 int scols_print_table(struct libscols_table *tb)
 {
 	int empty = 0;
-	int rc = do_print_table(tb, &empty);
+	int rc;
+
+	UL_STATS_BEGIN(UL_STATS_PRINT);
+	rc = do_print_table(tb, &empty);
 
 	if (rc == 0 && !empty && !scols_table_is_json(tb))
 		fputc('\n', tb->out);
+	UL_STATS_END(UL_STATS_PRINT);
 	return rc;
 }
 
@@ -204,7 +233,9 @@ int scols_print_table_to_string(struct libscols_table *tb, char **data)
 
 	old_stream = scols_table_get_stream(tb);
 	scols_table_set_stream(tb, stream);
+	UL_STATS_BEGIN(UL_STATS_PRINT);
 	rc = do_print_table(tb, NULL);
+	UL_STATS_END(UL_STATS_PRINT);
 	fclose(stream);
 	scols_table_set_stream(tb, old_stream);
 
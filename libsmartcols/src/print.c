@@ -79,8 +79,7 @@ static int is_next_columns_empty(
 			return 0;
 
 		ce = scols_line_get_cell(ln, cl->seqnum);
-		if (ce)
-			data = scols_cell_get_data(ce);
+		data = __scols_get_cell_data(cl, ln, ce);
 		if (data && *data)
 			return 0;
 	}
@@ -226,6 +225,11 @@ static void fputs_color_reset(struct libscols_table *tb)
 
 static void fputs_color(struct libscols_table *tb, const char *color)
 {
+	/* already active, don't write the same sequence again */
+	if (color && tb->cur_color
+	    && (color == tb->cur_color || strcmp(color, tb->cur_color) == 0))
+		return;
+
 	if (tb->cur_color)
 		fputs_color_reset(tb);
 
@@ -234,6 +238,25 @@ static void fputs_color(struct libscols_table *tb, const char *color)
 		fputs(color, tb->out);
 }
 
+/* writes @n padding symbols, the spaces are written by one fwrite() */
+static void fputs_cellpadding(struct libscols_table *tb, size_t n)
+{
+	static const char spaces[] = "                                ";
+	const char *sym = cellpadding_symbol(tb);
+
+	if (*sym == ' ' && !*(sym + 1)) {
+		while (n) {
+			size_t sz = min(n, sizeof(spaces) - 1);
+
+			fwrite(spaces, 1, sz, tb->out);
+			n -= sz;
+		}
+	} else {
+		while (n--)
+			fputs(sym, tb->out);
+	}
+}
+
 static const char *get_cell_color(struct libscols_table *tb,
 				struct libscols_column *cl,
 				struct libscols_line *ln,
@@ -295,8 +318,7 @@ static void fputs_color_line_close(struct libscols_table *tb)
 static void print_empty_cell(struct libscols_table *tb,
 			  struct libscols_column *cl,
 			  struct libscols_line *ln,	/* optional */
-			  struct libscols_cell *ce,
-			  size_t bufsz)
+			  struct libscols_cell *ce)
 {
 	size_t len_pad = 0;		/* in screen cells as opposed to bytes */
 
@@ -317,24 +339,25 @@ static void print_empty_cell(struct libscols_table *tb,
 		} else {
 			/* use the same draw function as though we were intending to draw an L-shape */
 			struct ul_buffer art = UL_INIT_BUFFER;
+			char artmem[256];	/* usually enough, moved to heap if not */
 			char *data;
 
-			if (ul_buffer_alloc_data(&art, bufsz) == 0) {
-				/* whatever the rc, len_pad will be sensible */
-				tree_ascii_art_to_buffer(tb, ln, &art);
+			ul_buffer_set_storage(&art, artmem, sizeof(artmem));
 
-				if (!list_empty(&ln->ln_branch) && has_pending_data(tb))
-					ul_buffer_append_string(&art, vertical_symbol(tb));
+			/* whatever the rc, len_pad will be sensible */
+			tree_ascii_art_to_buffer(tb, ln, &art);
 
-				if (scols_table_is_noencoding(tb))
-					data = ul_buffer_get_data(&art, NULL, &len_pad);
-				else
-					data = ul_buffer_get_safe_data(&art, NULL, &len_pad, NULL);
+			if (!list_empty(&ln->ln_branch) && has_pending_data(tb))
+				ul_buffer_append_string(&art, vertical_symbol(tb));
 
-				if (data && len_pad)
-					fputs(data, tb->out);
-				ul_buffer_free_data(&art);
-			}
+			if (scols_table_is_noencoding(tb))
+				data = ul_buffer_get_data(&art, NULL, &len_pad);
+			else
+				data = ul_buffer_get_safe_data(&art, NULL, &len_pad, NULL);
+
+			if (data && len_pad)
+				fputs(data, tb->out);
+			ul_buffer_free_data(&art);
 		}
 	}
 
@@ -351,8 +374,8 @@ static void print_empty_cell(struct libscols_table *tb,
 	}
 
 	/* fill rest of cell with space */
-	for(; len_pad < cl->width; ++len_pad)
-		fputs(cellpadding_symbol(tb), tb->out);
+	if (len_pad < cl->width)
+		fputs_cellpadding(tb, cl->width - len_pad);
 
 	fputs_color_cell_close(tb, cl, ln, ce);
 
@@ -376,8 +399,7 @@ static void print_empty_cell(struct libscols_table *tb,
 static void print_newline_padding(struct libscols_table *tb,
 				  struct libscols_column *cl,
 				  struct libscols_line *ln,	/* optional */
-				  struct libscols_cell *ce,
-				  size_t bufsz)
+				  struct libscols_cell *ce)
 {
 	size_t i;
 
@@ -393,7 +415,7 @@ static void print_newline_padding(struct libscols_table *tb,
 
 	/* fill cells after line break */
 	for (i = 0; i <= (size_t) cl->seqnum; i++)
-		print_empty_cell(tb, scols_table_get_column(tb, i), ln, ce, bufsz);
+		print_empty_cell(tb, scols_table_get_column(tb, i), ln, ce);
 
 	fputs_color_line_close(tb);
 }
@@ -452,7 +474,7 @@ static int print_pending_data(
 		struct libscols_cell *ce)
 {
 	size_t width = cl->width, bytes;
-	size_t len = width, i;
+	size_t len = width;
 	char *data;
 	char *nextchunk = NULL;
 
@@ -501,8 +523,8 @@ static int print_pending_data(
 	}
 
 	/* fill rest of cell with space */
-	for(i = len; i < width; i++)
-		fputs(cellpadding_symbol(tb), tb->out);
+	if (len < width)
+		fputs_cellpadding(tb, width - len);
 
 	fputs_color_cell_close(tb, cl, ln, ce);
 
@@ -569,7 +591,7 @@ static int print_data(struct libscols_table *tb,
 		      struct libscols_cell *ce,	/* optional */
 		      struct ul_buffer *buf)
 {
-	size_t len = 0, i, width, bytes;
+	size_t len = 0, width, bytes;
 	char *data, *nextchunk;
 	const char *name = NULL;
 	int is_last;
@@ -670,8 +692,8 @@ static int print_data(struct libscols_table *tb,
 
 	if (data && *data) {
 		if (scols_column_is_right(cl)) {
-			for (i = len; i < width; i++)
-				fputs(cellpadding_symbol(tb), tb->out);
+			if (len < width)
+				fputs_cellpadding(tb, width - len);
 			len = width;
 		}
 		fputs(data, tb->out);
@@ -691,14 +713,16 @@ static int print_data(struct libscols_table *tb,
 	}
 
 	/* fill rest of cell with space */
-	for(i = len; i < width; i++)
-		fputs(cellpadding_symbol(tb), tb->out);
+	if (len < width)
+		fputs_cellpadding(tb, width - len);
 
 	fputs_color_cell_close(tb, cl, ln, ce);
 
-	if (len > width && !scols_column_is_trunc(cl)) {
+	/* the streamed lines are not aligned to the wider data, the next
+	 * column is only shifted */
+	if (len > width && !scols_column_is_trunc(cl) && !tb->streaming) {
 		DBG(COL, ul_debugobj(cl, "*** data len=%zu > column width=%zu", len, width));
-		print_newline_padding(tb, cl, ln, ce, ul_buffer_get_bufsiz(buf));	/* next column starts on next line */
+		print_newline_padding(tb, cl, ln, ce);	/* next column starts on next line */
 
 	} else if (!is_last)
 		fputs(colsep(tb), tb->out);		/* columns separator */
@@ -724,7 +748,7 @@ int __cell_to_buffer(struct libscols_table *tb,
 	ul_buffer_reset_data(buf);
 
 	ce = scols_line_get_cell(ln, cl->seqnum);
-	data = ce ? scols_cell_get_data(ce) : NULL;
+	data = __scols_get_cell_data(cl, ln, ce);
 
 	if (!scols_column_is_tree(cl))
 		return data ? ul_buffer_append_string(buf, data) : 0;
@@ -755,6 +779,25 @@ int __cell_to_buffer(struct libscols_table *tb,
 	return rc;
 }
 
+/* NDJSON tree, the tree column data of the parent line */
+static void print_ndjson_parent(struct libscols_table *tb,
+				struct libscols_line *ln)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+	const char *data = NULL;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (ln->parent && scols_table_next_column(tb, &itr, &cl) == 0) {
+		if (!scols_column_is_tree(cl))
+			continue;
+		data = __scols_get_cell_data(cl, ln->parent,
+				scols_line_get_cell(ln->parent, cl->seqnum));
+		break;
+	}
+	ul_jsonwrt_value_s(&tb->json, tb->ndjson_parent, data);
+}
+
 /*
  * Prints data. Data can be printed in more formats (raw, NAME=xxx pairs), and
  * control and non-printable characters can be encoded in the \x?? encoding.
@@ -786,6 +829,8 @@ static int print_line(struct libscols_table *tb,
 		if (rc == 0 && cl->pending_data)
 			pending = 1;
 	}
+	if (rc == 0 && tb->ndjson_parent)
+		print_ndjson_parent(tb, ln);
 	fputs_color_line_close(tb);
 
 	/* extra lines of the multi-line cells */
@@ -804,7 +849,7 @@ static int print_line(struct libscols_table *tb,
 				if (rc == 0 && cl->pending_data)
 					pending = 1;
 			} else
-				print_empty_cell(tb, cl, ln, NULL, ul_buffer_get_bufsiz(buf));
+				print_empty_cell(tb, cl, ln, NULL);
 		}
 		fputs_color_line_close(tb);
 	}
@@ -1013,6 +1058,95 @@ int __scols_print_table(struct libscols_table *tb, struct ul_buffer *buf)
 	return __scols_print_range(tb, buf, &itr, NULL);
 }
 
+/*
+ * Streaming mode -- prints and removes all lines from the table. The column
+ * widths are calculated only once, from lines available when the first line
+ * is printed. Called when a new line is added (so all the current lines are
+ * complete) and by scols_print_table() for the rest of the table.
+ *
+ * Returns: 0 on success, 1 if not ready (not enough lines to sample).
+ */
+int __scols_print_stream(struct libscols_table *tb)
+{
+	int rc = 0;
+
+	assert(tb);
+
+	if (!tb->stream_started) {
+		if (list_empty(&tb->tb_lines)
+		    || tb->nlines < max(tb->stream_nsample, (size_t) 1))
+			return 1;
+
+		DBG(TAB, ul_debugobj(tb, "streaming: start [sample=%zu]", tb->nlines));
+
+		tb->header_printed = 0;
+		tb->stream_nprinted = 0;
+		rc = __scols_initialize_printing(tb, &tb->stream_buf);
+		if (rc)
+			return rc;
+		tb->stream_started = 1;
+
+		if (scols_table_is_json(tb) && !tb->ndjson) {
+			ul_jsonwrt_root_open(&tb->json);
+			ul_jsonwrt_array_open(&tb->json, tb->name ? tb->name : "");
+		}
+		if (tb->format == SCOLS_FMT_HUMAN)
+			__scols_print_title(tb);
+
+		rc = __scols_print_header(tb, &tb->stream_buf);
+		if (rc)
+			return rc;
+	}
+
+	/* NDJSON tree -- the lines are kept in the table, the next lines
+	 * may be added as their children */
+	if (scols_table_is_tree(tb)) {
+		struct list_head *p = tb->stream_last ?
+				tb->stream_last->ln_lines.next : tb->tb_lines.next;
+
+		for (; rc == 0 && p != &tb->tb_lines; p = p->next) {
+			struct libscols_line *ln = list_entry(p,
+						struct libscols_line, ln_lines);
+
+			ul_jsonwrt_object_open(&tb->json, NULL);
+			rc = print_line(tb, ln, &tb->stream_buf);
+			ul_jsonwrt_object_close(&tb->json);
+			tb->stream_last = ln;
+			tb->stream_nprinted++;
+		}
+		return rc;
+	}
+
+	while (rc == 0 && !list_empty(&tb->tb_lines)) {
+		struct libscols_line *ln = list_entry(tb->tb_lines.next,
+						struct libscols_line, ln_lines);
+
+		/* the separator is printed before the line, the last line
+		 * in the table is unknown */
+		if (tb->stream_nprinted && !scols_table_is_json(tb)) {
+			if (tb->no_linesep == 0) {
+				fputs(linesep(tb), tb->out);
+				tb->termlines_used++;
+			}
+			if (want_repeat_header(tb))
+				__scols_print_header(tb, &tb->stream_buf);
+		}
+
+		if (scols_table_is_json(tb))
+			ul_jsonwrt_object_open(&tb->json, NULL);
+
+		rc = print_line(tb, ln, &tb->stream_buf);
+
+		if (scols_table_is_json(tb))
+			ul_jsonwrt_object_close(&tb->json);
+
+		tb->stream_nprinted++;
+		scols_table_remove_line(tb, ln);
+	}
+
+	return rc;
+}
+
 /* scols_walk_tree() callback to print tree line */
 static int print_tree_line(struct libscols_table *tb,
 			   struct libscols_line *ln,
@@ -1092,12 +1226,38 @@ static size_t strlen_line(struct libscols_line *ln)
 	return sz;
 }
 
+/* NDJSON tree, "parent-<name>" key, where <name> is the tree column name */
+static int init_ndjson_parent(struct libscols_table *tb)
+{
+	struct libscols_column *cl;
+	struct libscols_iter itr;
+
+	scols_reset_iter(&itr, SCOLS_ITER_FORWARD);
+	while (scols_table_next_column(tb, &itr, &cl) == 0) {
+		const char *name;
+
+		if (!scols_column_is_tree(cl))
+			continue;
+		name = scols_cell_get_data(&cl->header);
+		if (asprintf(&tb->ndjson_parent, "parent-%s", name ? name : "") < 0) {
+			tb->ndjson_parent = NULL;
+			return -ENOMEM;
+		}
+		break;
+	}
+	return 0;
+}
+
 void __scols_cleanup_printing(struct libscols_table *tb, struct ul_buffer *buf)
 {
 	if (!tb)
 		return;
 
 	ul_buffer_free_data(buf);
+	ul_jsonwrt_deinit(&tb->json);
+
+	free(tb->ndjson_parent);
+	tb->ndjson_parent = NULL;
 
 	if (tb->priv_symbols) {
 		scols_table_set_symbols(tb, NULL);
@@ -1154,7 +1314,16 @@ int __scols_initialize_printing(struct libscols_table *tb, struct ul_buffer *buf
 		break;
 	case SCOLS_FMT_JSON:
 		ul_jsonwrt_init(&tb->json, tb->out, 0);
-		extra_bufsz += tb->nlines * 3;		/* indentation */
+		ul_jsonwrt_set_buffered(&tb->json, 1);
+		if (tb->ndjson) {
+			ul_jsonwrt_set_compact(&tb->json, 1);
+			if (scols_table_is_tree(tb)) {
+				rc = init_ndjson_parent(tb);
+				if (rc)
+					goto err;
+			}
+		} else
+			extra_bufsz += tb->nlines * 3;	/* indentation */
 		/* fallthrough */
 	case SCOLS_FMT_EXPORT:
 	{
@@ -32,6 +32,7 @@
 #define SCOLS_DEBUG_COL		(1 << 5)
 #define SCOLS_DEBUG_BUFF	(1 << 6)
 #define SCOLS_DEBUG_GROUP	(1 << 7)
+#define SCOLS_DEBUG_FLTR	(1 << 8)
 #define SCOLS_DEBUG_ALL		0xFFFF
 
 UL_DEBUG_DECLARE_MASK(libsmartcols);
@@ -83,6 +84,22 @@ struct libscols_cell {
 	char	*color;
 	void    *userdata;
 	int	flags;
+
+	size_t	width;			/* cached display width of the data */
+
+	unsigned int	arena_data :1,	/* data allocated by arena */
+			width_cached :1,	/* the width is valid */
+			width_noenc :1,		/* the width is without encoding */
+			lazy_done :1;		/* data function already called */
+};
+
+/*
+ * Memory arena for lines
+ */
+struct libscols_arena {
+	int	refcount;
+	size_t	size;			/* allocated bytes */
+	struct libscols_arena_chunk *chunks;	/* the current chunk is the first */
 };
 
 extern int scols_line_move_cells(struct libscols_line *ln, size_t newn, size_t oldn);
@@ -125,6 +142,9 @@ struct libscols_column {
 			char *, void *);
 	void *wrapfunc_data;
 
+	char *(*datafunc)(struct libscols_column *,
+			struct libscols_line *, void *);	/* lazy data */
+	void *datafunc_data;
 
 	struct libscols_cell	header;
 	struct list_head	cl_columns;	/* member of table->tb_columns */
@@ -179,6 +199,7 @@ struct libscols_line {
 
 	struct libscols_cell	*cells;		/* array with data */
 	size_t			ncells;		/* number of cells */
+	struct libscols_arena	*arena;		/* cells and data allocator or NULL */
 
 	struct list_head	ln_lines;	/* member of table->tb_lines */
 	struct list_head	ln_branch;	/* head of line->ln_children */
@@ -188,6 +209,8 @@ struct libscols_line {
 	struct libscols_line	*parent;
 	struct libscols_group	*parent_group;	/* for group childs */
 	struct libscols_group	*group;		/* for group members */
+
+	unsigned int	filter_done :1;		/* evaluated by the table filter */
 };
 
 enum {
@@ -239,6 +262,17 @@ struct libscols_table {
 
 	const char *cur_color;	/* current active color when printing */
 
+	struct libscols_arena	*arena;	/* allocator for new lines or NULL */
+
+	size_t	stream_nsample;		/* streaming: lines used for width calculation */
+	size_t	stream_nprinted;	/* streaming: already printed lines */
+	struct ul_buffer stream_buf;	/* streaming: print buffer */
+	struct libscols_line *stream_last;	/* streaming: last printed tree line */
+
+	char	*ndjson_parent;		/* NDJSON: key for the parent of the tree line */
+
+	struct libscols_filter	*filter;	/* remove not matching lines */
+
 	/* flags */
 	unsigned int	ascii		:1,	/* don't use unicode */
 			colors_wanted	:1,	/* enable colors */
@@ -254,7 +288,10 @@ struct libscols_table {
 			no_headings	:1,	/* don't print header */
 			no_encode	:1,	/* don't care about control and non-printable chars */
 			no_linesep	:1,	/* don't print line separator */
-			no_wrap		:1;	/* never wrap lines */
+			no_wrap		:1,	/* never wrap lines */
+			streaming	:1,	/* print lines when added */
+			stream_started	:1,	/* streaming: header already printed */
+			ndjson		:1;	/* JSON: one object per line */
 };
 
 #define IS_ITER_FORWARD(_i)	((_i)->direction == SCOLS_ITER_FORWARD)
@@ -283,6 +320,13 @@ static inline int scols_iter_is_last(const struct libscols_iter *itr)
 	return itr->p == itr->head;
 }
 
+/*
+ * column.c
+ */
+const char *__scols_get_cell_data(struct libscols_column *cl,
+				  struct libscols_line *ln,
+				  struct libscols_cell *ce);
+
 /*
  * line.c
  */
@@ -291,12 +335,30 @@ int scols_line_next_group_child(struct libscols_line *ln,
                           struct libscols_line **chld);
 
 
+/*
+ * arena.c
+ */
+struct libscols_arena *scols_new_arena(void);
+void scols_ref_arena(struct libscols_arena *ar);
+void scols_unref_arena(struct libscols_arena *ar);
+struct libscols_cell *scols_arena_alloc_cells(struct libscols_arena *ar, size_t n);
+char *scols_arena_strdup(struct libscols_arena *ar, const char *str);
+
+/*
+ * filter.c
+ */
+int __scols_filter_resolve(struct libscols_filter *fltr, struct libscols_table *tb);
+int __scols_filter_match(struct libscols_filter *fltr,
+			 struct libscols_table *tb,
+			 struct libscols_line *ln);
+
 /*
  * table.c
  */
 int scols_table_next_group(struct libscols_table *tb,
                           struct libscols_iter *itr,
                           struct libscols_group **gr);
+void __scols_table_filter_lines(struct libscols_table *tb, int all);
 
 /*
  * grouping.c
@@ -341,6 +403,7 @@ int __scols_print_tree(struct libscols_table *tb, struct ul_buffer *buf);
 int __scols_print_table(struct libscols_table *tb, struct ul_buffer *buf);
 int __scols_print_header(struct libscols_table *tb, struct ul_buffer *buf);
 int __scols_print_title(struct libscols_table *tb);
+int __scols_print_stream(struct libscols_table *tb);
 int __scols_print_range(struct libscols_table *tb,
                         struct ul_buffer *buf,
                         struct libscols_iter *itr,
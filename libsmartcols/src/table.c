@@ -128,6 +128,10 @@ void scols_unref_table(struct libscols_table *tb)
 		scols_table_remove_groups(tb);
 		scols_table_remove_lines(tb);
 		scols_table_remove_columns(tb);
+		scols_unref_arena(tb->arena);
+		scols_unref_filter(tb->filter);
+		if (tb->stream_started)
+			__scols_cleanup_printing(tb, &tb->stream_buf);
 		scols_unref_symbols(tb->symbols);
 		scols_reset_cell(&tb->title);
 		free(tb->grpset);
@@ -631,12 +635,30 @@ int scols_table_add_line(struct libscols_table *tb, struct libscols_line *ln)
 	if (!list_empty(&ln->ln_lines))
 		return -EINVAL;
 
+	/* use the table arena for the line without cells; the streamed
+	 * lines are deallocated when printed, the arena would only grow */
+	if (tb->arena && !tb->streaming && !ln->arena && !ln->cells) {
+		ln->arena = tb->arena;
+		scols_ref_arena(ln->arena);
+	}
+
 	if (tb->ncols > ln->ncells) {
 		int rc = scols_line_alloc_cells(ln, tb->ncols);
 		if (rc)
 			return rc;
 	}
 
+	/* the already added lines are complete now */
+	if (tb->filter)
+		__scols_table_filter_lines(tb, 1);
+
+	if (tb->streaming
+	    && (!scols_table_is_tree(tb) || scols_table_is_ndjson(tb))) {
+		int rc = __scols_print_stream(tb);
+		if (rc < 0)
+			return rc;
+	}
+
 	DBG(TAB, ul_debugobj(tb, "add line"));
 	list_add_tail(&ln->ln_lines, &tb->tb_lines);
 	ln->seqnum = tb->nlines++;
@@ -686,6 +708,7 @@ void scols_table_remove_lines(struct libscols_table *tb)
 			scols_line_remove_child(ln->parent, ln);
 		scols_table_remove_line(tb, ln);
 	}
+	tb->stream_last = NULL;
 }
 
 /**
@@ -1067,6 +1090,42 @@ int scols_table_enable_json(struct libscols_table *tb, int enable)
 		tb->format = SCOLS_FMT_JSON;
 	else if (tb->format == SCOLS_FMT_JSON)
 		tb->format = 0;
+	tb->ndjson = 0;
+	return 0;
+}
+
+/**
+ * scols_table_enable_ndjson:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enable/disable newline-delimited JSON output format. Every line is printed
+ * as a separate JSON object on one output line, there is no top-level object
+ * and no array. The tree is not nested, the lines are printed in the order
+ * they were added and every object contains the "parent-<name>" key, where
+ * <name> is the tree column name and the value is the tree column data of
+ * the parent line (null for the tree roots).
+ *
+ * NDJSON is a variant of the JSON format, so scols_table_is_json() returns
+ * true too. The tree tables may be printed in the streaming mode (see
+ * scols_table_enable_streaming()), but the printed lines are kept in memory
+ * until the table is deallocated, as they may be used as parents.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.38
+ */
+int scols_table_enable_ndjson(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "ndjson: %s", enable ? "ENABLE" : "DISABLE"));
+	if (enable)
+		tb->format = SCOLS_FMT_JSON;
+	else if (tb->format == SCOLS_FMT_JSON && tb->ndjson)
+		tb->format = 0;
+	tb->ndjson = enable ? 1 : 0;
 	return 0;
 }
 
@@ -1367,6 +1426,19 @@ int scols_table_is_json(const struct libscols_table *tb)
 	return tb->format == SCOLS_FMT_JSON;
 }
 
+/**
+ * scols_table_is_ndjson:
+ * @tb: table
+ *
+ * Returns: 1 if newline-delimited JSON output format is enabled.
+ *
+ * Since: 2.38
+ */
+int scols_table_is_ndjson(const struct libscols_table *tb)
+{
+	return tb->format == SCOLS_FMT_JSON && tb->ndjson;
+}
+
 /**
  * scols_table_is_maxout
  * @tb: table
@@ -1391,6 +1463,204 @@ int scols_table_is_minout(const struct libscols_table *tb)
 	return tb->minout;
 }
 
+/**
+ * scols_table_enable_arena:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enables memory arena for new lines added to the table (the lines without
+ * allocated cells). The cells and data set by scols_line_set_data() are
+ * allocated from large memory chunks and the memory is deallocated at once,
+ * when the table and all the lines are deallocated. It's recommended for
+ * large tables. The data set by scols_line_refer_data() are not affected.
+ *
+ * The memory used by the line is not deallocated when the line is removed
+ * from the table or the cell data are modified, so don't enable the arena
+ * if you frequently modify or remove lines. The arena is not used in the
+ * streaming mode (see scols_table_enable_streaming()).
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.38
+ */
+int scols_table_enable_arena(struct libscols_table *tb, int enable)
+{
+	if (!tb)
+		return -EINVAL;
+
+	DBG(TAB, ul_debugobj(tb, "arena: %s", enable ? "ENABLE" : "DISABLE"));
+	if (enable && !tb->arena) {
+		tb->arena = scols_new_arena();
+		if (!tb->arena)
+			return -ENOMEM;
+	} else if (!enable && tb->arena) {
+		/* the lines keep the arena referenced */
+		scols_unref_arena(tb->arena);
+		tb->arena = NULL;
+	}
+	return 0;
+}
+
+/**
+ * scols_table_enable_streaming:
+ * @tb: table
+ * @enable: 1 or 0
+ *
+ * Enables streaming mode. The lines are printed (and removed from the table)
+ * as soon as they are complete, it means when the next line is added by
+ * scols_table_new_line() or scols_table_add_line(). The rest of the table is
+ * printed by scols_print_table(). The memory usage does not depend on number
+ * of lines in this mode.
+ *
+ * The column widths are calculated only once, from the column width hints and
+ * from the first lines (see scols_table_set_streaming_sample()), so the data
+ * in the later lines may exceed the columns; the next columns on the line are
+ * shifted in this case. Don't use the line after the
+ * next line has been added, the line is already deallocated. Trees and
+ * sorting are not supported; the whole table is printed by
+ * scols_print_table() for trees. The only exception is the NDJSON output
+ * (see scols_table_enable_ndjson()), where the tree lines are printed when
+ * complete, but kept in the table.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.38
+ */
+int scols_table_enable_streaming(struct libscols_table *tb, int enable)
+{
+	if (!tb || tb->stream_started)
+		return -EINVAL;
+	DBG(TAB, ul_debugobj(tb, "streaming: %s", enable ? "ENABLE" : "DISABLE"));
+	tb->streaming = enable ? 1 : 0;
+	return 0;
+}
+
+/**
+ * scols_table_set_filter:
+ * @tb: table
+ * @fltr: compiled filter or NULL
+ *
+ * Sets the table filter. The lines which do not match the filter are removed
+ * (and deallocated if not referenced elsewhere) as soon as they are complete,
+ * it means when the next line is added by scols_table_new_line() or
+ * scols_table_add_line(), and the last line before the table is printed or
+ * sorted. The already added lines are evaluated now, except the last one.
+ *
+ * The columns used in the filter expression have to be already defined in
+ * the table. Don't use the line after the next line has been added, the line
+ * may be already deallocated. The filter is not used for trees and for the
+ * grouped lines.
+ *
+ * Returns: 0 on success, negative number in case of an error (-EINVAL for
+ * unknown column, see scols_filter_get_errmsg()).
+ *
+ * Since: 2.38
+ */
+int scols_table_set_filter(struct libscols_table *tb, struct libscols_filter *fltr)
+{
+	int rc;
+
+	if (!tb)
+		return -EINVAL;
+	if (fltr) {
+		rc = __scols_filter_resolve(fltr, tb);
+		if (rc)
+			return rc;
+		scols_ref_filter(fltr);
+	}
+	DBG(TAB, ul_debugobj(tb, "set filter %p", fltr));
+	scols_unref_filter(tb->filter);
+	tb->filter = fltr;
+
+	if (fltr) {
+		struct list_head *p;
+
+		list_for_each(p, &tb->tb_lines)
+			list_entry(p, struct libscols_line, ln_lines)->filter_done = 0;
+		__scols_table_filter_lines(tb, 0);
+	}
+	return 0;
+}
+
+/**
+ * scols_table_get_filter:
+ * @tb: table
+ *
+ * Returns: the filter or NULL.
+ *
+ * Since: 2.38
+ */
+struct libscols_filter *scols_table_get_filter(struct libscols_table *tb)
+{
+	return tb ? tb->filter : NULL;
+}
+
+/*
+ * Removes the lines which do not match the table filter. The last line is
+ * ignored if @all is zero, the line may be incomplete yet. The not evaluated
+ * lines are always at the end of the table.
+ */
+void __scols_table_filter_lines(struct libscols_table *tb, int all)
+{
+	struct list_head *p;
+
+	if (!tb->filter || scols_table_is_tree(tb))
+		return;
+
+	p = all ? tb->tb_lines.prev : tb->tb_lines.prev->prev;
+
+	while (p != &tb->tb_lines) {
+		struct libscols_line *ln = list_entry(p, struct libscols_line, ln_lines);
+
+		if (ln->filter_done)
+			break;
+		p = p->prev;
+		ln->filter_done = 1;
+
+		if (!ln->group && !ln->parent_group
+		    && !__scols_filter_match(tb->filter, tb, ln)) {
+			DBG(TAB, ul_debugobj(tb, "filter: remove line %p", ln));
+			scols_table_remove_line(tb, ln);
+		}
+	}
+}
+
+/**
+ * scols_table_is_streaming:
+ * @tb: table
+ *
+ * Returns: 1 if streaming mode is enabled or 0
+ *
+ * Since: 2.38
+ */
+int scols_table_is_streaming(const struct libscols_table *tb)
+{
+	return tb->streaming;
+}
+
+/**
+ * scols_table_set_streaming_sample:
+ * @tb: table
+ * @nlines: number of lines
+ *
+ * Sets number of lines used to calculate column widths in streaming mode.
+ * The output starts after @nlines lines are complete. The default is zero,
+ * then the output starts with the first line and the widths are based on
+ * the column width hints, header and the first line only.
+ *
+ * Returns: 0 on success, negative number in case of an error.
+ *
+ * Since: 2.38
+ */
+int scols_table_set_streaming_sample(struct libscols_table *tb, size_t nlines)
+{
+	if (!tb || tb->stream_started)
+		return -EINVAL;
+	DBG(TAB, ul_debugobj(tb, "streaming sample: %zu", nlines));
+	tb->stream_nsample = nlines;
+	return 0;
+}
+
 /**
  * scols_table_is_tree:
  * @tb: table
@@ -1466,6 +1736,8 @@ static int cells_cmp_wrapper_lines(struct list_head *a, struct list_head *b, voi
 	rb = list_entry(b, struct libscols_line, ln_lines);
 	ca = scols_line_get_cell(ra, cl->seqnum);
 	cb = scols_line_get_cell(rb, cl->seqnum);
+	__scols_get_cell_data(cl, ra, ca);
+	__scols_get_cell_data(cl, rb, cb);
 
 	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
 }
@@ -1485,10 +1757,107 @@ static int cells_cmp_wrapper_children(struct list_head *a, struct list_head *b,
 	rb = list_entry(b, struct libscols_line, ln_children);
 	ca = scols_line_get_cell(ra, cl->seqnum);
 	cb = scols_line_get_cell(rb, cl->seqnum);
+	__scols_get_cell_data(cl, ra, ca);
+	__scols_get_cell_data(cl, rb, cb);
 
 	return cl->cmpfunc(ca, cb, cl->cmpfunc_data);
 }
 
+/*
+ * Array based sort -- the cells are collected to the array only once, and
+ * sorted by merge sort (stable as list_sort()) without walking the list. The
+ * list_sort() is also inefficient for lists longer than 2^20 items.
+ */
+#define SCOLS_SORT_MINENTS	32	/* use list_sort() for small lists */
+#define SCOLS_SORT_INSERTION	16	/* insertion sort for small ranges */
+
+struct sort_ent {
+	struct libscols_cell	*ce;
+	struct libscols_line	*ln;
+};
+
+static inline int sort_ent_cmp(struct sort_ent *a, struct sort_ent *b,
+			       struct libscols_column *cl)
+{
+	return cl->cmpfunc(a->ce, b->ce, cl->cmpfunc_data);
+}
+
+static void sort_ents(struct sort_ent *ents, struct sort_ent *tmp, size_t n,
+		      struct libscols_column *cl)
+{
+	size_t i, j, k, half;
+
+	if (n <= SCOLS_SORT_INSERTION) {
+		for (i = 1; i < n; i++) {
+			struct sort_ent x = ents[i];
+
+			for (j = i; j > 0 && sort_ent_cmp(&ents[j - 1], &x, cl) > 0; j--)
+				ents[j] = ents[j - 1];
+			ents[j] = x;
+		}
+		return;
+	}
+
+	half = n / 2;
+	sort_ents(ents, tmp, half, cl);
+	sort_ents(ents + half, tmp, n - half, cl);
+
+	/* already ordered */
+	if (sort_ent_cmp(&ents[half - 1], &ents[half], cl) <= 0)
+		return;
+
+	memcpy(tmp, ents, half * sizeof(struct sort_ent));
+	for (i = 0, j = half, k = 0; i < half && j < n; k++) {
+		if (sort_ent_cmp(&ents[j], &tmp[i], cl) < 0)
+			ents[k] = ents[j++];
+		else
+			ents[k] = tmp[i++];
+	}
+	while (i < half)
+		ents[k++] = tmp[i++];
+}
+
+/* sorts list of lines, @children is 1 for the ln_children lists */
+static void sort_lines(struct list_head *head, int children,
+		       struct libscols_column *cl)
+{
+	struct sort_ent *ents = NULL, *tmp;
+	struct list_head *p;
+	size_t i, n = 0;
+
+	list_for_each(p, head)
+		n++;
+
+	if (n >= SCOLS_SORT_MINENTS)
+		ents = malloc((n + n / 2 + 1) * sizeof(struct sort_ent));
+	if (!ents) {
+		list_sort(head, children ? cells_cmp_wrapper_children
+					 : cells_cmp_wrapper_lines, cl);
+		return;
+	}
+	tmp = ents + n;
+
+	i = 0;
+	list_for_each(p, head) {
+		struct libscols_line *ln = children ?
+				list_entry(p, struct libscols_line, ln_children) :
+				list_entry(p, struct libscols_line, ln_lines);
+
+		ents[i].ln = ln;
+		ents[i].ce = scols_line_get_cell(ln, cl->seqnum);
+		__scols_get_cell_data(cl, ln, ents[i].ce);
+		i++;
+	}
+
+	sort_ents(ents, tmp, n, cl);
+
+	/* relink in the new order */
+	INIT_LIST_HEAD(head);
+	for (i = 0; i < n; i++)
+		list_add_tail(children ? &ents[i].ln->ln_children :
+					 &ents[i].ln->ln_lines, head);
+	free(ents);
+}
 
 static int sort_line_children(struct libscols_line *ln, struct libscols_column *cl)
 {
@@ -1501,7 +1870,7 @@ static int sort_line_children(struct libscols_line *ln, struct libscols_column *
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->ln_branch, cells_cmp_wrapper_children, cl);
+		sort_lines(&ln->ln_branch, 1, cl);
 	}
 
 	if (is_first_group_member(ln)) {
@@ -1511,7 +1880,7 @@ static int sort_line_children(struct libscols_line *ln, struct libscols_column *
 			sort_line_children(chld, cl);
 		}
 
-		list_sort(&ln->group->gr_children, cells_cmp_wrapper_children, cl);
+		sort_lines(&ln->group->gr_children, 1, cl);
 	}
 
 	return 0;
@@ -1554,8 +1923,11 @@ int scols_sort_table(struct libscols_table *tb, struct libscols_column *cl)
 	if (!cl || !cl->cmpfunc)
 		return -EINVAL;
 
+	if (tb->filter)
+		__scols_table_filter_lines(tb, 1);
+
 	DBG(TAB, ul_debugobj(tb, "sorting table by %zu column", cl->seqnum));
-	list_sort(&tb->tb_lines, cells_cmp_wrapper_lines, cl);
+	sort_lines(&tb->tb_lines, 0, cl);
 
 	if (scols_table_is_tree(tb))
 		__scols_sort_tree(tb, cl);
@@ -207,25 +207,46 @@ static int get_node_id(unsigned char *node_id)
 	return 0;
 }
 
-/* Assume that the gettimeofday() has microsecond granularity */
+/*
+ * The maximal number of 100ns intervals the clock may be moved ahead of the
+ * system time by the subsequent calls
+ */
 #define MAX_ADJUSTMENT 10
 
+/* Returns the system time in 100ns intervals since the Unix epoch */
+static uint64_t get_clock_ticks(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && !defined(_WIN32)
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_REALTIME, &ts) == 0)
+		return ((uint64_t) ts.tv_sec) * 10000000 + ts.tv_nsec / 100;
+#endif
+	{
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		return ((uint64_t) tv.tv_sec) * 10000000 + tv.tv_usec * 10;
+	}
+}
+
 /*
  * Get clock from global sequence clock counter.
  *
+ * The counter is kept in 100ns intervals, the state file stores the last
+ * used value as seconds, microseconds and the rest ("adj").
+ *
  * Return -1 if the clock counter could not be opened/locked (in this case
  * pseudorandom value is returned in @ret_clock_seq), otherwise return 0.
  */
 static int get_clock(uint32_t *clock_high, uint32_t *clock_low,
 		     uint16_t *ret_clock_seq, int *num)
 {
-	THREAD_LOCAL int		adjustment = 0;
-	THREAD_LOCAL struct timeval	last = {0, 0};
+	THREAD_LOCAL uint64_t		last = 0;
 	THREAD_LOCAL int		state_fd = -2;
 	THREAD_LOCAL FILE		*state_f;
 	THREAD_LOCAL uint16_t		clock_seq;
-	struct timeval			tv;
-	uint64_t			clock_reg;
+	uint64_t			clock_reg, now;
 	mode_t				save_umask;
 	int				len;
 	int				ret = 0;
@@ -268,54 +289,39 @@ static int get_clock(uint32_t *clock_high, uint32_t *clock_low,
 		if (fscanf(state_f, "clock: %04x tv: %lu %lu adj: %d\n",
 			   &cl, &tv1, &tv2, &a) == 4) {
 			clock_seq = cl & 0x3FFF;
-			last.tv_sec = tv1;
-			last.tv_usec = tv2;
-			adjustment = a;
+			last = ((uint64_t) tv1) * 10000000 + tv2 * 10 + a;
 		}
 	}
 
-	if ((last.tv_sec == 0) && (last.tv_usec == 0)) {
+	if (last == 0) {
 		ul_random_get_bytes(&clock_seq, sizeof(clock_seq));
 		clock_seq &= 0x3FFF;
-		gettimeofday(&last, NULL);
-		last.tv_sec--;
+		last = get_clock_ticks() - 10000000;
 	}
 
 try_again:
-	gettimeofday(&tv, NULL);
-	if ((tv.tv_sec < last.tv_sec) ||
-	    ((tv.tv_sec == last.tv_sec) &&
-	     (tv.tv_usec < last.tv_usec))) {
+	now = get_clock_ticks();
+	if (now > last)
+		clock_reg = now;
+	else if (last - now < MAX_ADJUSTMENT)
+		clock_reg = last + 1;
+	else if (last - now == MAX_ADJUSTMENT)
+		goto try_again;
+	else {
 		clock_seq = (clock_seq+1) & 0x3FFF;
-		adjustment = 0;
-		last = tv;
-	} else if ((tv.tv_sec == last.tv_sec) &&
-	    (tv.tv_usec == last.tv_usec)) {
-		if (adjustment >= MAX_ADJUSTMENT)
-			goto try_again;
-		adjustment++;
-	} else {
-		adjustment = 0;
-		last = tv;
+		clock_reg = now;
 	}
 
-	clock_reg = tv.tv_usec*10 + adjustment;
-	clock_reg += ((uint64_t) tv.tv_sec)*10000000;
-	clock_reg += (((uint64_t) 0x01B21DD2) << 32) + 0x13814000;
-
-	if (num && (*num > 1)) {
-		adjustment += *num - 1;
-		last.tv_usec += adjustment / 10;
-		adjustment = adjustment % 10;
-		last.tv_sec += last.tv_usec / 1000000;
-		last.tv_usec = last.tv_usec % 1000000;
-	}
+	last = clock_reg;
+	if (num && (*num > 1))
+		last += *num - 1;
 
 	if (state_fd >= 0) {
 		rewind(state_f);
 		len = fprintf(state_f,
 			      "clock: %04x tv: %016ld %08ld adj: %08d\n",
-			      clock_seq, (long)last.tv_sec, (long)last.tv_usec, adjustment);
+			      clock_seq, (long) (last / 10000000),
+			      (long) ((last / 10) % 1000000), (int) (last % 10));
 		fflush(state_f);
 		if (ftruncate(state_fd, len) < 0) {
 			fprintf(state_f, "                   \n");
@@ -325,6 +331,8 @@ try_again:
 		flock(state_fd, LOCK_UN);
 	}
 
+	clock_reg += (((uint64_t) 0x01B21DD2) << 32) + 0x13814000;
+
 	*clock_high = clock_reg >> 32;
 	*clock_low = clock_reg;
 	*ret_clock_seq = clock_seq;
@@ -346,11 +354,15 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 	ssize_t ret;
 	int32_t reply_len = 0, expected = 16;
 	struct sockaddr_un srv_addr;
+	int type = SOCK_STREAM;
 
 	if (sizeof(UUIDD_SOCKET_PATH) > sizeof(srv_addr.sun_path))
 		return -1;
 
-	if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+#ifdef SOCK_CLOEXEC
+	type |= SOCK_CLOEXEC;
+#endif
+	if ((s = socket(AF_UNIX, type, 0)) < 0)
 		return -1;
 
 	srv_addr.sun_family = AF_UNIX;
@@ -372,22 +384,30 @@ static int get_uuid_via_daemon(int op, uuid_t out, int *num)
 	if (ret < 1)
 		goto fail;
 
-	ret = read_all(s, (char *) &reply_len, sizeof(reply_len));
-	if (ret < 0)
+	/* the reply length and the reply are read at once, the server
+	 * closes the connection after the reply */
+	ret = read_all(s, op_buf, sizeof(reply_len) + expected);
+	if (ret < (ssize_t) sizeof(reply_len))
 		goto fail;
 
-	if (reply_len != expected)
+	memcpy(&reply_len, op_buf, sizeof(reply_len));
+	if (reply_len != expected || ret != (ssize_t) sizeof(reply_len) + expected)
 		goto fail;
 
-	ret = read_all(s, op_buf, reply_len);
+	/* the number of the reserved UUIDs */
+	if (op == UUIDD_OP_BULK_TIME_UUID) {
+		int n;
 
-	if (op == UUIDD_OP_BULK_TIME_UUID)
-		memcpy(op_buf+16, num, sizeof(int));
+		memcpy(&n, op_buf + sizeof(reply_len) + 16, sizeof(n));
+		if (n < 1 || n > *num)
+			goto fail;
+		*num = n;
+	}
 
-	memcpy(out, op_buf, 16);
+	memcpy(out, op_buf + sizeof(reply_len), 16);
 
 	close(s);
-	return ((ret == expected) ? 0 : -1);
+	return 0;
 
 fail:
 	close(s);
@@ -432,6 +452,22 @@ int __uuid_generate_time(uuid_t out, int *num)
 	return ret;
 }
 
+/*
+ * The number of time-based UUIDs reserved per thread at once (see
+ * uuid_generate_time_generic())
+ */
+#define UUID_TIME_BLOCK		1000
+
+#ifdef HAVE_TLS
+/* changed after fork(), getpid() is used only if not supported by kernel */
+static uint64_t fork_generation(void)
+{
+	uint64_t gen = ul_fork_generation();
+
+	return gen ? gen : (uint64_t) getpid();
+}
+#endif
+
 /*
  * Generate time-based UUID and store it to @out
  *
@@ -439,47 +475,58 @@ int __uuid_generate_time(uuid_t out, int *num)
  * or, if uuidd is not usable, by using the global clock state counter (see get_clock()).
  * If neither of these is possible (e.g. because of insufficient permissions), it generates
  * the UUID anyway, but returns -1. Otherwise, returns 0.
+ *
+ * With thread-local storage every thread reserves a block of UUID_TIME_BLOCK
+ * timestamps (from uuidd or from the clock counter) and the next UUIDs of the
+ * block are generated without any locking, file I/O or uuidd request. The
+ * block is released if it's older than one second or if the process has
+ * been forked (the child would generate the same UUIDs as the parent).
  */
 static int uuid_generate_time_generic(uuid_t out) {
 #ifdef HAVE_TLS
 	THREAD_LOCAL int		num = 0;
+	THREAD_LOCAL int		ret = 0;
 	THREAD_LOCAL struct uuid	uu;
 	THREAD_LOCAL time_t		last_time = 0;
+	THREAD_LOCAL uint64_t		last_gen = 0;
 	time_t				now;
 
 	if (num > 0) {
 		now = time(NULL);
-		if (now > last_time+1)
+		if (now > last_time+1 || fork_generation() != last_gen)
 			num = 0;
 	}
 	if (num <= 0) {
-		num = 1000;
+		num = UUID_TIME_BLOCK;
 		if (get_uuid_via_daemon(UUIDD_OP_BULK_TIME_UUID,
-					out, &num) == 0) {
-			last_time = time(NULL);
-			uuid_unpack(out, &uu);
-			num--;
-			return 0;
-		}
-		num = 0;
-	}
-	if (num > 0) {
-		uu.time_low++;
-		if (uu.time_low == 0) {
-			uu.time_mid++;
-			if (uu.time_mid == 0)
-				uu.time_hi_and_version++;
+					out, &num) == 0)
+			ret = 0;
+		else {
+			num = UUID_TIME_BLOCK;
+			ret = __uuid_generate_time(out, &num);
 		}
+		last_time = time(NULL);
+		last_gen = fork_generation();
+		uuid_unpack(out, &uu);
 		num--;
-		uuid_pack(&uu, out);
-		return 0;
+		return ret;
+	}
+
+	uu.time_low++;
+	if (uu.time_low == 0) {
+		uu.time_mid++;
+		if (uu.time_mid == 0)
+			uu.time_hi_and_version++;
 	}
+	num--;
+	uuid_pack(&uu, out);
+	return ret;
 #else
 	if (get_uuid_via_daemon(UUIDD_OP_TIME_UUID, out, 0) == 0)
 		return 0;
-#endif
 
 	return __uuid_generate_time(out, NULL);
+#endif
 }
 
 /*
@@ -499,32 +546,55 @@ int uuid_generate_time_safe(uuid_t out)
 }
 
 
-int __uuid_generate_random(uuid_t out, int *num)
+/*
+ * The random bytes for more UUIDs are read in chunks of UUID_RANDOM_BATCH
+ * UUIDs. The single UUIDs are served from the per-thread pool of the
+ * kernel random bytes in ul_random_get_bytes().
+ */
+#define UUID_RANDOM_BATCH	16	/* 256 bytes; getrandom() is not interrupted */
+
+static void set_random_version(unsigned char *out)
 {
-	uuid_t	buf;
 	struct uuid uu;
-	int i, n, r = 0;
 
-	if (!num || !*num)
-		n = 1;
-	else
-		n = *num;
+	uuid_unpack(out, &uu);
+
+	uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
+	uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
+		| 0x4000;
+	uuid_pack(&uu, out);
+}
 
-	for (i = 0; i < n; i++) {
-		if (ul_random_get_bytes(buf, sizeof(buf)))
+static int generate_random_n(unsigned char *out, size_t n)
+{
+	size_t i;
+	int r = 0;
+
+	if (n == 1) {
+		if (ul_random_get_bytes(out, sizeof(uuid_t)))
 			r = -1;
-		uuid_unpack(buf, &uu);
+	} else {
+		/* the UUIDs are generated in place, read directly to @out */
+		for (i = 0; i < n; i += UUID_RANDOM_BATCH) {
+			size_t x = min(n - i, (size_t) UUID_RANDOM_BATCH);
 
-		uu.clock_seq = (uu.clock_seq & 0x3FFF) | 0x8000;
-		uu.time_hi_and_version = (uu.time_hi_and_version & 0x0FFF)
-			| 0x4000;
-		uuid_pack(&uu, out);
-		out += sizeof(uuid_t);
+			if (ul_random_get_bytes(out + i * sizeof(uuid_t),
+						x * sizeof(uuid_t)))
+				r = -1;
+		}
 	}
 
+	for (i = 0; i < n; i++)
+		set_random_version(out + i * sizeof(uuid_t));
+
 	return r;
 }
 
+int __uuid_generate_random(uuid_t out, int *num)
+{
+	return generate_random_n(out, !num || *num <= 0 ? 1 : (size_t) *num);
+}
+
 void uuid_generate_random(uuid_t out)
 {
 	int	num = 1;
@@ -533,6 +603,18 @@ void uuid_generate_random(uuid_t out)
 	__uuid_generate_random(out, &num);
 }
 
+/*
+ * Generates @n random UUIDs to the @out array. Returns 0 on success or -1 if
+ * high-quality randomness has not been available (the UUIDs are generated by
+ * pseudo-random generator in this case).
+ */
+int uuid_generate_random_n(uuid_t out[], size_t n)
+{
+	if (!n)
+		return 0;
+	return generate_random_n(out[0], n);
+}
+
 /*
  * This is the generic front-end to __uuid_generate_random and
  * uuid_generate_time.  It uses __uuid_generate_random output
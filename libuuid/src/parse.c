@@ -34,7 +34,6 @@
 
 #include <stdlib.h>
 #include <stdio.h>
-#include <ctype.h>
 #include <string.h>
 
 #include "c.h"
@@ -49,52 +48,42 @@ int uuid_parse(const char *in, uuid_t uu)
 	return uuid_parse_range(in, in + len, uu);
 }
 
+/* returns the hex digit value or -1 */
+static inline int hexval(unsigned char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c |= 0x20;			/* to lower case */
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
 int uuid_parse_range(const char *in_start, const char *in_end, uuid_t uu)
 {
-	struct uuid	uuid;
-	int		i;
-	const char	*cp;
-	char		buf[3];
+	/* offsets of the hex pairs in the string, the bytes are in the
+	 * same order as in the binary UUID (see uuid_pack()) */
+	static const unsigned char offsets[16] = {
+		0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34
+	};
+	const unsigned char *cp = (const unsigned char *) in_start;
+	uuid_t	buf;
+	int	i;
 
 	if ((in_end - in_start) != 36)
 		return -1;
-	for (i=0, cp = in_start; i <= 36; i++,cp++) {
-		if ((i == 8) || (i == 13) || (i == 18) ||
-		    (i == 23)) {
-			if (*cp == '-')
-				continue;
-			return -1;
-		}
-		if (i== 36)
-			if (*cp == 0)
-				continue;
-		if (!isxdigit(*cp))
-			return -1;
-	}
-	errno = 0;
-	uuid.time_low = strtoul(in_start, NULL, 16);
-
-	if (!errno)
-		uuid.time_mid = strtoul(in_start+9, NULL, 16);
-	if (!errno)
-		uuid.time_hi_and_version = strtoul(in_start+14, NULL, 16);
-	if (!errno)
-		uuid.clock_seq = strtoul(in_start+19, NULL, 16);
-	if (errno)
+	if (cp[8] != '-' || cp[13] != '-' || cp[18] != '-' || cp[23] != '-')
 		return -1;
 
-	cp = in_start+24;
-	buf[2] = 0;
-	for (i=0; i < 6; i++) {
-		buf[0] = *cp++;
-		buf[1] = *cp++;
+	for (i = 0; i < 16; i++) {
+		int hi = hexval(cp[offsets[i]]);
+		int lo = hexval(cp[offsets[i] + 1]);
 
-		errno = 0;
-		uuid.node[i] = strtoul(buf, NULL, 16);
-		if (errno)
+		if (hi < 0 || lo < 0)
 			return -1;
+		buf[i] = (hi << 4) | lo;
 	}
 
-	uuid_pack(&uuid, uu);
+	memcpy(uu, buf, sizeof(buf));
 	return 0;
 }
@@ -43,6 +43,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "c.h"
 #include "uuid.h"
@@ -87,12 +89,54 @@ static int check_uuids_in_file(const char *file)
 	return ret;
 }
 
+/*
+ * The time-based UUIDs are generated from a per-thread block of timestamps,
+ * the block must not be shared with a forked child.
+ */
+static int test_time_fork(void)
+{
+	uuid_t parent, child;
+	int pfd[2], status, failed = 0;
+	pid_t pid;
+
+	uuid_generate_time(parent);		/* reserve a block */
+
+	if (pipe(pfd) != 0)
+		err(EXIT_FAILURE, "pipe failed");
+
+	pid = fork();
+	if (pid < 0)
+		err(EXIT_FAILURE, "fork failed");
+	if (pid == 0) {
+		uuid_generate_time(child);
+		if (write(pfd[1], child, sizeof(child)) != sizeof(child))
+			_exit(EXIT_FAILURE);
+		_exit(EXIT_SUCCESS);
+	}
+	close(pfd[1]);
+
+	uuid_generate_time(parent);
+	if (read(pfd[0], child, sizeof(child)) != sizeof(child)
+	    || waitpid(pid, &status, 0) != pid || status != 0)
+		errx(EXIT_FAILURE, "child failed");
+	close(pfd[0]);
+
+	if (uuid_compare(parent, child) == 0) {
+		printf("parent and child time UUIDs are equal, FAILED\n");
+		failed++;
+	} else
+		printf("parent and child time UUIDs differ, OK\n");
+	return failed;
+}
+
 int
 main(int argc, char **argv)
 {
 	int failed = 0;
 
-	if (argc < 2) {
+	if (argc == 2 && strcmp(argv[1], "--time-fork") == 0) {
+		failed += test_time_fork();
+	} else if (argc < 2) {
 		failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981b", 1);
 		failed += test_uuid("84949CC5-4701-4A84-895B-354C584A981B", 1);
 		failed += test_uuid("84949cc5-4701-4a84-895b-354c584a981bc", 0);
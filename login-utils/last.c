@@ -26,6 +26,7 @@
  */
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <time.h>
 #include <stdio.h>
@@ -41,6 +42,7 @@
 #include <netdb.h>
 #include <arpa/inet.h>
 #include <libgen.h>
+#include <search.h>
 
 #include "c.h"
 #include "nls.h"
@@ -73,8 +75,6 @@
 # define LAST_TIMESTAMP_LEN 32
 #endif
 
-#define UCHUNKSIZE	16384	/* How much we read at once. */
-
 struct last_control {
 	unsigned int lastb :1,	  /* Is this command 'lastb' */
 		     extended :1, /* Lots of info */
@@ -96,11 +96,18 @@ struct last_control {
 	unsigned int time_fmt;	/* time format */
 };
 
-/* Double linked list of struct utmp's */
-struct utmplist {
-	struct utmpx ut;
-	struct utmplist *next;
-	struct utmplist *prev;
+/* The last record of a line, the lines are kept in a tsearch() tree */
+struct utmpline {
+	char line[sizeof(((struct utmpx *) 0)->ut_line)];
+	time_t time;
+};
+
+/* wtmp file mapped to memory */
+struct wtmpfile {
+	const char *data;
+	size_t size;
+	size_t base;		/* offset of the first complete record */
+	size_t nrecs;		/* number of the complete records */
 };
 
 /* Types of listing */
@@ -176,92 +183,77 @@ static int which_time_format(const char *s)
 #endif
 
 /*
- *	Read one utmp entry, return in new format.
- *	Automatically reposition file pointer.
+ *	Map the file to memory. The records are aligned to the end of the
+ *	file, an incomplete record at the begin is ignored.
  */
-static int uread(FILE *fp, struct utmpx *u,  int *quit, const char *filename)
+static int wtmp_open(struct wtmpfile *wf, int fd, const char *filename)
 {
-	static int utsize;
-	static char buf[UCHUNKSIZE];
-	char tmp[1024];
-	static off_t fpos;
-	static int bpos;
-	off_t o;
-
-	if (quit == NULL && u != NULL) {
-		/*
-		 *	Normal read.
-		 */
-		return fread(u, sizeof(struct utmpx), 1, fp);
-	}
-
-	if (u == NULL) {
-		/*
-		 *	Initialize and position.
-		 */
-		utsize = sizeof(struct utmpx);
-		fseeko(fp, 0, SEEK_END);
-		fpos = ftello(fp);
-		if (fpos == 0)
-			return 0;
-		o = ((fpos - 1) / UCHUNKSIZE) * UCHUNKSIZE;
-		if (fseeko(fp, o, SEEK_SET) < 0) {
-			warn(_("seek on %s failed"), filename);
-			return 0;
-		}
-		bpos = (int)(fpos - o);
-		if (fread(buf, bpos, 1, fp) != 1) {
-			warn(_("cannot read %s"), filename);
-			return 0;
-		}
-		fpos = o;
-		return 1;
-	}
+	struct stat st;
+	void *data;
 
-	/*
-	 *	Read one struct. From the buffer if possible.
-	 */
-	bpos -= utsize;
-	if (bpos >= 0) {
-		memcpy(u, buf + bpos, sizeof(struct utmpx));
-		return 1;
-	}
+	memset(wf, 0, sizeof(*wf));
 
-	/*
-	 *	Oops we went "below" the buffer. We should be able to
-	 *	seek back UCHUNKSIZE bytes.
-	 */
-	fpos -= UCHUNKSIZE;
-	if (fpos < 0)
-		return 0;
-
-	/*
-	 *	Copy whatever is left in the buffer.
-	 */
-	memcpy(tmp + (-bpos), buf, utsize + bpos);
-	if (fseeko(fp, fpos, SEEK_SET) < 0) {
-		warn(_("seek on %s failed"), filename);
+	if (fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, _("stat of %s failed"), filename);
+	if (st.st_size == 0)
 		return 0;
+	if ((uintmax_t) st.st_size > SIZE_MAX) {
+		warnx(_("%s: file too large"), filename);
+		return -1;
 	}
 
-	/*
-	 *	Read another UCHUNKSIZE bytes.
-	 */
-	if (fread(buf, UCHUNKSIZE, 1, fp) != 1) {
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
 		warn(_("cannot read %s"), filename);
-		return 0;
+		return -1;
 	}
+	wf->data = data;
+	wf->size = st.st_size;
+	wf->nrecs = wf->size / sizeof(struct utmpx);
+	wf->base = wf->size - wf->nrecs * sizeof(struct utmpx);
+	return 0;
+}
 
-	/*
-	 *	The end of the UCHUNKSIZE byte buffer should be the first
-	 *	few bytes of the current struct utmp.
-	 */
-	memcpy(tmp, buf + UCHUNKSIZE + bpos, -bpos);
-	bpos += UCHUNKSIZE;
+static void wtmp_close(struct wtmpfile *wf)
+{
+	if (wf->data)
+		munmap((void *) wf->data, wf->size);
+	memset(wf, 0, sizeof(*wf));
+}
 
-	memcpy(u, tmp, sizeof(struct utmpx));
+/* the records in the file are not aligned, copy them */
+static void wtmp_get(const struct wtmpfile *wf, size_t i, struct utmpx *u)
+{
+	memcpy(u, wf->data + wf->base + i * sizeof(struct utmpx),
+	       sizeof(struct utmpx));
+}
 
-	return 1;
+/*
+ *	Returns index of the first record not older than @t. The records are
+ *	appended to the file, so they are expected in time order.
+ */
+static size_t wtmp_find(const struct wtmpfile *wf, time_t t)
+{
+	size_t lo = 0, hi = wf->nrecs;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct utmpx u;
+
+		wtmp_get(wf, mid, &u);
+		if (u.ut_tv.tv_sec < t)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int cmp_line(const void *a, const void *b)
+{
+	return strncmp(((const struct utmpline *) a)->line,
+		       ((const struct utmpline *) b)->line,
+		       sizeof(((struct utmpline *) 0)->line));
 }
 
 #ifndef FUZZ_TARGET
@@ -651,12 +643,14 @@ static int is_phantom(const struct last_control *ctl, struct utmpx *ut)
 static void process_wtmp_file(const struct last_control *ctl,
 			      const char *filename)
 {
-	FILE *fp;		/* File pointer of wtmp file */
+	int fd;			/* wtmp file descriptor */
+	struct wtmpfile wf;	/* wtmp file in memory */
+	size_t i, first;	/* Records to read backwards */
 
 	struct utmpx ut;	/* Current utmp entry */
-	struct utmplist *ulist = NULL;	/* All entries */
-	struct utmplist *p;	/* Pointer into utmplist */
-	struct utmplist *next;	/* Pointer into utmplist */
+	void *lines = NULL;	/* The last records of the lines */
+	struct utmpline *p;	/* Pointer into lines */
+	struct utmpline key;
 
 	time_t lastboot = 0;	/* Last boottime */
 	time_t lastrch = 0;	/* Last run level change */
@@ -665,6 +659,7 @@ static void process_wtmp_file(const struct last_control *ctl,
 	int whydown = 0;	/* Why we went down: crash or shutdown */
 
 	int c, x;		/* Scratch */
+	void *node;
 	struct stat st;		/* To stat the [uw]tmp file */
 	int quit = 0;		/* Flag */
 	int down = 0;		/* Down flag */
@@ -690,39 +685,39 @@ static void process_wtmp_file(const struct last_control *ctl,
 	/*
 	 * Open the utmp file
 	 */
-	if ((fp = fopen(filename, "r")) == NULL)
+	if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) < 0)
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
 
-	/*
-	 * Optimize the buffer size.
-	 */
-	setvbuf(fp, NULL, _IOFBF, UCHUNKSIZE);
+	if (wtmp_open(&wf, fd, filename) != 0)
+		quit = 1;
 
 	/*
 	 * Read first structure to capture the time field
 	 */
-	if (uread(fp, &ut, NULL, filename) == 1)
+	if (wf.size >= sizeof(struct utmpx)) {
+		memcpy(&ut, wf.data, sizeof(struct utmpx));
 		begintime = ut.ut_tv.tv_sec;
-	else {
-		if (fstat(fileno(fp), &st) != 0)
+	} else {
+		if (fstat(fd, &st) != 0)
 			err(EXIT_FAILURE, _("stat of %s failed"), filename);
 		begintime = st.st_ctime;
 		quit = 1;
 	}
 
 	/*
-	 * Go to end of file minus one structure
-	 * and/or initialize utmp reading code.
+	 * Skip the records out of --since and --until range by binary
+	 * search, the checks below are still necessary if the records
+	 * are not in time order.
 	 */
-	uread(fp, NULL, NULL, filename);
+	i = ctl->until ? wtmp_find(&wf, ctl->until + 1) : wf.nrecs;
+	first = ctl->since ? wtmp_find(&wf, ctl->since) : 0;
 
 	/*
 	 * Read struct after struct backwards from the file.
 	 */
-	while (!quit) {
+	while (!quit && i > first) {
 
-		if (uread(fp, &ut, &quit, filename) != 1)
-			break;
+		wtmp_get(&wf, --i, &ut);
 
 		if (ctl->since && ut.ut_tv.tv_sec < ctl->since)
 			continue;
@@ -822,23 +817,15 @@ static void process_wtmp_file(const struct last_control *ctl,
 			 * the same ut_line.
 			 */
 			c = 0;
-			for (p = ulist; p; p = next) {
-				next = p->next;
-				if (strncmp(p->ut.ut_line, ut.ut_line,
-				    sizeof(ut.ut_line)) == 0) {
-					/* Show it */
-					if (c == 0) {
-						quit = list(ctl, &ut, p->ut.ut_tv.tv_sec, R_NORMAL);
-						c = 1;
-					}
-					if (p->next)
-						p->next->prev = p->prev;
-					if (p->prev)
-						p->prev->next = p->next;
-					else
-						ulist = p->next;
-					free(p);
-				}
+			memcpy(key.line, ut.ut_line, sizeof(key.line));
+			node = tfind(&key, &lines, cmp_line);
+			if (node) {
+				/* Show it */
+				p = *(struct utmpline **) node;
+				quit = list(ctl, &ut, p->time, R_NORMAL);
+				c = 1;
+				tdelete(p, &lines, cmp_line);
+				free(p);
 			}
 			/*
 			 * Not found? Then crashed, down, still
@@ -859,17 +846,21 @@ static void process_wtmp_file(const struct last_control *ctl,
 		case DEAD_PROCESS:
 			/*
 			 * Just store the data if it is
-			 * interesting enough.
+			 * interesting enough. Only the latest
+			 * record of the line is used.
 			 */
 			if (ut.ut_line[0] == 0)
 				break;
-			p = xmalloc(sizeof(struct utmplist));
-			memcpy(&p->ut, &ut, sizeof(struct utmpx));
-			p->next  = ulist;
-			p->prev  = NULL;
-			if (ulist)
-				ulist->prev = p;
-			ulist = p;
+			p = xmalloc(sizeof(struct utmpline));
+			memcpy(p->line, ut.ut_line, sizeof(p->line));
+			p->time = ut.ut_tv.tv_sec;
+			node = tsearch(p, &lines, cmp_line);
+			if (!node)
+				err(EXIT_FAILURE, _("failed to allocate memory"));
+			if (*(struct utmpline **) node != p) {
+				(*(struct utmpline **) node)->time = p->time;
+				free(p);
+			}
 			break;
 
 		case EMPTY:
@@ -887,16 +878,13 @@ static void process_wtmp_file(const struct last_control *ctl,
 
 		/*
 		 * If we saw a shutdown/reboot record we can remove
-		 * the entire current ulist.
+		 * the entire current lines tree.
 		 */
 		if (down) {
 			lastboot = ut.ut_tv.tv_sec;
 			whydown = (ut.ut_type == SHUTDOWN_TIME) ? R_DOWN : R_CRASH;
-			for (p = ulist; p; p = next) {
-				next = p->next;
-				free(p);
-			}
-			ulist = NULL;
+			tdestroy(lines, free);
+			lines = NULL;
 			down = 0;
 		}
 	}
@@ -914,12 +902,9 @@ static void process_wtmp_file(const struct last_control *ctl,
 		free(tmp);
 	}
 
-	fclose(fp);
-
-	for (p = ulist; p; p = next) {
-		next = p->next;
-		free(p);
-	}
+	wtmp_close(&wf);
+	close(fd);
+	tdestroy(lines, free);
 }
 
 #ifdef FUZZ_TARGET
@@ -58,6 +58,8 @@
 #include "logindefs.h"
 #include "procutils.h"
 #include "timeutils.h"
+#include "all-io.h"
+#include "idcache.h"
 
 /*
  * column description
@@ -73,6 +75,9 @@ struct lslogins_coldesc {
 
 static int lslogins_flag;
 
+/* group names */
+static struct idcache *gid_cache;
+
 #define UL_UID_MIN 1000
 #define UL_UID_MAX 60000
 #define UL_SYS_UID_MIN 101
@@ -255,11 +260,16 @@ static const struct lslogins_coldesc coldescs[] =
 struct lslogins_control {
 	struct utmpx *wtmp;
 	size_t wtmp_size;
+	void *wtmp_index;	/* the last wtmp record of each user */
 
 	struct utmpx *btmp;
 	size_t btmp_size;
+	void *btmp_index;	/* the last btmp record of each user */
 
 	int lastlogin_fd;
+	struct lastlog lastlog;	/* the last read lastlog record */
+	uid_t lastlog_uid;	/* uid of the lastlog record */
+	int lastlog_ok;		/* lastlog and lastlog_uid are valid */
 
 	void *usertree;
 
@@ -393,12 +403,15 @@ again:
 		if (!want_names)
 			x = snprintf(p, len, "%u,", sgroups[n]);
 		else {
-			struct group *grp = getgrgid(sgroups[n]);
-			if (!grp) {
+			struct identry *grp;
+
+			add_gid(gid_cache, sgroups[n]);
+			grp = get_id(gid_cache, sgroups[n]);
+			if (!grp || grp->unknown) {
 				free(res);
 				return NULL;
 			}
-			x = snprintf(p, len, "%s,", grp->gr_name);
+			x = snprintf(p, len, "%s,", grp->name);
 		}
 
 		if (x < 0 || (size_t) x >= len) {
@@ -422,21 +435,51 @@ again:
 	return res;
 }
 
-static struct utmpx *get_last_wtmp(struct lslogins_control *ctl, const char *username)
+static int cmp_ut_user(const void *a, const void *b)
 {
-	size_t n = 0;
+	return strncmp(((const struct utmpx *) a)->ut_user,
+		       ((const struct utmpx *) b)->ut_user,
+		       sizeof(((struct utmpx *) 0)->ut_user));
+}
+
+static void free_nothing(void *p __attribute__((__unused__)))
+{
+}
 
-	if (!username)
+/*
+ * Creates tsearch() tree with the last record of each user, so the
+ * per-user lookups do not scan the whole file.
+ */
+static void *index_utmpx(struct utmpx *records, size_t nrecords)
+{
+	void *tree = NULL;
+	size_t i;
+
+	for (i = 0; i < nrecords; i++) {
+		struct utmpx **node = tsearch(&records[i], &tree, cmp_ut_user);
+
+		if (!node)
+			err(EXIT_FAILURE, _("failed to allocate memory"));
+		*node = &records[i];	/* the later one wins */
+	}
+	return tree;
+}
+
+static struct utmpx *get_last_utmpx(void *index, const char *username)
+{
+	struct utmpx key, **node;
+
+	if (!username || !index)
 		return NULL;
 
-	n = ctl->wtmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->wtmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->wtmp + n;
-	} while (n--);
-	return NULL;
+	strncpy(key.ut_user, username, sizeof(key.ut_user));
+	node = tfind(&key, &index, cmp_ut_user);
+	return node ? *node : NULL;
+}
 
+static struct utmpx *get_last_wtmp(struct lslogins_control *ctl, const char *username)
+{
+	return get_last_utmpx(ctl->wtmp_index, username);
 }
 
 static int require_wtmp(void)
@@ -459,60 +502,43 @@ static int require_btmp(void)
 
 static struct utmpx *get_last_btmp(struct lslogins_control *ctl, const char *username)
 {
-	size_t n = 0;
-
-	if (!username)
-		return NULL;
-
-	n = ctl->btmp_size - 1;
-	do {
-		if (!strncmp(username, ctl->btmp[n].ut_user,
-		             sizeof(ctl->wtmp[0].ut_user)))
-			return ctl->btmp + n;
-	}while (n--);
-	return NULL;
-
+	return get_last_utmpx(ctl->btmp_index, username);
 }
 
+/*
+ * The file is an array of struct utmpx (see also last.c), read it at once
+ * rather than by getutxent() which locks the file for each record.
+ */
 static int parse_utmpx(const char *path, size_t *nrecords, struct utmpx **records)
 {
-	size_t i, imax = 0;
 	struct utmpx *ary = NULL;
 	struct stat st;
+	ssize_t sz;
+	int fd;
 
 	*nrecords = 0;
 	*records = NULL;
 
-	if (utmpxname(path) < 0)
-		return -errno;
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		goto fail;
+	if (fstat(fd, &st) != 0)
+		goto fail;
 
-	/* optimize allocation according to file size, the realloc() below is
-	 * just fallback only */
-	if (stat(path, &st) == 0 && (size_t) st.st_size > sizeof(struct utmpx)) {
-		imax = st.st_size / sizeof(struct utmpx);
-		ary = xmalloc(imax * sizeof(struct utmpx));
-	}
-
-	for (i = 0; ; i++) {
-		struct utmpx *u;
-		errno = 0;
-		u = getutxent();
-		if (!u) {
-			if (errno)
-				goto fail;
-			break;
-		}
-		if (i == imax)
-			ary = xrealloc(ary, (imax *= 2) * sizeof(struct utmpx));
-		ary[i] = *u;
+	if ((size_t) st.st_size >= sizeof(struct utmpx)) {
+		ary = xmalloc(st.st_size);
+		sz = read_all(fd, (char *) ary, st.st_size);
+		if (sz < 0)
+			goto fail;
+		*nrecords = sz / sizeof(struct utmpx);
 	}
 
-	*nrecords = i;
 	*records = ary;
-	endutxent();
+	close(fd);
 	return 0;
 fail:
-	endutxent();
+	if (fd >= 0)
+		close(fd);
 	free(ary);
 	if (errno) {
 		if (errno != EACCES)
@@ -524,23 +550,30 @@ fail:
 
 static void get_lastlog(struct lslogins_control *ctl, uid_t uid, void *dst, int what)
 {
-	struct lastlog ll;
-
-	if (ctl->lastlogin_fd < 0 ||
-	    pread(ctl->lastlogin_fd, (void *)&ll, sizeof(ll), uid * sizeof(ll)) != sizeof(ll))
-		return;
+	struct lastlog *ll = &ctl->lastlog;
+
+	/* the columns are read one by one, read the record only once */
+	if (!ctl->lastlog_ok || ctl->lastlog_uid != uid) {
+		ctl->lastlog_ok = 0;
+		if (ctl->lastlogin_fd < 0 ||
+		    pread(ctl->lastlogin_fd, (void *) ll, sizeof(*ll),
+			  (off_t) uid * sizeof(*ll)) != sizeof(*ll))
+			return;
+		ctl->lastlog_uid = uid;
+		ctl->lastlog_ok = 1;
+	}
 
 	switch (what) {
 	case LASTLOG_TIME: {
 		time_t *t = (time_t *)dst;
-		*t = ll.ll_time;
+		*t = ll->ll_time;
 		break;
 		}
 	case LASTLOG_LINE:
-		mem2strcpy(dst, ll.ll_line, sizeof(ll.ll_line), sizeof(ll.ll_line) + 1);
+		mem2strcpy(dst, ll->ll_line, sizeof(ll->ll_line), sizeof(ll->ll_line) + 1);
 		break;
 	case LASTLOG_HOST:
-		mem2strcpy(dst, ll.ll_host, sizeof(ll.ll_host), sizeof(ll.ll_host) + 1);
+		mem2strcpy(dst, ll->ll_host, sizeof(ll->ll_host), sizeof(ll->ll_host) + 1);
 		break;
 	default:
 		abort();
@@ -691,7 +724,7 @@ static struct lslogins_user *get_user_info(struct lslogins_control *ctl, const c
 {
 	struct lslogins_user *user;
 	struct passwd *pwd;
-	struct group *grp;
+	struct identry *grp;
 	struct spwd *shadow;
 	struct utmpx *user_wtmp = NULL, *user_btmp = NULL;
 	size_t n = 0;
@@ -723,8 +756,9 @@ static struct lslogins_user *get_user_info(struct lslogins_control *ctl, const c
 	}
 
 	errno = 0;
-	grp = getgrgid(pwd->pw_gid);
-	if (!grp)
+	add_gid(gid_cache, pwd->pw_gid);
+	grp = get_id(gid_cache, pwd->pw_gid);
+	if (!grp || grp->unknown)
 		return NULL;
 
 	user = xcalloc(1, sizeof(struct lslogins_user));
@@ -750,7 +784,7 @@ static struct lslogins_user *get_user_info(struct lslogins_control *ctl, const c
 			user->uid = pwd->pw_uid;
 			break;
 		case COL_GROUP:
-			user->group = xstrdup(grp->gr_name);
+			user->group = xstrdup(grp->name);
 			break;
 		case COL_GID:
 			user->gid = pwd->pw_gid;
@@ -991,6 +1025,8 @@ static void free_ctl(struct lslogins_control *ctl)
 {
 	size_t n = 0;
 
+	tdestroy(ctl->wtmp_index, free_nothing);
+	tdestroy(ctl->btmp_index, free_nothing);
 	free(ctl->wtmp);
 	free(ctl->btmp);
 
@@ -1660,14 +1696,25 @@ int main(int argc, char *argv[])
 
 	if (require_wtmp()) {
 		parse_utmpx(path_wtmp, &ctl->wtmp_size, &ctl->wtmp);
+		ctl->wtmp_index = index_utmpx(ctl->wtmp, ctl->wtmp_size);
 		ctl->lastlogin_fd = open(path_lastlog, O_RDONLY, 0);
 	}
-	if (require_btmp())
+	if (require_btmp()) {
 		parse_utmpx(path_btmp, &ctl->btmp_size, &ctl->btmp);
+		ctl->btmp_index = index_utmpx(ctl->btmp, ctl->btmp_size);
+	}
+
+	gid_cache = new_idcache();
+	if (!gid_cache)
+		err(EXIT_FAILURE, _("failed to allocate GID cache"));
 
 	if (logins || groups)
 		get_ulist(ctl, logins, groups);
 
+	/* all users are listed, resolve their groups by one pass */
+	if (!ctl->ulist_on)
+		preload_gids(gid_cache);
+
 	if (create_usertree(ctl))
 		return EXIT_FAILURE;
 
@@ -1675,6 +1722,7 @@ int main(int argc, char *argv[])
 
 	scols_unref_table(tb);
 	tdestroy(ctl->usertree, free_user);
+	free_idcache(gid_cache);
 
 	if (ctl->lastlogin_fd >= 0)
 		close(ctl->lastlogin_fd);
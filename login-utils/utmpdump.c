@@ -45,6 +45,12 @@
 #include "xalloc.h"
 #include "closestream.h"
 #include "timeutils.h"
+#include "strutils.h"
+#include "optutils.h"
+#include "jsonwrt.h"
+
+/* number of records read or written at once */
+#define UTMPDUMP_NRECS	1024
 
 static time_t strtotime(const char *s_time)
 {
@@ -95,48 +101,200 @@ static void xcleanse(char *s, int len)
 			*s = '?';
 }
 
-static void print_utline(struct utmpx *ut, FILE *out)
+/* like "%0*d" */
+static char *put_num(char *p, long num, int width)
 {
-	const char *addr_string;
-	char buffer[INET6_ADDRSTRLEN];
-	char time_string[40];
-	struct timeval tv;
+	unsigned long x = num < 0 ? -(unsigned long) num : (unsigned long) num;
+	char digits[sizeof(long) * 3];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + x % 10;
+		x /= 10;
+	} while (x);
+
+	if (num < 0) {
+		*p++ = '-';
+		width--;
+	}
+	for (; width > n; width--)
+		*p++ = '0';
+	while (n)
+		*p++ = digits[--n];
+	return p;
+}
+
+/* like "[%-*.*s] " */
+static char *put_field(char *p, const char *str, size_t maxsz, size_t width)
+{
+	size_t len = strnlen(str, maxsz);
+
+	*p++ = '[';
+	memcpy(p, str, len);
+	p += len;
+	for (; len < width; len++)
+		*p++ = ' ';
+	*p++ = ']';
+	*p++ = ' ';
+	return p;
+}
+
+/* The same address and second are usually in many records, cache them. */
+static const char *utmp_addr_string(struct utmpx *ut)
+{
+	static char buffer[INET6_ADDRSTRLEN];
+	static int32_t last[4];
+	static const char *str;
 
+	if (str && memcmp(last, ut->ut_addr_v6, sizeof(last)) == 0)
+		return str;
+
+	memcpy(last, ut->ut_addr_v6, sizeof(last));
 	if (ut->ut_addr_v6[1] || ut->ut_addr_v6[2] || ut->ut_addr_v6[3])
-		addr_string = inet_ntop(AF_INET6, &(ut->ut_addr_v6), buffer, sizeof(buffer));
+		str = inet_ntop(AF_INET6, &(ut->ut_addr_v6), buffer, sizeof(buffer));
 	else
-		addr_string = inet_ntop(AF_INET, &(ut->ut_addr_v6), buffer, sizeof(buffer));
+		str = inet_ntop(AF_INET, &(ut->ut_addr_v6), buffer, sizeof(buffer));
+	return str;
+}
+
+static const char *utmp_time_string(struct utmpx *ut)
+{
+	static char buffer[40];
+	static char *usec;		/* microseconds in the buffer */
+	static time_t last;
+	struct timeval tv;
 
 	tv.tv_sec = ut->ut_tv.tv_sec;
 	tv.tv_usec = ut->ut_tv.tv_usec;
 
-	if (strtimeval_iso(&tv, ISO_TIMESTAMP_COMMA_GT, time_string,
-			   sizeof(time_string)) != 0)
+	if (tv.tv_usec < 0 || tv.tv_usec > 999999) {
+		usec = NULL;
+		if (strtimeval_iso(&tv, ISO_TIMESTAMP_COMMA_GT, buffer,
+				   sizeof(buffer)) != 0)
+			return NULL;
+		return buffer;
+	}
+
+	if (!usec || tv.tv_sec != last) {
+		struct timeval sec = { .tv_sec = tv.tv_sec };
+
+		usec = NULL;
+		if (strtimeval_iso(&sec, ISO_TIMESTAMP_COMMA_GT, buffer,
+				   sizeof(buffer)) != 0)
+			return NULL;
+		usec = strchr(buffer, ',');
+		if (!usec)
+			return NULL;
+		usec++;
+		last = tv.tv_sec;
+	}
+	put_num(usec, tv.tv_usec, 6);
+	return buffer;
+}
+
+/* the utmp strings are not terminated if they use whole the field */
+static const char *field_to_str(char *buf, const char *field, size_t sz)
+{
+	memcpy(buf, field, sz);
+	buf[sz] = '\0';
+	return buf;
+}
+
+static void print_utline_json(struct utmpx *ut, const char *addr_string,
+			      const char *time_string, struct ul_jsonwrt *json)
+{
+	char buf[sizeof(ut->ut_host) + 1];
+
+	ul_jsonwrt_object_open(json, NULL);
+
+	*put_num(buf, ut->ut_type, 0) = '\0';
+	ul_jsonwrt_value_raw(json, "type", buf);
+	*put_num(buf, ut->ut_pid, 0) = '\0';
+	ul_jsonwrt_value_raw(json, "pid", buf);
+
+	ul_jsonwrt_value_s(json, "id",
+		field_to_str(buf, ut->ut_id, sizeof(ut->ut_id)));
+	ul_jsonwrt_value_s(json, "user",
+		field_to_str(buf, ut->ut_user, sizeof(ut->ut_user)));
+	ul_jsonwrt_value_s(json, "line",
+		field_to_str(buf, ut->ut_line, sizeof(ut->ut_line)));
+	ul_jsonwrt_value_s(json, "host",
+		field_to_str(buf, ut->ut_host, sizeof(ut->ut_host)));
+	ul_jsonwrt_value_s(json, "addr", addr_string);
+	ul_jsonwrt_value_s(json, "time", time_string);
+
+	ul_jsonwrt_object_close(json);
+}
+
+static void print_utline(struct utmpx *ut, FILE *out, struct ul_jsonwrt *json)
+{
+	const char *addr_string, *time_string;
+	char line[64 + sizeof(ut->ut_user) + sizeof(ut->ut_line)
+		     + sizeof(ut->ut_host) + INET6_ADDRSTRLEN + 40];
+	char *p = line;
+
+	addr_string = utmp_addr_string(ut);
+	time_string = utmp_time_string(ut);
+	if (!time_string)
 		return;
+
+	if (json) {
+		print_utline_json(ut, addr_string, time_string, json);
+		return;
+	}
+
 	cleanse(ut->ut_id);
 	cleanse(ut->ut_user);
 	cleanse(ut->ut_line);
 	cleanse(ut->ut_host);
 
-	/*            type pid    id       user     line     host     addr    time */
-	fprintf(out, "[%d] [%05d] [%-4.4s] [%-*.*s] [%-*.*s] [%-*.*s] [%-15s] [%s]\n",
-	       ut->ut_type, ut->ut_pid, ut->ut_id,
-	       8, (int)sizeof(ut->ut_user), ut->ut_user,
-	       12, (int)sizeof(ut->ut_line), ut->ut_line,
-	       20, (int)sizeof(ut->ut_host), ut->ut_host,
-	       addr_string, time_string);
+	/* "[%d] [%05d] [%-4.4s] [%-8s] [%-12s] [%-20s] [%-15s] [%s]\n" */
+	*p++ = '[';
+	p = put_num(p, ut->ut_type, 0);
+	*p++ = ']';
+	*p++ = ' ';
+	*p++ = '[';
+	p = put_num(p, ut->ut_pid, 5);
+	*p++ = ']';
+	*p++ = ' ';
+	p = put_field(p, ut->ut_id, sizeof(ut->ut_id), 4);
+	p = put_field(p, ut->ut_user, sizeof(ut->ut_user), 8);
+	p = put_field(p, ut->ut_line, sizeof(ut->ut_line), 12);
+	p = put_field(p, ut->ut_host, sizeof(ut->ut_host), 20);
+	p = put_field(p, addr_string ? addr_string : "(null)", INET6_ADDRSTRLEN, 15);
+	p = put_field(p, time_string, 40, 0);
+	p[-1] = '\n';
+
+	fwrite(line, 1, p - line, out);
+}
+
+/* returns number of the dumped records */
+static size_t dump_records(FILE *in, FILE *out, struct ul_jsonwrt *json)
+{
+	struct utmpx *uts = xmalloc(UTMPDUMP_NRECS * sizeof(struct utmpx));
+	size_t i, n, count = 0;
+
+	do {
+		n = fread(uts, sizeof(struct utmpx), UTMPDUMP_NRECS, in);
+		for (i = 0; i < n; i++)
+			print_utline(&uts[i], out, json);
+		count += n;
+	} while (n == UTMPDUMP_NRECS);
+
+	free(uts);
+	return count;
 }
 
 #ifdef HAVE_INOTIFY_INIT
 #define EVENTS		(IN_MODIFY|IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT)
 #define NEVENTS		4
 
-static void roll_file(const char *filename, off_t *size, FILE *out)
+static void roll_file(const char *filename, off_t *size, FILE *out,
+		      struct ul_jsonwrt *json)
 {
 	FILE *in;
 	struct stat st;
-	struct utmpx ut;
-	off_t pos;
+	size_t count = 0;
 
 	if (!(in = fopen(filename, "r")))
 		err(EXIT_FAILURE, _("cannot open %s"), filename);
@@ -147,23 +305,21 @@ static void roll_file(const char *filename, off_t *size, FILE *out)
 	if (st.st_size == *size)
 		goto done;
 
-	if (fseek(in, *size, SEEK_SET) != (off_t) -1) {
-		while (fread(&ut, sizeof(ut), 1, in) == 1)
-			print_utline(&ut, out);
-	}
+	if (fseeko(in, *size, SEEK_SET) != (off_t) -1)
+		count = dump_records(in, out, json);
 
-	pos = ftello(in);
-	/* If we've successfully read something, use the file position, this
-	 * avoids data duplication.  If we read nothing or hit an error,
-	 * reset to the reported size, this handles truncated files.
+	/* If we've successfully read something, continue after the last
+	 * record, this avoids data duplication.  If we read nothing or hit
+	 * an error, reset to the reported size, this handles truncated files.
 	 */
-	*size = (pos != -1 && pos != *size) ? pos : st.st_size;
+	*size = count ? *size + (off_t) (count * sizeof(struct utmpx)) : st.st_size;
 
 done:
 	fclose(in);
 }
 
-static int follow_by_inotify(FILE *in, const char *filename, FILE *out)
+static int follow_by_inotify(FILE *in, const char *filename, FILE *out,
+			     struct ul_jsonwrt *json)
 {
 	char buf[NEVENTS * sizeof(struct inotify_event)];
 	int fd, wd, event;
@@ -199,7 +355,7 @@ static int follow_by_inotify(FILE *in, const char *filename, FILE *out)
 				    (struct inotify_event *) &buf[event];
 
 			if (ev->mask & IN_MODIFY)
-				roll_file(filename, &size, out);
+				roll_file(filename, &size, out, json);
 			else {
 				close(wd);
 				wd = -1;
@@ -214,28 +370,25 @@ static int follow_by_inotify(FILE *in, const char *filename, FILE *out)
 }
 #endif /* HAVE_INOTIFY_INIT */
 
-static FILE *dump(FILE *in, const char *filename, int follow, FILE *out)
+static FILE *dump(FILE *in, const char *filename, int follow, FILE *out,
+		  struct ul_jsonwrt *json)
 {
-	struct utmpx ut;
-
 	if (follow)
-		ignore_result( fseek(in, -10 * sizeof(ut), SEEK_END) );
+		ignore_result( fseek(in, -10 * sizeof(struct utmpx), SEEK_END) );
 
-	while (fread(&ut, sizeof(ut), 1, in) == 1)
-		print_utline(&ut, out);
+	dump_records(in, out, json);
 
 	if (!follow)
 		return in;
 
 #ifdef HAVE_INOTIFY_INIT
-	if (follow_by_inotify(in, filename, out) == 0)
+	if (follow_by_inotify(in, filename, out, json) == 0)
 		return NULL;				/* file already closed */
 #endif
 	/* fallback for systems without inotify or with non-free
 	 * inotify instances */
 	for (;;) {
-		while (fread(&ut, sizeof(ut), 1, in) == 1)
-			print_utline(&ut, out);
+		dump_records(in, out, json);
 		sleep(1);
 	}
 
@@ -273,35 +426,57 @@ static int gettok(char *line, char *dest, int size, int eatspace)
 
 static void undump(FILE *in, FILE *out)
 {
-	struct utmpx ut;
+	struct utmpx *uts, *ut;
 	char s_addr[INET6_ADDRSTRLEN + 1], s_time[29] = {}, *linestart, *line;
+	char last_time[20] = {};	/* seconds part of the previous timestamp */
+	time_t last_sec = 0;
+	size_t n = 0;
 
+	uts = xmalloc(UTMPDUMP_NRECS * sizeof(*uts));
 	linestart = xmalloc(1024 * sizeof(*linestart));
 	s_time[28] = 0;
 
 	while (fgets(linestart, 1023, in)) {
 		line = linestart;
-		memset(&ut, '\0', sizeof(ut));
-		sscanf(line, "[%hd] [%d] [%4c] ", &ut.ut_type, &ut.ut_pid, ut.ut_id);
+		ut = &uts[n];
+		memset(ut, '\0', sizeof(*ut));
+		sscanf(line, "[%hd] [%d] [%4c] ", &ut->ut_type, &ut->ut_pid, ut->ut_id);
 
 		line += 19;
-		line += gettok(line, ut.ut_user, sizeof(ut.ut_user), 1);
-		line += gettok(line, ut.ut_line, sizeof(ut.ut_line), 1);
-		line += gettok(line, ut.ut_host, sizeof(ut.ut_host), 1);
+		line += gettok(line, ut->ut_user, sizeof(ut->ut_user), 1);
+		line += gettok(line, ut->ut_line, sizeof(ut->ut_line), 1);
+		line += gettok(line, ut->ut_host, sizeof(ut->ut_host), 1);
 		line += gettok(line, s_addr, sizeof(s_addr) - 1, 1);
 		gettok(line, s_time, sizeof(s_time) - 1, 0);
 		if (strchr(s_addr, '.'))
-			inet_pton(AF_INET, s_addr, &(ut.ut_addr_v6));
+			inet_pton(AF_INET, s_addr, &(ut->ut_addr_v6));
 		else
-			inet_pton(AF_INET6, s_addr, &(ut.ut_addr_v6));
-
-		ut.ut_tv.tv_sec = strtotime(s_time);
-		ut.ut_tv.tv_usec = strtousec(s_time);
+			inet_pton(AF_INET6, s_addr, &(ut->ut_addr_v6));
+
+		/* ISO timestamps of the same second differ in microseconds only */
+		if (isdigit(*s_time) && *last_time
+		    && strncmp(s_time, last_time, sizeof(last_time) - 1) == 0)
+			ut->ut_tv.tv_sec = last_sec;
+		else {
+			ut->ut_tv.tv_sec = strtotime(s_time);
+			if (isdigit(*s_time)) {
+				xstrncpy(last_time, s_time, sizeof(last_time));
+				last_sec = ut->ut_tv.tv_sec;
+			} else
+				*last_time = '\0';
+		}
+		ut->ut_tv.tv_usec = strtousec(s_time);
 
-		ignore_result( fwrite(&ut, sizeof(ut), 1, out) );
+		if (++n == UTMPDUMP_NRECS) {
+			ignore_result( fwrite(uts, sizeof(*uts), n, out) );
+			n = 0;
+		}
 	}
+	if (n)
+		ignore_result( fwrite(uts, sizeof(*uts), n, out) );
 
 	free(linestart);
+	free(uts);
 }
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -317,6 +492,7 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -f, --follow         output appended data as the file grows\n"), out);
+	fputs(_(" -J, --json           use JSON output format\n"), out);
 	fputs(_(" -r, --reverse        write back dumped data into utmp file\n"), out);
 	fputs(_(" -o, --output <file>  write to file instead of standard output\n"), out);
 	printf(USAGE_HELP_OPTIONS(22));
@@ -331,22 +507,32 @@ int main(int argc, char **argv)
 	FILE *in = NULL, *out = NULL;
 	int reverse = 0, follow = 0;
 	const char *filename = NULL;
+	struct ul_jsonwrt json, *jsonwrt = NULL;
 
 	static const struct option longopts[] = {
 		{ "follow",  no_argument,       NULL, 'f' },
+		{ "json",    no_argument,       NULL, 'J' },
 		{ "reverse", no_argument,       NULL, 'r' },
 		{ "output",  required_argument, NULL, 'o' },
 		{ "help",    no_argument,       NULL, 'h' },
 		{ "version", no_argument,       NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
 	};
+	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
+		{ 'J', 'r' },
+		{ 0 }
+	};
+	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "fro:hV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "fJro:hV", longopts, NULL)) != -1) {
+
+		err_exclusive_options(c, longopts, excl, excl_st);
+
 		switch (c) {
 		case 'r':
 			reverse = 1;
@@ -356,6 +542,10 @@ int main(int argc, char **argv)
 			follow = 1;
 			break;
 
+		case 'J':
+			jsonwrt = &json;
+			break;
+
 		case 'o':
 			out = fopen(optarg, "w");
 			if (!out)
@@ -396,7 +586,16 @@ int main(int argc, char **argv)
 		undump(in, out);
 	} else {
 		fprintf(stderr, _("Utmp dump of %s\n"), filename);
-		in = dump(in, filename, follow, out);
+		if (jsonwrt) {
+			ul_jsonwrt_init(jsonwrt, out, 0);
+			ul_jsonwrt_root_open(jsonwrt);
+			ul_jsonwrt_array_open(jsonwrt, "utmp");
+		}
+		in = dump(in, filename, follow, out, jsonwrt);
+		if (jsonwrt) {
+			ul_jsonwrt_array_close(jsonwrt);
+			ul_jsonwrt_root_close(jsonwrt);
+		}
 	}
 
 	if (out != stdout && close_stream(out))
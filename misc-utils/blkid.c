@@ -18,6 +18,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
 
 #define OUTPUT_FULL		(1 << 0)
 #define OUTPUT_VALUE_ONLY	(1 << 1)
@@ -25,6 +26,7 @@
 #define OUTPUT_PRETTY_LIST	(1 << 3)		/* deprecated */
 #define OUTPUT_UDEV_LIST	(1 << 4)		/* deprecated */
 #define OUTPUT_EXPORT_LIST	(1 << 5)
+#define OUTPUT_STATS		(1 << 6)
 
 #define BLKID_EXIT_NOTFOUND	2	/* token or device not found */
 #define BLKID_EXIT_OTHER	4	/* bad usage or other error */
@@ -50,6 +52,7 @@ struct blkid_control {
 	int output;
 	uintmax_t offset;
 	uintmax_t size;
+	unsigned int nworkers;
 	char *show[128];
 	unsigned int
 		eval:1,
@@ -79,13 +82,14 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(	" -d, --no-encoding          don't encode non-printing characters\n"), out);
 	fputs(_(	" -g, --garbage-collect      garbage collect the blkid cache\n"), out);
 	fputs(_(	" -o, --output <format>      output format; can be one of:\n"
-			"                              value, device, export or full; (default: full)\n"), out);
+			"                              value, device, export, stats or full; (default: full)\n"), out);
 	fputs(_(	" -k, --list-filesystems     list all known filesystems/RAIDs and exit\n"), out);
 	fputs(_(	" -s, --match-tag <tag>      show specified tag(s) (default show all tags)\n"), out);
 	fputs(_(	" -t, --match-token <token>  find device with a specific token (NAME=value pair)\n"), out);
 	fputs(_(	" -l, --list-one             look up only first device with token specified by -t\n"), out);
 	fputs(_(	" -L, --label <label>        convert LABEL to device name\n"), out);
 	fputs(_(	" -U, --uuid <uuid>          convert UUID to device name\n"), out);
+	fputs(_(	"     --workers <num>        probe all devices by <num> threads\n"), out);
 	fputs(          "\n", out);
 	fputs(_(	"Low-level probing options:\n"), out);
 	fputs(_(	" -p, --probe                low-level superblocks probing (bypass cache)\n"), out);
@@ -503,6 +507,25 @@ static int lowprobe_topology(blkid_probe pr)
 	return blkid_do_fullprobe(pr);
 }
 
+static void print_stats(blkid_probe pr, const char *devname)
+{
+	int n, nstats = blkid_probe_numof_stats(pr);
+
+	for (n = 0; n < nstats; n++) {
+		const char *chain, *name;
+		uint64_t usec, nreads, nbytes;
+
+		if (blkid_probe_get_stat(pr, n, &chain, &name, &usec,
+					 &nreads, &nbytes))
+			continue;
+		printf("%s: CHAIN=%s", devname, chain);
+		if (name)
+			printf(" PROBER=%s", name);
+		printf(" TIME_US=%"PRIu64" READS=%"PRIu64" BYTES=%"PRIu64"\n",
+				usec, nreads, nbytes);
+	}
+}
+
 static int lowprobe_device(blkid_probe pr, const char *devname,
 			   struct blkid_control *ctl)
 {
@@ -536,6 +559,11 @@ static int lowprobe_device(blkid_probe pr, const char *devname,
 	if (!rc)
 		nvals = blkid_probe_numof_values(pr);
 
+	if (ctl->output & OUTPUT_STATS) {
+		print_stats(pr, devname);
+		goto done;
+	}
+
 	if (nvals && !first && ctl->output & (OUTPUT_UDEV_LIST | OUTPUT_EXPORT_LIST))
 		/* add extra line between output from devices */
 		fputc('\n', stdout);
@@ -678,6 +706,10 @@ int main(int argc, char **argv)
 	unsigned int i;
 	int c;
 
+	enum {
+		OPT_WORKERS = CHAR_MAX + 1
+	};
+
 	static const struct option longopts[] = {
 		{ "cache-file",	      required_argument, NULL, 'c' },
 		{ "no-encoding",      no_argument,	 NULL, 'd' },
@@ -698,6 +730,7 @@ int main(int argc, char **argv)
 		{ "usages",	      required_argument, NULL, 'u' },
 		{ "match-types",      required_argument, NULL, 'n' },
 		{ "version",	      no_argument,	 NULL, 'V' },
+		{ "workers",	      required_argument, NULL, OPT_WORKERS },
 		{ "help",	      no_argument,       NULL, 'h' },
 		{ NULL, 0, NULL, 0 }
 	};
@@ -778,6 +811,8 @@ int main(int argc, char **argv)
 				ctl.output = OUTPUT_UDEV_LIST;
 			else if (!strcmp(optarg, "export"))
 				ctl.output = OUTPUT_EXPORT_LIST;
+			else if (!strcmp(optarg, "stats"))
+				ctl.output = OUTPUT_STATS;
 			else if (!strcmp(optarg, "full"))
 				ctl.output = 0;
 			else
@@ -796,6 +831,9 @@ int main(int argc, char **argv)
 			}
 			ctl.show[numtag++] = optarg;
 			break;
+		case OPT_WORKERS:
+			ctl.nworkers = strtou32_or_err(optarg, _("invalid workers argument"));
+			break;
 		case 'S':
 			ctl.size = strtosize_or_err(optarg, _("invalid size argument"));
 			break;
@@ -865,6 +903,11 @@ int main(int argc, char **argv)
 		pretty_print_dev(NULL);
 	}
 
+	if (ctl.output & OUTPUT_STATS && !ctl.lowprobe)
+		errx(BLKID_EXIT_OTHER,
+		     _("The 'stats' output format is supported "
+		       "in the low-level probing mode only"));
+
 	if (ctl.lowprobe) {
 		/*
 		 * Low-level API
@@ -883,6 +926,8 @@ int main(int argc, char **argv)
 		pr = blkid_new_probe();
 		if (!pr)
 			goto exit;
+		if ((ctl.output & OUTPUT_STATS) && blkid_probe_enable_stats(pr, 1))
+			goto exit;
 		if (hint && blkid_probe_set_hint(pr, hint, 0) != 0) {
 			warn(_("Failed to use probing hint: %s"), hint);
 			goto exit;
@@ -943,7 +988,10 @@ int main(int argc, char **argv)
 		blkid_dev_iterate	iter;
 		blkid_dev		dev;
 
-		blkid_probe_all(cache);
+		if (ctl.nworkers)
+			blkid_probe_all_parallel(cache, ctl.nworkers);
+		else
+			blkid_probe_all(cache);
 
 		iter = blkid_dev_iterate_begin(cache);
 		blkid_dev_set_search(iter, search_type, search_value);
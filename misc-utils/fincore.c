@@ -25,6 +25,22 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <string.h>
+#include <ftw.h>
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
+#if defined(__linux__)
+# include <sys/syscall.h>
+# include <stdint.h>
+# ifndef SYS_cachestat
+#  if defined(__alpha__)
+#   define SYS_cachestat	561
+#  elif !defined(__mips__)
+#   define SYS_cachestat	451
+#  endif
+# endif
+#endif
 
 #include "c.h"
 #include "nls.h"
@@ -39,8 +55,27 @@
    calling.
 
    Window size depends on page size.
-   e.g. 128MB on x86_64. ( = N_PAGES_IN_WINDOW * 4096 ). */
+   e.g. 128MB on x86_64. ( = N_PAGES_IN_WINDOW * 4096 ).
+   The window is doubled after each call up to N_PAGES_IN_WINDOW_MAX
+   (8GB on x86_64) to reduce the number of syscalls for huge files. */
 #define N_PAGES_IN_WINDOW ((size_t)(32 * 1024))
+#define N_PAGES_IN_WINDOW_MAX (N_PAGES_IN_WINDOW * 64)
+
+#ifdef SYS_cachestat
+/* from linux/mman.h */
+struct ul_cachestat_range {
+	uint64_t off;
+	uint64_t len;
+};
+
+struct ul_cachestat {
+	uint64_t nr_cache;
+	uint64_t nr_dirty;
+	uint64_t nr_writeback;
+	uint64_t nr_evicted;
+	uint64_t nr_recently_evicted;
+};
+#endif
 
 
 struct colinfo {
@@ -54,7 +89,16 @@ enum {
 	COL_PAGES,
 	COL_SIZE,
 	COL_FILE,
-	COL_RES
+	COL_RES,
+	COL_DIRTY_PAGES,
+	COL_DIRTY,
+	COL_WRITEBACK_PAGES,
+	COL_WRITEBACK,
+	COL_EVICTED_PAGES,
+	COL_EVICTED,
+	COL_RECENTLY_EVICTED_PAGES,
+	COL_RECENTLY_EVICTED,
+	COL_RES_RANGES
 };
 
 static struct colinfo infos[] = {
@@ -62,22 +106,64 @@ static struct colinfo infos[] = {
 	[COL_RES]    = { "RES",      5, SCOLS_FL_RIGHT, N_("file data resident in memory in bytes")},
 	[COL_SIZE]   = { "SIZE",     5, SCOLS_FL_RIGHT, N_("size of the file")},
 	[COL_FILE]   = { "FILE",     4, 0, N_("file name")},
+	[COL_DIRTY_PAGES] = { "DIRTY_PAGES", 1, SCOLS_FL_RIGHT, N_("number of dirty pages")},
+	[COL_DIRTY]  = { "DIRTY",    5, SCOLS_FL_RIGHT, N_("number of dirty bytes")},
+	[COL_WRITEBACK_PAGES] = { "WRITEBACK_PAGES", 1, SCOLS_FL_RIGHT, N_("number of pages marked for writeback")},
+	[COL_WRITEBACK] = { "WRITEBACK", 5, SCOLS_FL_RIGHT, N_("number of bytes marked for writeback")},
+	[COL_EVICTED_PAGES] = { "EVICTED_PAGES", 1, SCOLS_FL_RIGHT, N_("number of evicted pages")},
+	[COL_EVICTED] = { "EVICTED", 5, SCOLS_FL_RIGHT, N_("number of evicted bytes")},
+	[COL_RECENTLY_EVICTED_PAGES] = { "RECENTLY_EVICTED_PAGES", 1, SCOLS_FL_RIGHT, N_("number of recently evicted pages")},
+	[COL_RECENTLY_EVICTED] = { "RECENTLY_EVICTED", 5, SCOLS_FL_RIGHT, N_("number of recently evicted bytes")},
+	[COL_RES_RANGES] = { "RES_RANGES", 12, SCOLS_FL_WRAP, N_("file data ranges resident in memory")},
 };
 
 static int columns[ARRAY_SIZE(infos) * 2] = {-1};
 static size_t ncolumns;
 
+/* resident pages [start, end) */
+struct fincore_range {
+	off_t start;
+	off_t end;
+};
+
+/* the result for one file */
+struct fincore_state {
+	char *name;
+	struct stat file_stat;
+
+	off_t count_incore;		/* resident pages */
+	uint64_t count_dirty;		/* the rest is from cachestat() only */
+	uint64_t count_writeback;
+	uint64_t count_evicted;
+	uint64_t count_recently_evicted;
+
+	struct fincore_range *ranges;	/* for RES_RANGES only */
+	size_t nranges;
+
+	int rc;				/* <0 on error, 0 success, 1 ignore */
+	unsigned int has_cachestat : 1;
+};
+
 struct fincore_control {
 	const size_t pagesize;
 
 	struct libscols_table *tb;		/* output */
 
+	struct fincore_state *files;		/* files to count */
+	size_t nfiles;
+	unsigned int nworkers;
+
 	unsigned int bytes : 1,
 		     noheadings : 1,
 		     raw : 1,
-		     json : 1;
+		     json : 1,
+		     recursive : 1,
+		     ranges : 1;		/* RES_RANGES requested */
 };
 
+/* cachestat() is not supported by the kernel; set by the first call */
+static int no_cachestat;
+
 
 static int column_name_to_id(const char *name, size_t namesz)
 {
@@ -106,14 +192,58 @@ static const struct colinfo *get_column_info(int num)
 	return &infos[ get_column_id(num) ];
 }
 
+static char *pages_to_string(struct fincore_control *ctl, int inbytes,
+			     uintmax_t pages)
+{
+	char *tmp;
+
+	if (!inbytes)
+		xasprintf(&tmp, "%ju", pages);
+	else if (ctl->bytes)
+		xasprintf(&tmp, "%ju", pages * ctl->pagesize);
+	else
+		tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, pages * ctl->pagesize);
+	return tmp;
+}
+
+/* returns "start-end" for all the resident ranges, one range per line */
+static char *ranges_to_string(struct fincore_control *ctl,
+			      struct fincore_state *st)
+{
+	char *res = NULL;
+	size_t i;
+
+	for (i = 0; i < st->nranges; i++) {
+		uintmax_t start = (uintmax_t) st->ranges[i].start * ctl->pagesize;
+		uintmax_t end = (uintmax_t) st->ranges[i].end * ctl->pagesize;
+		char *tmp;
+
+		if (end > (uintmax_t) st->file_stat.st_size)
+			end = st->file_stat.st_size;
+		if (ctl->bytes)
+			xasprintf(&tmp, "%s%ju-%ju", i ? "\n" : "", start, end);
+		else {
+			char *a = size_to_human_string(SIZE_SUFFIX_1LETTER, start);
+			char *b = size_to_human_string(SIZE_SUFFIX_1LETTER, end);
+
+			xasprintf(&tmp, "%s%s-%s", i ? "\n" : "", a, b);
+			free(a);
+			free(b);
+		}
+		if (strappend(&res, tmp) != 0)
+			err(EXIT_FAILURE, _("failed to allocate output data"));
+		free(tmp);
+	}
+	return res;
+}
+
 static int add_output_data(struct fincore_control *ctl,
-			   const char *name,
-			   off_t file_size,
-			   off_t count_incore)
+			   struct fincore_state *st)
 {
 	size_t i;
 	char *tmp;
 	struct libscols_line *ln;
+	off_t file_size = st->file_stat.st_size;
 
 	assert(ctl);
 	assert(ctl->tb);
@@ -124,18 +254,19 @@ static int add_output_data(struct fincore_control *ctl,
 
 	for (i = 0; i < ncolumns; i++) {
 		int rc = 0;
+		int id = get_column_id(i);
 
-		switch(get_column_id(i)) {
+		switch(id) {
 		case COL_FILE:
-			rc = scols_line_set_data(ln, i, name);
+			rc = scols_line_set_data(ln, i, st->name);
 			break;
 		case COL_PAGES:
-			xasprintf(&tmp, "%jd",  (intmax_t) count_incore);
+			xasprintf(&tmp, "%jd",  (intmax_t) st->count_incore);
 			rc = scols_line_refer_data(ln, i, tmp);
 			break;
 		case COL_RES:
 		{
-			uintmax_t res = (uintmax_t) count_incore * ctl->pagesize;
+			uintmax_t res = (uintmax_t) st->count_incore * ctl->pagesize;
 
 			if (ctl->bytes)
 				xasprintf(&tmp, "%ju", res);
@@ -151,6 +282,39 @@ static int add_output_data(struct fincore_control *ctl,
 				tmp = size_to_human_string(SIZE_SUFFIX_1LETTER, file_size);
 			rc = scols_line_refer_data(ln, i, tmp);
 			break;
+		case COL_DIRTY_PAGES:
+		case COL_DIRTY:
+			if (st->has_cachestat)
+				rc = scols_line_refer_data(ln, i,
+					pages_to_string(ctl, id == COL_DIRTY,
+						st->count_dirty));
+			break;
+		case COL_WRITEBACK_PAGES:
+		case COL_WRITEBACK:
+			if (st->has_cachestat)
+				rc = scols_line_refer_data(ln, i,
+					pages_to_string(ctl, id == COL_WRITEBACK,
+						st->count_writeback));
+			break;
+		case COL_EVICTED_PAGES:
+		case COL_EVICTED:
+			if (st->has_cachestat)
+				rc = scols_line_refer_data(ln, i,
+					pages_to_string(ctl, id == COL_EVICTED,
+						st->count_evicted));
+			break;
+		case COL_RECENTLY_EVICTED_PAGES:
+		case COL_RECENTLY_EVICTED:
+			if (st->has_cachestat)
+				rc = scols_line_refer_data(ln, i,
+					pages_to_string(ctl, id == COL_RECENTLY_EVICTED,
+						st->count_recently_evicted));
+			break;
+		case COL_RES_RANGES:
+			if (st->nranges)
+				rc = scols_line_refer_data(ln, i,
+					ranges_to_string(ctl, st));
+			break;
 		default:
 			return -EINVAL;
 		}
@@ -162,42 +326,113 @@ static int add_output_data(struct fincore_control *ctl,
 	return 0;
 }
 
+static void add_range(struct fincore_state *st, off_t start, off_t end)
+{
+	if (st->nranges && st->ranges[st->nranges - 1].end == start) {
+		st->ranges[st->nranges - 1].end = end;
+		return;
+	}
+	if (st->nranges % 32 == 0)
+		st->ranges = xrealloc(st->ranges,
+				(st->nranges + 32) * sizeof(struct fincore_range));
+	st->ranges[st->nranges].start = start;
+	st->ranges[st->nranges].end = end;
+	st->nranges++;
+}
+
 static int do_mincore(struct fincore_control *ctl,
 		      void *window, const size_t len,
-		      const char *name,
-		      off_t *count_incore)
+		      off_t file_offset,
+		      unsigned char *vec,
+		      struct fincore_state *st)
 {
-	static unsigned char vec[N_PAGES_IN_WINDOW];
-	int n = (len / ctl->pagesize) + ((len % ctl->pagesize)? 1: 0);
+	size_t n = (len / ctl->pagesize) + ((len % ctl->pagesize)? 1: 0);
+	off_t first = file_offset / ctl->pagesize;
+	size_t i, start = 0;
+	int inrange = 0;
 
 	if (mincore (window, len, vec) < 0) {
-		warn(_("failed to do mincore: %s"), name);
+		warn(_("failed to do mincore: %s"), st->name);
 		return -errno;
 	}
 
-	while (n > 0)
-	{
-		if (vec[--n] & 0x1)
-		{
-			vec[n] = 0;
-			(*count_incore)++;
+	if (!st->has_cachestat) {
+		for (i = 0; i < n; i++)
+			st->count_incore += vec[i] & 0x1;
+	}
+
+	if (!ctl->ranges)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if ((vec[i] & 0x1) && !inrange) {
+			start = i;
+			inrange = 1;
+		} else if (!(vec[i] & 0x1) && inrange) {
+			add_range(st, first + start, first + i);
+			inrange = 0;
 		}
 	}
+	if (inrange)
+		add_range(st, first + start, first + n);
 
 	return 0;
 }
 
+#ifdef SYS_cachestat
+/*
+ * Returns: 0 on success, 1 if cachestat() is not supported, <0 on error.
+ */
+static int fincore_cachestat(int fd, struct fincore_state *st)
+{
+	struct ul_cachestat_range range = { 0, 0 };	/* whole file */
+	struct ul_cachestat cs;
+
+	if (no_cachestat)
+		return 1;
+
+	memset(&cs, 0, sizeof(cs));
+	if (syscall(SYS_cachestat, fd, &range, &cs, 0) != 0) {
+		if (errno == ENOSYS)
+			no_cachestat = 1;
+		if (errno == ENOSYS || errno == EOPNOTSUPP)
+			return 1;	/* try mincore() */
+		warn(_("failed to do cachestat: %s"), st->name);
+		return -errno;
+	}
+
+	st->count_incore = cs.nr_cache;
+	st->count_dirty = cs.nr_dirty;
+	st->count_writeback = cs.nr_writeback;
+	st->count_evicted = cs.nr_evicted;
+	st->count_recently_evicted = cs.nr_recently_evicted;
+	st->has_cachestat = 1;
+	return 0;
+}
+#endif
+
 static int fincore_fd (struct fincore_control *ctl,
 		       int fd,
-		       const char *name,
-		       off_t file_size,
-		       off_t *count_incore)
+		       struct fincore_state *st)
 {
-	size_t window_size = N_PAGES_IN_WINDOW * ctl->pagesize;
+	size_t window_pages = N_PAGES_IN_WINDOW;
+	off_t file_size = st->file_stat.st_size;
 	off_t file_offset, len;
+	unsigned char *vec;
 	int rc = 0;
 
+#ifdef SYS_cachestat
+	rc = fincore_cachestat(fd, st);
+	if (rc < 0 || (rc == 0 && !ctl->ranges))
+		return rc;
+	rc = 0;		/* the ranges are available by mincore() only */
+#endif
+	/* no larger vector than necessary for small files */
+	vec = xmalloc(min((size_t) (file_size / ctl->pagesize) + 1,
+			  N_PAGES_IN_WINDOW_MAX));
+
 	for (file_offset = 0; file_offset < file_size; file_offset += len) {
+		size_t window_size = window_pages * ctl->pagesize;
 		void  *window = NULL;
 
 		len = file_size - file_offset;
@@ -207,17 +442,20 @@ static int fincore_fd (struct fincore_control *ctl,
 		window = mmap(window, len, PROT_NONE, MAP_PRIVATE, fd, file_offset);
 		if (window == MAP_FAILED) {
 			rc = -EINVAL;
-			warn(_("failed to do mmap: %s"), name);
+			warn(_("failed to do mmap: %s"), st->name);
 			break;
 		}
 
-		rc = do_mincore(ctl, window, len, name, count_incore);
+		rc = do_mincore(ctl, window, len, file_offset, vec, st);
+		munmap (window, len);
 		if (rc)
 			break;
 
-		munmap (window, len);
+		if (window_pages < N_PAGES_IN_WINDOW_MAX)
+			window_pages *= 2;
 	}
 
+	free(vec);
 	return rc;
 }
 
@@ -225,34 +463,118 @@ static int fincore_fd (struct fincore_control *ctl,
  * Returns: <0 on error, 0 success, 1 ignore.
  */
 static int fincore_name(struct fincore_control *ctl,
-			const char *name,
-			struct stat *sb,
-			off_t *count_incore)
+			struct fincore_state *st)
 {
 	int fd;
 	int rc = 0;
 
-	if ((fd = open (name, O_RDONLY)) < 0) {
-		warn(_("failed to open: %s"), name);
+	if ((fd = open (st->name, O_RDONLY)) < 0) {
+		warn(_("failed to open: %s"), st->name);
 		return -errno;
 	}
 
-	if (fstat (fd, sb) < 0) {
-		warn(_("failed to do fstat: %s"), name);
+	if (fstat (fd, &st->file_stat) < 0) {
+		warn(_("failed to do fstat: %s"), st->name);
 		close (fd);
 		return -errno;
 	}
 
-	if (S_ISDIR(sb->st_mode))
+	if (S_ISDIR(st->file_stat.st_mode))
 		rc = 1;			/* ignore */
 
-	else if (sb->st_size)
-		rc = fincore_fd(ctl, fd, name, sb->st_size, count_incore);
+	else if (st->file_stat.st_size)
+		rc = fincore_fd(ctl, fd, st);
 
 	close (fd);
 	return rc;
 }
 
+static void add_file(struct fincore_control *ctl, const char *name)
+{
+	if (ctl->nfiles % 64 == 0)
+		ctl->files = xrealloc(ctl->files,
+				(ctl->nfiles + 64) * sizeof(struct fincore_state));
+	memset(&ctl->files[ctl->nfiles], 0, sizeof(struct fincore_state));
+	ctl->files[ctl->nfiles++].name = xstrdup(name);
+}
+
+/* nftw() does not support a private data pointer */
+static struct fincore_control *walk_ctl;
+
+static int add_tree_file(const char *fpath, const struct stat *sb,
+			 int typeflag,
+			 struct FTW *ftwbuf __attribute__((__unused__)))
+{
+	if (typeflag == FTW_DNR || typeflag == FTW_NS)
+		warnx(_("cannot read %s"), fpath);
+	else if (typeflag == FTW_F && S_ISREG(sb->st_mode))
+		add_file(walk_ctl, fpath);
+	return 0;
+}
+
+static void add_name(struct fincore_control *ctl, const char *name)
+{
+	struct stat sb;
+
+	if (ctl->recursive && stat(name, &sb) == 0 && S_ISDIR(sb.st_mode)) {
+		walk_ctl = ctl;
+		if (nftw(name, add_tree_file, 16, FTW_PHYS) != 0)
+			warn(_("cannot read %s"), name);
+		return;
+	}
+	add_file(ctl, name);
+}
+
+#ifdef HAVE_PTHREAD_H
+struct fincore_workers {
+	struct fincore_control *ctl;
+	pthread_mutex_t lock;
+	size_t next;
+};
+
+static void *fincore_worker(void *data)
+{
+	struct fincore_workers *wrk = data;
+
+	for (;;) {
+		struct fincore_state *st = NULL;
+
+		pthread_mutex_lock(&wrk->lock);
+		if (wrk->next < wrk->ctl->nfiles)
+			st = &wrk->ctl->files[wrk->next++];
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (!st)
+			break;
+		st->rc = fincore_name(wrk->ctl, st);
+	}
+	return NULL;
+}
+
+static void fincore_parallel(struct fincore_control *ctl)
+{
+	struct fincore_workers wrk = { .ctl = ctl };
+	pthread_t *threads;
+	unsigned int i, n;
+
+	pthread_mutex_init(&wrk.lock, NULL);
+	threads = xcalloc(ctl->nworkers, sizeof(pthread_t));
+
+	for (n = 0; n < ctl->nworkers; n++) {
+		if (pthread_create(&threads[n], NULL, fincore_worker, &wrk) != 0)
+			break;
+	}
+	if (!n)
+		fincore_worker(&wrk);	/* no thread, do it ourselves */
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	pthread_mutex_destroy(&wrk.lock);
+}
+#endif /* HAVE_PTHREAD_H */
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -267,6 +589,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -n, --noheadings      don't print headings\n"), out);
 	fputs(_(" -o, --output <list>   output columns\n"), out);
 	fputs(_(" -r, --raw             use raw output format\n"), out);
+	fputs(_(" -R, --recursive       count all files in the directories\n"), out);
+#ifdef HAVE_PTHREAD_H
+	fputs(_("     --workers <num>   count the files by <num> threads\n"), out);
+#endif
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(23));
@@ -274,7 +600,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out, USAGE_COLUMNS);
 
 	for (i = 0; i < ARRAY_SIZE(infos); i++)
-		fprintf(out, " %11s  %s\n", infos[i].name, _(infos[i].help));
+		fprintf(out, " %22s  %s\n", infos[i].name, _(infos[i].help));
 
 	printf(USAGE_MAN_TAIL("fincore(1)"));
 
@@ -292,6 +618,9 @@ int main(int argc, char ** argv)
 		.pagesize = getpagesize()
 	};
 
+	enum {
+		OPT_WORKERS = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 		{ "bytes",      no_argument, NULL, 'b' },
 		{ "noheadings", no_argument, NULL, 'n' },
@@ -300,6 +629,8 @@ int main(int argc, char ** argv)
 		{ "help",	no_argument, NULL, 'h' },
 		{ "json",       no_argument, NULL, 'J' },
 		{ "raw",        no_argument, NULL, 'r' },
+		{ "recursive",  no_argument, NULL, 'R' },
+		{ "workers",    required_argument, NULL, OPT_WORKERS },
 		{ NULL, 0, NULL, 0 },
 	};
 
@@ -308,7 +639,7 @@ int main(int argc, char ** argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long (argc, argv, "bno:JrVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long (argc, argv, "bno:JrRVh", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'b':
 			ctl.bytes = 1;
@@ -325,6 +656,12 @@ int main(int argc, char ** argv)
 		case 'r':
 			ctl.raw = 1;
 			break;
+		case 'R':
+			ctl.recursive = 1;
+			break;
+		case OPT_WORKERS:
+			ctl.nworkers = strtou32_or_err(optarg, _("invalid workers argument"));
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -369,6 +706,14 @@ int main(int argc, char ** argv)
 		if (!cl)
 			err(EXIT_FAILURE, _("failed to allocate output column"));
 
+		if (col->flags & SCOLS_FL_WRAP) {
+			scols_column_set_wrapfunc(cl,
+						scols_wrapnl_chunksize,
+						scols_wrapnl_nextchunk,
+						NULL);
+			scols_column_set_safechars(cl, "\n");
+		}
+
 		if (ctl.json) {
 			int id = get_column_id(i);
 
@@ -376,8 +721,15 @@ int main(int argc, char ** argv)
 			case COL_FILE:
 				scols_column_set_json_type(cl, SCOLS_JSON_STRING);
 				break;
+			case COL_RES_RANGES:
+				scols_column_set_json_type(cl, SCOLS_JSON_ARRAY_STRING);
+				break;
 			case COL_SIZE:
 			case COL_RES:
+			case COL_DIRTY:
+			case COL_WRITEBACK:
+			case COL_EVICTED:
+			case COL_RECENTLY_EVICTED:
 				if (!ctl.bytes)
 					break;
 				/* fallthrough */
@@ -386,16 +738,28 @@ int main(int argc, char ** argv)
 				break;
 			}
 		}
+
+		if (get_column_id(i) == COL_RES_RANGES)
+			ctl.ranges = 1;
 	}
 
-	for(; optind < argc; optind++) {
-		char *name = argv[optind];
-		struct stat sb;
-		off_t count_incore = 0;
+	for(; optind < argc; optind++)
+		add_name(&ctl, argv[optind]);
+
+#ifdef HAVE_PTHREAD_H
+	if (ctl.nworkers > 1)
+		fincore_parallel(&ctl);
+	else
+#endif
+	for (i = 0; i < ctl.nfiles; i++)
+		ctl.files[i].rc = fincore_name(&ctl, &ctl.files[i]);
+
+	for (i = 0; i < ctl.nfiles; i++) {
+		struct fincore_state *st = &ctl.files[i];
 
-		switch (fincore_name(&ctl, name, &sb, &count_incore)) {
+		switch (st->rc) {
 		case 0:
-			add_output_data(&ctl, name, sb.st_size, count_incore);
+			add_output_data(&ctl, st);
 			break;
 		case 1:
 			break; /* ignore */
@@ -403,7 +767,10 @@ int main(int argc, char ** argv)
 			rc = EXIT_FAILURE;
 			break;
 		}
+		free(st->name);
+		free(st->ranges);
 	}
+	free(ctl.files);
 
 	scols_print_table(ctl.tb);
 	scols_unref_table(ctl.tb);
@@ -30,6 +30,7 @@
 #endif
 #include <assert.h>
 #include <poll.h>
+#include <time.h>
 #include <sys/statvfs.h>
 #include <sys/types.h>
 #ifdef HAVE_LIBUDEV
@@ -818,6 +819,23 @@ static char **append_pid_tabfile(char **files, int *nfiles, pid_t pid)
 	return append_tabfile(files, nfiles, path);
 }
 
+/*
+ * Parses mountinfo, or mounts if mountinfo is not available. The file is not
+ * checked by access(2) first, the parser reports the same error.
+ */
+static int parse_kernel_table(struct libmnt_table *tb, const char **path)
+{
+	int rc;
+
+	*path = _PATH_PROC_MOUNTINFO;
+	rc = mnt_table_parse_file(tb, *path);
+	if (rc == -ENOENT || rc == -EACCES) {
+		*path = _PATH_PROC_MOUNTS;
+		rc = mnt_table_parse_file(tb, *path);
+	}
+	return rc;
+}
+
 /* calls libmount fstab/mtab/mountinfo parser */
 static struct libmnt_table *parse_tabfiles(char **files,
 					   int nfiles,
@@ -832,6 +850,7 @@ static struct libmnt_table *parse_tabfiles(char **files,
 		return NULL;
 	}
 	mnt_table_set_parser_errcb(tb, parser_errcb);
+	mnt_table_enable_zerocopy(tb, 1);	/* read-only use */
 
 	do {
 		/* NULL means that libmount will use default paths */
@@ -846,11 +865,9 @@ static struct libmnt_table *parse_tabfiles(char **files,
 			break;
 		case TABTYPE_KERNEL:
 			if (!path)
-				path = access(_PATH_PROC_MOUNTINFO, R_OK) == 0 ?
-					      _PATH_PROC_MOUNTINFO :
-					      _PATH_PROC_MOUNTS;
-
-			rc = mnt_table_parse_file(tb, path);
+				rc = parse_kernel_table(tb, &path);
+			else
+				rc = mnt_table_parse_file(tb, path);
 			break;
 		}
 		if (rc) {
@@ -876,11 +893,7 @@ static void cache_set_targets(struct libmnt_cache *tmp)
 	if (!tb)
 		return;
 
-	path = access(_PATH_PROC_MOUNTINFO, R_OK) == 0 ?
-		_PATH_PROC_MOUNTINFO :
-		_PATH_PROC_MOUNTS;
-
-	if (mnt_table_parse_file(tb, path) == 0)
+	if (parse_kernel_table(tb, &path) == 0)
 		mnt_cache_set_targets(tmp, tb);
 
 	mnt_unref_table(tb);
@@ -1094,22 +1107,43 @@ static int poll_match(struct libmnt_fs *fs)
 	return rc;
 }
 
+/*
+ * Waits until @interval milliseconds since @start are over. The events
+ * within this time are consumed by poll(), so a burst of mount table changes
+ * is processed and printed as one batch.
+ */
+static int poll_coalesce(struct pollfd *fds, const struct timespec *start,
+			 int interval)
+{
+	struct timespec now;
+	int64_t left;
+
+	do {
+		if (clock_gettime(CLOCK_MONOTONIC, &now) != 0)
+			return -errno;
+		left = (int64_t) interval
+			- (int64_t) (now.tv_sec - start->tv_sec) * 1000
+			- (now.tv_nsec - start->tv_nsec) / 1000000;
+		if (left <= 0)
+			break;
+		if (poll(fds, 1, (int) left) < 0 && errno != EINTR)
+			return -errno;
+	} while (1);
+
+	return 0;
+}
+
 static int poll_table(struct libmnt_table *tb, const char *tabfile,
-		  int timeout, struct libscols_table *table, int direction)
+		  int timeout, int interval, struct libscols_table *table,
+		  int direction)
 {
 	FILE *f = NULL;
-	int rc = -1;
+	int rc = -1, refresh = 1;
 	struct libmnt_iter *itr = NULL;
-	struct libmnt_table *tb_new;
+	struct libmnt_table *tb_new = NULL;
 	struct libmnt_tabdiff *diff = NULL;
 	struct pollfd fds[1];
 
-	tb_new = mnt_new_table();
-	if (!tb_new) {
-		warn(_("failed to initialize libmount table"));
-		goto done;
-	}
-
 	itr = mnt_new_iter(direction);
 	if (!itr) {
 		warn(_("failed to initialize libmount iterator"));
@@ -1124,7 +1158,6 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 
 	/* cache is unnecessary to detect changes */
 	mnt_table_set_cache(tb, NULL);
-	mnt_table_set_cache(tb_new, NULL);
 
 	f = fopen(tabfile, "r");
 	if (!f) {
@@ -1132,14 +1165,12 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 		goto done;
 	}
 
-	mnt_table_set_parser_errcb(tb_new, parser_errcb);
-
 	fds[0].fd = fileno(f);
 	fds[0].events = POLLPRI;
 
 	while (1) {
-		struct libmnt_table *tmp;
 		struct libmnt_fs *old, *new;
+		struct timespec start;
 		int change, count;
 
 		count = poll(fds, 1, timeout);
@@ -1150,18 +1181,58 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 			goto done;
 		}
 
-		rewind(f);
-		rc = mnt_table_parse_stream(tb_new, f, tabfile);
-		if (!rc)
-			rc = mnt_diff_tables(diff, tb, tb_new);
-		if (rc < 0)
+		if (interval > 0
+		    && (clock_gettime(CLOCK_MONOTONIC, &start) != 0
+			|| poll_coalesce(fds, &start, interval) != 0)) {
+			warn(_("poll() failed"));
 			goto done;
+		}
+
+		/*
+		 * The mountinfo table is updated in place, only the changed
+		 * lines are parsed. The other tables are parsed again and
+		 * compared with the previous version.
+		 */
+		if (refresh) {
+			rc = mnt_table_refresh(tb, tabfile, diff);
+			if (rc == -EINVAL)
+				refresh = 0;
+			else if (rc < 0)
+				goto done;
+		}
+		if (!refresh) {
+			struct libmnt_table *tmp;
+
+			if (!tb_new) {
+				tb_new = mnt_new_table();
+				if (!tb_new) {
+					warn(_("failed to initialize libmount table"));
+					goto done;
+				}
+				mnt_table_set_cache(tb_new, NULL);
+				mnt_table_set_parser_errcb(tb_new, parser_errcb);
+			}
+
+			rewind(f);
+			rc = mnt_table_parse_stream(tb_new, f, tabfile);
+			if (!rc)
+				rc = mnt_diff_tables(diff, tb, tb_new);
+			if (rc < 0)
+				goto done;
+
+			/* swap tables */
+			tmp = tb;
+			tb = tb_new;
+			tb_new = tmp;
+		}
 
 		count = 0;
 		mnt_reset_iter(itr, direction);
 		while(mnt_tabdiff_next_change(
 				diff, itr, &old, &new, &change) == 0) {
 
+			if (change == MNT_TABDIFF_PROPAGATION)
+				continue;	/* not supported by --poll */
 			if (!has_poll_action(change))
 				continue;
 			if (!poll_match(new ? new : old))
@@ -1183,14 +1254,10 @@ static int poll_table(struct libmnt_table *tb, const char *tabfile,
 				goto done;
 		}
 
-		/* swap tables */
-		tmp = tb;
-		tb = tb_new;
-		tb_new = tmp;
-
 		/* remove already printed lines to reduce memory usage */
 		scols_table_remove_lines(table);
-		mnt_reset_table(tb_new);
+		if (tb_new)
+			mnt_reset_table(tb_new);
 
 		if (count && (flags & FL_FIRSTONLY))
 			break;
@@ -1239,6 +1306,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputc('\n', out);
 	fputs(_(" -p, --poll[=<list>]    monitor changes in table of mounted filesystems\n"), out);
 	fputs(_(" -w, --timeout <num>    upper limit in milliseconds that --poll will block\n"), out);
+	fputs(_("     --coalesce <num>   merge --poll changes within <num> milliseconds\n"), out);
 	fputc('\n', out);
 
 	fputs(_(" -A, --all              disable all built-in filters, print all filesystems\n"), out);
@@ -1257,6 +1325,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -l, --list             use list format output\n"), out);
 	fputs(_(" -N, --task <tid>       use alternative namespace (/proc/<tid>/mountinfo file)\n"), out);
 	fputs(_(" -n, --noheadings       don't print column headings\n"), out);
+	fputs(_("     --ndjson           use newline-delimited JSON output format\n"), out);
 	fputs(_(" -O, --options <list>   limit the set of filesystems by mount options\n"), out);
 	fputs(_(" -o, --output <list>    the output columns to be shown\n"), out);
 	fputs(_("     --output-all       output all available columns\n"), out);
@@ -1299,7 +1368,7 @@ int main(int argc, char *argv[])
 	char **tabfiles = NULL;
 	int direction = MNT_ITER_FORWARD;
 	int verify = 0;
-	int c, rc = -1, timeout = -1;
+	int c, rc = -1, timeout = -1, interval = 0;
 	int ntabfiles = 0, tabtype = 0;
 	char *outarg = NULL;
 	size_t i;
@@ -1314,7 +1383,9 @@ int main(int argc, char *argv[])
 		FINDMNT_OPT_PSEUDO,
 		FINDMNT_OPT_REAL,
 		FINDMNT_OPT_VFS_ALL,
-		FINDMNT_OPT_SHADOWED
+		FINDMNT_OPT_SHADOWED,
+		FINDMNT_OPT_COALESCE,
+		FINDMNT_OPT_NDJSON
 	};
 
 	static const struct option longopts[] = {
@@ -1360,13 +1431,15 @@ int main(int argc, char *argv[])
 		{ "pseudo",	    no_argument,       NULL, FINDMNT_OPT_PSEUDO	 },
 		{ "vfs-all",	    no_argument,       NULL, FINDMNT_OPT_VFS_ALL },
 		{ "shadowed",       no_argument,       NULL, FINDMNT_OPT_SHADOWED },
+		{ "coalesce",       required_argument, NULL, FINDMNT_OPT_COALESCE },
+		{ "ndjson",         no_argument,       NULL, FINDMNT_OPT_NDJSON },
 		{ NULL, 0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
 		{ 'C', 'c'},			/* [no]canonicalize */
 		{ 'C', 'e' },			/* nocanonicalize, evaluate */
-		{ 'J', 'P', 'r','x' },		/* json,pairs,raw,verify */
+		{ 'J', 'P', 'r','x', FINDMNT_OPT_NDJSON },	/* json,pairs,raw,verify,ndjson */
 		{ 'M', 'T' },			/* mountpoint, target */
 		{ 'N','k','m','s' },		/* task,kernel,mtab,fstab */
 		{ 'P','l','r','x' },		/* pairs,list,raw,verify */
@@ -1519,6 +1592,12 @@ int main(int argc, char *argv[])
 		case 'w':
 			timeout = strtos32_or_err(optarg, _("invalid timeout argument"));
 			break;
+		case FINDMNT_OPT_COALESCE:
+			interval = strtos32_or_err(optarg, _("invalid coalesce argument"));
+			break;
+		case FINDMNT_OPT_NDJSON:
+			flags |= FL_JSON | FL_NDJSON;
+			break;
 		case 'x':
 			verify = 1;
 			break;
@@ -1639,6 +1718,7 @@ int main(int argc, char *argv[])
 			warn(_("failed to initialize libmount cache"));
 			goto leave;
 		}
+		mnt_cache_enable_cached_resolve(cache, TRUE);
 		mnt_table_set_cache(tb, cache);
 
 		if (tabtype != TABTYPE_KERNEL)
@@ -1665,6 +1745,15 @@ int main(int argc, char *argv[])
 	scols_table_enable_raw(table,        !!(flags & FL_RAW));
 	scols_table_enable_export(table,     !!(flags & FL_EXPORT));
 	scols_table_enable_json(table,       !!(flags & FL_JSON));
+	if (flags & FL_NDJSON) {
+		scols_table_enable_ndjson(table, 1);
+
+		/* print the lines as soon as they are complete; --submounts
+		 * --list looks for already added lines */
+		if (!(flags & FL_POLL)
+		    && !((flags & FL_SUBMOUNTS) && !(flags & FL_TREE)))
+			scols_table_enable_streaming(table, 1);
+	}
 	scols_table_enable_ascii(table,      !!(flags & FL_ASCII));
 	scols_table_enable_noheadings(table, !!(flags & FL_NOHEADINGS));
 
@@ -1718,7 +1807,8 @@ int main(int argc, char *argv[])
 	 */
 	if (flags & FL_POLL) {
 		/* poll mode (accept the first tabfile only) */
-		rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO, timeout, table, direction);
+		rc = poll_table(tb, tabfiles ? *tabfiles : _PATH_PROC_MOUNTINFO,
+				timeout, interval, table, direction);
 
 	} else if ((flags & FL_TREE) && !(flags & FL_SUBMOUNTS)) {
 		/* whole tree */
@@ -30,6 +30,7 @@ enum {
 	FL_EXPORT	= (1 << 24),
 	FL_TREE		= (1 << 25),
 	FL_JSON		= (1 << 26),
+	FL_NDJSON	= (1 << 27),
 };
 
 extern struct libmnt_cache *cache;
@@ -88,11 +88,14 @@ struct getopt_control {
 	struct option *long_options;	/* long options */
 	int long_options_length;	/* length of options array */
 	int long_options_nr;		/* number of used elements in array */
+	char *buf;			/* print_normalized() buffer */
+	size_t bufsz;			/* allocated size of buf */
 	unsigned int
 		compatible:1,		/* compatibility mode for 'difficult' programs */
 		quiet_errors:1,		/* print errors */
 		quiet_output:1,		/* print output */
-		quote:1;		/* quote output */
+		quote:1,		/* quote output */
+		print0:1;		/* NUL terminated output */
 };
 
 enum { REALLOC_INCREMENT = 8 };
@@ -101,34 +104,74 @@ enum { REALLOC_INCREMENT = 8 };
 static int (*getopt_long_fp) (int argc, char *const *argv, const char *optstr,
 			      const struct option * longopts, int *longindex);
 
+/*
+ * Prints an option name (with @prefix) or the "--" separator.
+ */
+static void print_token(const struct getopt_control *ctl,
+			const char *prefix, const char *str)
+{
+	if (ctl->print0) {
+		fputs(prefix, stdout);
+		fputs(str, stdout);
+		putchar('\0');
+	} else
+		printf(" %s%s", prefix, str);
+}
+
+/* Returns the size of @arg after print_normalized() quoting. */
+static size_t normalized_size(const struct getopt_control *ctl, const char *arg)
+{
+	size_t sz = 2;		/* opening and closing quote */
+
+	for (; *arg; arg++) {
+		if (ctl->shell == TCSH) {
+			if (*arg == '\\' || *arg == '\n') {
+				sz += 2;
+				continue;
+			}
+			if (*arg == '!' || isspace(*arg)) {
+				sz += 4;
+				continue;
+			}
+		}
+		sz += *arg == '\'' ? 4 : 1;
+	}
+	return sz;
+}
+
 /*
  * This function 'normalizes' a single argument: it puts single quotes
  * around it and escapes other special characters. If quote is false, it
- * just returns its argument.
+ * just prints its argument.
  *
  * Bash only needs special treatment for single quotes; tcsh also recognizes
- * exclamation marks within single quotes, and nukes whitespace. This
- * function returns a pointer to a buffer that is overwritten by each call.
+ * exclamation marks within single quotes, and nukes whitespace. The result
+ * is built in a buffer reused by all the calls.
  */
-static void print_normalized(const struct getopt_control *ctl, const char *arg)
+static void print_normalized(struct getopt_control *ctl, const char *arg)
 {
-	char *buf;
 	const char *argptr = arg;
 	char *bufptr;
+	size_t sz;
 
+	if (ctl->print0) {
+		fputs(arg, stdout);
+		putchar('\0');
+		return;
+	}
 	if (!ctl->quote) {
 		printf(" %s", arg);
 		return;
 	}
 
-	/*
-	 * Each character in arg may take up to four characters in the
-	 * result: For a quote we need a closing quote, a backslash, a quote
-	 * and an opening quote! We need also the global opening and closing
-	 * quote, and one extra character for '\0'.
-	 */
-	buf = xmalloc(strlen(arg) * 4 + 3);
-	bufptr = buf;
+	/* leading space and the quoted argument */
+	sz = normalized_size(ctl, arg) + 1;
+	if (sz > ctl->bufsz) {
+		ctl->bufsz = max(sz, ctl->bufsz * 2);
+		ctl->buf = xrealloc(ctl->buf, ctl->bufsz);
+	}
+	bufptr = ctl->buf;
+	*bufptr++ = ' ';
 
 	for (*bufptr++ = '\''; *argptr; argptr++) {
 		if (ctl->shell == TCSH) {
@@ -172,9 +215,7 @@ static void print_normalized(const struct getopt_control *ctl, const char *arg)
 	}
 
 	*bufptr++ = '\'';
-	*bufptr++ = '\0';
-	printf(" %s", buf);
-	free(buf);
+	fwrite(ctl->buf, 1, bufptr - ctl->buf, stdout);
 }
 
 /*
@@ -190,6 +231,9 @@ static int generate_output(struct getopt_control *ctl, char *argv[], int argc)
 	int opt;
 	int longindex;
 	const char *charptr;
+	char *optstr = ctl->optstr;
+	char **nonopts = NULL;
+	size_t i, nnonopts = 0;
 
 	if (ctl->quiet_errors)
 		/* No error reporting from getopt(3) */
@@ -197,17 +241,33 @@ static int generate_output(struct getopt_control *ctl, char *argv[], int argc)
 	/* Reset getopt(3) */
 	optind = 0;
 
+	/*
+	 * The default getopt(3) mode permutes argv[] to move the non-option
+	 * arguments behind the options, which is quadratic for long argument
+	 * lists with options between the parameters. Let getopt(3) return the
+	 * parameters in order and collect them here instead; the output is
+	 * the same.
+	 */
+	if (*optstr != '+' && *optstr != '-' && !getenv("POSIXLY_CORRECT")) {
+		optstr = strconcat("-", ctl->optstr);
+		if (!optstr)
+			err_oom();
+		nonopts = xcalloc(argc, sizeof(char *));
+	}
+
 	while ((opt =
 		(getopt_long_fp
-		 (argc, argv, ctl->optstr,
+		 (argc, argv, optstr,
 		  (const struct option *)ctl->long_options, &longindex)))
 	       != EOF) {
 		if (opt == '?' || opt == ':')
 			exit_code = GETOPT_EXIT_CODE;
+		else if (opt == NON_OPT && nonopts)
+			nonopts[nnonopts++] = optarg;
 		else if (!ctl->quiet_output) {
 			switch (opt) {
 			case LONG_OPT:
-				printf(" --%s", ctl->long_options[longindex].name);
+				print_token(ctl, "--", ctl->long_options[longindex].name);
 				if (ctl->long_options[longindex].has_arg)
 					print_normalized(ctl, optarg ? optarg : "");
 				break;
@@ -215,24 +275,36 @@ static int generate_output(struct getopt_control *ctl, char *argv[], int argc)
 				print_normalized(ctl, optarg ? optarg : "");
 				break;
 			default:
-				printf(" -%c", opt);
+			{
+				char name[3] = { '-', opt, '\0' };
+
+				print_token(ctl, "", name);
 				charptr = strchr(ctl->optstr, opt);
 				if (charptr != NULL && *++charptr == ':')
 					print_normalized(ctl, optarg ? optarg : "");
 			}
+			}
 		}
 	}
 	if (!ctl->quiet_output) {
-		printf(" --");
+		print_token(ctl, "", "--");
+		for (i = 0; i < nnonopts; i++)
+			print_normalized(ctl, nonopts[i]);
 		while (optind < argc)
 			print_normalized(ctl, argv[optind++]);
-		printf("\n");
+		if (!ctl->print0)
+			printf("\n");
+	}
+	if (nonopts) {
+		free(nonopts);
+		free(optstr);
 	}
 	for (longindex = 0; longindex < ctl->long_options_nr; longindex++)
 		free((char *)ctl->long_options[longindex].name);
 	free(ctl->long_options);
 	free(ctl->optstr);
 	free(ctl->name);
+	free(ctl->buf);
 	return exit_code;
 }
 
@@ -358,6 +430,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --shell <shell>           set quoting conventions to those of <shell>\n"), stdout);
 	fputs(_(" -T, --test                    test for getopt(1) version\n"), stdout);
 	fputs(_(" -u, --unquoted                do not quote the output\n"), stdout);
+	fputs(_(" -z, --print0                  terminate output items by NUL, do not quote\n"), stdout);
 	fputs(USAGE_SEPARATOR, stdout);
 	printf(USAGE_HELP_OPTIONS(31));
 	printf(USAGE_MAN_TAIL("getopt(1)"));
@@ -373,7 +446,7 @@ int main(int argc, char *argv[])
 	int opt;
 
 	/* Stop scanning as soon as a non-option argument is found! */
-	static const char *shortopts = "+ao:l:n:qQs:TuhV";
+	static const char *shortopts = "+ao:l:n:qQs:TuzhV";
 	static const struct option longopts[] = {
 		{"options", required_argument, NULL, 'o'},
 		{"longoptions", required_argument, NULL, 'l'},
@@ -382,6 +455,7 @@ int main(int argc, char *argv[])
 		{"shell", required_argument, NULL, 's'},
 		{"test", no_argument, NULL, 'T'},
 		{"unquoted", no_argument, NULL, 'u'},
+		{"print0", no_argument, NULL, 'z'},
 		{"help", no_argument, NULL, 'h'},
 		{"alternative", no_argument, NULL, 'a'},
 		{"name", required_argument, NULL, 'n'},
@@ -451,6 +525,9 @@ int main(int argc, char *argv[])
 		case 'u':
 			ctl.quote = 0;
 			break;
+		case 'z':
+			ctl.print0 = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -36,6 +36,15 @@
 #include <signal.h>		/* SIG*, sigaction */
 #include <getopt.h>		/* getopt_long() */
 #include <ctype.h>		/* tolower() */
+#include <sys/ioctl.h>		/* ioctl() */
+#ifdef HAVE_LINUX_FIEMAP_H
+# include <linux/fs.h>		/* FS_IOC_FIEMAP, FIDEDUPERANGE */
+# include <linux/fiemap.h>
+#endif
+#include <dirent.h>		/* opendir() */
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
 
 #include "nls.h"
 #include "c.h"
@@ -43,6 +52,10 @@
 #include "strutils.h"
 #include "monotonic.h"
 #include "optutils.h"
+#include "sha1.h"
+#include "fileutils.h"
+#include "closestream.h"
+#include "all-io.h"
 
 #include <regex.h>		/* regcomp(), regsearch() */
 
@@ -56,6 +69,8 @@ static int quiet;		/* don't print anything */
  * struct file - Information about a file
  * @st:       The stat buffer associated with the file
  * @next:     Next file with the same size
+ * @digest:   The content digests, allocated on the first comparison
+ * @deduped:  The file has been deduplicated (in --dedupe mode)
  * @basename: The offset off the basename in the filename
  * @path:     The path of the file
  *
@@ -64,6 +79,8 @@ static int quiet;		/* don't print anything */
 struct file {
 	struct stat st;
 	struct file *next;
+	struct file_digest *digest;
+	unsigned int deduped:1;
 	struct link {
 		struct link *next;
 		int basename;
@@ -95,13 +112,40 @@ enum log_level {
 # define DEF_SCAN_BUFSIZ 8192
 #endif
 
+/* the size of the file head and tail used for the sample digest */
+#define DIGEST_SAMPLE_SIZE 4096
+
+/**
+ * struct file_digest - Content digests of a file
+ * @sample: SHA1 of the first and the last DIGEST_SAMPLE_SIZE bytes
+ * @full:   SHA1 of the whole file
+ * @has_sample: @sample is valid
+ * @has_full:   @full is valid
+ * @failed: The file cannot be read, don't try it again
+ * @cached: The digests are from the digest cache file
+ *
+ * The digests are calculated at most once per file; the different digests
+ * mean different contents, the same digests are verified by
+ * file_contents_equal().
+ */
+struct file_digest {
+	unsigned char sample[UL_SHA1LENGTH];
+	unsigned char full[UL_SHA1LENGTH];
+	unsigned int has_sample:1,
+		     has_full:1,
+		     failed:1,
+		     cached:1;
+};
+
 /**
  * struct statistic - Statistics about the file
  * @started: Whether we are post command-line processing
  * @files: The number of files worked on
  * @linked: The number of files replaced by a hardlink to a master
+ * @deduped: The number of files deduplicated with a master
  * @xattr_comparisons: The number of extended attribute comparisons
  * @comparisons: The number of comparisons
+ * @cached: The number of files with the digests from the cache file
  * @saved: The (exaggerated) amount of space saved
  * @start_time: The time we started at
  */
@@ -109,8 +153,10 @@ static struct statistics {
 	int started;
 	size_t files;
 	size_t linked;
+	size_t deduped;
 	size_t xattr_comparisons;
 	size_t comparisons;
+	size_t cached;
 	double saved;
 	struct timeval start_time;
 } stats;
@@ -137,6 +183,10 @@ struct hdl_regex {
  * @keep_oldest: Choose the file with oldest timestamp as master (default = FALSE)
  * @dry_run: Specifies whether hardlink should not link files (default = FALSE)
  * @min_size: Minimum size of files to consider. (default = 1 byte)
+ * @bufsiz: The size of the read buffers
+ * @nworkers: The number of threads to find and hash files (default = 0, serial)
+ * @cache_file: The digest cache file (default = NULL, no cache)
+ * @dedupe: Share the extents of the files rather than link them (default = FALSE)
  */
 static struct options {
 	struct hdl_regex *include;
@@ -152,8 +202,11 @@ static struct options {
 	unsigned int minimise:1;
 	unsigned int keep_oldest:1;
 	unsigned int dry_run:1;
+	unsigned int dedupe:1;
 	uintmax_t min_size;
 	size_t bufsiz;
+	unsigned int nworkers;
+	const char *cache_file;
 } opts = {
 	/* default setting */
 	.respect_mode = TRUE,
@@ -321,6 +374,9 @@ static void print_stats(void)
 	     opts.dry_run ? _("dry-run") : _("real"));
 	jlog(JLOG_SUMMARY, "%-15s %zu", _("Files:"), stats.files);
 	jlog(JLOG_SUMMARY, _("%-15s %zu files"), _("Linked:"), stats.linked);
+	if (opts.dedupe)
+		jlog(JLOG_SUMMARY, _("%-15s %zu files"), _("Deduped:"),
+		     stats.deduped);
 
 #ifdef HAVE_SYS_XATTR_H
 	jlog(JLOG_SUMMARY, _("%-15s %zu xattrs"), _("Compared:"),
@@ -328,6 +384,9 @@ static void print_stats(void)
 #endif
 	jlog(JLOG_SUMMARY, _("%-15s %zu files"), _("Compared:"),
 	     stats.comparisons);
+	if (opts.cache_file)
+		jlog(JLOG_SUMMARY, _("%-15s %zu files"), _("Cached:"),
+		     stats.cached);
 
 	ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
 				   SIZE_SUFFIX_SPACE |
@@ -562,10 +621,9 @@ static int file_xattrs_equal(const struct file *a, const struct file *b)
  */
 static int file_contents_equal(const struct file *a, const struct file *b)
 {
-	FILE *fa = NULL;
-	FILE *fb = NULL;
+	int fa = -1, fb = -1;
 	int cmp = 0;		/* zero => equal */
-	off_t off = 0;		/* current offset */
+	const char *errpath;
 
 	assert(a->links != NULL);
 	assert(b->links != NULL);
@@ -575,29 +633,34 @@ static int file_contents_equal(const struct file *a, const struct file *b)
 
 	stats.comparisons++;
 
-	if ((fa = fopen(a->links->path, "rb")) == NULL)
-		goto err;
-	if ((fb = fopen(b->links->path, "rb")) == NULL)
-		goto err;
+	if ((fa = open(a->links->path, O_RDONLY | O_CLOEXEC)) < 0) {
+		errpath = a->links->path;
+		goto err_open;
+	}
+	if ((fb = open(b->links->path, O_RDONLY | O_CLOEXEC)) < 0) {
+		errpath = b->links->path;
+		goto err_open;
+	}
 
 #if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
-	ignore_result( posix_fadvise(fileno(fa), 0, 0, POSIX_FADV_SEQUENTIAL) );
-	ignore_result( posix_fadvise(fileno(fb), 0, 0, POSIX_FADV_SEQUENTIAL) );
+	ignore_result( posix_fadvise(fa, 0, 0, POSIX_FADV_SEQUENTIAL) );
+	ignore_result( posix_fadvise(fb, 0, 0, POSIX_FADV_SEQUENTIAL) );
 #endif
 
 	while (!handle_interrupt() && cmp == 0) {
-		size_t ca;
-		size_t cb;
+		ssize_t ca;
+		ssize_t cb;
 
-		ca = fread(buf_a, 1, opts.bufsiz, fa);
-		if (ca < sizeof(buf_a) && ferror(fa))
-			goto err;
-
-		cb = fread(buf_b, 1, opts.bufsiz, fb);
-		if (cb < sizeof(buf_b) && ferror(fb))
-			goto err;
-
-		off += ca;
+		ca = read_all(fa, buf_a, opts.bufsiz);
+		if (ca < 0) {
+			errpath = a->links->path;
+			goto err_read;
+		}
+		cb = read_all(fb, buf_b, opts.bufsiz);
+		if (cb < 0) {
+			errpath = b->links->path;
+			goto err_read;
+		}
 
 		if ((ca != cb || ca == 0)) {
 			cmp = CMP(ca, cb);
@@ -606,31 +669,515 @@ static int file_contents_equal(const struct file *a, const struct file *b)
 		cmp = memcmp(buf_a, buf_b, ca);
 	}
  out:
-	if (fa != NULL)
-		fclose(fa);
-	if (fb != NULL)
-		fclose(fb);
+	if (fa >= 0)
+		close(fa);
+	if (fb >= 0)
+		close(fb);
 	return !handle_interrupt() && cmp == 0;
- err:
-	if (fa == NULL || fb == NULL)
-		warn(_("cannot open %s"), fa ? b->links->path : a->links->path);
-	else
-		warn(_("cannot read %s"),
-		     ferror(fa) ? a->links->path : b->links->path);
+ err_open:
+	warn(_("cannot open %s"), errpath);
+	cmp = 1;
+	goto out;
+ err_read:
+	warn(_("cannot read %s"), errpath);
 	cmp = 1;
 	goto out;
 }
 
+#ifdef HAVE_LINUX_FIEMAP_H
+
+/* the extents which may have different data even if the mapping is the same */
+#define FIEMAP_EXTENT_UNSAFE	(FIEMAP_EXTENT_UNKNOWN | \
+				 FIEMAP_EXTENT_DELALLOC | \
+				 FIEMAP_EXTENT_ENCODED | \
+				 FIEMAP_EXTENT_DATA_ENCRYPTED | \
+				 FIEMAP_EXTENT_NOT_ALIGNED | \
+				 FIEMAP_EXTENT_DATA_INLINE | \
+				 FIEMAP_EXTENT_DATA_TAIL | \
+				 FIEMAP_EXTENT_UNWRITTEN)
+
+#define FIEMAP_NEXTENTS		32
+
 /**
- * file_may_link_to - Check whether a file may replace another one
+ * fds_extents_shared - Check whether two files share all extents
+ * @fa: The first file descriptor
+ * @fb: The second file descriptor
+ *
+ * Returns: %TRUE if the files are mapped to the same physical extents (for
+ * example reflinked or deduplicated files); the data are the same in this
+ * case and there is no need to read them.
+ */
+static int fds_extents_shared(int fa, int fb)
+{
+	char bufa[sizeof(struct fiemap) + FIEMAP_NEXTENTS * sizeof(struct fiemap_extent)];
+	char bufb[sizeof(bufa)];
+	struct fiemap *ma = (struct fiemap *) bufa;
+	struct fiemap *mb = (struct fiemap *) bufb;
+	uint64_t start = 0;
+
+	for (;;) {
+		size_t i, n;
+
+		memset(ma, 0, sizeof(*ma));
+		ma->fm_start = start;
+		ma->fm_length = ~0ULL;
+		ma->fm_flags = FIEMAP_FLAG_SYNC;
+		ma->fm_extent_count = FIEMAP_NEXTENTS;
+		memcpy(mb, ma, sizeof(*mb));
+
+		if (ioctl(fa, FS_IOC_FIEMAP, (unsigned long) ma) < 0
+		    || ioctl(fb, FS_IOC_FIEMAP, (unsigned long) mb) < 0)
+			return FALSE;
+
+		n = ma->fm_mapped_extents;
+		if (n == 0 || n != mb->fm_mapped_extents)
+			return FALSE;
+
+		for (i = 0; i < n; i++) {
+			struct fiemap_extent *ea = &ma->fm_extents[i];
+			struct fiemap_extent *eb = &mb->fm_extents[i];
+
+			if (ea->fe_logical != eb->fe_logical
+			    || ea->fe_physical != eb->fe_physical
+			    || ea->fe_length != eb->fe_length
+			    || ea->fe_flags != eb->fe_flags
+			    || !(ea->fe_flags & FIEMAP_EXTENT_SHARED)
+			    || (ea->fe_flags & FIEMAP_EXTENT_UNSAFE))
+				return FALSE;
+			if (ea->fe_flags & FIEMAP_EXTENT_LAST)
+				return TRUE;
+		}
+		start = ma->fm_extents[n - 1].fe_logical
+		      + ma->fm_extents[n - 1].fe_length;
+	}
+}
+
+/**
+ * file_extents_shared - Check whether two files share all extents
  * @a: The first file
  * @b: The second file
  *
- * Check whether the two fies are considered equal and can be linked
- * together. If the two files are identical, the result will be FALSE,
- * as replacing a link with an identical one is stupid.
+ * See fds_extents_shared().
+ */
+static int file_extents_shared(const struct file *a, const struct file *b)
+{
+	int fa, fb, rc = FALSE;
+
+	fa = open(a->links->path, O_RDONLY | O_CLOEXEC);
+	if (fa < 0)
+		return FALSE;
+	fb = open(b->links->path, O_RDONLY | O_CLOEXEC);
+	if (fb >= 0) {
+		rc = fds_extents_shared(fa, fb);
+		close(fb);
+	}
+	close(fa);
+
+	if (rc)
+		jlog(JLOG_VERBOSE1, _("Skipped comparison of %s to %s (shared extents)"),
+		     a->links->path, b->links->path);
+	return rc;
+}
+#else /* !HAVE_LINUX_FIEMAP_H */
+static int file_extents_shared(const struct file *a __attribute__((__unused__)),
+			       const struct file *b __attribute__((__unused__)))
+{
+	return FALSE;
+}
+#endif /* HAVE_LINUX_FIEMAP_H */
+
+/*
+ * The digest cache file
+ *
+ * Every line describes one file by "dev ino size mtime ctime sample full" (the
+ * times as seconds.nanoseconds, the digests in hex, the full digest may be
+ * "-"). The digests are used only if the stat information is unchanged.
+ */
+#define DIGEST_CACHE_HEADER	"# hardlink digest cache v1"
+
+/**
+ * struct cache_entry - Digests of a file from the previous run
+ * @dev:    The device of the file
+ * @ino:    The inode of the file
+ * @size:   The size of the file
+ * @mtime:  The time of the last modification
+ * @ctime:  The time of the last status change
+ * @digest: The digests
+ */
+struct cache_entry {
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	struct timespec ctime;
+	struct file_digest digest;
+};
+
+static void *digest_cache;
+
+static void stat_get_times(const struct stat *st,
+			   struct timespec *mtime, struct timespec *ctime)
+{
+	mtime->tv_sec = st->st_mtime;
+	ctime->tv_sec = st->st_ctime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+	mtime->tv_nsec = st->st_mtim.tv_nsec;
+	ctime->tv_nsec = st->st_ctim.tv_nsec;
+#else
+	mtime->tv_nsec = 0;
+	ctime->tv_nsec = 0;
+#endif
+}
+
+static int compare_cache_entries(const void *_a, const void *_b)
+{
+	const struct cache_entry *a = _a;
+	const struct cache_entry *b = _b;
+	int diff = 0;
+
+	if (diff == 0)
+		diff = CMP(a->dev, b->dev);
+	if (diff == 0)
+		diff = CMP(a->ino, b->ino);
+
+	return diff;
+}
+
+/* returns the cache entry of the file or NULL if there is no valid entry */
+static struct cache_entry *cache_lookup(const struct file *f)
+{
+	struct cache_entry key, *ce, **node;
+	struct timespec mtime, ctime;
+
+	if (!digest_cache)
+		return NULL;
+
+	key.dev = f->st.st_dev;
+	key.ino = f->st.st_ino;
+	node = tfind(&key, &digest_cache, compare_cache_entries);
+	if (!node)
+		return NULL;
+
+	ce = *node;
+	stat_get_times(&f->st, &mtime, &ctime);
+
+	if (ce->size != f->st.st_size
+	    || ce->mtime.tv_sec != mtime.tv_sec
+	    || ce->mtime.tv_nsec != mtime.tv_nsec
+	    || ce->ctime.tv_sec != ctime.tv_sec
+	    || ce->ctime.tv_nsec != ctime.tv_nsec)
+		return NULL;
+	return ce;
+}
+
+static int hex_to_digest(const char *str, unsigned char *digest)
+{
+	size_t i;
+
+	if (strlen(str) != UL_SHA1LENGTH * 2)
+		return -1;
+
+	for (i = 0; i < UL_SHA1LENGTH; i++) {
+		unsigned int x;
+
+		if (!isxdigit(str[i * 2]) || !isxdigit(str[i * 2 + 1])
+		    || sscanf(str + i * 2, "%2x", &x) != 1)
+			return -1;
+		digest[i] = x;
+	}
+	return 0;
+}
+
+static void fputs_digest(const unsigned char *digest, FILE *f)
+{
+	size_t i;
+
+	for (i = 0; i < UL_SHA1LENGTH; i++)
+		fprintf(f, "%02x", digest[i]);
+}
+
+/**
+ * cache_load - Read the digest cache file
+ * @path: The cache file
+ *
+ * A missing file is not an error, the cache is created by cache_save().
+ * Invalid lines are ignored.
+ */
+static void cache_load(const char *path)
+{
+	char *line = NULL;
+	size_t sz = 0;
+	FILE *f;
+
+	f = fopen(path, "r" UL_CLOEXECSTR);
+	if (!f) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), path);
+		return;
+	}
+
+	if (getline(&line, &sz, f) < 0
+	    || strncmp(line, DIGEST_CACHE_HEADER "\n", sizeof(DIGEST_CACHE_HEADER)) != 0) {
+		warnx(_("%s: unsupported digest cache format, ignoring"), path);
+		goto done;
+	}
+
+	while (getline(&line, &sz, f) >= 0) {
+		struct cache_entry *ce, **node;
+		uintmax_t dev, ino;
+		intmax_t size, msec, csec;
+		long mnsec, cnsec;
+		char sample[UL_SHA1LENGTH * 2 + 1], full[UL_SHA1LENGTH * 2 + 1];
+
+		if (sscanf(line, "%ju %ju %jd %jd.%ld %jd.%ld %40s %40s",
+			   &dev, &ino, &size, &msec, &mnsec, &csec, &cnsec,
+			   sample, full) != 9)
+			continue;
+
+		ce = xcalloc(1, sizeof(*ce));
+		ce->dev = dev;
+		ce->ino = ino;
+		ce->size = size;
+		ce->mtime.tv_sec = msec;
+		ce->mtime.tv_nsec = mnsec;
+		ce->ctime.tv_sec = csec;
+		ce->ctime.tv_nsec = cnsec;
+
+		if (hex_to_digest(sample, ce->digest.sample) != 0) {
+			free(ce);
+			continue;
+		}
+		ce->digest.has_sample = 1;
+		if (hex_to_digest(full, ce->digest.full) == 0)
+			ce->digest.has_full = 1;
+
+		node = tsearch(ce, &digest_cache, compare_cache_entries);
+		if (!node)
+			err(EXIT_FAILURE, _("cannot allocate memory"));
+		if (*node != ce)
+			free(ce);	/* duplicate */
+	}
+done:
+	free(line);
+	fclose(f);
+}
+
+static FILE *cache_out;
+
+static void cache_save_file(const void *nodep, const VISIT which,
+			    const int depth __attribute__((__unused__)))
+{
+	const struct file *f = *(struct file **)nodep;
+	const struct file_digest *d = f->digest;
+	struct timespec mtime, ctime;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	if (d && d->cached)
+		stats.cached++;
+	if (!d || d->failed || !d->has_sample) {
+		struct cache_entry *ce = cache_lookup(f);
+
+		/* not compared in this run, keep the old digests */
+		if (!ce)
+			return;
+		d = &ce->digest;
+	}
+
+	stat_get_times(&f->st, &mtime, &ctime);
+	fprintf(cache_out, "%ju %ju %jd %jd.%09ld %jd.%09ld ",
+		(uintmax_t) f->st.st_dev, (uintmax_t) f->st.st_ino,
+		(intmax_t) f->st.st_size,
+		(intmax_t) mtime.tv_sec, (long) mtime.tv_nsec,
+		(intmax_t) ctime.tv_sec, (long) ctime.tv_nsec);
+	fputs_digest(d->sample, cache_out);
+	fputc(' ', cache_out);
+	if (d->has_full)
+		fputs_digest(d->full, cache_out);
+	else
+		fputc('-', cache_out);
+	fputc('\n', cache_out);
+}
+
+/**
+ * cache_save - Write the digests of all the files to the digest cache file
+ * @path: The cache file
+ *
+ * The file is replaced atomically; the entries of the files which have not
+ * been found in this run are dropped.
  */
-static int file_may_link_to(const struct file *a, const struct file *b)
+static void cache_save(const char *path)
+{
+	char *tmp;
+	int fd;
+
+	xasprintf(&tmp, "%s.XXXXXX", path);
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0) {
+		warn(_("cannot create %s"), tmp);
+		goto done;
+	}
+	cache_out = fdopen(fd, "w");
+	if (!cache_out) {
+		warn(_("cannot open %s"), tmp);
+		close(fd);
+		unlink(tmp);
+		goto done;
+	}
+
+	fputs(DIGEST_CACHE_HEADER "\n", cache_out);
+	twalk(files_by_ino, cache_save_file);
+
+	if (close_stream(cache_out) != 0) {
+		warn(_("write failed: %s"), tmp);
+		unlink(tmp);
+	} else if (rename(tmp, path) != 0) {
+		warn(_("cannot rename %s to %s"), tmp, path);
+		unlink(tmp);
+	}
+	cache_out = NULL;
+done:
+	free(tmp);
+}
+
+/*
+ * Adds @len bytes from @off of the file to the digest; returns 0 on success
+ * or -1 on read error (or unexpected end of the file).
+ */
+static int digest_file_range(int fd, off_t off, off_t len, UL_SHA1_CTX *ctx,
+			     char *buf)
+{
+	while (len > 0) {
+		size_t sz = len < (off_t) opts.bufsiz ? (size_t) len : opts.bufsiz;
+		ssize_t n;
+
+		if (handle_interrupt())
+			return -1;
+
+		n = pread(fd, buf, sz, off);
+		if (n < 0 && (errno == EINTR || errno == EAGAIN))
+			continue;
+		if (n <= 0)
+			return -1;
+
+		ul_SHA1Update(ctx, (unsigned char *) buf, n);
+		off += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/**
+ * file_update_digest - Calculate the file digest if not yet available
+ * @f: The file
+ * @full: Calculate the digest of the whole file, or the sample digest
+ * @buf: The read buffer (opts.bufsiz bytes)
+ *
+ * Returns: 0 on success, -1 if the file cannot be read.
+ */
+static int file_update_digest(struct file *f, int full, char *buf)
+{
+	struct file_digest *d;
+	off_t size = f->st.st_size;
+	UL_SHA1_CTX ctx;
+	int fd, rc;
+
+	if (!f->digest) {
+		struct cache_entry *ce = cache_lookup(f);
+
+		f->digest = xcalloc(1, sizeof(struct file_digest));
+		if (ce) {
+			*f->digest = ce->digest;
+			f->digest->cached = 1;
+		}
+	}
+	d = f->digest;
+
+	if (d->failed)
+		return -1;
+	if (full ? d->has_full : d->has_sample)
+		return 0;
+
+	jlog(JLOG_VERBOSE2, _("Hashing %s (%s)"), f->links->path,
+	     full ? _("content") : _("sample"));
+
+	fd = open(f->links->path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		warn(_("cannot open %s"), f->links->path);
+		d->failed = 1;
+		return -1;
+	}
+
+	ul_SHA1Init(&ctx);
+	if (full) {
+#if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
+		ignore_result( posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL) );
+#endif
+		rc = digest_file_range(fd, 0, size, &ctx, buf);
+	} else if (size <= 2 * DIGEST_SAMPLE_SIZE)
+		rc = digest_file_range(fd, 0, size, &ctx, buf);
+	else {
+		rc = digest_file_range(fd, 0, DIGEST_SAMPLE_SIZE, &ctx, buf);
+		if (!rc)
+			rc = digest_file_range(fd, size - DIGEST_SAMPLE_SIZE,
+					       DIGEST_SAMPLE_SIZE, &ctx, buf);
+	}
+	close(fd);
+
+	if (rc) {
+		if (!handle_interrupt())
+			warn(_("cannot read %s"), f->links->path);
+		d->failed = 1;
+		return -1;
+	}
+
+	if (full) {
+		ul_SHA1Final(d->full, &ctx);
+		d->has_full = 1;
+	} else {
+		ul_SHA1Final(d->sample, &ctx);
+		d->has_sample = 1;
+
+		/* the sample is the whole file */
+		if (size <= 2 * DIGEST_SAMPLE_SIZE) {
+			memcpy(d->full, d->sample, sizeof(d->full));
+			d->has_full = 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * file_digests_equal - Compare digests of two files
+ * @a: The first file
+ * @b: The second file
+ * @full: Compare the full content digests, or the sample digests
+ *
+ * Every file is read at most once for each digest, the digests are kept for
+ * the next comparisons with the other files of the same size.
+ *
+ * Returns: %TRUE if the files may be equal.
+ */
+static int file_digests_equal(struct file *a, struct file *b, int full)
+{
+	if (file_update_digest(a, full, buf_a) != 0
+	    || file_update_digest(b, full, buf_a) != 0)
+		return FALSE;
+	if (full)
+		return memcmp(a->digest->full, b->digest->full, UL_SHA1LENGTH) == 0;
+	return memcmp(a->digest->sample, b->digest->sample, UL_SHA1LENGTH) == 0;
+}
+
+/**
+ * file_attrs_may_link - Check whether the file attributes allow linking
+ * @a: The first file
+ * @b: The second file
+ *
+ * Compare the stat information and names of the files, nothing is read
+ * from the filesystem.
+ */
+static int file_attrs_may_link(const struct file *a, const struct file *b)
 {
 	return (a->st.st_size != 0 &&
 		a->st.st_size == b->st.st_size &&
@@ -643,9 +1190,27 @@ static int file_may_link_to(const struct file *a, const struct file *b)
 		(!opts.respect_time || a->st.st_mtime == b->st.st_mtime) &&
 		(!opts.respect_name
 		 || strcmp(a->links->path + a->links->basename,
-			   b->links->path + b->links->basename) == 0) &&
+			   b->links->path + b->links->basename) == 0));
+}
+
+/**
+ * file_may_link_to - Check whether a file may replace another one
+ * @a: The first file
+ * @b: The second file
+ *
+ * Check whether the two fies are considered equal and can be linked
+ * together. If the two files are identical, the result will be FALSE,
+ * as replacing a link with an identical one is stupid. The contents are
+ * compared only if the digests are the same and the files do not share all
+ * the extents.
+ */
+static int file_may_link_to(struct file *a, struct file *b)
+{
+	return (file_attrs_may_link(a, b) &&
 		(!opts.respect_xattrs || file_xattrs_equal(a, b)) &&
-		file_contents_equal(a, b));
+		file_digests_equal(a, b, 0) &&
+		(file_extents_shared(a, b) ||
+		 (file_digests_equal(a, b, 1) && file_contents_equal(a, b))));
 }
 
 /**
@@ -750,6 +1315,99 @@ static int file_link(struct file *a, struct file *b)
 	return TRUE;
 }
 
+#if defined(HAVE_LINUX_FIEMAP_H) && defined(FIDEDUPERANGE)
+
+/* the kernel may limit the length of one request, see FIDEDUPERANGE */
+#define DEDUPE_CHUNKSIZ		(16 * 1024 * 1024)
+
+/**
+ * file_dedupe - Share the extents of b with a
+ * @a: The first file
+ * @b: The second file
+ *
+ * Deduplicate the data of the files by FIDEDUPERANGE; unlike file_link(),
+ * both files are kept with their own inode and attributes. The kernel
+ * compares the data again, so the files are never corrupted.
+ *
+ * Returns: %TRUE if the files share all extents now.
+ */
+static int file_dedupe(struct file *a, struct file *b)
+{
+	struct file_dedupe_range *range;
+	off_t off = 0, size = a->st.st_size;
+	int fa, fb, rc = FALSE;
+	char *ssz;
+
+	fa = open(a->links->path, O_RDONLY | O_CLOEXEC);
+	if (fa < 0) {
+		warn(_("cannot open %s"), a->links->path);
+		return FALSE;
+	}
+	fb = open(b->links->path, O_RDONLY | O_CLOEXEC);
+	if (fb < 0) {
+		warn(_("cannot open %s"), b->links->path);
+		close(fa);
+		return FALSE;
+	}
+
+	if (fds_extents_shared(fa, fb)) {
+		rc = TRUE;		/* already deduplicated */
+		goto done;
+	}
+
+	ssz = size_to_human_string(SIZE_SUFFIX_3LETTER |
+				   SIZE_SUFFIX_SPACE |
+				   SIZE_DECIMAL_2DIGITS, size);
+	jlog(JLOG_INFO, _("%sDeduplicating %s and %s (-%s)"),
+	     opts.dry_run ? _("[DryRun] ") : "", a->links->path, b->links->path,
+	     ssz);
+	free(ssz);
+
+	range = xcalloc(1, sizeof(*range) + sizeof(struct file_dedupe_range_info));
+
+	while (!opts.dry_run && off < size && !handle_interrupt()) {
+		struct file_dedupe_range_info *info = &range->info[0];
+
+		range->src_offset = off;
+		range->src_length = min(size - off, (off_t) DEDUPE_CHUNKSIZ);
+		range->dest_count = 1;
+		info->dest_fd = fb;
+		info->dest_offset = off;
+
+		if (ioctl(fa, FIDEDUPERANGE, range) < 0) {
+			warn(_("cannot deduplicate %s and %s"),
+			     a->links->path, b->links->path);
+			break;
+		}
+		if (info->status == FILE_DEDUPE_RANGE_DIFFERS) {
+			warnx(_("cannot deduplicate %s and %s: data differ"),
+			      a->links->path, b->links->path);
+			break;
+		}
+		if (info->status < 0) {
+			errno = -info->status;
+			warn(_("cannot deduplicate %s and %s"),
+			     a->links->path, b->links->path);
+			break;
+		}
+		if (info->bytes_deduped == 0)
+			break;
+		off += info->bytes_deduped;
+	}
+	free(range);
+
+	if (opts.dry_run || off >= size) {
+		stats.deduped++;
+		stats.saved += size;
+		rc = TRUE;
+	}
+done:
+	close(fa);
+	close(fb);
+	return rc;
+}
+#endif /* HAVE_LINUX_FIEMAP_H && FIDEDUPERANGE */
+
 /**
  * inserter - Callback function for nftw()
  * @fpath: The path of the file being visited
@@ -760,12 +1418,11 @@ static int file_link(struct file *a, struct file *b)
  * Called by nftw() for the files. See the manual page for nftw() for
  * further information.
  */
+static void insert_file(const char *fpath, const struct stat *sb, int base);
+
 static int inserter(const char *fpath, const struct stat *sb,
 		    int typeflag, struct FTW *ftwbuf)
 {
-	struct file *fil;
-	struct file **node;
-	size_t pathlen;
 	int included;
 	int excluded;
 
@@ -783,12 +1440,28 @@ static int inserter(const char *fpath, const struct stat *sb,
 	    (!opts.exclude && opts.include && !included))
 		return 0;
 
+	insert_file(fpath, sb, ftwbuf->base);
+	return 0;
+}
+
+/**
+ * insert_file - Add a regular file to the trees
+ * @fpath: The path of the file
+ * @sb:    The stat information of the file
+ * @base:  The offset of the basename in @fpath
+ */
+static void insert_file(const char *fpath, const struct stat *sb, int base)
+{
+	struct file *fil;
+	struct file **node;
+	size_t pathlen;
+
 	stats.files++;
 
 	if ((uintmax_t) sb->st_size < opts.min_size) {
 		jlog(JLOG_VERBOSE1,
 		     _("Skipped %s (smaller than configured size)"), fpath);
-		return 0;
+		return;
 	}
 
 	jlog(JLOG_VERBOSE2, _("Visiting %s (file %zu)"), fpath, stats.files);
@@ -799,7 +1472,7 @@ static int inserter(const char *fpath, const struct stat *sb,
 	fil->links = xcalloc(1, sizeof(struct link) + pathlen);
 
 	fil->st = *sb;
-	fil->links->basename = ftwbuf->base;
+	fil->links->basename = base;
 	fil->links->next = NULL;
 
 	memcpy(fil->links->path, fpath, pathlen);
@@ -846,13 +1519,360 @@ static int inserter(const char *fpath, const struct stat *sb,
 		}
 	}
 
-	return 0;
+	return;
 
  fail:
 	warn(_("cannot continue"));	/* probably ENOMEM */
-	return 0;
+}
+
+#ifdef HAVE_PTHREAD_H
+/**
+ * struct walk_dir - A directory waiting for a worker
+ * @next: The next directory in the stack
+ * @path: The path of the directory
+ */
+struct walk_dir {
+	struct walk_dir *next;
+#if __STDC_VERSION__ >= 199901L
+	char path[];
+#elif __GNUC__
+	char path[0];
+#else
+	char path[1];
+#endif
+};
+
+/**
+ * struct hdl_workers - State shared by the worker threads
+ * @lock:   Protects this struct, the trees and the statistics
+ * @cond:   Signals new directories and the end of the walk
+ * @dirs:   The stack of directories to read
+ * @nbusy:  The number of workers reading a directory
+ * @interrupted: SIGINT or SIGTERM has been received
+ * @files:  The files to hash
+ * @nfiles: The number of the files
+ * @next:   The next file to hash
+ * @full:   Calculate the full digests rather than the sample digests
+ */
+static struct hdl_workers {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	struct walk_dir *dirs;
+	size_t nbusy;
+	unsigned int interrupted:1;
+
+	struct file **files;
+	size_t nfiles;
+	size_t next;
+	unsigned int full:1;
+} workers = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER
+};
+
+/* the caller is expected to hold workers.lock */
+static int workers_interrupted(void)
+{
+	if (!workers.interrupted && handle_interrupt())
+		workers.interrupted = 1;
+	return workers.interrupted;
+}
+
+static void push_dir(const char *path)
+{
+	size_t len = strlen(path) + 1;
+	struct walk_dir *d = xmalloc(sizeof(*d) + len);
+
+	memcpy(d->path, path, len);
+
+	pthread_mutex_lock(&workers.lock);
+	d->next = workers.dirs;
+	workers.dirs = d;
+	pthread_cond_signal(&workers.cond);
+	pthread_mutex_unlock(&workers.lock);
+}
+
+/**
+ * walk_file - Filter and insert a file found by the workers
+ * @fpath: The path of the file
+ * @sb:    The stat information of the file
+ * @base:  The offset of the basename in @fpath
+ */
+static void walk_file(const char *fpath, const struct stat *sb, int base)
+{
+	int included = match_any_regex(opts.include, fpath);
+	int excluded = match_any_regex(opts.exclude, fpath);
+
+	if ((opts.exclude && excluded && !included) ||
+	    (!opts.exclude && opts.include && !included))
+		return;
+
+	pthread_mutex_lock(&workers.lock);
+	insert_file(fpath, sb, base);
+	pthread_mutex_unlock(&workers.lock);
+}
+
+/**
+ * walk_dir - Read a directory
+ * @path: The path of the directory
+ *
+ * Insert the regular files and push the subdirectories to the stack. The
+ * symbolic links are not followed, like nftw(FTW_PHYS) in the serial mode.
+ */
+static void walk_dir(const char *path)
+{
+	size_t len = strlen(path);
+	struct dirent *de;
+	char *fpath;
+	DIR *dir;
+
+	dir = opendir(path);
+	if (!dir) {
+		warn(_("cannot read %s"), path);
+		return;
+	}
+
+	while (len > 1 && path[len - 1] == '/')
+		len--;
+
+	while ((de = readdir(dir))) {
+		struct stat st;
+
+		if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (de->d_type != DT_UNKNOWN && de->d_type != DT_DIR
+		    && de->d_type != DT_REG)
+			continue;
+#endif
+		xasprintf(&fpath, "%.*s/%s", (int) len, path, de->d_name);
+
+		if (fstatat(dirfd(dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+			warn(_("cannot read %s"), fpath);
+		else if (S_ISDIR(st.st_mode))
+			push_dir(fpath);
+		else if (S_ISREG(st.st_mode))
+			walk_file(fpath, &st, len + 1);
+		free(fpath);
+	}
+	closedir(dir);
+}
+
+static void *walk_worker(void *data __attribute__((__unused__)))
+{
+	pthread_mutex_lock(&workers.lock);
+	for (;;) {
+		struct walk_dir *d;
+
+		while (!workers.dirs && workers.nbusy && !workers.interrupted)
+			pthread_cond_wait(&workers.cond, &workers.lock);
+
+		if (!workers.dirs || workers_interrupted())
+			break;
+
+		d = workers.dirs;
+		workers.dirs = d->next;
+		workers.nbusy++;
+		pthread_mutex_unlock(&workers.lock);
+
+		walk_dir(d->path);
+		free(d);
+
+		pthread_mutex_lock(&workers.lock);
+		workers.nbusy--;
+	}
+	/* wake up the others, there is nothing more to do */
+	pthread_cond_broadcast(&workers.cond);
+	pthread_mutex_unlock(&workers.lock);
+	return NULL;
+}
+
+static void *digest_worker(void *data __attribute__((__unused__)))
+{
+	char *buf = xmalloc(opts.bufsiz);
+
+	for (;;) {
+		struct file *f = NULL;
+
+		pthread_mutex_lock(&workers.lock);
+		if (!workers_interrupted() && workers.next < workers.nfiles)
+			f = workers.files[workers.next++];
+		pthread_mutex_unlock(&workers.lock);
+
+		if (!f)
+			break;
+		file_update_digest(f, workers.full, buf);
+	}
+
+	free(buf);
+	return NULL;
+}
+
+static void run_workers(void *(*fn)(void *), unsigned int nworkers)
+{
+	pthread_t *threads = xcalloc(nworkers, sizeof(pthread_t));
+	unsigned int i, n;
+
+	for (n = 0; n < nworkers; n++) {
+		if (pthread_create(&threads[n], NULL, fn, NULL) != 0)
+			break;
+	}
+	if (!n)
+		fn(NULL);		/* no thread, do it ourselves */
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+/* add all files of the by-size node which may be linked to another one */
+static void collect_files(const void *nodep, const VISIT which,
+			  const int depth __attribute__((__unused__)))
+{
+	struct file *head = *(struct file **)nodep;
+	struct file *a, *b;
+
+	if (which != leaf && which != endorder)
+		return;
+
+	for (a = head; a != NULL; a = a->next) {
+		for (b = head; b != NULL; b = b->next) {
+			if (a != b && file_attrs_may_link(a, b))
+				break;
+		}
+		if (!b)
+			continue;
+		if (workers.nfiles % 1024 == 0)
+			workers.files = xrealloc(workers.files,
+				(workers.nfiles + 1024) * sizeof(struct file *));
+		workers.files[workers.nfiles++] = a;
+	}
+}
+
+static int cmp_sample_digests(const void *_a, const void *_b)
+{
+	const struct file *a = *(const struct file **)_a;
+	const struct file *b = *(const struct file **)_b;
+	int diff = 0;
+
+	if (diff == 0)
+		diff = CMP(a->st.st_dev, b->st.st_dev);
+	if (diff == 0)
+		diff = CMP(a->st.st_size, b->st.st_size);
+	if (diff == 0)
+		diff = CMP(a->digest->failed, b->digest->failed);
+	if (diff == 0 && !a->digest->failed)
+		diff = memcmp(a->digest->sample, b->digest->sample, UL_SHA1LENGTH);
+
+	return diff;
 }
 
+/**
+ * hash_files - Calculate the content digests by the worker threads
+ * @nworkers: The number of threads
+ *
+ * The sample digests are calculated for all files which may be linked with
+ * any other file in accordance with the stat information, and the full
+ * digests for the files with the same sample digests. The comparison by
+ * visitor() then uses the digests and reads only the duplicate files.
+ */
+static void hash_files(unsigned int nworkers)
+{
+	size_t i, j, k, n = 0;
+
+	twalk(files, collect_files);
+	if (!workers.nfiles)
+		return;
+
+	workers.full = 0;
+	workers.next = 0;
+	run_workers(digest_worker, nworkers);
+	if (workers.interrupted)
+		goto done;
+
+	qsort(workers.files, workers.nfiles, sizeof(struct file *),
+	      cmp_sample_digests);
+
+	/* keep the files to be hashed in the beginning of the array */
+	for (i = 0; i < workers.nfiles; i = j) {
+		for (j = i + 1; j < workers.nfiles; j++) {
+			if (cmp_sample_digests(&workers.files[i],
+					       &workers.files[j]) != 0)
+				break;
+		}
+		if (workers.files[i]->digest->failed)
+			continue;
+
+		for (k = i; k < j; k++) {
+			struct file *f = workers.files[k];
+			size_t m;
+
+			if (f->digest->has_full)
+				continue;
+			for (m = i; m < j; m++) {
+				if (m != k && file_attrs_may_link(f, workers.files[m]))
+					break;
+			}
+			if (m < j)
+				workers.files[n++] = f;
+		}
+	}
+
+	if (n) {
+		workers.nfiles = n;
+		workers.full = 1;
+		workers.next = 0;
+		run_workers(digest_worker, nworkers);
+	}
+done:
+	free(workers.files);
+	workers.files = NULL;
+	workers.nfiles = 0;
+}
+
+/**
+ * walk_parallel - Find files by the worker threads
+ * @paths:    The directories or files to process
+ * @npaths:   The number of @paths
+ * @nworkers: The number of threads
+ */
+static void walk_parallel(char **paths, int npaths, unsigned int nworkers)
+{
+	int i;
+
+	for (i = npaths - 1; i >= 0; i--) {
+		struct stat st;
+		const char *base;
+
+		if (lstat(paths[i], &st) != 0) {
+			warn(_("cannot process %s"), paths[i]);
+			continue;
+		}
+		if (S_ISDIR(st.st_mode)) {
+			push_dir(paths[i]);
+			continue;
+		}
+		if (!S_ISREG(st.st_mode))
+			continue;
+
+		base = strrchr(paths[i], '/');
+		walk_file(paths[i], &st, base ? base - paths[i] + 1 : 0);
+	}
+
+	run_workers(walk_worker, nworkers);
+
+	while (workers.dirs) {
+		struct walk_dir *d = workers.dirs;
+
+		workers.dirs = d->next;
+		free(d);
+	}
+	if (!workers.interrupted)
+		hash_files(nworkers);
+}
+#endif /* HAVE_PTHREAD_H */
+
 /**
  * visitor - Callback for twalk()
  * @nodep: Pointer to a pointer to a #struct file
@@ -876,7 +1896,7 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 	for (; master != NULL; master = master->next) {
 		if (handle_interrupt())
 			exit(EXIT_FAILURE);
-		if (master->links == NULL)
+		if (master->links == NULL || master->deduped)
 			continue;
 
 		for (other = master->next; other != NULL; other = other->next) {
@@ -886,10 +1906,18 @@ static void visitor(const void *nodep, const VISIT which, const int depth)
 			assert(other != other->next);
 			assert(other->st.st_size == master->st.st_size);
 
-			if (other->links == NULL
+			if (other->links == NULL || other->deduped
 			    || !file_may_link_to(master, other))
 				continue;
 
+#if defined(HAVE_LINUX_FIEMAP_H) && defined(FIDEDUPERANGE)
+			if (opts.dedupe) {
+				if (file_dedupe(master, other))
+					other->deduped = 1;
+				continue;
+			}
+#endif
+
 			if (!file_link(master, other) && errno == EMLINK)
 				master = other;
 		}
@@ -931,6 +1959,13 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --minimum-size <size>  minimum size for files.\n"), out);
 	fputs(_(" -S, --buffer-size <size>   buffer size for file reading (speedup, using more RAM)\n"), out);
 	fputs(_(" -c, --content              compare only file contents, same as -pot\n"), out);
+	fputs(_("     --cache-file <file>    keep the content digests in <file> for the next runs\n"), out);
+#if defined(HAVE_LINUX_FIEMAP_H) && defined(FIDEDUPERANGE)
+	fputs(_("     --dedupe               share the file extents rather than hardlink\n"), out);
+#endif
+#ifdef HAVE_PTHREAD_H
+	fputs(_("     --workers <num>        find and hash files by <num> threads\n"), out);
+#endif
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(28));
@@ -959,6 +1994,11 @@ static void deinit_buffers(void)
  */
 static int parse_options(int argc, char *argv[])
 {
+	enum {
+		OPT_WORKERS = CHAR_MAX + 1,
+		OPT_CACHE_FILE,
+		OPT_DEDUPE
+	};
 	static const char optstr[] = "VhvnfpotXcmMOx:i:s:S:q";
 	static const struct option long_options[] = {
 		{"version", no_argument, NULL, 'V'},
@@ -979,6 +2019,9 @@ static int parse_options(int argc, char *argv[])
 		{"buffer-size", required_argument, NULL, 'S'},
 		{"content", no_argument, NULL, 'c'},
 		{"quiet", no_argument, NULL, 'q'},
+		{"workers", required_argument, NULL, OPT_WORKERS},
+		{"cache-file", required_argument, NULL, OPT_CACHE_FILE},
+		{"dedupe", no_argument, NULL, OPT_DEDUPE},
 		{NULL, 0, NULL, 0}
 	};
 	static const ul_excl_t excl[] = {
@@ -1045,6 +2088,19 @@ static int parse_options(int argc, char *argv[])
 		case 'S':
 			opts.bufsiz = strtosize_or_err(optarg, _("failed to parse size"));
 			break;
+		case OPT_DEDUPE:
+#if defined(HAVE_LINUX_FIEMAP_H) && defined(FIDEDUPERANGE)
+			opts.dedupe = TRUE;
+			break;
+#else
+			errx(EXIT_FAILURE, _("deduplication is not supported"));
+#endif
+		case OPT_CACHE_FILE:
+			opts.cache_file = optarg;
+			break;
+		case OPT_WORKERS:
+			opts.nworkers = strtou32_or_err(optarg, _("invalid workers argument"));
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1104,8 +2160,16 @@ int main(int argc, char *argv[])
 
 	init_buffers(opts.bufsiz);
 
+	if (opts.cache_file)
+		cache_load(opts.cache_file);
+
 	stats.started = TRUE;
 
+#ifdef HAVE_PTHREAD_H
+	if (opts.nworkers)
+		walk_parallel(argv + optind, argc - optind, opts.nworkers);
+	else
+#endif
 	for (; optind < argc; optind++) {
 		if (nftw(argv[optind], inserter, 20, FTW_PHYS) == -1)
 			warn(_("cannot process %s"), argv[optind]);
@@ -1113,6 +2177,9 @@ int main(int argc, char *argv[])
 
 	twalk(files, visitor);
 
+	if (opts.cache_file)
+		cache_save(opts.cache_file);
+
 	deinit_buffers();
 
 	return 0;
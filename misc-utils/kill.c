@@ -45,6 +45,7 @@
  */
 
 #include <ctype.h>		/* for isdigit() */
+#include <errno.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -72,11 +73,18 @@ enum {
 #ifdef UL_HAVE_PIDFD
 # include <poll.h>
 # include "list.h"
+# include "monotonic.h"
 struct timeouts {
 	int period;
 	int sig;
 	struct list_head follow_ups;
 };
+
+/* process signaled with --timeout, waiting for the follow-up signals */
+struct kill_target {
+	pid_t pid;
+	int pfd;
+};
 #endif
 
 struct kill_control {
@@ -88,6 +96,9 @@ struct kill_control {
 #endif
 #ifdef UL_HAVE_PIDFD
 	struct list_head follow_ups;
+	struct kill_target *targets;
+	size_t ntargets;
+	siginfo_t info;
 #endif
 	unsigned int
 		check_all:1,
@@ -378,48 +389,123 @@ static char **parse_arguments(int argc, char **argv, struct kill_control *ctl)
 }
 
 #ifdef UL_HAVE_PIDFD
-static int kill_with_timeout(const struct kill_control *ctl)
+/*
+ * Sends the first signal and remembers the process for the follow-up
+ * signals. The pidfd is opened before the signal is sent, so the follow-up
+ * signals go to the same process.
+ */
+static int kill_with_timeout(struct kill_control *ctl)
+{
+	struct kill_target *t;
+	int pfd;
+
+	if ((pfd = pidfd_open(ctl->pid, 0)) < 0)
+		return -1;
+
+	ctl->info.si_signo = ctl->numsig;
+	if (pidfd_send_signal(pfd, ctl->numsig, &ctl->info, 0) < 0) {
+		close(pfd);
+		return -1;
+	}
+
+	if (ctl->ntargets % 64 == 0)
+		ctl->targets = xrealloc(ctl->targets,
+				(ctl->ntargets + 64) * sizeof(*ctl->targets));
+	t = &ctl->targets[ctl->ntargets++];
+	t->pid = ctl->pid;
+	t->pfd = pfd;
+	return 0;
+}
+
+static int64_t now_ms(void)
+{
+	struct timeval tv;
+
+	gettime_monotonic(&tv);
+	return (int64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* closes pidfds of the finished processes, returns number of remaining */
+static size_t drop_finished(struct kill_control *ctl, struct pollfd *fds)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < ctl->ntargets; i++) {
+		if (fds[i].revents) {
+			close(ctl->targets[i].pfd);
+			continue;
+		}
+		ctl->targets[n] = ctl->targets[i];
+		fds[n++] = fds[i];
+	}
+	ctl->ntargets = n;
+	return n;
+}
+
+/*
+ * Waits for all the processes signaled by kill_with_timeout() at once and
+ * sends the follow-up signals to the processes which are still alive when
+ * the timeout expires.
+ */
+static void wait_for_targets(struct kill_control *ctl)
 {
-	int pfd, n;
-	struct pollfd p = { 0 };
-	siginfo_t info = { 0 };
 	struct list_head *entry;
+	struct pollfd *fds;
+	size_t i;
 
-	info.si_code = SI_QUEUE;
-	info.si_signo = ctl->numsig;
-	info.si_uid = getuid();
-	info.si_pid = getpid();
-	info.si_value.sival_int =
-	    ctl->use_sigval != 0 ? ctl->use_sigval : ctl->numsig;
+	if (!ctl->ntargets)
+		return;
 
-	if ((pfd = pidfd_open(ctl->pid, 0)) < 0)
-		err(EXIT_FAILURE, _("pidfd_open() failed: %d"), ctl->pid);
-	p.fd = pfd;
-	p.events = POLLIN;
+	fds = xcalloc(ctl->ntargets, sizeof(*fds));
+	for (i = 0; i < ctl->ntargets; i++) {
+		fds[i].fd = ctl->targets[i].pfd;
+		fds[i].events = POLLIN;
+	}
 
-	if (pidfd_send_signal(pfd, ctl->numsig, &info, 0) < 0)
-		err(EXIT_FAILURE, _("pidfd_send_signal() failed"));
 	list_for_each(entry, &ctl->follow_ups) {
 		struct timeouts *timeout;
+		int64_t deadline;
 
 		timeout = list_entry(entry, struct timeouts, follow_ups);
-		n = poll(&p, 1, timeout->period);
-		if (n < 0)
-			err(EXIT_FAILURE, _("poll() failed"));
-		if (n == 0) {
-			info.si_signo = timeout->sig;
+		deadline = now_ms() + timeout->period;
+
+		while (ctl->ntargets) {
+			int64_t left = deadline - now_ms();
+			int n = poll(fds, ctl->ntargets, left > 0 ? (int) left : 0);
+
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				err(EXIT_FAILURE, _("poll() failed"));
+			}
+			if (n == 0)
+				break;
+			drop_finished(ctl, fds);
+		}
+
+		ctl->info.si_signo = timeout->sig;
+		for (i = 0; i < ctl->ntargets; i++) {
+			struct kill_target *t = &ctl->targets[i];
+
 			if (ctl->verbose)
 				printf(_("timeout, sending signal %d to pid %d\n"),
-					 timeout->sig, ctl->pid);
-			if (pidfd_send_signal(pfd, timeout->sig, &info, 0) < 0)
-				err(EXIT_FAILURE, _("pidfd_send_signal() failed"));
+					 timeout->sig, t->pid);
+			if (pidfd_send_signal(t->pfd, timeout->sig, &ctl->info, 0) < 0
+			    && errno != ESRCH)
+				warn(_("pidfd_send_signal() failed"));
 		}
 	}
-	return 0;
+
+	for (i = 0; i < ctl->ntargets; i++)
+		close(ctl->targets[i].pfd);
+	free(ctl->targets);
+	free(fds);
+	ctl->targets = NULL;
+	ctl->ntargets = 0;
 }
 #endif
 
-static int kill_verbose(const struct kill_control *ctl)
+static int kill_verbose(struct kill_control *ctl)
 {
 	int rc = 0;
 
@@ -461,6 +547,16 @@ int main(int argc, char **argv)
 #endif
 	argv = parse_arguments(argc, argv, &ctl);
 
+#ifdef UL_HAVE_PIDFD
+	if (ctl.timeout) {
+		ctl.info.si_code = SI_QUEUE;
+		ctl.info.si_uid = getuid();
+		ctl.info.si_pid = getpid();
+		ctl.info.si_value.sival_int =
+		    ctl.use_sigval != 0 ? ctl.use_sigval : ctl.numsig;
+	}
+#endif
+
 	/* The rest of the arguments should be process ids and names. */
 	for ( ; (ctl.arg = *argv) != NULL; argv++) {
 		char *ep = NULL;
@@ -497,6 +593,8 @@ int main(int argc, char **argv)
 	}
 
 #ifdef UL_HAVE_PIDFD
+	wait_for_targets(&ctl);
+
 	while (!list_empty(&ctl.follow_ups)) {
 		struct timeouts *x = list_entry(ctl.follow_ups.next,
 				                  struct timeouts, follow_ups);
@@ -53,6 +53,7 @@
 #include <pwd.h>
 #include <signal.h>
 #include <sys/uio.h>
+#include <poll.h>
 
 #include "all-io.h"
 #include "c.h"
@@ -101,9 +102,31 @@ enum {
 	OPT_ID,
 	OPT_STRUCTURED_DATA_ID,
 	OPT_STRUCTURED_DATA_PARAM,
-	OPT_OCTET_COUNT
+	OPT_OCTET_COUNT,
+	OPT_BATCH,
+	OPT_QUEUE
 };
 
+#ifndef HAVE_SENDMMSG
+struct mmsghdr {
+	struct msghdr	msg_hdr;
+	unsigned int	msg_len;
+};
+#endif
+
+/* message waiting in the --batch queue */
+struct logger_msg {
+	char *data;
+	size_t len;			/* used size */
+	size_t size;			/* allocated size */
+};
+
+#define LOGGER_INBUF_SIZE	(64 * 1024)
+
+/* --queue: messages sent by one sendmsg(), and when to give up at exit */
+#define LOGGER_QUEUE_IOV	64
+#define LOGGER_DRAIN_TRIES	10	/* seconds without progress */
+
 /* rfc5424 structured data */
 struct structured_data {
 	char *id;		/* SD-ID */
@@ -117,6 +140,10 @@ struct logger_ctl {
 	int pri;
 	pid_t pid;			/* zero when unwanted */
 	char *hdr;			/* the syslog header (based on protocol) */
+	char *hostname;			/* cached hostname for the header */
+	char *hdr_tail;			/* cached static part of rfc5424 header */
+	time_t hdr_sec;			/* time of hdr_timefmt */
+	char hdr_timefmt[64];		/* rfc5424 timestamp format for hdr_sec */
 	char const *tag;
 	char *login;
 	char *msgid;
@@ -130,6 +157,26 @@ struct logger_ctl {
 
 	void (*syslogfp)(struct logger_ctl *ctl);
 
+	struct logger_msg *batch;	/* messages to send by one syscall */
+	struct mmsghdr *batch_hdrs;
+	struct iovec *batch_iovs;
+	size_t nbatch;			/* number of queued messages */
+	size_t batch_max;		/* --batch <number> */
+
+	struct logger_msg *queue;	/* --queue ring buffer */
+	size_t queue_max;		/* --queue <number> */
+	size_t queue_head;		/* the oldest queued message */
+	size_t queue_len;		/* number of queued messages */
+	size_t queue_off;		/* already sent bytes of the oldest one */
+	time_t reconnect_time;		/* last reconnect attempt */
+	size_t nqueued;			/* statistics for --queue */
+	size_t nsent;
+	size_t ndropped;
+
+	char *inbuf;			/* stdin buffer */
+	size_t inpos;
+	size_t inlen;
+
 	unsigned int
 			unix_socket_errors:1,	/* whether to report or not errors */
 			noact:1,		/* do not write to sockets */
@@ -139,6 +186,7 @@ struct logger_ctl {
 			rfc5424_tq:1,		/* include time quality markup */
 			rfc5424_host:1,		/* include hostname */
 			skip_empty_lines:1,	/* do not send empty lines when processing files */
+			connect_nofail:1,	/* don't exit when connection fails */
 			octet_count:1;		/* use RFC6587 octet counting */
 };
 
@@ -271,7 +319,7 @@ static int unix_socket(struct logger_ctl *ctl, const char *path, int *socket_typ
 	}
 
 	if (i == 0) {
-		if (ctl->unix_socket_errors)
+		if (ctl->unix_socket_errors && !ctl->connect_nofail)
 			err(EXIT_FAILURE, _("socket %s"), path);
 
 		/* write_output() will try to reconnect */
@@ -284,7 +332,8 @@ static int unix_socket(struct logger_ctl *ctl, const char *path, int *socket_typ
 	return fd;
 }
 
-static int inet_socket(const char *servername, const char *port, int *socket_type)
+static int inet_socket(struct logger_ctl *ctl, const char *servername,
+		       const char *port, int *socket_type)
 {
 	int fd, errcode, i, type = -1;
 	struct addrinfo hints, *res;
@@ -308,6 +357,8 @@ static int inet_socket(const char *servername, const char *port, int *socket_typ
 			continue;
 		hints.ai_family = AF_UNSPEC;
 		errcode = getaddrinfo(servername, p, &hints, &res);
+		if (errcode != 0 && ctl->connect_nofail)
+			return -1;
 		if (errcode != 0)
 			errx(EXIT_FAILURE, _("failed to resolve name %s port %s: %s"),
 			     servername, p, gai_strerror(errcode));
@@ -325,6 +376,8 @@ static int inet_socket(const char *servername, const char *port, int *socket_typ
 		break;
 	}
 
+	if (i == 0 && ctl->connect_nofail)
+		return -1;
 	if (i == 0)
 		errx(EXIT_FAILURE, _("failed to connect to %s port %s"), servername, p);
 
@@ -404,6 +457,7 @@ static int journald_entry(struct logger_ctl *ctl, FILE *fp)
 static char const *rfc3164_current_time(void)
 {
 	static char time[32];
+	static time_t last = (time_t) -1;
 	struct timeval tv;
 	struct tm tm;
 	static char const * const monthnames[] = {
@@ -412,6 +466,9 @@ static char const *rfc3164_current_time(void)
 	};
 
 	logger_gettimeofday(&tv, NULL);
+	if (tv.tv_sec == last)
+		return time;
+	last = tv.tv_sec;
 	localtime_r(&tv.tv_sec, &tm);
 	snprintf(time, sizeof(time),"%s %2d %2.2d:%2.2d:%2.2d",
 		monthnames[tm.tm_mon], tm.tm_mday,
@@ -435,11 +492,245 @@ static char const *rfc3164_current_time(void)
 #define iovec_memcmp(ary, idx, str, len)		\
 		memcmp((ary)[(idx) - 1].iov_base, str, len)
 
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+#ifdef SCM_CREDENTIALS
+union logger_cmsg {
+	struct cmsghdr cmh;
+	char   control[CMSG_SPACE(sizeof(struct ucred))];
+};
+
+/* syslog/journald may follow local socket credentials rather
+ * than in the message PID. If we use --id as root than we can
+ * force kernel to accept another valid PID than the real logger(1)
+ * PID.
+ */
+static void set_credentials(struct logger_ctl *ctl, struct msghdr *message,
+			    union logger_cmsg *cbuf)
+{
+	struct cmsghdr *cmhp;
+	struct ucred *cred;
+
+	if (!ctl->pid || ctl->server || ctl->pid == getpid()
+	    || geteuid() != 0 || kill(ctl->pid, 0) != 0)
+		return;
+
+	message->msg_control = cbuf->control;
+	message->msg_controllen = CMSG_SPACE(sizeof(struct ucred));
+
+	cmhp = CMSG_FIRSTHDR(message);
+	cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
+	cmhp->cmsg_level = SOL_SOCKET;
+	cmhp->cmsg_type = SCM_CREDENTIALS;
+	cred = (struct ucred *) CMSG_DATA(cmhp);
+
+	cred->pid = ctl->pid;
+}
+#endif
+
+/* sends the --batch queue, usually by one sendmmsg() call */
+static void logger_flush(struct logger_ctl *ctl)
+{
+	size_t i, sent = 0;
+	int retry = 1;
+#ifdef SCM_CREDENTIALS
+	union logger_cmsg cbuf;
+	struct msghdr creds = { 0 };
+
+	set_credentials(ctl, &creds, &cbuf);
+#endif
+	for (i = 0; i < ctl->nbatch; i++) {
+		struct msghdr *m = &ctl->batch_hdrs[i].msg_hdr;
+
+		memset(m, 0, sizeof(*m));
+		ctl->batch_iovs[i].iov_base = ctl->batch[i].data;
+		ctl->batch_iovs[i].iov_len = ctl->batch[i].len;
+		m->msg_iov = &ctl->batch_iovs[i];
+		m->msg_iovlen = 1;
+#ifdef SCM_CREDENTIALS
+		m->msg_control = creds.msg_control;
+		m->msg_controllen = creds.msg_controllen;
+#endif
+	}
+
+	/* reconnect and try again on error, see write_output() */
+	while (sent < ctl->nbatch) {
+#ifdef HAVE_SENDMMSG
+		int rc = sendmmsg(ctl->fd, ctl->batch_hdrs + sent,
+				  ctl->nbatch - sent, MSG_NOSIGNAL);
+#else
+		int rc = sendmsg(ctl->fd, &ctl->batch_hdrs[sent].msg_hdr,
+				 MSG_NOSIGNAL) < 0 ? -1 : 1;
+#endif
+		if (rc > 0) {
+			sent += rc;
+			retry = 1;
+		} else if (retry) {
+			logger_reopen(ctl);
+			retry = 0;
+		} else {
+			warn(_("send message failed"));
+			sent++;
+			retry = 1;
+		}
+	}
+	ctl->nbatch = 0;
+}
+
+/* copies the message pieces to @m */
+static void logger_msg_set(struct logger_msg *m,
+			   const struct iovec *iov, int iovlen)
+{
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < iovlen; i++)
+		len += iov[i].iov_len;
+	if (m->size < len) {
+		m->size = len;
+		m->data = xrealloc(m->data, len);
+	}
+	m->len = 0;
+	for (i = 0; i < iovlen; i++) {
+		memcpy(m->data + m->len, iov[i].iov_base, iov[i].iov_len);
+		m->len += iov[i].iov_len;
+	}
+}
+
+static void logger_batch_add(struct logger_ctl *ctl,
+			     const struct iovec *iov, int iovlen)
+{
+	logger_msg_set(&ctl->batch[ctl->nbatch], iov, iovlen);
+
+	if (++ctl->nbatch == ctl->batch_max)
+		logger_flush(ctl);
+}
+
+/*
+ * --queue support. The messages are kept in a ring buffer and written by
+ * non-blocking sendmsg() whenever the socket is writable, so a slow or
+ * unreachable server never blocks the input. When the ring buffer is full
+ * new messages are dropped. If the connection is lost, the partially sent
+ * message is sent again from its begin after reconnect; the octet counting
+ * framing makes the broken frame harmless for the server.
+ */
+static int logger_queue_reconnect(struct logger_ctl *ctl)
+{
+	time_t now = time(NULL);
+
+	/* try it once per second at most, connect() blocks */
+	if (now == ctl->reconnect_time)
+		return -1;
+	ctl->reconnect_time = now;
+
+	logger_reopen(ctl);
+	return is_connected(ctl) ? 0 : -1;
+}
+
+static void logger_queue_send(struct logger_ctl *ctl)
+{
+	while (ctl->queue_len) {
+		struct iovec iov[LOGGER_QUEUE_IOV];
+		struct msghdr message = { 0 };
+		size_t i, n = min(ctl->queue_len, (size_t) LOGGER_QUEUE_IOV);
+		ssize_t rc;
+
+		if (!is_connected(ctl) && logger_queue_reconnect(ctl) != 0)
+			return;
+
+		for (i = 0; i < n; i++) {
+			struct logger_msg *m = &ctl->queue[
+				(ctl->queue_head + i) % ctl->queue_max];
+			size_t off = i == 0 ? ctl->queue_off : 0;
+
+			iov[i].iov_base = m->data + off;
+			iov[i].iov_len = m->len - off;
+		}
+		message.msg_iov = iov;
+		message.msg_iovlen = n;
+
+		rc = sendmsg(ctl->fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (rc < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK
+			    || errno == EINTR)
+				return;
+			/* connection lost */
+			close(ctl->fd);
+			ctl->fd = -1;
+			ctl->queue_off = 0;
+			continue;
+		}
+
+		while (rc > 0) {
+			struct logger_msg *m = &ctl->queue[ctl->queue_head];
+			size_t rest = m->len - ctl->queue_off;
+
+			if ((size_t) rc < rest) {
+				ctl->queue_off += rc;
+				break;
+			}
+			rc -= rest;
+			ctl->queue_off = 0;
+			ctl->queue_head = (ctl->queue_head + 1) % ctl->queue_max;
+			ctl->queue_len--;
+			ctl->nsent++;
+		}
+	}
+}
+
+static void logger_queue_add(struct logger_ctl *ctl,
+			     const struct iovec *iov, int iovlen)
+{
+	if (ctl->queue_len == ctl->queue_max)
+		logger_queue_send(ctl);
+	if (ctl->queue_len == ctl->queue_max) {
+		ctl->ndropped++;
+		return;
+	}
+	logger_msg_set(&ctl->queue[(ctl->queue_head + ctl->queue_len)
+				   % ctl->queue_max], iov, iovlen);
+	ctl->queue_len++;
+	ctl->nqueued++;
+
+	logger_queue_send(ctl);
+}
+
+/* waits for the pending messages at exit, gives up if there is no progress */
+static void logger_queue_drain(struct logger_ctl *ctl)
+{
+	int tries = 0;
+
+	while (ctl->queue_len && tries < LOGGER_DRAIN_TRIES) {
+		size_t len = ctl->queue_len, off = ctl->queue_off;
+
+		if (is_connected(ctl)) {
+			struct pollfd fds = { .fd = ctl->fd, .events = POLLOUT };
+
+			ignore_result( poll(&fds, 1, 1000) );
+		} else
+			ignore_result( poll(NULL, 0, 1000) );
+
+		logger_queue_send(ctl);
+		if (ctl->queue_len == len && ctl->queue_off == off)
+			tries++;
+		else
+			tries = 0;
+	}
+
+	ctl->ndropped += ctl->queue_len;
+	ctl->queue_len = 0;
+}
+
 /* writes generated buffer to desired destination. For TCP syslog,
  * we use RFC6587 octet-stuffing (unless octet-counting is selected).
  * This is not great, but doing full blown RFC5425 (TLS) looks like
  * it is too much for the logger utility. If octet-counting is
  * selected, we use that.
+ *
+ * With --batch the message is queued and sent later by logger_flush(),
+ * with --queue it is sent when the socket is writable.
  */
 static void write_output(struct logger_ctl *ctl, const char *const msg)
 {
@@ -447,8 +738,8 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 	int iovlen = 0;
 	char *octet = NULL;
 
-	/* initial connect failed? */
-	if (!ctl->noact && !is_connected(ctl))
+	/* initial connect failed? (--queue reconnects later) */
+	if (!ctl->noact && !is_connected(ctl) && !ctl->queue_max)
 		logger_reopen(ctl);
 
 	/* 1) octen count */
@@ -463,44 +754,31 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 	/* 3) message */
 	iovec_add_string(iov, iovlen, msg, 0);
 
+	if (!ctl->noact && ctl->queue_max) {
+		logger_queue_add(ctl, iov, iovlen);
+		goto stderr_out;
+	}
+
 	if (!ctl->noact && is_connected(ctl)) {
 		struct msghdr message = { 0 };
 #ifdef SCM_CREDENTIALS
-		struct cmsghdr *cmhp;
-		struct ucred *cred;
-		union {
-			struct cmsghdr cmh;
-			char   control[CMSG_SPACE(sizeof(struct ucred))];
-		} cbuf;
+		union logger_cmsg cbuf;
 #endif
 
 		/* 4) add extra \n to make sure message is terminated */
 		if ((ctl->socket_type == TYPE_TCP) && !ctl->octet_count)
 			iovec_add_string(iov, iovlen, "\n", 1);
 
+		if (ctl->batch_max > 1) {
+			logger_batch_add(ctl, iov, iovlen);
+			goto stderr_out;
+		}
+
 		message.msg_iov = iov;
 		message.msg_iovlen = iovlen;
 
 #ifdef SCM_CREDENTIALS
-		/* syslog/journald may follow local socket credentials rather
-		 * than in the message PID. If we use --id as root than we can
-		 * force kernel to accept another valid PID than the real logger(1)
-		 * PID.
-		 */
-		if (ctl->pid && !ctl->server && ctl->pid != getpid()
-		    && geteuid() == 0 && kill(ctl->pid, 0) == 0) {
-
-			message.msg_control = cbuf.control;
-			message.msg_controllen = CMSG_SPACE(sizeof(struct ucred));
-
-			cmhp = CMSG_FIRSTHDR(&message);
-			cmhp->cmsg_len = CMSG_LEN(sizeof(struct ucred));
-			cmhp->cmsg_level = SOL_SOCKET;
-			cmhp->cmsg_type = SCM_CREDENTIALS;
-			cred = (struct ucred *) CMSG_DATA(cmhp);
-
-			cred->pid = ctl->pid;
-		}
+		set_credentials(ctl, &message, &cbuf);
 #endif
 		/* Note that logger(1) maybe executed for long time (as pipe
 		 * reader) and connection endpoint (syslogd) may be restarted.
@@ -511,9 +789,6 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 		 * MSG_NOSIGNAL is POSIX.1-2008 compatible, but it for example
 		 * not supported by apple-darwin15.6.0.
 		 */
-#ifndef MSG_NOSIGNAL
-# define MSG_NOSIGNAL 0
-#endif
 		if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0) {
 			logger_reopen(ctl);
 			if (sendmsg(ctl->fd, &message, MSG_NOSIGNAL) < 0)
@@ -521,6 +796,7 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 		}
 	}
 
+stderr_out:
 	if (ctl->stderr_printout) {
 		/* make sure it's terminated for stderr */
 		if (iovec_memcmp(iov, iovlen, "\n", 1) != 0)
@@ -533,25 +809,29 @@ static void write_output(struct logger_ctl *ctl, const char *const msg)
 }
 
 #define NILVALUE "-"
+
+/* the hostname does not change, the headers use cached one */
+static const char *logger_hostname(struct logger_ctl *ctl)
+{
+	if (!ctl->hostname)
+		ctl->hostname = logger_xgethostname();
+	if (!ctl->hostname)
+		ctl->hostname = xstrdup(NILVALUE);
+	return ctl->hostname;
+}
+
 static void syslog_rfc3164_header(struct logger_ctl *const ctl)
 {
-	char pid[30], *hostname;
+	char pid[30];
+	const char *hostname = logger_hostname(ctl);
 
 	*pid = '\0';
 	if (ctl->pid)
 		snprintf(pid, sizeof(pid), "[%d]", ctl->pid);
 
-	if ((hostname = logger_xgethostname())) {
-		char *dot = strchr(hostname, '.');
-		if (dot)
-			*dot = '\0';
-	} else
-		hostname = xstrdup(NILVALUE);
-
-	xasprintf(&ctl->hdr, "<%d>%.15s %s %.200s%s: ",
-		 ctl->pri, rfc3164_current_time(), hostname, ctl->tag, pid);
-
-	free(hostname);
+	xasprintf(&ctl->hdr, "<%d>%.15s %.*s %.200s%s: ",
+		 ctl->pri, rfc3164_current_time(),
+		 (int) strcspn(hostname, "."), hostname, ctl->tag, pid);
 }
 
 static inline struct list_head *get_user_structured_data(struct logger_ctl *ctl)
@@ -756,45 +1036,26 @@ static int valid_structured_data_id(const char *str)
  * specified RFC5424. The rest of the field mappings should be
  * pretty clear from RFC5424. -- Rainer Gerhards, 2015-03-10
  */
-static void syslog_rfc5424_header(struct logger_ctl *const ctl)
+/* the static part of the header: HOSTNAME APP-NAME PROCID MSGID SD */
+static char *syslog_rfc5424_tail(struct logger_ctl *const ctl)
 {
-	char *time;
-	char *hostname;
+	char *tail;
+	const char *hostname;
 	char const *app_name = ctl->tag;
 	char *procid;
 	char *const msgid = xstrdup(ctl->msgid ? ctl->msgid : NILVALUE);
 	char *structured = NULL;
 	struct list_head *sd;
 
-	if (ctl->rfc5424_time) {
-		struct timeval tv;
-		struct tm tm;
-
-		logger_gettimeofday(&tv, NULL);
-		if (localtime_r(&tv.tv_sec, &tm) != NULL) {
-			char fmt[64];
-			const size_t i = strftime(fmt, sizeof(fmt),
-						  "%Y-%m-%dT%H:%M:%S.%%06u%z ", &tm);
-			/* patch TZ info to comply with RFC3339 (we left SP at end) */
-			fmt[i - 1] = fmt[i - 2];
-			fmt[i - 2] = fmt[i - 3];
-			fmt[i - 3] = ':';
-			xasprintf(&time, fmt, tv.tv_usec);
-		} else
-			err(EXIT_FAILURE, _("localtime() failed"));
-	} else
-		time = xstrdup(NILVALUE);
-
 	if (ctl->rfc5424_host) {
-		if (!(hostname = logger_xgethostname()))
-			hostname = xstrdup(NILVALUE);
+		hostname = logger_hostname(ctl);
 		/* Arbitrary looking 'if (var < strlen()) checks originate from
 		 * RFC 5424 - 6 Syslog Message Format definition.  */
 		if (255 < strlen(hostname))
 			errx(EXIT_FAILURE, _("hostname '%s' is too long"),
 			     hostname);
 	} else
-		hostname = xstrdup(NILVALUE);
+		hostname = NILVALUE;
 
 	if (48 < strlen(ctl->tag))
 		errx(EXIT_FAILURE, _("tag '%s' is too long"), ctl->tag);
@@ -828,21 +1089,56 @@ static void syslog_rfc5424_header(struct logger_ctl *const ctl)
 	if (!structured)
 		structured = xstrdup(NILVALUE);
 
-	xasprintf(&ctl->hdr, "<%d>1 %s %s %s %s %s %s ",
-		ctl->pri,
-		time,
+	xasprintf(&tail, "%s %s %s %s %s",
 		hostname,
 		app_name,
 		procid,
 		msgid,
 		structured);
 
-	free(time);
-	free(hostname);
 	/* app_name points to ctl->tag, do NOT free! */
 	free(procid);
 	free(msgid);
 	free(structured);
+	return tail;
+}
+
+/*
+ * The header is generated for each message, but only the priority and
+ * the timestamp may differ; the rest is cached in ctl->hdr_tail and the
+ * timestamp format in ctl->hdr_timefmt.
+ */
+static void syslog_rfc5424_header(struct logger_ctl *const ctl)
+{
+	char time[64];
+
+	if (ctl->rfc5424_time) {
+		struct timeval tv;
+		struct tm tm;
+
+		logger_gettimeofday(&tv, NULL);
+		if (!*ctl->hdr_timefmt || ctl->hdr_sec != tv.tv_sec) {
+			char *fmt = ctl->hdr_timefmt;
+			size_t i;
+
+			if (localtime_r(&tv.tv_sec, &tm) == NULL)
+				err(EXIT_FAILURE, _("localtime() failed"));
+			i = strftime(fmt, sizeof(ctl->hdr_timefmt),
+				     "%Y-%m-%dT%H:%M:%S.%%06u%z ", &tm);
+			/* patch TZ info to comply with RFC3339 (we left SP at end) */
+			fmt[i - 1] = fmt[i - 2];
+			fmt[i - 2] = fmt[i - 3];
+			fmt[i - 3] = ':';
+			ctl->hdr_sec = tv.tv_sec;
+		}
+		snprintf(time, sizeof(time), ctl->hdr_timefmt, (unsigned int) tv.tv_usec);
+	} else
+		xstrncpy(time, NILVALUE, sizeof(time));
+
+	if (!ctl->hdr_tail)
+		ctl->hdr_tail = syslog_rfc5424_tail(ctl);
+
+	xasprintf(&ctl->hdr, "<%d>1 %s %s ", ctl->pri, time, ctl->hdr_tail);
 }
 
 static void parse_rfc5424_flags(struct logger_ctl *ctl, char *s)
@@ -900,7 +1196,7 @@ static void generate_syslog_header(struct logger_ctl *const ctl)
 static void __logger_open(struct logger_ctl *ctl)
 {
 	if (ctl->server) {
-		ctl->fd = inet_socket(ctl->server, ctl->port, &ctl->socket_type);
+		ctl->fd = inet_socket(ctl, ctl->server, ctl->port, &ctl->socket_type);
 	} else {
 		if (!ctl->unix_socket)
 			ctl->unix_socket = _PATH_DEVLOG;
@@ -914,6 +1210,10 @@ static void logger_open(struct logger_ctl *ctl)
 {
 	__logger_open(ctl);
 
+	/* --queue reconnects later, the initial connection only has to work */
+	if (ctl->queue_max)
+		ctl->connect_nofail = 1;
+
 	if (!ctl->syslogfp)
 		ctl->syslogfp = ctl->server ? syslog_rfc5424_header :
 					      syslog_local_header;
@@ -968,6 +1268,39 @@ static void logger_command_line(struct logger_ctl *ctl, char **argv)
 	free(buf);
 }
 
+/* like getchar(), but sends the queued messages while it waits for input */
+static int logger_getchar(struct logger_ctl *ctl)
+{
+	if (ctl->inpos >= ctl->inlen) {
+		ssize_t n;
+
+		if (ctl->nbatch)
+			logger_flush(ctl);
+		while (ctl->queue_len) {
+			struct pollfd fds[2] = {
+				{ .fd = fileno(stdin), .events = POLLIN },
+				{ .fd = ctl->fd,       .events = POLLOUT }
+			};
+
+			/* disconnected: fd -1 is ignored, reconnect later */
+			if (poll(fds, 2, is_connected(ctl) ? -1 : 1000) < 0
+			    && errno != EINTR)
+				break;
+			if (fds[0].revents)
+				break;
+			logger_queue_send(ctl);
+		}
+		do {
+			n = read(fileno(stdin), ctl->inbuf, LOGGER_INBUF_SIZE);
+		} while (n < 0 && errno == EINTR);
+		if (n <= 0)
+			return EOF;
+		ctl->inpos = 0;
+		ctl->inlen = n;
+	}
+	return (unsigned char) ctl->inbuf[ctl->inpos++];
+}
+
 static void logger_stdin(struct logger_ctl *ctl)
 {
 	/* note: we re-generate the syslog header for each log message to
@@ -983,13 +1316,14 @@ static void logger_stdin(struct logger_ctl *ctl)
 	int c;
 	size_t i;
 
-	c = getchar();
+	ctl->inbuf = xmalloc(LOGGER_INBUF_SIZE);
+	c = logger_getchar(ctl);
 	while (c != EOF) {
 		i = 0;
 		if (ctl->prio_prefix && c == '<') {
 			pri = 0;
 			buf[i++] = c;
-			while (isdigit(c = getchar()) && pri <= 191) {
+			while (isdigit(c = logger_getchar(ctl)) && pri <= 191) {
 				buf[i++] = c;
 				pri = pri * 10 + c - '0';
 			}
@@ -1011,12 +1345,12 @@ static void logger_stdin(struct logger_ctl *ctl)
 				last_pri = ctl->pri;
 			}
 			if (c != EOF && c != '\n')
-				c = getchar();
+				c = logger_getchar(ctl);
 		}
 
 		while (c != EOF && c != '\n' && i < max_usrmsg_size) {
 			buf[i++] = c;
-			c = getchar();
+			c = logger_getchar(ctl);
 		}
 		buf[i] = '\0';
 
@@ -1028,17 +1362,38 @@ static void logger_stdin(struct logger_ctl *ctl)
 		}
 
 		if (c == '\n')	/* discard line terminator */
-			c = getchar();
+			c = logger_getchar(ctl);
 	}
 
 	free(buf);
+	free(ctl->inbuf);
+	ctl->inbuf = NULL;
 }
 
-static void logger_close(const struct logger_ctl *ctl)
+static void logger_close(struct logger_ctl *ctl)
 {
+	size_t i;
+
+	if (ctl->nbatch)
+		logger_flush(ctl);
+	if (ctl->queue_len)
+		logger_queue_drain(ctl);
+	if (ctl->ndropped)
+		warnx(_("sent %zu messages, dropped %zu messages"),
+		      ctl->nsent, ctl->ndropped);
 	if (ctl->fd != -1 && close(ctl->fd) != 0)
 		err(EXIT_FAILURE, _("close failed"));
+	for (i = 0; ctl->batch && i < ctl->batch_max; i++)
+		free(ctl->batch[i].data);
+	free(ctl->batch);
+	for (i = 0; ctl->queue && i < ctl->queue_max; i++)
+		free(ctl->queue[i].data);
+	free(ctl->queue);
+	free(ctl->batch_hdrs);
+	free(ctl->batch_iovs);
 	free(ctl->hdr);
+	free(ctl->hdr_tail);
+	free(ctl->hostname);
 	free(ctl->login);
 }
 
@@ -1059,6 +1414,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_("     --no-act             do everything except the write the log\n"), out);
 	fputs(_(" -p, --priority <prio>    mark given message with this priority\n"), out);
 	fputs(_("     --octet-count        use rfc6587 octet counting\n"), out);
+	fputs(_("     --batch <number>     send up to <number> messages at once\n"), out);
+	fputs(_("     --queue <number>     queue up to <number> messages, don't wait for TCP server\n"), out);
 	fputs(_("     --prio-prefix        look for a prefix on every line read from stdin\n"), out);
 	fputs(_(" -s, --stderr             output message to standard error as well\n"), out);
 	fputs(_(" -S, --size <size>        maximum size for a single message\n"), out);
@@ -1112,7 +1469,8 @@ int main(int argc, char **argv)
 		.rfc5424_time = 1,
 		.rfc5424_tq = 1,
 		.rfc5424_host = 1,
-		.skip_empty_lines = 0
+		.skip_empty_lines = 0,
+		.batch_max = 1
 	};
 	int ch;
 	int stdout_reopened = 0;
@@ -1136,6 +1494,8 @@ int main(int argc, char **argv)
 		{ "version",	   no_argument,	      0, 'V'		   },
 		{ "help",	   no_argument,	      0, 'h'		   },
 		{ "octet-count",   no_argument,	      0, OPT_OCTET_COUNT   },
+		{ "batch",	   required_argument, 0, OPT_BATCH	   },
+		{ "queue",	   required_argument, 0, OPT_QUEUE	   },
 		{ "prio-prefix",   no_argument,	      0, OPT_PRIO_PREFIX   },
 		{ "rfc3164",	   no_argument,	      0, OPT_RFC3164	   },
 		{ "rfc5424",	   optional_argument, 0, OPT_RFC5424	   },
@@ -1213,6 +1573,18 @@ int main(int argc, char **argv)
 		case OPT_OCTET_COUNT:
 			ctl.octet_count = 1;
 			break;
+		case OPT_BATCH:
+			ctl.batch_max = strtou32_or_err(optarg,
+				_("failed to parse batch size"));
+			if (!ctl.batch_max)
+				errx(EXIT_FAILURE, _("batch size must be greater than zero"));
+			break;
+		case OPT_QUEUE:
+			ctl.queue_max = strtou32_or_err(optarg,
+				_("failed to parse queue size"));
+			if (!ctl.queue_max)
+				errx(EXIT_FAILURE, _("queue size must be greater than zero"));
+			break;
 		case OPT_PRIO_PREFIX:
 			ctl.prio_prefix = 1;
 			break;
@@ -1300,6 +1672,17 @@ int main(int argc, char **argv)
 	default:
 		abort();
 	}
+	if (ctl.queue_max) {
+		/* stream socket, the frames must not depend on \n */
+		ctl.socket_type = TYPE_TCP;
+		ctl.octet_count = 1;
+		ctl.queue = xcalloc(ctl.queue_max, sizeof(*ctl.queue));
+	}
+	if (ctl.batch_max > 1) {
+		ctl.batch = xcalloc(ctl.batch_max, sizeof(*ctl.batch));
+		ctl.batch_hdrs = xcalloc(ctl.batch_max, sizeof(*ctl.batch_hdrs));
+		ctl.batch_iovs = xcalloc(ctl.batch_max, sizeof(*ctl.batch_iovs));
+	}
 	logger_open(&ctl);
 	if (0 < argc)
 		logger_command_line(&ctl, argv);
@@ -77,6 +77,7 @@ static char *binary_search (char *, char *);
 static int compare (char *, char *);
 static char *linear_search (char *, char *);
 static int look (char *, char *);
+static int look_batch (char *, char *, const char *, int);
 static void print_from (char *, char *);
 static void __attribute__((__noreturn__)) usage(void);
 
@@ -86,11 +87,13 @@ main(int argc, char *argv[])
 	struct stat sb;
 	int ch, fd, termchar;
 	char *back, *file, *front, *p;
+	const char *strings_file = NULL;
 
 	static const struct option longopts[] = {
 		{"alternative", no_argument, NULL, 'a'},
 		{"alphanum", no_argument, NULL, 'd'},
 		{"ignore-case", no_argument, NULL, 'f'},
+		{"strings", required_argument, NULL, 's'},
 		{"terminate", required_argument, NULL, 't'},
 		{"version", no_argument, NULL, 'V'},
 		{"help", no_argument, NULL, 'h'},
@@ -112,7 +115,7 @@ main(int argc, char *argv[])
 	termchar = '\0';
 	string = NULL;		/* just for gcc */
 
-	while ((ch = getopt_long(argc, argv, "adft:Vh", longopts, NULL)) != -1)
+	while ((ch = getopt_long(argc, argv, "adfs:t:Vh", longopts, NULL)) != -1)
 		switch(ch) {
 		case 'a':
 			file = _PATH_WORDS_ALT;
@@ -123,6 +126,9 @@ main(int argc, char *argv[])
 		case 'f':
 			fflag = 1;
 			break;
+		case 's':
+			strings_file = optarg;
+			break;
 		case 't':
 			termchar = *optarg;
 			break;
@@ -136,7 +142,19 @@ main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	switch (argc) {
+	if (strings_file) {
+		switch (argc) {
+		case 1:
+			file = *argv;
+			break;
+		case 0:
+			dflag = fflag = 1;
+			break;
+		default:
+			warnx(_("bad usage"));
+			errtryhelp(EXIT_FAILURE);
+		}
+	} else switch (argc) {
 	case 2:				/* Don't set -df for user. */
 		string = *argv++;
 		file = *argv;
@@ -150,7 +168,7 @@ main(int argc, char *argv[])
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (termchar != '\0' && (p = strchr(string, termchar)) != NULL)
+	if (!strings_file && termchar != '\0' && (p = strchr(string, termchar)) != NULL)
 		*++p = '\0';
 
 	if ((fd = open(file, O_RDONLY, 0)) < 0 || fstat(fd, &sb))
@@ -165,6 +183,9 @@ main(int argc, char *argv[])
 #endif
 			err(EXIT_FAILURE, "%s", file);
 	back = front + sb.st_size;
+
+	if (strings_file)
+		return look_batch(front, back, strings_file, termchar);
 	return look(front, back);
 }
 
@@ -198,6 +219,46 @@ look(char *front, char *back)
 	return (front ? 0 : 1);
 }
 
+/*
+ * Look for all strings from the file (one per line), the dictionary is
+ * opened and mapped only once. Returns 0 if any line has been found.
+ */
+static int
+look_batch(char *front, char *back, const char *filename, int termchar)
+{
+	FILE *f = stdin;
+	char *buf = NULL, *p;
+	size_t bufsz = 0;
+	ssize_t len;
+	int rc = 1;
+
+	if (strcmp(filename, "-") != 0) {
+		f = fopen(filename, "r");
+		if (!f)
+			err(EXIT_FAILURE, _("cannot open %s"), filename);
+	}
+
+	while ((len = getline(&buf, &bufsz, f)) >= 0) {
+		if (len && buf[len - 1] == '\n')
+			buf[--len] = '\0';
+		if (!len)
+			continue;
+		if (termchar != '\0' && (p = strchr(buf, termchar)) != NULL)
+			*++p = '\0';
+
+		string = buf;
+		if (look(front, back) == 0)
+			rc = 0;
+	}
+	if (ferror(f))
+		err(EXIT_FAILURE, _("read failed: %s"), filename);
+
+	free(buf);
+	if (f != stdin)
+		fclose(f);
+	return rc;
+}
+
 
 /*
  * Binary search for "string" in memory between "front" and "back".
@@ -293,19 +354,13 @@ linear_search(char *front, char *back)
 static void
 print_from(char *front, char *back)
 {
-	int eol;
-
 	while (front < back && compare(front, back) == EQUAL) {
-		if (compare(front, back) == EQUAL) {
-			eol = 0;
-			while (front < back && !eol) {
-				if (putchar(*front) == EOF)
-					err(EXIT_FAILURE, "stdout");
-				if (*front++ == '\n')
-					eol = 1;
-			}
-		} else
-			SKIP_PAST_NEWLINE(front, back);
+		char *eol = memchr(front, '\n', back - front);
+		size_t len = (eol ? eol + 1 : back) - front;
+
+		if (fwrite(front, 1, len, stdout) != len)
+			err(EXIT_FAILURE, "stdout");
+		front += len;
 	}
 }
 
@@ -330,6 +385,19 @@ compare(char *s2, char *s2end) {
 	int i;
 	char *p;
 
+	/* nothing to ignore, compare in place */
+	if (!dflag && !fflag) {
+		size_t n = min((size_t) (s2end - s2), (size_t) stringlen);
+
+		p = memchr(s2, '\n', n);
+		if (p)
+			n = p - s2;
+		i = memcmp(s2, string, n);
+		if (i == 0 && n < (size_t) stringlen)
+			i = -1;		/* the line is shorter */
+		return ((i > 0) ? LESS : (i < 0) ? GREATER : EQUAL);
+	}
+
 	/* copy, ignoring things that should be ignored */
 	p = comparbuf;
 	i = stringlen;
@@ -365,6 +433,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -a, --alternative        use the alternative dictionary\n"), out);
 	fputs(_(" -d, --alphanum           compare only blanks and alphanumeric characters\n"), out);
 	fputs(_(" -f, --ignore-case        ignore case differences when comparing\n"), out);
+	fputs(_(" -s, --strings <file>     read strings to look for from file\n"), out);
 	fputs(_(" -t, --terminate <char>   define the string-termination character\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -90,6 +90,7 @@ struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev, size_t
 
 		mnt_table_set_parser_errcb(mtab, table_parser_errcb);
 		mnt_table_set_cache(mtab, mntcache);
+		mnt_table_enable_lazy_parse(mtab, 1);	/* options rarely used */
 
 		if (!lsblk->sysroot)
 			mnt_table_parse_mtab(mtab, NULL);
@@ -178,4 +179,7 @@ void lsblk_mnt_deinit(void)
 	mnt_unref_table(mtab);
 	mnt_unref_table(swaps);
 	mnt_unref_cache(mntcache);
+
+	mtab = swaps = NULL;
+	mntcache = NULL;
 }
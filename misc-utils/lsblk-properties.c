@@ -15,7 +15,12 @@
 #include "lsblk.h"
 
 #ifdef HAVE_LIBUDEV
+# ifdef LSBLK_PARALLEL_PROPERTIES
+/* libudev objects must not be shared between threads */
+static __thread struct udev *udev;
+# else
 static struct udev *udev;
+# endif
 #endif
 
 void lsblk_device_free_properties(struct lsblk_devprop *p)
@@ -325,9 +330,90 @@ void lsblk_properties_deinit(void)
 {
 #ifdef HAVE_LIBUDEV
 	udev_unref(udev);
+	udev = NULL;
 #endif
 }
 
+#ifdef LSBLK_PARALLEL_PROPERTIES
+struct lsblk_prop_workers {
+	pthread_mutex_t lock;
+	struct lsblk_device **devs;
+	size_t ndevs;
+	size_t next;			/* the next device to read */
+};
+
+static void *properties_worker(void *data)
+{
+	struct lsblk_prop_workers *wrk = data;
+
+	for (;;) {
+		struct lsblk_device *dev = NULL;
+
+		pthread_mutex_lock(&wrk->lock);
+		if (wrk->next < wrk->ndevs)
+			dev = wrk->devs[wrk->next++];
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (!dev)
+			break;
+		lsblk_device_get_properties(dev);
+	}
+#ifdef HAVE_LIBUDEV
+	/* the context is thread-local, nobody else can release it */
+	udev_unref(udev);
+	udev = NULL;
+#endif
+	return NULL;
+}
+
+/*
+ * Reads properties of all the devices in the tree by @nworkers threads. The
+ * properties are cached in the devices, so the output (in the usual order)
+ * does not need to wait for udev or blkid probing later.
+ */
+void lsblk_devtree_read_properties(struct lsblk_devtree *tr, unsigned int nworkers)
+{
+	struct lsblk_prop_workers wrk = { .ndevs = 0 };
+	struct lsblk_device *dev;
+	struct lsblk_iter itr;
+	pthread_t *threads;
+	unsigned int i, n;
+	size_t count = 0;
+
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0)
+		count++;
+	if (count < 2 || nworkers < 2)
+		return;
+
+	wrk.devs = xcalloc(count, sizeof(struct lsblk_device *));
+	lsblk_reset_iter(&itr, LSBLK_ITER_FORWARD);
+	while (lsblk_devtree_next_device(tr, &itr, &dev) == 0)
+		wrk.devs[wrk.ndevs++] = dev;
+
+	DBG(DEV, ul_debug("reading properties of %zu devices by %u threads",
+				wrk.ndevs, nworkers));
+
+	blkid_init_debug(0);		/* don't initialize it in threads */
+	nworkers = min((size_t) nworkers, wrk.ndevs);
+	threads = xcalloc(nworkers, sizeof(pthread_t));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (n = 0; n < nworkers; n++) {
+		if (pthread_create(&threads[n], NULL, properties_worker, &wrk) != 0)
+			break;
+	}
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	/* no thread, the properties will be read on demand */
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+	free(wrk.devs);
+}
+#endif /* LSBLK_PARALLEL_PROPERTIES */
+
 
 
 /*
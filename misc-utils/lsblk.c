@@ -36,6 +36,9 @@
 #include <grp.h>
 #include <ctype.h>
 #include <assert.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #include <blkid.h>
 
@@ -61,6 +64,9 @@ UL_DEBUG_DEFINE_MASKNAMES(lsblk) = UL_DEBUG_EMPTY_MASKNAMES;
 #define LSBLK_EXIT_SOMEOK 64
 #define LSBLK_EXIT_ALLFAILED 32
 
+/* --watch, wait for more uevents before the output is refreshed */
+#define LSBLK_WATCH_SETTLE_MS	100
+
 static int column_id_to_number(int id);
 
 /* column IDs */
@@ -139,6 +145,7 @@ enum {
 	LSBLK_EXPORT =		(1 << 3),
 	LSBLK_TREE =		(1 << 4),
 	LSBLK_JSON =		(1 << 5),
+	LSBLK_NDJSON =		(1 << 6),
 };
 
 /* Types used for qsort() and JSON */
@@ -580,7 +587,8 @@ static char *mk_dm_name(const char *name)
 }
 
 /* stores data to scols cell userdata (invisible and independent on output)
- * to make the original values accessible for sort functions
+ * to make the original values accessible for sort functions; the data are
+ * tracked in lsblk->sortdata, the line may be removed by the table filter
  */
 static void set_sortdata_u64(struct libscols_line *ln, int col, uint64_t x)
 {
@@ -592,6 +600,10 @@ static void set_sortdata_u64(struct libscols_line *ln, int col, uint64_t x)
 	data = xmalloc(sizeof(uint64_t));
 	*data = x;
 	scols_cell_set_userdata(ce, data);
+
+	lsblk->sortdata = xrealloc(lsblk->sortdata,
+			(lsblk->nsortdata + 1) * sizeof(uint64_t *));
+	lsblk->sortdata[lsblk->nsortdata++] = data;
 }
 
 /* do not modify *data on any error */
@@ -610,24 +622,15 @@ static void str2u64(const char *str, uint64_t *data)
 	*data = num;
 }
 
-static void unref_sortdata(struct libscols_table *tb)
+static void unref_sortdata(void)
 {
-	struct libscols_iter *itr;
-	struct libscols_line *ln;
-
-	if (!tb || !lsblk->sort_col)
-		return;
-	itr = scols_new_iter(SCOLS_ITER_FORWARD);
-	if (!itr)
-		return;
-	while (scols_table_next_line(tb, itr, &ln) == 0) {
-		struct libscols_cell *ce = scols_line_get_column_cell(ln,
-								lsblk->sort_col);
-		void *data = scols_cell_get_userdata(ce);
-		free(data);
-	}
+	size_t i;
 
-	scols_free_iter(itr);
+	for (i = 0; i < lsblk->nsortdata; i++)
+		free(lsblk->sortdata[i]);
+	free(lsblk->sortdata);
+	lsblk->sortdata = NULL;
+	lsblk->nsortdata = 0;
 }
 
 static char *get_vfs_attribute(struct lsblk_device *dev, int id)
@@ -1160,7 +1163,8 @@ static void device_to_scols(
 		link_group = 1;
 	}
 
-	ln = scols_table_new_line(tab, link_group ? NULL : parent_line);
+	/* the filtered lines may be deallocated, don't use them as parents */
+	ln = scols_table_new_line(tab, link_group || lsblk->filter ? NULL : parent_line);
 	if (!ln)
 		err(EXIT_FAILURE, _("failed to allocate output line"));
 
@@ -1294,6 +1298,8 @@ static int initialize_device(struct lsblk_device *dev,
 		DBG(DEV, ul_debugobj(dev, "%s: failed to initialize sysfs handler", dev->name));
 		return -1;
 	}
+	/* the same attributes are often read for more columns */
+	ul_path_enable_cache(dev->sysfs, 1);
 
 	dev->maj = major(devno);
 	dev->min = minor(devno);
@@ -1315,9 +1321,17 @@ static int initialize_device(struct lsblk_device *dev,
 		}
 	}
 
-	dev->npartitions = sysfs_blkdev_count_partitions(dev->sysfs, dev->name);
-	dev->nholders = ul_path_count_dirents(dev->sysfs, "holders");
-	dev->nslaves = ul_path_count_dirents(dev->sysfs, "slaves");
+	/* Read only what is necessary to build the tree; partitions have
+	 * no partitions and slaves, holders are used for dependencies only,
+	 * and nothing of that is needed for --nodeps (except slaves to
+	 * detect in-middle devices and for the disk specific columns). */
+	if (!wholedisk) {
+		if (!lsblk->nodeps)
+			dev->npartitions = sysfs_blkdev_count_partitions(dev->sysfs, dev->name);
+		dev->nslaves = ul_path_count_dirents(dev->sysfs, "slaves");
+	}
+	if (!lsblk->nodeps && !lsblk->inverse)
+		dev->nholders = ul_path_count_dirents(dev->sysfs, "holders");
 
 	DBG(DEV, ul_debugobj(dev, "%s: npartitions=%d, nholders=%d, nslaves=%d",
 			dev->name, dev->npartitions, dev->nholders, dev->nslaves));
@@ -1883,6 +1897,195 @@ static void devtree_set_dedupkeys(struct lsblk_devtree *tr, int id)
 		device_set_dedupkey(dev, NULL, id);
 }
 
+#ifdef LSBLK_PARALLEL_PROPERTIES
+/* returns 1 if any column is based on lsblk_device_get_properties() */
+static int columns_need_properties(void)
+{
+	size_t i;
+
+	for (i = 0; i < ncolumns; i++) {
+		switch (get_column_id(i)) {
+		case COL_OWNER:
+		case COL_GROUP:
+		case COL_MODE:
+			if (lsblk->sysroot)
+				return 1;
+			break;
+		case COL_FSTYPE:
+		case COL_FSVERSION:
+		case COL_LABEL:
+		case COL_UUID:
+		case COL_PTUUID:
+		case COL_PTTYPE:
+		case COL_PARTTYPE:
+		case COL_PARTTYPENAME:
+		case COL_PARTLABEL:
+		case COL_PARTUUID:
+		case COL_PARTFLAGS:
+		case COL_WWN:
+		case COL_MODEL:
+		case COL_SERIAL:
+			return 1;
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+#endif
+
+/*
+ * Read the devices (all or the specified @devs) into a new tree, print it and
+ * return the exit status. The output table is emptied, so the function may be
+ * called more than once.
+ */
+static int scan_and_print(int ndevs, char **devs, unsigned int nworkers)
+{
+	struct lsblk_devtree *tr;
+	int status;
+
+	tr = lsblk_new_devtree();
+	if (!tr)
+		err(EXIT_FAILURE, _("failed to allocate device tree"));
+
+	if (!ndevs) {
+		int rc = lsblk->inverse ?
+			process_all_devices_inverse(tr) :
+			process_all_devices(tr);
+
+		status = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+	} else {
+		int i, cnt_err = 0;
+
+		for (i = 0; i < ndevs; i++) {
+			if (process_one_device(tr, devs[i]) != 0)
+				cnt_err++;
+		}
+		status = ndevs == cnt_err ? LSBLK_EXIT_ALLFAILED :/* all failed */
+			 cnt_err	  ? LSBLK_EXIT_SOMEOK :	  /* some ok */
+					    EXIT_SUCCESS;	  /* all success */
+	}
+
+#ifdef LSBLK_PARALLEL_PROPERTIES
+	if (nworkers > 1 && columns_need_properties())
+		lsblk_devtree_read_properties(tr, nworkers);
+#else
+	(void) nworkers;
+#endif
+	if (lsblk->dedup_id > -1) {
+		devtree_set_dedupkeys(tr, lsblk->dedup_id);
+		lsblk_devtree_deduplicate_devices(tr);
+	}
+
+	devtree_to_scols(tr, lsblk->table);
+
+	if (lsblk->sort_col)
+		scols_sort_table(lsblk->table, lsblk->sort_col);
+	if (lsblk->force_tree_order)
+		scols_sort_table_by_tree(lsblk->table);
+
+	scols_print_table(lsblk->table);
+	fflush(stdout);
+
+	scols_table_remove_lines(lsblk->table);
+	unref_sortdata();
+	lsblk_unref_devtree(tr);
+
+	return status;
+}
+
+/* returns 1 if a block device uevent has been received, 0 if not, <0 on error */
+static int read_block_uevents(int fd)
+{
+	char buf[8192];
+	int found = 0;
+
+	for (;;) {
+		ssize_t sz = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		ssize_t off;
+
+		if (sz < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS) {
+				/* dropped events; refresh anyway */
+				found = 1;
+				continue;
+			}
+			return -errno;
+		}
+		buf[sz] = '\0';
+
+		/* "action@devpath\0KEY=value\0KEY=value..." */
+		for (off = 0; !found && off < sz; off += strlen(buf + off) + 1) {
+			if (strcmp(buf + off, "SUBSYSTEM=block") == 0)
+				found = 1;
+		}
+	}
+	return found;
+}
+
+/*
+ * Print the devices, and then again after each batch of block device uevents.
+ * The tree is always rebuilt from sysfs, because any event may affect the
+ * dependencies between the devices.
+ */
+static int watch_devices(int ndevs, char **devs, unsigned int nworkers)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1		/* kernel uevents */
+	};
+	struct pollfd fds[1];
+	int fd;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		err(EXIT_FAILURE, _("cannot open uevent netlink socket"));
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+		err(EXIT_FAILURE, _("cannot bind uevent netlink socket"));
+
+	fds[0].fd = fd;
+	fds[0].events = POLLIN;
+
+	scan_and_print(ndevs, devs, nworkers);
+
+	for (;;) {
+		int rc = poll(fds, 1, -1);
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, _("poll failed"));
+		}
+
+		rc = read_block_uevents(fd);
+		if (rc < 0) {
+			errno = -rc;
+			err(EXIT_FAILURE, _("cannot read uevent"));
+		}
+		if (!rc)
+			continue;
+
+		/* events usually come in bursts (disk and partitions, ...);
+		 * wait until they settle */
+		while (poll(fds, 1, LSBLK_WATCH_SETTLE_MS) > 0) {
+			if (read_block_uevents(fd) < 0)
+				break;
+		}
+
+		/* mount tables may be changed too */
+		lsblk_mnt_deinit();
+		fputc('\n', stdout);
+		scan_and_print(ndevs, devs, nworkers);
+	}
+
+	close(fd);
+	return EXIT_SUCCESS;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -1901,6 +2104,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -J, --json           use JSON output format\n"), out);
 	fputs(_(" -O, --output-all     output all columns\n"), out);
 	fputs(_(" -P, --pairs          use key=\"value\" output format\n"), out);
+	fputs(_(" -Q, --filter <expr>  print only lines matching the expression\n"), out);
 	fputs(_(" -S, --scsi           output info about SCSI devices\n"), out);
 	fputs(_(" -T, --tree[=<column>] use tree format output\n"), out);
 	fputs(_(" -a, --all            print all devices\n"), out);
@@ -1921,7 +2125,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -w, --width <num>    specifies output width as number of characters\n"), out);
 	fputs(_(" -x, --sort <column>  sort output by <column>\n"), out);
 	fputs(_(" -z, --zoned          print zone related information\n"), out);
+	fputs(_("     --ndjson         use newline-delimited JSON output format\n"), out);
 	fputs(_("     --sysroot <dir>  use specified directory as system root\n"), out);
+	fputs(_("     --watch          print the output again on block device changes\n"), out);
+#ifdef LSBLK_PARALLEL_PROPERTIES
+	fputs(_("     --workers <num>  read udev/blkid properties by <num> threads\n"), out);
+#endif
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(22));
 
@@ -1950,15 +2159,18 @@ int main(int argc, char *argv[])
 		.flags = LSBLK_TREE,
 		.tree_id = COL_NAME
 	};
-	struct lsblk_devtree *tr = NULL;
-	int c, status = EXIT_FAILURE;
-	char *outarg = NULL;
+	int c, status = EXIT_FAILURE, watch = 0;
+	char *outarg = NULL, *filter = NULL;
 	size_t i;
 	unsigned int width = 0;
+	unsigned int nworkers = 0;
 	int force_tree = 0, has_tree_col = 0;
 
 	enum {
-		OPT_SYSROOT = CHAR_MAX + 1
+		OPT_SYSROOT = CHAR_MAX + 1,
+		OPT_WORKERS,
+		OPT_WATCH,
+		OPT_NDJSON
 	};
 
 	static const struct option longopts[] = {
@@ -1973,6 +2185,7 @@ int main(int argc, char *argv[])
 		{ "output",     required_argument, NULL, 'o' },
 		{ "output-all", no_argument,       NULL, 'O' },
 		{ "merge",      no_argument,       NULL, 'M' },
+		{ "ndjson",     no_argument,       NULL, OPT_NDJSON },
 		{ "perms",      no_argument,       NULL, 'm' },
 		{ "noheadings",	no_argument,       NULL, 'n' },
 		{ "list",       no_argument,       NULL, 'l' },
@@ -1981,6 +2194,7 @@ int main(int argc, char *argv[])
 		{ "inverse",	no_argument,       NULL, 's' },
 		{ "fs",         no_argument,       NULL, 'f' },
 		{ "exclude",    required_argument, NULL, 'e' },
+		{ "filter",     required_argument, NULL, 'Q' },
 		{ "include",    required_argument, NULL, 'I' },
 		{ "topology",   no_argument,       NULL, 't' },
 		{ "paths",      no_argument,       NULL, 'p' },
@@ -1988,8 +2202,10 @@ int main(int argc, char *argv[])
 		{ "scsi",       no_argument,       NULL, 'S' },
 		{ "sort",	required_argument, NULL, 'x' },
 		{ "sysroot",    required_argument, NULL, OPT_SYSROOT },
+		{ "workers",    required_argument, NULL, OPT_WORKERS },
 		{ "tree",       optional_argument, NULL, 'T' },
 		{ "version",    no_argument,       NULL, 'V' },
+		{ "watch",      no_argument,       NULL, OPT_WATCH },
 		{ "width",	required_argument, NULL, 'w' },
 		{ NULL, 0, NULL, 0 },
 	};
@@ -1997,13 +2213,15 @@ int main(int argc, char *argv[])
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'D','O' },
 		{ 'I','e' },
-		{ 'J', 'P', 'r' },
+		{ 'J', 'P', 'r', OPT_NDJSON },
+		{ 'M','Q' },
 		{ 'O','S' },
 		{ 'O','f' },
 		{ 'O','m' },
 		{ 'O','o' },
 		{ 'O','t' },
 		{ 'P','T', 'l','r' },
+		{ 'Q','T' },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -2018,7 +2236,7 @@ int main(int argc, char *argv[])
 	lsblk_init_debug();
 
 	while((c = getopt_long(argc, argv,
-			       "abdDzE:e:fhJlnMmo:OpPiI:rstVST::w:x:", longopts, NULL)) != -1) {
+			       "abdDzE:e:fhJlnMmo:OpPiI:Q:rstVST::w:x:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -2144,6 +2362,15 @@ int main(int argc, char *argv[])
 		case OPT_SYSROOT:
 			lsblk->sysroot = optarg;
 			break;
+		case OPT_WORKERS:
+			nworkers = strtou32_or_err(optarg, _("invalid workers argument"));
+			break;
+		case OPT_WATCH:
+			watch = 1;
+			break;
+		case OPT_NDJSON:
+			lsblk->flags |= LSBLK_JSON | LSBLK_NDJSON;
+			break;
 		case 'E':
 			lsblk->dedup_id = column_name_to_id(optarg, strlen(optarg));
 			if (lsblk->dedup_id >= 0)
@@ -2153,6 +2380,10 @@ int main(int argc, char *argv[])
 		case 'w':
 			width = strtou32_or_err(optarg, _("invalid output width number argument"));
 			break;
+		case 'Q':
+			lsblk->flags &= ~LSBLK_TREE; /* disable the default */
+			filter = optarg;
+			break;
 		case 'x':
 			lsblk->flags &= ~LSBLK_TREE; /* disable the default */
 			lsblk->sort_id = column_name_to_id(optarg, strlen(optarg));
@@ -2197,8 +2428,9 @@ int main(int argc, char *argv[])
 		 * /sys is no more sorted */
 		lsblk->sort_id = COL_MAJMIN;
 
-	/* For --{inverse,raw,pairs} --list we still follow parent->child relation */
-	if (!(lsblk->flags & LSBLK_TREE)
+	/* For --{inverse,raw,pairs} --list we still follow parent->child relation,
+	 * but not for --filter, the lines are without relations */
+	if (!(lsblk->flags & LSBLK_TREE) && !filter
 	    && (lsblk->inverse || lsblk->flags & LSBLK_EXPORT || lsblk->flags & LSBLK_RAW))
 		lsblk->force_tree_order = 1;
 
@@ -2227,6 +2459,14 @@ int main(int argc, char *argv[])
 	scols_table_enable_export(lsblk->table, !!(lsblk->flags & LSBLK_EXPORT));
 	scols_table_enable_ascii(lsblk->table, !!(lsblk->flags & LSBLK_ASCII));
 	scols_table_enable_json(lsblk->table, !!(lsblk->flags & LSBLK_JSON));
+	if (lsblk->flags & LSBLK_NDJSON) {
+		scols_table_enable_ndjson(lsblk->table, 1);
+
+		/* print the lines as soon as they are complete if the table
+		 * is not reordered and the lines are not grouped */
+		if (lsblk->sort_id < 0 && !lsblk->force_tree_order && !lsblk->merge)
+			scols_table_enable_streaming(lsblk->table, 1);
+	}
 	scols_table_enable_noheadings(lsblk->table, !!(lsblk->flags & LSBLK_NOHEADINGS));
 
 	if (lsblk->flags & LSBLK_JSON)
@@ -2307,53 +2547,29 @@ int main(int argc, char *argv[])
 		}
 	}
 
-	tr = lsblk_new_devtree();
-	if (!tr)
-		err(EXIT_FAILURE, _("failed to allocate device tree"));
-
-	if (optind == argc) {
-		int rc = lsblk->inverse ?
-			process_all_devices_inverse(tr) :
-			process_all_devices(tr);
-
-		status = rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
-	} else {
-		int cnt = 0, cnt_err = 0;
-
-		while (optind < argc) {
-			if (process_one_device(tr, argv[optind++]) != 0)
-				cnt_err++;
-			cnt++;
-		}
-		status = cnt == 0	? EXIT_FAILURE :	/* nothing */
-			 cnt == cnt_err	? LSBLK_EXIT_ALLFAILED :/* all failed */
-			 cnt_err	? LSBLK_EXIT_SOMEOK :	/* some ok */
-					  EXIT_SUCCESS;		/* all success */
-	}
-
-	if (lsblk->dedup_id > -1) {
-		devtree_set_dedupkeys(tr, lsblk->dedup_id);
-		lsblk_devtree_deduplicate_devices(tr);
+	if (filter) {
+		lsblk->filter = scols_new_filter();
+		if (!lsblk->filter)
+			err(EXIT_FAILURE, _("failed to allocate filter"));
+		if (scols_filter_parse_string(lsblk->filter, filter) != 0
+		    || scols_table_set_filter(lsblk->table, lsblk->filter) != 0)
+			errx(EXIT_FAILURE, _("failed to use filter: %s"),
+					scols_filter_get_errmsg(lsblk->filter));
 	}
 
-	devtree_to_scols(tr, lsblk->table);
-
-	if (lsblk->sort_col)
-		scols_sort_table(lsblk->table, lsblk->sort_col);
-	if (lsblk->force_tree_order)
-		scols_sort_table_by_tree(lsblk->table);
-
-	scols_print_table(lsblk->table);
+	if (watch)
+		status = watch_devices(argc - optind, argv + optind, nworkers);
+	else
+		status = scan_and_print(argc - optind, argv + optind, nworkers);
 
 leave:
-	if (lsblk->sort_col)
-		unref_sortdata(lsblk->table);
+	unref_sortdata();
+	scols_unref_filter(lsblk->filter);
 
 	scols_unref_table(lsblk->table);
 
 	lsblk_mnt_deinit();
 	lsblk_properties_deinit();
-	lsblk_unref_devtree(tr);
 
 	return status;
 }
@@ -18,6 +18,12 @@
 #include "list.h"
 #include "debug.h"
 
+/* the properties are read by threads, udev handler is thread-local */
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_TLS)
+# define LSBLK_PARALLEL_PROPERTIES 1
+# include <pthread.h>
+#endif
+
 #define LSBLK_DEBUG_INIT	(1 << 1)
 #define LSBLK_DEBUG_FILTER	(1 << 2)
 #define LSBLK_DEBUG_DEV		(1 << 3)
@@ -35,6 +41,10 @@ UL_DEBUG_DECLARE_MASK(lsblk);
 struct lsblk {
 	struct libscols_table *table;	/* output table */
 	struct libscols_column *sort_col;/* sort output by this column */
+	struct libscols_filter *filter;	/* print only matching lines */
+
+	uint64_t **sortdata;		/* cells userdata for sort_col */
+	size_t nsortdata;
 
 	int sort_id;			/* id of the sort column */
 	int tree_id;			/* od of column used for tree */
@@ -217,6 +227,9 @@ extern struct libmnt_fs **lsblk_device_get_filesystems(struct lsblk_device *dev,
 extern void lsblk_device_free_properties(struct lsblk_devprop *p);
 extern struct lsblk_devprop *lsblk_device_get_properties(struct lsblk_device *dev);
 extern void lsblk_properties_deinit(void);
+#ifdef LSBLK_PARALLEL_PROPERTIES
+extern void lsblk_devtree_read_properties(struct lsblk_devtree *tr, unsigned int nworkers);
+#endif
 
 extern const char *lsblk_parttype_code_to_string(const char *code, const char *pttype);
 
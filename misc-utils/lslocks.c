@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <search.h>
 
 #include <libmount.h>
 #include <libsmartcols.h>
@@ -89,6 +90,29 @@ static pid_t pid = 0;
 
 static struct libmnt_table *tab;		/* /proc/self/mountinfo */
 
+/* read PATH and SIZE from /proc/<pid>/fd */
+static int need_files;
+
+/* open file of a process, see get_filename_sz() */
+struct lock_file {
+	ino_t ino;
+	int fd;
+	uint64_t size;
+	char *path;		/* readlink() result, on demand */
+};
+
+/* the process data are shared by all locks of the process */
+struct lock_proc {
+	pid_t pid;
+	char *cmdname;
+
+	struct lock_file *files;	/* sorted by inode */
+	size_t nfiles;
+	unsigned int files_read : 1;
+};
+
+static void *procs;		/* tsearch() tree of struct lock_proc */
+
 /* basic output flags */
 static int no_headings;
 static int no_inaccessible;
@@ -155,65 +179,136 @@ static char *get_fallback_filename(dev_t dev)
 	return res;
 }
 
+static int cmp_proc(const void *a, const void *b)
+{
+	pid_t x = ((const struct lock_proc *) a)->pid,
+	      y = ((const struct lock_proc *) b)->pid;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int cmp_file(const void *a, const void *b)
+{
+	ino_t x = ((const struct lock_file *) a)->ino,
+	      y = ((const struct lock_file *) b)->ino;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void free_proc(void *data)
+{
+	struct lock_proc *pr = data;
+	size_t i;
+
+	for (i = 0; i < pr->nfiles; i++)
+		free(pr->files[i].path);
+	free(pr->files);
+	free(pr->cmdname);
+	free(pr);
+}
+
+static struct lock_proc *get_proc(pid_t lock_pid)
+{
+	struct lock_proc key = { .pid = lock_pid }, *pr, **node;
+
+	node = tfind(&key, &procs, cmp_proc);
+	if (node)
+		return *node;
+
+	pr = xcalloc(1, sizeof(*pr));
+	pr->pid = lock_pid;
+	pr->cmdname = proc_get_command_name(lock_pid);
+	if (!pr->cmdname)
+		pr->cmdname = xstrdup(_("(unknown)"));
+
+	if (!tsearch(pr, &procs, cmp_proc))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
+	return pr;
+}
+
 /*
- * Return the absolute path of a file from
- * a given inode number (and its size)
+ * Read inodes and sizes of all open files of the process, only once for
+ * all locks of the process. The links are read later on demand.
  */
-static char *get_filename_sz(ino_t inode, pid_t lock_pid, size_t *size)
+static void read_proc_files(struct lock_proc *pr)
 {
 	struct stat sb;
 	struct dirent *dp;
 	DIR *dirp;
-	size_t len;
-	int fd;
-	char path[PATH_MAX], sym[PATH_MAX], *ret = NULL;
+	size_t nalloc = 0;
+	char path[PATH_MAX];
 
-	*size = 0;
-	memset(path, 0, sizeof(path));
-	memset(sym, 0, sizeof(sym));
+	pr->files_read = 1;
 
 	/*
 	 * We know the pid so we don't have to
 	 * iterate the *entire* filesystem searching
 	 * for the damn file.
 	 */
-	snprintf(path, sizeof(path), "/proc/%d/fd/", lock_pid);
+	snprintf(path, sizeof(path), "/proc/%d/fd/", pr->pid);
 	if (!(dirp = opendir(path)))
-		return NULL;
-
-	if ((len = strlen(path)) >= (sizeof(path) - 2))
-		goto out;
-
-	if ((fd = dirfd(dirp)) < 0 )
-		goto out;
+		return;
 
 	while ((dp = readdir(dirp))) {
-		if (!strcmp(dp->d_name, ".") ||
-		    !strcmp(dp->d_name, ".."))
-			continue;
+		struct lock_file *f;
+		long num;
 
 		errno = 0;
 
 		/* care only for numerical descriptors */
-		if (!strtol(dp->d_name, (char **) NULL, 10) || errno)
+		num = strtol(dp->d_name, (char **) NULL, 10);
+		if (!num || errno)
 			continue;
 
-		if (!fstatat(fd, dp->d_name, &sb, 0)
-		    && inode != sb.st_ino)
+		if (fstatat(dirfd(dirp), dp->d_name, &sb, 0) != 0)
 			continue;
 
-		if ((len = readlinkat(fd, dp->d_name, sym, sizeof(sym) - 1)) < 1)
-			goto out;
+		if (pr->nfiles == nalloc) {
+			nalloc = nalloc ? nalloc * 2 : 16;
+			pr->files = xrealloc(pr->files, nalloc * sizeof(*pr->files));
+		}
+		f = &pr->files[pr->nfiles++];
+		f->ino = sb.st_ino;
+		f->fd = (int) num;
+		f->size = sb.st_size;
+		f->path = NULL;
+	}
+	closedir(dirp);
 
-		*size = sb.st_size;
-		sym[len] = '\0';
+	if (pr->nfiles > 1)
+		qsort(pr->files, pr->nfiles, sizeof(*pr->files), cmp_file);
+}
+
+/*
+ * Return the absolute path of a file from
+ * a given inode number (and its size)
+ */
+static char *get_filename_sz(ino_t inode, struct lock_proc *pr, size_t *size)
+{
+	struct lock_file key = { .ino = inode }, *f;
+
+	*size = 0;
+
+	if (!pr->files_read)
+		read_proc_files(pr);
+
+	f = bsearch(&key, pr->files, pr->nfiles, sizeof(*pr->files), cmp_file);
+	if (!f)
+		return NULL;
+
+	if (!f->path) {
+		char path[PATH_MAX], sym[PATH_MAX];
+		ssize_t len;
 
-		ret = xstrdup(sym);
-		break;
+		snprintf(path, sizeof(path), "/proc/%d/fd/%d", pr->pid, f->fd);
+		if ((len = readlink(path, sym, sizeof(sym) - 1)) < 1)
+			return NULL;
+		sym[len] = '\0';
+		f->path = xstrdup(sym);
 	}
-out:
-	closedir(dirp);
-	return ret;
+
+	*size = f->size;
+	return xstrdup(f->path);
 }
 
 /*
@@ -238,6 +333,7 @@ static int get_local_locks(struct list_head *locks)
 	char buf[PATH_MAX], *tok = NULL;
 	size_t sz;
 	struct lock *l;
+	struct lock_proc *pr;
 	dev_t dev = 0;
 
 	if (!(fp = fopen(_PATH_PROC_LOCKS, "r")))
@@ -247,6 +343,7 @@ static int get_local_locks(struct list_head *locks)
 
 		l = xcalloc(1, sizeof(*l));
 		INIT_LIST_HEAD(&l->locks);
+		pr = NULL;
 
 		for (tok = strtok(buf, " "), i = 0; tok;
 		     tok = strtok(NULL, " "), i++) {
@@ -282,9 +379,8 @@ static int get_local_locks(struct list_head *locks)
 				 */
 				l->pid = strtos32_or_err(tok, _("failed to parse pid"));
 				if (l->pid > 0) {
-					l->cmdname = proc_get_command_name(l->pid);
-					if (!l->cmdname)
-						l->cmdname = xstrdup(_("(unknown)"));
+					pr = get_proc(l->pid);
+					l->cmdname = xstrdup(pr->cmdname);
 				} else
 					l->cmdname = xstrdup(_("(undefined)"));
 				break;
@@ -309,25 +405,29 @@ static int get_local_locks(struct list_head *locks)
 			}
 		}
 
-		l->path = get_filename_sz(inode, l->pid, &sz);
+		if (need_files) {
+			l->path = pr ? get_filename_sz(inode, pr, &sz) : NULL;
 
-		/* no permissions -- ignore */
-		if (!l->path && no_inaccessible) {
-			rem_lock(l);
-			continue;
-		}
+			/* no permissions -- ignore */
+			if (!l->path && no_inaccessible) {
+				rem_lock(l);
+				continue;
+			}
 
-		if (!l->path) {
-			/* probably no permission to peek into l->pid's path */
-			l->path = get_fallback_filename(dev);
-			l->size = 0;
-		} else
-			l->size = sz;
+			if (!l->path) {
+				/* probably no permission to peek into l->pid's path */
+				l->path = get_fallback_filename(dev);
+				l->size = 0;
+			} else
+				l->size = sz;
+		}
 
 		list_add(&l->locks, locks);
 	}
 
 	fclose(fp);
+	tdestroy(procs, free_proc);
+	procs = NULL;
 	return 0;
 }
 
@@ -559,6 +659,7 @@ static void __attribute__((__noreturn__)) usage(void)
 int main(int argc, char *argv[])
 {
 	int c, rc = 0;
+	size_t i;
 	struct list_head locks;
 	char *outarg = NULL;
 	enum {
@@ -654,6 +755,14 @@ int main(int argc, char *argv[])
 
 	scols_init_debug(0);
 
+	/* the open files of the processes are scanned only if necessary */
+	need_files = no_inaccessible;
+	for (i = 0; !need_files && i < ncolumns; i++) {
+		int id = get_column_id(i);
+
+		need_files = id == COL_PATH || id == COL_SIZE;
+	}
+
 	rc = get_local_locks(&locks);
 
 	if (!rc && !list_empty(&locks))
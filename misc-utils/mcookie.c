@@ -32,12 +32,16 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
 
 enum {
 	BUFFERSIZE = 4096,
-	RAND_BYTES = 128
+	RAND_BYTES = 128,
+	READSIZE = 256 * 1024,		/* read(2) size for --max-size */
+	MAPCHUNK = 64 * 1024 * 1024	/* ul_MD5Update() size for mmap()ed files */
 };
 
 struct mcookie_control {
@@ -49,30 +53,87 @@ struct mcookie_control {
 	unsigned int verbose:1;
 };
 
+/*
+ * Hashes up to @wanted bytes of a regular file from the current position
+ * without copying the data to userspace buffers. Returns the number of
+ * hashed bytes, or -1 if the file cannot be mapped.
+ */
+static int64_t hash_mapped_file(struct mcookie_control *ctl, int fd,
+				uint64_t wanted)
+{
+	struct stat st;
+	off_t off, moff;
+	size_t len, skip, i;
+	unsigned char *map;
+
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+		return -1;
+	off = lseek(fd, 0, SEEK_CUR);
+	if (off < 0 || off >= st.st_size)
+		return -1;
+
+	if ((uint64_t) (st.st_size - off) < wanted)
+		wanted = st.st_size - off;
+	if (wanted > SIZE_MAX / 2)
+		return -1;		/* too large for the address space */
+
+	moff = off & ~((off_t) getpagesize() - 1);
+	skip = off - moff;
+	len = wanted;
+
+	map = mmap(NULL, len + skip, PROT_READ, MAP_PRIVATE, fd, moff);
+	if (map == MAP_FAILED)
+		return -1;
+#ifdef MADV_SEQUENTIAL
+	madvise(map, len + skip, MADV_SEQUENTIAL);
+#endif
+	for (i = 0; i < len; i += MAPCHUNK)
+		ul_MD5Update(&ctl->ctx, map + skip + i,
+			     min((size_t) MAPCHUNK, len - i));
+
+	munmap(map, len + skip);
+
+	/* keep the position as read(2) would do for stdin */
+	lseek(fd, off + len, SEEK_SET);
+	return len;
+}
+
 /* The basic function to hash a file */
 static uint64_t hash_file(struct mcookie_control *ctl, int fd)
 {
-	unsigned char buf[BUFFERSIZE];
-	uint64_t wanted, count;
+	unsigned char *buf;
+	size_t bufsz;
+	uint64_t wanted, count = 0;
+	int64_t mapped;
+
+	wanted = ctl->maxsz ? ctl->maxsz : BUFFERSIZE;
+
+	mapped = hash_mapped_file(ctl, fd, wanted);
+	if (mapped >= 0) {
+		count = mapped;
+		goto done;
+	}
 
-	wanted = ctl->maxsz ? ctl->maxsz : sizeof(buf);
+	bufsz = ctl->maxsz ? READSIZE : BUFFERSIZE;
+	buf = xmalloc(bufsz);
 
-	for (count = 0; count < wanted; ) {
-		size_t rdsz = sizeof(buf);
+	while (count < wanted) {
+		size_t rdsz = bufsz;
 		ssize_t r;
 
 		if (wanted - count < rdsz)
 			rdsz = wanted - count;
 
 		r = read_all(fd, (char *) buf, rdsz);
-		if (r < 0)
+		if (r <= 0)
 			break;
 		ul_MD5Update(&ctl->ctx, buf, r);
 		count += r;
 	}
+	free(buf);
+done:
 	/* Separate files with a null byte */
-	buf[0] = '\0';
-	ul_MD5Update(&ctl->ctx, buf, 1);
+	ul_MD5Update(&ctl->ctx, (unsigned char const *) "", 1);
 	return count;
 }
 
@@ -0,0 +1,144 @@
+/*
+ * ul-multicall - run several util-linux programs from one binary
+ *
+ * No copyright is claimed.  This code is in the public domain; do with
+ * it what you wish.
+ *
+ * The programs are linked into the binary with the libraries, so an exec
+ * does not need the dynamic loader to resolve and relocate libmount,
+ * libblkid and libsmartcols. The program is selected by the name the
+ * binary is executed as (usually a symlink), or by the first argument.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "c.h"
+#include "nls.h"
+#include "closestream.h"
+
+struct multicall_applet {
+	const char	*name;
+	int		(*main)(int argc, char **argv);
+};
+
+/* the applets are compiled with -Dmain=<name>_main */
+#define MULTICALL_APPLET(_name) \
+	extern int _name ## _main(int argc, char **argv);
+
+#ifdef MULTICALL_BLKID
+MULTICALL_APPLET(blkid)
+#endif
+#ifdef MULTICALL_FINDMNT
+MULTICALL_APPLET(findmnt)
+#endif
+#ifdef MULTICALL_LSBLK
+MULTICALL_APPLET(lsblk)
+#endif
+#ifdef MULTICALL_MOUNT
+MULTICALL_APPLET(mount)
+#endif
+#ifdef MULTICALL_UMOUNT
+MULTICALL_APPLET(umount)
+#endif
+
+static const struct multicall_applet applets[] = {
+#ifdef MULTICALL_BLKID
+	{ "blkid",	blkid_main },
+#endif
+#ifdef MULTICALL_FINDMNT
+	{ "findmnt",	findmnt_main },
+#endif
+#ifdef MULTICALL_LSBLK
+	{ "lsblk",	lsblk_main },
+#endif
+#ifdef MULTICALL_MOUNT
+	{ "mount",	mount_main },
+#endif
+#ifdef MULTICALL_UMOUNT
+	{ "umount",	umount_main },
+#endif
+	{ NULL, NULL }
+};
+
+static const struct multicall_applet *find_applet(const char *name)
+{
+	const struct multicall_applet *ap;
+
+	for (ap = applets; ap->name; ap++) {
+		if (strcmp(ap->name, name) == 0)
+			return ap;
+	}
+	return NULL;
+}
+
+static void list_applets(FILE *out)
+{
+	const struct multicall_applet *ap;
+
+	for (ap = applets; ap->name; ap++)
+		fprintf(out, "%s\n", ap->name);
+}
+
+static void __attribute__((__noreturn__)) usage(void)
+{
+	FILE *out = stdout;
+
+	fputs(USAGE_HEADER, out);
+	fprintf(out, _(" %s <program> [<argument> ...]\n"),
+		program_invocation_short_name);
+	fprintf(out, _(" <program> [<argument> ...]\n"));
+
+	fputs(USAGE_SEPARATOR, out);
+	fputs(_("Run a util-linux program linked into this binary.\n"), out);
+
+	fputs(USAGE_OPTIONS, out);
+	fputs(_(" -l, --list          list the available programs\n"), out);
+	fprintf(out, USAGE_HELP_OPTIONS(21));
+	fprintf(out, USAGE_MAN_TAIL("ul-multicall(1)"));
+	exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char **argv)
+{
+	const struct multicall_applet *ap;
+	const char *name;
+
+	name = strrchr(argv[0], '/');
+	name = name ? name + 1 : argv[0];
+
+	ap = find_applet(name);
+	if (ap)
+		return ap->main(argc, argv);
+
+	setlocale(LC_ALL, "");
+	bindtextdomain(PACKAGE, LOCALEDIR);
+	textdomain(PACKAGE);
+
+	if (argc < 2) {
+		warnx(_("no program specified"));
+		errtryhelp(EXIT_FAILURE);
+	}
+	if (!strcmp(argv[1], "-h") || !strcmp(argv[1], "--help"))
+		usage();
+	if (!strcmp(argv[1], "-V") || !strcmp(argv[1], "--version"))
+		print_version(EXIT_SUCCESS);
+	if (!strcmp(argv[1], "-l") || !strcmp(argv[1], "--list")) {
+		close_stdout_atexit();
+		list_applets(stdout);
+		return EXIT_SUCCESS;
+	}
+
+	ap = find_applet(argv[1]);
+	if (!ap)
+		errx(EXIT_FAILURE, _("unsupported program: %s"), argv[1]);
+
+	/* the messages of the program have to use its name */
+#ifdef HAVE_PROGRAM_INVOCATION_SHORT_NAME
+	program_invocation_name = argv[1];
+	program_invocation_short_name = argv[1];
+#elif defined(HAVE___PROGNAME)
+	__progname = argv[1];
+#endif
+	return ap->main(argc - 1, argv + 1);
+}
@@ -26,9 +26,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <search.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/param.h>
+#include <sys/resource.h>
 #include <pwd.h>
 #include <grp.h>
 
@@ -50,6 +53,22 @@
 #define NAMEI_OWNERS	(1 << 4)
 #define NAMEI_VERTICAL	(1 << 5)
 
+/*
+ * Cached result of lstat() and readlink() for a path component; the paths
+ * of all the arguments share the cache, so common prefixes are resolved
+ * only once. The components are looked up by fstatat() relative to the
+ * O_PATH descriptor of the parent directory.
+ */
+struct namei_dent {
+	struct namei_dent *parent;	/* NULL for "/" and the working directory */
+	char		*name;
+	struct stat	st;
+	int		noent;		/* errno from lstat() */
+	char		*symlink;	/* readlink() result */
+	size_t		symlinksz;
+	int		fd;		/* O_PATH descriptor of the directory */
+	unsigned int	fd_done : 1;
+};
 
 struct namei {
 	struct stat	st;		/* item lstat() */
@@ -60,12 +79,17 @@ struct namei {
 	int		level;
 	int		mountpoint;	/* is mount point */
 	int		noent;		/* this item not existing (stores errno from stat()) */
+	struct namei_dent *dent;	/* cached lookup */
 };
 
 static int flags;
 static struct idcache *gcache;	/* groupnames */
 static struct idcache *ucache;	/* usernames */
 
+static void *dents;			/* tree of struct namei_dent */
+static size_t ndirfds, maxdirfds;	/* number of cached O_PATH descriptors */
+static struct namei_dent cwd_dent = { .name = ".", .fd = AT_FDCWD, .fd_done = 1 };
+
 static void
 free_namei(struct namei *nm)
 {
@@ -81,13 +105,10 @@ free_namei(struct namei *nm)
 static void
 readlink_to_namei(struct namei *nm, const char *path)
 {
-	char sym[PATH_MAX];
-	ssize_t sz;
+	const char *sym = nm->dent->symlink;
+	size_t sz = nm->dent->symlinksz;
 	int isrel = 0;
 
-	sz = readlink(path, sym, sizeof(sym));
-	if (sz < 1)
-		err(EXIT_FAILURE, _("failed to read symlink: %s"), path);
 	if (*sym != '/') {
 		char *p = strrchr(path, '/');
 
@@ -114,6 +135,94 @@ readlink_to_namei(struct namei *nm, const char *path)
 	nm->abslink[sz] = '\0';
 }
 
+static int
+cmp_dents(const void *a, const void *b)
+{
+	const struct namei_dent *x = a, *y = b;
+
+	if (x->parent != y->parent)
+		return x->parent < y->parent ? -1 : 1;
+	return strcmp(x->name, y->name);
+}
+
+static void
+free_dent(void *data)
+{
+	struct namei_dent *d = data;
+
+	if (d->fd >= 0)
+		close(d->fd);
+	free(d->symlink);
+	free(d->name);
+	free(d);
+}
+
+/*
+ * Returns O_PATH descriptor of the directory, AT_FDCWD or -1. The number of
+ * the descriptors is limited to keep some for NSS and the output.
+ */
+static int
+dent_dirfd(struct namei_dent *d)
+{
+	if (!d->fd_done) {
+		d->fd_done = 1;
+		if (ndirfds >= maxdirfds)
+			return -1;
+		if (!d->parent)			/* "/" */
+			d->fd = open("/", O_PATH | O_DIRECTORY | O_CLOEXEC);
+		else if (d->parent->fd >= 0 || d->parent->fd == AT_FDCWD)
+			d->fd = openat(d->parent->fd, d->name,
+				       O_PATH | O_DIRECTORY | O_CLOEXEC);
+		if (d->fd >= 0)
+			ndirfds++;
+	}
+	return d->fd;
+}
+
+/*
+ * Returns cached lstat() of @name in the directory @dir, or of "/" if @dir
+ * is NULL. The full @path of the component is used if the directory cannot
+ * be opened (e.g. no more file descriptors), then the result is the same
+ * as before the cache.
+ */
+static struct namei_dent *
+lookup_dent(struct namei_dent *dir, const char *path, const char *name)
+{
+	struct namei_dent key = { .parent = dir, .name = (char *) name }, *d;
+	void **x = tfind(&key, &dents, cmp_dents);
+	char sym[PATH_MAX];
+	ssize_t sz;
+	int dfd;
+
+	if (x)
+		return *x;
+
+	d = xcalloc(1, sizeof(*d));
+	d->parent = dir;
+	d->name = xstrdup(name);
+	d->fd = -1;
+	tsearch(d, &dents, cmp_dents);
+
+	dfd = dir ? dent_dirfd(dir) : -1;
+
+	if (dfd == -1 ? lstat(path, &d->st) != 0 :
+	    fstatat(dfd, name, &d->st, AT_SYMLINK_NOFOLLOW) != 0) {
+		d->noent = errno;
+		return d;
+	}
+	if (!S_ISLNK(d->st.st_mode))
+		return d;
+
+	sz = dfd == -1 ? readlink(path, sym, sizeof(sym)) :
+			 readlinkat(dfd, name, sym, sizeof(sym));
+	if (sz < 1)
+		err(EXIT_FAILURE, _("failed to read symlink: %s"), path);
+	d->symlink = xmalloc(sz);
+	memcpy(d->symlink, sym, sz);
+	d->symlinksz = sz;
+	return d;
+}
+
 static struct stat *
 dotdot_stat(const char *dirname, struct stat *st)
 {
@@ -138,7 +247,8 @@ dotdot_stat(const char *dirname, struct stat *st)
 }
 
 static struct namei *
-new_namei(struct namei *parent, const char *path, const char *fname, int lev)
+new_namei(struct namei *parent, struct namei_dent *dir,
+	  const char *path, const char *fname, int lev)
 {
 	struct namei *nm;
 
@@ -150,11 +260,13 @@ new_namei(struct namei *parent, const char *path, const char *fname, int lev)
 
 	nm->level = lev;
 	nm->name = xstrdup(fname);
+	nm->dent = lookup_dent(dir, path, fname);
 
-	if (lstat(path, &nm->st) != 0) {
-		nm->noent = errno;
+	if (nm->dent->noent) {
+		nm->noent = nm->dent->noent;
 		return nm;
 	}
+	nm->st = nm->dent->st;
 
 	if (S_ISLNK(nm->st.st_mode))
 		readlink_to_namei(nm, path);
@@ -180,7 +292,8 @@ new_namei(struct namei *parent, const char *path, const char *fname, int lev)
 }
 
 static struct namei *
-add_namei(struct namei *parent, const char *orgpath, int start, struct namei **last)
+add_namei(struct namei *parent, const char *orgpath, int start,
+	  struct namei_dent *dir, struct namei **last)
 {
 	struct namei *nm = NULL, *first = NULL;
 	char *fname, *end, *path;
@@ -199,7 +312,8 @@ add_namei(struct namei *parent, const char *orgpath, int start, struct namei **l
 	if (*fname == '/') {
 		while (*fname == '/')
 			fname++; /* eat extra '/' */
-		first = nm = new_namei(nm, "/", "/", level);
+		first = nm = new_namei(nm, NULL, "/", "/", level);
+		dir = nm->dent;
 	}
 
 	for (end = fname; fname && end; ) {
@@ -210,7 +324,8 @@ add_namei(struct namei *parent, const char *orgpath, int start, struct namei **l
 				*end = '\0';
 
 			/* create a new entry */
-			nm = new_namei(nm, path, fname, level);
+			nm = new_namei(nm, dir, path, fname, level);
+			dir = nm->dent;
 		} else
 			end = NULL;
 		if (!first)
@@ -251,7 +366,8 @@ follow_symlinks(struct namei *nm)
 			return -1;
 		}
 		next = nm->next;
-		nm->next = add_namei(nm, nm->abslink, nm->relstart, &last);
+		nm->next = add_namei(nm, nm->abslink, nm->relstart,
+				     nm->dent->parent, &last);
 		if (last)
 			last->next = next;
 		else
@@ -368,6 +484,7 @@ main(int argc, char **argv)
 {
 	int c;
 	int rc = EXIT_SUCCESS;
+	struct rlimit rl;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -409,6 +526,10 @@ main(int argc, char **argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
+	maxdirfds = 512;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < maxdirfds * 2)
+		maxdirfds = rl.rlim_cur / 2;
+
 	ucache = new_idcache();
 	if (!ucache)
 		err(EXIT_FAILURE, _("failed to allocate UID cache"));
@@ -424,7 +545,7 @@ main(int argc, char **argv)
 		if (stat(path, &st) != 0)
 			rc = EXIT_FAILURE;
 
-		nm = add_namei(NULL, path, 0, NULL);
+		nm = add_namei(NULL, path, 0, &cwd_dent, NULL);
 		if (nm) {
 			int sml = 0;
 			if (!(flags & NAMEI_NOLINKS))
@@ -442,6 +563,7 @@ main(int argc, char **argv)
 		}
 	}
 
+	tdestroy(dents, free_dent);
 	free_idcache(ucache);
 	free_idcache(gcache);
 
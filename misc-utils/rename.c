@@ -32,6 +32,7 @@ for i in $@; do N=`echo "$i" | sed "s/$FROM/$TO/g"`; mv "$i" "$N"; done
 #include <termios.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 
 #include "nls.h"
 #include "xalloc.h"
@@ -44,10 +45,73 @@ for i in $@; do N=`echo "$i" | sed "s/$FROM/$TO/g"`; mv "$i" "$N"; done
 #define RENAME_EXIT_NOTHING	4
 #define RENAME_EXIT_UNEXPLAINED	64
 
+#ifndef RENAME_NOREPLACE
+# define RENAME_NOREPLACE	(1 << 0)
+#endif
+
 static int tty_cbreak = 0;
 static int all = 0;
 static int last = 0;
 
+/* directory of the previous file; the files are usually from the same
+ * directory as expanded by a shell glob */
+static struct {
+	char	*path;		/* including the last '/' */
+	size_t	len;
+	int	fd;
+} lastdir = { .fd = -1 };
+
+/*
+ * The renamed directory (or symlink) may be the cached directory or its
+ * parent, so the cached path would be resolved to another directory now.
+ */
+static void drop_lastdir(void)
+{
+	if (lastdir.fd >= 0)
+		close(lastdir.fd);
+	free(lastdir.path);
+	lastdir.path = NULL;
+	lastdir.len = 0;
+	lastdir.fd = -1;
+}
+
+/*
+ * Returns O_PATH descriptor of the directory with the file @s and sets
+ * @base to the file name, or returns AT_FDCWD (and @base is @s).
+ */
+static int get_dirfd(const char *s, const char **base)
+{
+	const char *p = strrchr(s, '/');
+	size_t len;
+
+	*base = s;
+	if (!p || !*(p + 1))
+		return AT_FDCWD;
+	len = p - s + 1;
+
+	if (lastdir.len != len || strncmp(lastdir.path, s, len) != 0) {
+		drop_lastdir();
+		lastdir.path = xstrndup(s, len);
+		lastdir.len = len;
+		lastdir.fd = open(lastdir.path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+	}
+	if (lastdir.fd < 0)
+		return AT_FDCWD;
+
+	*base = p + 1;
+	return lastdir.fd;
+}
+
+static int rename_noreplace(int dfd, const char *from, const char *to)
+{
+#ifdef SYS_renameat2
+	return syscall(SYS_renameat2, dfd, from, dfd, to, RENAME_NOREPLACE);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 static int string_replace(char *from, char *to, char *s, char *orig, char **newname)
 {
 	char *p, *q, *where;
@@ -187,10 +251,17 @@ static int do_file(char *from, char *to, char *s, int verbose, int noact,
                    int nooverwrite, int interactive)
 {
 	char *newname = NULL, *file=NULL;
-	int ret = 1;
+	const char *base = s, *newbase;
+	int ret = 1, dfd = AT_FDCWD;
 	struct stat sb;
 
-	if ( faccessat(AT_FDCWD, s, F_OK, AT_SYMLINK_NOFOLLOW) != 0 &&
+	/* only the file name is modified, use the directory descriptor */
+	if (strchr(from, '/') == NULL && strchr(to, '/') == NULL) {
+		file = strrchr(s, '/');
+		dfd = get_dirfd(s, &base);
+	}
+
+	if ( faccessat(dfd, base, F_OK, AT_SYMLINK_NOFOLLOW) != 0 &&
 	     errno != EINVAL )
 	   /* Skip if AT_SYMLINK_NOFOLLOW is not supported; lstat() below will
 	      detect the access error */
@@ -199,18 +270,34 @@ static int do_file(char *from, char *to, char *s, int verbose, int noact,
 		return 2;
 	}
 
-	if (lstat(s, &sb) == -1) {
+	if (fstatat(dfd, base, &sb, AT_SYMLINK_NOFOLLOW) == -1) {
 		warn(_("stat of %s failed"), s);
 		return 2;
 	}
-	if (strchr(from, '/') == NULL && strchr(to, '/') == NULL)
-		file = strrchr(s, '/');
 	if (file == NULL)
 		file = s;
 	if (string_replace(from, to, file, s, &newname) != 0)
 		return 0;
+	newbase = newname + (base - s);
+
+	/* atomic check for the existing file if supported */
+	if (nooverwrite && !interactive && !noact) {
+		if (rename_noreplace(dfd, base, newbase) == 0)
+			goto done;
+		if (errno == EEXIST) {
+			if (verbose)
+				printf(_("Skipping existing file: `%s'\n"), newname);
+			free(newname);
+			return 0;
+		}
+		if (errno != ENOSYS && errno != EINVAL) {
+			warn(_("%s: rename to %s failed"), s, newname);
+			free(newname);
+			return 2;
+		}
+	}
 
-	if ((nooverwrite || interactive) && access(newname, F_OK) != 0)
+	if ((nooverwrite || interactive) && faccessat(dfd, newbase, F_OK, 0) != 0)
 		nooverwrite = interactive = 0;
 
 	if (nooverwrite || (interactive && (noact || ask(newname) != 0))) {
@@ -218,10 +305,13 @@ static int do_file(char *from, char *to, char *s, int verbose, int noact,
 			printf(_("Skipping existing file: `%s'\n"), newname);
 		ret = 0;
 	}
-	else if (!noact && rename(s, newname) != 0) {
+	else if (!noact && renameat(dfd, base, dfd, newbase) != 0) {
 		warn(_("%s: rename to %s failed"), s, newname);
 		ret = 2;
 	}
+done:
+	if (ret == 1 && !noact && (S_ISDIR(sb.st_mode) || S_ISLNK(sb.st_mode)))
+		drop_lastdir();
 	if (verbose && (noact || ret == 1))
 		printf("`%s' -> `%s'\n", s, newname);
 	free(newname);
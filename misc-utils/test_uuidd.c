@@ -22,11 +22,17 @@
  * to overwrite the built-in default then use:
  *
  *	make uuidd uuidgen runstatedir=/var/run
+ *
+ * The benchmark mode (-b) measures the generation throughput and latency per
+ * libuuid call for the selected UUID type (-T) and number of UUIDs per call
+ * (-n, random UUIDs only). Compare the results with and without running
+ * uuidd to see the in-process vs. daemon generation.
  */
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/shm.h>
 #include <sys/types.h>
@@ -44,6 +50,23 @@ static size_t nprocesses = 4;
 static size_t nthreads = 4;
 static size_t nobjects = 4096;
 static size_t loglev = 1;
+static size_t nbulk = 1;
+static int benchmark;
+
+enum {
+	UUID_BENCH_TIME = 0,
+	UUID_BENCH_RANDOM,
+	UUID_BENCH_MD5,
+	UUID_BENCH_SHA1
+};
+
+static const char *uuid_types[] = {
+	[UUID_BENCH_TIME]   = "time",
+	[UUID_BENCH_RANDOM] = "random",
+	[UUID_BENCH_MD5]    = "md5",
+	[UUID_BENCH_SHA1]   = "sha1"
+};
+static int bench_type = UUID_BENCH_TIME;
 
 struct processentry {
 	pid_t		pid;
@@ -72,6 +95,11 @@ typedef struct objectentry object_t;
 static int shmem_id;
 static object_t *objects;
 
+/* benchmark only; latency of the libuuid call in nanoseconds, the slot of
+ * the first object generated by the call is used */
+static int latencies_id;
+static uint64_t *latencies;
+
 
 static void __attribute__((__noreturn__)) usage(void)
 {
@@ -81,6 +109,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	printf("  -t <num>     number of nthreads (default:%zu)\n", nthreads);
 	printf("  -o <num>     number of nobjects (default:%zu)\n", nobjects);
 	printf("  -l <level>   log level (default:%zu)\n", loglev);
+	printf("  -T <type>    UUID type: time, random, md5 or sha1 (default:%s)\n",
+			uuid_types[bench_type]);
+	printf("  -n <num>     number of UUIDs per call, random only (default:%zu)\n", nbulk);
+	printf("  -b           benchmark, print throughput and latencies\n");
 	printf("  -h           display help\n");
 
 	exit(EXIT_SUCCESS);
@@ -115,9 +147,48 @@ static void remove_segment(int id, void *address)
 	     id, address));
 }
 
-static void object_uuid_create(object_t * object)
+static uint64_t get_nsec(void)
 {
-	uuid_generate_time(object->uuid);
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* creates @n UUIDs at once for the random type, otherwise @n is 1 */
+static void object_uuid_create(object_t *object, size_t n)
+{
+	switch (bench_type) {
+	case UUID_BENCH_TIME:
+		uuid_generate_time(object->uuid);
+		break;
+	case UUID_BENCH_RANDOM:
+		if (n > 1) {
+			uuid_t *uus = xmalloc(n * sizeof(uuid_t));
+			size_t i;
+
+			uuid_generate_random_n(uus, n);
+			for (i = 0; i < n; i++)
+				uuid_copy(object[i].uuid, uus[i]);
+			free(uus);
+		} else
+			uuid_generate_random(object->uuid);
+		break;
+	case UUID_BENCH_MD5:
+	case UUID_BENCH_SHA1:
+	{
+		char name[32];
+		int len;
+
+		/* the objects are unique by the index */
+		len = snprintf(name, sizeof(name), "%zu", (size_t) (object - objects));
+		if (bench_type == UUID_BENCH_MD5)
+			uuid_generate_md5(object->uuid, *uuid_get_template("dns"), name, len);
+		else
+			uuid_generate_sha1(object->uuid, *uuid_get_template("dns"), name, len);
+		break;
+	}
+	}
 }
 
 static void object_uuid_to_string(object_t * object, char **string_uuid)
@@ -135,15 +206,28 @@ static int object_uuid_compare(const void *object1, const void *object2)
 
 static void *create_uuids(thread_t *th)
 {
-	size_t i;
+	size_t i, n, end = th->index + nobjects;
+
+	for (i = th->index; i < end; i += n) {
+		uint64_t start = 0;
+		size_t k;
 
-	for (i = th->index; i < th->index + nobjects; i++) {
-		object_t *obj = &objects[i];
+		n = min(nbulk, end - i);
+		if (benchmark)
+			start = get_nsec();
 
-		object_uuid_create(obj);
-		obj->tid = th->tid;
-		obj->pid = th->proc->pid;
-		obj->idx = th->index + i;
+		object_uuid_create(&objects[i], n);
+
+		if (benchmark)
+			latencies[i] = get_nsec() - start;
+
+		for (k = i; k < i + n; k++) {
+			object_t *obj = &objects[k];
+
+			obj->tid = th->tid;
+			obj->pid = th->proc->pid;
+			obj->idx = th->index + k;
+		}
 	}
 	return NULL;
 }
@@ -264,14 +348,49 @@ static void object_dump(size_t idx, object_t *obj)
 	fprintf(stderr, "}\n");
 }
 
+static int cmp_latency(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* compacts the call latencies to the begin of the array and prints them */
+static void print_benchmark(uint64_t nsec)
+{
+	size_t i, ncalls = 0, total = nprocesses * nthreads * nobjects;
+
+	for (i = 0; i < total; i++) {
+		if (latencies[i])
+			latencies[ncalls++] = latencies[i];
+	}
+
+	printf("%s: %zu UUIDs in %.3f ms, %.0f UUIDs/sec\n",
+			uuid_types[bench_type], total, nsec / 1000000.0,
+			nsec ? total * 1000000000.0 / nsec : 0);
+	if (!ncalls)
+		return;
+
+	qsort(latencies, ncalls, sizeof(uint64_t), cmp_latency);
+	printf("latency per call (%zu UUIDs): "
+	       "p50 %ju ns, p90 %ju ns, p99 %ju ns, p99.9 %ju ns, max %ju ns\n",
+			nbulk,
+			(uintmax_t) latencies[ncalls * 50 / 100],
+			(uintmax_t) latencies[ncalls * 90 / 100],
+			(uintmax_t) latencies[ncalls * 99 / 100],
+			(uintmax_t) latencies[ncalls * 999 / 1000],
+			(uintmax_t) latencies[ncalls - 1]);
+}
+
 #define MSG_TRY_HELP "Try '-h' for help."
 
 int main(int argc, char *argv[])
 {
 	size_t i, nfailed = 0, nignored = 0;
+	uint64_t start = 0, nsec = 0;
 	int c;
 
-	while (((c = getopt(argc, argv, "p:t:o:l:h")) != -1)) {
+	while (((c = getopt(argc, argv, "p:t:o:l:T:n:bh")) != -1)) {
 		switch (c) {
 		case 'p':
 			nprocesses = strtou32_or_err(optarg, "invalid nprocesses number argument");
@@ -285,6 +404,23 @@ int main(int argc, char *argv[])
 		case 'l':
 			loglev = strtou32_or_err(optarg, "invalid log level argument");
 			break;
+		case 'T':
+			for (i = 0; i < ARRAY_SIZE(uuid_types); i++) {
+				if (strcmp(optarg, uuid_types[i]) == 0)
+					break;
+			}
+			if (i == ARRAY_SIZE(uuid_types))
+				errx(EXIT_FAILURE, "unsupported UUID type: %s", optarg);
+			bench_type = i;
+			break;
+		case 'n':
+			nbulk = strtou32_or_err(optarg, "invalid number of UUIDs per call");
+			if (!nbulk)
+				errx(EXIT_FAILURE, "number of UUIDs per call must be positive");
+			break;
+		case 'b':
+			benchmark = 1;
+			break;
 		case 'h':
 			usage();
 			break;
@@ -296,6 +432,8 @@ int main(int argc, char *argv[])
 
 	if (optind != argc)
 		errx(EXIT_FAILURE, "bad usage\n" MSG_TRY_HELP);
+	if (nbulk > 1 && bench_type != UUID_BENCH_RANDOM)
+		errx(EXIT_FAILURE, "-n is supported for random UUIDs only");
 
 	if (loglev == 1)
 		fprintf(stderr, "requested: %zu processes, %zu threads, %zu objects per thread (%zu objects = %zu bytes)\n",
@@ -306,8 +444,17 @@ int main(int argc, char *argv[])
 	allocate_segment(&shmem_id, (void **)&objects,
 			 nprocesses * nthreads * nobjects, sizeof(object_t));
 
+	if (benchmark) {
+		allocate_segment(&latencies_id, (void **)&latencies,
+			 nprocesses * nthreads * nobjects, sizeof(uint64_t));
+		start = get_nsec();
+	}
+
 	create_nprocesses();
 
+	if (benchmark)
+		nsec = get_nsec() - start;
+
 	if (loglev >= 3) {
 		for (i = 0; i < nprocesses * nthreads * nobjects; i++)
 			object_dump(i, &objects[i]);
@@ -337,6 +484,10 @@ int main(int argc, char *argv[])
 	}
 
 	remove_segment(shmem_id, objects);
+	if (benchmark) {
+		print_benchmark(nsec);
+		remove_segment(latencies_id, latencies);
+	}
 	if (nignored)
 		printf("%zu objects ignored\n", nignored);
 	if (!nfailed)
@@ -40,7 +40,7 @@
 #include <string.h>
 #include <getopt.h>
 #include <sys/signalfd.h>
-#include <poll.h>
+#include <sys/epoll.h>
 
 #include "uuid.h"
 #include "uuidd.h"
@@ -78,6 +78,28 @@ struct uuidd_cxt_t {
 			no_sock: 1;
 };
 
+/* epoll loop connection */
+enum {
+	UUIDD_CONN_SIGNAL,
+	UUIDD_CONN_LISTEN,
+	UUIDD_CONN_CLIENT
+};
+
+struct uuidd_conn_t {
+	int		type;
+	int		fd;
+	size_t		reqsz;			/* request bytes read */
+	size_t		replysz;		/* reply size, zero if not ready */
+	size_t		replyoff;		/* reply bytes written */
+	char		req[sizeof(uuidd_prot_op_t) + sizeof(uuidd_prot_num_t)];
+	char		reply[sizeof(int32_t) + UUIDD_PROT_BUFSZ];
+};
+
+/* max number of concurrently connected clients */
+#define UUIDD_MAX_CLIENTS	128
+/* max number of epoll events per epoll_wait() */
+#define UUIDD_EPOLL_EVENTS	32
+
 struct uuidd_options_t {
 	const char	 *pidfile_path;
 	const char	 *socket_path;
@@ -337,28 +359,230 @@ static void timeout_handler(int sig __attribute__((__unused__)),
 		errx(EXIT_FAILURE, _("timed out"));
 }
 
-static void server_loop(const char *socket_path, const char *pidfile_path,
-			struct uuidd_cxt_t *uuidd_cxt)
+/*
+ * Generates reply for @op to @reply_buf, returns the reply length or -1 for
+ * invalid operation.
+ */
+static int32_t process_request(const struct uuidd_cxt_t *uuidd_cxt,
+			       uuidd_prot_op_t op, uuidd_prot_num_t num,
+			       char *reply_buf, size_t bufsz)
 {
-	struct sockaddr_un	from_addr;
-	socklen_t		fromlen;
 	int32_t			reply_len = 0;
 	uuid_t			uu;
-	char			reply_buf[UUIDD_PROT_BUFSZ], *cp;
-	uuidd_prot_op_t 	op;
-	char			str[UUID_STR_LEN];
-	int			i, ns, len;
-	uuidd_prot_num_t	num;		/* intentionally uninitialized */
+	char			str[UUID_STR_LEN], *cp;
+	int			i;
+
+	switch (op) {
+	case UUIDD_OP_GETPID:
+		snprintf(reply_buf, bufsz, "%d", getpid());
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_GET_MAXOP:
+		snprintf(reply_buf, bufsz, "%d", UUIDD_MAX_OP);
+		reply_len = strlen(reply_buf) + 1;
+		break;
+	case UUIDD_OP_TIME_UUID:
+		num = 1;
+		__uuid_generate_time(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated time UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_RANDOM_UUID:
+		num = 1;
+		__uuid_generate_random(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, _("Generated random UUID: %s\n"), str);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		break;
+	case UUIDD_OP_BULK_TIME_UUID:
+		__uuid_generate_time(uu, &num);
+		if (uuidd_cxt->debug) {
+			uuid_unparse(uu, str);
+			fprintf(stderr, P_("Generated time UUID %s "
+					   "and %d following\n",
+					   "Generated time UUID %s "
+					   "and %d following\n", num - 1),
+			       str, num - 1);
+		}
+		memcpy(reply_buf, uu, sizeof(uu));
+		reply_len = sizeof(uu);
+		memcpy(reply_buf + reply_len, &num, sizeof(num));
+		reply_len += sizeof(num);
+		break;
+	case UUIDD_OP_BULK_RANDOM_UUID:
+		if (num < 0)
+			num = 1;
+		if ((bufsz - sizeof(num)) < (size_t) (sizeof(uu) * num))
+			num = (bufsz - sizeof(num)) / sizeof(uu);
+		__uuid_generate_random((unsigned char *) reply_buf +
+				      sizeof(num), &num);
+		reply_len = sizeof(num) + (sizeof(uu) * num);
+		memcpy(reply_buf, &num, sizeof(num));
+		if (uuidd_cxt->debug) {
+			fprintf(stderr, P_("Generated %d UUID:\n",
+					   "Generated %d UUIDs:\n", num), num);
+			cp = reply_buf + sizeof(num);
+			for (i = 0; i < num; i++) {
+				uuid_unparse((unsigned char *)cp, str);
+				fprintf(stderr, "\t%s\n", str);
+				cp += sizeof(uu);
+			}
+		}
+		break;
+	default:
+		if (uuidd_cxt->debug)
+			fprintf(stderr, _("Invalid operation %d\n"), op);
+		return -1;
+	}
+
+	return reply_len;
+}
+
+static void accept_clients(int efd, struct uuidd_conn_t *listenconn,
+			   size_t *nclients)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+
+	while (*nclients < UUIDD_MAX_CLIENTS) {
+		struct uuidd_conn_t *conn;
+		int ns;
+
+		ns = accept4(listenconn->fd, NULL, NULL,
+			     SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (ns < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK
+			    || errno == EINTR || errno == ECONNABORTED)
+				return;
+			err(EXIT_FAILURE, "accept");
+		}
+
+		conn = calloc(1, sizeof(*conn));
+		if (!conn) {
+			warn(_("cannot allocate client"));
+			close(ns);
+			return;
+		}
+		conn->type = UUIDD_CONN_CLIENT;
+		conn->fd = ns;
+
+		ev.data.ptr = conn;
+		if (epoll_ctl(efd, EPOLL_CTL_ADD, ns, &ev) < 0) {
+			warn(_("cannot add client to epoll"));
+			close(ns);
+			free(conn);
+			return;
+		}
+		(*nclients)++;
+	}
+
+	/* too many clients, accept more when a client is done */
+	ev.events = 0;
+	ev.data.ptr = listenconn;
+	epoll_ctl(efd, EPOLL_CTL_MOD, listenconn->fd, &ev);
+}
+
+/*
+ * Reads the client request and writes the reply. Returns 0 if the client
+ * is not complete (waiting for more data or for a writable socket),
+ * otherwise 1 and the connection has to be closed.
+ */
+static int handle_client(const struct uuidd_cxt_t *uuidd_cxt, int efd,
+			 struct uuidd_conn_t *conn)
+{
+	ssize_t len;
+
+	while (!conn->replysz) {
+		size_t need = sizeof(uuidd_prot_op_t);
+		uuidd_prot_op_t op;
+		uuidd_prot_num_t num = 0;
+		int32_t reply_len;
+
+		if (conn->reqsz >= need) {
+			op = conn->req[0];
+			if (op == UUIDD_OP_BULK_TIME_UUID ||
+			    op == UUIDD_OP_BULK_RANDOM_UUID)
+				need += sizeof(num);
+		}
+
+		if (conn->reqsz < need) {
+			len = read(conn->fd, conn->req + conn->reqsz,
+				   need - conn->reqsz);
+			if (len < 0 && (errno == EAGAIN || errno == EINTR))
+				return 0;
+			if (len <= 0) {
+				/* incomplete request is silently ignored */
+				if (!conn->reqsz && len < 0)
+					warn(_("read failed"));
+				else if (!conn->reqsz)
+					warnx(_("error reading from client, len = %zd"),
+							len);
+				return 1;
+			}
+			conn->reqsz += len;
+			continue;
+		}
+
+		/* complete request */
+		op = conn->req[0];
+		if (need > sizeof(op)) {
+			memcpy(&num, conn->req + sizeof(op), sizeof(num));
+			if (uuidd_cxt->debug)
+				fprintf(stderr, _("operation %d, incoming num = %d\n"),
+				       op, num);
+		} else if (uuidd_cxt->debug)
+			fprintf(stderr, _("operation %d\n"), op);
+
+		reply_len = process_request(uuidd_cxt, op, num,
+				conn->reply + sizeof(reply_len),
+				sizeof(conn->reply) - sizeof(reply_len));
+		if (reply_len < 0)
+			return 1;
+
+		memcpy(conn->reply, &reply_len, sizeof(reply_len));
+		conn->replysz = sizeof(reply_len) + reply_len;
+	}
+
+	while (conn->replyoff < conn->replysz) {
+		len = write(conn->fd, conn->reply + conn->replyoff,
+			    conn->replysz - conn->replyoff);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < 0 && errno == EAGAIN) {
+			struct epoll_event ev = {
+				.events = EPOLLOUT,
+				.data.ptr = conn
+			};
+			/* wait for writable socket */
+			if (epoll_ctl(efd, EPOLL_CTL_MOD, conn->fd, &ev) < 0)
+				return 1;
+			return 0;
+		}
+		if (len <= 0)
+			return 1;
+		conn->replyoff += len;
+	}
+	return 1;
+}
+
+static void server_loop(const char *socket_path, const char *pidfile_path,
+			struct uuidd_cxt_t *uuidd_cxt)
+{
+	char			reply_buf[UUIDD_PROT_BUFSZ];
 	int			s = 0;
 	int			fd_pidfile = -1;
-	int			ret;
-	struct pollfd		pfd[2];
+	int			ret, efd;
 	sigset_t		sigmask;
-	int			sigfd;
-	enum {
-				POLLFD_SIGNAL = 0,
-				POLLFD_SOCKET
-	};
+	struct uuidd_conn_t	sigconn = { .type = UUIDD_CONN_SIGNAL },
+				listenconn = { .type = UUIDD_CONN_LISTEN };
+	struct epoll_event	ev, events[UUIDD_EPOLL_EVENTS];
+	size_t			nclients = 0;
 
 #ifdef HAVE_LIBSYSTEMD
 	if (!uuidd_cxt->no_sock)	/* no_sock implies no_fork and no_pid */
@@ -431,131 +655,73 @@ static void server_loop(const char *socket_path, const char *pidfile_path,
 	/* Block signals so that they aren't handled according to their
 	 * default dispositions */
 	sigprocmask(SIG_BLOCK, &sigmask, NULL);
-	if ((sigfd = signalfd(-1, &sigmask, 0)) < 0)
+	if ((sigconn.fd = signalfd(-1, &sigmask, SFD_CLOEXEC)) < 0)
 		err(EXIT_FAILURE, _("cannot set signal handler"));
 
-	pfd[POLLFD_SIGNAL].fd = sigfd;
-	pfd[POLLFD_SOCKET].fd = s;
-	pfd[POLLFD_SIGNAL].events = pfd[POLLFD_SOCKET].events = POLLIN | POLLERR | POLLHUP;
+	/* the clients are accepted as non-blocking sockets and handled
+	 * by one epoll loop, so a slow client does not block the others */
+	listenconn.fd = s;
+	if (fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK) < 0)
+		err(EXIT_FAILURE, _("cannot set non-blocking mode"));
+
+	efd = epoll_create1(EPOLL_CLOEXEC);
+	if (efd < 0)
+		err(EXIT_FAILURE, _("cannot create epoll"));
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &sigconn;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, sigconn.fd, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot add signal handler to epoll"));
+	ev.data.ptr = &listenconn;
+	if (epoll_ctl(efd, EPOLL_CTL_ADD, s, &ev) < 0)
+		err(EXIT_FAILURE, _("cannot add socket to epoll"));
 
 	while (1) {
-		ret = poll(pfd, ARRAY_SIZE(pfd),
+		int i;
+
+		ret = epoll_wait(efd, events, ARRAY_SIZE(events),
 				uuidd_cxt->timeout ?
 					(int) uuidd_cxt->timeout * 1000 : -1);
 		if (ret < 0) {
-			if (errno == EAGAIN)
+			if (errno == EAGAIN || errno == EINTR)
 				continue;
-			warn(_("poll failed"));
+			warn(_("epoll_wait failed"));
 			all_done(uuidd_cxt, EXIT_FAILURE);
 		}
-		if (ret == 0) {		/* true when poll() times out */
+		if (ret == 0) {		/* true when epoll_wait() times out */
 			if (uuidd_cxt->debug)
 				fprintf(stderr, _("timeout [%d sec]\n"), uuidd_cxt->timeout);
 			all_done(uuidd_cxt, EXIT_SUCCESS);
 		}
-		if (pfd[POLLFD_SIGNAL].revents != 0)
-			handle_signal(uuidd_cxt, sigfd);
-		if (pfd[POLLFD_SOCKET].revents == 0)
-			continue;
-		fromlen = sizeof(from_addr);
-		ns = accept(s, (struct sockaddr *) &from_addr, &fromlen);
-		if (ns < 0) {
-			if ((errno == EAGAIN) || (errno == EINTR))
-				continue;
-			err(EXIT_FAILURE, "accept");
-		}
-		len = read(ns, &op, sizeof(op));
-		if (len != sizeof(op)) {
-			if (len < 0)
-				warn(_("read failed"));
-			else
-				warnx(_("error reading from client, len = %d"),
-						len);
-			goto shutdown_socket;
-		}
-		if ((op == UUIDD_OP_BULK_TIME_UUID) ||
-		    (op == UUIDD_OP_BULK_RANDOM_UUID)) {
-			if (read_all(ns, (char *) &num, sizeof(num)) != sizeof(num))
-				goto shutdown_socket;
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("operation %d, incoming num = %d\n"),
-				       op, num);
-		} else if (uuidd_cxt->debug)
-			fprintf(stderr, _("operation %d\n"), op);
 
-		switch (op) {
-		case UUIDD_OP_GETPID:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", getpid());
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_GET_MAXOP:
-			snprintf(reply_buf, sizeof(reply_buf), "%d", UUIDD_MAX_OP);
-			reply_len = strlen(reply_buf) + 1;
-			break;
-		case UUIDD_OP_TIME_UUID:
-			num = 1;
-			__uuid_generate_time(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated time UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_RANDOM_UUID:
-			num = 1;
-			__uuid_generate_random(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, _("Generated random UUID: %s\n"), str);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			break;
-		case UUIDD_OP_BULK_TIME_UUID:
-			__uuid_generate_time(uu, &num);
-			if (uuidd_cxt->debug) {
-				uuid_unparse(uu, str);
-				fprintf(stderr, P_("Generated time UUID %s "
-						   "and %d following\n",
-						   "Generated time UUID %s "
-						   "and %d following\n", num - 1),
-				       str, num - 1);
-			}
-			memcpy(reply_buf, uu, sizeof(uu));
-			reply_len = sizeof(uu);
-			memcpy(reply_buf + reply_len, &num, sizeof(num));
-			reply_len += sizeof(num);
-			break;
-		case UUIDD_OP_BULK_RANDOM_UUID:
-			if (num < 0)
-				num = 1;
-			if ((sizeof(reply_buf) - sizeof(num)) < (size_t) (sizeof(uu) * num))
-				num = (sizeof(reply_buf) - sizeof(num)) / sizeof(uu);
-			__uuid_generate_random((unsigned char *) reply_buf +
-					      sizeof(num), &num);
-			reply_len = sizeof(num) + (sizeof(uu) * num);
-			memcpy(reply_buf, &num, sizeof(num));
-			if (uuidd_cxt->debug) {
-				fprintf(stderr, P_("Generated %d UUID:\n",
-						   "Generated %d UUIDs:\n", num), num);
-				cp = reply_buf + sizeof(num);
-				for (i = 0; i < num; i++) {
-					uuid_unparse((unsigned char *)cp, str);
-					fprintf(stderr, "\t%s\n", str);
-					cp += sizeof(uu);
+		for (i = 0; i < ret; i++) {
+			struct uuidd_conn_t *conn = events[i].data.ptr;
+
+			switch (conn->type) {
+			case UUIDD_CONN_SIGNAL:
+				handle_signal(uuidd_cxt, conn->fd);
+				break;
+			case UUIDD_CONN_LISTEN:
+				if (events[i].events & EPOLLIN)
+					accept_clients(efd, conn, &nclients);
+				break;
+			case UUIDD_CONN_CLIENT:
+				if (handle_client(uuidd_cxt, efd, conn) == 0)
+					break;
+				close(conn->fd);
+				free(conn);
+
+				/* accept again if the limit has been reached */
+				if (nclients == UUIDD_MAX_CLIENTS) {
+					ev.events = EPOLLIN;
+					ev.data.ptr = &listenconn;
+					epoll_ctl(efd, EPOLL_CTL_MOD, s, &ev);
 				}
+				nclients--;
+				break;
 			}
-			break;
-		default:
-			if (uuidd_cxt->debug)
-				fprintf(stderr, _("Invalid operation %d\n"), op);
-			goto shutdown_socket;
 		}
-		write_all(ns, (char *) &reply_len, sizeof(num));
-		write_all(ns, reply_buf, reply_len);
-	shutdown_socket:
-		close(ns);
 	}
 }
 
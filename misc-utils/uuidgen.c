@@ -17,6 +17,11 @@
 #include "nls.h"
 #include "c.h"
 #include "closestream.h"
+#include "strutils.h"
+#include "xalloc.h"
+
+/* number of UUIDs generated and written at once for --count */
+#define UUIDGEN_CHUNK	1024
 
 static void __attribute__((__noreturn__)) usage(void)
 {
@@ -37,6 +42,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -m, --md5           generate md5 hash\n"), out);
 	fputs(_(" -s, --sha1          generate sha1 hash\n"), out);
 	fputs(_(" -x, --hex           interpret name as hex string\n"), out);
+	fputs(_(" -C, --count num     generate more uuids\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(21));
 	printf(USAGE_MAN_TAIL("uuidgen(1)"));
@@ -79,15 +85,56 @@ badstring:
 	return value2;
 }
 
+/*
+ * Generates @n UUIDs of @type to @uus; the hash-based UUIDs are already in
+ * @uus[0] (the result is always the same).
+ */
+static void generate_uuids(int type, uuid_t *uus, size_t n)
+{
+	size_t i;
+
+	switch (type) {
+	case UUID_TYPE_DCE_TIME:
+		for (i = 0; i < n; i++)
+			uuid_generate_time(uus[i]);
+		break;
+	case UUID_TYPE_DCE_RANDOM:
+		uuid_generate_random_n(uus, n);
+		break;
+	case UUID_TYPE_DCE_MD5:
+	case UUID_TYPE_DCE_SHA1:
+		for (i = 1; i < n; i++)
+			uuid_copy(uus[i], uus[0]);
+		break;
+	default:
+		for (i = 0; i < n; i++)
+			uuid_generate(uus[i]);
+		break;
+	}
+}
+
+/* writes @n UUIDs by one fwrite(), @buf is n * UUID_STR_LEN bytes */
+static void print_uuids(uuid_t *uus, size_t n, char *buf)
+{
+	char *p = buf;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		uuid_unparse(uus[i], p);
+		p += UUID_STR_LEN;
+		*(p - 1) = '\n';
+	}
+	fwrite(buf, 1, p - buf, stdout);
+}
+
 int
 main (int argc, char *argv[])
 {
 	int    c;
 	int    do_type = 0, is_hex = 0;
-	char   str[UUID_STR_LEN];
-	char   *namespace = NULL, *name = NULL;
-	size_t namelen = 0;
-	uuid_t ns, uu;
+	char   *namespace = NULL, *name = NULL, *buf;
+	size_t namelen = 0, count = 1, chunk;
+	uuid_t ns, *uus;
 
 	static const struct option longopts[] = {
 		{"random", no_argument, NULL, 'r'},
@@ -99,6 +146,7 @@ main (int argc, char *argv[])
 		{"md5", no_argument, NULL, 'm'},
 		{"sha1", no_argument, NULL, 's'},
 		{"hex", no_argument, NULL, 'x'},
+		{"count", required_argument, NULL, 'C'},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -107,7 +155,7 @@ main (int argc, char *argv[])
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "rtVhn:N:msx", longopts, NULL)) != -1)
+	while ((c = getopt_long(argc, argv, "rtVhn:N:msxC:", longopts, NULL)) != -1)
 		switch (c) {
 		case 't':
 			do_type = UUID_TYPE_DCE_TIME;
@@ -130,6 +178,9 @@ main (int argc, char *argv[])
 		case 'x':
 			is_hex = 1;
 			break;
+		case 'C':
+			count = strtou32_or_err(optarg, _("invalid count argument"));
+			break;
 
 		case 'h':
 			usage();
@@ -165,15 +216,10 @@ main (int argc, char *argv[])
 			name = unhex(name, &namelen);
 	}
 
-	switch (do_type) {
-	case UUID_TYPE_DCE_TIME:
-		uuid_generate_time(uu);
-		break;
-	case UUID_TYPE_DCE_RANDOM:
-		uuid_generate_random(uu);
-		break;
-	case UUID_TYPE_DCE_MD5:
-	case UUID_TYPE_DCE_SHA1:
+	chunk = max((size_t) 1, min(count, (size_t) UUIDGEN_CHUNK));
+	uus = xmalloc(chunk * sizeof(uuid_t));
+
+	if (do_type == UUID_TYPE_DCE_MD5 || do_type == UUID_TYPE_DCE_SHA1) {
 		if (namespace[0] == '@' && namespace[1] != '\0') {
 			const uuid_t *uuidptr;
 
@@ -190,18 +236,23 @@ main (int argc, char *argv[])
 			}
 		}
 		if (do_type == UUID_TYPE_DCE_MD5)
-			uuid_generate_md5(uu, ns, name, namelen);
+			uuid_generate_md5(uus[0], ns, name, namelen);
 		else
-			uuid_generate_sha1(uu, ns, name, namelen);
-		break;
-	default:
-		uuid_generate(uu);
-		break;
+			uuid_generate_sha1(uus[0], ns, name, namelen);
 	}
 
-	uuid_unparse(uu, str);
+	buf = xmalloc(chunk * UUID_STR_LEN);
+
+	while (count > 0) {
+		size_t n = min(count, chunk);
+
+		generate_uuids(do_type, uus, n);
+		print_uuids(uus, n, buf);
+		count -= n;
+	}
 
-	printf("%s\n", str);
+	free(buf);
+	free(uus);
 
 	if (is_hex)
 		free(name);
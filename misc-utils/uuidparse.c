@@ -55,6 +55,9 @@
 #include "timeutils.h"
 #include "xalloc.h"
 
+/* number of lines used to calculate column widths, the rest is streamed */
+#define UUIDPARSE_STREAM_SAMPLE	1000
+
 /* column IDs */
 enum {
 	COL_UUID = 0,
@@ -258,6 +261,11 @@ static void print_output(struct control const *const ctrl, int argc,
 	scols_table_enable_noheadings(tb, ctrl->no_headings);
 	scols_table_enable_raw(tb, ctrl->raw);
 
+	/* print the lines continuously, the widths are calculated from the
+	 * width hints and the first lines only */
+	scols_table_enable_streaming(tb, 1);
+	scols_table_set_streaming_sample(tb, UUIDPARSE_STREAM_SAMPLE);
+
 	for (i = 0; i < ncolumns; i++) {
 		const struct colinfo *col = get_column_info(i);
 
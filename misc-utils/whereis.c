@@ -86,6 +86,12 @@ enum {
 	ALL_DIRS = BIN_DIR | MAN_DIR | SRC_DIR
 };
 
+/* directory entry in the lookup index */
+struct wh_name {
+	const char	*key;		/* name, or name without "s." prefix */
+	size_t		pos;		/* index to wh_dirlist->names[] */
+};
+
 /* directories */
 struct wh_dirlist {
 	int	type;
@@ -93,6 +99,14 @@ struct wh_dirlist {
 	ino_t	st_ino;
 	char	*path;
 
+	/* the directory is read only once, names are kept in readdir() order
+	 * and the index is sorted by the key for the lookups */
+	char		**names;
+	size_t		nnames;
+	struct wh_name	*index;
+	size_t		nindex;
+	unsigned int	scanned : 1;
+
 	struct wh_dirlist *next;
 };
 
@@ -377,6 +391,10 @@ static void free_dirlist(struct wh_dirlist **ls0, int type)
 		if (ls->type & type) {
 			next = ls->next;
 			DBG(LIST, ul_debugobj(*ls0, " free: %s", ls->path));
+			while (ls->nnames > 0)
+				free(ls->names[--ls->nnames]);
+			free(ls->names);
+			free(ls->index);
 			free(ls->path);
 			free(ls);
 			ls = next;
@@ -427,34 +445,125 @@ static int filename_equal(const char *cp, const char *dp, int type)
 	return 0;
 }
 
-static void findin(const char *dir, const char *pattern, int *count,
-		   char **wait, int type)
+static int cmp_names(const void *a, const void *b)
+{
+	return strcmp(((const struct wh_name *) a)->key,
+		      ((const struct wh_name *) b)->key);
+}
+
+static int cmp_pos(const void *a, const void *b)
+{
+	size_t x = *(const size_t *) a, y = *(const size_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void index_add(struct wh_dirlist *ls, const char *key, size_t pos)
+{
+	if (ls->nindex % 256 == 0)
+		ls->index = xrealloc(ls->index,
+				(ls->nindex + 256) * sizeof(struct wh_name));
+	ls->index[ls->nindex].key = key;
+	ls->index[ls->nindex].pos = pos;
+	ls->nindex++;
+}
+
+/* reads the directory and creates the lookup index */
+static void scan_dir(struct wh_dirlist *ls)
 {
 	DIR *dirp;
 	struct dirent *dp;
 
-	dirp = opendir(dir);
+	ls->scanned = 1;
+
+	dirp = opendir(ls->path);
 	if (dirp == NULL)
 		return;
 
-	DBG(SEARCH, ul_debug("find '%s' in '%s'", pattern, dir));
+	DBG(SEARCH, ul_debug("scan '%s'", ls->path));
 
 	while ((dp = readdir(dirp)) != NULL) {
-		if (!filename_equal(pattern, dp->d_name, type))
+		char *name = xstrdup(dp->d_name);
+
+		if (ls->nnames % 256 == 0)
+			ls->names = xrealloc(ls->names,
+					(ls->nnames + 256) * sizeof(char *));
+		ls->names[ls->nnames] = name;
+
+		index_add(ls, name, ls->nnames);
+		/* sources may be prefixed by "s.", see filename_equal() */
+		if ((ls->type & SRC_DIR) && name[0] == 's' && name[1] == '.')
+			index_add(ls, name + 2, ls->nnames);
+		ls->nnames++;
+	}
+	closedir(dirp);
+
+	qsort(ls->index, ls->nindex, sizeof(struct wh_name), cmp_names);
+}
+
+/*
+ * All the names matched by filename_equal() begin with the pattern, so only
+ * the range of the index with the pattern prefix is compared. The matches
+ * are printed in the readdir() order as before.
+ */
+static void findin(struct wh_dirlist *ls, const char *pattern, int *count,
+		   char **wait)
+{
+	size_t lo = 0, hi, i, n = 0, *found = NULL;
+	size_t len = strlen(pattern);
+
+	if (!ls->scanned)
+		scan_dir(ls);
+	if (!ls->nindex)
+		return;
+
+	DBG(SEARCH, ul_debug("find '%s' in '%s'", pattern, ls->path));
+
+	/* the first key >= pattern */
+	hi = ls->nindex;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (strcmp(ls->index[mid].key, pattern) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo; i < ls->nindex; i++) {
+		const struct wh_name *nm = &ls->index[i];
+
+		if (strncmp(nm->key, pattern, len) != 0)
+			break;
+		if (!filename_equal(pattern, ls->names[nm->pos], ls->type))
 			continue;
+		if (n % 16 == 0)
+			found = xrealloc(found, (n + 16) * sizeof(size_t));
+		found[n++] = nm->pos;
+	}
+
+	if (n > 1)
+		qsort(found, n, sizeof(size_t), cmp_pos);
+
+	for (i = 0; i < n; i++) {
+		const char *name;
+
+		if (i && found[i] == found[i - 1])
+			continue;	/* matched by both keys */
+		name = ls->names[found[i]];
 
 		if (uflag && *count == 0)
-			xasprintf(wait, "%s/%s", dir, dp->d_name);
+			xasprintf(wait, "%s/%s", ls->path, name);
 
 		else if (uflag && *count == 1 && *wait) {
-			printf("%s: %s %s/%s", pattern, *wait, dir,  dp->d_name);
+			printf("%s: %s %s/%s", pattern, *wait, ls->path, name);
 			free(*wait);
 			*wait = NULL;
 		} else
-			printf(" %s/%s", dir, dp->d_name);
+			printf(" %s/%s", ls->path, name);
 		++(*count);
 	}
-	closedir(dirp);
+	free(found);
 }
 
 static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
@@ -480,7 +589,7 @@ static void lookup(const char *pattern, struct wh_dirlist *ls, int want)
 
 	for (; ls; ls = ls->next) {
 		if ((ls->type & want) && ls->path)
-			findin(ls->path, patbuf, &count, &wait, ls->type);
+			findin(ls, patbuf, &count, &wait);
 	}
 
 	free(wait);
@@ -34,6 +34,10 @@
 #include <blkid.h>
 #include <libsmartcols.h>
 
+#ifdef HAVE_LINUX_BLKZONED_H
+# include <linux/blkzoned.h>
+#endif
+
 #include "nls.h"
 #include "xalloc.h"
 #include "strutils.h"
@@ -465,15 +469,56 @@ static void free_wipe(struct wipe_desc *wp)
 	}
 }
 
+/* a magic string to be zeroed by write_batch() */
+struct wipe_range {
+	loff_t		offset;
+	size_t		len;
+	char		*type;
+};
+
+struct wipe_batch {
+	struct wipe_range *ranges;
+	size_t		nranges;
+};
+
+/*
+ * The sequential zones have to be reset by libblkid, the batch is usable
+ * for the conventional devices only.
+ */
+static int is_zoned(int fd __attribute__((__unused__)))
+{
+#if defined(HAVE_LINUX_BLKZONED_H) && defined(BLKGETZONESZ)
+	uint32_t zone_size = 0;
+
+	if (ioctl(fd, BLKGETZONESZ, &zone_size) == 0 && zone_size)
+		return 1;
+#endif
+	return 0;
+}
+
 static void do_wipe_real(struct wipe_control *ctl, blkid_probe pr,
-			struct wipe_desc *w)
+			struct wipe_desc *w, struct wipe_batch *batch)
 {
 	size_t i;
 
-	if (blkid_do_wipe(pr, ctl->noact) != 0)
+	/* With the batch, the magic string is erased in the probing buffers
+	 * only (as for --no-act), so libblkid does not read the device again
+	 * for the next probe; the device is written by write_batch(). */
+	if (blkid_do_wipe(pr, ctl->noact || batch) != 0)
 		err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
 		     ctl->devname, w->type, (intmax_t)w->offset);
 
+	if (batch) {
+		struct wipe_range *r;
+
+		batch->ranges = xrealloc(batch->ranges,
+				(batch->nranges + 1) * sizeof(struct wipe_range));
+		r = &batch->ranges[batch->nranges++];
+		r->offset = w->offset;
+		r->len = min(w->len, (size_t) BUFSIZ);
+		r->type = xstrdup(w->type);
+	}
+
 	if (ctl->quiet)
 		return;
 
@@ -509,6 +554,26 @@ err:
 	err(EXIT_FAILURE, _("%s: failed to create a signature backup"), fname);
 }
 
+/* zeroes all the magic strings found by do_wipe(), followed by one fsync() */
+static void write_batch(struct wipe_control *ctl, int fd, struct wipe_batch *batch)
+{
+	char buf[BUFSIZ] = { 0 };
+	size_t i;
+
+	for (i = 0; i < batch->nranges; i++) {
+		struct wipe_range *r = &batch->ranges[i];
+
+		if (lseek(fd, r->offset, SEEK_SET) == (off_t) -1
+		    || write_all(fd, buf, r->len) != 0)
+			err(EXIT_FAILURE, _("%s: failed to erase %s magic string at offset 0x%08jx"),
+			     ctl->devname, r->type, (intmax_t) r->offset);
+		free(r->type);
+	}
+	free(batch->ranges);
+	batch->ranges = NULL;
+	batch->nranges = 0;
+}
+
 #ifdef BLKRRPART
 static void rereadpt(int fd, const char *devname)
 {
@@ -542,6 +607,7 @@ static int do_wipe(struct wipe_control *ctl)
 	blkid_probe pr;
 	char *backup = NULL;
 	struct wipe_desc *w;
+	struct wipe_batch batch = { .nranges = 0 }, *pbatch = NULL;
 
 	if (!ctl->force)
 		mode |= O_EXCL;
@@ -556,6 +622,9 @@ static int do_wipe(struct wipe_control *ctl)
 		return -1;
 	}
 
+	if (!ctl->noact && !is_zoned(blkid_probe_get_fd(pr)))
+		pbatch = &batch;
+
 	if (ctl->backup) {
 		const char *home = getenv ("HOME");
 		char *tmp = xstrdup(ctl->devname);
@@ -587,7 +656,7 @@ static int do_wipe(struct wipe_control *ctl)
 
 		if (backup)
 			do_backup(wp, backup);
-		do_wipe_real(ctl, pr, wp);
+		do_wipe_real(ctl, pr, wp, pbatch);
 		if (wp->is_parttable)
 			reread = 1;
 		wiped = 1;
@@ -615,6 +684,8 @@ static int do_wipe(struct wipe_control *ctl)
 	if (need_force)
 		warnx(_("Use the --force option to force erase."));
 
+	if (pbatch)
+		write_batch(ctl, blkid_probe_get_fd(pr), pbatch);
 	fsync(blkid_probe_get_fd(pr));
 
 #ifdef BLKRRPART
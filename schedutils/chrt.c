@@ -321,21 +321,25 @@ static int set_sched_one(struct chrt_ctl *ctl, pid_t pid)
 }
 #endif /* HAVE_SCHED_SETATTR */
 
+#ifdef __linux__
+static int set_sched_task(pid_t tid, void *data)
+{
+	struct chrt_ctl *ctl = (struct chrt_ctl *) data;
+
+	if (set_sched_one(ctl, tid) == -1
+	    && (errno != ESRCH || tid == ctl->pid))	/* finished thread */
+		err(EXIT_FAILURE, _("failed to set tid %d's policy"), tid);
+	return 0;
+}
+#endif
+
 static void set_sched(struct chrt_ctl *ctl)
 {
 	if (ctl->all_tasks) {
 #ifdef __linux__
-		pid_t tid;
-		struct proc_tasks *ts = proc_open_tasks(ctl->pid);
-
-		if (!ts)
+		/* threads created in meantime are found by the next pass */
+		if (proc_foreach_task(ctl->pid, set_sched_task, ctl) != 0)
 			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
-
-		while (!proc_next_tid(ts, &tid))
-			if (set_sched_one(ctl, tid) == -1)
-				err(EXIT_FAILURE, _("failed to set tid %d's policy"), tid);
-
-		proc_close_tasks(ts);
 #else
 		err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
 #endif
@@ -18,6 +18,7 @@
 #include "strutils.h"
 #include "c.h"
 #include "closestream.h"
+#include "procutils.h"
 
 static int tolerant;
 
@@ -98,6 +99,40 @@ static void ioprio_setid(int which, int ioclass, int data, int who)
 		err(EXIT_FAILURE, _("ioprio_set failed"));
 }
 
+/*
+ * Sets the priority for all the selected processes and prints a summary;
+ * processes which exit meanwhile are ignored.
+ */
+static int ioprio_setselected(struct proc_processes *ps, int ioclass, int data)
+{
+	size_t nchanged = 0, nfailed = 0;
+	pid_t pid;
+	int rc;
+
+	while ((rc = proc_next_pid(ps, &pid)) == 0) {
+		if (ioprio_set(IOPRIO_WHO_PROCESS, pid,
+			       IOPRIO_PRIO_VALUE(ioclass, data)) == 0) {
+			nchanged++;
+			continue;
+		}
+		if (errno == ESRCH)
+			continue;
+		if (!nfailed && !tolerant)
+			warn(_("ioprio_set failed for %d"), pid);
+		nfailed++;
+	}
+	if (rc < 0)
+		warn(_("failed to read list of processes"));
+
+	printf(P_("%zu process changed", "%zu processes changed", nchanged),
+	       nchanged);
+	if (nfailed)
+		printf(_(", failed %zu"), nfailed);
+	fputc('\n', stdout);
+
+	return (nfailed && !tolerant) || rc < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -105,6 +140,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,  _(" %1$s [options] -p <pid>...\n"
 			" %1$s [options] -P <pgid>...\n"
 			" %1$s [options] -u <uid>...\n"
+			" %1$s [options] -s <filter>...\n"
 			" %1$s [options] <command>\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -117,6 +153,7 @@ static void __attribute__((__noreturn__)) usage(void)
 		"                          only for the realtime and best-effort classes\n"), out);
 	fputs(_(" -p, --pid <pid>...     act on these already running processes\n"), out);
 	fputs(_(" -P, --pgid <pgrp>...   act on already running processes in these groups\n"), out);
+	fputs(_(" -s, --select <filter>  act on all processes matching the filter\n"), out);
 	fputs(_(" -t, --ignore           ignore failures\n"), out);
 	fputs(_(" -u, --uid <uid>...     act on already running processes owned by these users\n"), out);
 
@@ -133,6 +170,7 @@ int main(int argc, char **argv)
 	int data = 4, set = 0, ioclass = IOPRIO_CLASS_BE, c;
 	int which = 0, who = 0;
 	const char *invalid_msg = NULL;
+	struct proc_processes *sel = NULL;
 
 	static const struct option longopts[] = {
 		{ "classdata", required_argument, NULL, 'n' },
@@ -141,6 +179,7 @@ int main(int argc, char **argv)
 		{ "ignore",    no_argument,       NULL, 't' },
 		{ "pid",       required_argument, NULL, 'p' },
 		{ "pgid",      required_argument, NULL, 'P' },
+		{ "select",    required_argument, NULL, 's' },
 		{ "uid",       required_argument, NULL, 'u' },
 		{ "version",   no_argument,       NULL, 'V' },
 		{ NULL, 0, NULL, 0 }
@@ -151,7 +190,7 @@ int main(int argc, char **argv)
 	textdomain(PACKAGE);
 	close_stdout_atexit();
 
-	while ((c = getopt_long(argc, argv, "+n:c:p:P:u:tVh", longopts, NULL)) != EOF)
+	while ((c = getopt_long(argc, argv, "+n:c:p:P:s:u:tVh", longopts, NULL)) != EOF)
 		switch (c) {
 		case 'n':
 			data = strtos32_or_err(optarg, _("invalid class data argument"));
@@ -194,6 +233,19 @@ int main(int argc, char **argv)
 			which = strtos32_or_err(optarg, invalid_msg);
 			who = IOPRIO_WHO_USER;
 			break;
+		case 's':
+		{
+			int rc;
+
+			if (!sel && !(sel = proc_open_processes()))
+				err(EXIT_FAILURE, _("failed to read list of processes"));
+			rc = proc_processes_add_filter(sel, optarg);
+			if (rc) {
+				errno = -rc;
+				err(EXIT_FAILURE, _("invalid filter '%s'"), optarg);
+			}
+			break;
+		}
 		case 't':
 			tolerant = 1;
 			break;
@@ -226,6 +278,22 @@ int main(int argc, char **argv)
 			break;
 	}
 
+	if (sel) {
+		int rc;
+
+		/*
+		 * ionice -c CLASS -s FILTER [-s FILTER ...]
+		 */
+		if (who || optind < argc)
+			errx(EXIT_FAILURE,
+			     _("--select cannot be combined with pid, pgid, uid or command"));
+		if (!set)
+			errx(EXIT_FAILURE, _("--select requires --class or --classdata"));
+		rc = ioprio_setselected(sel, ioclass, data);
+		proc_close_processes(sel);
+		return rc;
+	}
+
 	if (!set && !which && optind == argc)
 		/*
 		 * ionice without options, print the current ioprio
@@ -39,10 +39,13 @@ struct taskset {
 	pid_t		pid;		/* task PID */
 	cpu_set_t	*set;		/* task CPU mask */
 	size_t		setsize;
+	cpu_set_t	*new_set;	/* mask to set */
+	size_t		new_setsize;
 	char		*buf;		/* buffer for conversion from mask to string */
 	size_t		buflen;
 	unsigned int	use_list:1,	/* use list rather than masks */
-			get_only:1;	/* print the mask, but not modify */
+			get_only:1,	/* print the mask, but not modify */
+			summary:1;	/* don't print all tasks */
 };
 
 static void __attribute__((__noreturn__)) usage(void)
@@ -61,6 +64,7 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -a, --all-tasks         operate on all the tasks (threads) for a given pid\n"
 		" -p, --pid               operate on existing given pid\n"
 		" -c, --cpu-list          display and specify cpus in list format\n"
+		"     --summary           with --all-tasks print the given pid only\n"
 		));
 	printf(USAGE_HELP_OPTIONS(25));
 
@@ -112,6 +116,17 @@ static void __attribute__((__noreturn__)) err_affinity(pid_t pid, int set)
 	err(EXIT_FAILURE, msg, pid ? pid : getpid());
 }
 
+/* --all-tasks --summary */
+static int set_task(pid_t tid, void *data)
+{
+	struct taskset *ts = (struct taskset *) data;
+
+	if (sched_setaffinity(tid, ts->new_setsize, ts->new_set) < 0
+	    && (errno != ESRCH || tid == ts->pid))	/* finished thread */
+		err_affinity(tid, 1);
+	return 0;
+}
+
 static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 {
 	/* read the current mask */
@@ -136,6 +151,16 @@ static void do_taskset(struct taskset *ts, size_t setsize, cpu_set_t *set)
 	}
 }
 
+/* --all-tasks */
+static int do_task(pid_t tid, void *data)
+{
+	struct taskset *ts = (struct taskset *) data;
+
+	ts->pid = tid;
+	do_taskset(ts, ts->new_setsize, ts->new_set);
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	cpu_set_t *new_set;
@@ -144,11 +169,15 @@ int main(int argc, char **argv)
 	int ncpus;
 	size_t new_setsize, nbits;
 	struct taskset ts;
+	enum {
+		OPT_SUMMARY = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 		{ "all-tasks",	0, NULL, 'a' },
 		{ "pid",	0, NULL, 'p' },
 		{ "cpu-list",	0, NULL, 'c' },
+		{ "summary",	0, NULL, OPT_SUMMARY },
 		{ "help",	0, NULL, 'h' },
 		{ "version",	0, NULL, 'V' },
 		{ NULL,		0, NULL,  0  }
@@ -173,6 +202,9 @@ int main(int argc, char **argv)
 		case 'c':
 			ts.use_list = 1;
 			break;
+		case OPT_SUMMARY:
+			ts.summary = 1;
+			break;
 
 		case 'V':
 			print_version(EXIT_SUCCESS);
@@ -227,11 +259,25 @@ int main(int argc, char **argv)
 		     argv[optind]);
 	}
 
-	if (all_tasks && pid) {
-		struct proc_tasks *tasks = proc_open_tasks(pid);
-		while (!proc_next_tid(tasks, &ts.pid))
-			do_taskset(&ts, new_setsize, new_set);
-		proc_close_tasks(tasks);
+	ts.new_set = new_set;
+	ts.new_setsize = new_setsize;
+
+	if (all_tasks && pid && ts.summary) {
+		ts.pid = pid;
+		if (sched_getaffinity(pid, ts.setsize, ts.set) < 0)
+			err_affinity(pid, 0);
+		print_affinity(&ts, FALSE);
+
+		if (!ts.get_only) {
+			if (proc_foreach_task(pid, set_task, &ts) != 0)
+				err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
+			if (sched_getaffinity(pid, ts.setsize, ts.set) < 0)
+				err_affinity(pid, 0);
+			print_affinity(&ts, TRUE);
+		}
+	} else if (all_tasks && pid) {
+		if (proc_foreach_task(pid, do_task, &ts) != 0)
+			err(EXIT_FAILURE, _("cannot obtain the list of tasks"));
 	} else {
 		ts.pid = pid;
 		do_taskset(&ts, new_setsize, new_set);
@@ -38,6 +38,10 @@
 #include <sys/time.h>
 #include <linux/fs.h>
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 #ifdef HAVE_LIBBLKID
 # include <blkid.h>
 #endif
@@ -47,6 +51,7 @@
 #include "c.h"
 #include "closestream.h"
 #include "monotonic.h"
+#include "xalloc.h"
 
 #ifndef BLKDISCARD
 # define BLKDISCARD	_IO(0x12,119)
@@ -66,6 +71,32 @@ enum {
 	ACT_SECURE
 };
 
+/* the default step if --workers or --rate is used */
+#define DEF_PARALLEL_STEP	(1024 * 1024 * 1024)
+
+struct discard_control {
+	char *path;
+	int fd;
+	int act;
+
+	uint64_t off;		/* the next range to submit */
+	uint64_t end;
+	uint64_t step;
+
+	uint64_t rate;		/* bytes per second, 0 = unlimited */
+	uint64_t submitted;	/* bytes submitted since start */
+	uint64_t done;		/* bytes done since start */
+	uint64_t stats[2];	/* progress: offset and length */
+
+	struct timeval start;
+	struct timeval last;	/* the last progress report */
+
+	unsigned int verbose : 1;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t lock;
+#endif
+};
+
 static void print_stats(int act, char *path, uint64_t stats[])
 {
 	switch (act) {
@@ -99,6 +130,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -s, --secure        perform secure discard\n"), out);
 	fputs(_(" -z, --zeroout       zero-fill rather than discard\n"), out);
 	fputs(_(" -v, --verbose       print aligned length and offset\n"), out);
+	fputs(_(" -r, --rate <num>    limit the rate to <num> bytes per second\n"), out);
+#ifdef HAVE_PTHREAD_H
+	fputs(_("     --workers <num> submit the requests by <num> threads\n"), out);
+#endif
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(21));
@@ -148,15 +183,151 @@ out:
 }
 #endif /* HAVE_LIBBLKID */
 
+static void lock_ctl(struct discard_control *ctl __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ctl->lock);
+#endif
+}
+
+static void unlock_ctl(struct discard_control *ctl __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ctl->lock);
+#endif
+}
+
+static uint64_t usec_since(const struct timeval *tv)
+{
+	struct timeval now, delta;
+
+	gettime_monotonic(&now);
+	timersub(&now, tv, &delta);
+	return (uint64_t) delta.tv_sec * 1000000 + delta.tv_usec;
+}
+
+static void do_discard(struct discard_control *ctl, uint64_t range[2])
+{
+	switch (ctl->act) {
+	case ACT_ZEROOUT:
+		if (ioctl(ctl->fd, BLKZEROOUT, range))
+			 err(EXIT_FAILURE, _("%s: BLKZEROOUT ioctl failed"), ctl->path);
+		break;
+	case ACT_SECURE:
+		if (ioctl(ctl->fd, BLKSECDISCARD, range))
+			err(EXIT_FAILURE, _("%s: BLKSECDISCARD ioctl failed"), ctl->path);
+		break;
+	case ACT_DISCARD:
+		if (ioctl(ctl->fd, BLKDISCARD, range))
+			err(EXIT_FAILURE, _("%s: BLKDISCARD ioctl failed"), ctl->path);
+		break;
+	}
+}
+
+/*
+ * Submits the ranges until the end; called by all the workers (or once
+ * without --workers). With --rate a request is delayed until the rate of
+ * all the already submitted requests is below the limit.
+ */
+static void *discard_worker(void *data)
+{
+	struct discard_control *ctl = data;
+
+	for (;;) {
+		uint64_t range[2], due = 0;
+		struct timeval now;
+
+		lock_ctl(ctl);
+		if (ctl->off >= ctl->end) {
+			unlock_ctl(ctl);
+			break;
+		}
+		range[0] = ctl->off;
+		range[1] = min(ctl->step, ctl->end - ctl->off);
+		ctl->off += range[1];
+
+		if (ctl->rate) {
+			due = (uint64_t) ((long double) ctl->submitted * 1000000 / ctl->rate);
+			ctl->submitted += range[1];
+		}
+		unlock_ctl(ctl);
+
+		if (ctl->rate) {
+			uint64_t elapsed = usec_since(&ctl->start);
+
+			if (due > elapsed)
+				xusleep(due - elapsed);
+		}
+
+		do_discard(ctl, range);
+
+		lock_ctl(ctl);
+		ctl->done += range[1];
+		if (!ctl->stats[1])
+			ctl->stats[0] = range[0];
+		ctl->stats[1] += range[1];
+
+		/* reporting progress at most once per second */
+		if (ctl->verbose && ctl->step) {
+			gettime_monotonic(&now);
+			if (now.tv_sec > ctl->last.tv_sec &&
+			    (now.tv_usec >= ctl->last.tv_usec || now.tv_sec > ctl->last.tv_sec + 1)) {
+				print_stats(ctl->act, ctl->path, ctl->stats);
+				ctl->stats[1] = 0;
+				ctl->last = now;
+			}
+		}
+		unlock_ctl(ctl);
+	}
+	return NULL;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void discard_parallel(struct discard_control *ctl, unsigned int nworkers)
+{
+	pthread_t *threads = xcalloc(nworkers, sizeof(pthread_t));
+	unsigned int i, n;
+
+	for (n = 0; n < nworkers; n++) {
+		if (pthread_create(&threads[n], NULL, discard_worker, ctl) != 0)
+			break;
+	}
+	if (!n)
+		discard_worker(ctl);	/* no thread, do it ourselves */
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+#endif
+
+static void print_throughput(struct discard_control *ctl)
+{
+	uint64_t usec = usec_since(&ctl->start);
+	char *str;
+
+	if (!usec)
+		usec = 1;
+	str = size_to_human_string(SIZE_SUFFIX_3LETTER | SIZE_SUFFIX_SPACE,
+			(uint64_t) ((long double) ctl->done * 1000000 / usec));
+	printf(_("%s: %" PRIu64 " bytes in %" PRIu64 ".%06" PRIu64 " seconds (%s/s)\n"),
+		ctl->path, ctl->done, usec / 1000000, usec % 1000000, str);
+	free(str);
+}
+
 int main(int argc, char **argv)
 {
 	char *path;
 	int c, fd, verbose = 0, secsize, force = 0;
-	uint64_t end, blksize, step, range[2], stats[2];
+	uint64_t end, blksize, step, range[2], rate = 0;
+	unsigned int nworkers = 0;
 	struct stat sb;
-	struct timeval now = { 0 }, last = { 0 };
 	int act = ACT_DISCARD;
+	struct discard_control ctl = { .fd = -1 };
 
+	enum {
+		OPT_WORKERS = CHAR_MAX + 1
+	};
 	static const struct option longopts[] = {
 	    { "help",      no_argument,       NULL, 'h' },
 	    { "version",   no_argument,       NULL, 'V' },
@@ -167,6 +338,8 @@ int main(int argc, char **argv)
 	    { "secure",    no_argument,       NULL, 's' },
 	    { "verbose",   no_argument,       NULL, 'v' },
 	    { "zeroout",   no_argument,       NULL, 'z' },
+	    { "rate",      required_argument, NULL, 'r' },
+	    { "workers",   required_argument, NULL, OPT_WORKERS },
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -179,7 +352,7 @@ int main(int argc, char **argv)
 	range[1] = ULLONG_MAX;
 	step = 0;
 
-	while ((c = getopt_long(argc, argv, "hfVsvo:l:p:z", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hfVsvo:l:p:r:z", longopts, NULL)) != -1) {
 		switch(c) {
 		case 'f':
 			force = 1;
@@ -205,6 +378,14 @@ int main(int argc, char **argv)
 		case 'z':
 			act = ACT_ZEROOUT;
 			break;
+		case 'r':
+			rate = strtosize_or_err(optarg,
+					_("failed to parse rate"));
+			break;
+		case OPT_WORKERS:
+			nworkers = strtou32_or_err(optarg,
+					_("invalid workers argument"));
+			break;
 
 		case 'h':
 			usage();
@@ -251,6 +432,9 @@ int main(int argc, char **argv)
 	if (end < range[0] || end > blksize)
 		end = blksize;
 
+	if (!step && (nworkers || rate))
+		step = min((uint64_t) DEF_PARALLEL_STEP / secsize * secsize,
+			   end - range[0]);
 	range[1] = (step > 0) ? step : end - range[0];
 
 	/* check length alignment to the sector size */
@@ -283,44 +467,30 @@ int main(int argc, char **argv)
 	}
 #endif /* HAVE_LIBBLKID */
 
-	stats[0] = range[0], stats[1] = 0;
-	gettime_monotonic(&last);
-
-	for (/* nothing */; range[0] < end; range[0] += range[1]) {
-		if (range[0] + range[1] > end)
-			range[1] = end - range[0];
-
-		switch (act) {
-		case ACT_ZEROOUT:
-			if (ioctl(fd, BLKZEROOUT, &range))
-				 err(EXIT_FAILURE, _("%s: BLKZEROOUT ioctl failed"), path);
-			break;
-		case ACT_SECURE:
-			if (ioctl(fd, BLKSECDISCARD, &range))
-				err(EXIT_FAILURE, _("%s: BLKSECDISCARD ioctl failed"), path);
-			break;
-		case ACT_DISCARD:
-			if (ioctl(fd, BLKDISCARD, &range))
-				err(EXIT_FAILURE, _("%s: BLKDISCARD ioctl failed"), path);
-			break;
-		}
-
-		stats[1] += range[1];
-
-		/* reporting progress at most once per second */
-		if (verbose && step) {
-			gettime_monotonic(&now);
-			if (now.tv_sec > last.tv_sec &&
-			    (now.tv_usec >= last.tv_usec || now.tv_sec > last.tv_sec + 1)) {
-				print_stats(act, path, stats);
-				stats[0] += stats[1], stats[1] = 0;
-				last = now;
-			}
-		}
-	}
+	ctl.path = path;
+	ctl.fd = fd;
+	ctl.act = act;
+	ctl.off = range[0];
+	ctl.end = end;
+	ctl.step = range[1];
+	ctl.rate = rate;
+	ctl.verbose = verbose;
+	ctl.stats[0] = range[0];
+	gettime_monotonic(&ctl.start);
+	ctl.last = ctl.start;
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_init(&ctl.lock, NULL);
+	if (nworkers > 1)
+		discard_parallel(&ctl, nworkers);
+	else
+#endif
+		discard_worker(&ctl);
 
-	if (verbose && stats[1])
-		print_stats(act, path, stats);
+	if (verbose && ctl.stats[1])
+		print_stats(act, path, ctl.stats);
+	if (verbose && (nworkers || rate))
+		print_throughput(&ctl);
 
 	close(fd);
 	return EXIT_SUCCESS;
@@ -30,12 +30,18 @@
 #include <getopt.h>
 #include <time.h>
 
+#include <errno.h>
+
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <linux/fs.h>
 #include <linux/blkzoned.h>
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 #include "nls.h"
 #include "strutils.h"
 #include "xalloc.h"
@@ -44,6 +50,7 @@
 #include "blkdev.h"
 #include "sysfs.h"
 #include "optutils.h"
+#include "jsonwrt.h"
 
 /*
  * These ioctls are defined in linux/blkzoned.h starting with kernel 5.5.
@@ -81,8 +88,10 @@ struct blkzone_control {
 	uint64_t offset;
 	uint64_t length;
 	uint32_t count;
+	unsigned int nworkers;		/* --workers */
 
 	unsigned int force : 1;
+	unsigned int json : 1;
 	unsigned int verbose : 1;
 };
 
@@ -206,6 +215,7 @@ done:
  * blkzone report
  */
 #define DEF_REPORT_LEN		(1U << 12) /* 4k zones per report (256k kzalloc) */
+#define MAX_REPORT_LEN		(1U << 16) /* 64k zones per report (4M buffer) */
 
 static const char *type_text[] = {
 	"RESERVED",
@@ -226,13 +236,34 @@ static const char *condition_str[] = {
 	"of"  /* Offline */
 };
 
+static void print_zone_json(struct ul_jsonwrt *json, const struct blk_zone *entry,
+			    uint64_t cap)
+{
+	unsigned int type = entry->type;
+	uint8_t cond = entry->cond;
+
+	ul_jsonwrt_object_open(json, NULL);
+	ul_jsonwrt_value_u64(json, "start", entry->start);
+	ul_jsonwrt_value_u64(json, "len", entry->len);
+	ul_jsonwrt_value_u64(json, "cap", cap);
+	ul_jsonwrt_value_u64(json, "wptr", type == 0x1 ? 0 : entry->wp - entry->start);
+	ul_jsonwrt_value_boolean(json, "reset", entry->reset);
+	ul_jsonwrt_value_boolean(json, "non-seq", entry->non_seq);
+	ul_jsonwrt_value_s(json, "cond",
+			condition_str[cond & (ARRAY_SIZE(condition_str) - 1)]);
+	ul_jsonwrt_value_s(json, "type",
+			type < ARRAY_SIZE(type_text) ? type_text[type] : NULL);
+	ul_jsonwrt_object_close(json);
+}
+
 static int blkzone_report(struct blkzone_control *ctl)
 {
 	bool only_capacity_sum = !strcmp(ctl->command->name, "capacity");
 	uint64_t capacity_sum = 0;
 	struct blk_zone_report *zi;
+	struct ul_jsonwrt json;
 	unsigned long zonesize;
-	uint32_t i, nr_zones;
+	uint32_t i, nr_zones, report_len;
 	int fd;
 
 	fd = init_device(ctl, O_RDONLY);
@@ -252,16 +283,32 @@ static int blkzone_report(struct blkzone_control *ctl)
 	else
 		nr_zones = 1 + (ctl->total_sectors - ctl->offset) / zonesize;
 
+	/* large devices have many thousands of zones, use one buffer for as
+	 * many zones as possible to reduce number of the ioctls */
+	report_len = max(min(nr_zones, MAX_REPORT_LEN), DEF_REPORT_LEN);
 	zi = xmalloc(sizeof(struct blk_zone_report) +
-		     (DEF_REPORT_LEN * sizeof(struct blk_zone)));
+		     (report_len * sizeof(struct blk_zone)));
+
+	if (ctl->json) {
+		ul_jsonwrt_init(&json, stdout, 0);
+		ul_jsonwrt_root_open(&json);
+		if (!only_capacity_sum)
+			ul_jsonwrt_array_open(&json, "zones");
+	}
 
 	while (nr_zones && ctl->offset < ctl->total_sectors) {
 
-		zi->nr_zones = min(nr_zones, DEF_REPORT_LEN);
+		zi->nr_zones = min(nr_zones, report_len);
 		zi->sector = ctl->offset;
 
-		if (ioctl(fd, BLKREPORTZONE, zi) == -1)
+		if (ioctl(fd, BLKREPORTZONE, zi) == -1) {
+			/* old kernels allocate the report in kernel memory */
+			if (errno == ENOMEM && report_len > DEF_REPORT_LEN) {
+				report_len /= 2;
+				continue;
+			}
 			err(EXIT_FAILURE, _("%s: BLKREPORTZONE ioctl failed"), ctl->devname);
+		}
 
 		if (ctl->verbose)
 			printf(_("Found %d zones from 0x%"PRIx64"\n"),
@@ -298,6 +345,8 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 			if (only_capacity_sum) {
 				capacity_sum += cap;
+			} else if (ctl->json) {
+				print_zone_json(&json, entry, cap);
 			} else {
 				printf(_("  start: 0x%09"PRIx64", len 0x%06"PRIx64
 					", cap 0x%06"PRIx64", wptr 0x%06"PRIx64
@@ -314,7 +363,13 @@ static int blkzone_report(struct blkzone_control *ctl)
 
 	}
 
-	if (only_capacity_sum)
+	if (ctl->json) {
+		if (only_capacity_sum)
+			ul_jsonwrt_value_u64(&json, "capacity", capacity_sum);
+		else
+			ul_jsonwrt_array_close(&json);
+		ul_jsonwrt_root_close(&json);
+	} else if (only_capacity_sum)
 		printf(_("0x%09"PRIx64"\n"), capacity_sum);
 
 	free(zi);
@@ -323,6 +378,75 @@ static int blkzone_report(struct blkzone_control *ctl)
 	return 0;
 }
 
+#ifdef HAVE_PTHREAD_H
+/* a part of the range for one thread */
+struct blkzone_job {
+	int fd;
+	unsigned long ioctl_cmd;
+	struct blk_zone_range za;
+	int errsv;			/* errno from the failed ioctl */
+};
+
+static void *blkzone_worker(void *data)
+{
+	struct blkzone_job *job = data;
+
+	if (ioctl(job->fd, job->ioctl_cmd, &job->za) == -1)
+		job->errsv = errno;
+	return NULL;
+}
+
+/*
+ * Splits the range to @nworkers parts aligned to zones and runs the ioctls in
+ * parallel. Returns 0 on success or errno of the first failed ioctl.
+ */
+static int blkzone_action_parallel(struct blkzone_control *ctl, int fd,
+				   unsigned long zonesize, uint64_t zlen)
+{
+	uint64_t nzones = (zlen + zonesize - 1) / zonesize;
+	uint64_t sector = ctl->offset, end = ctl->offset + zlen;
+	struct blkzone_job *jobs;
+	pthread_t *threads;
+	unsigned int i, n, njobs;
+	int rc = 0;
+
+	njobs = min((uint64_t) ctl->nworkers, nzones);
+	jobs = xcalloc(njobs, sizeof(struct blkzone_job));
+	threads = xcalloc(njobs, sizeof(pthread_t));
+
+	for (i = 0; i < njobs; i++) {
+		uint64_t nr = (nzones / njobs + (i < nzones % njobs ? 1 : 0)) * zonesize;
+
+		jobs[i].fd = fd;
+		jobs[i].ioctl_cmd = ctl->command->ioctl_cmd;
+		jobs[i].za.sector = sector;
+		jobs[i].za.nr_sectors = min(nr, end - sector);
+		sector += jobs[i].za.nr_sectors;
+	}
+
+	for (n = 0; n < njobs; n++) {
+		if (pthread_create(&threads[n], NULL, blkzone_worker, &jobs[n]) != 0)
+			break;
+	}
+	/* the rest (or all if no thread has been created) do ourselves */
+	for (i = n; i < njobs; i++)
+		blkzone_worker(&jobs[i]);
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < njobs; i++) {
+		if (jobs[i].errsv) {
+			rc = jobs[i].errsv;
+			break;
+		}
+	}
+	free(threads);
+	free(jobs);
+	return rc;
+}
+#endif /* HAVE_PTHREAD_H */
+
 /*
  * blkzone reset, open, close, and finish.
  */
@@ -366,10 +490,21 @@ static int blkzone_action(struct blkzone_control *ctl)
 	za.sector = ctl->offset;
 	za.nr_sectors = zlen;
 
+#ifdef HAVE_PTHREAD_H
+	if (ctl->nworkers > 1 && zlen > zonesize) {
+		int rc = blkzone_action_parallel(ctl, fd, zonesize, zlen);
+
+		if (rc) {
+			errno = rc;
+			err(EXIT_FAILURE, _("%s: %s ioctl failed"),
+			    ctl->devname, ctl->command->ioctl_name);
+		}
+	} else
+#endif
 	if (ioctl(fd, ctl->command->ioctl_cmd, &za) == -1)
 		err(EXIT_FAILURE, _("%s: %s ioctl failed"),
 		    ctl->devname, ctl->command->ioctl_name);
-	else if (ctl->verbose)
+	if (ctl->verbose)
 		printf(_("%s: successful %s of zones in range from %" PRIu64 ", to %" PRIu64),
 			ctl->devname,
 			ctl->command->name,
@@ -399,6 +534,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -l, --length <sectors> maximum sectors to act (in 512-byte sectors)\n"), out);
 	fputs(_(" -c, --count <number>   maximum number of zones\n"), out);
 	fputs(_(" -f, --force            enforce on block devices used by the system\n"), out);
+	fputs(_(" -J, --json             use JSON output format for report and capacity\n"), out);
+#ifdef HAVE_PTHREAD_H
+	fputs(_("     --workers <num>    split the range of zones to <num> parallel parts\n"), out);
+#endif
 	fputs(_(" -v, --verbose          display more details\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(24));
@@ -416,6 +555,9 @@ int main(int argc, char **argv)
 	struct blkzone_control ctl = {
 		.devname = NULL
 	};
+	enum {
+		OPT_WORKERS = CHAR_MAX + 1
+	};
 
 	static const struct option longopts[] = {
 	    { "help",    no_argument,       NULL, 'h' },
@@ -423,6 +565,8 @@ int main(int argc, char **argv)
 	    { "length",  required_argument, NULL, 'l' }, /* max of sectors to operate on */
 	    { "offset",  required_argument, NULL, 'o' }, /* starting LBA */
 	    { "force",   no_argument,       NULL, 'f' },
+	    { "json",    no_argument,       NULL, 'J' },
+	    { "workers", required_argument, NULL, OPT_WORKERS },
 	    { "verbose", no_argument,       NULL, 'v' },
 	    { "version", no_argument,       NULL, 'V' },
 	    { NULL, 0, NULL, 0 }
@@ -447,7 +591,7 @@ int main(int argc, char **argv)
 		argc--;
 	}
 
-	while ((c = getopt_long(argc, argv, "hc:l:o:fvV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "hc:l:o:fJvV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -467,6 +611,13 @@ int main(int argc, char **argv)
 		case 'f':
 			ctl.force = 1;
 			break;
+		case 'J':
+			ctl.json = 1;
+			break;
+		case OPT_WORKERS:
+			ctl.nworkers = strtou32_or_err(optarg,
+					_("invalid workers argument"));
+			break;
 		case 'v':
 			ctl.verbose = 1;
 			break;
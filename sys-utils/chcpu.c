@@ -42,6 +42,7 @@
 #include "path.h"
 #include "closestream.h"
 #include "optutils.h"
+#include "monotonic.h"
 
 #define EXCL_ERROR "--{configure,deconfigure,disable,dispatch,enable}"
 
@@ -52,6 +53,7 @@
 
 static cpu_set_t *onlinecpus;
 static int maxcpus;
+static int timing;
 
 #define is_cpu_online(cpu) (CPU_ISSET_S((cpu), CPU_ALLOC_SIZE(maxcpus), onlinecpus))
 #define num_online_cpus()  (CPU_COUNT_S(CPU_ALLOC_SIZE(maxcpus), onlinecpus))
@@ -66,6 +68,39 @@ enum {
 	CMD_CPU_DISPATCH_VERTICAL,
 };
 
+/*
+ * Writes cpuN/online and returns the time spent in the write in @msecs. The
+ * write returns when the kernel has finished the hotplug transition, so it
+ * is the hotplug latency of the CPU as seen from userspace.
+ */
+static int cpu_set_online(struct path_cxt *sys, int cpu, int enable, double *msecs)
+{
+	struct timeval start, end, diff;
+	int rc;
+
+	gettime_monotonic(&start);
+	rc = ul_path_writef_string(sys, enable ? "1" : "0", "cpu%d/online", cpu);
+	gettime_monotonic(&end);
+
+	timersub(&end, &start, &diff);
+	*msecs = diff.tv_sec * 1000.0 + diff.tv_usec / 1000.0;
+	return rc;
+}
+
+static void print_timing_summary(int enable, int count, double total, double max)
+{
+	if (!timing || !count)
+		return;
+	printf(enable ?
+		P_("%d CPU enabled in %.3f ms (average %.3f ms, maximum %.3f ms)\n",
+		   "%d CPUs enabled in %.3f ms (average %.3f ms, maximum %.3f ms)\n",
+		   count) :
+		P_("%d CPU disabled in %.3f ms (average %.3f ms, maximum %.3f ms)\n",
+		   "%d CPUs disabled in %.3f ms (average %.3f ms, maximum %.3f ms)\n",
+		   count),
+		count, total, total / count, max);
+}
+
 /* returns:   0 = success
  *          < 0 = failure
  *          > 0 = partial success
@@ -75,7 +110,8 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 	int cpu;
 	int online, rc;
 	int configured = -1;
-	int fails = 0;
+	int fails = 0, count = 0;
+	double msecs, total = 0, max = 0;
 
 	for (cpu = 0; cpu < maxcpus; cpu++) {
 		if (!CPU_ISSET_S(cpu, setsize, cpu_set))
@@ -103,14 +139,16 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 		if (ul_path_accessf(sys, F_OK, "cpu%d/configure", cpu) == 0)
 			ul_path_readf_s32(sys, &configured, "cpu%d/configure", cpu);
 		if (enable) {
-			rc = ul_path_writef_string(sys, "1", "cpu%d/online", cpu);
+			rc = cpu_set_online(sys, cpu, 1, &msecs);
 			if (rc != 0 && configured == 0) {
 				warn(_("CPU %u enable failed (CPU is deconfigured)"), cpu);
 				fails++;
 			} else if (rc != 0) {
 				warn(_("CPU %u enable failed"), cpu);
 				fails++;
-			} else
+			} else if (timing)
+				printf(_("CPU %u enabled (%.3f ms)\n"), cpu, msecs);
+			else
 				printf(_("CPU %u enabled\n"), cpu);
 		} else {
 			if (onlinecpus && num_online_cpus() == 1) {
@@ -118,18 +156,28 @@ static int cpu_enable(struct path_cxt *sys, cpu_set_t *cpu_set, size_t setsize,
 				fails++;
 				continue;
 			}
-			rc = ul_path_writef_string(sys, "0", "cpu%d/online", cpu);
+			rc = cpu_set_online(sys, cpu, 0, &msecs);
 			if (rc != 0) {
 				warn(_("CPU %u disable failed"), cpu);
 				fails++;
 			} else {
-				printf(_("CPU %u disabled\n"), cpu);
+				if (timing)
+					printf(_("CPU %u disabled (%.3f ms)\n"), cpu, msecs);
+				else
+					printf(_("CPU %u disabled\n"), cpu);
 				if (onlinecpus)
 					CPU_CLR_S(cpu, setsize, onlinecpus);
 			}
 		}
+		if (rc == 0) {
+			count++;
+			total += msecs;
+			if (msecs > max)
+				max = msecs;
+		}
 	}
 
+	print_timing_summary(enable, count, total, max);
 	return fails == 0 ? 0 : fails == maxcpus ? -1 : 1;
 }
 
@@ -252,6 +300,7 @@ static void __attribute__((__noreturn__)) usage(void)
 		" -g, --deconfigure <cpu-list>  deconfigure cpus\n"
 		" -p, --dispatch <mode>         set dispatching mode\n"
 		" -r, --rescan                  trigger rescan of cpus\n"
+		" -t, --timing                  print time spent to enable or disable cpus\n"
 		), stdout);
 	printf(USAGE_HELP_OPTIONS(31));
 
@@ -275,6 +324,7 @@ int main(int argc, char *argv[])
 		{ "enable",	required_argument, NULL, 'e' },
 		{ "help",	no_argument,       NULL, 'h' },
 		{ "rescan",	no_argument,       NULL, 'r' },
+		{ "timing",	no_argument,       NULL, 't' },
 		{ "version",	no_argument,       NULL, 'V' },
 		{ NULL,		0, NULL, 0 }
 	};
@@ -308,7 +358,7 @@ int main(int argc, char *argv[])
 
 	setsize = CPU_ALLOC_SIZE(maxcpus);
 
-	while ((c = getopt_long(argc, argv, "c:d:e:g:hp:rV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "c:d:e:g:hp:rtV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -341,6 +391,9 @@ int main(int argc, char *argv[])
 		case 'r':
 			cmd = CMD_CPU_RESCAN;
 			break;
+		case 't':
+			timing = 1;
+			break;
 
 		case 'h':
 			usage();
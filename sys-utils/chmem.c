@@ -23,6 +23,7 @@
 #include <getopt.h>
 #include <assert.h>
 #include <dirent.h>
+#include <sys/time.h>
 
 #include "c.h"
 #include "nls.h"
@@ -32,6 +33,7 @@
 #include "optutils.h"
 #include "closestream.h"
 #include "xalloc.h"
+#include "monotonic.h"
 
 /* partial success, otherwise we return regular EXIT_{SUCCESS,FAILURE} */
 #define CHMEM_EXIT_SOMEOK		64
@@ -46,10 +48,17 @@ struct chmem_desc {
 	uint64_t	start;
 	uint64_t	end;
 	uint64_t	size;
+
+	uint64_t	ndone;		/* number of changed blocks */
+	uint64_t	ntodo;
+	struct timeval	start_time;	/* for --progress */
+	struct timeval	last_report;
+
 	unsigned int	use_blocks : 1;
 	unsigned int	is_size	   : 1;
 	unsigned int	verbose	   : 1;
 	unsigned int	have_zones : 1;
+	unsigned int	progress   : 1;
 };
 
 enum {
@@ -101,6 +110,48 @@ static void idxtostr(struct chmem_desc *desc, uint64_t idx, char *buf, size_t bu
 		 idx, start, end);
 }
 
+/*
+ * Prints the number of changed blocks and the throughput to stderr, at most
+ * once per second. The state of the blocks is written one by one, the kernel
+ * serializes memory hotplug operations anyway.
+ */
+static void report_progress(struct chmem_desc *desc, int enable, int final)
+{
+	struct timeval now, diff;
+	char *sizestr, *ratestr;
+	uint64_t bytes;
+	double secs;
+
+	if (!desc->progress)
+		return;
+
+	gettime_monotonic(&now);
+	if (!desc->last_report.tv_sec && !desc->last_report.tv_usec) {
+		desc->start_time = desc->last_report = now;
+		return;
+	}
+	timersub(&now, &desc->last_report, &diff);
+	if (!final && diff.tv_sec < 1)
+		return;
+	desc->last_report = now;
+
+	timersub(&now, &desc->start_time, &diff);
+	secs = diff.tv_sec + diff.tv_usec / 1000000.0;
+	bytes = desc->ndone * desc->block_size;
+
+	sizestr = size_to_human_string(SIZE_SUFFIX_1LETTER, bytes);
+	ratestr = size_to_human_string(SIZE_SUFFIX_1LETTER,
+				secs > 0 ? (uint64_t) (bytes / secs) : bytes);
+	fprintf(stderr, enable ?
+		_("\r%"PRIu64"/%"PRIu64" blocks (%s) enabled, %s/s") :
+		_("\r%"PRIu64"/%"PRIu64" blocks (%s) disabled, %s/s"),
+		desc->ndone, desc->ntodo, sizestr, ratestr);
+	if (final)
+		fputc('\n', stderr);
+	free(sizestr);
+	free(ratestr);
+}
+
 static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 {
 	char *name, *onoff, line[BUFSIZ], str[BUFSIZ];
@@ -112,6 +163,9 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 	onoff = enable ? "online" : "offline";
 	i = enable ? 0 : desc->ndirs - 1;
 
+	desc->ntodo = size;
+	report_progress(desc, enable, 0);
+
 	if (enable && zone_id >= 0) {
 		if (zone_id == ZONE_MOVABLE)
 			onoff = "online_movable";
@@ -157,9 +211,13 @@ static int chmem_size(struct chmem_desc *desc, int enable, int zone_id)
 			else
 				fprintf(stdout, _("%s disabled\n"), str);
 		}
-		if (rc == 0)
+		if (rc == 0) {
 			size--;
+			desc->ndone++;
+		}
+		report_progress(desc, enable, 0);
 	}
+	report_progress(desc, enable, 1);
 	if (size) {
 		uint64_t bytes;
 		char *sizestr;
@@ -185,6 +243,9 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 	todo = desc->end - desc->start + 1;
 	onoff = enable ? "online" : "offline";
 
+	desc->ntodo = todo;
+	report_progress(desc, enable, 0);
+
 	if (enable && zone_id >= 0) {
 		if (zone_id == ZONE_MOVABLE)
 			onoff = "online_movable";
@@ -207,6 +268,7 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			else if (desc->verbose && !enable)
 				fprintf(stdout, _("%s already disabled\n"), str);
 			todo--;
+			desc->ntodo--;
 			continue;
 		}
 
@@ -243,9 +305,13 @@ static int chmem_range(struct chmem_desc *desc, int enable, int zone_id)
 			else
 				fprintf(stdout, _("%s disabled\n"), str);
 		}
-		if (rc == 0)
+		if (rc == 0) {
 			todo--;
+			desc->ndone++;
+		}
+		report_progress(desc, enable, 0);
 	}
+	report_progress(desc, enable, 1);
 	return todo == 0 ? 0 : todo == desc->end - desc->start + 1 ? -1 : 1;
 }
 
@@ -347,6 +413,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -d, --disable      disable memory\n"), out);
 	fputs(_(" -b, --blocks       use memory blocks\n"), out);
 	fputs(_(" -z, --zone <name>  select memory zone (see below)\n"), out);
+	fputs(_(" -p, --progress     report progress and throughput\n"), out);
 	fputs(_(" -v, --verbose      verbose output\n"), out);
 	printf(USAGE_HELP_OPTIONS(20));
 
@@ -371,6 +438,7 @@ int main(int argc, char **argv)
 		{"disable",	no_argument,		NULL, 'd'},
 		{"enable",	no_argument,		NULL, 'e'},
 		{"help",	no_argument,		NULL, 'h'},
+		{"progress",	no_argument,		NULL, 'p'},
 		{"verbose",	no_argument,		NULL, 'v'},
 		{"version",	no_argument,		NULL, 'V'},
 		{"zone",	required_argument,	NULL, 'z'},
@@ -395,7 +463,7 @@ int main(int argc, char **argv)
 
 	read_info(desc);
 
-	while ((c = getopt_long(argc, argv, "bdehvVz:", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "bdehpvVz:", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -409,6 +477,9 @@ int main(int argc, char **argv)
 		case 'b':
 			desc->use_blocks = 1;
 			break;
+		case 'p':
+			desc->progress = 1;
+			break;
 		case 'v':
 			desc->verbose = 1;
 			break;
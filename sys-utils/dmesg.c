@@ -20,6 +20,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include "c.h"
 #include "colors.h"
@@ -35,6 +36,8 @@
 #include "monotonic.h"
 #include "mangle.h"
 #include "pager.h"
+#include "fileutils.h"
+#include "pathnames.h"
 
 /* Close the log.  Currently a NOP. */
 #define SYSLOG_ACTION_CLOSE          0
@@ -168,6 +171,9 @@ struct dmesg_control {
 
 	struct timeval	lasttime;	/* last printed timestamp */
 	struct tm	lasttm;		/* last localtime */
+	time_t		tmcache_time;	/* time of tmcache and ctimecache */
+	struct tm	tmcache;	/* localtime() of tmcache_time */
+	char		ctimecache[128];/* strftime() of tmcache, or empty */
 	struct timeval	boot_time;	/* system boot time */
 	time_t		suspended_time;	/* time spent in suspended state */
 
@@ -180,9 +186,17 @@ struct dmesg_control {
 	ssize_t		kmsg_first_read;/* initial read() return code */
 	char		kmsg_buf[BUFSIZ];/* buffer to read kmsg data */
 
+	const char	*seq_file;	/* --seq-file path */
+	char		boot_id[40];	/* current boot ID */
+	uint64_t	seq_last;	/* last processed kmsg sequence number */
+
 	time_t		since;		/* filter records by time */
 	time_t		until;		/* filter records by time */
 
+	const char	*subsys;	/* filter records by SUBSYSTEM= */
+	const char	*device;	/* filter records by DEVICE= */
+	const char	*match;		/* filter records by message text */
+
 	/*
 	 * For the --file option we mmap whole file. The unnecessary (already
 	 * printed) pages are always unmapped. The result is that we have in
@@ -202,8 +216,11 @@ struct dmesg_control {
 			decode:1,	/* use "facility: level: " prefix */
 			pager:1,	/* pipe output into a pager */
 			color:1,	/* colorize messages */
-			force_prefix:1;	/* force timestamp and decode prefix
+			force_prefix:1,	/* force timestamp and decode prefix
 					   on each line */
+			tmcache_ok:1,	/* tmcache is valid */
+			seq_ok:1,	/* seq_last is valid */
+			seq_dirty:1;	/* seq_last is not saved yet */
 	int		indent;		/* due to timestamps if newline */
 };
 
@@ -214,6 +231,12 @@ struct dmesg_record {
 	int		level;
 	int		facility;
 	struct timeval  tv;
+	uint64_t	seqnum;		/* kmsg sequence number */
+
+	const char	*subsys;	/* kmsg SUBSYSTEM= value (not terminated) */
+	size_t		subsys_size;
+	const char	*device;	/* kmsg DEVICE= value (not terminated) */
+	size_t		device_size;
 
 	const char	*next;		/* buffer with next unparsed record */
 	size_t		next_size;	/* size of the next buffer */
@@ -226,6 +249,11 @@ struct dmesg_record {
 		(_r)->level = -1; \
 		(_r)->tv.tv_sec = 0; \
 		(_r)->tv.tv_usec = 0; \
+		(_r)->seqnum = 0; \
+		(_r)->subsys = NULL; \
+		(_r)->subsys_size = 0; \
+		(_r)->device = NULL; \
+		(_r)->device_size = 0; \
 	} while (0)
 
 static int read_kmsg(struct dmesg_control *ctl);
@@ -308,6 +336,10 @@ static void __attribute__((__noreturn__)) usage(void)
 		"Suspending/resume will make ctime and iso timestamps inaccurate.\n"), out);
 	fputs(_("     --since <time>          display the lines since the specified time\n"), out);
 	fputs(_("     --until <time>          display the lines until the specified time\n"), out);
+	fputs(_("     --seq-file <file>       skip messages read last time, remember the last one\n"), out);
+	fputs(_("     --subsystem <name>      display messages of the subsystem only\n"), out);
+	fputs(_("     --device <name>         display messages of the device only\n"), out);
+	fputs(_("     --match <string>        display messages containing the string only\n"), out);
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(29));
@@ -800,6 +832,10 @@ static int accept_record(struct dmesg_control *ctl, struct dmesg_record *rec)
 	if (ctl->until && ctl->until <= record_time(ctl, rec))
 		return 0;
 
+	if (ctl->match && !memmem(rec->mesg, rec->mesg_size,
+				  ctl->match, strlen(ctl->match)))
+		return 0;
+
 	return 1;
 }
 
@@ -833,29 +869,45 @@ static void raw_print(struct dmesg_control *ctl, const char *buf, size_t size)
 		putchar('\n');
 }
 
+/*
+ * Many records share the same second, so the last localtime() result and
+ * the last ctime string are cached.
+ */
 static struct tm *record_localtime(struct dmesg_control *ctl,
 				   struct dmesg_record *rec,
 				   struct tm *tm)
 {
 	time_t t = record_time(ctl, rec);
-	return localtime_r(&t, tm);
+
+	if (!ctl->tmcache_ok || ctl->tmcache_time != t) {
+		if (!localtime_r(&t, &ctl->tmcache))
+			return NULL;
+		ctl->tmcache_time = t;
+		ctl->tmcache_ok = 1;
+		*ctl->ctimecache = '\0';
+	}
+	*tm = ctl->tmcache;
+	return tm;
 }
 
-static char *record_ctime(struct dmesg_control *ctl,
-			  struct dmesg_record *rec,
-			  char *buf, size_t bufsiz)
+static const char *record_ctime(struct dmesg_control *ctl,
+				struct dmesg_record *rec)
 {
 	struct tm tm;
 
-	record_localtime(ctl, rec, &tm);
+	if (!record_localtime(ctl, rec, &tm))
+		return "";
+	if (*ctl->ctimecache)
+		return ctl->ctimecache;
 
 	/* TRANSLATORS: dmesg uses strftime() fo generate date-time string
 	   where %a is abbreviated name of the day, %b is abbreviated month
 	   name and %e is day of the month as a decimal number. Please, set
 	   proper month/day order here */
-	if (strftime(buf, bufsiz, _("%a %b %e %H:%M:%S %Y"), &tm) == 0)
-		*buf = '\0';
-	return buf;
+	if (strftime(ctl->ctimecache, sizeof(ctl->ctimecache),
+		     _("%a %b %e %H:%M:%S %Y"), &tm) == 0)
+		*ctl->ctimecache = '\0';
+	return ctl->ctimecache;
 }
 
 static char *short_ctime(struct tm *tm, char *buf, size_t bufsiz)
@@ -963,11 +1015,11 @@ static void print_record(struct dmesg_control *ctl,
 		break;
 	case DMESG_TIMEFTM_CTIME:
 		ctl->indent = snprintf(tsbuf, sizeof(tsbuf), "[%s] ",
-				      record_ctime(ctl, rec, buf, sizeof(buf)));
+				      record_ctime(ctl, rec));
 		break;
 	case DMESG_TIMEFTM_CTIME_DELTA:
 		ctl->indent = snprintf(tsbuf, sizeof(tsbuf), "[%s <%12.06f>] ",
-				      record_ctime(ctl, rec, buf, sizeof(buf)),
+				      record_ctime(ctl, rec),
 				      record_count_delta(ctl, rec));
 		break;
 	case DMESG_TIMEFTM_DELTA:
@@ -1117,6 +1169,7 @@ static void print_buffer(struct dmesg_control *ctl,
 		print_record(ctl, &rec);
 }
 
+/* Returns size of the record or -errno */
 static ssize_t read_kmsg_one(struct dmesg_control *ctl)
 {
 	ssize_t size;
@@ -1127,19 +1180,76 @@ static ssize_t read_kmsg_one(struct dmesg_control *ctl)
 			    sizeof(ctl->kmsg_buf) - 1);
 	} while (size < 0 && errno == EPIPE);
 
-	return size;
+	return size < 0 ? -errno : size;
 }
 
-static int init_kmsg(struct dmesg_control *ctl)
+/*
+ * The --seq-file contains "<boot-id> <seqnum>" of the last record read by
+ * the previous dmesg instance. The kmsg sequence numbers start from zero on
+ * each boot, so the boot ID has to match.
+ */
+static void load_seq_file(struct dmesg_control *ctl)
 {
-	int mode = O_RDONLY;
+	char id[sizeof(ctl->boot_id)];
+	uint64_t seq;
+	FILE *f;
+
+	f = fopen(_PATH_PROC_BOOT_ID, "r" UL_CLOEXECSTR);
+	if (f) {
+		if (fscanf(f, "%36s", ctl->boot_id) != 1)
+			*ctl->boot_id = '\0';
+		fclose(f);
+	}
 
-	if (!ctl->follow)
-		mode |= O_NONBLOCK;
-	else
-		setlinebuf(stdout);
+	f = fopen(ctl->seq_file, "r" UL_CLOEXECSTR);
+	if (!f) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), ctl->seq_file);
+		return;
+	}
+	if (fscanf(f, "%36s %" SCNu64, id, &seq) == 2
+	    && *ctl->boot_id && strcmp(id, ctl->boot_id) == 0) {
+		ctl->seq_last = seq;
+		ctl->seq_ok = 1;
+	}
+	fclose(f);
+}
+
+/* Atomically replaces --seq-file with the current position */
+static void save_seq_file(struct dmesg_control *ctl)
+{
+	char *tmp;
+	FILE *f = NULL;
+	int fd;
+
+	if (!ctl->seq_dirty)
+		return;
+
+	xasprintf(&tmp, "%s.XXXXXX", ctl->seq_file);
+	fd = mkstemp_cloexec(tmp);
+	if (fd >= 0 && !(f = fdopen(fd, "w")))
+		close(fd);
+	if (!f) {
+		warn(_("cannot create %s"), tmp);
+		if (fd >= 0)
+			unlink(tmp);
+		goto done;
+	}
+	fprintf(f, "%s %" PRIu64 "\n",
+		*ctl->boot_id ? ctl->boot_id : "-", ctl->seq_last);
+	if (close_stream(f) != 0 || rename(tmp, ctl->seq_file) != 0) {
+		warn(_("cannot write %s"), ctl->seq_file);
+		unlink(tmp);
+	} else
+		ctl->seq_dirty = 0;
+done:
+	free(tmp);
+}
 
-	ctl->kmsg = open("/dev/kmsg", mode);
+static int init_kmsg(struct dmesg_control *ctl)
+{
+	/* follow mode waits in poll() to print the records in batches */
+	ctl->kmsg = open("/dev/kmsg", O_RDONLY | O_NONBLOCK);
 	if (ctl->kmsg < 0)
 		return -1;
 
@@ -1159,7 +1269,8 @@ static int init_kmsg(struct dmesg_control *ctl)
 	 * read_kmsg().
 	 */
 	ctl->kmsg_first_read = read_kmsg_one(ctl);
-	if (ctl->kmsg_first_read < 0) {
+	if (ctl->kmsg_first_read < 0
+	    && !(ctl->follow && ctl->kmsg_first_read == -EAGAIN)) {
 		close(ctl->kmsg);
 		ctl->kmsg = -1;
 		return -1;
@@ -1168,6 +1279,46 @@ static int init_kmsg(struct dmesg_control *ctl)
 	return 0;
 }
 
+/*
+ * Parses " KEY=value\n" lines behind the message text. Only SUBSYSTEM=
+ * and DEVICE= are interesting for us.
+ */
+static void parse_kmsg_dict(struct dmesg_record *rec,
+			    const char *p, const char *end)
+{
+	while (p < end && *p == ' ') {
+		const char *eol = memchr(p, '\n', end - p);
+
+		if (!eol)
+			eol = end;
+		p++;
+		if (eol - p > 10 && strncmp(p, "SUBSYSTEM=", 10) == 0) {
+			rec->subsys = p + 10;
+			rec->subsys_size = eol - rec->subsys;
+		} else if (eol - p > 7 && strncmp(p, "DEVICE=", 7) == 0) {
+			rec->device = p + 7;
+			rec->device_size = eol - rec->device;
+		}
+		p = eol + 1;
+	}
+}
+
+static int dict_value_eq(const char *val, size_t sz, const char *str)
+{
+	return val && strlen(str) == sz && memcmp(val, str, sz) == 0;
+}
+
+static int accept_dict(struct dmesg_control *ctl, struct dmesg_record *rec)
+{
+	if (ctl->subsys && !dict_value_eq(rec->subsys, rec->subsys_size,
+					  ctl->subsys))
+		return 0;
+	if (ctl->device && !dict_value_eq(rec->device, rec->device_size,
+					  ctl->device))
+		return 0;
+	return 1;
+}
+
 /*
  * /dev/kmsg record format:
  *
@@ -1181,6 +1332,11 @@ static int init_kmsg(struct dmesg_control *ctl)
  */
 #define LAST_KMSG_FIELD(s)	(!s || !*s || *(s - 1) == ';')
 
+/*
+ * Returns 0 on success, 1 if the record is filtered out by --subsystem or
+ * --device (the message text is not decoded then), and -1 on error.
+ */
+
 static int parse_kmsg_record(struct dmesg_control *ctl,
 			     struct dmesg_record *rec,
 			     char *buf,
@@ -1207,6 +1363,8 @@ static int parse_kmsg_record(struct dmesg_control *ctl,
 		goto mesg;
 
 	/* B) sequence number */
+	if (ctl->seq_file)
+		rec->seqnum = strtoull(p, NULL, 10);
 	p = skip_item(p, end, ",;");
 	if (LAST_KMSG_FIELD(p))
 		goto mesg;
@@ -1240,6 +1398,17 @@ mesg:
 	if (*p && *p != '\n')
 		p--;
 
+	/*
+	 * The dictionary is checked before the message is decoded, the
+	 * records of other subsystems or devices are not processed at all.
+	 */
+	if (ctl->subsys || ctl->device) {
+		if (*p == '\n')
+			parse_kmsg_dict(rec, p + 1, buf + sz);
+		if (!accept_dict(ctl, rec))
+			return 1;
+	}
+
 	/*
 	 * Kernel escapes non-printable characters, unfortunately kernel
 	 * definition of "non-printable" is too strict. On UTF8 console we can
@@ -1250,7 +1419,7 @@ mesg:
 
 	rec->mesg_size--;	/* don't count \0 */
 
-	/* F) message tags (ignore) */
+	/* F) message tags (parsed above if necessary) */
 
 	return 0;
 }
@@ -1262,11 +1431,15 @@ mesg:
  * So this function does not compose one huge buffer (like read_syslog_buffer())
  * and print_buffer() is unnecessary. All is done in this function.
  *
+ * In follow mode all the available records are printed, and the output is
+ * flushed only before waiting for more.
+ *
  * Returns 0 on success, -1 on error.
  */
 static int read_kmsg(struct dmesg_control *ctl)
 {
 	struct dmesg_record rec;
+	struct pollfd fds = { .fd = ctl->kmsg, .events = POLLIN };
 	ssize_t sz;
 
 	if (ctl->method != DMESG_METHOD_KMSG || ctl->kmsg < 0)
@@ -1279,16 +1452,42 @@ static int read_kmsg(struct dmesg_control *ctl)
 	 */
 	sz = ctl->kmsg_first_read;
 
-	while (sz > 0) {
-		*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
+	for (;;) {
+		while (sz > 0) {
+			*(ctl->kmsg_buf + sz) = '\0';	/* for debug messages */
+
+			int rc;
 
-		if (parse_kmsg_record(ctl, &rec,
-				      ctl->kmsg_buf, (size_t) sz) == 0)
-			print_record(ctl, &rec);
+			rc = parse_kmsg_record(ctl, &rec,
+					       ctl->kmsg_buf, (size_t) sz);
+			if (rc < 0)
+				goto next;
+			if (ctl->seq_file) {
+				if (ctl->seq_ok && rec.seqnum <= ctl->seq_last)
+					goto next;	/* already read */
+				ctl->seq_last = rec.seqnum;
+				ctl->seq_ok = ctl->seq_dirty = 1;
+			}
+			if (rc == 0)
+				print_record(ctl, &rec);
+		next:
+			sz = read_kmsg_one(ctl);
+		}
+		if (!ctl->follow || sz != -EAGAIN)
+			break;
 
+		fflush(stdout);
+		if (ctl->seq_file)
+			save_seq_file(ctl);
+		if (poll(&fds, 1, -1) < 0 && errno != EINTR)
+			break;
 		sz = read_kmsg_one(ctl);
 	}
 
+	if (ctl->seq_file) {
+		fflush(stdout);
+		save_seq_file(ctl);
+	}
 	return 0;
 }
 
@@ -1354,7 +1553,11 @@ int main(int argc, char *argv[])
 		OPT_TIME_FORMAT = CHAR_MAX + 1,
 		OPT_NOESC,
 		OPT_SINCE,
-		OPT_UNTIL
+		OPT_UNTIL,
+		OPT_SEQ_FILE,
+		OPT_SUBSYSTEM,
+		OPT_DEVICE,
+		OPT_MATCH
 	};
 
 	static const struct option longopts[] = {
@@ -1365,6 +1568,7 @@ int main(int argc, char *argv[])
 		{ "console-off",   no_argument,       NULL, 'D' },
 		{ "console-on",    no_argument,       NULL, 'E' },
 		{ "decode",        no_argument,	      NULL, 'x' },
+		{ "device",        required_argument, NULL, OPT_DEVICE },
 		{ "file",          required_argument, NULL, 'F' },
 		{ "facility",      required_argument, NULL, 'f' },
 		{ "follow",        no_argument,       NULL, 'w' },
@@ -1373,7 +1577,10 @@ int main(int argc, char *argv[])
 		{ "help",          no_argument,	      NULL, 'h' },
 		{ "kernel",        no_argument,       NULL, 'k' },
 		{ "level",         required_argument, NULL, 'l' },
+		{ "match",         required_argument, NULL, OPT_MATCH },
+		{ "seq-file",      required_argument, NULL, OPT_SEQ_FILE },
 		{ "since",	   required_argument, NULL, OPT_SINCE },
+		{ "subsystem",     required_argument, NULL, OPT_SUBSYSTEM },
 		{ "syslog",        no_argument,       NULL, 'S' },
 		{ "raw",           no_argument,       NULL, 'r' },
 		{ "read-clear",    no_argument,	      NULL, 'c' },
@@ -1530,6 +1737,18 @@ int main(int argc, char *argv[])
 			ctl.until = (time_t) (p / 1000000);
 			break;
 		}
+		case OPT_SEQ_FILE:
+			ctl.seq_file = optarg;
+			break;
+		case OPT_SUBSYSTEM:
+			ctl.subsys = optarg;
+			break;
+		case OPT_DEVICE:
+			ctl.device = optarg;
+			break;
+		case OPT_MATCH:
+			ctl.match = optarg;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -1582,6 +1801,18 @@ int main(int argc, char *argv[])
 		if (ctl.method == DMESG_METHOD_KMSG && init_kmsg(&ctl) != 0)
 			ctl.method = DMESG_METHOD_SYSLOG;
 
+		if (ctl.seq_file) {
+			if (ctl.method != DMESG_METHOD_KMSG)
+				errx(EXIT_FAILURE, _("--seq-file is supported only "
+					"when reading messages from /dev/kmsg"));
+			load_seq_file(&ctl);
+		}
+
+		if ((ctl.subsys || ctl.device)
+		    && ctl.method != DMESG_METHOD_KMSG)
+			errx(EXIT_FAILURE, _("--subsystem and --device are supported "
+				"only when reading messages from /dev/kmsg"));
+
 		if (ctl.raw
 		    && ctl.method != DMESG_METHOD_KMSG
 		    && (ctl.fltr_lev || ctl.fltr_fac))
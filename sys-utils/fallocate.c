@@ -151,37 +151,31 @@ static void xposix_fallocate(int fd, off_t offset, off_t length)
 }
 #endif
 
-/* The real buffer size has to be bufsize + sizeof(uintptr_t) */
-static int is_nul(void *buf, size_t bufsize)
+/*
+ * Returns non-zero if the buffer contains zeros only. The first bytes are
+ * checked one by one, and the rest is compared with the zeroed beginning of
+ * the buffer by memcmp(), which is vectorized in libc.
+ */
+static int is_nul(const char *buf, size_t bufsize)
 {
-	typedef uintptr_t word;
-	void const *vp;
-	char const *cbuf = buf, *cp;
-	word const *wp = buf;
-
-	/* set sentinel */
-	memset((char *) buf + bufsize, '\1', sizeof(word));
-
-	/* Find first nonzero *word*, or the word with the sentinel.  */
-	while (*wp++ == 0)
-		continue;
+	size_t i, n = min(bufsize, (size_t) 16);
 
-	/* Find the first nonzero *byte*, or the sentinel.  */
-	vp = wp - 1;
-	cp = vp;
-
-	while (*cp++ == 0)
-		continue;
-
-	return cbuf + bufsize < cp;
+	for (i = 0; i < n; i++) {
+		if (buf[i])
+			return 0;
+	}
+	return bufsize <= n || memcmp(buf, buf + n, bufsize - n) == 0;
 }
 
+/* the read size; the data are checked in st_blksize blocks */
+#define DIG_READ_SIZE	(1024 * 1024)
+
 static void dig_holes(int fd, off_t file_off, off_t len)
 {
 	off_t file_end = len ? file_off + len : 0;
 	off_t hole_start = 0, hole_sz = 0;
 	uintmax_t ct = 0;
-	size_t  bufsz;
+	size_t  bufsz, rdsz;
 	char *buf;
 	struct stat st;
 #if defined(POSIX_FADV_SEQUENTIAL) && defined(HAVE_POSIX_FADVISE)
@@ -201,12 +195,12 @@ static void dig_holes(int fd, off_t file_off, off_t len)
 		err(EXIT_FAILURE, _("stat of %s failed"), filename);
 
 	bufsz = st.st_blksize;
+	rdsz = max(bufsz, DIG_READ_SIZE / bufsz * bufsz);
 
 	if (lseek(fd, file_off, SEEK_SET) < 0)
 		err(EXIT_FAILURE, _("seek on %s failed"), filename);
 
-	/* buffer + extra space for is_nul() sentinel */
-	buf = xmalloc(bufsz + sizeof(uintptr_t));
+	buf = xmalloc(rdsz);
 	while (file_end == 0 || file_off < file_end) {
 		/*
 		 * Detect data area (skip holes)
@@ -232,7 +226,7 @@ static void dig_holes(int fd, off_t file_off, off_t len)
 		 * Dig holes in the area
 		 */
 		while (off < end) {
-			ssize_t rsz = pread(fd, buf, bufsz, off);
+			ssize_t i, rsz = pread(fd, buf, rdsz, off);
 			if (rsz < 0 && errno)
 				err(EXIT_FAILURE, _("%s: read failed"), filename);
 			if (end && rsz > 0 && off > end - rsz)
@@ -240,15 +234,19 @@ static void dig_holes(int fd, off_t file_off, off_t len)
 			if (rsz <= 0)
 				break;
 
-			if (is_nul(buf, rsz)) {
-				if (!hole_sz)				/* new hole detected */
-					hole_start = off;
-				hole_sz += rsz;
-			 } else if (hole_sz) {
-				xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
-					   hole_start, hole_sz);
-				ct += hole_sz;
-				hole_sz = hole_start = 0;
+			for (i = 0; i < rsz; i += bufsz) {
+				size_t sz = min((size_t) (rsz - i), bufsz);
+
+				if (is_nul(buf + i, sz)) {
+					if (!hole_sz)			/* new hole detected */
+						hole_start = off + i;
+					hole_sz += sz;
+				} else if (hole_sz) {
+					xfallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE,
+						   hole_start, hole_sz);
+					ct += hole_sz;
+					hole_sz = hole_start = 0;
+				}
 			}
 
 #if defined(POSIX_FADV_DONTNEED) && defined(HAVE_POSIX_FADVISE)
@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <paths.h>
+#include <search.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,6 +44,7 @@
 #include "nls.h"
 #include "strutils.h"
 #include "closestream.h"
+#include "xalloc.h"
 #include "monotonic.h"
 #include "timer.h"
 
@@ -52,7 +54,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	printf(
 		_(" %1$s [options] <file>|<directory> <command> [<argument>...]\n"
 		  " %1$s [options] <file>|<directory> -c <command>\n"
-		  " %1$s [options] <file descriptor number>\n"),
+		  " %1$s [options] <file descriptor number>\n"
+		  " %1$s [options] --coproc <directory>\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, stdout);
@@ -68,6 +71,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(  " -o, --close              close file descriptor before running command\n"), stdout);
 	fputs(_(  " -c, --command <command>  run a single command string through the shell\n"), stdout);
 	fputs(_(  " -F, --no-fork            execute command without forking\n"), stdout);
+	fputs(_(  "     --coproc             serve lock requests from stdin for files in <directory>\n"), stdout);
 	fputs(_(  "     --verbose            increase verbosity\n"), stdout);
 	fputs(USAGE_SEPARATOR, stdout);
 	printf(USAGE_HELP_OPTIONS(26));
@@ -124,6 +128,171 @@ static void __attribute__((__noreturn__)) run_program(char **cmd_argv)
 	_exit((errno == ENOMEM) ? EX_OSERR : EX_UNAVAILABLE);
 }
 
+/*
+ * The --coproc mode. Lock requests are read from stdin, one per line, as
+ * "<request> <name>" where <name> is a file in the directory; the reply is
+ * a line with "ok", "busy" (conflict with -n or timeout with -w) or
+ * "error <message>". The lock files are kept open until EOF, so every
+ * request is only one flock(2) call.
+ */
+struct coproc_lock {
+	char *name;
+	int fd;
+	int type;		/* LOCK_SH, LOCK_EX or LOCK_UN */
+	unsigned int rdwr : 1;	/* opened O_RDWR for NFS */
+};
+
+struct coproc {
+	int dirfd;
+	void *locks;		/* tsearch() tree of struct coproc_lock */
+
+	struct itimerval timeout;
+	unsigned int have_timeout : 1,
+		     nonblock : 1,
+		     verbose : 1;
+};
+
+static int cmp_coproc_lock(const void *a, const void *b)
+{
+	return strcmp(((const struct coproc_lock *) a)->name,
+		      ((const struct coproc_lock *) b)->name);
+}
+
+static struct coproc_lock *coproc_get_lock(struct coproc *co, char *name, int create)
+{
+	struct coproc_lock key = { .name = name }, *lk, **node;
+
+	node = tfind(&key, &co->locks, cmp_coproc_lock);
+	if (node)
+		return *node;
+	if (!create)
+		return NULL;
+
+	lk = xcalloc(1, sizeof(*lk));
+	lk->fd = openat(co->dirfd, name, O_RDONLY | O_NOCTTY | O_CREAT | O_CLOEXEC, 0666);
+	if (lk->fd < 0 && errno == EISDIR)
+		lk->fd = openat(co->dirfd, name, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+	if (lk->fd < 0) {
+		free(lk);
+		return NULL;
+	}
+	lk->name = xstrdup(name);
+	lk->type = LOCK_UN;
+	tsearch(lk, &co->locks, cmp_coproc_lock);
+	return lk;
+}
+
+static const char *coproc_request(struct coproc *co, char *req, char *name)
+{
+	struct coproc_lock *lk;
+	struct ul_timer timer;
+	int type, block = 0, rc;
+
+	if (!strcmp(req, "lock"))
+		type = LOCK_EX, block = co->nonblock ? LOCK_NB : 0;
+	else if (!strcmp(req, "shared"))
+		type = LOCK_SH, block = co->nonblock ? LOCK_NB : 0;
+	else if (!strcmp(req, "trylock"))
+		type = LOCK_EX, block = LOCK_NB;
+	else if (!strcmp(req, "tryshared"))
+		type = LOCK_SH, block = LOCK_NB;
+	else if (!strcmp(req, "unlock"))
+		type = LOCK_UN;
+	else {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (!*name || strchr(name, '/') || !strcmp(name, ".") || !strcmp(name, "..")) {
+		errno = EINVAL;
+		return NULL;
+	}
+	lk = coproc_get_lock(co, name, type != LOCK_UN);
+	if (!lk)
+		return type == LOCK_UN ? "ok" : NULL;
+
+	if (type == LOCK_UN) {
+		if (lk->type != LOCK_UN && flock(lk->fd, LOCK_UN) != 0)
+			return NULL;
+		lk->type = LOCK_UN;
+		return "ok";
+	}
+
+	if (co->have_timeout && !block) {
+		timeout_expired = 0;
+		if (setup_timer(&timer, &co->timeout, &timeout_handler))
+			return NULL;
+	}
+	while ((rc = flock(lk->fd, type | block)) != 0) {
+		if (errno == EINTR && !timeout_expired)
+			continue;
+		if ((errno == EIO || errno == EBADF) && !lk->rdwr
+		    && type != LOCK_SH && lk->type == LOCK_UN) {
+			/* probably NFSv4, see main() */
+			int fd = openat(co->dirfd, name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+			if (fd >= 0) {
+				close(lk->fd);
+				lk->fd = fd;
+				lk->rdwr = 1;
+				continue;
+			}
+		}
+		break;
+	}
+	if (co->have_timeout && !block)
+		cancel_timer(&timer);
+
+	if (rc == 0) {
+		lk->type = type;
+		return "ok";
+	}
+	if (errno == EWOULDBLOCK || errno == EINTR) {
+		if (co->verbose)
+			warnx(_("%s: failed to get lock"), name);
+		return "busy";
+	}
+	return NULL;
+}
+
+static void __attribute__((__noreturn__)) run_coproc(struct coproc *co,
+						      const char *dirname)
+{
+	char *line = NULL;
+	size_t sz = 0;
+	ssize_t len;
+
+	co->dirfd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (co->dirfd < 0)
+		err(EX_NOINPUT, _("cannot open directory %s"), dirname);
+
+	/* the replies have to be visible to the other side immediately */
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	while ((len = getline(&line, &sz, stdin)) >= 0) {
+		char *req = line, *name;
+		const char *reply;
+
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		name = strchr(line, ' ');
+		if (name)
+			*name++ = '\0';
+		else
+			name = line + len;
+
+		reply = coproc_request(co, req, name);
+		if (reply)
+			printf("%s\n", reply);
+		else
+			printf("error %s\n", strerror(errno));
+	}
+
+	/* all the locks are dropped when the files are closed on exit */
+	free(line);
+	exit(EX_OK);
+}
+
 int main(int argc, char *argv[])
 {
 	struct ul_timer timer;
@@ -146,8 +315,10 @@ int main(int argc, char *argv[])
 	int conflict_exit_code = 1;
 	char **cmd_argv = NULL, *sh_c_argv[4];
 	const char *filename = NULL;
+	int coproc = 0;
 	enum {
-		OPT_VERBOSE = CHAR_MAX + 1
+		OPT_VERBOSE = CHAR_MAX + 1,
+		OPT_COPROC
 	};
 	static const struct option long_options[] = {
 		{"shared", no_argument, NULL, 's'},
@@ -161,6 +332,7 @@ int main(int argc, char *argv[])
 		{"close", no_argument, NULL, 'o'},
 		{"no-fork", no_argument, NULL, 'F'},
 		{"verbose", no_argument, NULL, OPT_VERBOSE},
+		{"coproc", no_argument, NULL, OPT_COPROC},
 		{"help", no_argument, NULL, 'h'},
 		{"version", no_argument, NULL, 'V'},
 		{NULL, 0, NULL, 0}
@@ -218,6 +390,9 @@ int main(int argc, char *argv[])
 		case OPT_VERBOSE:
 			verbose = 1;
 			break;
+		case OPT_COPROC:
+			coproc = 1;
+			break;
 
 		case 'V':
 			print_version(EX_OK);
@@ -232,6 +407,25 @@ int main(int argc, char *argv[])
 		errx(EX_USAGE,
 			_("the --no-fork and --close options are incompatible"));
 
+	if (coproc) {
+		struct coproc co = { .verbose = verbose, .nonblock = !!block };
+
+		if (argc != optind + 1)
+			errx(EX_USAGE, _("%s requires exactly one directory"), "--coproc");
+		if (no_fork || do_close || type == LOCK_UN)
+			errx(EX_USAGE, _("%s cannot be combined with %s, %s or %s"),
+					"--coproc", "--no-fork", "--close", "--unlock");
+		if (have_timeout) {
+			/* -w 0 is equivalent to -n */
+			if (timeout.it_value.tv_sec || timeout.it_value.tv_usec) {
+				co.have_timeout = 1;
+				co.timeout = timeout;
+			} else
+				co.nonblock = 1;
+		}
+		run_coproc(&co, argv[optind]);
+	}
+
 	if (argc > optind + 1) {
 		/* Run command */
 		if (!strcmp(argv[optind + 1], "-c") ||
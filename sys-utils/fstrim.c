@@ -35,9 +35,14 @@
 
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/vfs.h>
 #include <linux/fs.h>
 
+#ifdef HAVE_PTHREAD_H
+# include <pthread.h>
+#endif
+
 #include "nls.h"
 #include "xalloc.h"
 #include "strutils.h"
@@ -47,6 +52,7 @@
 #include "sysfs.h"
 #include "optutils.h"
 #include "statfs_magic.h"
+#include "fileutils.h"
 
 #include <libmount.h>
 
@@ -60,8 +66,26 @@ struct fstrim_range {
 #define FITRIM		_IOWR('X', 121, struct fstrim_range)
 #endif
 
+#define FSTRIM_PROGRESS_HEADER	"# fstrim progress v1"
+
+/* where to continue on the next run, see --state-file */
+struct fstrim_progress {
+	char *target;			/* mountpoint (realpath) */
+	uint64_t offset;
+};
+
 struct fstrim_control {
 	struct fstrim_range range;
+	unsigned int nworkers;		/* --workers */
+	uint64_t chunksize;		/* --chunk-size */
+	unsigned int pause;		/* --pause in milliseconds */
+
+	const char *statefile;		/* --state-file */
+	struct fstrim_progress *progress;
+	size_t nprogress;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t lock;		/* protects progress */
+#endif
 
 	unsigned int verbose : 1,
 		     quiet_unsupp : 1,
@@ -85,6 +109,245 @@ static int is_directory(const char *path, int silent)
 	return 1;
 }
 
+static void lock_ctl(struct fstrim_control *ctl __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&ctl->lock);
+#endif
+}
+
+static void unlock_ctl(struct fstrim_control *ctl __attribute__((__unused__)))
+{
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_unlock(&ctl->lock);
+#endif
+}
+
+/*
+ * Reads the --state-file. A missing file is not an error, the file is created
+ * by progress_save(). Invalid lines are ignored.
+ */
+static void progress_load(struct fstrim_control *ctl)
+{
+	char *line = NULL;
+	size_t sz = 0;
+	FILE *f;
+
+	f = fopen(ctl->statefile, "r" UL_CLOEXECSTR);
+	if (!f) {
+		if (errno != ENOENT)
+			warn(_("cannot open %s"), ctl->statefile);
+		return;
+	}
+
+	if (getline(&line, &sz, f) < 0
+	    || strncmp(line, FSTRIM_PROGRESS_HEADER "\n", sizeof(FSTRIM_PROGRESS_HEADER)) != 0) {
+		warnx(_("%s: unsupported state file format, ignoring"), ctl->statefile);
+		goto done;
+	}
+
+	while (getline(&line, &sz, f) >= 0) {
+		struct fstrim_progress *pr;
+		uintmax_t offset;
+		int n = 0;
+
+		rtrim_whitespace((unsigned char *) line);
+		if (sscanf(line, "%ju %n", &offset, &n) != 1 || !n || line[n] != '/')
+			continue;
+
+		ctl->progress = xrealloc(ctl->progress, (ctl->nprogress + 1)
+					* sizeof(struct fstrim_progress));
+		pr = &ctl->progress[ctl->nprogress++];
+		pr->target = xstrdup(line + n);
+		pr->offset = offset;
+	}
+done:
+	free(line);
+	fclose(f);
+}
+
+/* the file is replaced atomically; call with locked ctl */
+static void progress_save(struct fstrim_control *ctl)
+{
+	char *tmp;
+	size_t i;
+	FILE *f;
+	int fd;
+
+	xasprintf(&tmp, "%s.XXXXXX", ctl->statefile);
+	fd = mkstemp_cloexec(tmp);
+	if (fd < 0) {
+		warn(_("cannot create %s"), tmp);
+		goto done;
+	}
+	f = fdopen(fd, "w");
+	if (!f) {
+		warn(_("cannot open %s"), tmp);
+		close(fd);
+		unlink(tmp);
+		goto done;
+	}
+
+	fputs(FSTRIM_PROGRESS_HEADER "\n", f);
+	for (i = 0; i < ctl->nprogress; i++) {
+		struct fstrim_progress *pr = &ctl->progress[i];
+
+		if (pr->target)
+			fprintf(f, "%ju %s\n", (uintmax_t) pr->offset, pr->target);
+	}
+
+	if (close_stream(f) != 0) {
+		warn(_("write failed: %s"), tmp);
+		unlink(tmp);
+	} else if (rename(tmp, ctl->statefile) != 0) {
+		warn(_("cannot rename %s to %s"), tmp, ctl->statefile);
+		unlink(tmp);
+	}
+done:
+	free(tmp);
+}
+
+static struct fstrim_progress *progress_find(struct fstrim_control *ctl,
+					     const char *target)
+{
+	size_t i;
+
+	for (i = 0; i < ctl->nprogress; i++) {
+		if (ctl->progress[i].target
+		    && strcmp(ctl->progress[i].target, target) == 0)
+			return &ctl->progress[i];
+	}
+	return NULL;
+}
+
+/* returns the offset where the previous run stopped or @def */
+static uint64_t progress_get(struct fstrim_control *ctl, const char *target,
+			     uint64_t def)
+{
+	struct fstrim_progress *pr;
+
+	lock_ctl(ctl);
+	pr = progress_find(ctl, target);
+	if (pr)
+		def = pr->offset;
+	unlock_ctl(ctl);
+	return def;
+}
+
+/* records @offset for @target, or removes the record if the filesystem
+ * has been finished; the state file is updated */
+static void progress_set(struct fstrim_control *ctl, const char *target,
+			 uint64_t offset, int finished)
+{
+	struct fstrim_progress *pr;
+
+	lock_ctl(ctl);
+	pr = progress_find(ctl, target);
+	if (finished) {
+		if (pr) {
+			free(pr->target);
+			pr->target = NULL;
+		}
+	} else {
+		if (!pr) {
+			ctl->progress = xrealloc(ctl->progress, (ctl->nprogress + 1)
+						* sizeof(struct fstrim_progress));
+			pr = &ctl->progress[ctl->nprogress++];
+			pr->target = xstrdup(target);
+		}
+		pr->offset = offset;
+	}
+	progress_save(ctl);
+	unlock_ctl(ctl);
+}
+
+static void progress_free(struct fstrim_control *ctl)
+{
+	size_t i;
+
+	for (i = 0; i < ctl->nprogress; i++)
+		free(ctl->progress[i].target);
+	free(ctl->progress);
+	ctl->progress = NULL;
+	ctl->nprogress = 0;
+}
+
+/*
+ * Calls FITRIM for the range @start, @len in --chunk-size pieces, returns the
+ * number of the trimmed bytes in @trimmed.
+ *
+ * The filesystems (ext4, XFS) return EINVAL for a range behind the end of the
+ * filesystem; that's how we know that the whole filesystem has been trimmed.
+ * Not all filesystems do that (btrfs trims the unallocated space on every
+ * call), so the range is also limited by the filesystem size.
+ *
+ * returns: 0 = success, 1 = unsupported, < 0 = error
+ */
+static int fstrim_chunks(struct fstrim_control *ctl, int fd,
+			 const char *path, const char *target,
+			 uint64_t start, uint64_t len, uint64_t *trimmed)
+{
+	struct statvfs vfs;
+	uint64_t end = UINT64_MAX;
+	int rc = 0;
+
+	*trimmed = 0;
+
+	if (fstatvfs(fd, &vfs) == 0 && vfs.f_blocks && vfs.f_frsize)
+		end = (uint64_t) vfs.f_blocks * vfs.f_frsize;
+
+	while (len) {
+		struct fstrim_range range = {
+			.start = start,
+			.minlen = ctl->range.minlen
+		};
+		uint64_t step = min(len, ctl->chunksize);
+
+		if (start >= end) {
+			/* behind the end of the filesystem */
+			if (ctl->statefile)
+				progress_set(ctl, target, 0, 1);
+			return 0;
+		}
+		step = min(step, end - start);
+		range.len = step;
+
+		errno = 0;
+		if (ioctl(fd, FITRIM, &range)) {
+			if (errno == EINVAL && start > ctl->range.start) {
+				/* behind the end of the filesystem */
+				if (ctl->statefile)
+					progress_set(ctl, target, 0, 1);
+				return 0;
+			}
+			switch (errno) {
+			case EBADF:
+			case ENOTTY:
+			case EOPNOTSUPP:
+				return 1;
+			default:
+				rc = -errno;
+			}
+			warn(_("%s: FITRIM ioctl failed"), path);
+			return rc;
+		}
+		*trimmed += range.len;
+
+		if (step >= UINT64_MAX - start)
+			len = 0;	/* end of the address space */
+		else {
+			start += step;
+			len -= step;
+		}
+		if (ctl->statefile)
+			progress_set(ctl, target, start, 0);
+
+		if (len && ctl->pause)
+			xusleep((useconds_t) ctl->pause * 1000);
+	}
+	return rc;
+}
+
 /* returns: 0 = success, 1 = unsupported, < 0 = error */
 static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const char *devname)
 {
@@ -117,7 +380,17 @@ static int fstrim_filesystem(struct fstrim_control *ctl, const char *path, const
 	}
 
 	errno = 0;
-	if (ioctl(fd, FITRIM, &range)) {
+	if (ctl->chunksize) {
+		uint64_t start = ctl->range.start, trimmed;
+
+		if (ctl->statefile)
+			start = progress_get(ctl, rpath, start);
+		rc = fstrim_chunks(ctl, fd, path, rpath, start, ctl->range.len,
+				   &trimmed);
+		if (rc)
+			goto done;
+		range.len = trimmed;
+	} else if (ioctl(fd, FITRIM, &range)) {
 		switch (errno) {
 		case EBADF:
 		case ENOTTY:
@@ -156,7 +429,8 @@ done:
 	return rc;
 }
 
-static int has_discard(const char *devname, struct path_cxt **wholedisk)
+static int has_discard(const char *devname, struct path_cxt **wholedisk,
+		       dev_t *diskno)
 {
 	struct path_cxt *pc = NULL;
 	uint64_t dg = 0;
@@ -180,6 +454,8 @@ static int has_discard(const char *devname, struct path_cxt **wholedisk)
 	rc = sysfs_blkdev_get_wholedisk(pc, NULL, 0, &disk);
 	if (rc != 0 || !disk)
 		goto fail;
+	if (diskno)
+		*diskno = disk;
 
 	if (dev != disk) {
 		/* Partition, try reuse whole-disk context if valid for the
@@ -254,6 +530,97 @@ static int uniq_fs_source_cmp(
 	return !mnt_fs_streq_srcpath(a, mnt_fs_get_srcpath(b));
 }
 
+#ifdef HAVE_PTHREAD_H
+/* a filesystem to trim */
+struct fstrim_job {
+	const char *tgt;
+	const char *src;
+	dev_t disk;		/* whole disk, 0 if unknown */
+	int rc;			/* fstrim_filesystem() result */
+	struct fstrim_job *next;	/* next job on the same disk */
+};
+
+struct fstrim_workers {
+	struct fstrim_control *ctl;
+	pthread_mutex_t lock;
+	struct fstrim_job **disks;	/* the first job for each disk */
+	size_t ndisks;
+	size_t next;			/* the next disk to trim */
+};
+
+/* trims the filesystems of one disk after another */
+static void *fstrim_worker(void *data)
+{
+	struct fstrim_workers *wrk = data;
+
+	for (;;) {
+		struct fstrim_job *job = NULL;
+
+		pthread_mutex_lock(&wrk->lock);
+		if (wrk->next < wrk->ndisks)
+			job = wrk->disks[wrk->next++];
+		pthread_mutex_unlock(&wrk->lock);
+
+		if (!job)
+			break;
+		for (; job; job = job->next)
+			job->rc = fstrim_filesystem(wrk->ctl, job->tgt, job->src);
+	}
+	return NULL;
+}
+
+/*
+ * Trims the filesystems on the different disks in parallel, the filesystems
+ * on the same disk are trimmed one after another.
+ */
+static void fstrim_parallel(struct fstrim_control *ctl,
+			    struct fstrim_job *jobs, size_t njobs)
+{
+	struct fstrim_workers wrk = { .ctl = ctl };
+	pthread_t *threads;
+	size_t i, k;
+	unsigned int n, nthreads;
+
+	wrk.disks = xcalloc(njobs, sizeof(struct fstrim_job *));
+
+	/* group the jobs by the whole disks, keep the order */
+	for (i = 0; i < njobs; i++) {
+		struct fstrim_job *job = &jobs[i];
+
+		for (k = 0; job->disk && k < wrk.ndisks; k++) {
+			struct fstrim_job *x = wrk.disks[k];
+
+			if (x->disk != job->disk)
+				continue;
+			while (x->next)
+				x = x->next;
+			x->next = job;
+			break;
+		}
+		if (!job->disk || k == wrk.ndisks)
+			wrk.disks[wrk.ndisks++] = job;
+	}
+
+	nthreads = min((size_t) ctl->nworkers, wrk.ndisks);
+	threads = xcalloc(nthreads, sizeof(pthread_t));
+	pthread_mutex_init(&wrk.lock, NULL);
+
+	for (n = 0; n < nthreads; n++) {
+		if (pthread_create(&threads[n], NULL, fstrim_worker, &wrk) != 0)
+			break;
+	}
+	if (!n)
+		fstrim_worker(&wrk);	/* no thread, do it ourselves */
+
+	for (i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&wrk.lock);
+	free(threads);
+	free(wrk.disks);
+}
+#endif /* HAVE_PTHREAD_H */
+
 /*
  * -1 = tab empty
  *  0 = all success
@@ -269,9 +636,16 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	struct path_cxt *wholedisk = NULL;
 	int cnt = 0, cnt_err = 0;
 	int fstab = 0;
+#ifdef HAVE_PTHREAD_H
+	struct fstrim_job *jobs = NULL;
+	size_t i, njobs = 0;
+#endif
 
-	tab = mnt_new_table_from_file(filename);
+	tab = mnt_new_table();
 	if (!tab)
+		err(MNT_EX_FAIL, _("failed to initialize libmount table"));
+	mnt_table_enable_lazy_parse(tab, 1);	/* mountinfo options are not used */
+	if (mnt_table_parse_file(tab, filename) != 0)
 		err(MNT_EX_FAIL, _("failed to parse %s"), filename);
 
 	if (mnt_table_is_empty(tab)) {
@@ -352,6 +726,7 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 			   *tgt = mnt_fs_get_target(fs);
 		char *path;
 		int rc = 1;
+		dev_t disk = 0;
 
 		/* Is it really accessible mountpoint? Not all mountpoints are
 		 * accessible (maybe over mounted by another filesystem) */
@@ -371,10 +746,25 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 		}
 
 		if (!is_directory(tgt, 1) ||
-		    !has_discard(src, &wholedisk))
+		    !has_discard(src, &wholedisk, &disk))
 			continue;
 		cnt++;
 
+#ifdef HAVE_PTHREAD_H
+		if (ctl->nworkers > 1) {
+			/* trimmed later by fstrim_parallel() */
+			if (njobs % 16 == 0)
+				jobs = xrealloc(jobs, (njobs + 16) * sizeof(*jobs));
+			jobs[njobs].tgt = tgt;
+			jobs[njobs].src = src;
+			jobs[njobs].disk = disk;
+			jobs[njobs].rc = 0;
+			jobs[njobs].next = NULL;
+			njobs++;
+			continue;
+		}
+#endif
+
 		/*
 		 * We're able to detect that the device supports discard, but
 		 * things also depend on filesystem or device mapping, for
@@ -391,6 +781,20 @@ static int fstrim_all_from_file(struct fstrim_control *ctl, const char *filename
 	}
 	mnt_free_iter(itr);
 
+#ifdef HAVE_PTHREAD_H
+	if (njobs) {
+		fstrim_parallel(ctl, jobs, njobs);
+
+		for (i = 0; i < njobs; i++) {
+			if (jobs[i].rc < 0)
+				cnt_err++;
+			else if (jobs[i].rc == 1 && !ctl->quiet_unsupp)
+				warnx(_("%s: the discard operation is not supported"),
+				      jobs[i].tgt);
+		}
+		free(jobs);
+	}
+#endif
 	ul_unref_path(wholedisk);
 	mnt_unref_table(tab);
 	mnt_unref_cache(cache);
@@ -453,6 +857,12 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -v, --verbose            print number of discarded bytes\n"), out);
 	fputs(_("     --quiet-unsupported  suppress error messages if trim unsupported\n"), out);
 	fputs(_(" -n, --dry-run            does everything, but trim\n"), out);
+	fputs(_("     --chunk-size <num>   trim in ranges of <num> bytes\n"), out);
+	fputs(_("     --pause <msec>       sleep between the ranges\n"), out);
+	fputs(_("     --state-file <file>  continue where the previous run stopped\n"), out);
+#ifdef HAVE_PTHREAD_H
+	fputs(_("     --workers <num>      trim filesystems on <num> disks in parallel\n"), out);
+#endif
 
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(21));
@@ -473,7 +883,11 @@ int main(int argc, char **argv)
 			.range = { .len = ULLONG_MAX }
 	};
 	enum {
-		OPT_QUIET_UNSUPP = CHAR_MAX + 1
+		OPT_QUIET_UNSUPP = CHAR_MAX + 1,
+		OPT_WORKERS,
+		OPT_CHUNK_SIZE,
+		OPT_PAUSE,
+		OPT_STATE_FILE
 	};
 
 	static const struct option longopts[] = {
@@ -488,6 +902,10 @@ int main(int argc, char **argv)
 	    { "verbose",   no_argument,       NULL, 'v' },
 	    { "quiet-unsupported", no_argument,       NULL, OPT_QUIET_UNSUPP },
 	    { "dry-run",   no_argument,       NULL, 'n' },
+	    { "workers",   required_argument, NULL, OPT_WORKERS },
+	    { "chunk-size", required_argument, NULL, OPT_CHUNK_SIZE },
+	    { "pause",     required_argument, NULL, OPT_PAUSE },
+	    { "state-file", required_argument, NULL, OPT_STATE_FILE },
 	    { NULL, 0, NULL, 0 }
 	};
 
@@ -540,6 +958,23 @@ int main(int argc, char **argv)
 		case OPT_QUIET_UNSUPP:
 			ctl.quiet_unsupp = 1;
 			break;
+		case OPT_WORKERS:
+			ctl.nworkers = strtou32_or_err(optarg,
+					_("invalid workers argument"));
+			break;
+		case OPT_CHUNK_SIZE:
+			ctl.chunksize = strtosize_or_err(optarg,
+					_("failed to parse chunk size"));
+			if (!ctl.chunksize)
+				errx(EXIT_FAILURE, _("chunk size must be greater than zero"));
+			break;
+		case OPT_PAUSE:
+			ctl.pause = strtou32_or_err(optarg,
+					_("invalid pause argument"));
+			break;
+		case OPT_STATE_FILE:
+			ctl.statefile = optarg;
+			break;
 		case 'h':
 			usage();
 		case 'V':
@@ -560,13 +995,26 @@ int main(int argc, char **argv)
 		errtryhelp(EXIT_FAILURE);
 	}
 
-	if (all)
-		return fstrim_all(&ctl, tabs);	/* MNT_EX_* codes */
+	if ((ctl.pause || ctl.statefile) && !ctl.chunksize)
+		errx(EXIT_FAILURE, _("--pause and --state-file require --chunk-size"));
+	if (ctl.statefile) {
+#ifdef HAVE_PTHREAD_H
+		pthread_mutex_init(&ctl.lock, NULL);
+#endif
+		progress_load(&ctl);
+	}
+
+	if (all) {
+		rc = fstrim_all(&ctl, tabs);	/* MNT_EX_* codes */
+		progress_free(&ctl);
+		return rc;
+	}
 
 	if (!is_directory(path, 0))
 		return EXIT_FAILURE;
 
 	rc = fstrim_filesystem(&ctl, path, NULL);
+	progress_free(&ctl);
 	if (rc == 1 && ctl.quiet_unsupp)
 		rc = 0;
 	if (rc == 1)
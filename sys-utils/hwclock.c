@@ -1063,8 +1063,11 @@ manipulate_clock(const struct hwclock_control *ctl, const time_t set_time,
 		 * anything between the follow three statements.
 		 * Synchronization failure MUST exit, because all drift
 		 * operations are invalid without it.
+		 *
+		 * With --nosync the clock is read immediately; the tick is
+		 * then anywhere within the next second.
 		 */
-		if (synchronize_to_clock_tick(ctl))
+		if (!ctl->nosync && synchronize_to_clock_tick(ctl))
 			return EXIT_FAILURE;
 		read_hardware_clock(ctl, &hclock_valid, &hclocktime.tv_sec);
 		gettimeofday(&read_time, NULL);
@@ -1083,6 +1086,13 @@ manipulate_clock(const struct hwclock_control *ctl, const time_t set_time,
 				     hclocktime.tv_sec, &tdrift);
 		if (!ctl->show)
 			hclocktime = time_inc(tdrift, hclocktime.tv_sec);
+		if (ctl->nosync) {
+			/* use the middle of the second to halve the error */
+			hclocktime = time_inc(hclocktime, 0.5);
+			if (ctl->verbose)
+				printf(_("Read without clock tick synchronization, "
+					 "the error bound is +/- 0.5 seconds\n"));
+		}
 
 		startup_hclocktime =
 		 time_inc(hclocktime, time_diff(startup_time, read_time));
@@ -1194,6 +1204,7 @@ usage(void)
 	puts(_("     --update-drift   update the RTC drift factor"));
 	printf(_(
 	       "     --noadjfile      do not use %1$s\n"), _PATH_ADJTIME);
+	puts(_("     --nosync         do not wait for the RTC clock tick"));
 	printf(_(
 	       "     --adjfile <file> use an alternate file to %1$s\n"), _PATH_ADJTIME);
 	puts(_("     --test           dry run; implies --verbose"));
@@ -1229,6 +1240,7 @@ int main(int argc, char **argv)
 		OPT_GET,
 		OPT_GETEPOCH,
 		OPT_NOADJFILE,
+		OPT_NOSYNC,
 		OPT_PREDICT,
 		OPT_SET,
 		OPT_SETEPOCH,
@@ -1256,6 +1268,7 @@ int main(int argc, char **argv)
 		{ "epoch",        required_argument, NULL, OPT_EPOCH      },
 #endif
 		{ "noadjfile",    no_argument,       NULL, OPT_NOADJFILE  },
+		{ "nosync",       no_argument,       NULL, OPT_NOSYNC     },
 		{ "directisa",    no_argument,       NULL, OPT_DIRECTISA  },
 		{ "test",         no_argument,       NULL, OPT_TEST       },
 		{ "date",         required_argument, NULL, OPT_DATE       },
@@ -1275,9 +1288,11 @@ int main(int argc, char **argv)
 		{ 'a','r','s','w',
 		  OPT_GET, OPT_GETEPOCH, OPT_PREDICT,
 		  OPT_SET, OPT_SETEPOCH, OPT_SYSTZ },
+		{ 'a', OPT_NOSYNC },
 		{ 'l', 'u' },
 		{ OPT_ADJFILE, OPT_NOADJFILE },
 		{ OPT_NOADJFILE, OPT_UPDATE },
+		{ OPT_NOSYNC, OPT_UPDATE },
 		{ 0 }
 	};
 	int excl_st[ARRAY_SIZE(excl)] = UL_EXCL_STATUS_INIT;
@@ -1371,6 +1386,9 @@ int main(int argc, char **argv)
 		case OPT_NOADJFILE:
 			ctl.noadjfile = 1;
 			break;
+		case OPT_NOSYNC:
+			ctl.nosync = 1;
+			break;
 		case OPT_DIRECTISA:
 			ctl.directisa = 1;
 			break;
@@ -41,6 +41,7 @@ struct hwclock_control {
 		setepoch:1,
 #endif
 		noadjfile:1,
+		nosync:1,
 		local_opt:1,
 		directisa:1,
 		testing:1,
@@ -97,6 +97,28 @@ int ipc_shm_get_limits(struct ipc_limits *lim)
 	return 0;
 }
 
+static void shm_from_ds(struct shm_data *p, int shmid, struct shmid_ds *shmseg)
+{
+	struct ipc_perm *ipcp = &shmseg->shm_perm;
+
+	p->shm_perm.key = ipcp->KEY;
+	p->shm_perm.id = shmid;
+	p->shm_perm.mode = ipcp->mode;
+	p->shm_segsz = shmseg->shm_segsz;
+	p->shm_cprid = shmseg->shm_cpid;
+	p->shm_lprid = shmseg->shm_lpid;
+	p->shm_nattch = shmseg->shm_nattch;
+	p->shm_perm.uid = ipcp->uid;
+	p->shm_perm.gid = ipcp->gid;
+	p->shm_perm.cuid = ipcp->cuid;
+	p->shm_perm.cgid = ipcp->cgid;
+	p->shm_atim = shmseg->shm_atime;
+	p->shm_dtim = shmseg->shm_dtime;
+	p->shm_ctim = shmseg->shm_ctime;
+	p->shm_rss = 0xdead;
+	p->shm_swp = 0xdead;
+}
+
 int ipc_shm_get_info(int id, struct shm_data **shmds)
 {
 	FILE *f;
@@ -108,6 +130,16 @@ int ipc_shm_get_info(int id, struct shm_data **shmds)
 	p = *shmds = xcalloc(1, sizeof(struct shm_data));
 	p->next = NULL;
 
+	/*
+	 * A single segment is read by IPC_STAT, the /proc file lists all
+	 * segments and it's expensive to parse on systems with many of them.
+	 * The /proc file is used if IPC_STAT is not permitted.
+	 */
+	if (id > -1 && shmctl(id, IPC_STAT, &dummy) == 0) {
+		shm_from_ds(p, id, &dummy);
+		return 1;
+	}
+
 	f = fopen(_PATH_PROC_SYSV_SHM, "r");
 	if (!f)
 		goto shm_fallback;
@@ -167,7 +199,6 @@ shm_fallback:
 	for (j = 0; j <= maxid; j++) {
 		int shmid;
 		struct shmid_ds shmseg;
-		struct ipc_perm *ipcp = &shmseg.shm_perm;
 
 		shmid = shmctl(j, SHM_STAT, &shmseg);
 		if (shmid < 0 || (id > -1 && shmid != id)) {
@@ -175,22 +206,7 @@ shm_fallback:
 		}
 
 		i++;
-		p->shm_perm.key = ipcp->KEY;
-		p->shm_perm.id = shmid;
-		p->shm_perm.mode = ipcp->mode;
-		p->shm_segsz = shmseg.shm_segsz;
-		p->shm_cprid = shmseg.shm_cpid;
-		p->shm_lprid = shmseg.shm_lpid;
-		p->shm_nattch = shmseg.shm_nattch;
-		p->shm_perm.uid = ipcp->uid;
-		p->shm_perm.gid = ipcp->gid;
-		p->shm_perm.cuid = ipcp->cuid;
-		p->shm_perm.cgid = ipcp->cuid;
-		p->shm_atim = shmseg.shm_atime;
-		p->shm_dtim = shmseg.shm_dtime;
-		p->shm_ctim = shmseg.shm_ctime;
-		p->shm_rss = 0xdead;
-		p->shm_swp = 0xdead;
+		shm_from_ds(p, shmid, &shmseg);
 
 		if (id < 0) {
 			p->next = xcalloc(1, sizeof(struct shm_data));
@@ -217,19 +233,25 @@ void ipc_shm_free_info(struct shm_data *shmds)
 static void get_sem_elements(struct sem_data *p)
 {
 	size_t i;
+	unsigned short *vals;
+	union semun all;
 
 	if (!p || !p->sem_nsems || p->sem_nsems > SIZE_MAX || p->sem_perm.id < 0)
 		return;
 
 	p->elements = xcalloc(p->sem_nsems, sizeof(struct sem_elem));
 
+	/* all the values by one call rather than GETVAL for each semaphore */
+	vals = xcalloc(p->sem_nsems, sizeof(unsigned short));
+	all.array = vals;
+	if (semctl(p->sem_perm.id, 0, GETALL, all) < 0)
+		err(EXIT_FAILURE, _("%s failed"), "semctl(GETALL)");
+
 	for (i = 0; i < p->sem_nsems; i++) {
 		struct sem_elem *e = &p->elements[i];
 		union semun arg = { .val = 0 };
 
-		e->semval = semctl(p->sem_perm.id, i, GETVAL, arg);
-		if (e->semval < 0)
-			err(EXIT_FAILURE, _("%s failed"), "semctl(GETVAL)");
+		e->semval = vals[i];
 
 		e->ncount = semctl(p->sem_perm.id, i, GETNCNT, arg);
 		if (e->ncount < 0)
@@ -243,6 +265,23 @@ static void get_sem_elements(struct sem_data *p)
 		if (e->pid < 0)
 			err(EXIT_FAILURE, _("%s failed"), "semctl(GETPID)");
 	}
+	free(vals);
+}
+
+static void sem_from_ds(struct sem_data *p, int semid, struct semid_ds *semseg)
+{
+	struct ipc_perm *ipcp = &semseg->sem_perm;
+
+	p->sem_perm.key = ipcp->KEY;
+	p->sem_perm.id = semid;
+	p->sem_perm.mode = ipcp->mode;
+	p->sem_nsems = semseg->sem_nsems;
+	p->sem_perm.uid = ipcp->uid;
+	p->sem_perm.gid = ipcp->gid;
+	p->sem_perm.cuid = ipcp->cuid;
+	p->sem_perm.cgid = ipcp->cgid;
+	p->sem_otime = semseg->sem_otime;
+	p->sem_ctime = semseg->sem_ctime;
 }
 
 int ipc_sem_get_info(int id, struct sem_data **semds)
@@ -256,6 +295,18 @@ int ipc_sem_get_info(int id, struct sem_data **semds)
 	p = *semds = xcalloc(1, sizeof(struct sem_data));
 	p->next = NULL;
 
+	/* see ipc_shm_get_info() */
+	if (id > -1) {
+		struct semid_ds semseg;
+
+		arg.buf = &semseg;
+		if (semctl(id, 0, IPC_STAT, arg) == 0) {
+			sem_from_ds(p, id, &semseg);
+			get_sem_elements(p);
+			return 1;
+		}
+	}
+
 	f = fopen(_PATH_PROC_SYSV_SEM, "r");
 	if (!f)
 		goto sem_fallback;
@@ -307,7 +358,6 @@ sem_fallback:
 	for (j = 0; j <= maxid; j++) {
 		int semid;
 		struct semid_ds semseg;
-		struct ipc_perm *ipcp = &semseg.sem_perm;
 		arg.buf = (struct semid_ds *)&semseg;
 
 		semid = semctl(j, 0, SEM_STAT, arg);
@@ -316,16 +366,7 @@ sem_fallback:
 		}
 
 		i++;
-		p->sem_perm.key = ipcp->KEY;
-		p->sem_perm.id = semid;
-		p->sem_perm.mode = ipcp->mode;
-		p->sem_nsems = semseg.sem_nsems;
-		p->sem_perm.uid = ipcp->uid;
-		p->sem_perm.gid = ipcp->gid;
-		p->sem_perm.cuid = ipcp->cuid;
-		p->sem_perm.cgid = ipcp->cuid;
-		p->sem_otime = semseg.sem_otime;
-		p->sem_ctime = semseg.sem_ctime;
+		sem_from_ds(p, semid, &semseg);
 
 		if (id < 0) {
 			p->next = xcalloc(1, sizeof(struct sem_data));
@@ -353,6 +394,27 @@ void ipc_sem_free_info(struct sem_data *semds)
 	}
 }
 
+static void msg_from_ds(struct msg_data *p, int msgid, struct msqid_ds *msgseg)
+{
+	struct ipc_perm *ipcp = &msgseg->msg_perm;
+
+	p->msg_perm.key = ipcp->KEY;
+	p->msg_perm.id = msgid;
+	p->msg_perm.mode = ipcp->mode;
+	p->q_cbytes = msgseg->msg_cbytes;
+	p->q_qnum = msgseg->msg_qnum;
+	p->q_lspid = msgseg->msg_lspid;
+	p->q_lrpid = msgseg->msg_lrpid;
+	p->msg_perm.uid = ipcp->uid;
+	p->msg_perm.gid = ipcp->gid;
+	p->msg_perm.cuid = ipcp->cuid;
+	p->msg_perm.cgid = ipcp->cgid;
+	p->q_stime = msgseg->msg_stime;
+	p->q_rtime = msgseg->msg_rtime;
+	p->q_ctime = msgseg->msg_ctime;
+	p->q_qbytes = msgseg->msg_qbytes;
+}
+
 int ipc_msg_get_info(int id, struct msg_data **msgds)
 {
 	FILE *f;
@@ -364,6 +426,12 @@ int ipc_msg_get_info(int id, struct msg_data **msgds)
 	p = *msgds = xcalloc(1, sizeof(struct msg_data));
 	p->next = NULL;
 
+	/* see ipc_shm_get_info() */
+	if (id > -1 && msgctl(id, IPC_STAT, &msgseg) == 0) {
+		msg_from_ds(p, id, &msgseg);
+		return 1;
+	}
+
 	f = fopen(_PATH_PROC_SYSV_MSG, "r");
 	if (!f)
 		goto msg_fallback;
@@ -418,7 +486,6 @@ msg_fallback:
 
 	for (j = 0; j <= maxid; j++) {
 		int msgid;
-		struct ipc_perm *ipcp = &msgseg.msg_perm;
 
 		msgid = msgctl(j, MSG_STAT, &msgseg);
 		if (msgid < 0 || (id > -1 && msgid != id)) {
@@ -426,21 +493,7 @@ msg_fallback:
 		}
 
 		i++;
-		p->msg_perm.key = ipcp->KEY;
-		p->msg_perm.id = msgid;
-		p->msg_perm.mode = ipcp->mode;
-		p->q_cbytes = msgseg.msg_cbytes;
-		p->q_qnum = msgseg.msg_qnum;
-		p->q_lspid = msgseg.msg_lspid;
-		p->q_lrpid = msgseg.msg_lrpid;
-		p->msg_perm.uid = ipcp->uid;
-		p->msg_perm.gid = ipcp->gid;
-		p->msg_perm.cuid = ipcp->cuid;
-		p->msg_perm.cgid = ipcp->cgid;
-		p->q_stime = msgseg.msg_stime;
-		p->q_rtime = msgseg.msg_rtime;
-		p->q_ctime = msgseg.msg_ctime;
-		p->q_qbytes = msgseg.msg_qbytes;
+		msg_from_ds(p, msgid, &msgseg);
 
 		if (id < 0) {
 			p->next = xcalloc(1, sizeof(struct msg_data));
@@ -21,6 +21,7 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <locale.h>
 #include <stdio.h>
@@ -175,12 +176,11 @@ static struct libscols_line *new_scols_line(struct libscols_table *table)
 	return line;
 }
 
-static void add_scols_line(struct irq_output *out,
+static void set_scols_line(struct irq_output *out,
 			   struct irq_info *info,
-			   struct libscols_table *table)
+			   struct libscols_line *line)
 {
 	size_t i;
-	struct libscols_line *line = new_scols_line(table);
 
 	for (i = 0; i < out->ncolumns; i++) {
 		char *str = NULL;
@@ -228,39 +228,103 @@ static char *remove_repeated_spaces(char *str)
 	return str;
 }
 
+/*
+ * Reads the whole @softirq or interrupts file into a buffer. The file is kept
+ * open and the buffer is reused by all the updates, so irqtop does not
+ * reopen the file or allocate on each refresh.
+ *
+ * Returns the size of the data or -1 on error.
+ */
+static ssize_t read_irqfile(int softirq, char **data)
+{
+	static int fds[2] = { -1, -1 };
+	static char *buf;
+	static size_t bufsz;
+	const char *path = softirq ? _PATH_PROC_SOFTIRQS : _PATH_PROC_INTERRUPTS;
+	size_t off = 0;
+	ssize_t n;
+
+	if (fds[softirq] < 0) {
+		fds[softirq] = open(path, O_RDONLY | O_CLOEXEC);
+		if (fds[softirq] < 0) {
+			warn(_("cannot open %s"), path);
+			return -1;
+		}
+	}
+	if (!buf) {
+		bufsz = BUFSIZ * 4;
+		buf = xmalloc(bufsz);
+	}
+
+	while ((n = pread(fds[softirq], buf + off, bufsz - off - 1, off)) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("cannot read %s"), path);
+			return -1;
+		}
+		off += n;
+		if (off == bufsz - 1) {
+			bufsz *= 2;
+			buf = xrealloc(buf, bufsz);
+		}
+	}
+	buf[off] = '\0';
+	*data = buf;
+	return off;
+}
+
+/* parses the next number from @str, returns 0 if there is no number */
+static inline int next_count(char **str, unsigned long *num)
+{
+	char *p = *str;
+	unsigned long x = 0;
+
+	while (*p == ' ')
+		p++;
+	if (!isdigit((unsigned char) *p))
+		return 0;
+	while (isdigit((unsigned char) *p))
+		x = x * 10 + (*p++ - '0');
+
+	*num = x;
+	*str = p;
+	return 1;
+}
+
 /*
  * irqinfo - parse the system's interrupts
+ *
+ * If @prev is specified, the deltas are calculated and the IRQ names are
+ * moved from @prev to the new stat if the IRQ has not been changed. The
+ * @prev counters stay unmodified.
  */
-static struct irq_stat *get_irqinfo(int softirq)
+static struct irq_stat *get_irqinfo(int softirq, struct irq_stat *prev)
 {
-	FILE *irqfile;
-	char *line = NULL, *tmp;
-	size_t len = 0;
+	char *data, *line, *next, *tmp;
 	struct irq_stat *stat;
 	struct irq_info *curr;
 
-	/* NAME + ':' + 11 bytes/cpu + IRQ_NAME_LEN */
-	stat = xcalloc(1, sizeof(*stat));
+	if (read_irqfile(softirq, &data) < 0)
+		return NULL;
 
-	stat->irq_info = xmalloc(sizeof(*stat->irq_info) * IRQ_INFO_LEN);
-	stat->nr_irq_info = IRQ_INFO_LEN;
+	stat = xcalloc(1, sizeof(*stat));
 
-	if (softirq)
-		irqfile = fopen(_PATH_PROC_SOFTIRQS, "r");
-	else
-		irqfile = fopen(_PATH_PROC_INTERRUPTS, "r");
-	if (!irqfile) {
-		warn(_("cannot open %s"), _PATH_PROC_INTERRUPTS);
-		goto free_stat;
-	}
+	stat->nr_irq_info = prev && prev->nr_irq_info ? prev->nr_irq_info : IRQ_INFO_LEN;
+	stat->irq_info = xmalloc(sizeof(*stat->irq_info) * stat->nr_irq_info);
 
 	/* read header firstly */
-	if (getline(&line, &len, irqfile) < 0) {
-		warn(_("cannot read %s"), _PATH_PROC_INTERRUPTS);
-		goto close_file;
+	next = strchr(data, '\n');
+	if (!next) {
+		warnx(_("cannot read %s"), softirq ? _PATH_PROC_SOFTIRQS :
+						     _PATH_PROC_INTERRUPTS);
+		free(stat->irq_info);
+		free(stat);
+		return NULL;
 	}
+	*next++ = '\0';
 
-	tmp = line;
+	tmp = data;
 	while ((tmp = strstr(tmp, "CPU")) != NULL) {
 		tmp += 3;	/* skip this "CPU", find next */
 		stat->nr_active_cpu++;
@@ -269,48 +333,63 @@ static struct irq_stat *get_irqinfo(int softirq)
 	stat->cpus =  xcalloc(stat->nr_active_cpu, sizeof(struct irq_cpu));
 
 	/* parse each line of _PATH_PROC_INTERRUPTS */
-	while (getline(&line, &len, irqfile) >= 0) {
+	for (line = next; line && *line; line = next) {
+		struct irq_info *pre = NULL;
 		unsigned long count;
 		size_t index;
-		int length;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
 
 		tmp = strchr(line, ':');
 		if (!tmp)
 			continue;
+		*tmp++ = '\0';
 
-		length = strlen(line);
+		while (isspace((unsigned char) *line))
+			line++;
 
 		curr = stat->irq_info + stat->nr_irq++;
 		memset(curr, 0, sizeof(*curr));
-		*tmp = '\0';
-		curr->irq = xstrdup(line);
-		ltrim_whitespace((unsigned char *)curr->irq);
 
-		tmp += 1;
-		for (index = 0; (index < stat->nr_active_cpu) && (tmp - line < length); index++) {
+		/* the same IRQ as in the previous update */
+		if (prev && stat->nr_irq <= prev->nr_irq
+		    && prev->irq_info[stat->nr_irq - 1].irq
+		    && strcmp(prev->irq_info[stat->nr_irq - 1].irq, line) == 0)
+			pre = &prev->irq_info[stat->nr_irq - 1];
+
+		for (index = 0; index < stat->nr_active_cpu
+				&& next_count(&tmp, &count); index++) {
 			struct irq_cpu *cpu = &stat->cpus[index];
 
-			sscanf(tmp, " %10lu", &count);
 			curr->total += count;
 			cpu->total += count;
 			stat->total_irq += count;
-
-			tmp += 11;
 		}
 
-		/* softirq always has no desc, add additional desc for softirq */
-		if (softirq)
-			get_softirq_desc(curr);
-		else {
-			if (tmp - line < length) {
+		if (pre) {
+			curr->delta = curr->total - pre->total;
+			stat->delta_irq += curr->delta;
+
+			curr->irq = pre->irq;
+			curr->name = pre->name;
+			pre->irq = pre->name = NULL;
+
+		} else {
+			curr->irq = xstrdup(line);
+
+			/* softirq always has no desc, add additional desc for softirq */
+			if (softirq)
+				get_softirq_desc(curr);
+			else {
 				/* strip all space before desc */
-				while (isspace(*tmp))
+				while (isspace((unsigned char) *tmp))
 					tmp++;
 				tmp = remove_repeated_spaces(tmp);
 				rtrim_whitespace((unsigned char *)tmp);
 				curr->name = xstrdup(tmp);
-			} else /* no irq name string, we have to set '\0' here */
-				curr->name = xstrdup("");
+			}
 		}
 
 		if (stat->nr_irq == stat->nr_irq_info) {
@@ -319,18 +398,8 @@ static struct irq_stat *get_irqinfo(int softirq)
 						  sizeof(*stat->irq_info) * stat->nr_irq_info);
 		}
 	}
-	fclose(irqfile);
-	free(line);
-	return stat;
 
- close_file:
-	fclose(irqfile);
- free_stat:
-	free(stat->irq_info);
-	free(stat->cpus);
-	free(stat);
-	free(line);
-	return NULL;
+	return stat;
 }
 
 void free_irqstat(struct irq_stat *stat)
@@ -419,25 +488,14 @@ void set_sort_func_by_key(struct irq_output *out, char c)
 	}
 }
 
-struct libscols_table *get_scols_cpus_table(struct irq_output *out,
-					struct irq_stat *prev,
-					struct irq_stat *curr)
+static struct libscols_table *new_scols_cpus_table(struct irq_output *out,
+						   struct irq_stat *curr)
 {
 	struct libscols_table *table;
 	struct libscols_column *cl;
-	struct libscols_line *ln;
 	char colname[sizeof(stringify_value(LONG_MAX))];
 	size_t i;
 
-	if (prev) {
-		for (i = 0; i < curr->nr_active_cpu; i++) {
-			struct irq_cpu *pre = &prev->cpus[i];
-			struct irq_cpu *cur = &curr->cpus[i];
-
-			cur->delta = cur->total - pre->total;
-		}
-	}
-
 	table = scols_new_table();
 	if (!table) {
 		warn(_("failed to initialize output table"));
@@ -464,7 +522,54 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	}
 
 	/* per cpu % of total */
-	ln = new_scols_line(table);
+	if (!new_scols_line(table))
+		goto err;
+	/* per cpu % of delta */
+	if (!new_scols_line(table))
+		goto err;
+
+	return table;
+ err:
+	scols_unref_table(table);
+	return NULL;
+}
+
+/*
+ * Updates the cells of @table (or of a new table if @table is NULL) by the
+ * @curr stats. The @table is reused if the number of CPUs has not been
+ * changed, otherwise it's deallocated and replaced by a new table.
+ *
+ * Returns the table or NULL on error.
+ */
+struct libscols_table *update_scols_cpus_table(struct irq_output *out,
+					struct libscols_table *table,
+					struct irq_stat *prev,
+					struct irq_stat *curr)
+{
+	struct libscols_line *ln;
+	size_t i, off = out->json ? 0 : 1;
+
+	if (prev && prev->nr_active_cpu == curr->nr_active_cpu) {
+		for (i = 0; i < curr->nr_active_cpu; i++) {
+			struct irq_cpu *pre = &prev->cpus[i];
+			struct irq_cpu *cur = &curr->cpus[i];
+
+			cur->delta = cur->total - pre->total;
+		}
+	}
+
+	if (table && scols_table_get_ncols(table) != curr->nr_active_cpu + off) {
+		scols_unref_table(table);
+		table = NULL;
+	}
+	if (!table) {
+		table = new_scols_cpus_table(out, curr);
+		if (!table)
+			return NULL;
+	}
+
+	/* per cpu % of total */
+	ln = scols_table_get_line(table, 0);
 	if (!ln || (!out->json && scols_line_set_data(ln, 0, "%irq:") != 0))
 		goto err;
 
@@ -473,12 +578,12 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 		char *str;
 
 		xasprintf(&str, "%0.1f", (double)((long double) cpu->total / (long double) curr->total_irq * 100.0));
-		if (str && scols_line_refer_data(ln, i + 1, str) != 0)
+		if (str && scols_line_refer_data(ln, i + off, str) != 0)
 			goto err;
 	}
 
 	/* per cpu % of delta */
-	ln = new_scols_line(table);
+	ln = scols_table_get_line(table, 1);
 	/* xgettext:no-c-format */
 	if (!ln || (!out->json && scols_line_set_data(ln, 0, _("%delta:")) != 0))
 		goto err;
@@ -487,10 +592,12 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 		struct irq_cpu *cpu = &curr->cpus[i];
 		char *str;
 
-		if (!curr->delta_irq)
+		if (!curr->delta_irq) {
+			scols_line_refer_data(ln, i + off, NULL);
 			continue;
+		}
 		xasprintf(&str, "%0.1f", (double)((long double) cpu->delta / (long double) curr->delta_irq * 100.0));
-		if (str && scols_line_refer_data(ln, i + 1, str) != 0)
+		if (str && scols_line_refer_data(ln, i + off, str) != 0)
 			goto err;
 	}
 
@@ -500,48 +607,76 @@ struct libscols_table *get_scols_cpus_table(struct irq_output *out,
 	return NULL;
 }
 
-struct libscols_table *get_scols_table(struct irq_output *out,
-					      struct irq_stat *prev,
-					      struct irq_stat **xstat,
-					      int softirq)
+struct libscols_table *get_scols_cpus_table(struct irq_output *out,
+					struct irq_stat *prev,
+					struct irq_stat *curr)
 {
-	struct libscols_table *table;
+	return update_scols_cpus_table(out, NULL, prev, curr);
+}
+
+/*
+ * Reads the stats and updates @table (or a new table if @table is NULL). The
+ * already existing lines are reused, the cells are updated in place and the
+ * lines which are not necessary anymore are removed. If @maxlines is not zero,
+ * then only the first @maxlines IRQs (after sort) are added to the table.
+ *
+ * Returns the table or NULL on error, the @table is deallocated on error.
+ */
+struct libscols_table *update_scols_table(struct irq_output *out,
+					  struct libscols_table *table,
+					  struct irq_stat *prev,
+					  struct irq_stat **xstat,
+					  int softirq,
+					  size_t maxlines)
+{
+	struct libscols_iter *itr;
+	struct libscols_line *ln;
 	struct irq_info *result;
 	struct irq_stat *stat;
-	size_t size;
+	size_t size, nlines;
 	size_t i;
+	int reuse = 1;
 
-	/* the stats */
-	stat = get_irqinfo(softirq);
+	/* the stats, incl. deltas */
+	stat = get_irqinfo(softirq, prev);
 	if (!stat)
-		return NULL;
+		goto err;
 
 	size = sizeof(*stat->irq_info) * stat->nr_irq;
 	result = xmalloc(size);
 	memcpy(result, stat->irq_info, size);
 
-	if (prev) {
-		stat->delta_irq = 0;
-		for (i = 0; i < stat->nr_irq; i++) {
-			struct irq_info *cur = &result[i];
-			struct irq_info *pre = &prev->irq_info[i];
-
-			cur->delta = cur->total - pre->total;
-			stat->delta_irq += cur->delta;
-		}
-	}
 	sort_result(out, result, stat->nr_irq);
 
-	table = new_scols_table(out);
-	if (!table) {
+	if (!table)
+		table = new_scols_table(out);
+	itr = scols_new_iter(SCOLS_ITER_FORWARD);
+	if (!table || !itr) {
 		free(result);
 		free_irqstat(stat);
-		return NULL;
+		scols_free_iter(itr);
+		goto err;
 	}
 
-	for (i = 0; i < stat->nr_irq; i++)
-		add_scols_line(out, &result[i], table);
+	nlines = stat->nr_irq;
+	if (maxlines && nlines > maxlines)
+		nlines = maxlines;
 
+	for (i = 0; i < nlines; i++) {
+		if (!reuse || scols_table_next_line(table, itr, &ln) != 0) {
+			reuse = 0;
+			ln = new_scols_line(table);
+			if (!ln)
+				break;
+		}
+		set_scols_line(out, &result[i], ln);
+	}
+
+	/* remove the rest of the lines from the previous update */
+	while (reuse && scols_table_next_line(table, itr, &ln) == 0)
+		scols_table_remove_line(table, ln);
+
+	scols_free_iter(itr);
 	free(result);
 
 	if (xstat)
@@ -550,4 +685,15 @@ struct libscols_table *get_scols_table(struct irq_output *out,
 		free_irqstat(stat);
 
 	return table;
+ err:
+	scols_unref_table(table);
+	return NULL;
+}
+
+struct libscols_table *get_scols_table(struct irq_output *out,
+					      struct irq_stat *prev,
+					      struct irq_stat **xstat,
+					      int softirq)
+{
+	return update_scols_table(out, NULL, prev, xstat, softirq, 0);
 }
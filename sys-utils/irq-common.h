@@ -65,8 +65,20 @@ struct libscols_table *get_scols_table(struct irq_output *out,
                                               struct irq_stat **xstat,
                                               int softirq);
 
+struct libscols_table *update_scols_table(struct irq_output *out,
+                                          struct libscols_table *table,
+                                          struct irq_stat *prev,
+                                          struct irq_stat **xstat,
+                                          int softirq,
+                                          size_t maxlines);
+
 struct libscols_table *get_scols_cpus_table(struct irq_output *out,
                                         struct irq_stat *prev,
                                         struct irq_stat *curr);
 
+struct libscols_table *update_scols_cpus_table(struct irq_output *out,
+                                        struct libscols_table *table,
+                                        struct irq_stat *prev,
+                                        struct irq_stat *curr);
+
 #endif /* UTIL_LINUX_H_IRQ_COMMON */
@@ -78,6 +78,10 @@ struct irqtop_ctl {
 	struct itimerspec timer;
 	struct irq_stat	*prev_stat;
 
+	/* the tables are reused by all updates */
+	struct libscols_table *table;
+	struct libscols_table *cpus;
+
 	unsigned int request_exit:1;
 	unsigned int softirq:1;
 };
@@ -98,24 +102,31 @@ static void parse_input(struct irqtop_ctl *ctl, struct irq_output *out, char c)
 
 static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 {
-	struct libscols_table *table, *cpus;
+	struct libscols_table *table;
 	struct irq_stat *stat;
 	time_t now = time(NULL);
 	char timestr[64], *data, *data0, *p;
 
-	/* make irqs table */
-	table = get_scols_table(out, ctl->prev_stat, &stat, ctl->softirq);
+	/* update irqs table, the lines out of the screen are not necessary */
+	table = ctl->table = update_scols_table(out, ctl->table, ctl->prev_stat,
+					&stat, ctl->softirq, ctl->rows);
 	if (!table) {
 		ctl->request_exit = 1;
 		return 1;
 	}
 	scols_table_enable_maxout(table, 1);
 	scols_table_enable_nowrap(table, 1);
+
+	/* the width is reduced by every print, reset it for the reused tables */
+	if (ctl->cols > 0)
+		scols_table_set_termwidth(table, ctl->cols);
 	scols_table_reduce_termwidth(table, 1);
 
-	/* make cpus table */
-	cpus = get_scols_cpus_table(out, ctl->prev_stat, stat);
-	scols_table_reduce_termwidth(cpus, 1);
+	/* update cpus table */
+	ctl->cpus = update_scols_cpus_table(out, ctl->cpus, ctl->prev_stat, stat);
+	if (ctl->cpus && ctl->cols > 0)
+		scols_table_set_termwidth(ctl->cpus, ctl->cols);
+	scols_table_reduce_termwidth(ctl->cpus, 1);
 
 	/* print header */
 	move(0, 0);
@@ -124,9 +135,10 @@ static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 			   stat->total_irq, stat->delta_irq, ctl->hostname, timestr);
 
 	/* print cpus table */
-	scols_print_table_to_string(cpus, &data);
-	wprintw(ctl->win, "%s\n\n", data);
-	free(data);
+	if (ctl->cpus && scols_print_table_to_string(ctl->cpus, &data) == 0) {
+		wprintw(ctl->win, "%s\n\n", data);
+		free(data);
+	}
 
 	/* print irqs table */
 	scols_print_table_to_string(table, &data0);
@@ -146,7 +158,6 @@ static int update_screen(struct irqtop_ctl *ctl, struct irq_output *out)
 	free(data0);
 
 	/* clean up */
-	scols_unref_table(table);
 	if (ctl->prev_stat)
 		free_irqstat(ctl->prev_stat);
 	ctl->prev_stat = stat;
@@ -361,6 +372,8 @@ int main(int argc, char **argv)
 	ctl.hostname = xgethostname();
 	event_loop(&ctl, &out);
 
+	scols_unref_table(ctl.table);
+	scols_unref_table(ctl.cpus);
 	free_irqstat(ctl.prev_stat);
 	free(ctl.hostname);
 
@@ -58,6 +58,7 @@ enum {
 static int no_headings;
 static int raw;
 static int json;
+static int verbose;
 
 struct colinfo {
 	const char *name;
@@ -399,7 +400,8 @@ static void __attribute__((__noreturn__)) usage(void)
 
 	fprintf(out,
 	      _(" %1$s [options] [<loopdev>]\n"
-		" %1$s [options] -f | <loopdev> <file>\n"),
+		" %1$s [options] -f | <loopdev> <file>\n"
+		" %1$s [options] -f <file>...\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -422,7 +424,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -b, --sector-size <num>       set the logical sector size to <num>\n"), out);
 	fputs(_(" -P, --partscan                create a partitioned loop device\n"), out);
 	fputs(_(" -r, --read-only               set up a read-only loop device\n"), out);
-	fputs(_("     --direct-io[=<on|off>]    open backing file with O_DIRECT\n"), out);
+	fputs(_("     --direct-io[=<on|off|auto>]\n"
+		"                               open backing file with O_DIRECT\n"), out);
 	fputs(_("     --show                    print device name after setup (with -f)\n"), out);
 	fputs(_(" -v, --verbose                 verbose mode\n"), out);
 
@@ -470,6 +473,42 @@ static void warn_size(const char *filename, uint64_t size, uint64_t offset, int
 			filename);
 }
 
+/*
+ * --direct-io=auto; enables direct I/O if the backing file supports O_DIRECT
+ * and the loop device may be aligned to the device with the file. The
+ * logical block size is set to the alignment, if not specified by user.
+ */
+static int dio_auto_flags(const char *file, int lo_flags, int flags,
+			  uint64_t offset, uint64_t *blocksize)
+{
+	int mode = lo_flags & LO_FLAGS_READ_ONLY ? O_RDONLY : O_RDWR;
+	uint64_t align = 0;
+
+	lo_flags &= ~LO_FLAGS_DIRECT_IO;
+
+	if (loopdev_get_dio_alignment(file, mode, &align) != 0) {
+		if (verbose)
+			warn(_("%s: direct I/O not supported"), file);
+		return lo_flags;
+	}
+	if ((flags & LOOPDEV_FL_OFFSET) && offset % align) {
+		if (verbose)
+			warnx(_("%s: offset %"PRIu64" is not aligned to %"PRIu64
+				" bytes, direct I/O disabled"), file, offset, align);
+		return lo_flags;
+	}
+	if (*blocksize && *blocksize < align) {
+		if (verbose)
+			warnx(_("%s: sector size %"PRIu64" is smaller than %"PRIu64
+				" bytes, direct I/O disabled"), file, *blocksize, align);
+		return lo_flags;
+	}
+	if (!*blocksize && align > 512)
+		*blocksize = align;
+
+	return lo_flags | LO_FLAGS_DIRECT_IO;
+}
+
 static int create_loop(struct loopdev_cxt *lc,
 		       int nooverlap, int lo_flags, int flags,
 		       const char *file, uint64_t offset, uint64_t sizelimit,
@@ -597,8 +636,8 @@ int main(int argc, char **argv)
 	uint64_t offset = 0, sizelimit = 0, blocksize = 0;
 	int res = 0, showdev = 0, lo_flags = 0;
 	char *outarg = NULL;
-	int list = 0;
-	unsigned long use_dio = 0, set_dio = 0, set_blocksize = 0;
+	int list = 0, batch = 0;
+	unsigned long use_dio = 0, set_dio = 0, set_blocksize = 0, auto_dio = 0;
 
 	enum {
 		OPT_SIZELIMIT = CHAR_MAX + 1,
@@ -726,12 +765,15 @@ int main(int argc, char **argv)
 			break;
 		case OPT_DIO:
 			use_dio = set_dio = 1;
-			if (optarg)
+			if (optarg && strcmp(optarg, "auto") == 0)
+				auto_dio = 1;
+			else if (optarg)
 				use_dio = parse_switch(optarg, _("argument error"), "on", "off", NULL);
-			if (use_dio)
+			if (use_dio && !auto_dio)
 				lo_flags |= LO_FLAGS_DIRECT_IO;
 			break;
 		case 'v':
+			verbose = 1;
 			break;
 		case OPT_SIZELIMIT:			/* --sizelimit */
 			sizelimit = strtosize_or_err(optarg, _("failed to parse size"));
@@ -775,13 +817,11 @@ int main(int argc, char **argv)
 
 	if (act == A_FIND_FREE && optind < argc) {
 		/*
-		 * losetup -f <backing_file>
+		 * losetup -f <backing_file> [<backing_file> ...]
 		 */
 		act = A_CREATE;
 		file = argv[optind++];
-
-		if (optind < argc)
-			errx(EXIT_FAILURE, _("unexpected arguments"));
+		batch = 1;
 	}
 
 	if (list && !act && optind == argc)
@@ -827,6 +867,9 @@ int main(int argc, char **argv)
 		file = argv[optind++];
 	}
 
+	if (act != A_CREATE && auto_dio)
+		errx(EXIT_FAILURE, _("--direct-io=auto is allowed during loop device setup only"));
+
 	if (act != A_CREATE &&
 	    (sizelimit || lo_flags || showdev))
 		errx(EXIT_FAILURE,
@@ -843,12 +886,33 @@ int main(int argc, char **argv)
 
 	switch (act) {
 	case A_CREATE:
-		res = create_loop(&lc, no_overlap, lo_flags, flags, file,
-				  offset, sizelimit, blocksize);
-		if (res == 0) {
-			if (showdev)
-				printf("%s\n", loopcxt_get_device(&lc));
-			warn_size(file, sizelimit, offset, flags);
+		/* all the files are attached by the same context, so
+		 * /dev/loop-control is open only once */
+		for (;;) {
+			int fl = lo_flags, rc;
+			uint64_t bsz = blocksize;
+
+			if (auto_dio)
+				fl = dio_auto_flags(file, lo_flags, flags, offset, &bsz);
+
+			rc = create_loop(&lc, no_overlap, fl, flags, file,
+					 offset, sizelimit, bsz);
+			if (rc == 0) {
+				if (showdev)
+					printf("%s\n", loopcxt_get_device(&lc));
+				if (verbose && auto_dio)
+					printf(_("%s: direct I/O %s, logical sector size %"PRIu64"\n"),
+						loopcxt_get_device(&lc),
+						loopcxt_is_dio(&lc) ? _("on") : _("off"),
+						bsz ? bsz : 512);
+				warn_size(file, sizelimit, offset, flags);
+			} else
+				res++;
+
+			if (!batch || optind >= argc)
+				break;
+			file = argv[optind++];
+			ignore_result( loopcxt_set_device(&lc, NULL) );
 		}
 		break;
 	case A_DELETE:
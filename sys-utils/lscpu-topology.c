@@ -94,6 +94,7 @@ static int cputype_read_topology(struct lscpu_cxt *cxt, struct lscpu_cputype *ct
 	size_t i, npos;
 	struct path_cxt *sys;
 	int nthreads = 0, sw_topo = 0;
+	cpu_set_t *incore, *insocket, *inbook, *indrawer;
 	FILE *fd;
 
 	sys = cxt->syscpu;				/* /sys/devices/system/cpu/ */
@@ -102,6 +103,19 @@ static int cputype_read_topology(struct lscpu_cxt *cxt, struct lscpu_cputype *ct
 	DBG(TYPE, ul_debugobj(ct, "reading %s/%s/%s topology",
 				ct->vendor ?: "", ct->model ?: "", ct->modelname ?:""));
 
+	/* CPUs already covered by the maps; all siblings share the same map,
+	 * so the map is read only for the first CPU of the group */
+	incore = cpuset_alloc(cxt->maxcpus, NULL, NULL);
+	insocket = cpuset_alloc(cxt->maxcpus, NULL, NULL);
+	inbook = cpuset_alloc(cxt->maxcpus, NULL, NULL);
+	indrawer = cpuset_alloc(cxt->maxcpus, NULL, NULL);
+	if (!incore || !insocket || !inbook || !indrawer)
+		err(EXIT_FAILURE, _("failed to allocate cpu set"));
+	CPU_ZERO_S(cxt->setsize, incore);
+	CPU_ZERO_S(cxt->setsize, insocket);
+	CPU_ZERO_S(cxt->setsize, inbook);
+	CPU_ZERO_S(cxt->setsize, indrawer);
+
 	for (i = 0; i < cxt->npossibles; i++) {
 		struct lscpu_cpu *cpu = cxt->cpus[i];
 		cpu_set_t *thread_siblings = NULL, *core_siblings = NULL;
@@ -112,25 +126,39 @@ static int cputype_read_topology(struct lscpu_cxt *cxt, struct lscpu_cputype *ct
 			continue;
 
 		num = cpu->logical_id;
+
+		/* all the maps are known */
+		if (CPU_ISSET_S(num, cxt->setsize, incore) &&
+		    CPU_ISSET_S(num, cxt->setsize, insocket) &&
+		    (!ct->bookmaps || CPU_ISSET_S(num, cxt->setsize, inbook)) &&
+		    (!ct->drawermaps || CPU_ISSET_S(num, cxt->setsize, indrawer)))
+			continue;
+
 		if (ul_path_accessf(sys, F_OK,
 					"cpu%d/topology/thread_siblings", num) != 0)
 			continue;
 
 		/* read topology maps */
-		ul_path_readf_cpuset(sys, &thread_siblings, cxt->maxcpus,
+		if (!CPU_ISSET_S(num, cxt->setsize, incore))
+			ul_path_readf_cpuset(sys, &thread_siblings, cxt->maxcpus,
 					"cpu%d/topology/thread_siblings", num);
-		ul_path_readf_cpuset(sys, &core_siblings, cxt->maxcpus,
+		if (!CPU_ISSET_S(num, cxt->setsize, insocket))
+			ul_path_readf_cpuset(sys, &core_siblings, cxt->maxcpus,
 					"cpu%d/topology/core_siblings", num);
-		ul_path_readf_cpuset(sys, &book_siblings, cxt->maxcpus,
+		if (!CPU_ISSET_S(num, cxt->setsize, inbook))
+			ul_path_readf_cpuset(sys, &book_siblings, cxt->maxcpus,
 					"cpu%d/topology/book_siblings", num);
-		ul_path_readf_cpuset(sys, &drawer_siblings, cxt->maxcpus,
+		if (!CPU_ISSET_S(num, cxt->setsize, indrawer))
+			ul_path_readf_cpuset(sys, &drawer_siblings, cxt->maxcpus,
 					"cpu%d/topology/drawer_siblings", num);
 
-		n = CPU_COUNT_S(cxt->setsize, thread_siblings);
-		if (!n)
-			n = 1;
-		if (n > nthreads)
-			nthreads = n;
+		if (thread_siblings) {
+			n = CPU_COUNT_S(cxt->setsize, thread_siblings);
+			if (!n)
+				n = 1;
+			if (n > nthreads)
+				nthreads = n;
+		}
 
 		/* Allocate arrays for topology maps.
 		 *
@@ -150,16 +178,29 @@ static int cputype_read_topology(struct lscpu_cxt *cxt, struct lscpu_cputype *ct
 			ct->drawermaps = xcalloc(npos, sizeof(cpu_set_t *));
 
 		/* add to topology maps */
-		add_cpuset_to_array(ct->coremaps, &ct->ncores, thread_siblings, cxt->setsize);
-		add_cpuset_to_array(ct->socketmaps, &ct->nsockets, core_siblings, cxt->setsize);
-
-		if (book_siblings)
+		if (thread_siblings) {
+			CPU_OR_S(cxt->setsize, incore, incore, thread_siblings);
+			add_cpuset_to_array(ct->coremaps, &ct->ncores, thread_siblings, cxt->setsize);
+		}
+		if (core_siblings) {
+			CPU_OR_S(cxt->setsize, insocket, insocket, core_siblings);
+			add_cpuset_to_array(ct->socketmaps, &ct->nsockets, core_siblings, cxt->setsize);
+		}
+		if (book_siblings) {
+			CPU_OR_S(cxt->setsize, inbook, inbook, book_siblings);
 			add_cpuset_to_array(ct->bookmaps, &ct->nbooks, book_siblings, cxt->setsize);
-		if (drawer_siblings)
+		}
+		if (drawer_siblings) {
+			CPU_OR_S(cxt->setsize, indrawer, indrawer, drawer_siblings);
 			add_cpuset_to_array(ct->drawermaps, &ct->ndrawers, drawer_siblings, cxt->setsize);
-
+		}
 	}
 
+	cpuset_free(incore);
+	cpuset_free(insocket);
+	cpuset_free(inbook);
+	cpuset_free(indrawer);
+
 	/* s390 detects its cpu topology via /proc/sysinfo, if present.
 	 * Using simply the cpu topology masks in sysfs will not give
 	 * usable results since everything is virtualized. E.g.
@@ -306,6 +347,21 @@ static int mk_cache_id(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu, char *type,
 	return idx;
 }
 
+/* returns number of the known caches shared by @cpu */
+static size_t count_cpu_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < cxt->ncaches; i++) {
+		struct lscpu_cache *ca = &cxt->caches[i];
+
+		if (ca->sharedmap &&
+		    CPU_ISSET_S(cpu->logical_id, cxt->setsize, ca->sharedmap))
+			n++;
+	}
+	return n;
+}
+
 static int read_sparc_onecache(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu,
 			   int level, char *typestr, int type)
 {
@@ -386,6 +442,13 @@ static int read_caches(struct lscpu_cxt *cxt, struct lscpu_cpu *cpu)
 				"cpu%d/l1_icache_size", num) == 0)
 		return read_sparc_caches(cxt, cpu);
 
+	/* the caches are shared by more CPUs, nothing to do if the CPU is
+	 * already in the shared maps of all its caches */
+	if (ncaches && count_cpu_caches(cxt, cpu) == ncaches) {
+		DBG(CPU, ul_debugobj(cpu, "#%d caches already known", num));
+		return 0;
+	}
+
 	DBG(CPU, ul_debugobj(cpu, "#%d reading %zd caches", num, ncaches));
 
 	for (i = 0; i < ncaches; i++) {
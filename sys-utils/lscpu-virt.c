@@ -8,6 +8,8 @@
 #include <stdio.h>
 
 #include "lscpu.h"
+#include "fileutils.h"
+#include "closestream.h"
 
 #if (defined(__x86_64__) || defined(__i386__))
 # define INCLUDE_VMWARE_BDOOR
@@ -504,6 +506,96 @@ static int is_vmware_platform(void)
 }
 
 #endif /* INCLUDE_VMWARE_BDOOR */
+
+/*
+ * The hypervisor detection (cpuid, DMI tables, /proc and /sys probes) is
+ * cached for --virt-cache in _PATH_LSCPU_VIRT_CACHE. The cache is valid for
+ * the current boot only, it's written by root and ignored if owned by another
+ * user.
+ */
+static int read_boot_id(struct lscpu_cxt *cxt, char *buf, size_t bufsz)
+{
+	return ul_path_read_buffer(cxt->procfs, buf, bufsz,
+				   "sys/kernel/random/boot_id") > 0 ? 0 : -1;
+}
+
+static int read_virt_cache(struct lscpu_cxt *cxt, struct lscpu_virt *virt)
+{
+	char bootid[64], buf[BUFSIZ];
+	struct stat st;
+	FILE *f;
+	int valid = 0;
+
+	if (read_boot_id(cxt, bootid, sizeof(bootid)) != 0)
+		return -1;
+
+	f = fopen(_PATH_LSCPU_VIRT_CACHE, "r" UL_CLOEXECSTR);
+	if (!f)
+		return -1;
+	if (fstat(fileno(f), &st) != 0 || st.st_uid != 0
+	    || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		fclose(f);
+		return -1;
+	}
+
+	while (fgets(buf, sizeof(buf), f)) {
+		char *val = strchr(buf, '=');
+
+		if (!val)
+			continue;
+		*val++ = '\0';
+		rtrim_whitespace((unsigned char *) val);
+
+		if (strcmp(buf, "BOOT_ID") == 0)
+			valid = strcmp(val, bootid) == 0;
+		else if (strcmp(buf, "VENDOR") == 0)
+			virt->vendor = atoi(val);
+		else if (strcmp(buf, "TYPE") == 0)
+			virt->type = atoi(val);
+		else if (strcmp(buf, "HYPERVISOR") == 0 && *val && !virt->hypervisor)
+			virt->hypervisor = xstrdup(val);
+	}
+	fclose(f);
+
+	if (!valid || virt->vendor < 0 || virt->vendor > VIRT_VENDOR_WSL
+	    || virt->type < 0 || virt->type > VIRT_TYPE_CONTAINER) {
+		free(virt->hypervisor);
+		virt->hypervisor = NULL;
+		virt->vendor = virt->type = 0;
+		return -1;
+	}
+
+	DBG(VIRT, ul_debug("virtualization read from %s", _PATH_LSCPU_VIRT_CACHE));
+	return 0;
+}
+
+static void write_virt_cache(struct lscpu_cxt *cxt, const struct lscpu_virt *virt)
+{
+	char bootid[64], *tmpname = NULL;
+	FILE *f;
+
+	if (geteuid() != 0 || read_boot_id(cxt, bootid, sizeof(bootid)) != 0)
+		return;
+
+	f = xfmkstemp(&tmpname, _PATH_RUNSTATEDIR, "lscpu-virt");
+	if (!f)
+		return;
+
+	fprintf(f, "BOOT_ID=%s\nVENDOR=%d\nTYPE=%d\nHYPERVISOR=%s\n",
+			bootid, virt->vendor, virt->type,
+			virt->hypervisor ? virt->hypervisor : "");
+
+	if (fchmod(fileno(f), 0644) != 0) {
+		fclose(f);
+		unlink(tmpname);
+	} else if (close_stream(f) != 0
+		   || rename(tmpname, _PATH_LSCPU_VIRT_CACHE) != 0)
+		unlink(tmpname);
+	else
+		DBG(VIRT, ul_debug("virtualization cached in %s", _PATH_LSCPU_VIRT_CACHE));
+	free(tmpname);
+}
+
 struct lscpu_virt *lscpu_read_virtualization(struct lscpu_cxt *cxt)
 {
 	char buf[BUFSIZ];
@@ -525,6 +617,12 @@ struct lscpu_virt *lscpu_read_virtualization(struct lscpu_cxt *cxt)
 	}
 
 
+	/* --sysroot snapshots are never cached */
+	if (cxt->noalive)
+		cxt->virtcache = 0;
+	if (cxt->virtcache && read_virt_cache(cxt, virt) == 0)
+		goto cached;
+
 	/* We have to detect WSL first. is_vmware_platform() crashes on Windows 10. */
 	fd = ul_path_fopen(cxt->procfs, "r", "sys/kernel/osrelease");
 	if (fd) {
@@ -661,6 +759,9 @@ struct lscpu_virt *lscpu_read_virtualization(struct lscpu_cxt *cxt)
 		}
 	}
 done:
+	if (cxt->virtcache)
+		write_virt_cache(cxt, virt);
+cached:
 	DBG(VIRT, ul_debugobj(virt, "virt: cpu='%s' hypervisor='%s' vendor=%d type=%d",
 				virt->cpuflag,
 				virt->hypervisor,
@@ -124,6 +124,19 @@ enum {
 	COL_CACHE_COHERENCYSIZE
 };
 
+enum {
+	COL_NODE_NODE,
+	COL_NODE_CPUS,
+	COL_NODE_ONLINE,
+	COL_NODE_CORES,
+	COL_NODE_SOCKETS,
+	COL_NODE_CACHE,
+	COL_NODE_MHZ,
+	COL_NODE_MAXMHZ,
+	COL_NODE_MINMHZ,
+	COL_NODE_CPULIST
+};
+
 
 /* column description
  */
@@ -172,6 +185,20 @@ static struct lscpu_coldesc coldescs_cache[] =
 	[COL_CACHE_COHERENCYSIZE] = { "COHERENCY-SIZE", N_("minimum amount of data in bytes transferred from memory to cache"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER }
 };
 
+static struct lscpu_coldesc coldescs_node[] =
+{
+	[COL_NODE_NODE]        = { "NODE", N_("logical NUMA node number"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_CPUS]        = { "CPUS", N_("number of CPUs in the node"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_ONLINE]      = { "ONLINE", N_("number of online CPUs in the node"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_CORES]       = { "CORES", N_("number of cores with CPUs in the node"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_SOCKETS]     = { "SOCKETS", N_("number of sockets with CPUs in the node"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_CACHE]       = { "CACHE", N_("size of all caches used by CPUs of the node"), SCOLS_FL_RIGHT },
+	[COL_NODE_MHZ]         = { "MHZ", N_("average current MHz of the online CPUs"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_MAXMHZ]      = { "MAXMHZ", N_("highest maximum MHz of the CPUs"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_MINMHZ]      = { "MINMHZ", N_("lowest minimum MHz of the CPUs"), SCOLS_FL_RIGHT, 0, SCOLS_JSON_NUMBER },
+	[COL_NODE_CPULIST]     = { "CPULIST", N_("CPUs in the node") }
+};
+
 static int is_term = 0;
 
 UL_DEBUG_DEFINE_MASK(lscpu);
@@ -212,6 +239,21 @@ cache_column_name_to_id(const char *name, size_t namesz)
 	return -1;
 }
 
+static int
+node_column_name_to_id(const char *name, size_t namesz)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(coldescs_node); i++) {
+		const char *cn = coldescs_node[i].name;
+
+		if (!strncasecmp(name, cn, namesz) && !*(cn + namesz))
+			return i;
+	}
+	warnx(_("unknown column: %s"), name);
+	return -1;
+}
+
 static void lscpu_context_init_paths(struct lscpu_cxt *cxt)
 {
 	DBG(MISC, ul_debugobj(cxt, "initialize paths"));
@@ -223,6 +265,7 @@ static void lscpu_context_init_paths(struct lscpu_cxt *cxt)
 		err(EXIT_FAILURE, _("failed to initialize CPUs sysfs handler"));
 	if (cxt->prefix)
 		ul_path_set_prefix(cxt->syscpu, cxt->prefix);
+	ul_path_enable_cache(cxt->syscpu, 1);
 
 	/* /proc */
 	cxt->procfs = ul_new_path("/proc");
@@ -230,6 +273,7 @@ static void lscpu_context_init_paths(struct lscpu_cxt *cxt)
 		err(EXIT_FAILURE, _("failed to initialize procfs handler"));
 	if (cxt->prefix)
 		ul_path_set_prefix(cxt->procfs, cxt->prefix);
+	ul_path_enable_cache(cxt->procfs, 1);
 }
 
 static struct lscpu_cxt *lscpu_new_context(void)
@@ -586,6 +630,7 @@ static void print_caches_readable(struct lscpu_cxt *cxt, int cols[], size_t ncol
 		 err(EXIT_FAILURE, _("failed to allocate output table"));
 	if (cxt->json) {
 		scols_table_enable_json(tb, 1);
+		scols_table_enable_ndjson(tb, cxt->ndjson);
 		scols_table_set_name(tb, "caches");
 	}
 
@@ -624,6 +669,216 @@ static void print_caches_readable(struct lscpu_cxt *cxt, int cols[], size_t ncol
 	scols_unref_table(tb);
 }
 
+/* per-node rollup of the CPU data */
+struct lscpu_nodeinfo {
+	size_t	ncpus;
+	size_t	nonlines;
+	size_t	ncores;
+	size_t	nsockets;
+	uint64_t cachesize;
+
+	size_t	nmhz;		/* number of CPUs in sum_mhz */
+	float	sum_mhz;
+	float	max_mhz;
+	float	min_mhz;
+};
+
+/* returns number of @nmaps maps with any CPU from @node */
+static size_t count_maps_in_node(struct lscpu_cxt *cxt, cpu_set_t *node,
+				 cpu_set_t **maps, size_t nmaps, cpu_set_t *tmp)
+{
+	size_t i, n = 0;
+
+	for (i = 0; i < nmaps; i++) {
+		CPU_AND_S(cxt->setsize, tmp, node, maps[i]);
+		if (CPU_COUNT_S(cxt->setsize, tmp))
+			n++;
+	}
+	return n;
+}
+
+/*
+ * Computes the rollups for all NUMA nodes from the already read CPUs,
+ * topology maps and caches. The CPUs are visited only once.
+ */
+static struct lscpu_nodeinfo *summarize_nodes(struct lscpu_cxt *cxt)
+{
+	struct lscpu_nodeinfo *nodes;
+	cpu_set_t *tmp;
+	size_t i, n;
+
+	nodes = xcalloc(cxt->nnodes, sizeof(*nodes));
+
+	for (i = 0; i < cxt->npossibles; i++) {
+		struct lscpu_cpu *cpu = cxt->cpus[i];
+		struct lscpu_nodeinfo *nd;
+
+		if (!cpu || !cpu->type)
+			continue;
+		if (cpuset_ary_isset(cpu->logical_id, cxt->nodemaps,
+				     cxt->nnodes, cxt->setsize, &n) != 0)
+			continue;
+
+		nd = &nodes[n];
+		nd->ncpus++;
+
+		if (cpu->mhz_max_freq && cpu->mhz_max_freq > nd->max_mhz)
+			nd->max_mhz = cpu->mhz_max_freq;
+		if (cpu->mhz_min_freq &&
+		    (!nd->min_mhz || cpu->mhz_min_freq < nd->min_mhz))
+			nd->min_mhz = cpu->mhz_min_freq;
+
+		if (!is_cpu_online(cxt, cpu))
+			continue;
+		nd->nonlines++;
+		if (cpu->mhz_cur_freq) {
+			nd->sum_mhz += cpu->mhz_cur_freq;
+			nd->nmhz++;
+		}
+	}
+
+	tmp = cpuset_alloc(cxt->maxcpus, NULL, NULL);
+	if (!tmp)
+		err(EXIT_FAILURE, _("failed to allocate cpu set"));
+
+	for (n = 0; n < cxt->nnodes; n++) {
+		struct lscpu_nodeinfo *nd = &nodes[n];
+		cpu_set_t *node = cxt->nodemaps[n];
+
+		for (i = 0; i < cxt->ncputypes; i++) {
+			struct lscpu_cputype *ct = cxt->cputypes[i];
+
+			nd->ncores += count_maps_in_node(cxt, node,
+					ct->coremaps, ct->ncores, tmp);
+			nd->nsockets += count_maps_in_node(cxt, node,
+					ct->socketmaps, ct->nsockets, tmp);
+		}
+		for (i = 0; i < cxt->ncaches; i++) {
+			struct lscpu_cache *ca = &cxt->caches[i];
+
+			if (!ca->sharedmap)
+				continue;
+			CPU_AND_S(cxt->setsize, tmp, node, ca->sharedmap);
+			if (CPU_COUNT_S(cxt->setsize, tmp))
+				nd->cachesize += ca->size;
+		}
+	}
+
+	cpuset_free(tmp);
+	return nodes;
+}
+
+static void nodes_add_line(struct lscpu_cxt *cxt,
+			   struct libscols_table *tb,
+			   size_t idx, struct lscpu_nodeinfo *nd,
+			   int cols[], size_t ncols)
+{
+	struct libscols_line *ln;
+	size_t c;
+
+	ln = scols_table_new_line(tb, NULL);
+	if (!ln)
+		err(EXIT_FAILURE, _("failed to allocate output line"));
+
+	for (c = 0; c < ncols; c++) {
+		char *data = NULL;
+		int col = cols[c];
+
+		switch (col) {
+		case COL_NODE_NODE:
+			xasprintf(&data, "%d", cxt->idx2nodenum[idx]);
+			break;
+		case COL_NODE_CPUS:
+			xasprintf(&data, "%zu", nd->ncpus);
+			break;
+		case COL_NODE_ONLINE:
+			xasprintf(&data, "%zu", nd->nonlines);
+			break;
+		case COL_NODE_CORES:
+			xasprintf(&data, "%zu", nd->ncores);
+			break;
+		case COL_NODE_SOCKETS:
+			xasprintf(&data, "%zu", nd->nsockets);
+			break;
+		case COL_NODE_CACHE:
+			if (!nd->cachesize)
+				break;
+			if (cxt->bytes)
+				xasprintf(&data, "%" PRIu64, nd->cachesize);
+			else
+				data = size_to_human_string(SIZE_SUFFIX_1LETTER, nd->cachesize);
+			break;
+		case COL_NODE_MHZ:
+			if (nd->nmhz)
+				xasprintf(&data, "%.4f", nd->sum_mhz / nd->nmhz);
+			break;
+		case COL_NODE_MAXMHZ:
+			if (nd->max_mhz)
+				xasprintf(&data, "%.4f", nd->max_mhz);
+			break;
+		case COL_NODE_MINMHZ:
+			if (nd->min_mhz)
+				xasprintf(&data, "%.4f", nd->min_mhz);
+			break;
+		case COL_NODE_CPULIST:
+		{
+			size_t setbuflen = 7 * cxt->maxcpus;
+			char setbuf[setbuflen], *p;
+
+			p = cxt->hex ?
+				cpumask_create(setbuf, setbuflen, cxt->nodemaps[idx], cxt->setsize) :
+				cpulist_create(setbuf, setbuflen, cxt->nodemaps[idx], cxt->setsize);
+			if (p)
+				data = xstrdup(p);
+			break;
+		}
+		}
+
+		if (data && scols_line_refer_data(ln, c, data))
+			err(EXIT_FAILURE, _("failed to add output data"));
+	}
+}
+
+/*
+ * [-N] backend
+ */
+static void print_nodes_readable(struct lscpu_cxt *cxt, int cols[], size_t ncols)
+{
+	size_t i;
+	struct libscols_table *tb;
+	struct lscpu_nodeinfo *nodes;
+
+	scols_init_debug(0);
+
+	tb = scols_new_table();
+	if (!tb)
+		 err(EXIT_FAILURE, _("failed to allocate output table"));
+	if (cxt->json) {
+		scols_table_enable_json(tb, 1);
+		scols_table_enable_ndjson(tb, cxt->ndjson);
+		scols_table_set_name(tb, "nodes");
+	}
+
+	for (i = 0; i < ncols; i++) {
+		struct lscpu_coldesc *cd = &coldescs_node[cols[i]];
+		struct libscols_column *cl;
+
+		cl = scols_table_new_column(tb, cd->name, 0, cd->flags);
+		if (cl == NULL)
+			err(EXIT_FAILURE, _("failed to allocate output column"));
+		if (cxt->json)
+			scols_column_set_json_type(cl, cd->json_type);
+	}
+
+	nodes = summarize_nodes(cxt);
+	for (i = 0; i < cxt->nnodes; i++)
+		nodes_add_line(cxt, tb, i, &nodes[i], cols, ncols);
+	free(nodes);
+
+	scols_print_table(tb);
+	scols_unref_table(tb);
+}
+
 /*
  * [-p] backend, we support two parsable formats:
  *
@@ -741,6 +996,7 @@ static void print_cpus_readable(struct lscpu_cxt *cxt, int cols[], size_t ncols)
 		 err(EXIT_FAILURE, _("failed to allocate output table"));
 	if (cxt->json) {
 		scols_table_enable_json(tb, 1);
+		scols_table_enable_ndjson(tb, cxt->ndjson);
 		scols_table_set_name(tb, "cpus");
 	}
 
@@ -955,6 +1211,7 @@ static void print_summary(struct lscpu_cxt *cxt)
 	scols_table_enable_noheadings(tb, 1);
 	if (cxt->json) {
 		scols_table_enable_json(tb, 1);
+		scols_table_enable_ndjson(tb, cxt->ndjson);
 		scols_table_set_name(tb, "lscpu");
 	} else if (is_term) {
 		struct libscols_symbols *sy = scols_new_symbols();
@@ -1169,13 +1426,16 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -B, --bytes             print sizes in bytes rather than in human readable format\n"), out);
 	fputs(_(" -C, --caches[=<list>]   info about caches in extended readable format\n"), out);
 	fputs(_(" -c, --offline           print offline CPUs only\n"), out);
+	fputs(_(" -N, --nodes[=<list>]    info about NUMA nodes in extended readable format\n"), out);
 	fputs(_(" -J, --json              use JSON for default or extended format\n"), out);
+	fputs(_("     --ndjson            use newline-delimited JSON for default or extended format\n"), out);
 	fputs(_(" -e, --extended[=<list>] print out an extended readable format\n"), out);
 	fputs(_(" -p, --parse[=<list>]    print out a parsable format\n"), out);
 	fputs(_(" -s, --sysroot <dir>     use specified directory as system root\n"), out);
 	fputs(_(" -x, --hex               print hexadecimal masks rather than lists of CPUs\n"), out);
 	fputs(_(" -y, --physical          print physical instead of logical IDs\n"), out);
-	fputs(_("     --output-all        print all available columns for -e, -p or -C\n"), out);
+	fputs(_("     --output-all        print all available columns for -e, -p, -C or -N\n"), out);
+	fputs(_("     --virt-cache        use cached virtualization detection for this boot\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(25));
 
@@ -1187,6 +1447,10 @@ static void __attribute__((__noreturn__)) usage(void)
 	for (i = 0; i < ARRAY_SIZE(coldescs_cache); i++)
 		fprintf(out, " %13s  %s\n", coldescs_cache[i].name, _(coldescs_cache[i].help));
 
+	fputs(_("\nAvailable output columns for -N:\n"), out);
+	for (i = 0; i < ARRAY_SIZE(coldescs_node); i++)
+		fprintf(out, " %13s  %s\n", coldescs_node[i].name, _(coldescs_node[i].help));
+
 	printf(USAGE_MAN_TAIL("lscpu(1)"));
 
 	exit(EXIT_SUCCESS);
@@ -1202,6 +1466,8 @@ int main(int argc, char *argv[])
 	size_t i, ncolumns = 0;
 	enum {
 		OPT_OUTPUT_ALL = CHAR_MAX + 1,
+		OPT_NDJSON,
+		OPT_VIRT_CACHE
 	};
 	static const struct option longopts[] = {
 		{ "all",        no_argument,       NULL, 'a' },
@@ -1212,17 +1478,20 @@ int main(int argc, char *argv[])
 		{ "help",	no_argument,       NULL, 'h' },
 		{ "extended",	optional_argument, NULL, 'e' },
 		{ "json",       no_argument,       NULL, 'J' },
+		{ "ndjson",     no_argument,       NULL, OPT_NDJSON },
+		{ "nodes",      optional_argument, NULL, 'N' },
 		{ "parse",	optional_argument, NULL, 'p' },
 		{ "sysroot",	required_argument, NULL, 's' },
 		{ "physical",	no_argument,	   NULL, 'y' },
 		{ "hex",	no_argument,	   NULL, 'x' },
 		{ "version",	no_argument,	   NULL, 'V' },
 		{ "output-all",	no_argument,	   NULL, OPT_OUTPUT_ALL },
+		{ "virt-cache", no_argument,       NULL, OPT_VIRT_CACHE },
 		{ NULL,		0, NULL, 0 }
 	};
 
 	static const ul_excl_t excl[] = {	/* rows and cols in ASCII order */
-		{ 'C','e','p' },
+		{ 'C','N','e','p' },
 		{ 'a','b','c' },
 		{ 0 }
 	};
@@ -1235,7 +1504,7 @@ int main(int argc, char *argv[])
 
 	cxt = lscpu_new_context();
 
-	while ((c = getopt_long(argc, argv, "aBbC::ce::hJp::s:xyV", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "aBbC::ce::hJN::p::s:xyV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -1263,6 +1532,14 @@ int main(int argc, char *argv[])
 			}
 			cxt->mode = LSCPU_OUTPUT_CACHES;
 			break;
+		case 'N':
+			if (optarg) {
+				if (*optarg == '=')
+					optarg++;
+				outarg = optarg;
+			}
+			cxt->mode = LSCPU_OUTPUT_NODES;
+			break;
 		case 'J':
 			cxt->json = 1;
 			break;
@@ -1288,6 +1565,12 @@ int main(int argc, char *argv[])
 		case OPT_OUTPUT_ALL:
 			all = 1;
 			break;
+		case OPT_NDJSON:
+			cxt->json = cxt->ndjson = 1;
+			break;
+		case OPT_VIRT_CACHE:
+			cxt->virtcache = 1;
+			break;
 
 		case 'h':
 			usage();
@@ -1301,6 +1584,8 @@ int main(int argc, char *argv[])
 	if (all && ncolumns == 0) {
 		size_t maxsz = cxt->mode == LSCPU_OUTPUT_CACHES ?
 				ARRAY_SIZE(coldescs_cache) :
+			       cxt->mode == LSCPU_OUTPUT_NODES ?
+				ARRAY_SIZE(coldescs_node) :
 				ARRAY_SIZE(coldescs_cpu);
 
 		for (i = 0; i < maxsz; i++)
@@ -1368,6 +1653,32 @@ int main(int argc, char *argv[])
 
 		print_caches_readable(cxt, columns, ncolumns);
 		break;
+	case LSCPU_OUTPUT_NODES:
+		if (!ncolumns) {
+			struct lscpu_cputype *ct = lscpu_cputype_get_default(cxt);
+
+			columns[ncolumns++] = COL_NODE_NODE;
+			columns[ncolumns++] = COL_NODE_CPUS;
+			if (cxt->online)
+				columns[ncolumns++] = COL_NODE_ONLINE;
+			columns[ncolumns++] = COL_NODE_CORES;
+			columns[ncolumns++] = COL_NODE_SOCKETS;
+			if (cxt->ncaches)
+				columns[ncolumns++] = COL_NODE_CACHE;
+			if (ct && ct->has_freq) {
+				columns[ncolumns++] = COL_NODE_MAXMHZ;
+				columns[ncolumns++] = COL_NODE_MINMHZ;
+				columns[ncolumns++] = COL_NODE_MHZ;
+			}
+			columns[ncolumns++] = COL_NODE_CPULIST;
+		}
+		if (outarg && string_add_to_idarray(outarg, columns,
+					ARRAY_SIZE(columns),
+					&ncolumns, node_column_name_to_id) < 0)
+			return EXIT_FAILURE;
+
+		print_nodes_readable(cxt, columns, ncolumns);
+		break;
 	case LSCPU_OUTPUT_READABLE:
 		if (!ncolumns) {
 			/* No list was given. Just print whatever is there. */
@@ -196,7 +196,8 @@ enum {
 	LSCPU_OUTPUT_SUMMARY = 0,	/* default */
 	LSCPU_OUTPUT_CACHES,
 	LSCPU_OUTPUT_PARSABLE,
-	LSCPU_OUTPUT_READABLE
+	LSCPU_OUTPUT_READABLE,
+	LSCPU_OUTPUT_NODES
 };
 
 struct lscpu_cxt {
@@ -244,6 +245,8 @@ struct lscpu_cxt {
 		     show_compatible : 1,
 		     hex : 1,
 		     json : 1,
+		     ndjson : 1,
+		     virtcache : 1,
 		     bytes : 1;
 
 	int is_cluster; /* For aarch64 if the machine doesn't have ACPI PPTT */
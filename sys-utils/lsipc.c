@@ -40,6 +40,7 @@
 #include "procutils.h"
 #include "ipcutils.h"
 #include "timeutils.h"
+#include "idcache.h"
 
 /*
  * time modes
@@ -198,6 +199,10 @@ static const struct lsipc_coldesc coldescs[] =
 static int columns[ARRAY_SIZE(coldescs) * 2];
 static size_t ncolumns;
 
+/* owner names */
+static struct idcache *uid_cache;
+static struct idcache *gid_cache;
+
 static inline size_t err_columns_index(size_t arysz, size_t idx)
 {
 	if (idx >= arysz)
@@ -246,20 +251,24 @@ static const struct lsipc_coldesc *get_column_desc(int num)
 	return &coldescs[ get_column_id(num) ];
 }
 
-static char *get_username(struct passwd **pw, uid_t id)
+static char *get_username(uid_t id)
 {
-	if (!*pw || (*pw)->pw_uid != id)
-		*pw = getpwuid(id);
+	struct identry *ent;
+
+	add_uid(uid_cache, id);
+	ent = get_id(uid_cache, id);
 
-	return *pw ? xstrdup((*pw)->pw_name) : NULL;
+	return ent && !ent->unknown ? xstrdup(ent->name) : NULL;
 }
 
-static char *get_groupname(struct group **gr, gid_t id)
+static char *get_groupname(gid_t id)
 {
-	if (!*gr || (*gr)->gr_gid != id)
-		*gr = getgrgid(id);
+	struct identry *ent;
+
+	add_gid(gid_cache, id);
+	ent = get_id(gid_cache, id);
 
-	return *gr ? xstrdup((*gr)->gr_name) : NULL;
+	return ent && !ent->unknown ? xstrdup(ent->name) : NULL;
 }
 
 static int parse_time_mode(const char *s)
@@ -542,8 +551,6 @@ static void setup_sem_elements_columns(struct libscols_table *tb)
 static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL, *cpw = NULL;
-	struct group *gr = NULL, *cgr = NULL;
 	struct sem_data *semds, *semdsp;
 	char *arg = NULL;
 
@@ -573,7 +580,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, semdsp->sem_perm.uid);
+				arg = get_username(semdsp->sem_perm.uid);
 				if (!arg)
 					xasprintf(&arg, "%u", semdsp->sem_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
@@ -592,7 +599,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&cpw, semdsp->sem_perm.cuid);
+				arg = get_username(semdsp->sem_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -601,7 +608,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&cgr, semdsp->sem_perm.cgid);
+				arg = get_groupname(semdsp->sem_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -610,7 +617,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, semdsp->sem_perm.uid);
+				arg = get_username(semdsp->sem_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -619,7 +626,7 @@ static void do_sem(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr, semdsp->sem_perm.gid);
+				arg = get_groupname(semdsp->sem_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -736,8 +743,6 @@ static void do_sem_global(struct lsipc_control *ctl, struct libscols_table *tb)
 static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL;
-	struct group *gr = NULL;
 	struct msg_data *msgds, *msgdsp;
 	char *arg = NULL;
 
@@ -755,14 +760,6 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 		if (!ln)
 			err(EXIT_FAILURE, _("failed to allocate output line"));
 
-		/* no need to call getpwuid() for the same user */
-		if (!(pw && pw->pw_uid == msgdsp->msg_perm.uid))
-			pw = getpwuid(msgdsp->msg_perm.uid);
-
-		/* no need to call getgrgid() for the same user */
-		if (!(gr && gr->gr_gid == msgdsp->msg_perm.gid))
-			gr = getgrgid(msgdsp->msg_perm.gid);
-
 		for (n = 0; n < ncolumns; n++) {
 			int rc = 0;
 
@@ -776,7 +773,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, msgdsp->msg_perm.uid);
+				arg = get_username(msgdsp->msg_perm.uid);
 				if (!arg)
 					xasprintf(&arg, "%u", msgdsp->msg_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
@@ -795,7 +792,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&pw, msgdsp->msg_perm.cuid);
+				arg = get_username(msgdsp->msg_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -804,7 +801,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&gr, msgdsp->msg_perm.cgid);
+				arg = get_groupname(msgdsp->msg_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -813,7 +810,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, msgdsp->msg_perm.uid);
+				arg = get_username(msgdsp->msg_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -822,7 +819,7 @@ static void do_msg(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr,msgdsp->msg_perm.gid);
+				arg = get_groupname(msgdsp->msg_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -899,8 +896,6 @@ static void do_msg_global(struct lsipc_control *ctl, struct libscols_table *tb)
 static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 {
 	struct libscols_line *ln;
-	struct passwd *pw = NULL;
-	struct group *gr = NULL;
 	struct shm_data *shmds, *shmdsp;
 	char *arg = NULL;
 
@@ -932,7 +927,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_OWNER:
-				arg = get_username(&pw, shmdsp->shm_perm.uid);
+				arg = get_username(shmdsp->shm_perm.uid);
 				if (!arg)
 					xasprintf(&arg, "%u", shmdsp->shm_perm.uid);
 				rc = scols_line_refer_data(ln, n, arg);
@@ -951,7 +946,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CUSER:
-				arg = get_username(&pw, shmdsp->shm_perm.cuid);
+				arg = get_username(shmdsp->shm_perm.cuid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -960,7 +955,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_CGROUP:
-				arg = get_groupname(&gr, shmdsp->shm_perm.cgid);
+				arg = get_groupname(shmdsp->shm_perm.cgid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -969,7 +964,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_USER:
-				arg = get_username(&pw, shmdsp->shm_perm.uid);
+				arg = get_username(shmdsp->shm_perm.uid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -978,7 +973,7 @@ static void do_shm(int id, struct lsipc_control *ctl, struct libscols_table *tb)
 				rc = scols_line_refer_data(ln, n, arg);
 				break;
 			case COL_GROUP:
-				arg = get_groupname(&gr, shmdsp->shm_perm.gid);
+				arg = get_groupname(shmdsp->shm_perm.gid);
 				if (arg)
 					rc = scols_line_refer_data(ln, n, arg);
 				break;
@@ -1153,6 +1148,13 @@ int main(int argc, char *argv[])
 
 	scols_init_debug(0);
 
+	uid_cache = new_idcache();
+	if (!uid_cache)
+		err(EXIT_FAILURE, _("failed to allocate UID cache"));
+	gid_cache = new_idcache();
+	if (!gid_cache)
+		err(EXIT_FAILURE, _("failed to allocate GID cache"));
+
 	while ((opt = getopt_long(argc, argv, "bceghi:Jlmno:PqrstV", longopts, NULL)) != -1) {
 
 		err_exclusive_options(opt, longopts, excl, excl_st);
@@ -1341,6 +1343,8 @@ int main(int argc, char *argv[])
 	print_table(ctl, tb);
 
 	scols_unref_table(tb);
+	free_idcache(uid_cache);
+	free_idcache(gid_cache);
 	free(ctl);
 
 	return EXIT_SUCCESS;
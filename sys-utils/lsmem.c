@@ -69,6 +69,9 @@ struct lsmem {
 	int			ndirs;
 	struct memory_block	*blocks;
 	int			nblocks;
+	int			blocks_sz;		/* allocated blocks */
+	int			*nodes;			/* node of each block index */
+	uint64_t		nnodes;
 	uint64_t		block_size;
 	uint64_t		mem_online;
 	uint64_t		mem_offline;
@@ -358,11 +361,66 @@ static int memory_block_get_node(struct lsmem *lsmem, char *name)
 	return node;
 }
 
+/*
+ * Reads the memory<num> links in the node<num> directories, which is much
+ * less work than to search for the node<num> link in the directory of each
+ * memory block. Returns 0 if the map is not available.
+ */
+static int read_node_map(struct lsmem *lsmem)
+{
+	struct dirent *de, *me;
+	DIR *dir, *ndir;
+	uint64_t last;
+	char path[PATH_MAX];
+	uint64_t i;
+
+	dir = ul_path_opendir(lsmem->sysmem, "../node");
+	if (!dir)
+		return 0;
+
+	/* the blocks are sorted by index */
+	last = strtoumax(lsmem->dirs[lsmem->ndirs - 1]->d_name + 6, NULL, 10);
+	lsmem->nnodes = last + 1;
+	lsmem->nodes = xmalloc(lsmem->nnodes * sizeof(int));
+	for (i = 0; i < lsmem->nnodes; i++)
+		lsmem->nodes[i] = -1;
+
+	while ((de = readdir(dir)) != NULL) {
+		int node;
+
+		if (strncmp("node", de->d_name, 4) != 0
+		    || !isdigit_string(de->d_name + 4))
+			continue;
+		node = strtol(de->d_name + 4, NULL, 10);
+
+		snprintf(path, sizeof(path), "../node/%s", de->d_name);
+		ndir = ul_path_opendir(lsmem->sysmem, path);
+		if (!ndir)
+			continue;
+		while ((me = readdir(ndir)) != NULL) {
+			if (strncmp("memory", me->d_name, 6) != 0
+			    || !isdigit_string(me->d_name + 6))
+				continue;
+			i = strtoumax(me->d_name + 6, NULL, 10);
+			if (i < lsmem->nnodes)
+				lsmem->nodes[i] = node;
+		}
+		closedir(ndir);
+	}
+	closedir(dir);
+	return 1;
+}
+
 static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 				    struct memory_block *blk)
 {
-	char *line = NULL;
-	int i, x = 0, rc = 0;
+	struct ul_path_attr attrs[] = {
+		{ .name = "removable",   .type = UL_PATH_ATTR_S32 },
+		{ .name = "state",       .type = UL_PATH_ATTR_STRING },
+		{ .name = "valid_zones", .type = UL_PATH_ATTR_STRING }
+	};
+	char *line;
+	int i, rc = 0;
 
 	memset(blk, 0, sizeof(*blk));
 
@@ -374,10 +432,15 @@ static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 	if (errno)
 		rc = -errno;
 
-	if (ul_path_readf_s32(lsmem->sysmem, &x, "%s/removable", name) == 0)
-		blk->removable = x == 1;
+	/* all attributes by one call, valid_zones only if needed */
+	ul_path_read_attrs(lsmem->sysmem, name, attrs,
+			   lsmem->have_zones ? ARRAY_SIZE(attrs) : ARRAY_SIZE(attrs) - 1);
 
-	if (ul_path_readf_string(lsmem->sysmem, &line, "%s/state", name) > 0 && line) {
+	if (attrs[0].rc == 0)
+		blk->removable = attrs[0].data.s32 == 1;
+
+	line = attrs[1].rc == 0 ? attrs[1].data.str : NULL;
+	if (line) {
 		if (strcmp(line, "offline") == 0)
 			blk->state = MEMORY_STATE_OFFLINE;
 		else if (strcmp(line, "online") == 0)
@@ -387,14 +450,17 @@ static int memory_block_read_attrs(struct lsmem *lsmem, char *name,
 		free(line);
 	}
 
-	if (lsmem->have_nodes)
-		blk->node = memory_block_get_node(lsmem, name);
+	if (lsmem->have_nodes) {
+		if (lsmem->nodes)
+			blk->node = blk->index < lsmem->nnodes ?
+					lsmem->nodes[blk->index] : -1;
+		else
+			blk->node = memory_block_get_node(lsmem, name);
+	}
 
 	blk->nr_zones = 0;
-	if (lsmem->have_zones
-	    && ul_path_readf_string(lsmem->sysmem, &line, "%s/valid_zones", name) > 0
-	    && line) {
-
+	line = lsmem->have_zones && attrs[2].rc == 0 ? attrs[2].data.str : NULL;
+	if (line) {
 		char *token = strtok(line, " ");
 
 		for (i = 0; token && i < MAX_NR_ZONES; i++) {
@@ -447,6 +513,7 @@ static void free_info(struct lsmem *lsmem)
 	if (!lsmem)
 		return;
 	free(lsmem->blocks);
+	free(lsmem->nodes);
 	for (i = 0; i < lsmem->ndirs; i++)
 		free(lsmem->dirs[i]);
 	free(lsmem->dirs);
@@ -476,9 +543,12 @@ static void read_info(struct lsmem *lsmem)
 			lsmem->blocks[lsmem->nblocks - 1].count++;
 			continue;
 		}
-		lsmem->nblocks++;
-		lsmem->blocks = xrealloc(lsmem->blocks, lsmem->nblocks * sizeof(blk));
-		*&lsmem->blocks[lsmem->nblocks - 1] = blk;
+		if (lsmem->nblocks == lsmem->blocks_sz) {
+			lsmem->blocks_sz = lsmem->blocks_sz ? lsmem->blocks_sz * 2 : 64;
+			lsmem->blocks = xrealloc(lsmem->blocks,
+					lsmem->blocks_sz * sizeof(blk));
+		}
+		lsmem->blocks[lsmem->nblocks++] = blk;
 	}
 }
 
@@ -502,8 +572,10 @@ static void read_basic_info(struct lsmem *lsmem)
 	if (lsmem->ndirs <= 0)
 		err(EXIT_FAILURE, _("Failed to read %s"), dir);
 
-	if (memory_block_get_node(lsmem, lsmem->dirs[0]->d_name) != -1)
+	if (memory_block_get_node(lsmem, lsmem->dirs[0]->d_name) != -1) {
 		lsmem->have_nodes = 1;
+		read_node_map(lsmem);
+	}
 
 	/* The valid_zones sysmem attribute was introduced with kernel 3.18 */
 	if (ul_path_access(lsmem->sysmem, F_OK, "memory0/valid_zones") == 0)
@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <wchar.h>
+#include <search.h>
 #include <libsmartcols.h>
 #include <libmount.h>
 
@@ -212,15 +213,24 @@ struct lsns {
 
 
 	struct libmnt_table *tab;
+
+	void	*ns_tree;	/* namespaces by inode, for get_namespace() */
+	void	*ns_rela_tree;	/* parent and owner inodes, for get_ns_ino() */
 };
 
 struct netnsid_cache {
 	ino_t ino;
 	int   id;
-	struct list_head netnsids;
 };
 
-static struct list_head netnsids_cache;
+/* tsearch() tree, one entry per network namespace */
+static void *netnsids_cache;
+
+struct ns_rela_cache {
+	ino_t ino;
+	ino_t pino;
+	ino_t oino;
+};
 
 static int netlink_fd = -1;
 
@@ -281,10 +291,20 @@ static inline const struct colinfo *get_column_info(unsigned num)
 	return &infos[ get_column_id(num) ];
 }
 
-static int get_ns_ino(int dir, const char *nsname, ino_t *ino, ino_t *pino, ino_t *oino)
+/* all caches are keyed by ino_t as the first struct member */
+static int cmp_ino(const void *a, const void *b)
+{
+	ino_t x = *(const ino_t *) a, y = *(const ino_t *) b;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int get_ns_ino(struct lsns *ls, int dir, const char *nsname,
+		      ino_t *ino, ino_t *pino, ino_t *oino)
 {
 	struct stat st;
 	char path[16];
+	struct ns_rela_cache *rela, **node;
 
 	snprintf(path, sizeof(path), "ns/%s", nsname);
 
@@ -295,6 +315,15 @@ static int get_ns_ino(int dir, const char *nsname, ino_t *ino, ino_t *pino, ino_
 	*pino = 0;
 	*oino = 0;
 
+	/* the parent and owner are the same for all processes in the
+	 * namespace, ask nsfs only for the first one */
+	node = tfind(ino, &ls->ns_rela_tree, cmp_ino);
+	if (node) {
+		*pino = (*node)->pino;
+		*oino = (*node)->oino;
+		return 0;
+	}
+
 #ifdef HAVE_LINUX_NSFS_H
 	int fd, pfd, ofd;
 	fd = openat(dir, path, 0);
@@ -332,6 +361,12 @@ static int get_ns_ino(int dir, const char *nsname, ino_t *ino, ino_t *pino, ino_
  out:
 	close(fd);
 #endif
+	rela = xmalloc(sizeof(*rela));
+	rela->ino = *ino;
+	rela->pino = *pino;
+	rela->oino = *oino;
+	if (!tsearch(rela, &ls->ns_rela_tree, cmp_ino))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
 	return 0;
 }
 
@@ -363,16 +398,12 @@ error:
 #ifdef HAVE_LINUX_NET_NAMESPACE_H
 static int netnsid_cache_find(ino_t netino, int *netnsid)
 {
-	struct list_head *p;
+	struct netnsid_cache **e;
 
-	list_for_each(p, &netnsids_cache) {
-		struct netnsid_cache *e = list_entry(p,
-						     struct netnsid_cache,
-						     netnsids);
-		if (e->ino == netino) {
-			*netnsid = e->id;
-			return 1;
-		}
+	e = tfind(&netino, &netnsids_cache, cmp_ino);
+	if (e) {
+		*netnsid = (*e)->id;
+		return 1;
 	}
 
 	return 0;
@@ -385,8 +416,8 @@ static void netnsid_cache_add(ino_t netino, int netnsid)
 	e = xcalloc(1, sizeof(*e));
 	e->ino = netino;
 	e->id  = netnsid;
-	INIT_LIST_HEAD(&e->netnsids);
-	list_add(&e->netnsids, &netnsids_cache);
+	if (!tsearch(e, &netnsids_cache, cmp_ino))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
 }
 
 static int get_netnsid_via_netlink_send_request(int target_fd)
@@ -537,7 +568,7 @@ static int read_process(struct lsns *ls, pid_t pid)
 		if (!ls->fltr_types[i])
 			continue;
 
-		rc = get_ns_ino(dirfd(dir), ns_names[i], &p->ns_ids[i],
+		rc = get_ns_ino(ls, dirfd(dir), ns_names[i], &p->ns_ids[i],
 				&p->ns_pids[i], &p->ns_oids[i]);
 		if (rc && rc != -EACCES && rc != -ENOENT)
 			goto done;
@@ -586,15 +617,10 @@ done:
 
 static struct lsns_namespace *get_namespace(struct lsns *ls, ino_t ino)
 {
-	struct list_head *p;
+	struct lsns_namespace **ns;
 
-	list_for_each(p, &ls->namespaces) {
-		struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
-
-		if (ns->id == ino)
-			return ns;
-	}
-	return NULL;
+	ns = tfind(&ino, &ls->ns_tree, cmp_ino);
+	return ns ? *ns : NULL;
 }
 
 static int namespace_has_process(struct lsns_namespace *ns, pid_t pid)
@@ -629,25 +655,53 @@ static struct lsns_namespace *add_namespace(struct lsns *ls, int type, ino_t ino
 	ns->related_id[RELA_OWNER] = owner_ino;
 
 	list_add_tail(&ns->namespaces, &ls->namespaces);
+	if (!tsearch(ns, &ls->ns_tree, cmp_ino))
+		err(EXIT_FAILURE, _("failed to allocate memory"));
 	return ns;
 }
 
-static int add_process_to_namespace(struct lsns *ls, struct lsns_namespace *ns, struct lsns_process *proc)
+static int cmp_pid(const void *a, const void *b)
+{
+	pid_t x = ((const struct lsns_process *) a)->pid,
+	      y = ((const struct lsns_process *) b)->pid;
+
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static void free_nothing(void *p __attribute__((__unused__)))
+{
+}
+
+/* set proc->parent for all processes, by one lookup for each process */
+static void link_processes(struct lsns *ls)
 {
 	struct list_head *p;
+	void *pids = NULL;
 
-	DBG(NS, ul_debugobj(ns, "add process [%p] pid=%d to %s[%ju]",
-		proc, proc->pid, ns_names[ns->type], (uintmax_t)ns->id));
+	list_for_each(p, &ls->processes) {
+		struct lsns_process *proc = list_entry(p, struct lsns_process, processes);
+
+		if (!tsearch(proc, &pids, cmp_pid))
+			err(EXIT_FAILURE, _("failed to allocate memory"));
+	}
 
 	list_for_each(p, &ls->processes) {
-		struct lsns_process *xproc = list_entry(p, struct lsns_process, processes);
+		struct lsns_process *proc = list_entry(p, struct lsns_process, processes);
+		struct lsns_process key = { .pid = proc->ppid }, **parent;
 
-		if (xproc->pid == proc->ppid)		/* my parent */
-			proc->parent = xproc;
-		else if (xproc->ppid == proc->pid)	/* my child */
-			xproc->parent = proc;
+		parent = tfind(&key, &pids, cmp_pid);
+		if (parent && *parent != proc)
+			proc->parent = *parent;
 	}
 
+	tdestroy(pids, free_nothing);
+}
+
+static int add_process_to_namespace(struct lsns_namespace *ns, struct lsns_process *proc)
+{
+	DBG(NS, ul_debugobj(ns, "add process [%p] pid=%d to %s[%ju]",
+		proc, proc->pid, ns_names[ns->type], (uintmax_t)ns->id));
+
 	list_add_tail(&proc->ns_siblings[ns->type], &ns->processes);
 	ns->nprocs++;
 
@@ -800,6 +854,8 @@ static int read_namespaces(struct lsns *ls)
 
 	DBG(NS, ul_debug("reading namespace"));
 
+	link_processes(ls);
+
 	list_for_each(p, &ls->processes) {
 		size_t i;
 		struct lsns_namespace *ns;
@@ -814,31 +870,20 @@ static int read_namespaces(struct lsns *ls)
 				if (!ns)
 					return -ENOMEM;
 			}
-			add_process_to_namespace(ls, ns, proc);
+			add_process_to_namespace(ns, proc);
 		}
 	}
 
 	if (ls->tree == LSNS_TREE_OWNER || ls->tree == LSNS_TREE_PARENT) {
 		list_for_each(p, &ls->namespaces) {
 			struct lsns_namespace *ns = list_entry(p, struct lsns_namespace, namespaces);
-			struct list_head *pp;
-			list_for_each(pp, &ls->namespaces) {
-				struct lsns_namespace *pns = list_entry(pp, struct lsns_namespace, namespaces);
-				if (ns->type == LSNS_ID_USER
-				    || ns->type == LSNS_ID_PID) {
-					if (ns->related_id[RELA_PARENT] == pns->id)
-						ns->related_ns[RELA_PARENT] = pns;
-					if (ns->related_id[RELA_OWNER] == pns->id)
-						ns->related_ns[RELA_OWNER] = pns;
-					if (ns->related_ns[RELA_PARENT] && ns->related_ns[RELA_OWNER])
-						break;
-				} else {
-					if (ns->related_id[RELA_OWNER] == pns->id) {
-						ns->related_ns[RELA_OWNER] = pns;
-						break;
-					}
-				}
-			}
+
+			if (ns->type == LSNS_ID_USER
+			    || ns->type == LSNS_ID_PID)
+				ns->related_ns[RELA_PARENT] = get_namespace(ls,
+						ns->related_id[RELA_PARENT]);
+			ns->related_ns[RELA_OWNER] = get_namespace(ls,
+						ns->related_id[RELA_OWNER]);
 
 			/* lsns scans /proc/[0-9]+ for finding namespaces.
 			 * So if a namespace has no process, lsns cannot
@@ -1262,7 +1307,6 @@ int main(int argc, char *argv[])
 
 	INIT_LIST_HEAD(&ls.processes);
 	INIT_LIST_HEAD(&ls.namespaces);
-	INIT_LIST_HEAD(&netnsids_cache);
 
 	while ((c = getopt_long(argc, argv,
 				"Jlp:o:nruhVt:T::W", long_opts, NULL)) != -1) {
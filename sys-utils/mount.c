@@ -467,6 +467,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	" -c, --no-canonicalize   don't canonicalize paths\n"
 	" -f, --fake              dry run; skip the mount(2) syscall\n"
 	" -F, --fork              fork off for each device (use with -a)\n"
+	"     --fork-limit <num>  maximal number of parallel mounts (implies -F)\n"
 	" -T, --fstab <path>      alternative file to /etc/fstab\n"));
 	fprintf(out, _(
 	" -i, --internal-only     don't call the mount.<type> helpers\n"));
@@ -618,7 +619,8 @@ int main(int argc, char **argv)
 		MOUNT_OPT_SOURCE,
 		MOUNT_OPT_OPTMODE,
 		MOUNT_OPT_OPTSRC,
-		MOUNT_OPT_OPTSRC_FORCE
+		MOUNT_OPT_OPTSRC_FORCE,
+		MOUNT_OPT_FORK_LIMIT
 	};
 
 	static const struct option longopts[] = {
@@ -626,6 +628,7 @@ int main(int argc, char **argv)
 		{ "fake",             no_argument,       NULL, 'f'                   },
 		{ "fstab",            required_argument, NULL, 'T'                   },
 		{ "fork",             no_argument,       NULL, 'F'                   },
+		{ "fork-limit",       required_argument, NULL, MOUNT_OPT_FORK_LIMIT  },
 		{ "help",             no_argument,       NULL, 'h'                   },
 		{ "no-mtab",          no_argument,       NULL, 'n'                   },
 		{ "read-only",        no_argument,       NULL, 'r'                   },
@@ -862,6 +865,17 @@ int main(int argc, char **argv)
 		case MOUNT_OPT_OPTSRC_FORCE:
 			optmode |= MNT_OMODE_FORCE;
 			break;
+		case MOUNT_OPT_FORK_LIMIT:
+		{
+			int32_t limit = strtos32_or_err(optarg,
+					_("invalid fork limit argument"));
+			if (limit < 0)
+				errx(MNT_EX_USAGE, _("invalid fork limit argument: '%s'"),
+						optarg);
+			mnt_context_enable_fork(cxt, TRUE);
+			mnt_context_set_fork_limit(cxt, limit);
+			break;
+		}
 
 		case 'h':
 			mnt_free_context(cxt);
@@ -41,6 +41,8 @@
 #include "closestream.h"
 #include "namespace.h"
 #include "exec_shell.h"
+#include "pidfd-utils.h"
+#include "xalloc.h"
 
 static struct namespace_file {
 	int nstype;
@@ -80,6 +82,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -a, --all              enter all namespaces\n"), out);
 	fputs(_(" -t, --target <pid>     target process to get namespaces from\n"), out);
+	fputs(_("     --targets <pid>[,<pid>...]\n"
+		"                        run the program for every target process in turn\n"), out);
 	fputs(_(" -m, --mount[=<file>]   enter mount namespace\n"), out);
 	fputs(_(" -u, --uts[=<file>]     enter UTS namespace (hostname etc)\n"), out);
 	fputs(_(" -i, --ipc[=<file>]     enter System V IPC namespace\n"), out);
@@ -146,6 +150,77 @@ static void open_namespace_fd(int nstype, const char *path)
 	assert(nsfile->nstype);
 }
 
+#ifdef UL_HAVE_PIDFD
+/*
+ * Enters all the @namespaces of the target process by one setns() call on
+ * its pidfd (Linux 5.8). The namespaces are changed at once, so there is no
+ * need to care about the order of the user namespace.
+ */
+static int enter_target_namespaces(int namespaces)
+{
+	int fd, rc;
+
+	fd = pidfd_open(namespace_target_pid, 0);
+	if (fd < 0)
+		return -errno;
+	rc = setns(fd, namespaces);
+	close(fd);
+	return rc ? -errno : 0;
+}
+#endif
+
+static pid_t *parse_targets(const char *list, size_t *ntargets)
+{
+	pid_t *targets = NULL;
+	char *buf = xstrdup(list), *tok, *save = NULL;
+	size_t n = 0;
+
+	for (tok = strtok_r(buf, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		targets = xrealloc(targets, (n + 1) * sizeof(*targets));
+		targets[n++] = strtoul_or_err(tok, _("failed to parse pid"));
+	}
+	free(buf);
+
+	if (!n)
+		errx(EXIT_FAILURE, _("failed to parse pid"));
+	*ntargets = n;
+	return targets;
+}
+
+/*
+ * Forks a child for every target. The child returns to continue with the
+ * target as namespace_target_pid, the parent waits for it before the next
+ * one is started and exits when all of them are done.
+ */
+static void fork_for_targets(pid_t *targets, size_t ntargets)
+{
+	int rc = EXIT_SUCCESS;
+	size_t i;
+
+	for (i = 0; i < ntargets; i++) {
+		pid_t child;
+		int status;
+
+		child = fork();
+		if (child < 0)
+			err(EXIT_FAILURE, _("fork failed"));
+		if (child == 0) {
+			namespace_target_pid = targets[i];
+			free(targets);
+			return;
+		}
+		while (waitpid(child, &status, 0) < 0) {
+			if (errno != EINTR)
+				err(EXIT_FAILURE, _("waitpid failed"));
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			rc = EXIT_FAILURE;
+	}
+	free(targets);
+	exit(rc);
+}
+
 static int get_ns_ino(const char *path, ino_t *ino)
 {
 	struct stat st;
@@ -207,13 +282,15 @@ static void continue_as_child(void)
 int main(int argc, char *argv[])
 {
 	enum {
-		OPT_PRESERVE_CRED = CHAR_MAX + 1
+		OPT_PRESERVE_CRED = CHAR_MAX + 1,
+		OPT_TARGETS
 	};
 	static const struct option longopts[] = {
 		{ "all", no_argument, NULL, 'a' },
 		{ "help", no_argument, NULL, 'h' },
 		{ "version", no_argument, NULL, 'V'},
 		{ "target", required_argument, NULL, 't' },
+		{ "targets", required_argument, NULL, OPT_TARGETS },
 		{ "mount", optional_argument, NULL, 'm' },
 		{ "uts", optional_argument, NULL, 'u' },
 		{ "ipc", optional_argument, NULL, 'i' },
@@ -237,8 +314,10 @@ int main(int argc, char *argv[])
 	struct namespace_file *nsfile;
 	int c, pass, namespaces = 0, setgroups_nerrs = 0, preserve_cred = 0;
 	bool do_rd = false, do_wd = false, force_uid = false, force_gid = false;
-	bool do_all = false;
+	bool do_all = false, use_pidfd = false;
 	int do_fork = -1; /* unknown yet */
+	pid_t *targets = NULL;
+	size_t ntargets = 0;
 	uid_t uid = 0;
 	gid_t gid = 0;
 #ifdef HAVE_LIBSELINUX
@@ -332,6 +411,10 @@ int main(int argc, char *argv[])
 			else
 				do_wd = true;
 			break;
+		case OPT_TARGETS:
+			free(targets);
+			targets = parse_targets(optarg, &ntargets);
+			break;
 		case OPT_PRESERVE_CRED:
 			preserve_cred = 1;
 			break;
@@ -349,6 +432,13 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (targets) {
+		if (namespace_target_pid)
+			errx(EXIT_FAILURE, _("%s and %s are mutually exclusive"),
+					"--target", "--targets");
+		fork_for_targets(targets, ntargets);
+	}
+
 #ifdef HAVE_LIBSELINUX
 	if (selinux && is_selinux_enabled() > 0) {
 		char *scon = NULL;
@@ -382,10 +472,23 @@ int main(int argc, char *argv[])
 		}
 	}
 
+#ifdef UL_HAVE_PIDFD
+	/*
+	 * All the namespaces from the target process may be entered by its
+	 * pidfd, the namespace files are opened only if that fails.
+	 */
+	if (namespaces && namespace_target_pid) {
+		use_pidfd = true;
+		for (nsfile = namespace_files; nsfile->nstype; nsfile++) {
+			if (nsfile->fd >= 0)
+				use_pidfd = false;
+		}
+	}
+#endif
 	/*
 	 * Open remaining namespace and directory descriptors.
 	 */
-	for (nsfile = namespace_files; nsfile->nstype; nsfile++)
+	for (nsfile = namespace_files; !use_pidfd && nsfile->nstype; nsfile++)
 		if (nsfile->nstype & namespaces)
 			open_namespace_fd(nsfile->nstype, NULL);
 	if (do_rd)
@@ -421,6 +524,19 @@ int main(int argc, char *argv[])
 	 * privileging it then we enter the user namespace first
 	 * (because the initial setns will fail).
 	 */
+#ifdef UL_HAVE_PIDFD
+	if (use_pidfd) {
+		if (enter_target_namespaces(namespaces) == 0) {
+			if ((namespaces & CLONE_NEWPID) && do_fork == -1)
+				do_fork = 1;
+		} else {
+			/* old kernel, fallback to the namespace files */
+			for (nsfile = namespace_files; nsfile->nstype; nsfile++)
+				if (nsfile->nstype & namespaces)
+					open_namespace_fd(nsfile->nstype, NULL);
+		}
+	}
+#endif
 	for (pass = 0; pass < 2; pass ++) {
 		for (nsfile = namespace_files + 1 - pass; nsfile->nstype; nsfile++) {
 			if (nsfile->fd < 0)
@@ -35,6 +35,7 @@
 #include "strutils.h"
 #include "list.h"
 #include "closestream.h"
+#include "procutils.h"
 
 #ifndef RLIMIT_RTTIME
 # define RLIMIT_RTTIME 15
@@ -162,12 +163,15 @@ static void __attribute__((__noreturn__)) usage(void)
 		_(" %s [options] [--<resource>=<limit>] [-p PID]\n"), program_invocation_short_name);
 	fprintf(out,
 		_(" %s [options] [--<resource>=<limit>] COMMAND\n"), program_invocation_short_name);
+	fprintf(out,
+		_(" %s [options] --<resource>=<limit> --select <filter>...\n"), program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("Show or change the resource limits of a process.\n"), out);
 
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -p, --pid <pid>        process id\n"
+		"     --select <filter>  modify all processes matching the filter\n"
 		" -o, --output <list>    define which output columns to use\n"
 		"     --noheadings       don't print headings\n"
 		"     --raw              use the raw output format\n"
@@ -391,6 +395,78 @@ static void do_prlimit(struct list_head *lims)
 	}
 }
 
+/*
+ * Sets the limits for all the selected processes; a limit with only the soft
+ * or only the hard value given needs to read the other one for each process.
+ * Returns the number of processes which could not be modified.
+ */
+static size_t do_prlimit_selected(struct list_head *lims,
+				  struct proc_processes *ps)
+{
+	size_t nchanged = 0, nfailed = 0;
+	struct list_head *p;
+	pid_t xpid;
+	int rc;
+
+	list_for_each(p, lims) {
+		struct prlimit *lim = list_entry(p, struct prlimit, lims);
+
+		if (!lim->modify)
+			errx(EXIT_FAILURE, _("--select requires a new value for all the limits"));
+		if (lim->modify == (PRLIMIT_HARD | PRLIMIT_SOFT)
+		    && lim->rlim.rlim_cur > lim->rlim.rlim_max)
+			errx(EXIT_FAILURE, _("the soft limit %s cannot exceed the hard limit"),
+					lim->desc->name);
+	}
+
+	while ((rc = proc_next_pid(ps, &xpid)) == 0) {
+		int failed = 0, gone = 0;
+
+		list_for_each(p, lims) {
+			struct prlimit *lim = list_entry(p, struct prlimit, lims);
+			struct rlimit new = lim->rlim, old;
+
+			if (lim->modify != (PRLIMIT_HARD | PRLIMIT_SOFT)) {
+				if (prlimit(xpid, lim->desc->resource, NULL, &old) == -1)
+					goto failed;
+				if (!(lim->modify & PRLIMIT_SOFT))
+					new.rlim_cur = old.rlim_cur;
+				else
+					new.rlim_max = old.rlim_max;
+				if (new.rlim_cur > new.rlim_max) {
+					errno = EINVAL;
+					goto failed;
+				}
+			}
+			if (prlimit(xpid, lim->desc->resource, &new, NULL) == 0)
+				continue;
+failed:
+			if (errno == ESRCH) {
+				gone = 1;	/* exited in the meantime */
+				break;
+			}
+			if (!nfailed && !failed)
+				warn(_("failed to set the %s resource limit for %d"),
+				     lim->desc->name, xpid);
+			failed = 1;
+		}
+		if (failed)
+			nfailed++;
+		else if (!gone)
+			nchanged++;
+	}
+	if (rc < 0)
+		warn(_("failed to read list of processes"));
+
+	printf(P_("%zu process changed", "%zu processes changed", nchanged),
+	       nchanged);
+	if (nfailed)
+		printf(_(", failed %zu"), nfailed);
+	fputc('\n', stdout);
+
+	return nfailed + (rc < 0);
+}
+
 static int get_range(char *str, rlim_t *soft, rlim_t *hard, int *found)
 {
 	char *end = NULL;
@@ -492,11 +568,13 @@ int main(int argc, char **argv)
 {
 	int opt;
 	struct list_head lims;
+	struct proc_processes *sel = NULL;
 
 	enum {
 		VERBOSE_OPTION = CHAR_MAX + 1,
 		RAW_OPTION,
-		NOHEADINGS_OPTION
+		NOHEADINGS_OPTION,
+		SELECT_OPTION
 	};
 
 	static const struct option longopts[] = {
@@ -522,6 +600,7 @@ int main(int argc, char **argv)
 		{ "help",       no_argument, NULL, 'h' },
 		{ "noheadings", no_argument, NULL, NOHEADINGS_OPTION },
 		{ "raw",        no_argument, NULL, RAW_OPTION },
+		{ "select",     required_argument, NULL, SELECT_OPTION },
 		{ "verbose",    no_argument, NULL, VERBOSE_OPTION },
 		{ NULL, 0, NULL, 0 }
 	};
@@ -613,6 +692,19 @@ int main(int argc, char **argv)
 		case RAW_OPTION:
 			raw = 1;
 			break;
+		case SELECT_OPTION:
+		{
+			int rc;
+
+			if (!sel && !(sel = proc_open_processes()))
+				err(EXIT_FAILURE, _("failed to read list of processes"));
+			rc = proc_processes_add_filter(sel, optarg);
+			if (rc) {
+				errno = -rc;
+				err(EXIT_FAILURE, _("invalid filter '%s'"), optarg);
+			}
+			break;
+		}
 
 		case 'h':
 			usage();
@@ -624,6 +716,18 @@ int main(int argc, char **argv)
 	}
 	if (argc > optind && pid)
 		errx(EXIT_FAILURE, _("options --pid and COMMAND are mutually exclusive"));
+	if (sel) {
+		size_t nfailed;
+
+		if (pid || argc > optind)
+			errx(EXIT_FAILURE, _("option --select cannot be combined with --pid or COMMAND"));
+		if (list_empty(&lims))
+			errx(EXIT_FAILURE, _("--select requires a new value for all the limits"));
+
+		nfailed = do_prlimit_selected(&lims, sel);
+		proc_close_processes(sel);
+		return nfailed ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
 	if (!ncolumns) {
 		/* default columns */
 		columns[ncolumns++] = COL_RES;
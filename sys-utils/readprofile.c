@@ -40,12 +40,14 @@
  * "readprofile -s -m /boot/System.map-test | grep __d_lookup | sort -n -k3"
  */
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
@@ -57,27 +59,155 @@
 #include "xalloc.h"
 #include "closestream.h"
 
-#define S_LEN 128
-
 /* These are the defaults */
 static char defaultmap[]="/boot/System.map";
 static char defaultpro[]="/proc/profile";
 
-static FILE *myopen(char *name, char *mode, int *flag)
+/* System.map in memory, mmap()ed or read from zcat */
+struct mapfile {
+	const char	*name;
+	char		*data;
+	size_t		size;
+	size_t		pos;		/* the next line */
+	int		lineno;		/* the last returned line */
+
+	unsigned int	mmapped : 1;
+};
+
+/* a line of the map, mode and name are not terminated */
+struct mapsym {
+	unsigned long long	addr;
+	const char		*mode;
+	const char		*name;
+	int			namesz;
+};
+
+static int read_stream(FILE *f, struct mapfile *mf)
 {
-	int len = strlen(name);
+	size_t sz = 0;
+
+	do {
+		if (mf->size == sz) {
+			sz = sz ? sz * 2 : 256 * 1024;
+			mf->data = xrealloc(mf->data, sz);
+		}
+		mf->size += fread(mf->data + mf->size, 1, sz - mf->size, f);
+	} while (mf->size == sz);
 
-	if (!strcmp(name + len - 3, ".gz")) {
-		FILE *res;
+	return ferror(f) ? -EIO : 0;
+}
+
+static int open_map(struct mapfile *mf, const char *name)
+{
+	size_t len = strlen(name);
+	struct stat st;
+	FILE *f;
+	int fd, rc;
+
+	memset(mf, 0, sizeof(*mf));
+	mf->name = name;
+
+	if (len > 3 && !strcmp(name + len - 3, ".gz")) {
 		char *cmdline = xmalloc(len + 6);
+
 		snprintf(cmdline, len + 6, "zcat %s", name);
-		res = popen(cmdline, mode);
+		f = popen(cmdline, "r");
 		free(cmdline);
-		*flag = 1;
-		return res;
+		if (!f)
+			return -errno;
+		rc = read_stream(f, mf);
+		if (pclose(f) != 0 && !rc)
+			rc = -ENOENT;
+		return rc;
 	}
-	*flag = 0;
-	return fopen(name, mode);
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		mf->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mf->data != MAP_FAILED) {
+			mf->size = st.st_size;
+			mf->mmapped = 1;
+			close(fd);
+			return 0;
+		}
+		mf->data = NULL;
+	}
+
+	f = fdopen(fd, "r");
+	if (!f) {
+		rc = -errno;
+		close(fd);
+		return rc;
+	}
+	rc = read_stream(f, mf);
+	fclose(f);
+	return rc;
+}
+
+static void close_map(struct mapfile *mf)
+{
+	if (mf->mmapped)
+		munmap(mf->data, mf->size);
+	else
+		free(mf->data);
+}
+
+static inline int is_map_blank(int c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/* Returns 1 and the next "<address> <mode> <name>" line, or 0 at the end. */
+static int next_map_symbol(struct mapfile *mf, struct mapsym *sym)
+{
+	const char *p, *end, *s;
+
+	if (mf->pos >= mf->size)
+		return 0;
+
+	p = mf->data + mf->pos;
+	end = memchr(p, '\n', mf->size - mf->pos);
+	if (!end)
+		end = mf->data + mf->size;
+	mf->pos = end - mf->data + 1;
+	mf->lineno++;
+
+	while (p < end && is_map_blank(*p))
+		p++;
+	sym->addr = 0;
+	for (s = p; p < end && isxdigit((unsigned char) *p); p++)
+		sym->addr = (sym->addr << 4) | (unsigned long long)
+			(isdigit((unsigned char) *p) ? *p - '0' : (*p | 0x20) - 'a' + 10);
+	if (p == s || p == end || !is_map_blank(*p))
+		goto err;
+
+	while (p < end && is_map_blank(*p))
+		p++;
+	sym->mode = p;
+	while (p < end && !is_map_blank(*p))
+		p++;
+	if (p == sym->mode)
+		goto err;
+
+	while (p < end && is_map_blank(*p))
+		p++;
+	sym->name = p;
+	while (p < end && !is_map_blank(*p))
+		p++;
+	sym->namesz = p - sym->name;
+	if (!sym->namesz)
+		goto err;
+	return 1;
+err:
+	errx(EXIT_FAILURE, _("%s(%i): wrong map line"), mf->name, mf->lineno);
+}
+
+static inline int is_symbol(const struct mapsym *sym, const char *name)
+{
+	return (size_t) sym->namesz == strlen(name)
+	       && !memcmp(sym->name, name, sym->namesz);
 }
 
 #ifndef BOOT_SYSTEM_MAP
@@ -99,6 +229,57 @@ static char *boot_uname_r_str(void)
 	return s;
 }
 
+/* Reads the profiling buffer, returns the number of entries in @len */
+static unsigned int *read_profile(const char *file, size_t *len, int native)
+{
+	unsigned int *buf;
+	ssize_t rc;
+	int fd;
+
+	/* Use an fd for the profiling buffer, to skip stdio overhead */
+	if (((fd = open(file, O_RDONLY)) < 0)
+	    || ((int)(*len = lseek(fd, 0, SEEK_END)) < 0)
+	    || (lseek(fd, 0, SEEK_SET) < 0))
+		err(EXIT_FAILURE, "%s", file);
+	if (!*len)
+		errx(EXIT_FAILURE, "%s: %s", file, _("input file is empty"));
+
+	buf = xmalloc(*len);
+
+	rc = read(fd, buf, *len);
+	if (rc < 0 || (size_t) rc != *len)
+		err(EXIT_FAILURE, "%s", file);
+	close(fd);
+
+	*len /= sizeof(*buf);
+
+	if (!native) {
+		int big = 0, small = 0;
+		unsigned *p;
+		size_t i;
+
+		for (p = buf + 1; p < buf + *len; p++) {
+			if (*p & ~0U << ((unsigned) sizeof(*buf) * 4U))
+				big++;
+			if (*p & ((1U << ((unsigned) sizeof(*buf) * 4U)) - 1U))
+				small++;
+		}
+		if (big > small) {
+			warnx(_("Assuming reversed byte order. "
+				"Use -n to force native byte order."));
+			for (p = buf; p < buf + *len; p++)
+				for (i = 0; i < sizeof(*buf) / 2; i++) {
+					unsigned char *b = (unsigned char *)p;
+					unsigned char tmp;
+					tmp = b[i];
+					b[i] = b[sizeof(*buf) - i - 1];
+					b[sizeof(*buf) - i - 1] = tmp;
+				}
+		}
+	}
+	return buf;
+}
+
 static void __attribute__((__noreturn__)) usage(void)
 {
 	FILE *out = stdout;
@@ -115,6 +296,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	      _("                                      \"%s\")\n"), boot_uname_r_str());
 	fprintf(out,
 	      _(" -p, --profile <pro-file>  (default:  \"%s\")\n"), defaultpro);
+	fputs(_(" -d, --delta <pro-file>    print only the ticks since the <pro-file> snapshot\n"), out);
 	fputs(_(" -M, --multiplier <mult>   set the profiling multiplier to <mult>\n"), out);
 	fputs(_(" -i, --info                print only info about the sampling step\n"), out);
 	fputs(_(" -v, --verbose             print verbose data\n"), out);
@@ -131,29 +313,24 @@ static void __attribute__((__noreturn__)) usage(void)
 
 int main(int argc, char **argv)
 {
-	FILE *map;
-	int proFd, has_mult = 0, multiplier = 0;
-	char *mapFile, *proFile;
+	struct mapfile map;
+	struct mapsym fn = { 0 }, next;		/* current and next symbol */
+	int has_mult = 0, multiplier = 0;
+	char *mapFile, *proFile, *deltaFile = NULL;
 	size_t len = 0, indx = 1;
 	unsigned long long add0 = 0;
 	unsigned int step;
 	unsigned int *buf, total, fn_len;
-	unsigned long long fn_add = 0, next_add; /* current and next address */
-	char fn_name[S_LEN], next_name[S_LEN];	/* current and next name */
-	char mode[8];
-	int c;
-	ssize_t rc;
+	int c, rc;
 	int optAll = 0, optInfo = 0, optReset = 0, optVerbose = 0, optNative = 0;
 	int optBins = 0, optSub = 0;
-	char mapline[S_LEN];
-	int maplineno = 1;
-	int popenMap;		/* flag to tell if popen() has been used */
 	int header_printed;
 	double rep = 0;
 
 	static const struct option longopts[] = {
 		{"mapfile", required_argument, NULL, 'm'},
 		{"profile", required_argument, NULL, 'p'},
+		{"delta", required_argument, NULL, 'd'},
 		{"multiplier", required_argument, NULL, 'M'},
 		{"info", no_argument, NULL, 'i'},
 		{"verbose", no_argument, NULL, 'v'},
@@ -167,8 +344,6 @@ int main(int argc, char **argv)
 		{NULL, 0, NULL, 0}
 	};
 
-#define next (current^1)
-
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
@@ -177,7 +352,7 @@ int main(int argc, char **argv)
 	proFile = defaultpro;
 	mapFile = defaultmap;
 
-	while ((c = getopt_long(argc, argv, "m:p:M:ivabsrnVh", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "m:p:d:M:ivabsrnVh", longopts, NULL)) != -1) {
 		switch (c) {
 		case 'm':
 			mapFile = optarg;
@@ -188,6 +363,9 @@ int main(int argc, char **argv)
 		case 'p':
 			proFile = optarg;
 			break;
+		case 'd':
+			deltaFile = optarg;
+			break;
 		case 'a':
 			optAll++;
 			break;
@@ -244,45 +422,18 @@ int main(int argc, char **argv)
 		exit(EXIT_SUCCESS);
 	}
 
-	/* Use an fd for the profiling buffer, to skip stdio overhead */
-	if (((proFd = open(proFile, O_RDONLY)) < 0)
-	    || ((int)(len = lseek(proFd, 0, SEEK_END)) < 0)
-	    || (lseek(proFd, 0, SEEK_SET) < 0))
-		err(EXIT_FAILURE, "%s", proFile);
-	if (!len)
-		errx(EXIT_FAILURE, "%s: %s", proFile, _("input file is empty"));
-
-	buf = xmalloc(len);
-
-	rc = read(proFd, buf, len);
-	if (rc < 0 || (size_t) rc != len)
-		err(EXIT_FAILURE, "%s", proFile);
-	close(proFd);
-
-	if (!optNative) {
-		int entries = len / sizeof(*buf);
-		int big = 0, small = 0;
-		unsigned *p;
-		size_t i;
+	buf = read_profile(proFile, &len, optNative);
 
-		for (p = buf + 1; p < buf + entries; p++) {
-			if (*p & ~0U << ((unsigned) sizeof(*buf) * 4U))
-				big++;
-			if (*p & ((1U << ((unsigned) sizeof(*buf) * 4U)) - 1U))
-				small++;
-		}
-		if (big > small) {
-			warnx(_("Assuming reversed byte order. "
-				"Use -n to force native byte order."));
-			for (p = buf; p < buf + entries; p++)
-				for (i = 0; i < sizeof(*buf) / 2; i++) {
-					unsigned char *b = (unsigned char *)p;
-					unsigned char tmp;
-					tmp = b[i];
-					b[i] = b[sizeof(*buf) - i - 1];
-					b[sizeof(*buf) - i - 1] = tmp;
-				}
-		}
+	if (deltaFile) {
+		size_t i, dlen;
+		unsigned int *dbuf = read_profile(deltaFile, &dlen, optNative);
+
+		if (dlen != len || dbuf[0] != buf[0])
+			errx(EXIT_FAILURE, _("%s and %s are not snapshots of the same profile"),
+					deltaFile, proFile);
+		for (i = 1; i < len; i++)
+			buf[i] = buf[i] > dbuf[i] ? buf[i] - dbuf[i] : 0;
+		free(dbuf);
 	}
 
 	step = buf[0];
@@ -293,24 +444,22 @@ int main(int argc, char **argv)
 
 	total = 0;
 
-	map = myopen(mapFile, "r", &popenMap);
-	if (map == NULL && mapFile == defaultmap) {
+	rc = open_map(&map, mapFile);
+	if (rc && mapFile == defaultmap) {
 		mapFile = boot_uname_r_str();
-		map = myopen(mapFile, "r", &popenMap);
+		rc = open_map(&map, mapFile);
 	}
-	if (map == NULL)
+	if (rc) {
+		errno = -rc;
 		err(EXIT_FAILURE, "%s", mapFile);
+	}
 
-	while (fgets(mapline, S_LEN, map)) {
-		if (sscanf(mapline, "%llx %7[^\n ] %127[^\n ]", &fn_add, mode, fn_name) != 3)
-			errx(EXIT_FAILURE, _("%s(%i): wrong map line"), mapFile,
-			     maplineno);
+	while (next_map_symbol(&map, &fn)) {
 		/* only elf works like this */
-		if (!strcmp(fn_name, "_stext") || !strcmp(fn_name, "__stext")) {
-			add0 = fn_add;
+		if (is_symbol(&fn, "_stext") || is_symbol(&fn, "__stext")) {
+			add0 = fn.addr;
 			break;
 		}
-		maplineno++;
 	}
 
 	if (!add0)
@@ -319,40 +468,38 @@ int main(int argc, char **argv)
 	/*
 	 * Main loop.
 	 */
-	while (fgets(mapline, S_LEN, map)) {
+	while (next_map_symbol(&map, &next)) {
 		unsigned int this = 0;
 		int done = 0;
+		char mode = *next.mode;
 
-		if (sscanf(mapline, "%llx %7[^\n ] %127[^\n ]", &next_add, mode, next_name) != 3)
-			errx(EXIT_FAILURE, _("%s(%i): wrong map line"), mapFile,
-			     maplineno);
 		header_printed = 0;
 
 		/* the kernel only profiles up to _etext */
-		if (!strcmp(next_name, "_etext") ||
-		    !strcmp(next_name, "__etext"))
+		if (is_symbol(&next, "_etext") ||
+		    is_symbol(&next, "__etext"))
 			done = 1;
 		else {
 			/* ignore any LEADING (before a '[tT]' symbol
 			 * is found) Absolute symbols and __init_end
 			 * because some architectures place it before
 			 * .text section */
-			if ((*mode == 'A' || *mode == '?')
-			    && (total == 0 || !strcmp(next_name, "__init_end")))
+			if ((mode == 'A' || mode == '?')
+			    && (total == 0 || is_symbol(&next, "__init_end")))
 				continue;
-			if (*mode != 'T' && *mode != 't' &&
-			    *mode != 'W' && *mode != 'w')
+			if (mode != 'T' && mode != 't' &&
+			    mode != 'W' && mode != 'w')
 				break;	/* only text is profiled */
 		}
 
-		if (indx >= len / sizeof(*buf))
+		if (indx >= len)
 			errx(EXIT_FAILURE,
 			     _("profile address out of range. Wrong map file?"));
 
-		while (step > 0 && indx < (next_add - add0) / step) {
+		while (step > 0 && indx < (next.addr - add0) / step) {
 			if (optBins && (buf[indx] || optAll)) {
 				if (!header_printed) {
-					printf("%s:\n", fn_name);
+					printf("%.*s:\n", fn.namesz, fn.name);
 					header_printed = 1;
 				}
 				printf("\t%llx\t%u\n", (indx - 1) * step + add0,
@@ -366,41 +513,39 @@ int main(int argc, char **argv)
 			if (optVerbose || this > 0)
 				printf("  total\t\t\t\t%u\n", this);
 		} else if ((this || optAll) &&
-			   (fn_len = next_add - fn_add) != 0) {
+			   (fn_len = next.addr - fn.addr) != 0) {
 			if (optVerbose)
-				printf("%016llx %-40s %6u %8.4f\n", fn_add,
-				       fn_name, this, this / (double)fn_len);
+				printf("%016llx %-40.*s %6u %8.4f\n", fn.addr,
+				       fn.namesz, fn.name, this, this / (double)fn_len);
 			else
-				printf("%6u %-40s %8.4f\n",
-				       this, fn_name, this / (double)fn_len);
+				printf("%6u %-40.*s %8.4f\n",
+				       this, fn.namesz, fn.name, this / (double)fn_len);
 			if (optSub && step > 0) {
 				unsigned long long scan;
 
-				for (scan = (fn_add - add0) / step + 1;
-				     scan < (next_add - add0) / step;
+				for (scan = (fn.addr - add0) / step + 1;
+				     scan < (next.addr - add0) / step;
 				     scan++) {
 					unsigned long long addr;
 					addr = (scan - 1) * step + add0;
-					printf("\t%#llx\t%s+%#llx\t%u\n",
-					       addr, fn_name, addr - fn_add,
+					printf("\t%#llx\t%.*s+%#llx\t%u\n",
+					       addr, fn.namesz, fn.name, addr - fn.addr,
 					       buf[scan]);
 				}
 			}
 		}
 
-		fn_add = next_add;
-		strcpy(fn_name, next_name);
+		fn = next;
 
-		maplineno++;
 		if (done)
 			break;
 	}
 
 	/* clock ticks, out of kernel text - probably modules */
-	printf("%6u %s\n", buf[len / sizeof(*buf) - 1], "*unknown*");
+	printf("%6u %s\n", buf[len - 1], "*unknown*");
 
-	if (fn_add > add0)
-		rep = total / (double)(fn_add - add0);
+	if (fn.addr > add0)
+		rep = total / (double)(fn.addr - add0);
 
 	/* trailer */
 	if (optVerbose)
@@ -410,6 +555,6 @@ int main(int argc, char **argv)
 		printf("%6u %-40s %8.4f\n",
 		       total, _("total"), rep);
 
-	popenMap ? pclose(map) : fclose(map);
+	close_map(&map);
 	exit(EXIT_SUCCESS);
 }
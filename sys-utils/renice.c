@@ -47,6 +47,7 @@
 #include "nls.h"
 #include "c.h"
 #include "closestream.h"
+#include "procutils.h"
 
 static const char *idtype[] = {
 	[PRIO_PROCESS]	= N_("process ID"),
@@ -61,7 +62,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fprintf(out,
 	      _(" %1$s [-n] <priority> [-p|--pid] <pid>...\n"
 		" %1$s [-n] <priority>  -g|--pgrp <pgid>...\n"
-		" %1$s [-n] <priority>  -u|--user <user>...\n"),
+		" %1$s [-n] <priority>  -u|--user <user>...\n"
+		" %1$s [-n] <priority>  -s|--select <filter>...\n"),
 		program_invocation_short_name);
 
 	fputs(USAGE_SEPARATOR, out);
@@ -72,6 +74,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -p, --pid              interpret arguments as process ID (default)\n"), out);
 	fputs(_(" -g, --pgrp             interpret arguments as process group ID\n"), out);
 	fputs(_(" -u, --user             interpret arguments as username or user ID\n"), out);
+	fputs(_(" -s, --select <filter>  alter all processes matching the filter\n"), out);
 	fputs(USAGE_SEPARATOR, out);
 	printf(USAGE_HELP_OPTIONS(24));
 	printf(USAGE_MAN_TAIL("renice(1)"));
@@ -106,6 +109,40 @@ static int donice(const int which, const int who, const int prio)
 	return 0;
 }
 
+/*
+ * Sets the priority for all the selected processes by one setpriority() per
+ * process and prints only a summary; used to tune thousands of processes.
+ */
+static int donice_selected(struct proc_processes *ps, const int prio)
+{
+	size_t nchanged = 0, nfailed = 0;
+	pid_t pid;
+	int rc;
+
+	while ((rc = proc_next_pid(ps, &pid)) == 0) {
+		if (setpriority(PRIO_PROCESS, pid, prio) == 0) {
+			nchanged++;
+			continue;
+		}
+		if (errno == ESRCH)
+			continue;	/* exited in the meantime */
+		if (!nfailed)
+			warn(_("failed to set priority for %d (%s)"),
+			     pid, idtype[PRIO_PROCESS]);
+		nfailed++;
+	}
+	if (rc < 0)
+		warn(_("failed to read list of processes"));
+
+	printf(P_("%zu process new priority %d",
+		  "%zu processes new priority %d", nchanged), nchanged, prio);
+	if (nfailed)
+		printf(_(", failed %zu"), nfailed);
+	fputc('\n', stdout);
+
+	return nfailed || rc < 0 ? 1 : 0;
+}
+
 /*
  * Change the priority (the nice value) of processes
  * or groups of processes which are already running.
@@ -115,6 +152,7 @@ int main(int argc, char **argv)
 	int which = PRIO_PROCESS;
 	int who = 0, prio, errs = 0;
 	char *endptr = NULL;
+	struct proc_processes *sel = NULL;
 
 	setlocale(LC_ALL, "");
 	bindtextdomain(PACKAGE, LOCALEDIR);
@@ -166,6 +204,24 @@ int main(int argc, char **argv)
 			which = PRIO_PROCESS;
 			continue;
 		}
+		if (strcmp(*argv, "-s") == 0 || strcmp(*argv, "--select") == 0) {
+			int rc;
+
+			if (argc < 2) {
+				warnx(_("%s requires an argument"), *argv);
+				errtryhelp(EXIT_FAILURE);
+			}
+			argc--;
+			argv++;
+			if (!sel && !(sel = proc_open_processes()))
+				err(EXIT_FAILURE, _("failed to read list of processes"));
+			rc = proc_processes_add_filter(sel, *argv);
+			if (rc) {
+				errno = -rc;
+				err(EXIT_FAILURE, _("invalid filter '%s'"), *argv);
+			}
+			continue;
+		}
 		if (which == PRIO_USER) {
 			struct passwd *pwd = getpwnam(*argv);
 
@@ -190,5 +246,9 @@ int main(int argc, char **argv)
 		}
 		errs |= donice(which, who, prio);
 	}
+	if (sel) {
+		errs |= donice_selected(sel, prio);
+		proc_close_processes(sel);
+	}
 	return errs != 0 ? EXIT_FAILURE : EXIT_SUCCESS;
 }
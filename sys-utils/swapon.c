@@ -66,6 +66,9 @@
 
 #define MAX_PAGESIZE	(64 * 1024)
 
+/* max number of concurrent swapon(2) calls for --all --parallel */
+#define MAX_SWAPON_WORKERS	16
+
 #ifndef UUID_STR_LEN
 # define UUID_STR_LEN	37
 #endif
@@ -130,6 +133,7 @@ struct swapon_ctl {
 		bytes:1,		/* display --show in bytes */
 		fix_page_size:1,	/* reinitialize page size */
 		no_heading:1,		/* toggle --show headers */
+		parallel:1,		/* concurrent swapon(2) for --all */
 		raw:1,			/* toggle --show alignment */
 		show:1,			/* display --show information */
 		verbose:1;		/* be chatty */
@@ -735,11 +739,68 @@ static int parse_options(struct swap_prop *props, const char *options)
 }
 
 
+struct swapon_entry {
+	const char	*device;
+	struct swap_prop prop;
+};
+
+/*
+ * Activates the devices by child processes, at most MAX_SWAPON_WORKERS at
+ * once. The kernel does the expensive part of swapon(2) (discard, mapping
+ * of the swap file extents) per device, so the devices are set up
+ * concurrently.
+ */
+static int swapon_parallel(const struct swapon_ctl *ctl,
+			   const struct swapon_entry *ents, size_t nents)
+{
+	size_t i = 0, running = 0;
+	int status = 0;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	while (i < nents || running) {
+		int st;
+
+		if (i < nents && running < MAX_SWAPON_WORKERS) {
+			const struct swapon_entry *e = &ents[i++];
+			pid_t pid = fork();
+
+			if (pid == 0) {
+				int rc = do_swapon(ctl, &e->prop, e->device, TRUE);
+
+				fflush(stdout);
+				_exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+			}
+			if (pid < 0) {
+				warn(_("fork failed"));
+				status |= do_swapon(ctl, &e->prop, e->device, TRUE);
+			} else
+				running++;
+			continue;
+		}
+
+		if (wait(&st) < 0) {
+			if (errno == EINTR)
+				continue;
+			warn(_("waitpid failed"));
+			return -1;
+		}
+		running--;
+		if (!WIFEXITED(st) || WEXITSTATUS(st) != EXIT_SUCCESS)
+			status |= -1;
+	}
+
+	return status;
+}
+
 static int swapon_all(struct swapon_ctl *ctl)
 {
 	struct libmnt_table *tb = get_fstab();
 	struct libmnt_iter *itr;
 	struct libmnt_fs *fs;
+	struct swapon_entry *ents = NULL;
+	size_t nents = 0;
 	int status = 0;
 
 	if (!tb)
@@ -789,10 +850,27 @@ static int swapon_all(struct swapon_ctl *ctl)
 			continue;
 		}
 
+		/*
+		 * The kernel assigns the default priorities in the order of
+		 * activation, so only the devices with an explicit priority
+		 * may be activated concurrently.
+		 */
+		if (ctl->parallel && prop.priority >= 0) {
+			ents = xrealloc(ents, (nents + 1) * sizeof(*ents));
+			ents[nents].device = device;
+			ents[nents].prop = prop;
+			nents++;
+			continue;
+		}
+
 		/* swapon */
 		status |= do_swapon(ctl, &prop, device, TRUE);
 	}
 
+	if (nents)
+		status |= swapon_parallel(ctl, ents, nents);
+
+	free(ents);
 	mnt_free_iter(itr);
 	return status;
 }
@@ -816,6 +894,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -f, --fixpgsz            reinitialize the swap space if necessary\n"), out);
 	fputs(_(" -o, --options <list>     comma-separated list of swap options\n"), out);
 	fputs(_(" -p, --priority <prio>    specify the priority of the swap device\n"), out);
+	fputs(_("     --parallel           enable devices with priority concurrently (with --all)\n"), out);
 	fputs(_(" -s, --summary            display summary about used swap devices (DEPRECATED)\n"), out);
 	fputs(_("     --show[=<columns>]   display summary in definable table\n"), out);
 	fputs(_("     --noheadings         don't print table heading (with --show)\n"), out);
@@ -860,7 +939,8 @@ int main(int argc, char *argv[])
 		NOHEADINGS_OPTION,
 		RAW_OPTION,
 		SHOW_OPTION,
-		OPT_LIST_TYPES
+		OPT_LIST_TYPES,
+		PARALLEL_OPTION
 	};
 
 	static const struct option long_opts[] = {
@@ -879,6 +959,7 @@ int main(int argc, char *argv[])
 		{ "noheadings", no_argument,       NULL, NOHEADINGS_OPTION },
 		{ "raw",        no_argument,       NULL, RAW_OPTION        },
 		{ "bytes",      no_argument,       NULL, BYTES_OPTION      },
+		{ "parallel",   no_argument,       NULL, PARALLEL_OPTION   },
 		{ NULL, 0, NULL, 0 }
 	};
 
@@ -976,6 +1057,9 @@ int main(int argc, char *argv[])
 		case BYTES_OPTION:
 			ctl.bytes = 1;
 			break;
+		case PARALLEL_OPTION:
+			ctl.parallel = 1;
+			break;
 		case 0:
 			break;
 
@@ -25,6 +25,7 @@
 #include <sys/stat.h>
 #include <sys/statfs.h>
 #include <sys/param.h>
+#include <sys/wait.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,6 +49,9 @@
 #define MNT_DETACH       0x00000002	/* Just detach from the tree */
 #endif
 
+/* max number of processes to remove the old root */
+#define MAX_REMOVE_WORKERS	16
+
 /* remove all files/directories below dirName -- don't cross mountpoints */
 static int recursiveRemove(int fd)
 {
@@ -122,6 +126,136 @@ done:
 	return rc;
 }
 
+/*
+ * Adds the subdirectories of @name (or of the directory @fd if @name is NULL)
+ * on the same device to the @list; returns -1 on error.
+ */
+static int add_subdirs(int fd, const char *name, dev_t dev,
+		       char ***list, size_t *count)
+{
+	struct dirent *d;
+	DIR *dir;
+	int dfd, rc = 0;
+
+	/* don't use dup(), the directory offset would be shared with @fd */
+	dfd = openat(fd, name ? name : ".", O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+	if (dfd < 0 || !(dir = fdopendir(dfd))) {
+		if (dfd >= 0)
+			close(dfd);
+		return name ? 0 : -1;
+	}
+
+	while (rc == 0 && (d = readdir(dir))) {
+		struct stat sb;
+		char *path, **tmp;
+
+		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+			continue;
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (d->d_type != DT_DIR && d->d_type != DT_UNKNOWN)
+			continue;
+#endif
+		if (fstatat(dirfd(dir), d->d_name, &sb, AT_SYMLINK_NOFOLLOW)
+		    || !S_ISDIR(sb.st_mode) || sb.st_dev != dev)
+			continue;
+
+		path = malloc((name ? strlen(name) + 1 : 0) + strlen(d->d_name) + 1);
+		tmp = realloc(*list, (*count + 1) * sizeof(char *));
+		if (!path || !tmp) {
+			free(path);
+			if (tmp)
+				*list = tmp;
+			rc = -1;
+			break;
+		}
+		*list = tmp;
+		if (name)
+			sprintf(path, "%s/%s", name, d->d_name);
+		else
+			strcpy(path, d->d_name);
+		(*list)[(*count)++] = path;
+	}
+	closedir(dir);
+	return rc;
+}
+
+/*
+ * Removes the directories from the @list with index @first, @first + @step,
+ * ... relative to @fd.
+ */
+static void remove_subdirs(int fd, char **list, size_t count,
+			   size_t first, size_t step)
+{
+	size_t i;
+
+	for (i = first; i < count; i += step) {
+		int cfd = openat(fd, list[i], O_RDONLY | O_DIRECTORY | O_NOFOLLOW);
+
+		if (cfd < 0)
+			continue;
+		recursiveRemove(cfd);
+		unlinkat(fd, list[i], AT_REMOVEDIR);
+	}
+}
+
+/*
+ * Removes the old root in parallel. The second level directories (usr/lib,
+ * lib/modules, ...) are distributed to worker processes by round-robin, the
+ * rest is removed by recursiveRemove() when all the workers are done. The
+ * files of a large initramfs are freed on more CPUs this way, and the
+ * directories are locked by the kernel independently.
+ */
+static int parallelRemove(int fd)
+{
+	char **list = NULL, **toplevel = NULL;
+	size_t count = 0, ntop = 0, i;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t nworkers, n;
+	struct stat rb;
+
+	if (ncpus < 2 || fstat(fd, &rb) != 0)
+		goto serial;
+
+	nworkers = min((size_t) ncpus, (size_t) MAX_REMOVE_WORKERS);
+
+	if (add_subdirs(fd, NULL, rb.st_dev, &toplevel, &ntop) != 0)
+		goto serial;
+	for (i = 0; i < ntop; i++) {
+		if (add_subdirs(fd, toplevel[i], rb.st_dev, &list, &count) != 0)
+			goto serial;
+	}
+	if (count < 2)
+		goto serial;
+
+	nworkers = min(nworkers, count);
+
+	for (n = 0; n < nworkers; n++) {
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			remove_subdirs(fd, list, count, n, nworkers);
+			_exit(EXIT_SUCCESS);
+		}
+		if (pid < 0)
+			break;
+	}
+	/* do the rest if fork() failed */
+	for (i = n; i < nworkers; i++)
+		remove_subdirs(fd, list, count, i, nworkers);
+
+	while (wait(NULL) > 0 || errno == EINTR)
+		;
+serial:
+	for (i = 0; i < count; i++)
+		free(list[i]);
+	free(list);
+	for (i = 0; i < ntop; i++)
+		free(toplevel[i]);
+	free(toplevel);
+
+	return recursiveRemove(fd);
+}
+
 static int switchroot(const char *newroot)
 {
 	/*  Don't try to unmount the old "/", there's no way to do it. */
@@ -198,7 +332,7 @@ static int switchroot(const char *newroot)
 		if (fstatfs(cfd, &stfs) == 0 &&
 		    (F_TYPE_EQUAL(stfs.f_type, STATFS_RAMFS_MAGIC) ||
 		     F_TYPE_EQUAL(stfs.f_type, STATFS_TMPFS_MAGIC)))
-			recursiveRemove(cfd);
+			parallelRemove(cfd);
 		else {
 			warn(_("old root filesystem is not an initramfs"));
 			close(cfd);
@@ -26,6 +26,7 @@
 #include <getopt.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 #include <libmount.h>
 
@@ -35,6 +36,7 @@
 #include "closestream.h"
 #include "pathnames.h"
 #include "canonicalize.h"
+#include "strutils.h"
 
 #define XALLOC_EXIT_CODE MNT_EX_SYSERR
 #include "xalloc.h"
@@ -43,6 +45,7 @@
 #include "optutils.h"
 
 static int quiet;
+static size_t parallel;		/* --parallel <num> */
 static struct ul_env_list *envs_removed;
 
 static int table_parser_errcb(struct libmnt_table *tb __attribute__((__unused__)),
@@ -99,6 +102,8 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -n, --no-mtab           don't write to /etc/mtab\n"), out);
 	fputs(_(" -l, --lazy              detach the filesystem now, clean up things later\n"), out);
 	fputs(_(" -O, --test-opts <list>  limit the set of filesystems (use with -a)\n"), out);
+	fputs(_("     --parallel <num>    unmount up to <num> filesystems in parallel\n"
+		"                           (use with -a or -R)\n"), out);
 	fputs(_(" -R, --recursive         recursively unmount a target with all its children\n"), out);
 	fputs(_(" -r, --read-only         in case unmounting fails, try to remount read-only\n"), out);
 	fputs(_(" -t, --types <list>      limit the set of filesystem types\n"), out);
@@ -333,6 +338,351 @@ done:
 	return rc;
 }
 
+/*
+ * Parallel umount -- the filesystems are unmounted by forked children, the
+ * leaves of the mount tree first. A filesystem is unmounted when all its
+ * children have been unmounted. The over-mounted filesystem's children are
+ * not accessible by path, so they wait for the over-mount (the "gate").
+ */
+struct umount_job {
+	struct libmnt_fs	*fs;
+	ssize_t			parent;		/* job waiting for this one or -1 */
+	size_t			nwaiting;	/* number of not yet unmounted children */
+
+	ssize_t			gate;		/* job has to be done before this one or -1 */
+	ssize_t			gated;		/* the first job gated by this one or -1 */
+	ssize_t			gated_next;	/* the next job with the same gate or -1 */
+
+	unsigned int		late : 1,	/* unmount after all other jobs */
+				done : 1;
+};
+
+struct umount_sched {
+	struct umount_job	*jobs;
+	size_t			njobs;
+	size_t			nlate;
+};
+
+#define umount_job_from_fs(_fs)	((ssize_t) (intptr_t) mnt_fs_get_userdata(_fs) - 1)
+
+static ssize_t add_umount_job(struct umount_sched *sc, struct libmnt_fs *fs,
+			      ssize_t parent, ssize_t gate)
+{
+	struct umount_job *job;
+	ssize_t x = sc->njobs;
+
+	sc->jobs = xrealloc(sc->jobs, (sc->njobs + 1) * sizeof(struct umount_job));
+	job = &sc->jobs[x];
+	memset(job, 0, sizeof(*job));
+	job->fs = fs;
+	job->parent = parent;
+	job->gated = -1;
+	job->gate = gate;
+	job->gated_next = -1;
+
+	if (parent >= 0)
+		sc->jobs[parent].nwaiting++;
+	if (gate >= 0) {
+		job->gated_next = sc->jobs[gate].gated;
+		sc->jobs[gate].gated = x;
+	}
+
+	/* mount table is read from /proc, keep it until the end */
+	if (mnt_fs_streq_target(fs, "/proc")) {
+		job->late = 1;
+		sc->nlate++;
+	}
+	mnt_fs_set_userdata(fs, (void *) (intptr_t) (x + 1));
+	sc->njobs++;
+	return x;
+}
+
+static int is_umount_fs(struct libmnt_fs *fs, const char *types,
+			const char *optpattern)
+{
+	return mnt_fs_get_target(fs)
+	       && (!types || mnt_fs_match_fstype(fs, types))
+	       && (!optpattern || mnt_fs_match_options(fs, optpattern));
+}
+
+/*
+ * Adds jobs for @root and all its children (matching @types and @optpattern)
+ * to @sc, the tree is walked from the @root.
+ */
+static int add_umount_tree(struct umount_sched *sc, struct libmnt_table *tb,
+			   struct libmnt_fs *root, const char *types,
+			   const char *optpattern)
+{
+	struct libmnt_iter *itr = mnt_new_iter(MNT_ITER_BACKWARD);
+	struct {
+		struct libmnt_fs *fs;
+		ssize_t anc;		/* the nearest job in parents */
+		ssize_t gate;		/* inherited gate */
+		struct libmnt_fs *over;	/* over-mount of the parent */
+	} *queue;
+	size_t nqueue = 0, maxqueue = mnt_table_get_nents(tb), i;
+	int rc = 0;
+
+	if (!itr)
+		err(MNT_EX_SYSERR, _("libmount iterator allocation failed"));
+
+	queue = xcalloc(maxqueue, sizeof(*queue));
+	queue[nqueue].fs = root;
+	queue[nqueue].anc = -1;
+	queue[nqueue++].gate = -1;
+
+	for (i = 0; i < nqueue; i++) {
+		struct libmnt_fs *child, *over = NULL;
+		ssize_t anc = queue[i].anc, gate = queue[i].gate;
+
+		/* the over-mount is added to the queue before its siblings */
+		if (queue[i].over && umount_job_from_fs(queue[i].over) >= 0)
+			gate = umount_job_from_fs(queue[i].over);
+
+		if (is_umount_fs(queue[i].fs, types, optpattern))
+			anc = add_umount_job(sc, queue[i].fs, anc, gate);
+
+		if (mnt_table_over_fs(tb, queue[i].fs, &over) == 0 && over
+		    && nqueue < maxqueue) {
+			queue[nqueue].fs = over;
+			queue[nqueue].anc = anc;
+			queue[nqueue++].gate = gate;
+		}
+
+		mnt_reset_iter(itr, MNT_ITER_BACKWARD);
+		while ((rc = mnt_table_next_child_fs(tb, itr, queue[i].fs, &child)) == 0) {
+			if (child == over)
+				continue;
+			if (nqueue == maxqueue)
+				break;
+			queue[nqueue].fs = child;
+			queue[nqueue].anc = anc;
+			queue[nqueue].gate = gate;
+			queue[nqueue++].over = over;
+		}
+		if (rc < 0) {
+			warnx(_("failed to get child fs of %s"),
+					mnt_fs_get_target(queue[i].fs));
+			break;
+		}
+		rc = 0;
+	}
+
+	free(queue);
+	mnt_free_iter(itr);
+	return rc;
+}
+
+static void free_umount_jobs(struct umount_sched *sc)
+{
+	size_t i;
+
+	for (i = 0; i < sc->njobs; i++)
+		mnt_fs_set_userdata(sc->jobs[i].fs, NULL);
+	free(sc->jobs);
+	sc->jobs = NULL;
+	sc->njobs = sc->nlate = 0;
+}
+
+static int is_umount_job_ready(struct umount_sched *sc, ssize_t x)
+{
+	struct umount_job *job = &sc->jobs[x];
+
+	return !job->done && job->nwaiting == 0
+	       && (job->gate < 0 || sc->jobs[job->gate].done);
+}
+
+/* returns the next ready job or -1 */
+static ssize_t next_umount_job(struct umount_sched *sc,
+			       size_t *ready, size_t *nready, size_t nnormal)
+{
+	size_t i;
+
+	for (i = *nready; i > 0; i--) {
+		size_t x = ready[i - 1];
+
+		if (sc->jobs[x].late && nnormal)
+			continue;
+		memmove(&ready[i - 1], &ready[i], (*nready - i) * sizeof(size_t));
+		(*nready)--;
+		return x;
+	}
+	return -1;
+}
+
+static int run_umount_jobs(struct libmnt_context *cxt, struct umount_sched *sc,
+			   int stop_on_error)
+{
+	size_t *ready, nready = 0, nrunning = 0, i;
+	size_t nnormal = sc->njobs - sc->nlate;
+	size_t maxrunning = min(parallel, sc->njobs);
+	pid_t *running;
+	ssize_t *running_jobs;
+	int rc = MNT_EX_SUCCESS, failed = 0;
+
+	if (!sc->njobs)
+		return MNT_EX_SUCCESS;
+
+	ready = xcalloc(sc->njobs, sizeof(size_t));
+	running = xcalloc(maxrunning, sizeof(pid_t));
+	running_jobs = xcalloc(maxrunning, sizeof(ssize_t));
+
+	for (i = sc->njobs; i > 0; i--) {
+		if (is_umount_job_ready(sc, i - 1))
+			ready[nready++] = i - 1;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	do {
+		ssize_t x;
+		pid_t pid;
+		int status = 0, xrc;
+
+		while (!failed && nrunning < maxrunning
+		       && (x = next_umount_job(sc, ready, &nready, nnormal)) >= 0) {
+			pid = fork();
+			if (pid < 0) {
+				warn(_("fork failed"));
+				rc = MNT_EX_SYSERR;
+				failed = 1;
+				break;
+			}
+			if (pid == 0) {
+				xrc = umount_one_if_mounted(cxt,
+						mnt_fs_get_target(sc->jobs[x].fs));
+				fflush(stdout);
+				fflush(stderr);
+				_exit(xrc);
+			}
+			for (i = 0; i < maxrunning; i++) {
+				if (!running[i])
+					break;
+			}
+			running[i] = pid;
+			running_jobs[i] = x;
+			nrunning++;
+		}
+		if (!nrunning)
+			break;
+
+		do {
+			pid = wait(&status);
+		} while (pid < 0 && errno == EINTR);
+		if (pid < 0) {
+			warn(_("waitpid failed"));
+			rc = MNT_EX_SYSERR;
+			break;
+		}
+		for (i = 0; i < maxrunning; i++) {
+			if (running[i] == pid)
+				break;
+		}
+		if (i == maxrunning)
+			continue;	/* not our child */
+
+		x = running_jobs[i];
+		running[i] = 0;
+		nrunning--;
+		sc->jobs[x].done = 1;
+		if (!sc->jobs[x].late)
+			nnormal--;
+
+		xrc = WIFEXITED(status) ? WEXITSTATUS(status) : MNT_EX_SYSERR;
+		if (xrc != MNT_EX_SUCCESS) {
+			if (stop_on_error) {
+				if (!failed)
+					rc = xrc;
+				failed = 1;
+				continue;
+			}
+			rc |= xrc;
+		}
+
+		/* the parent and the gated jobs */
+		if (sc->jobs[x].parent >= 0) {
+			ssize_t p = sc->jobs[x].parent;
+
+			sc->jobs[p].nwaiting--;
+			if (is_umount_job_ready(sc, p))
+				ready[nready++] = p;
+		}
+		for (x = sc->jobs[x].gated; x >= 0; x = sc->jobs[x].gated_next) {
+			if (is_umount_job_ready(sc, x))
+				ready[nready++] = x;
+		}
+	} while (1);
+
+	free(running);
+	free(running_jobs);
+	free(ready);
+	return rc;
+}
+
+/* umount -R --parallel */
+static int umount_do_recurse_parallel(struct libmnt_context *cxt,
+		struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	struct umount_sched sc = { .njobs = 0 };
+	int rc;
+
+	rc = add_umount_tree(&sc, tb, fs, NULL, NULL);
+	if (rc == 0)
+		rc = run_umount_jobs(cxt, &sc, TRUE);
+	else
+		rc = MNT_EX_SOFTWARE;
+
+	free_umount_jobs(&sc);
+	return rc;
+}
+
+static int umount_tree(struct libmnt_context *cxt,
+		struct libmnt_table *tb, struct libmnt_fs *fs)
+{
+	if (parallel > 1)
+		return umount_do_recurse_parallel(cxt, tb, fs);
+	return umount_do_recurse(cxt, tb, fs);
+}
+
+/* umount -a --parallel */
+static int umount_all_parallel(struct libmnt_context *cxt, const char *types,
+			       const char *optpattern)
+{
+	struct umount_sched sc = { .njobs = 0 };
+	struct libmnt_table *tb;
+	struct libmnt_iter *itr;
+	struct libmnt_fs *fs = NULL, *root = NULL;
+	int rc = 0;
+
+	tb = new_mountinfo(cxt);
+	if (!tb)
+		return MNT_EX_SOFTWARE;
+
+	if (mnt_table_get_root_fs(tb, &root) == 0 && root)
+		rc = add_umount_tree(&sc, tb, root, types, optpattern);
+	if (rc) {
+		rc = MNT_EX_SOFTWARE;
+		goto done;
+	}
+
+	/* not in the tree (e.g. parent is out of chroot) */
+	itr = mnt_new_iter(MNT_ITER_BACKWARD);
+	if (!itr)
+		err(MNT_EX_SYSERR, _("libmount iterator allocation failed"));
+	while (mnt_table_next_fs(tb, itr, &fs) == 0) {
+		if (umount_job_from_fs(fs) < 0 && is_umount_fs(fs, types, optpattern))
+			add_umount_job(&sc, fs, -1, -1);
+	}
+	mnt_free_iter(itr);
+
+	rc = run_umount_jobs(cxt, &sc, FALSE);
+done:
+	free_umount_jobs(&sc);
+	mnt_unref_table(tb);
+	return rc;
+}
+
 static int umount_recursive(struct libmnt_context *cxt, const char *spec)
 {
 	struct libmnt_table *tb;
@@ -348,7 +698,7 @@ static int umount_recursive(struct libmnt_context *cxt, const char *spec)
 
 	fs = mnt_table_find_target(tb, spec, MNT_ITER_BACKWARD);
 	if (fs)
-		rc = umount_do_recurse(cxt, tb, fs);
+		rc = umount_tree(cxt, tb, fs);
 	else {
 		rc = MNT_EX_USAGE;
 		if (!quiet)
@@ -412,7 +762,7 @@ static int umount_alltargets(struct libmnt_context *cxt, const char *spec, int r
 			continue;
 		mnt_context_disable_swapmatch(cxt, 1);
 		if (rec)
-			rc = umount_do_recurse(cxt, tb, fs);
+			rc = umount_tree(cxt, tb, fs);
 		else
 			rc = umount_one_if_mounted(cxt, mnt_fs_get_target(fs));
 
@@ -462,10 +812,11 @@ int main(int argc, char **argv)
 {
 	int c, rc = 0, all = 0, recursive = 0, alltargets = 0;
 	struct libmnt_context *cxt;
-	char *types = NULL;
+	char *types = NULL, *optpattern = NULL;
 
 	enum {
 		UMOUNT_OPT_FAKE = CHAR_MAX + 1,
+		UMOUNT_OPT_PARALLEL
 	};
 
 	static const struct option longopts[] = {
@@ -479,6 +830,7 @@ int main(int argc, char **argv)
 		{ "lazy",            no_argument,       NULL, 'l'             },
 		{ "no-canonicalize", no_argument,       NULL, 'c'             },
 		{ "no-mtab",         no_argument,       NULL, 'n'             },
+		{ "parallel",        required_argument, NULL, UMOUNT_OPT_PARALLEL },
 		{ "quiet",           no_argument,       NULL, 'q'             },
 		{ "read-only",       no_argument,       NULL, 'r'             },
 		{ "recursive",       no_argument,       NULL, 'R'             },
@@ -571,6 +923,10 @@ int main(int argc, char **argv)
 		case 'O':
 			if (mnt_context_set_options_pattern(cxt, optarg))
 				err(MNT_EX_SYSERR, _("failed to set options pattern"));
+			optpattern = optarg;
+			break;
+		case UMOUNT_OPT_PARALLEL:
+			parallel = strtou32_or_err(optarg, _("invalid parallel argument"));
 			break;
 		case 't':
 			types = optarg;
@@ -614,7 +970,10 @@ int main(int argc, char **argv)
 			types = "noproc,nodevfs,nodevpts,nosysfs,norpc_pipefs,nonfsd,noselinuxfs";
 
 		mnt_context_set_fstype_pattern(cxt, types);
-		rc = umount_all(cxt);
+		if (parallel > 1)
+			rc = umount_all_parallel(cxt, types, optpattern);
+		else
+			rc = umount_all(cxt);
 
 	} else if (argc < 1) {
 		warnx(_("bad usage"));
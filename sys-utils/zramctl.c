@@ -321,13 +321,18 @@ static int zram_control_remove(struct zram *z)
 	return ul_path_write_u64(ctl, n, "hot_remove");
 }
 
-static struct zram *find_free_zram(void)
+/*
+ * Returns the first free device with number >= @from and updates @from to
+ * the next number, so the search for more devices does not start from
+ * zram0 again.
+ */
+static struct zram *find_free_zram(size_t *from)
 {
 	struct zram *z = new_zram(NULL);
 	size_t i;
 	int isfree = 0;
 
-	for (i = 0; isfree == 0; i++) {
+	for (i = *from; isfree == 0; i++) {
 		DBG(fprintf(stderr, "find free: checking zram%zu", i));
 		zram_set_devname(z, NULL, i);
 		if (!zram_exist(z) && zram_control_add(z) != 0)
@@ -337,10 +342,30 @@ static struct zram *find_free_zram(void)
 	if (!isfree) {
 		free_zram(z);
 		z = NULL;
-	}
+	} else
+		*from = zram_get_devnum(z) + 1;
 	return z;
 }
 
+static void zram_setup(struct zram *z, uintmax_t size, uintmax_t nstreams,
+		       const char *algorithm)
+{
+	if (zram_set_u64parm(z, "reset", 1))
+		err(EXIT_FAILURE, _("%s: failed to reset"), z->devname);
+
+	if (nstreams &&
+	    zram_set_u64parm(z, "max_comp_streams", nstreams))
+		err(EXIT_FAILURE, _("%s: failed to set number of streams"), z->devname);
+
+	if (algorithm &&
+	    zram_set_strparm(z, "comp_algorithm", algorithm))
+		err(EXIT_FAILURE, _("%s: failed to set algorithm"), z->devname);
+
+	if (zram_set_u64parm(z, "disksize", size))
+		err(EXIT_FAILURE, _("%s: failed to set disksize (%ju bytes)"),
+			z->devname, size);
+}
+
 static char *get_mm_stat(struct zram *z, size_t idx, int bytes)
 {
 	struct path_cxt *sysfs;
@@ -549,6 +574,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(USAGE_OPTIONS, out);
 	fputs(_(" -a, --algorithm <alg>     compression algorithm to use\n"), out);
 	fputs(_(" -b, --bytes               print sizes in bytes rather than in human readable format\n"), out);
+	fputs(_("     --count <number>      set up <number> free devices (with --find and --size)\n"), out);
 	fputs(_(" -f, --find                find a free device\n"), out);
 	fputs(_(" -n, --noheadings          don't print headings\n"), out);
 	fputs(_(" -o, --output <list>       columns to use for status output\n"), out);
@@ -586,19 +612,22 @@ enum {
 
 int main(int argc, char **argv)
 {
-	uintmax_t size = 0, nstreams = 0;
+	uintmax_t size = 0, nstreams = 0, count = 0, i;
+	size_t next = 0;
 	char *algorithm = NULL;
 	int rc = 0, c, find = 0, act = A_NONE;
 	struct zram *zram = NULL;
 
 	enum {
 		OPT_RAW = CHAR_MAX + 1,
-		OPT_LIST_TYPES
+		OPT_LIST_TYPES,
+		OPT_COUNT
 	};
 
 	static const struct option longopts[] = {
 		{ "algorithm", required_argument, NULL, 'a' },
 		{ "bytes",     no_argument, NULL, 'b' },
+		{ "count",     required_argument, NULL, OPT_COUNT },
 		{ "find",      no_argument, NULL, 'f' },
 		{ "help",      no_argument, NULL, 'h' },
 		{ "output",    required_argument, NULL, 'o' },
@@ -638,6 +667,11 @@ int main(int argc, char **argv)
 		case 'f':
 			find = 1;
 			break;
+		case OPT_COUNT:
+			count = strtou32_or_err(optarg, _("failed to parse count"));
+			if (!count)
+				errx(EXIT_FAILURE, _("count must be greater than zero"));
+			break;
 		case 'o':
 			ncolumns = string_to_idarray(optarg,
 						     columns, ARRAY_SIZE(columns),
@@ -688,6 +722,10 @@ int main(int argc, char **argv)
 		errx(EXIT_FAILURE, _("options --algorithm and --streams "
 				     "must be combined with --size"));
 
+	if (count && (act != A_CREATE || !find))
+		errx(EXIT_FAILURE, _("option --count must be combined with "
+				     "--find and --size"));
+
 	ul_path_init_debug();
 	ul_sysfs_init_debug();
 
@@ -727,7 +765,7 @@ int main(int argc, char **argv)
 		}
 		break;
 	case A_FINDONLY:
-		zram = find_free_zram();
+		zram = find_free_zram(&next);
 		if (!zram)
 			errx(EXIT_FAILURE, _("no free zram device found"));
 		printf("%s\n", zram->devname);
@@ -735,33 +773,24 @@ int main(int argc, char **argv)
 		break;
 	case A_CREATE:
 		if (find) {
-			zram = find_free_zram();
-			if (!zram)
-				errx(EXIT_FAILURE, _("no free zram device found"));
-		} else if (optind == argc)
-			errx(EXIT_FAILURE, _("no device specified"));
-		else {
-			zram = new_zram(argv[optind]);
-			if (!zram_exist(zram))
-				err(EXIT_FAILURE, "%s", zram->devname);
+			/* all the devices share the same settings */
+			for (i = 0; i < (count ? count : 1); i++) {
+				zram = find_free_zram(&next);
+				if (!zram)
+					errx(EXIT_FAILURE, _("no free zram device found"));
+				zram_setup(zram, size, nstreams, algorithm);
+				printf("%s\n", zram->devname);
+				free_zram(zram);
+			}
+			break;
 		}
+		if (optind == argc)
+			errx(EXIT_FAILURE, _("no device specified"));
 
-		if (zram_set_u64parm(zram, "reset", 1))
-			err(EXIT_FAILURE, _("%s: failed to reset"), zram->devname);
-
-		if (nstreams &&
-		    zram_set_u64parm(zram, "max_comp_streams", nstreams))
-			err(EXIT_FAILURE, _("%s: failed to set number of streams"), zram->devname);
-
-		if (algorithm &&
-		    zram_set_strparm(zram, "comp_algorithm", algorithm))
-			err(EXIT_FAILURE, _("%s: failed to set algorithm"), zram->devname);
-
-		if (zram_set_u64parm(zram, "disksize", size))
-			err(EXIT_FAILURE, _("%s: failed to set disksize (%ju bytes)"),
-				zram->devname, size);
-		if (find)
-			printf("%s\n", zram->devname);
+		zram = new_zram(argv[optind]);
+		if (!zram_exist(zram))
+			err(EXIT_FAILURE, "%s", zram->devname);
+		zram_setup(zram, size, nstreams, algorithm);
 		free_zram(zram);
 		break;
 	}
@@ -165,8 +165,18 @@ struct issue {
 #ifdef AGETTY_RELOAD
 	char *mem_old;
 #endif
+	/* system data for the escapes, read once per evaluation */
+	struct utsname uts;
+	struct ifaddrs *addrs;
+	char *hostname;
+	char *domain;
+
 	unsigned int do_tcsetattr : 1,
-		     do_tcrestore : 1;
+		     do_tcrestore : 1,
+		     has_uts : 1,
+		     has_addrs : 1,
+		     has_hostname : 1,
+		     has_domain : 1;
 };
 
 /*
@@ -343,6 +353,7 @@ static void reload_agettys(void);
 static void print_issue_file(struct issue *ie, struct options *op, struct termios *tp);
 static void eval_issue_file(struct issue *ie, struct options *op, struct termios *tp);
 static void show_issue(struct options *op);
+static void issue_reset_cache(struct issue *ie);
 
 
 /* Fake hostname for ut_host specified on command line. */
@@ -1991,6 +2002,8 @@ static void eval_issue_file(struct issue *ie,
 	issuedir_read(ie, _PATH_SYSCONFSTATICDIR "/" _PATH_ISSUE_DIRNAME, op, tp);
 
 done:
+	/* the next evaluation has to see the current state of the system */
+	issue_reset_cache(ie);
 
 #ifdef AGETTY_RELOAD
 	if (netlink_groups != 0)
@@ -2570,6 +2583,79 @@ static void log_warn(const char *fmt, ...)
 	va_end(ap);
 }
 
+/*
+ * The issue file (and all the files in issue.d) may use the same escapes
+ * many times; the data for them is read only once per evaluation of the
+ * issue, see issue_reset_cache().
+ */
+static struct utsname *issue_get_uts(struct issue *ie)
+{
+	if (!ie->has_uts) {
+		if (uname(&ie->uts) != 0)
+			memset(&ie->uts, 0, sizeof(ie->uts));
+		ie->has_uts = 1;
+	}
+	return &ie->uts;
+}
+
+static struct ifaddrs *issue_get_ifaddrs(struct issue *ie)
+{
+	if (!ie->has_addrs) {
+		if (getifaddrs(&ie->addrs) != 0)
+			ie->addrs = NULL;
+		ie->has_addrs = 1;
+	}
+	return ie->addrs;
+}
+
+static const char *issue_get_hostname(struct issue *ie)
+{
+	if (!ie->has_hostname) {
+		ie->hostname = xgethostname();
+		ie->has_hostname = 1;
+	}
+	return ie->hostname;
+}
+
+/* DNS domain (\O), the canonical name of the host is resolved only once */
+static const char *issue_get_domain(struct issue *ie)
+{
+	if (!ie->has_domain) {
+		const char *host = issue_get_hostname(ie);
+		struct addrinfo hints, *info = NULL;
+
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_flags = AI_CANONNAME;
+
+		if (host && getaddrinfo(host, NULL, &hints, &info) == 0 && info) {
+			char *canon;
+
+			if (info->ai_canonname &&
+			    (canon = strchr(info->ai_canonname, '.'))) {
+				ie->domain = strdup(canon + 1);
+				if (!ie->domain)
+					log_err(_("failed to allocate memory: %m"));
+			}
+		}
+		if (info)
+			freeaddrinfo(info);
+		ie->has_domain = 1;
+	}
+	return ie->domain;
+}
+
+static void issue_reset_cache(struct issue *ie)
+{
+	if (ie->addrs)
+		freeifaddrs(ie->addrs);
+	free(ie->hostname);
+	free(ie->domain);
+
+	ie->addrs = NULL;
+	ie->hostname = ie->domain = NULL;
+	ie->has_uts = ie->has_addrs = ie->has_hostname = ie->has_domain = 0;
+}
+
 static void print_addr(struct issue *ie, sa_family_t family, void *addr)
 {
 	char buff[INET6_ADDRSTRLEN + 1];
@@ -2590,7 +2676,7 @@ static void output_iface_ip(struct issue *ie,
 {
 	struct ifaddrs *p;
 	struct addrinfo hints, *info = NULL;
-	char *host = NULL;
+	const char *host;
 	void *addr = NULL;
 
 	if (!addrs)
@@ -2640,7 +2726,7 @@ static void output_iface_ip(struct issue *ie,
 	if (family == AF_INET6)
 		hints.ai_flags = AI_V4MAPPED;
 
-	host = xgethostname();
+	host = issue_get_hostname(ie);
 	if (host && getaddrinfo(host, NULL, &hints, &info) == 0 && info) {
 		switch (info->ai_family) {
 		case AF_INET:
@@ -2655,7 +2741,6 @@ static void output_iface_ip(struct issue *ie,
 
 		freeaddrinfo(info);
 	}
-	free(host);
 }
 
 /*
@@ -2691,8 +2776,6 @@ static void output_special_char(struct issue *ie,
 				struct termios *tp,
 				FILE *fp)
 {
-	struct utsname uts;
-
 	switch (c) {
 	case 'e':
 	{
@@ -2707,24 +2790,19 @@ static void output_special_char(struct issue *ie,
 		break;
 	}
 	case 's':
-		uname(&uts);
-		fprintf(ie->output, "%s", uts.sysname);
+		fputs(issue_get_uts(ie)->sysname, ie->output);
 		break;
 	case 'n':
-		uname(&uts);
-		fprintf(ie->output, "%s", uts.nodename);
+		fputs(issue_get_uts(ie)->nodename, ie->output);
 		break;
 	case 'r':
-		uname(&uts);
-		fprintf(ie->output, "%s", uts.release);
+		fputs(issue_get_uts(ie)->release, ie->output);
 		break;
 	case 'v':
-		uname(&uts);
-		fprintf(ie->output, "%s", uts.version);
+		fputs(issue_get_uts(ie)->version, ie->output);
 		break;
 	case 'm':
-		uname(&uts);
-		fprintf(ie->output, "%s", uts.machine);
+		fputs(issue_get_uts(ie)->machine, ie->output);
 		break;
 	case 'o':
 	{
@@ -2736,24 +2814,9 @@ static void output_special_char(struct issue *ie,
 	}
 	case 'O':
 	{
-		char *dom = NULL;
-		char *host = xgethostname();
-		struct addrinfo hints, *info = NULL;
-
-		memset(&hints, 0, sizeof(hints));
-		hints.ai_flags = AI_CANONNAME;
-
-		if (host && getaddrinfo(host, NULL, &hints, &info) == 0 && info) {
-			char *canon;
+		const char *dom = issue_get_domain(ie);
 
-			if (info->ai_canonname &&
-			    (canon = strchr(info->ai_canonname, '.')))
-				dom = canon + 1;
-		}
 		fputs(dom ? dom : "unknown_domain", ie->output);
-		if (info)
-			freeaddrinfo(info);
-		free(host);
 		break;
 	}
 	case 'd':
@@ -2812,8 +2875,7 @@ static void output_special_char(struct issue *ie,
 
 		/* \S and PRETTY_NAME not found */
 		} else {
-			uname(&uts);
-			fputs(uts.sysname, ie->output);
+			fputs(issue_get_uts(ie)->sysname, ie->output);
 		}
 
 		free(var);
@@ -2841,10 +2903,10 @@ static void output_special_char(struct issue *ie,
 	case '6':
 	{
 		sa_family_t family = c == '4' ? AF_INET : AF_INET6;
-		struct ifaddrs *addrs = NULL;
+		struct ifaddrs *addrs = issue_get_ifaddrs(ie);
 		char iface[128];
 
-		if (getifaddrs(&addrs))
+		if (!addrs)
 			break;
 
 		if (get_escape_argument(fp, iface, sizeof(iface)))
@@ -2852,8 +2914,6 @@ static void output_special_char(struct issue *ie,
 		else
 			output_iface_ip(ie, addrs, NULL, family);
 
-		freeifaddrs(addrs);
-
 		if (c == '4')
 			netlink_groups |= RTMGRP_IPV4_IFADDR;
 		else
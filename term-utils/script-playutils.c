@@ -8,6 +8,7 @@
 #include <math.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 
 #include "c.h"
 #include "xalloc.h"
@@ -39,10 +40,28 @@ struct replay_log {
 	const char	*streams;	/* 'I'nput, 'O'utput or both */
 	const char	*filename;
 	FILE		*fp;
+	off_t		skip;		/* data to skip by replay_seek() */
 
 	unsigned int	noseek : 1;	/* do not seek in this log */
 };
 
+/*
+ * The seek index is a list of positions in the timing file (marks), each
+ * with the session time and offsets in the data logs at the position. A
+ * mark is added every REPLAY_INDEX_TIME seconds of the session time or
+ * every REPLAY_INDEX_STEPS steps, so replay_seek() parses a few thousands
+ * of timing entries at most.
+ */
+#define REPLAY_INDEX_TIME	10
+#define REPLAY_INDEX_STEPS	4096
+#define REPLAY_INDEX_MAGIC	"scriptreplay-index"
+
+struct replay_mark {
+	struct timeval	time;		/* session time at the mark */
+	int		line;		/* timing file line */
+	off_t		offset;		/* timing file offset */
+};
+
 struct replay_step {
 	char	type;		/* 'I'nput, 'O'utput, ... */
 	size_t	size;
@@ -64,6 +83,11 @@ struct replay_setup {
 	const char		*timing_filename;
 	int			timing_format;
 	int			timing_line;
+	struct timeval		elapsed;	/* session time of all read steps */
+
+	struct replay_mark	*marks;		/* seek index */
+	off_t			*marks_offs;	/* data logs offsets, nlogs per mark */
+	size_t			nmarks;
 
 	struct timeval		delay_max;
 	struct timeval		delay_min;
@@ -111,6 +135,8 @@ void replay_free_setup(struct replay_setup *stp)
 		return;
 
 	free(stp->logs);
+	free(stp->marks);
+	free(stp->marks_offs);
 	free(stp->step.name);
 	free(stp->step.value);
 	free(stp);
@@ -378,6 +404,47 @@ static int replay_seek_log(struct replay_log *log, size_t move)
 	return fseek(log->fp, move, SEEK_CUR) == (off_t) -1 ? -errno : 0;
 }
 
+/* reads the next timing entry; returns: 0 = success, <0 = error, 1 = EOF */
+static int replay_read_step(struct replay_setup *stp, struct replay_step *step)
+{
+	int rc = 1;
+
+	if (feof(stp->timing_fp))
+		return 1;
+
+	DBG(TIMING, ul_debug("reading next step"));
+
+	replay_reset_step(step);
+	stp->timing_line++;
+
+	switch (stp->timing_format) {
+	case REPLAY_TIMING_SIMPLE:
+		/* old format is the same as new format, but without <type> prefix */
+		rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
+		if (rc == 0)
+			step->type = stp->default_type;
+		break;
+	case REPLAY_TIMING_MULTI:
+		rc = fscanf(stp->timing_fp, "%c ", &step->type);
+		if (rc != 1)
+			rc = -EINVAL;
+		else
+			rc = read_multistream_step(step,
+					stp->timing_fp,
+					step->type);
+		break;
+	}
+
+	if (rc) {
+		if (rc < 0 && feof(stp->timing_fp))
+			rc = 1;
+		return rc;	/* error or EOF */
+	}
+
+	timerinc(&stp->elapsed, &step->delay);
+	return 0;
+}
+
 /* returns next step with pointer to the right log file for specified streams (e.g.
  * "IOS" for in/out/signals) or all streams if stream is NULL.
  *
@@ -401,38 +468,9 @@ int replay_get_next_step(struct replay_setup *stp, char *streams, struct replay_
 	do {
 		struct replay_log *log = NULL;
 
-		rc = 1;	/* done */
-		if (feof(stp->timing_fp))
-			break;
-
-		DBG(TIMING, ul_debug("reading next step"));
-
-		replay_reset_step(step);
-		stp->timing_line++;
-
-		switch (stp->timing_format) {
-		case REPLAY_TIMING_SIMPLE:
-			/* old format is the same as new format, but without <type> prefix */
-			rc = read_multistream_step(step, stp->timing_fp, stp->default_type);
-			if (rc == 0)
-				step->type = stp->default_type;
-			break;
-		case REPLAY_TIMING_MULTI:
-			rc = fscanf(stp->timing_fp, "%c ", &step->type);
-			if (rc != 1)
-				rc = -EINVAL;
-			else
-				rc = read_multistream_step(step,
-						stp->timing_fp,
-						step->type);
-			break;
-		}
-
-		if (rc) {
-			if (rc < 0 && feof(stp->timing_fp))
-				rc = 1;
+		rc = replay_read_step(stp, step);
+		if (rc)
 			break;		/* error or EOF */
-		}
 
 		DBG(TIMING, ul_debug(" step entry is '%c'", step->type));
 
@@ -491,6 +529,300 @@ done:
 	return rc;
 }
 
+static void replay_add_mark(struct replay_setup *stp, const off_t *offs, off_t offset)
+{
+	struct replay_mark *m;
+
+	if (stp->nmarks % 256 == 0) {
+		stp->marks = xrealloc(stp->marks,
+				(stp->nmarks + 256) * sizeof(*m));
+		stp->marks_offs = xrealloc(stp->marks_offs,
+				(stp->nmarks + 256) * stp->nlogs * sizeof(off_t));
+	}
+	m = &stp->marks[stp->nmarks];
+	m->time = stp->elapsed;
+	m->line = stp->timing_line;
+	m->offset = offset;
+	memcpy(&stp->marks_offs[stp->nmarks * stp->nlogs], offs,
+			stp->nlogs * sizeof(off_t));
+	stp->nmarks++;
+}
+
+/*
+ * Reads the whole timing file and creates the seek index. The data logs are
+ * not read. It has to be called before the first replay_get_next_step().
+ */
+int replay_build_index(struct replay_setup *stp)
+{
+	struct replay_step *step = &stp->step;
+	struct timeval last = { 0 }, interval = { .tv_sec = REPLAY_INDEX_TIME };
+	size_t i, nsteps = 0;
+	off_t *offs;
+	int rc;
+
+	assert(stp);
+	assert(stp->timing_fp);
+	assert(stp->timing_line == 0);
+
+	free(stp->marks);
+	free(stp->marks_offs);
+	stp->marks = NULL;
+	stp->marks_offs = NULL;
+	stp->nmarks = 0;
+
+	offs = xcalloc(stp->nlogs ? stp->nlogs : 1, sizeof(off_t));
+	for (i = 0; i < stp->nlogs; i++) {
+		if (!stp->logs[i].noseek)
+			offs[i] = ftello(stp->logs[i].fp);
+	}
+
+	do {
+		struct timeval next;
+
+		timeradd(&last, &interval, &next);
+		if (!stp->nmarks || nsteps >= REPLAY_INDEX_STEPS
+		    || !timercmp(&stp->elapsed, &next, <)) {
+			replay_add_mark(stp, offs, ftello(stp->timing_fp));
+			last = stp->elapsed;
+			nsteps = 0;
+		}
+
+		rc = replay_read_step(stp, step);
+		if (rc == 0) {
+			struct replay_log *log = replay_get_stream_log(stp, step->type);
+
+			if (log && !log->noseek)
+				offs[log - stp->logs] += step->size;
+			nsteps++;
+		}
+	} while (rc == 0);
+
+	free(offs);
+
+	DBG(TIMING, ul_debug("index: %zu marks for %d lines [rc=%d]",
+				stp->nmarks, stp->timing_line, rc));
+	return rc < 0 ? rc : 0;
+}
+
+/*
+ * The index file starts with a header line with the timing file size and
+ * mtime and the streams of the data logs, followed by a line for each mark:
+ *
+ *	<time> <line> <offset> <log offset> ...
+ */
+int replay_save_index(struct replay_setup *stp, const char *filename)
+{
+	struct stat st;
+	size_t i, j;
+	FILE *f;
+
+	assert(stp);
+	assert(filename);
+
+	if (fstat(fileno(stp->timing_fp), &st) != 0)
+		return -errno;
+
+	f = fopen(filename, "w" UL_CLOEXECSTR);
+	if (!f)
+		return -errno;
+
+	fprintf(f, "%s %jd %jd %zu", REPLAY_INDEX_MAGIC,
+			(intmax_t) st.st_size, (intmax_t) st.st_mtime, stp->nlogs);
+	for (i = 0; i < stp->nlogs; i++)
+		fprintf(f, " %s", stp->logs[i].streams);
+	fputc('\n', f);
+
+	for (i = 0; i < stp->nmarks; i++) {
+		struct replay_mark *m = &stp->marks[i];
+
+		fprintf(f, "%"PRId64".%06"PRId64" %d %jd",
+				(int64_t) m->time.tv_sec, (int64_t) m->time.tv_usec,
+				m->line, (intmax_t) m->offset);
+		for (j = 0; j < stp->nlogs; j++)
+			fprintf(f, " %jd", (intmax_t) stp->marks_offs[i * stp->nlogs + j]);
+		fputc('\n', f);
+	}
+
+	if (close_stream(f) != 0)
+		return -errno;
+
+	DBG(TIMING, ul_debug("index saved to %s", filename));
+	return 0;
+}
+
+/*
+ * Reads the seek index from @filename. Returns -EINVAL if the index does not
+ * match the timing file or the data logs.
+ */
+int replay_load_index(struct replay_setup *stp, const char *filename)
+{
+	char magic[sizeof(REPLAY_INDEX_MAGIC)], streams[8];
+	intmax_t size, mtime, offset;
+	struct stat st;
+	off_t *offs = NULL;
+	size_t i, nlogs;
+	int rc = 0;
+	FILE *f;
+
+	assert(stp);
+	assert(filename);
+
+	if (fstat(fileno(stp->timing_fp), &st) != 0)
+		return -errno;
+
+	f = fopen(filename, "r" UL_CLOEXECSTR);
+	if (!f)
+		return -errno;
+
+	if (fscanf(f, "%18s %jd %jd %zu", magic, &size, &mtime, &nlogs) != 4
+	    || strcmp(magic, REPLAY_INDEX_MAGIC) != 0
+	    || size != (intmax_t) st.st_size
+	    || mtime != (intmax_t) st.st_mtime
+	    || nlogs != stp->nlogs) {
+		rc = -EINVAL;
+		goto done;
+	}
+	for (i = 0; i < nlogs; i++) {
+		if (fscanf(f, "%7s", streams) != 1
+		    || strcmp(streams, stp->logs[i].streams) != 0) {
+			rc = -EINVAL;
+			goto done;
+		}
+	}
+
+	stp->nmarks = 0;
+	offs = xcalloc(nlogs ? nlogs : 1, sizeof(off_t));
+
+	for (;;) {
+		int64_t sec, usec;
+		int line;
+
+		rc = fscanf(f, "%"SCNd64".%06"SCNd64" %d %jd",
+				&sec, &usec, &line, &offset);
+		if (rc == EOF)
+			break;
+		if (rc != 4) {
+			rc = -EINVAL;
+			goto done;
+		}
+		for (i = 0; i < nlogs; i++) {
+			intmax_t x;
+
+			if (fscanf(f, "%jd", &x) != 1) {
+				rc = -EINVAL;
+				goto done;
+			}
+			offs[i] = x;
+		}
+		stp->elapsed.tv_sec = (time_t) sec;
+		stp->elapsed.tv_usec = (suseconds_t) usec;
+		stp->timing_line = line;
+		replay_add_mark(stp, offs, offset);
+	}
+	rc = stp->nmarks ? 0 : -EINVAL;
+done:
+	if (rc)
+		stp->nmarks = 0;
+	/* the position is still at the begin of the timing file */
+	stp->timing_line = 0;
+	timerclear(&stp->elapsed);
+
+	free(offs);
+	fclose(f);
+
+	DBG(TIMING, ul_debug("index: %zu marks loaded from %s [rc=%d]",
+				stp->nmarks, filename, rc));
+	return rc;
+}
+
+/*
+ * Moves to the first step which starts at or after session time @tv. The
+ * data of the skipped steps are not read. The seek index is used to jump
+ * close to @tv if available.
+ */
+int replay_seek(struct replay_setup *stp, const struct timeval *tv)
+{
+	struct replay_step *step = &stp->step;
+	size_t i;
+	int rc;
+
+	assert(stp);
+	assert(stp->timing_fp);
+	assert(tv);
+
+	if (stp->nmarks) {
+		struct replay_mark *m;
+		size_t lo = 0, hi = stp->nmarks;
+
+		/* the last mark before @tv (or the first one) */
+		while (hi - lo > 1) {
+			size_t mid = (lo + hi) / 2;
+
+			if (timercmp(&stp->marks[mid].time, tv, <))
+				lo = mid;
+			else
+				hi = mid;
+		}
+		m = &stp->marks[lo];
+
+		if (m->line > stp->timing_line || timercmp(&stp->elapsed, tv, >)) {
+			const off_t *offs = &stp->marks_offs[lo * stp->nlogs];
+
+			DBG(TIMING, ul_debug("seek: jump to line %d", m->line));
+
+			if (fseeko(stp->timing_fp, m->offset, SEEK_SET) != 0)
+				return -errno;
+			for (i = 0; i < stp->nlogs; i++) {
+				struct replay_log *log = &stp->logs[i];
+
+				if (log->noseek)
+					continue;
+				if (fseeko(log->fp, offs[i], SEEK_SET) != 0)
+					return -errno;
+			}
+			stp->timing_line = m->line;
+			stp->elapsed = m->time;
+		}
+	}
+
+	do {
+		struct timeval elapsed = stp->elapsed;
+		off_t offset = ftello(stp->timing_fp);
+		struct replay_log *log;
+
+		rc = replay_read_step(stp, step);
+		if (rc)
+			break;
+
+		if (!timercmp(&stp->elapsed, tv, <)) {
+			/* the step is wanted, read it again by replay_get_next_step() */
+			if (fseeko(stp->timing_fp, offset, SEEK_SET) != 0)
+				return -errno;
+			stp->timing_line--;
+			stp->elapsed = elapsed;
+			break;
+		}
+
+		log = replay_get_stream_log(stp, step->type);
+		if (log && !log->noseek)
+			log->skip += step->size;
+	} while (rc == 0);
+
+	for (i = 0; i < stp->nlogs; i++) {
+		struct replay_log *log = &stp->logs[i];
+
+		if (!log->skip)
+			continue;
+		DBG(LOG, ul_debug(" %s: seek ++ %jd", log->filename, (intmax_t) log->skip));
+		if (fseeko(log->fp, log->skip, SEEK_CUR) != 0)
+			return -errno;
+		log->skip = 0;
+	}
+
+	DBG(TIMING, ul_debug("seek done: line %d [rc=%d]", stp->timing_line, rc));
+	return rc < 0 ? rc : 0;
+}
+
 /* return: 0 = success, <0 = error, 1 = done (EOF) */
 int replay_emit_step_data(struct replay_setup *stp, struct replay_step *step, int fd)
 {
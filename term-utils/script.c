@@ -88,6 +88,14 @@ UL_DEBUG_DEFINE_MASKNAMES(script) = UL_DEBUG_EMPTY_MASKNAMES;
 
 #define DEFAULT_TYPESCRIPT_FILENAME "typescript"
 
+/*
+ * The logs are written to large stdio buffers; the buffers are flushed when
+ * full and at latest SCRIPT_FLUSH_INTERVAL seconds after the first unflushed
+ * write (unless --flush is specified).
+ */
+#define SCRIPT_LOG_BUFSIZ	(256 * 1024)
+#define SCRIPT_FLUSH_INTERVAL	1
+
 /*
  * Script is driven by stream (stdout/stdin) activity. It's possible to
  * associate arbitrary number of log files with the stream. We have two basic
@@ -107,6 +115,7 @@ struct script_log {
 	FILE	*fp;			/* file pointer (handler) */
 	int	format;			/* SCRIPT_FMT_* */
 	char	*filename;		/* on command line specified name */
+	char	*buf;			/* stdio buffer */
 	struct timeval oldtime;		/* previous entry log time (SCRIPT_FMT_TIMING_* only) */
 	struct timeval starttime;
 
@@ -142,6 +151,7 @@ struct script_control {
 	 append:1,		/* append output */
 	 rc_wanted:1,		/* return child exit value */
 	 flush:1,		/* flush after each write */
+	 flush_pending:1,	/* flush timer is set */
 	 quiet:1,		/* suppress most output */
 	 force:1,		/* write output to links */
 	 isterm:1;		/* is child process running as terminal */
@@ -322,6 +332,7 @@ static int log_close(struct script_control *ctl,
 	}
 
 	free(log->filename);
+	free(log->buf);
 	memset(log, 0, sizeof(*log));
 
 	return rc;
@@ -385,6 +396,11 @@ static int log_start(struct script_control *ctl,
 		return -errno;
 	}
 
+	if (!ctl->flush) {
+		log->buf = xmalloc(SCRIPT_LOG_BUFSIZ);
+		setvbuf(log->fp, log->buf, _IOFBF, SCRIPT_LOG_BUFSIZ);
+	}
+
 	/* write header, etc. */
 	switch (log->format) {
 	case SCRIPT_FMT_RAW:
@@ -498,6 +514,15 @@ static ssize_t log_write(struct script_control *ctl,
 
 	if (ctl->flush)
 		fflush(log->fp);
+	else if (!ctl->flush_pending && ctl->child > 0) {
+		/* flush the logs by callback_mainloop() later */
+		struct timeval tv = { .tv_sec = SCRIPT_FLUSH_INTERVAL };
+
+		gettime_monotonic(&now);
+		timeradd(&now, &tv, &tv);
+		ul_pty_set_mainloop_time(ctl->pty, &tv);
+		ctl->flush_pending = 1;
+	}
 	return ssz;
 }
 
@@ -734,6 +759,18 @@ static int callback_flush_logs(void *data)
 	return 0;
 }
 
+static int callback_mainloop(void *data)
+{
+	struct script_control *ctl = (struct script_control *) data;
+
+	DBG(IO, ul_debug("flush timeout"));
+
+	ul_pty_set_mainloop_time(ctl->pty, NULL);
+	ctl->flush_pending = 0;
+
+	return callback_flush_logs(data);
+}
+
 static void die_if_link(struct script_control *ctl, const char *filename)
 {
 	struct stat s;
@@ -926,6 +963,7 @@ int main(int argc, char **argv)
 	cb->log_stream_activity = callback_log_stream_activity;
 	cb->log_signal = callback_log_signal;
 	cb->flush_logs = callback_flush_logs;
+	cb->mainloop = callback_mainloop;
 
 	if (!ctl.quiet) {
 		printf(_("Script started"));
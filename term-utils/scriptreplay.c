@@ -65,6 +65,8 @@ usage(void)
 	fputs(USAGE_SEPARATOR, out);
 	fputs(_("     --summary           display overview about recorded session and exit\n"), out);
 	fputs(_(" -d, --divisor <num>     speed up or slow down execution with time divisor\n"), out);
+	fputs(_("     --seek <num>        start the replay at this many seconds of the session\n"), out);
+	fputs(_("     --index <file>      use (or create) seek index file\n"), out);
 	fputs(_(" -m, --maxdelay <num>    wait at most this many seconds between updates\n"), out);
 	fputs(_(" -x, --stream <name>     stream type (out, in, signal or info)\n"), out);
 	fputs(_(" -c, --cr-mode <type>    CR char mode (auto, never, always)\n"), out);
@@ -142,7 +144,7 @@ int
 main(int argc, char *argv[])
 {
 	static const struct timeval mindelay = { .tv_sec = 0, .tv_usec = 100 };
-	struct timeval maxdelay;
+	struct timeval maxdelay, seek;
 
 	int isterm;
 	struct termios saved;
@@ -153,12 +155,15 @@ main(int argc, char *argv[])
 	const char *log_out = NULL,
 	           *log_in = NULL,
 		   *log_io = NULL,
-		   *log_tm = NULL;
+		   *log_tm = NULL,
+		   *index = NULL;
 	double divi = 1;
 	int diviopt = FALSE, idx;
 	int ch, rc, crmode = REPLAY_CRMODE_AUTO, summary = 0;
 	enum {
-		OPT_SUMMARY = CHAR_MAX + 1
+		OPT_SUMMARY = CHAR_MAX + 1,
+		OPT_SEEK,
+		OPT_INDEX
 	};
 
 	static const struct option longopts[] = {
@@ -173,6 +178,8 @@ main(int argc, char *argv[])
 		{ "maxdelay",	required_argument,	0, 'm' },
 		{ "stream",     required_argument,	0, 'x' },
 		{ "summary",    no_argument,            0, OPT_SUMMARY },
+		{ "seek",       required_argument,      0, OPT_SEEK },
+		{ "index",      required_argument,      0, OPT_INDEX },
 		{ "version",	no_argument,		0, 'V' },
 		{ "help",	no_argument,		0, 'h' },
 		{ NULL,		0, 0, 0 }
@@ -195,6 +202,7 @@ main(int argc, char *argv[])
 
 	replay_init_debug();
 	timerclear(&maxdelay);
+	timerclear(&seek);
 
 	while ((ch = getopt_long(argc, argv, "B:c:I:O:T:t:s:d:m:x:Vh", longopts, NULL)) != -1) {
 
@@ -247,6 +255,12 @@ main(int argc, char *argv[])
 		case OPT_SUMMARY:
 			summary = 1;
 			break;
+		case OPT_SEEK:
+			strtotimeval_or_err(optarg, &seek, _("failed to parse seek argument"));
+			break;
+		case OPT_INDEX:
+			index = optarg;
+			break;
 		case 'V':
 			print_version(EXIT_SUCCESS);
 		case 'h':
@@ -307,6 +321,17 @@ main(int argc, char *argv[])
 		replay_set_delay_max(setup, &maxdelay);
 	replay_set_delay_min(setup, &mindelay);
 
+	if (index && replay_load_index(setup, index) != 0) {
+		if (replay_build_index(setup) != 0)
+			err(EXIT_FAILURE, _("%s: line %d: timing file error"),
+					replay_get_timing_file(setup),
+					replay_get_timing_line(setup));
+		if (replay_save_index(setup, index) != 0)
+			warn(_("cannot write %s"), index);
+	}
+	if ((index || timerisset(&seek)) && replay_seek(setup, &seek) != 0)
+		err(EXIT_FAILURE, _("%s: seek failed"), replay_get_timing_file(setup));
+
 	isterm = setterm(&saved);
 
 	do {
@@ -52,35 +52,27 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <poll.h>
 
 #include "nls.h"
 #include "closestream.h"
 #include "pathnames.h"
+#include "xalloc.h"
+#include "monotonic.h"
 #include "ttymsg.h"
 
 #define ERR_BUFLEN	(MAXNAMLEN + 1024)
 
 /*
- * Display the contents of a uio structure on a terminal.  Used by wall(1),
- * syslogd(8), and talkd(8).  Forks and finishes in child if write would block,
- * waiting up to tmout seconds.  Returns pointer to error string on unexpected
- * error; string is not newline-terminated.  Various "normal" errors are
- * ignored (exclusive-use, lack of permission, etc.).
+ * Opens the terminal for non-blocking writes. Returns pointer to error
+ * string, or NULL and @fd < 0 if the terminal is ignored.
  */
-char *
-ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
-	static char device[MAXNAMLEN];
-	static char errbuf[ERR_BUFLEN];
-	size_t cnt, left;
-	ssize_t wret;
-	struct iovec localiov[6];
-	int fd, forked = 0;
-	ssize_t	len = 0;
+static char *open_tty(const char *line, char *device, size_t devsz,
+		      char *errbuf, size_t errsz, int *fd)
+{
+	ssize_t len;
 
-	if (iovcnt > ARRAY_SIZE(localiov)) {
-		snprintf(errbuf, sizeof(errbuf), _("internal error: too many iov's"));
-		return errbuf;
-	}
+	*fd = -1;
 
 	/* The old code here rejected the line argument when it contained a '/',
 	   saying: "A slash may be an attempt to break security...".
@@ -89,9 +81,9 @@ ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
 	   already. So, this test was worthless, and these days it is
 	   also wrong since people use /dev/pts/xxx. */
 
-	len = snprintf(device, sizeof(device), "%s%s", _PATH_DEV, line);
-	if (len < 0 || (size_t)len >= sizeof(device)) {
-		snprintf(errbuf, sizeof(errbuf), _("excessively long line arg"));
+	len = snprintf(device, devsz, "%s%s", _PATH_DEV, line);
+	if (len < 0 || (size_t)len >= devsz) {
+		snprintf(errbuf, errsz, _("excessively long line arg"));
 		return errbuf;
 	}
 
@@ -99,15 +91,44 @@ ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
 	 * open will fail on slip lines or exclusive-use lines
 	 * if not running as root; not an error.
 	 */
-	if ((fd = open(device, O_WRONLY|O_NONBLOCK, 0)) < 0) {
+	if ((*fd = open(device, O_WRONLY|O_NONBLOCK, 0)) < 0) {
 		if (errno == EBUSY || errno == EACCES)
 			return NULL;
 
-		len = snprintf(errbuf, sizeof(errbuf), "%s: %m", device);
-		if (len < 0 || (size_t)len >= sizeof(errbuf))
-			snprintf(errbuf, sizeof(errbuf), _("open failed"));
+		len = snprintf(errbuf, errsz, "%s: %m", device);
+		if (len < 0 || (size_t)len >= errsz)
+			snprintf(errbuf, errsz, _("open failed"));
 		return errbuf;
 	}
+	return NULL;
+}
+
+/*
+ * Display the contents of a uio structure on a terminal.  Used by wall(1),
+ * syslogd(8), and talkd(8).  Forks and finishes in child if write would block,
+ * waiting up to tmout seconds.  Returns pointer to error string on unexpected
+ * error; string is not newline-terminated.  Various "normal" errors are
+ * ignored (exclusive-use, lack of permission, etc.).
+ */
+char *
+ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
+	static char device[MAXNAMLEN];
+	static char errbuf[ERR_BUFLEN];
+	size_t cnt, left;
+	ssize_t wret;
+	struct iovec localiov[6];
+	int fd, forked = 0;
+	ssize_t	len = 0;
+	char *errmsg;
+
+	if (iovcnt > ARRAY_SIZE(localiov)) {
+		snprintf(errbuf, sizeof(errbuf), _("internal error: too many iov's"));
+		return errbuf;
+	}
+
+	if ((errmsg = open_tty(line, device, sizeof(device),
+			       errbuf, sizeof(errbuf), &fd)) || fd < 0)
+		return errmsg;
 
 	for (cnt = left = 0; cnt < iovcnt; ++cnt)
 		left += iov[cnt].iov_len;
@@ -190,3 +211,180 @@ ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout) {
 		_exit(EXIT_SUCCESS);
 	return NULL;
 }
+
+/*
+ * Broadcast of the same message to many terminals. The message is written
+ * by non-blocking writes; the terminals which are not able to get the whole
+ * message at once are kept in the queue. ttymsg_queue_finish() forks one
+ * process for all of them which polls the terminals and writes the rest of
+ * the message, waiting up to tmout seconds for each terminal.
+ */
+void ttymsg_init_queue(struct ttymsg_queue *q, const char *msg, size_t len,
+		       int tmout)
+{
+	long max = sysconf(_SC_OPEN_MAX);
+
+	memset(q, 0, sizeof(*q));
+	q->msg = msg;
+	q->len = len;
+	q->tmout = tmout;
+
+	/* keep some descriptors for the rest of the program */
+	q->max = max > 64 ? (size_t) max - 32 : 32;
+}
+
+static void queue_remove(struct ttymsg_queue *q, size_t i)
+{
+	close(q->ttys[i].fd);
+	free(q->ttys[i].device);
+	q->ttys[i] = q->ttys[--q->nttys];
+}
+
+/*
+ * Writes the rest of the message to the terminal. Returns 1 when the
+ * terminal is done (or failed), 0 when it would block.
+ */
+static int queue_write(struct ttymsg_queue *q, struct ttymsg_tty *tty)
+{
+	while (tty->done < q->len) {
+		ssize_t wret = write(tty->fd, q->msg + tty->done,
+				     q->len - tty->done);
+		if (wret >= 0) {
+			tty->done += wret;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == EWOULDBLOCK)
+			return 0;
+		/*
+		 * We get ENODEV on a slip line if we're running as root,
+		 * and EIO if the line just went away.
+		 */
+		if (errno != ENODEV && errno != EIO)
+			warn("%s", tty->device);
+		break;
+	}
+	return 1;
+}
+
+/* waits for all queued terminals, up to the timeout for each one */
+static void queue_wait(struct ttymsg_queue *q)
+{
+	struct pollfd *fds = xcalloc(q->nttys, sizeof(*fds));
+
+	while (q->nttys) {
+		struct timeval now;
+		int tmout = -1, rc;
+		size_t i;
+
+		gettime_monotonic(&now);
+
+		for (i = 0; i < q->nttys; ) {
+			struct ttymsg_tty *tty = &q->ttys[i];
+			int ms;
+
+			if (!timercmp(&now, &tty->deadline, <)) {
+				queue_remove(q, i);	/* timeout, drop it */
+				continue;
+			}
+			ms = (tty->deadline.tv_sec - now.tv_sec) * 1000
+			     + (tty->deadline.tv_usec - now.tv_usec) / 1000 + 1;
+			if (tmout < 0 || ms < tmout)
+				tmout = ms;
+
+			fds[i].fd = tty->fd;
+			fds[i].events = POLLOUT;
+			fds[i].revents = 0;
+			i++;
+		}
+		if (!q->nttys)
+			break;
+
+		rc = poll(fds, q->nttys, tmout);
+		if (rc < 0 && errno != EINTR)
+			break;
+		if (rc <= 0)
+			continue;
+
+		/* remove from the end, queue_remove() moves the last entry */
+		for (i = q->nttys; i > 0; i--) {
+			if (fds[i - 1].revents && queue_write(q, &q->ttys[i - 1]))
+				queue_remove(q, i - 1);
+		}
+	}
+
+	while (q->nttys)
+		queue_remove(q, 0);
+	free(fds);
+}
+
+/*
+ * Like ttymsg(), but the message is queued if the terminal is not able
+ * to get it at once.
+ */
+char *ttymsg_queue_add(struct ttymsg_queue *q, char *line)
+{
+	static char device[MAXNAMLEN];
+	static char errbuf[ERR_BUFLEN];
+	struct ttymsg_tty *tty;
+	char *errmsg;
+	int fd;
+
+	if (q->nttys >= q->max)
+		ttymsg_queue_finish(q);
+
+	if ((errmsg = open_tty(line, device, sizeof(device),
+			       errbuf, sizeof(errbuf), &fd)) || fd < 0)
+		return errmsg;
+
+	if (q->nttys == q->alloc) {
+		q->alloc = q->alloc ? q->alloc * 2 : 64;
+		q->ttys = xrealloc(q->ttys, q->alloc * sizeof(*tty));
+	}
+	tty = &q->ttys[q->nttys];
+	tty->fd = fd;
+	tty->done = 0;
+	tty->device = device;
+
+	if (queue_write(q, tty)) {
+		close(fd);
+		return NULL;
+	}
+
+	gettime_monotonic(&tty->deadline);
+	tty->deadline.tv_sec += q->tmout;
+	tty->device = xstrdup(device);
+	q->nttys++;
+	return NULL;
+}
+
+void ttymsg_queue_finish(struct ttymsg_queue *q)
+{
+	if (q->nttys) {
+		pid_t pid = fork();
+
+		if (pid == 0) {
+			sigset_t sigmask;
+
+			signal(SIGTERM, SIG_DFL); /* XXX */
+			sigemptyset(&sigmask);
+			sigprocmask(SIG_SETMASK, &sigmask, NULL);
+
+			queue_wait(q);
+			_exit(EXIT_SUCCESS);
+		}
+		if (pid < 0)
+			queue_wait(q);	/* fork failed, wait here */
+
+		while (q->nttys)
+			queue_remove(q, 0);
+	}
+}
+
+void ttymsg_free_queue(struct ttymsg_queue *q)
+{
+	ttymsg_queue_finish(q);
+	free(q->ttys);
+	memset(q, 0, sizeof(*q));
+}
@@ -1,6 +1,33 @@
 #ifndef UTIL_LINUX_TERM_TTYMSG_H
 #define UTIL_LINUX_TERM_TTYMSG_H
 
+#include <sys/time.h>
+#include <sys/uio.h>
+
 char *ttymsg(struct iovec *iov, size_t iovcnt, char *line, int tmout);
 
+struct ttymsg_tty {
+	int		fd;
+	size_t		done;		/* already written bytes */
+	struct timeval	deadline;	/* give up at this (monotonic) time */
+	char		*device;
+};
+
+struct ttymsg_queue {
+	const char	*msg;
+	size_t		len;
+	int		tmout;		/* in seconds */
+
+	struct ttymsg_tty *ttys;	/* terminals which would block */
+	size_t		nttys;
+	size_t		alloc;
+	size_t		max;		/* max number of open terminals */
+};
+
+void ttymsg_init_queue(struct ttymsg_queue *q, const char *msg, size_t len,
+		       int tmout);
+char *ttymsg_queue_add(struct ttymsg_queue *q, char *line);
+void ttymsg_queue_finish(struct ttymsg_queue *q);
+void ttymsg_free_queue(struct ttymsg_queue *q);
+
 #endif /* UTIL_LINUX_TERM_TTYMSG_H */
@@ -1,16 +1,126 @@
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "md5.h"
 
-int main(void)
+static void print_digest(const unsigned char *digest)
 {
-	int i, ret;
+	int i;
+
+	for (i = 0; i < UL_MD5LENGTH; i++)
+		printf( "%02x", digest[i] );
+	printf("\n");
+}
+
+/* hashes every line of stdin (without the newline) by ul_MD5Multi() */
+static int test_multi(void)
+{
+	unsigned char (*digests)[UL_MD5LENGTH];
+	const unsigned char **data = NULL;
+	size_t *lens = NULL, n = 0, i;
+	char *line = NULL;
+	size_t sz = 0;
+	ssize_t len;
+
+	while ((len = getline(&line, &sz, stdin)) >= 0) {
+		if (len && line[len - 1] == '\n')
+			line[--len] = '\0';
+		data = realloc(data, (n + 1) * sizeof(*data));
+		lens = realloc(lens, (n + 1) * sizeof(*lens));
+		if (!data || !lens)
+			return EXIT_FAILURE;
+		data[n] = (unsigned char *) strdup(line);
+		lens[n++] = len;
+	}
+	free(line);
+
+	digests = malloc((n ? n : 1) * UL_MD5LENGTH);
+	if (!digests)
+		return EXIT_FAILURE;
+	ul_MD5Multi(digests, data, lens, n);
+
+	for (i = 0; i < n; i++) {
+		print_digest(digests[i]);
+		free((void *) data[i]);
+	}
+	free(digests);
+	free(data);
+	free(lens);
+	return EXIT_SUCCESS;
+}
+
+static double elapsed(struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* compares throughput of the single-stream and multi-buffer API */
+static int test_bench(size_t size, size_t count)
+{
+	unsigned char (*d1)[UL_MD5LENGTH] = malloc(count * UL_MD5LENGTH);
+	unsigned char (*d2)[UL_MD5LENGTH] = malloc(count * UL_MD5LENGTH);
+	const unsigned char **data = malloc(count * sizeof(*data));
+	size_t *lens = malloc(count * sizeof(*lens));
+	unsigned char *buf = malloc(size * count + 1);
+	struct timespec start;
+	double t1, t2;
+	size_t i;
+
+	if (!d1 || !d2 || !data || !lens || !buf)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < size * count; i++)
+		buf[i] = i * 7 + i / 13;
+	for (i = 0; i < count; i++) {
+		data[i] = buf + i * size;
+		lens[i] = size;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < count; i++) {
+		struct UL_MD5Context ctx;
+
+		ul_MD5Init(&ctx);
+		ul_MD5Update(&ctx, data[i], lens[i]);
+		ul_MD5Final(d1[i], &ctx);
+	}
+	t1 = elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ul_MD5Multi(d2, data, lens, count);
+	t2 = elapsed(&start);
+
+	printf("%zu messages of %zu bytes\n", count, size);
+	printf("single: %8.1f MB/s\n", size * count / t1 / 1e6);
+	printf("multi:  %8.1f MB/s\n", size * count / t2 / 1e6);
+
+	if (memcmp(d1, d2, count * UL_MD5LENGTH) != 0) {
+		fprintf(stderr, "digests differ\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret;
 	struct UL_MD5Context ctx;
 	unsigned char digest[UL_MD5LENGTH];
 	unsigned char buf[BUFSIZ];
 
+	if (argc == 2 && strcmp(argv[1], "--multi") == 0)
+		return test_multi();
+	if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+		return test_bench(argc > 2 ? strtoul(argv[2], NULL, 10) : 64,
+				  argc > 3 ? strtoul(argv[3], NULL, 10) : 100000);
+
 	ul_MD5Init( &ctx );
 
 	while(!feof(stdin) && !ferror(stdin)) {
@@ -22,8 +132,6 @@ int main(void)
 	fclose(stdin);
 	ul_MD5Final( digest, &ctx );
 
-	for (i = 0; i < UL_MD5LENGTH; i++)
-		printf( "%02x", digest[i] );
-	printf("\n");
+	print_digest(digest);
 	return 0;
 }
@@ -66,6 +66,7 @@
 #include "nls.h"
 #include "optutils.h"
 #include "strutils.h"
+#include "wcreader.h"
 #include "widechar.h"
 #include "xalloc.h"
 
@@ -135,6 +136,7 @@ struct col_ctl {
 	size_t max_bufd_lines;		/* max # lines to keep in memory */
 	struct col_line *line_freelist;
 	size_t nblank_lines;		/* # blanks after last flushed line */
+	struct ul_wcreader in;		/* buffered stdin */
 #ifdef COL_DEALLOCATE_ON_EXIT
 	struct col_alloc *alloc_root;	/* first of line allocations */
 	struct col_alloc *alloc_head;	/* latest line allocation */
@@ -409,7 +411,7 @@ static int handle_not_graphic(struct col_ctl *ctl, struct col_lines *lns)
 		lns->cur_col = 0;
 		return 1;
 	case ESC:
-		switch (getwchar()) {	/* just ignore EOF */
+		switch (ul_wcreader_getwc(&ctl->in)) {	/* just ignore EOF */
 		case RLF:
 			lns->cur_line -= 2;
 			break;
@@ -663,11 +665,12 @@ int main(int argc, char **argv)
 	ctl.lines = ctl.l = alloc_line(&ctl);
 
 	parse_options(&ctl, argc, argv);
+	ul_init_wcreader(&ctl.in, stdin);
 
-	while (feof(stdin) == 0) {
+	for (;;) {
 		errno = 0;
 		/* Get character */
-		lns.ch = getwchar();
+		lns.ch = ul_wcreader_getwc(&ctl.in);
 
 		if (lns.ch == WEOF) {
 			if (errno == EILSEQ) {
@@ -676,7 +679,7 @@ int main(int argc, char **argv)
 				char buf[5];
 				size_t len, i;
 
-				c = getchar();
+				c = ul_wcreader_getbyte(&ctl.in);
 				if (c == EOF)
 					break;
 				sprintf(buf, "\\x%02x", (unsigned char) c);
@@ -699,6 +702,7 @@ int main(int argc, char **argv)
 	if (lns.max_line == 0 && lns.cur_col == 0) {
 #ifdef COL_DEALLOCATE_ON_EXIT
 		free_line_allocations(ctl.alloc_root);
+		ul_free_wcreader(&ctl.in);
 #endif
 		return EXIT_SUCCESS;	/* no lines, so just exit */
 	}
@@ -718,6 +722,7 @@ int main(int argc, char **argv)
 	flush_blanks(&ctl);
 #ifdef COL_DEALLOCATE_ON_EXIT
 	free_line_allocations(ctl.alloc_root);
+	ul_free_wcreader(&ctl.in);
 #endif
 	return ret;
 }
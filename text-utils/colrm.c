@@ -46,6 +46,7 @@
 #include "nls.h"
 #include "strutils.h"
 #include "c.h"
+#include "wcreader.h"
 #include "widechar.h"
 #include "closestream.h"
 
@@ -72,7 +73,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	exit(EXIT_SUCCESS);
 }
 
-static int process_input(unsigned long first, unsigned long last)
+static int process_input(struct ul_wcreader *in, unsigned long first, unsigned long last)
 {
 	unsigned long ct = 0;
 	wint_t c;
@@ -81,7 +82,7 @@ static int process_input(unsigned long first, unsigned long last)
 	int padding;
 
 	for (;;) {
-		c = getwc(stdin);
+		c = ul_wcreader_getwc(in);
 		if (c == WEOF)
 			return 0;
 		if (c == '\t')
@@ -112,7 +113,7 @@ static int process_input(unsigned long first, unsigned long last)
 
 	/* Loop getting rid of characters */
 	while (!last || ct < last) {
-		c = getwc(stdin);
+		c = ul_wcreader_getwc(in);
 		if (c == WEOF)
 			return 0;
 		if (c == '\n') {
@@ -135,7 +136,7 @@ static int process_input(unsigned long first, unsigned long last)
 
 	/* Output last of the line */
 	for (;;) {
-		c = getwc(stdin);
+		c = ul_wcreader_getwc(in);
 		if (c == WEOF)
 			break;
 		if (c == '\n') {
@@ -154,6 +155,7 @@ static int process_input(unsigned long first, unsigned long last)
 
 int main(int argc, char **argv)
 {
+	struct ul_wcreader in;
 	unsigned long first = 0, last = 0;
 	int opt;
 
@@ -185,7 +187,8 @@ int main(int argc, char **argv)
 	if (argc > 2)
 		last = strtoul_or_err(*++argv, _("second argument"));
 
-	while (process_input(first, last))
+	ul_init_wcreader(&in, stdin);
+	while (process_input(&in, first, last))
 		;
 
 	fflush(stdout);
@@ -86,18 +86,23 @@ struct column_control {
 	const char *tree_parent;
 
 	wchar_t *input_separator;
+	const char *input_separator_mbs;	/* the same as multibyte string */
 	const char *output_separator;
 
 	wchar_t	**ents;		/* input entries */
 	size_t	nents;		/* number of entries */
 	size_t	maxlength;	/* longest input record (line) */
 	size_t  maxncols;	/* maximal number of input columns */
+	size_t	stream_sample;	/* --table-stream lines */
 
 	unsigned int greedy :1,
 		     json :1,
 		     header_repeat :1,
 		     keep_empty_lines :1,	/* --keep-empty-lines */
-		     tab_noheadings :1;
+		     tab_noheadings :1,
+		     stream :1,			/* --table-stream */
+		     stream_ready :1,		/* columns are final */
+		     bytesplit :1;		/* split table lines without wchar_t */
 };
 
 static size_t width(const wchar_t *str)
@@ -190,6 +195,30 @@ static wchar_t *local_wcstok(struct column_control const *const ctl, wchar_t *p,
 	return result;
 }
 
+/* the same as local_wcstok(), but for multibyte strings */
+static char *local_strtok(struct column_control const *const ctl, char *p,
+			  char **state)
+{
+	char *result = NULL;
+
+	if (ctl->greedy)
+		return strtok_r(p, ctl->input_separator_mbs, state);
+	if (!p) {
+		if (!*state)
+			return NULL;
+		p = *state;
+	}
+	result = p;
+	p = strpbrk(result, ctl->input_separator_mbs);
+	if (!p)
+		*state = NULL;
+	else {
+		*p = '\0';
+		*state = p + 1;
+	}
+	return result;
+}
+
 static char **split_or_error(const char *str, const char *errmsg)
 {
 	char **res = strv_split(str, ",");
@@ -226,6 +255,11 @@ static void init_table(struct column_control *ctl)
 		scols_table_enable_noheadings(ctl->tab, !!ctl->tab_noheadings);
 	} else
 		scols_table_enable_noheadings(ctl->tab, 1);
+
+	if (ctl->stream) {
+		scols_table_enable_streaming(ctl->tab, 1);
+		scols_table_set_streaming_sample(ctl->tab, ctl->stream_sample);
+	}
 }
 
 static struct libscols_column *string_to_column(struct column_control *ctl, const char *str)
@@ -442,18 +476,38 @@ static void modify_table(struct column_control *ctl)
 }
 
 
+/*
+ * Streaming mode -- the sampled lines are printed when the next line is
+ * added, so the columns have to be complete and modified before that. The
+ * later lines cannot add columns; the remaining data are in the last column
+ * (like --table-columns-limit).
+ */
+static void prepare_stream(struct column_control *ctl)
+{
+	if (!ctl->stream || ctl->stream_ready)
+		return;
+	if (scols_table_get_nlines(ctl->tab) < max(ctl->stream_sample, (size_t) 1))
+		return;
+
+	modify_table(ctl);
+	ctl->stream_ready = 1;
+}
+
 static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 {
 	wchar_t *wcdata, *sv = NULL, *wcs = wcs0;
-	size_t n = 0, nchars = 0;
+	size_t n = 0, nchars = 0, maxncols;
 	struct libscols_line *ln = NULL;
 
 	if (!ctl->tab)
 		init_table(ctl);
+
+	prepare_stream(ctl);
+	maxncols = ctl->stream_ready ? scols_table_get_ncols(ctl->tab) : ctl->maxncols;
 	do {
 		char *data;
 
-		if (ctl->maxncols && n + 1 == ctl->maxncols)
+		if (maxncols && n + 1 == maxncols)
 			wcdata = wcs0 + nchars;
 		else
 			wcdata = local_wcstok(ctl, wcs, &sv);
@@ -483,18 +537,86 @@ static int add_line_to_table(struct column_control *ctl, wchar_t *wcs0)
 			err(EXIT_FAILURE, _("failed to add output data"));
 		n++;
 		wcs = NULL;
-		if (ctl->maxncols && n == ctl->maxncols)
+		if (maxncols && n == maxncols)
 			break;
 	} while (1);
 
 	return 0;
 }
 
+/*
+ * The same as add_line_to_table(), but the line is split without conversion
+ * to wchar_t and back. It's possible for ASCII separators in UTF-8 or
+ * single-byte locales only (see main()), the separators are never part of
+ * a multibyte character in these encodings.
+ */
+static int add_mbsline_to_table(struct column_control *ctl, char *str0)
+{
+	char *str = str0, *field, *sv = NULL;
+	size_t n = 0, nbytes = 0, maxncols;
+	struct libscols_line *ln = NULL;
+
+	if (!ctl->tab)
+		init_table(ctl);
+
+	prepare_stream(ctl);
+	maxncols = ctl->stream_ready ? scols_table_get_ncols(ctl->tab) : ctl->maxncols;
+	do {
+		char *data;
+
+		if (maxncols && n + 1 == maxncols)
+			field = str0 + nbytes;
+		else
+			field = local_strtok(ctl, str, &sv);
+
+		if (!field)
+			break;
+		if (scols_table_get_ncols(ctl->tab) < n + 1) {
+			if (scols_table_is_json(ctl->tab))
+				errx(EXIT_FAILURE, _("line %zu: for JSON the name of the "
+					"column %zu is required"),
+					scols_table_get_nlines(ctl->tab) + 1,
+					n + 1);
+			scols_table_new_column(ctl->tab, NULL, 0, 0);
+		}
+		if (!ln) {
+			ln = scols_table_new_line(ctl->tab, NULL);
+			if (!ln)
+				err(EXIT_FAILURE, _("failed to allocate output line"));
+		}
+
+		nbytes += strlen(field) + 1;
+
+		data = xstrdup(field);
+		if (scols_line_refer_data(ln, n, data))
+			err(EXIT_FAILURE, _("failed to add output data"));
+		n++;
+		str = NULL;
+		if (maxncols && n == maxncols)
+			break;
+	} while (1);
+
+	return 0;
+}
+
+/* returns 1 if the string is ASCII or valid multibyte string */
+static int is_valid_mbs(const char *str)
+{
+	const char *p;
+
+	for (p = str; *p; p++) {
+		if ((unsigned char) *p >= 0x80)
+			return mbstowcs(NULL, p, 0) != (size_t) -1;
+	}
+	return 1;
+}
+
 static int add_emptyline_to_table(struct column_control *ctl)
 {
 	if (!ctl->tab)
 		init_table(ctl);
 
+	prepare_stream(ctl);
 	if (!scols_table_new_line(ctl->tab, NULL))
 		err(EXIT_FAILURE, _("failed to allocate output line"));
 
@@ -549,6 +671,12 @@ static int read_input(struct column_control *ctl, FILE *fp)
 			continue;
 		}
 
+		if (ctl->mode == COLUMN_MODE_TABLE && ctl->bytesplit
+		    && is_valid_mbs(buf)) {
+			rc = add_mbsline_to_table(ctl, buf);
+			continue;
+		}
+
 		wcs = mbs_to_wcs(buf);
 		if (!wcs) {
 			/*
@@ -674,6 +802,7 @@ static void __attribute__((__noreturn__)) usage(void)
 	fputs(_(" -E, --table-noextreme <columns>  don't count long text from the columns to column width\n"), out);
 	fputs(_(" -d, --table-noheadings           don't print header\n"), out);
 	fputs(_(" -e, --table-header-repeat        repeat header for each page\n"), out);
+	fputs(_(" -S, --table-stream <lines>       print lines continuously, widths from first lines\n"), out);
 	fputs(_(" -H, --table-hide <columns>       don't print the columns\n"), out);
 	fputs(_(" -R, --table-right <columns>      right align text in these columns\n"), out);
 	fputs(_(" -T, --table-truncate <columns>   truncate text in the columns when necessary\n"), out);
@@ -730,6 +859,7 @@ int main(int argc, char **argv)
 		{ "table-noheadings",    no_argument,       NULL, 'd' },
 		{ "table-order",         required_argument, NULL, 'O' },
 		{ "table-right",         required_argument, NULL, 'R' },
+		{ "table-stream",        required_argument, NULL, 'S' },
 		{ "table-truncate",      required_argument, NULL, 'T' },
 		{ "table-wrap",          required_argument, NULL, 'W' },
 		{ "table-empty-lines",   no_argument,       NULL, 'L' }, /* deprecated */
@@ -742,6 +872,7 @@ int main(int argc, char **argv)
 	};
 	static const ul_excl_t excl[] = {       /* rows and cols in ASCII order */
 		{ 'J','x' },
+		{ 'S','r' },
 		{ 't','x' },
 		{ 0 }
 	};
@@ -754,8 +885,9 @@ int main(int argc, char **argv)
 
 	ctl.output_separator = "  ";
 	ctl.input_separator = mbs_to_wcs("\t ");
+	ctl.input_separator_mbs = "\t ";
 
-	while ((c = getopt_long(argc, argv, "c:dE:eH:hi:Jl:LN:n:O:o:p:R:r:s:T:tVW:x", longopts, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "c:dE:eH:hi:Jl:LN:n:O:o:p:R:r:S:s:T:tVW:x", longopts, NULL)) != -1) {
 
 		err_exclusive_options(c, longopts, excl, excl_st);
 
@@ -811,11 +943,16 @@ int main(int argc, char **argv)
 		case 'r':
 			ctl.tree = optarg;
 			break;
+		case 'S':
+			ctl.stream = 1;
+			ctl.stream_sample = strtou32_or_err(optarg, _("invalid stream lines argument"));
+			break;
 		case 's':
 			free(ctl.input_separator);
 			ctl.input_separator = mbs_to_wcs(optarg);
 			if (!ctl.input_separator)
 				err(EXIT_FAILURE, _("failed to use input separator"));
+			ctl.input_separator_mbs = optarg;
 			ctl.greedy = 0;
 			break;
 		case 'T':
@@ -855,12 +992,26 @@ int main(int argc, char **argv)
 	if (ctl.mode != COLUMN_MODE_TABLE
 	    && (ctl.tab_order || ctl.tab_name || ctl.tab_colwrap ||
 		ctl.tab_colhide || ctl.tab_coltrunc || ctl.tab_colnoextrem ||
-		ctl.tab_colright || ctl.tab_colnames))
+		ctl.tab_colright || ctl.tab_colnames || ctl.stream))
 		errx(EXIT_FAILURE, _("option --table required for all --table-*"));
 
 	if (ctl.tab_colnames == NULL && ctl.json)
 		errx(EXIT_FAILURE, _("option --table-columns required for --json"));
 
+#ifdef HAVE_WIDECHAR
+	if (ctl.mode == COLUMN_MODE_TABLE) {
+		const char *p;
+
+		for (p = ctl.input_separator_mbs; *p; p++) {
+			if ((unsigned char) *p >= 0x80)
+				break;
+		}
+		if (!*p && (MB_CUR_MAX == 1 ||
+			    strcmp(nl_langinfo(CODESET), "UTF-8") == 0))
+			ctl.bytesplit = 1;
+	}
+#endif
+
 	if (!*argv)
 		eval += read_input(&ctl, stdin);
 	else
@@ -886,7 +1037,8 @@ int main(int argc, char **argv)
 	switch (ctl.mode) {
 	case COLUMN_MODE_TABLE:
 		if (ctl.tab && scols_table_get_nlines(ctl.tab)) {
-			modify_table(&ctl);
+			if (!ctl.stream_ready)
+				modify_table(&ctl);
 			eval = scols_print_table(ctl.tab);
 		}
 		break;
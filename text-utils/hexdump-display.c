@@ -237,6 +237,111 @@ static void bpad(struct hexdump_pr *pr)
 		;
 }
 
+/*
+ * Fast path for the built-in layouts (see HEXDUMP_LAYOUT_*). The output is
+ * the same as from the format interpreter below, but every line is composed
+ * in a buffer and written at once rather than by printf() per unit.
+ */
+static const char hexdigits[] = "0123456789abcdef";
+
+static char *layout_address(char *p, off_t addr, int width)
+{
+	unsigned long long x = addr;
+	char tmp[sizeof(x) * 2];
+	int n = 0;
+
+	do {
+		tmp[n++] = hexdigits[x & 0xf];
+		x >>= 4;
+	} while (x);
+
+	for (; width > n; width--)
+		*p++ = '0';
+	while (n)
+		*p++ = tmp[--n];
+	return p;
+}
+
+static void display_layout(struct hexdump *hex)
+{
+	unsigned char printable[256];
+	unsigned char *bp;
+	char line[128], *p;
+	int i;
+
+	for (i = 0; i < 256; i++)
+		printable[i] = isprint(i) ? i : '.';
+
+	while ((bp = get(hex)) != NULL) {
+		/* number of valid bytes in the block */
+		off_t nvalid = eaddress ? min(eaddress - address,
+					      (off_t) hex->blocksize) : hex->blocksize;
+
+		p = line;
+		switch (hex->layout) {
+		case HEXDUMP_LAYOUT_CANONICAL:
+			p = layout_address(p, address, 8);
+			*p++ = ' ';
+			for (i = 0; i < 16; i++) {
+				*p++ = ' ';
+				if (i == 8)
+					*p++ = ' ';
+				if (i < nvalid) {
+					*p++ = hexdigits[bp[i] >> 4];
+					*p++ = hexdigits[bp[i] & 0xf];
+				} else {
+					*p++ = ' ';
+					*p++ = ' ';
+				}
+			}
+			*p++ = ' ';
+			*p++ = ' ';
+			*p++ = '|';
+			for (i = 0; i < nvalid; i++)
+				*p++ = printable[bp[i]];
+			*p++ = '|';
+			break;
+
+		case HEXDUMP_LAYOUT_HEX16:
+		case HEXDUMP_LAYOUT_XHEX16:
+			p = layout_address(p, address, 7);
+			for (i = 0; i < 16; i += 2) {
+				uint16_t x;
+
+				*p++ = ' ';
+				if (hex->layout == HEXDUMP_LAYOUT_XHEX16) {
+					memcpy(p, "   ", 3);
+					p += 3;
+				}
+				if (i < nvalid) {
+					memcpy(&x, bp + i, sizeof(x));
+					*p++ = hexdigits[(x >> 12) & 0xf];
+					*p++ = hexdigits[(x >> 8) & 0xf];
+					*p++ = hexdigits[(x >> 4) & 0xf];
+					*p++ = hexdigits[x & 0xf];
+				} else {
+					memcpy(p, "    ", 4);
+					p += 4;
+				}
+			}
+			break;
+		}
+		*p++ = '\n';
+		fwrite(line, 1, p - line, stdout);
+	}
+
+	/* the end address, the same as the "%_A" unit */
+	if (!eaddress) {
+		if (!address)
+			return;
+		eaddress = address;
+	}
+	p = layout_address(line, eaddress,
+			   hex->layout == HEXDUMP_LAYOUT_CANONICAL ? 8 : 7);
+	*p++ = '\n';
+	fwrite(line, 1, p - line, stdout);
+}
+
 void display(struct hexdump *hex)
 {
 	register struct list_head *fs;
@@ -249,6 +354,11 @@ void display(struct hexdump *hex)
 	unsigned char savech = 0, *savebp;
 	struct list_head *p, *q, *r;
 
+	if (hex->layout != HEXDUMP_LAYOUT_NONE && hex->blocksize == 16) {
+		display_layout(hex);
+		return;
+	}
+
 	while ((bp = get(hex)) != NULL) {
 		fs = &hex->fshead; savebp = bp; saveaddress = address;
 
@@ -324,17 +434,100 @@ void display(struct hexdump *hex)
 
 static char **_argv;
 
+/*
+ * Input buffer. Regular files are read in large chunks, other files (pipes,
+ * terminals) only by the requested size to not delay the output.
+ */
+#define HEXDUMP_INBUFSZ		(256 * 1024)
+
+static u_char *inbuf;
+static size_t inpos, inlen;
+
+/*
+ * Returns the number of bytes available in the input buffer, 0 at the end of
+ * the input, or -1 if all input files failed.
+ */
+static ssize_t fill(struct hexdump *hex, size_t want)
+{
+	static int ateof = 1, regular;
+	struct stat st;
+	size_t n;
+
+	if (inpos < inlen)
+		return inlen - inpos;
+	inpos = inlen = 0;
+
+	while (TRUE) {
+		if (!hex->length)
+			return 0;
+		if (ateof) {
+			if (!next(NULL, hex))
+				return 0;
+			regular = fstat(fileno(stdin), &st) == 0 && S_ISREG(st.st_mode);
+		}
+		if (fileno(stdin) == -1) {
+			warnx(_("all input file arguments failed"));
+			return -1;
+		}
+		if (regular)
+			want = HEXDUMP_INBUFSZ;
+		if (hex->length != -1)
+			want = min((size_t) hex->length, want);
+
+		n = fread(inbuf, sizeof(unsigned char), want, stdin);
+		if (!n) {
+			if (ferror(stdin))
+				warn("%s", _argv[-1]);
+			ateof = 1;
+			continue;
+		}
+		ateof = 0;
+		if (hex->length != -1)
+			hex->length -= n;
+		inlen = n;
+		return n;
+	}
+}
+
+/*
+ * Returns the number of blocks at @p which are the same as @prev. The blocks
+ * after the first one are compared with the previous block in large chunks,
+ * so long runs of the same data (e.g. zeroed areas of disk images) are
+ * skipped by a few memcmp() calls.
+ */
+static size_t count_dups(const u_char *prev, const u_char *p, size_t len,
+			 size_t bs)
+{
+	size_t n;
+
+	if (len < bs || memcmp(p, prev, bs) != 0)
+		return 0;
+	n = bs;
+
+	while (n + bs <= len) {
+		size_t chunk = min(len - n, (size_t) 4096) / bs * bs;
+
+		if (memcmp(p + n, p + n - bs, chunk) != 0)
+			break;
+		n += chunk;
+	}
+	while (n + bs <= len && memcmp(p + n, prev, bs) == 0)
+		n += bs;
+
+	return n / bs;
+}
+
 static u_char *
 get(struct hexdump *hex)
 {
-	static int ateof = 1;
 	static u_char *curp, *savp;
-	ssize_t n, need, nread;
+	ssize_t need, nread, avail;
 	u_char *tmpp;
 
 	if (!curp) {
 		curp = xcalloc(1, hex->blocksize);
 		savp = xcalloc(1, hex->blocksize);
+		inbuf = xmalloc(max((size_t) hex->blocksize, (size_t) HEXDUMP_INBUFSZ));
 	} else {
 		tmpp = curp;
 		curp = savp;
@@ -343,12 +536,15 @@ get(struct hexdump *hex)
 	}
 	need = hex->blocksize, nread = 0;
 	while (TRUE) {
+		avail = fill(hex, need);
+		if (avail < 0)
+			goto retnul;
 		/*
 		 * if read the right number of bytes, or at EOF for one file,
 		 * and no other files are available, zero-pad the rest of the
 		 * block and set the end flag.
 		 */
-		if (!hex->length || (ateof && !next(NULL, hex))) {
+		if (!avail) {
 			if (need == hex->blocksize)
 				goto retnul;
 			if (!need && vflag != ALL &&
@@ -362,22 +558,26 @@ get(struct hexdump *hex)
 			eaddress = address + nread;
 			return(curp);
 		}
-		if (fileno(stdin) == -1) {
-			warnx(_("all input file arguments failed"));
-			goto retnul;
-		}
-		n = fread((char *)curp + nread, sizeof(unsigned char),
-		    hex->length == -1 ? need : min(hex->length, need), stdin);
-		if (!n) {
-			if (ferror(stdin))
-				warn("%s", _argv[-1]);
-			ateof = 1;
-			continue;
+
+		/* skip all buffered blocks which are the same as the last one */
+		if (!nread && (vflag == WAIT || vflag == DUP)) {
+			size_t ndups = count_dups(savp, inbuf + inpos, avail,
+						  hex->blocksize);
+			if (ndups) {
+				if (vflag == WAIT)
+					printf("*\n");
+				vflag = DUP;
+				address += ndups * hex->blocksize;
+				inpos += ndups * hex->blocksize;
+				continue;
+			}
 		}
-		ateof = 0;
-		if (hex->length != -1)
-			hex->length -= n;
-		if (!(need -= n)) {
+
+		avail = min(avail, need);
+		memcpy(curp + nread, inbuf + inpos, avail);
+		inpos += avail;
+
+		if (!(need -= avail)) {
 			if (vflag == ALL || vflag == FIRST ||
 			    memcmp(curp, savp, hex->blocksize) != 0) {
 				if (vflag == DUP || vflag == FIRST)
@@ -392,11 +592,12 @@ get(struct hexdump *hex)
 			nread = 0;
 		}
 		else
-			nread += n;
+			nread += avail;
 	}
 retnul:
 	free (curp);
 	free (savp);
+	free (inbuf);
 	return NULL;
 }
 
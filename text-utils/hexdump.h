@@ -86,12 +86,21 @@ struct hexdump_fs {			/* format strings */
 	int bcnt;
 };
 
+/* built-in layouts printed without the format interpreter */
+enum {
+	HEXDUMP_LAYOUT_NONE = 0,	/* use format strings */
+	HEXDUMP_LAYOUT_CANONICAL,	/* -C */
+	HEXDUMP_LAYOUT_HEX16,		/* default */
+	HEXDUMP_LAYOUT_XHEX16		/* -x */
+};
+
 struct hexdump {
   struct list_head fshead;				/* head of format strings */
   ssize_t blocksize;			/* data block size */
   int exitval;				/* final exit value */
   ssize_t length;			/* max bytes to read */
   off_t skip;				/* bytes to skip */
+  int layout;				/* HEXDUMP_LAYOUT_* */
 };
 
 extern struct hexdump_fu *endfu;
@@ -85,6 +85,7 @@
 #include "closestream.h"
 #include "rpmatch.h"
 #include "env.h"
+#include "lineidx.h"
 
 #ifdef TEST_PROGRAM
 # define NON_INTERACTIVE_MORE 1
@@ -162,6 +163,7 @@ struct more_control {
 	FILE *current_file;		/* currently open input file */
 	off_t file_position;		/* file position */
 	off_t file_size;		/* file size */
+	struct ul_lineidx line_index;	/* offsets of the lines read so far */
 	int argv_position;		/* argv[] position */
 	int lines_per_screen;		/* screen size in lines */
 	int d_scroll_len;		/* number of lines scrolled by 'd' */
@@ -377,13 +379,38 @@ static void more_fseek(struct more_control *ctl, off_t pos)
 	fseeko(ctl->current_file, pos, SEEK_SET);
 }
 
+/* Called after a newline has been read */
+static void more_index_line(struct more_control *ctl)
+{
+	/* the file is always read continuously from the begin, so the next
+	 * newline behind the indexed area starts the next line */
+	if (ul_lineidx_last(&ctl->line_index) < ctl->file_position)
+		ul_lineidx_add(&ctl->line_index, ctl->file_position);
+}
+
 static int more_getc(struct more_control *ctl)
 {
 	int ret = getc(ctl->current_file);
 	ctl->file_position = ftello(ctl->current_file);
+	if (ret == '\n')
+		more_index_line(ctl);
 	return ret;
 }
 
+/* Seek to begin of the line @n if the line has been already read */
+static int more_seek_line(struct more_control *ctl, int n)
+{
+	off_t pos;
+
+	if (ul_lineidx_get(&ctl->line_index, n, &pos) != 0)
+		return -1;
+	if (fseeko(ctl->current_file, pos, SEEK_SET) != 0)
+		return -1;
+	ctl->file_position = pos;
+	ctl->current_line = n;
+	return 0;
+}
+
 static int more_ungetc(struct more_control *ctl, int c)
 {
 	int ret = ungetc(c, ctl->current_file);
@@ -1347,11 +1374,14 @@ static void read_line(struct more_control *ctl)
 	char *p;
 
 	p = ctl->line_buf;
-	while ((c = more_getc(ctl)) != '\n' && c != EOF
+	while ((c = getc(ctl->current_file)) != '\n' && c != EOF
 	       && (ptrdiff_t)p != (ptrdiff_t)(ctl->line_buf + ctl->line_sz - 1))
 		*p++ = c;
-	if (c == '\n')
+	ctl->file_position = ftello(ctl->current_file);
+	if (c == '\n') {
 		ctl->current_line++;
+		more_index_line(ctl);
+	}
 	*p = '\0';
 }
 
@@ -1401,6 +1431,15 @@ static int more_poll(struct more_control *ctl, int timeout)
 	return 0;
 }
 
+/* Returns true if the basic regular expression @re matches only itself
+ * and it is safe to search for it byte by byte in the current locale */
+static int is_literal_regex(const char *re)
+{
+	if (strpbrk(re, "\\^$.[*"))
+		return 0;
+	return MB_CUR_MAX == 1 || strcmp(nl_langinfo(CODESET), "UTF-8") == 0;
+}
+
 /* Search for nth occurrence of regular expression contained in buf in
  * the file */
 static void search(struct more_control *ctl, char buf[], int n)
@@ -1410,7 +1449,8 @@ static void search(struct more_control *ctl, char buf[], int n)
 	off_t line2 = startline;
 	off_t line3;
 	int lncount;
-	int saveln, rc;
+	int saveln, rc, match;
+	const char *literal;
 	regex_t re;
 
 	if (buf != ctl->previous_search) {
@@ -1430,13 +1470,20 @@ static void search(struct more_control *ctl, char buf[], int n)
 		more_error(ctl, s);
 		return;
 	}
+	/* strstr() is much faster than regexec() for plain strings */
+	literal = is_literal_regex(buf) ? buf : NULL;
+
 	while (!feof(ctl->current_file)) {
 		line3 = line2;
 		line2 = line1;
 		line1 = ctl->file_position;
 		read_line(ctl);
 		lncount++;
-		if (regexec(&re, ctl->line_buf, 0, NULL, 0) == 0 && --n == 0) {
+		if (literal)
+			match = strstr(ctl->line_buf, literal) != NULL;
+		else
+			match = regexec(&re, ctl->line_buf, 0, NULL, 0) == 0;
+		if (match && --n == 0) {
 			if ((1 < lncount && ctl->no_tty_in) || 3 < lncount) {
 				putchar('\n');
 				if (ctl->clear_line_ends)
@@ -1466,7 +1513,9 @@ static void search(struct more_control *ctl, char buf[], int n)
 			}
 			break;
 		}
-		more_poll(ctl, 1);
+		/* check for signals, but do not wait on every line */
+		if (lncount % 256 == 0)
+			more_poll(ctl, 0);
 	}
 	/* Move ctrl+c signal handling back to more_key_command(). */
 	signal(SIGINT, SIG_DFL);
@@ -1577,6 +1626,10 @@ static int skip_backwards(struct more_control *ctl, int nlines)
 	ctl->next_jump = ctl->current_line - (ctl->lines_per_screen * (nlines + 1)) - 1;
 	if (ctl->next_jump < 0)
 		ctl->next_jump = 0;
+	if (more_seek_line(ctl, ctl->next_jump) == 0) {
+		ctl->next_jump = 0;
+		return ctl->lines_per_screen;
+	}
 	more_fseek(ctl, 0);
 	ctl->current_line = 0;
 	skip_lines(ctl);
@@ -1603,6 +1656,9 @@ static int skip_forwards(struct more_control *ctl, int nlines, cc_t comchar)
 		putp(ctl->erase_line);
 	putchar('\n');
 
+	if (more_seek_line(ctl, ctl->current_line + nlines) == 0)
+		return 1;
+
 	while (nlines > 0) {
 		while ((c = more_getc(ctl)) != '\n')
 			if (c == EOF)
@@ -1897,6 +1953,8 @@ static void display_file(struct more_control *ctl, int left)
 		return;
 	ctl->context.line_num = ctl->context.row_num = 0;
 	ctl->current_line = 0;
+	ul_lineidx_reset(&ctl->line_index);
+	ul_lineidx_add(&ctl->line_index, 0);
 	if (ctl->first_file) {
 		ctl->first_file = 0;
 		if (ctl->next_jump)
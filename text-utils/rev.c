@@ -96,13 +96,123 @@ static void reverse_str(wchar_t *str, size_t n)
 	}
 }
 
+/*
+ * Fast path for UTF-8 and single-byte locales. The input is read in large
+ * blocks and the lines are reversed in place, without conversion to wchar_t.
+ * Multibyte characters are reversed twice (alone and with the line), so the
+ * bytes of the character stay in the original order.
+ */
+#define REV_BUFSIZ	(64 * 1024)
+
+static void reverse_bytes(char *str, size_t n)
+{
+	char *a = str, *b = str + n - 1;
+
+	for (; a < b; a++, b--) {
+		char tmp = *a;
+		*a = *b;
+		*b = tmp;
+	}
+}
+
+/*
+ * Returns the size of the reversed string or -1 on invalid multibyte
+ * sequence. An incomplete character at the end of the input (@last) is
+ * ignored like by fgetws(), unless there is nothing else on the line.
+ */
+static ssize_t reverse_mbs(char *str, size_t n, int last)
+{
+#ifdef HAVE_WIDECHAR
+	mbstate_t st;
+	size_t i = 0, len;
+
+	memset(&st, 0, sizeof(st));
+	while (i < n) {
+		if (!((unsigned char) str[i] & 0x80)) {
+			i++;
+			continue;
+		}
+		len = mbrtowc(NULL, str + i, n - i, &st);
+		if (len == (size_t) -2 && last && i > 0) {
+			n = i;
+			break;
+		}
+		if (len == (size_t) -1 || len == (size_t) -2)
+			return -1;
+		reverse_bytes(str + i, len);
+		i += len;
+	}
+#endif
+	reverse_bytes(str, n);
+	return n;
+}
+
+/*
+ * Returns 0 on success or -1 on error (errno is set). The file is read by
+ * read(2) to not delay output of the interactive input.
+ */
+static int rev_fast(FILE *fp, uintmax_t *line)
+{
+	static char *buf;
+	static size_t bufsiz;
+	size_t len = 0;
+	char *p, *end, *nl;
+	ssize_t n;
+
+	if (!buf) {
+		bufsiz = REV_BUFSIZ;
+		buf = xmalloc(bufsiz);
+	}
+
+	do {
+		n = read(fileno(fp), buf + len, bufsiz - len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		len += n;
+		end = buf + len;
+
+		for (p = buf; p < end && (nl = memchr(p, '\n', end - p)); p = nl + 1) {
+			if (reverse_mbs(p, nl - p, 0) < 0)
+				goto err;
+			(*line)++;
+		}
+		/* the last line without \n */
+		if (n == 0 && p < end) {
+			ssize_t sz = reverse_mbs(p, end - p, 1);
+
+			if (sz < 0)
+				goto err;
+			fwrite(buf, 1, p + sz - buf, stdout);
+			(*line)++;
+			break;
+		}
+		fwrite(buf, 1, p - buf, stdout);
+
+		len = end - p;
+		memmove(buf, p, len);
+		if (len == bufsiz) {
+			bufsiz *= 2;
+			buf = xrealloc(buf, bufsiz);
+		}
+	} while (n != 0);
+
+	return 0;
+err:
+	fwrite(buf, 1, p - buf, stdout);
+	errno = EILSEQ;
+	return -1;
+}
+
 int main(int argc, char *argv[])
 {
 	char const *filename = "stdin";
 	wchar_t *buf;
 	size_t len, bufsiz = BUFSIZ;
 	FILE *fp = stdin;
-	int ch, rval = EXIT_SUCCESS;
+	int ch, rval = EXIT_SUCCESS, fast;
 	uintmax_t line;
 
 	static const struct option longopts[] = {
@@ -132,7 +242,14 @@ int main(int argc, char *argv[])
 	argc -= optind;
 	argv += optind;
 
-	buf = xmalloc(bufsiz * sizeof(wchar_t));
+	/* the newline and the other ASCII characters are never part of
+	 * a multibyte character in these locales */
+#ifdef HAVE_WIDECHAR
+	fast = MB_CUR_MAX == 1 || strcmp(nl_langinfo(CODESET), "UTF-8") == 0;
+#else
+	fast = 1;
+#endif
+	buf = fast ? NULL : xmalloc(bufsiz * sizeof(wchar_t));
 
 	do {
 		if (*argv) {
@@ -146,6 +263,13 @@ int main(int argc, char *argv[])
 		}
 
 		line = 0;
+		if (fast) {
+			if (rev_fast(fp, &line) != 0) {
+				warn("%s: %ju", filename, line);
+				rval = EXIT_FAILURE;
+			}
+			goto next;
+		}
 		while (fgetws(buf, bufsiz, fp)) {
 			len = wcslen(buf);
 
@@ -176,6 +300,7 @@ int main(int argc, char *argv[])
 			warn("%s: %ju", filename, line);
 			rval = EXIT_FAILURE;
 		}
+next:
 		if (fp != stdin)
 			fclose(fp);
 	} while(*argv);
@@ -59,6 +59,7 @@
 
 #include "nls.h"
 #include "xalloc.h"
+#include "wcreader.h"
 #include "widechar.h"
 #include "c.h"
 #include "closestream.h"
@@ -435,11 +436,12 @@ static void reverse(struct ul_ctl *ctl, struct term_caps const *const tcs)
 	ctl->up_line++;
 }
 
-static int handle_escape(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *f)
+static int handle_escape(struct ul_ctl *ctl, struct term_caps const *const tcs,
+			 struct ul_wcreader *in)
 {
 	wint_t c;
 
-	switch (c = getwc(f)) {
+	switch (c = ul_wcreader_getwc(in)) {
 	case HREV:
 		if (0 < ctl->half_position) {
 			ctl->mode &= ~SUBSCRIPT;
@@ -469,17 +471,20 @@ static int handle_escape(struct ul_ctl *ctl, struct term_caps const *const tcs,
 		return 0;
 	default:
 		/* unknown escape */
-		ungetwc(c, f);
+		ul_wcreader_ungetwc(in, c);
 		return 1;
 	}
 }
 
 static void filter(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *f)
 {
+	struct ul_wcreader in;
 	wint_t c;
 	int i, width;
 
-	while ((c = getwc(f)) != WEOF) {
+	ul_init_wcreader(&in, f);
+
+	while ((c = ul_wcreader_getwc(&in)) != WEOF) {
 		switch (c) {
 		case '\b':
 			set_column(ctl, ctl->column && 0 < ctl->column ? ctl->column - 1 : 0);
@@ -497,8 +502,8 @@ static void filter(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *
 			ctl->mode &= ~ALTERNATIVE_CHARSET;
 			continue;
 		case ESC:
-			if (handle_escape(ctl, tcs, f)) {
-				c = getwc(f);
+			if (handle_escape(ctl, tcs, &in)) {
+				c = ul_wcreader_getwc(&in);
 				errx(EXIT_FAILURE,
 				     _("unknown escape sequence in input: %o, %o"), ESC, c);
 			}
@@ -560,6 +565,7 @@ static void filter(struct ul_ctl *ctl, struct term_caps const *const tcs, FILE *
 	}
 	if (ctl->max_column)
 		flush_line(ctl, tcs);
+	ul_free_wcreader(&in);
 }
 
 int main(int argc, char **argv)
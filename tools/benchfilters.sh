@@ -0,0 +1,113 @@
+#!/bin/bash
+#
+# Measure throughput of the text-utils filters on synthetic input.
+#
+# usage: benchfilters.sh [<builddir>]
+#
+# The programs are executed from <builddir> (default: the current
+# directory). The results are printed in MB/s of input; the best of
+# BENCH_REPEAT runs is reported for each case. The UTF-8 input is used
+# in the UTF-8 locale only.
+#
+# Environment:
+#   BENCH_SIZE    size of the generated inputs in MiB (default: 16)
+#   BENCH_REPEAT  number of runs for each case (default: 3)
+#   BENCH_TOOLS   programs to measure (default: all)
+#   BENCH_TMPDIR  where to generate the inputs (default: $TMPDIR or /tmp)
+#
+
+builddir="${1:-.}"
+
+size="${BENCH_SIZE:-16}"
+repeat="${BENCH_REPEAT:-3}"
+tools="${BENCH_TOOLS:-rev col colrm column hexdump ul}"
+locales="C C.UTF-8"
+
+# <program> <input types> <arguments>
+cases=(
+	"rev		ascii utf8	"
+	"col		ascii utf8	-b"
+	"colrm		ascii utf8	10 30"
+	"column		ascii utf8	-t"
+	"hexdump	ascii binary	-C"
+	"hexdump	binary		-v -e '16/1 \"%02x \" \"\\n\"'"
+	"ul		ascii utf8	-t dumb"
+)
+
+tmpdir=$(mktemp -d "${BENCH_TMPDIR:-${TMPDIR:-/tmp}}/benchfilters.XXXXXX") || exit 1
+trap 'rm -rf "$tmpdir"' EXIT
+
+# Lines of words with overstrikes and tabs, like man-pages or logs.
+gen_text() {
+	local utf8=$1
+
+	awk -v utf8="$utf8" -v bytes=$(( size * 1024 * 1024 )) 'BEGIN {
+		srand(1);
+		split("alpha beta gamma delta epsilon zeta eta theta", w, " ");
+		split("\303\251t\303\251 \316\261\316\262\316\263 \344\275\240\345\245\275 na\303\257ve", u, " ");
+		while (n < bytes) {
+			line = sprintf("%08d", nr++);
+			nw = int(rand() * 12);
+			for (i = 0; i < nw; i++) {
+				if (utf8 && rand() < 0.3)
+					word = u[int(rand() * 4) + 1];
+				else
+					word = w[int(rand() * 8) + 1];
+				if (rand() < 0.05)
+					word = "_\b" word;
+				line = line (rand() < 0.1 ? "\t" : " ") word;
+			}
+			print line;
+			n += length(line) + 1;
+		}
+	}'
+}
+
+gen_text 0 > "$tmpdir/ascii"
+gen_text 1 > "$tmpdir/utf8"
+head -c $(( size * 1024 * 1024 )) /dev/urandom > "$tmpdir/binary"
+
+now() {
+	date +%s%N
+}
+
+printf "%-8s %-28s %-8s %-7s %10s\n" "PROGRAM" "ARGUMENTS" "LOCALE" "INPUT" "MB/s"
+
+for c in "${cases[@]}"; do
+	IFS=$'\t' read -r prog inputs args <<< "$c"
+
+	case " $tools " in
+	*" $prog "*) ;;
+	*) continue ;;
+	esac
+	if [ ! -x "$builddir/$prog" ]; then
+		echo "$prog: not found in $builddir, skipping" >&2
+		continue
+	fi
+
+	for loc in $locales; do
+		for in in $inputs; do
+			# UTF-8 input is invalid in the C locale
+			if [ "$in" = "utf8" ] && [ "$loc" = "C" ]; then
+				continue
+			fi
+			insz=$(stat -c %s "$tmpdir/$in")
+			best=
+
+			for (( i = 0; i < repeat; i++ )); do
+				start=$(now)
+				eval LC_ALL=$loc '"$builddir/$prog"' $args \
+					< "$tmpdir/$in" > /dev/null 2>&1
+				elapsed=$(( $(now) - start ))
+				if [ -z "$best" ] || [ $elapsed -lt $best ]; then
+					best=$elapsed
+				fi
+			done
+
+			rate=$(awk -v sz="$insz" -v ns="$best" 'BEGIN {
+				printf "%.1f", ns ? sz * 1000 / ns : 0 }')
+			printf "%-8s %-28s %-8s %-7s %10s\n" \
+				"$prog" "$args" "$loc" "$in" "$rate"
+		done
+	done
+done
@@ -0,0 +1,305 @@
+#!/bin/bash
+#
+# Measure run time of util-linux programs on generated fixtures.
+#
+# usage: benchperf.sh [--save <file>] [--baseline <file>] [<builddir>]
+#
+# The programs are executed from <builddir> (default: the current
+# directory). The best of BENCH_REPEAT runs is reported in milliseconds for
+# each case. The fixtures are generated with a fixed seed, so the same
+# BENCH_SCALE gives the same input on all systems.
+#
+# --save <file>      write the results to <file>
+# --baseline <file>  compare the results with <file> written by --save; the
+#                    cases slower than BENCH_THRESHOLD percent are marked and
+#                    the script exits with 1
+#
+# The cases that need root (loop devices, mount namespace) are skipped for
+# non-root users. Use them only on development systems.
+#
+# Environment:
+#   BENCH_SCALE      multiplier of the fixtures size (default: 1)
+#   BENCH_REPEAT     number of runs for each case (default: 3)
+#   BENCH_THRESHOLD  allowed slowdown in percent (default: 10)
+#   BENCH_CASES      cases to measure (default: all)
+#   BENCH_TMPDIR     where to generate the fixtures (default: $TMPDIR or /tmp)
+#
+
+savefile=
+basefile=
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+	--save)
+		savefile="$2"
+		shift 2
+		;;
+	--baseline)
+		basefile="$2"
+		shift 2
+		;;
+	*)
+		break
+		;;
+	esac
+done
+
+builddir="${1:-.}"
+
+scale="${BENCH_SCALE:-1}"
+repeat="${BENCH_REPEAT:-3}"
+threshold="${BENCH_THRESHOLD:-10}"
+
+# <name> <fixture> <root> <command>
+cases=(
+	"blkid-empty	image	no	blkid -p \$F/empty.img"
+	"blkid-swap	image	no	blkid -p \$F/swap.img"
+	"blkid-loops	loops	yes	blkid -c /dev/null \$LOOPDEVS"
+	"lsblk-json	sysroot	no	lsblk -J --sysroot \$F/sysroot"
+	"lsblk-loops	loops	yes	lsblk -J \$LOOPDEVS"
+	"findmnt-list	mountinfo	no	findmnt -F \$F/mountinfo -l"
+	"findmnt-json	mountinfo	no	findmnt -F \$F/mountinfo -J"
+	"findmnt-target	mountinfo	no	findmnt -F \$F/mountinfo -n -o SOURCE /mnt/dir$(( 5000 * scale ))"
+	"mount-a	fstab	yes	unshare --mount --propagation private mount -a -T \$F/fstab"
+	"last	wtmp	no	last -f \$F/wtmp"
+	"hexdump-C	binary	no	hexdump -C \$F/binary"
+	"column-t	text	no	column -t \$F/text"
+	"hardlink	tree	no	hardlink -n -q \$F/tree"
+)
+
+F=$(mktemp -d "${BENCH_TMPDIR:-${TMPDIR:-/tmp}}/benchperf.XXXXXX") || exit 1
+LOOPDEVS=
+
+cleanup() {
+	local dev
+
+	for dev in $LOOPDEVS; do
+		"$builddir/losetup" -d "$dev" 2>/dev/null
+	done
+	rm -rf "$F"
+}
+trap cleanup EXIT
+
+# Empty image (all the probers run) and a swap area.
+gen_image() {
+	truncate -s $(( 64 * scale ))M "$F/empty.img"
+	truncate -s $(( 64 * scale ))M "$F/swap.img"
+	"$builddir/mkswap" "$F/swap.img" > /dev/null 2>&1
+}
+
+# Block devices for lsblk --sysroot, every disk with two partitions.
+gen_sysroot() {
+	local root="$F/sysroot" i p n=0 dev dir
+
+	mkdir -p "$root/sys/block" "$root/sys/dev/block" "$root/proc/self"
+	: > "$root/proc/self/mountinfo"
+	printf "Filename\tType\tSize\tUsed\tPriority\n" > "$root/proc/swaps"
+
+	for (( i = 0; i < 1000 * scale; i++ )); do
+		dev="disk$i"
+		dir="$root/sys/devices/virtual/block/$dev"
+		mkdir -p "$dir/queue"
+		echo "259:$n" > "$dir/dev"
+		echo 4194304 > "$dir/size"
+		echo 0 > "$dir/ro"
+		echo 0 > "$dir/removable"
+		echo 512 > "$dir/queue/logical_block_size"
+		echo 4096 > "$dir/queue/physical_block_size"
+		echo 0 > "$dir/queue/rotational"
+		ln -s "../devices/virtual/block/$dev" "$root/sys/block/$dev"
+		ln -s "../../devices/virtual/block/$dev" "$root/sys/dev/block/259:$n"
+		n=$(( n + 1 ))
+
+		for p in 1 2; do
+			mkdir -p "$dir/${dev}p$p"
+			echo "259:$n" > "$dir/${dev}p$p/dev"
+			echo 2097152 > "$dir/${dev}p$p/size"
+			echo $(( (p - 1) * 2097152 )) > "$dir/${dev}p$p/start"
+			echo $p > "$dir/${dev}p$p/partition"
+			echo 0 > "$dir/${dev}p$p/ro"
+			ln -s "../../devices/virtual/block/$dev/${dev}p$p" \
+				"$root/sys/dev/block/259:$n"
+			n=$(( n + 1 ))
+		done
+	done
+}
+
+gen_mountinfo() {
+	awk -v n=$(( 10000 * scale )) 'BEGIN {
+		print "1 0 8:1 / / rw,relatime shared:1 - ext4 /dev/sda1 rw";
+		for (i = 2; i <= n; i++)
+			printf "%d 1 0:%d / /mnt/dir%d rw,nosuid,nodev shared:%d - tmpfs tmpfs%d rw,size=1024k\n",
+				i, i, i, i, i;
+	}' > "$F/mountinfo"
+}
+
+gen_fstab() {
+	local i
+
+	for (( i = 0; i < 1000 * scale; i++ )); do
+		mkdir -p "$F/mnt/$i"
+		echo "tmpfs$i $F/mnt/$i tmpfs size=1M 0 0"
+	done > "$F/fstab"
+}
+
+# Logins and logouts of a few users, a reboot every 100 sessions.
+gen_wtmp() {
+	awk -v n=$(( 100000 * scale )) 'BEGIN {
+		srand(1);
+		t = 1577836800;
+		for (i = 0; i < n; i++) {
+			if (i % 100 == 0)
+				printf "[2] [00000] [~~  ] [reboot  ] [~           ] [5.10.0              ] [0.0.0.0        ] [%s]\n", ts(t);
+			pid = 1000 + i % 30000;
+			tty = "pts/" (i % 20);
+			user = "user" int(rand() * 50);
+			t += int(rand() * 60) + 1;
+			printf "[7] [%05d] [ts/%d] [%-8s] [%-12s] [host%-16d] [10.0.%d.%-9d] [%s]\n",
+				pid, i % 20, user, tty, i % 100, i % 250, i % 250, ts(t);
+			t += int(rand() * 3600) + 1;
+			printf "[8] [%05d] [ts/%d] [        ] [%-12s] [                    ] [0.0.0.0        ] [%s]\n",
+				pid, i % 20, tty, ts(t);
+		}
+	}
+	function ts(t) {
+		return strftime("%Y-%m-%dT%H:%M:%S,000000+00:00", t, 1);
+	}' > "$F/wtmp.txt"
+	"$builddir/utmpdump" -r < "$F/wtmp.txt" > "$F/wtmp" 2>/dev/null
+}
+
+gen_binary() {
+	head -c $(( 64 * scale * 1024 * 1024 )) /dev/urandom > "$F/binary"
+}
+
+# Columns of words and numbers of variable width.
+gen_text() {
+	awk -v bytes=$(( 16 * scale * 1024 * 1024 )) 'BEGIN {
+		srand(1);
+		split("alpha beta gamma delta epsilon zeta eta theta", w, " ");
+		while (n < bytes) {
+			line = sprintf("%d %s %s %d %s", nr++, w[int(rand() * 8) + 1],
+				w[int(rand() * 8) + 1], int(rand() * 100000),
+				w[int(rand() * 8) + 1]);
+			print line;
+			n += length(line) + 1;
+		}
+	}' > "$F/text"
+}
+
+# Files in nested directories, every third one is a duplicate.
+gen_tree() {
+	local i dir
+
+	for (( i = 0; i < 2000 * scale; i++ )); do
+		dir="$F/tree/$(( i % 20 ))/$(( i % 7 ))"
+		mkdir -p "$dir"
+		if [ $(( i % 3 )) -eq 0 ]; then
+			printf "duplicate %d\n%04096d\n" $(( i % 100 )) 0 > "$dir/file$i"
+		else
+			printf "unique %d\n%04096d\n" $i 0 > "$dir/file$i"
+		fi
+	done
+}
+
+gen_loops() {
+	local i dev
+
+	for (( i = 0; i < 16 * scale; i++ )); do
+		truncate -s 16M "$F/loop$i.img"
+		dev=$("$builddir/losetup" --show -f "$F/loop$i.img" 2>/dev/null) || break
+		LOOPDEVS="$LOOPDEVS $dev"
+	done
+	[ -n "$LOOPDEVS" ]
+}
+
+declare -A generated
+declare -A baseline
+declare -A results
+
+if [ -n "$basefile" ]; then
+	while read -r name ms; do
+		[ -n "$name" ] && baseline[$name]=$ms
+	done < "$basefile"
+fi
+
+now() {
+	date +%s%N
+}
+
+printf "%-16s %10s %10s %8s\n" "CASE" "ms" "BASELINE" "CHANGE"
+
+regressions=0
+
+for c in "${cases[@]}"; do
+	IFS=$'\t' read -r name fixture needroot cmd <<< "$c"
+
+	if [ -n "$BENCH_CASES" ]; then
+		case " $BENCH_CASES " in
+		*" $name "*) ;;
+		*) continue ;;
+		esac
+	fi
+	if [ "$needroot" = "yes" ] && [ "$(id -u)" -ne 0 ]; then
+		echo "$name: needs root, skipping" >&2
+		continue
+	fi
+
+	prog=${cmd%% *}
+	if [ ! -x "$builddir/$prog" ]; then
+		echo "$name: $prog not found in $builddir, skipping" >&2
+		continue
+	fi
+
+	if [ -z "${generated[$fixture]}" ]; then
+		if ! gen_$fixture; then
+			echo "$name: cannot generate $fixture, skipping" >&2
+			generated[$fixture]=failed
+			continue
+		fi
+		generated[$fixture]=done
+	fi
+	[ "${generated[$fixture]}" = "done" ] || continue
+
+	# mount(8) in the namespace is executed from builddir too
+	cmd=${cmd/ mount / $builddir\/mount }
+
+	best=
+	for (( i = 0; i < repeat; i++ )); do
+		start=$(now)
+		eval '"$builddir/$prog"' "${cmd#* }" > /dev/null 2>&1
+		elapsed=$(( $(now) - start ))
+		if [ -z "$best" ] || [ $elapsed -lt $best ]; then
+			best=$elapsed
+		fi
+	done
+
+	ms=$(awk -v ns="$best" 'BEGIN { printf "%.2f", ns / 1000000 }')
+	results[$name]=$ms
+
+	base="${baseline[$name]}"
+	if [ -n "$base" ]; then
+		change=$(awk -v ms="$ms" -v base="$base" 'BEGIN {
+			printf "%+.1f%%", (base > 0 ? (ms - base) * 100 / base : 0) }')
+		slow=$(awk -v ms="$ms" -v base="$base" -v t="$threshold" 'BEGIN {
+			print (base > 0 && (ms - base) * 100 / base > t) ? 1 : 0 }')
+		if [ "$slow" = "1" ]; then
+			change="$change  REGRESSION"
+			regressions=$(( regressions + 1 ))
+		fi
+		printf "%-16s %10s %10s %8s\n" "$name" "$ms" "$base" "$change"
+	else
+		printf "%-16s %10s\n" "$name" "$ms"
+	fi
+done
+
+if [ -n "$savefile" ]; then
+	for name in "${!results[@]}"; do
+		echo "$name ${results[$name]}"
+	done | sort > "$savefile"
+fi
+
+if [ $regressions -gt 0 ]; then
+	echo "$regressions case(s) slower than $threshold% against $basefile" >&2
+	exit 1
+fi
+exit 0